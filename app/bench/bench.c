@@ -0,0 +1,551 @@
+// Replay a captured video stream into the client pipeline (stream -> decoder
+// -> video_buffer -> screen), without any device, to benchmark it.
+//
+// The input file contains the video socket stream exactly as sent by the
+// server: packets prefixed by the 20-byte frame meta header (see
+// stream_recv_packet()). It may be captured from a server started manually in
+// forward mode, by skipping the dummy byte and the 68-byte device meta:
+//
+//     nc localhost 27183 | tail -c +70 > capture.bin
+//
+// The packets are sent over a local TCP socket by a "synthetic server"
+// thread, at the rate given by their PTS (or at a fixed rate, or as fast as
+// possible), and received by the actual stream.
+
+// for portability (getrusage, getsockname)
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <libavformat/avformat.h>
+#include <libavutil/time.h>
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+
+#include "config.h"
+#include "compat.h"
+#include "decoder.h"
+#include "events.h"
+#include "fps_counter.h"
+#include "metrics.h"
+#include "screen.h"
+#include "stream.h"
+#include "video_buffer.h"
+#include "util/buffer_util.h"
+#include "util/log.h"
+#include "util/net.h"
+
+#define HEADER_SIZE 20
+#define NO_PTS UINT64_C(-1)
+#define PTS_MASK ((UINT64_C(1) << 62) - 1)
+
+#define IPV4_LOCALHOST 0x7F000001
+
+struct bench_args {
+    const char *filename;
+    unsigned fps; // 0 to follow the PTS
+    bool unpaced; // send as fast as possible
+    unsigned loops;
+    bool display;
+    unsigned decoder_threads;
+};
+
+struct capture {
+    uint8_t *data;
+    size_t size;
+    unsigned packet_count;
+    uint64_t first_pts; // NO_PTS if there is no data packet
+    uint64_t last_pts;
+};
+
+struct feeder {
+    const struct capture *capture;
+    const struct bench_args *args;
+    socket_t socket;
+    SDL_Thread *thread;
+    unsigned sent;
+};
+
+static void
+print_usage(const char *arg0) {
+    fprintf(stderr,
+        "Usage: %s [options] file\n"
+        "\n"
+        "Replay a captured video stream (frame meta headers followed by\n"
+        "H.264 packets) into the client pipeline, and report the\n"
+        "throughput, the latency of each stage and the CPU usage.\n"
+        "\n"
+        "Options:\n"
+        "\n"
+        "    --decoder-threads value\n"
+        "        Number of decoder threads (default is automatic).\n"
+        "\n"
+        "    --fps value\n"
+        "        Send the packets at a fixed rate, instead of following\n"
+        "        their PTS.\n"
+        "\n"
+        "    --loops value\n"
+        "        Replay the capture several times (it should start with a\n"
+        "        config packet and a key frame). Default is 1.\n"
+        "\n"
+        "    -N, --no-display\n"
+        "        Do not render the frames (the pipeline stops at the video\n"
+        "        buffer).\n"
+        "\n"
+        "    --unpaced\n"
+        "        Send the packets as fast as possible.\n"
+        "\n",
+        arg0);
+}
+
+static bool
+parse_unsigned(const char *s, unsigned min, unsigned max, const char *name,
+               unsigned *out) {
+    char *endptr;
+    long value = strtol(s, &endptr, 0);
+    if (*s == '\0' || *endptr != '\0' || value < min || value > max) {
+        LOGE("Invalid %s: %s (expected %u to %u)", name, s, min, max);
+        return false;
+    }
+    *out = (unsigned) value;
+    return true;
+}
+
+static bool
+parse_args(struct bench_args *args, int argc, char *argv[]) {
+    enum {
+        OPT_DECODER_THREADS = 1000,
+        OPT_FPS,
+        OPT_LOOPS,
+        OPT_UNPACED,
+    };
+    static const struct option long_options[] = {
+        {"decoder-threads", required_argument, NULL, OPT_DECODER_THREADS},
+        {"fps",             required_argument, NULL, OPT_FPS},
+        {"loops",           required_argument, NULL, OPT_LOOPS},
+        {"no-display",      no_argument,       NULL, 'N'},
+        {"unpaced",         no_argument,       NULL, OPT_UNPACED},
+        {NULL,              0,                 NULL, 0  },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "N", long_options, NULL)) != -1) {
+        switch (c) {
+            case OPT_DECODER_THREADS:
+                if (!parse_unsigned(optarg, 0, 16, "decoder threads",
+                                    &args->decoder_threads)) {
+                    return false;
+                }
+                break;
+            case OPT_FPS:
+                if (!parse_unsigned(optarg, 1, 1000, "fps", &args->fps)) {
+                    return false;
+                }
+                break;
+            case OPT_LOOPS:
+                if (!parse_unsigned(optarg, 1, 1000, "loops", &args->loops)) {
+                    return false;
+                }
+                break;
+            case 'N':
+                args->display = false;
+                break;
+            case OPT_UNPACED:
+                args->unpaced = true;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (optind != argc - 1) {
+        return false;
+    }
+    args->filename = argv[optind];
+    return true;
+}
+
+// load the whole capture in memory, so that the disk does not disturb the
+// measures, and check its framing
+static bool
+capture_load(struct capture *capture, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        LOGE("Could not open %s", filename);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        LOGE("Empty capture: %s", filename);
+        fclose(file);
+        return false;
+    }
+
+    capture->data = malloc(size);
+    if (!capture->data) {
+        LOGC("Could not allocate capture");
+        fclose(file);
+        return false;
+    }
+
+    size_t r = fread(capture->data, 1, size, file);
+    fclose(file);
+    if (r != (size_t) size) {
+        LOGE("Could not read %s", filename);
+        free(capture->data);
+        return false;
+    }
+    capture->size = size;
+
+    capture->packet_count = 0;
+    capture->first_pts = NO_PTS;
+    capture->last_pts = NO_PTS;
+    size_t offset = 0;
+    while (offset + HEADER_SIZE <= capture->size) {
+        uint64_t pts = buffer_read64be(&capture->data[offset]);
+        uint32_t len = buffer_read32be(&capture->data[offset + 16]);
+        if (!len || offset + HEADER_SIZE + len > capture->size) {
+            break;
+        }
+        if (pts != NO_PTS) {
+            pts &= PTS_MASK;
+            if (capture->first_pts == NO_PTS) {
+                capture->first_pts = pts;
+            }
+            capture->last_pts = pts;
+        }
+        ++capture->packet_count;
+        offset += HEADER_SIZE + len;
+    }
+
+    if (offset != capture->size) {
+        // a truncated capture is still usable
+        LOGW("Invalid framing at offset %" PRIu64 ", ignoring the end of the "
+             "capture", (uint64_t) offset);
+        capture->size = offset;
+    }
+
+    if (capture->first_pts == NO_PTS) {
+        LOGE("No video packet in %s", filename);
+        free(capture->data);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+wait_until(int64_t deadline) {
+    int64_t delay = deadline - av_gettime_relative();
+    if (delay > 0) {
+        av_usleep(delay);
+    }
+}
+
+static int
+run_feeder(void *data) {
+    struct feeder *feeder = data;
+    const struct capture *capture = feeder->capture;
+    const struct bench_args *args = feeder->args;
+
+    // the PTS continue to increase from one loop to the next
+    uint64_t period = args->fps ? 1000000 / args->fps : 16666;
+    uint64_t loop_duration = capture->last_pts - capture->first_pts + period;
+
+    uint8_t header[HEADER_SIZE];
+    int64_t start = av_gettime_relative();
+    unsigned index = 0;
+    for (unsigned loop = 0; loop < args->loops; ++loop) {
+        size_t offset = 0;
+        while (offset < capture->size) {
+            const uint8_t *packet = &capture->data[offset];
+            uint64_t pts = buffer_read64be(packet);
+            uint32_t len = buffer_read32be(&packet[16]);
+            memcpy(header, packet, HEADER_SIZE);
+
+            if (pts != NO_PTS) {
+                uint64_t flags = pts & ~PTS_MASK;
+                uint64_t relative = (pts & PTS_MASK) - capture->first_pts
+                                  + loop * loop_duration;
+                buffer_write64be(header, (capture->first_pts + relative)
+                                         | flags);
+                if (args->fps) {
+                    wait_until(start + (int64_t) index * period);
+                } else if (!args->unpaced) {
+                    wait_until(start + (int64_t) relative);
+                }
+                ++index;
+            }
+
+            if (net_send_all(feeder->socket, header, HEADER_SIZE) < 0
+                    || net_send_all(feeder->socket, &packet[HEADER_SIZE],
+                                    len) < 0) {
+                LOGE("Could not send packet");
+                goto end;
+            }
+            ++feeder->sent;
+            offset += HEADER_SIZE + len;
+        }
+    }
+
+end:
+    // the stream will detect the end of stream
+    net_shutdown(feeder->socket, SHUT_WR);
+    return 0;
+}
+
+// connect a pair of sockets over the loopback interface
+static bool
+connect_local_sockets(socket_t *server_socket, socket_t *client_socket) {
+    socket_t listener = net_listen(IPV4_LOCALHOST, 0, 1);
+    if (listener == INVALID_SOCKET) {
+        LOGE("Could not listen on localhost");
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(listener, (struct sockaddr *) &addr, &addrlen)) {
+        LOGE("Could not get the listening port");
+        net_close(listener);
+        return false;
+    }
+
+    *client_socket = net_connect(IPV4_LOCALHOST, ntohs(addr.sin_port));
+    if (*client_socket == INVALID_SOCKET) {
+        LOGE("Could not connect to localhost");
+        net_close(listener);
+        return false;
+    }
+
+    *server_socket = net_accept(listener);
+    net_close(listener);
+    if (*server_socket == INVALID_SOCKET) {
+        LOGE("Could not accept connection");
+        net_close(*client_socket);
+        return false;
+    }
+
+    return true;
+}
+
+static double
+get_cpu_time(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// process the events until the end of the stream
+// return the number of frames consumed
+static unsigned
+event_loop(struct screen *screen, struct video_buffer *vb, bool display) {
+    unsigned frames = 0;
+    SDL_Event event;
+    while (SDL_WaitEvent(&event)) {
+        switch (event.type) {
+            case SDL_QUIT:
+                LOGI("Interrupted");
+                return frames;
+            case EVENT_STREAM_STOPPED:
+                return frames;
+            case EVENT_NEW_FRAME:
+                if (!display) {
+                    if (video_buffer_consume_rendered_frame(vb)) {
+                        latency_stats_add_frame(&vb->latency_stats,
+                                                &vb->rendering_times,
+                                                av_gettime_relative());
+                        video_buffer_release_rendered_frame(vb);
+                        ++frames;
+                    }
+                    break;
+                }
+                if (!screen->has_frame) {
+                    screen->has_frame = true;
+                    screen_show_window(screen);
+                }
+                if (screen_update_frame(screen, vb)) {
+                    ++frames;
+                }
+                break;
+            case SDL_WINDOWEVENT:
+                if (display) {
+                    screen_handle_window_event(screen, &event.window);
+                }
+                break;
+        }
+    }
+    return frames;
+}
+
+static bool
+run_bench(const struct bench_args *args, const struct capture *capture) {
+    bool ret = false;
+
+    socket_t server_socket;
+    socket_t client_socket;
+    if (!connect_local_sockets(&server_socket, &client_socket)) {
+        return false;
+    }
+
+    struct metrics metrics;
+    metrics_init(&metrics);
+
+    struct fps_counter fps_counter;
+    fps_counter_init(&fps_counter, &metrics);
+
+    struct video_buffer vb;
+    if (!video_buffer_init(&vb, &fps_counter, &metrics, false, 3)) {
+        goto close_sockets;
+    }
+
+    struct screen screen;
+    screen_init(&screen);
+    if (args->display) {
+        // the window is resized on the first frame
+        struct size size = {1280, 720};
+        struct screen_params params = {
+            .window_title = "scrcpy-bench",
+            .window_x = SC_WINDOW_POSITION_UNDEFINED,
+            .window_y = SC_WINDOW_POSITION_UNDEFINED,
+            .mipmaps = true,
+        };
+        if (!screen_init_rendering(&screen, &params)) {
+            goto destroy_video_buffer;
+        }
+        screen_init_content(&screen, "scrcpy-bench", size, 0, 0, 0);
+    }
+
+    struct decoder decoder;
+    decoder_init(&decoder, &vb, NULL, NULL, SC_HW_DECODER_NONE,
+                 args->decoder_threads, SC_DECODER_THREAD_TYPE_SLICE, NULL);
+
+    struct stream stream;
+    stream_init(&stream, client_socket, AV_CODEC_ID_H264, &decoder, NULL,
+                NULL, NULL, NULL, &metrics, false, 0);
+
+    struct feeder feeder = {
+        .capture = capture,
+        .args = args,
+        .socket = server_socket,
+        .sent = 0,
+    };
+
+    double cpu_start = get_cpu_time();
+    int64_t start = av_gettime_relative();
+
+    if (!stream_start(&stream)) {
+        goto destroy_screen;
+    }
+
+    feeder.thread = SDL_CreateThread(run_feeder, "feeder", &feeder);
+    if (!feeder.thread) {
+        LOGC("Could not start feeder thread");
+        stream_stop(&stream);
+        net_shutdown(client_socket, SHUT_RDWR);
+        stream_join(&stream);
+        goto destroy_screen;
+    }
+
+    unsigned frames = event_loop(&screen, &vb, args->display);
+
+    int64_t elapsed = av_gettime_relative() - start;
+    double cpu = get_cpu_time() - cpu_start;
+
+    stream_stop(&stream);
+    net_shutdown(client_socket, SHUT_RDWR);
+    stream_join(&stream);
+    SDL_WaitThread(feeder.thread, NULL);
+
+    double seconds = elapsed / 1e6;
+    LOGI("Packets sent:    %u (%" PRIu64 " bytes received)", feeder.sent,
+         (uint64_t) atomic_load(&metrics.received_bytes));
+    LOGI("Frames rendered: %u in %.3f s (%.1f fps)", frames, seconds,
+         seconds > 0 ? frames / seconds : 0);
+    LOGI("Frames skipped:  %" PRIu64,
+         (uint64_t) atomic_load(&metrics.skipped_frames));
+    LOGI("CPU time:        %.3f s (%.1f%% of one core)", cpu,
+         seconds > 0 ? 100 * cpu / seconds : 0);
+    latency_stats_log(&vb.latency_stats);
+
+    ret = true;
+
+destroy_screen:
+    if (args->display) {
+        screen_destroy(&screen);
+    }
+destroy_video_buffer:
+    video_buffer_destroy(&vb);
+close_sockets:
+    net_close(server_socket);
+    net_close(client_socket);
+
+    return ret;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct bench_args args = {
+        .filename = NULL,
+        .fps = 0,
+        .unpaced = false,
+        .loops = 1,
+        .display = true,
+        .decoder_threads = 0,
+    };
+
+    if (!parse_args(&args, argc, argv)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
+
+    // on interruption, the feeder may write to a closed socket
+    signal(SIGPIPE, SIG_IGN);
+
+#ifdef SCRCPY_LAVF_REQUIRES_REGISTER_ALL
+    av_register_all();
+#endif
+
+    struct capture capture;
+    if (!capture_load(&capture, args.filename)) {
+        return 1;
+    }
+    LOGI("Capture: %u packets, %.3f s", capture.packet_count,
+         (capture.last_pts - capture.first_pts) / 1e6);
+
+    int res = 1;
+    uint32_t flags = args.display ? SDL_INIT_VIDEO : SDL_INIT_EVENTS;
+    if (SDL_Init(flags)) {
+        LOGC("Could not initialize SDL: %s", SDL_GetError());
+        goto free_capture;
+    }
+
+    if (!net_init()) {
+        goto quit_sdl;
+    }
+
+    res = run_bench(&args, &capture) ? 0 : 1;
+
+    net_cleanup();
+quit_sdl:
+    SDL_Quit();
+free_capture:
+    free(capture.data);
+
+    return res;
+}
@@ -0,0 +1,305 @@
+// Microbenchmarks of the serialization and queue primitives.
+//
+// Each benchmark is run with an increasing number of iterations until it
+// lasts at least MIN_DURATION, then its result is printed on stdout as a JSON
+// object per line (JSON Lines), to be tracked over time:
+//
+//     {"name":"control_msg_serialize/touch","iterations":4194304,
+//      "ns_per_op":21.3,"ops_per_sec":46948356}
+//
+// An optional argument filters the benchmarks by name (substring).
+//
+// To benchmark a new primitive (or an alternative implementation), add a
+// function to the benchmarks table.
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "config.h"
+#include "common.h"
+#include "control_msg.h"
+#include "device_msg.h"
+#include "util/buffer_util.h"
+#include "util/cbuf.h"
+
+// in seconds
+#define MIN_DURATION 0.2
+
+// prevent the compiler from optimizing the benchmarked code away
+static volatile uint64_t sink;
+
+struct benchmark {
+    const char *name;
+    void (*run)(uint64_t iterations);
+};
+
+static void
+bench_serialize_touch(uint64_t iterations) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = 0x1234567887654321L,
+            .position = {
+                .point = {.x = 100, .y = 200},
+                .screen_size = {.width = 1080, .height = 1920},
+            },
+            .pressure = 1.0f,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        msg.inject_touch_event.position.point.x = i & 0x3ff;
+        total += control_msg_serialize(&msg, buf);
+    }
+    sink = total + buf[0];
+}
+
+static void
+bench_serialize_touch_compact(uint64_t iterations) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = 0,
+            .position = {
+                .point = {.x = 100, .y = 200},
+                .screen_size = {.width = 1080, .height = 1920},
+            },
+            .pressure = 1.0f,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+
+    struct control_msg_compact_state state;
+    control_msg_compact_state_init(&state);
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        // a mouse drag, small deltas
+        msg.inject_touch_event.position.point.x = 100 + (i & 0x3f);
+        total += control_msg_serialize_compact(&msg, &state, buf);
+    }
+    sink = total + buf[0];
+}
+
+static void
+bench_serialize_text(uint64_t iterations) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_INJECT_TEXT,
+        .inject_text = {
+            .text = "The quick brown fox jumps over the lazy dog",
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        total += control_msg_serialize(&msg, buf);
+    }
+    sink = total + buf[0];
+}
+
+static void
+bench_deserialize_pong(uint64_t iterations) {
+    unsigned char buf[25];
+    buf[0] = DEVICE_MSG_TYPE_PONG;
+    buffer_write64be(&buf[1], 0x0102030405060708);
+    buffer_write64be(&buf[9], 0x1112131415161718);
+    buffer_write64be(&buf[17], 0x2122232425262728);
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct device_msg msg;
+        ssize_t r = device_msg_deserialize(buf, sizeof(buf), &msg);
+        total += r + msg.pong.pong_sent;
+    }
+    sink = total;
+}
+
+static void
+bench_deserialize_clipboard(uint64_t iterations) {
+    static const char text[] = "The quick brown fox jumps over the lazy dog";
+    unsigned char buf[5 + sizeof(text) - 1];
+    buf[0] = DEVICE_MSG_TYPE_CLIPBOARD;
+    buffer_write32be(&buf[1], sizeof(text) - 1);
+    memcpy(&buf[5], text, sizeof(text) - 1);
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct device_msg msg;
+        ssize_t r = device_msg_deserialize(buf, sizeof(buf), &msg);
+        total += r + msg.clipboard.text[0];
+        device_msg_destroy(&msg);
+    }
+    sink = total;
+}
+
+static void
+bench_buffer_write_read(uint64_t iterations) {
+    uint8_t buf[14];
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        buffer_write16be(buf, i);
+        buffer_write32be(&buf[2], i);
+        buffer_write64be(&buf[6], i);
+        total += buffer_read16be(buf) + buffer_read32be(&buf[2])
+               + buffer_read64be(&buf[6]);
+    }
+    sink = total;
+}
+
+static void
+bench_buffer_varint(uint64_t iterations) {
+    uint8_t buf[10];
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        // mostly small values (deltas), sometimes larger ones
+        uint64_t value = i & 0xff ? i & 0x7f : i;
+        total += buffer_write_varint(buf, value);
+    }
+    sink = total + buf[0];
+}
+
+struct int_cbuf CBUF(uint64_t, 64);
+
+static void
+bench_cbuf(uint64_t iterations) {
+    struct int_cbuf cbuf;
+    cbuf_init(&cbuf);
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t item;
+        cbuf_push(&cbuf, i);
+        cbuf_take(&cbuf, &item);
+        total += item;
+    }
+    sink = total;
+}
+
+// a cbuf protected by a mutex, as used between threads (for example by the
+// file handler)
+struct locked_cbuf {
+    SDL_mutex *mutex;
+    SDL_cond *cond; // signaled on push and on take
+    struct int_cbuf cbuf;
+    uint64_t iterations;
+};
+
+static int
+run_cbuf_consumer(void *data) {
+    struct locked_cbuf *lc = data;
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < lc->iterations; ++i) {
+        uint64_t item;
+        SDL_LockMutex(lc->mutex);
+        while (!cbuf_take(&lc->cbuf, &item)) {
+            SDL_CondWait(lc->cond, lc->mutex);
+        }
+        SDL_CondSignal(lc->cond);
+        SDL_UnlockMutex(lc->mutex);
+        total += item;
+    }
+    sink = total;
+    return 0;
+}
+
+static void
+bench_cbuf_contention(uint64_t iterations) {
+    struct locked_cbuf lc;
+    lc.mutex = SDL_CreateMutex();
+    lc.cond = SDL_CreateCond();
+    if (!lc.mutex || !lc.cond) {
+        fprintf(stderr, "Could not create mutex\n");
+        exit(1);
+    }
+    lc.iterations = iterations;
+    cbuf_init(&lc.cbuf);
+
+    SDL_Thread *consumer = SDL_CreateThread(run_cbuf_consumer, "consumer",
+                                            &lc);
+    if (!consumer) {
+        fprintf(stderr, "Could not create thread\n");
+        exit(1);
+    }
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        SDL_LockMutex(lc.mutex);
+        while (!cbuf_push(&lc.cbuf, i)) {
+            SDL_CondWait(lc.cond, lc.mutex);
+        }
+        SDL_CondSignal(lc.cond);
+        SDL_UnlockMutex(lc.mutex);
+    }
+
+    SDL_WaitThread(consumer, NULL);
+    SDL_DestroyCond(lc.cond);
+    SDL_DestroyMutex(lc.mutex);
+}
+
+static const struct benchmark benchmarks[] = {
+    {"control_msg_serialize/touch", bench_serialize_touch},
+    {"control_msg_serialize/touch_compact", bench_serialize_touch_compact},
+    {"control_msg_serialize/text", bench_serialize_text},
+    {"device_msg_deserialize/pong", bench_deserialize_pong},
+    {"device_msg_deserialize/clipboard", bench_deserialize_clipboard},
+    {"buffer_util/write_read", bench_buffer_write_read},
+    {"buffer_util/varint", bench_buffer_varint},
+    {"cbuf/push_take", bench_cbuf},
+    {"cbuf/contention", bench_cbuf_contention},
+};
+
+static double
+get_time(void) {
+    return (double) SDL_GetPerformanceCounter()
+         / SDL_GetPerformanceFrequency();
+}
+
+static void
+run_benchmark(const struct benchmark *bench) {
+    uint64_t iterations = 1024;
+    double duration;
+    for (;;) {
+        double start = get_time();
+        bench->run(iterations);
+        duration = get_time() - start;
+        if (duration >= MIN_DURATION || iterations >= (UINT64_C(1) << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double ns_per_op = duration * 1e9 / iterations;
+    printf("{\"name\":\"%s\",\"iterations\":%" PRIu64 ",\"ns_per_op\":%.2f,"
+           "\"ops_per_sec\":%.0f}\n", bench->name, iterations, ns_per_op,
+           iterations / duration);
+}
+
+int
+main(int argc, char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+
+    if (SDL_Init(0)) {
+        fprintf(stderr, "Could not initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    for (size_t i = 0; i < ARRAY_LEN(benchmarks); ++i) {
+        const struct benchmark *bench = &benchmarks[i];
+        if (!filter || strstr(bench->name, filter)) {
+            run_benchmark(bench);
+        }
+    }
+
+    SDL_Quit();
+    return 0;
+}
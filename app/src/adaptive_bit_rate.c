@@ -0,0 +1,96 @@
+#include "adaptive_bit_rate.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include "util/log.h"
+
+#define WINDOW_DURATION 500000 // us
+#define HOLD_DURATION 1000000 // us
+#define CONGESTION_DELAY 50000 // us
+#define UNCONGESTED_DELAY 20000 // us
+
+void
+adaptive_bit_rate_init(struct adaptive_bit_rate *abr, uint32_t max_bit_rate) {
+    abr->max_bit_rate = max_bit_rate;
+    abr->min_bit_rate = max_bit_rate / 16;
+    abr->bit_rate = max_bit_rate;
+    abr->base_delay = INT64_MAX;
+    abr->hold_until = 0;
+    abr->window_start = 0;
+    abr->window_bytes = 0;
+    abr->window_delay_sum = 0;
+    abr->window_packets = 0;
+}
+
+static bool
+update_bit_rate(struct adaptive_bit_rate *abr, int64_t now) {
+    if (now < abr->hold_until) {
+        return false;
+    }
+
+    int64_t duration = now - abr->window_start;
+    uint64_t throughput = abr->window_bytes * 8 * 1000000 / duration;
+    int64_t queue_delay = abr->window_delay_sum / abr->window_packets
+                        - abr->base_delay;
+
+    uint32_t bit_rate = abr->bit_rate;
+    if (queue_delay > CONGESTION_DELAY) {
+        bit_rate = (uint64_t) bit_rate * 3 / 4;
+        if (bit_rate < abr->min_bit_rate) {
+            bit_rate = abr->min_bit_rate;
+        }
+        abr->hold_until = now + HOLD_DURATION;
+    } else if (queue_delay < UNCONGESTED_DELAY
+            && throughput > abr->bit_rate / 2) {
+        uint32_t step = abr->max_bit_rate / 16;
+        bit_rate = abr->max_bit_rate - bit_rate > step ? bit_rate + step
+                                                       : abr->max_bit_rate;
+    }
+
+    if (bit_rate == abr->bit_rate) {
+        return false;
+    }
+
+    LOGD("Bit rate: %" PRIu32 " -> %" PRIu32 " (throughput=%" PRIu64
+         ", queue delay=%" PRIi64 "us)", abr->bit_rate, bit_rate, throughput,
+         queue_delay);
+    abr->bit_rate = bit_rate;
+    return true;
+}
+
+bool
+adaptive_bit_rate_add_packet(struct adaptive_bit_rate *abr, size_t size,
+                             int64_t capture_time, int64_t recv_time) {
+    if (!capture_time) {
+        // the clocks are not synchronized yet
+        return false;
+    }
+
+    int64_t delay = recv_time - capture_time;
+    if (delay < abr->base_delay) {
+        abr->base_delay = delay;
+    }
+
+    if (!abr->window_start) {
+        abr->window_start = recv_time;
+    }
+
+    abr->window_bytes += size;
+    abr->window_delay_sum += delay;
+    ++abr->window_packets;
+
+    if (recv_time - abr->window_start < WINDOW_DURATION) {
+        return false;
+    }
+
+    bool changed = update_bit_rate(abr, recv_time);
+
+    // start a new window
+    abr->window_start = recv_time;
+    abr->window_bytes = 0;
+    abr->window_delay_sum = 0;
+    abr->window_packets = 0;
+
+    return changed;
+}
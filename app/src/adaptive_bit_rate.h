@@ -0,0 +1,54 @@
+#ifndef ADAPTIVE_BIT_RATE_H
+#define ADAPTIVE_BIT_RATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Adapt the encoder bit rate to the network conditions
+//
+// The policy is AIMD (additive increase, multiplicative decrease), evaluated
+// on the packets received during windows of 500ms:
+//  - the queue delay is the average delay between capture and reception,
+//    minus the lowest delay ever observed (the part which does not depend on
+//    the amount of data in flight);
+//  - if the queue delay exceeds 50ms, the socket is backing up: the bit rate
+//    is multiplied by 3/4, then no decision is taken for 1 second, to let the
+//    queue drain;
+//  - if the queue delay is below 20ms, and the encoder actually produced more
+//    than half the current bit rate (a static screen gives no information
+//    about the network capacity), the bit rate is increased by 1/16 of the
+//    maximum bit rate;
+//  - the bit rate is kept between 1/16 of the maximum and the maximum (the
+//    initial value).
+//
+// The delays require the clocks to be synchronized: packets without capture
+// time are ignored.
+struct adaptive_bit_rate {
+    uint32_t max_bit_rate;
+    uint32_t min_bit_rate;
+    uint32_t bit_rate; // the current target
+
+    int64_t base_delay; // lowest capture-to-reception delay observed
+    int64_t hold_until; // no decision before this time
+
+    // current window
+    int64_t window_start; // 0 if no window is started
+    uint64_t window_bytes;
+    int64_t window_delay_sum;
+    unsigned window_packets;
+};
+
+void
+adaptive_bit_rate_init(struct adaptive_bit_rate *abr, uint32_t max_bit_rate);
+
+// Record a received packet (times in microseconds, in the local clock)
+//
+// Return true if the bit rate must be changed to abr->bit_rate.
+bool
+adaptive_bit_rate_add_packet(struct adaptive_bit_rate *abr, size_t size,
+                             int64_t capture_time, int64_t recv_time);
+
+#endif
@@ -0,0 +1,155 @@
+#include "annexb_input.h"
+
+#include <string.h>
+#include <libavutil/error.h>
+
+#include "config.h"
+#include "h264_nal.h"
+#include "util/log.h"
+
+// avio reads directly into the splitter buffer when more than its own buffer
+// size is requested
+#define READ_SIZE 0x40000
+
+// do not wait forever for an SPS if the input is not H.264
+#define PROBE_MAX_SIZE (16 * 1024 * 1024)
+
+static int
+interrupt_cb(void *opaque) {
+    struct annexb_input *input = opaque;
+    return atomic_load_explicit(&input->interrupted, memory_order_relaxed);
+}
+
+bool
+annexb_input_open(struct annexb_input *input, const char *url) {
+    atomic_init(&input->interrupted, false);
+    input->eof = false;
+    input->has_pending = false;
+
+    if (!strcmp(url, "-")) {
+        url = "pipe:0";
+    }
+
+    const AVIOInterruptCB int_cb = {
+        .callback = interrupt_cb,
+        .opaque = input,
+    };
+    // avio handles UTF-8 file names on all platforms
+    if (avio_open2(&input->avio, url, AVIO_FLAG_READ, &int_cb, NULL) < 0) {
+        LOGE("Could not open input: %s", url);
+        return false;
+    }
+
+    annexb_splitter_init(&input->splitter);
+    return true;
+}
+
+void
+annexb_input_close(struct annexb_input *input) {
+    avio_closep(&input->avio);
+    annexb_splitter_destroy(&input->splitter);
+}
+
+// read the next unit from the stream (ignoring the pending one)
+static bool
+read_unit(struct annexb_input *input, struct annexb_unit *unit) {
+    for (;;) {
+        if (annexb_splitter_next(&input->splitter, unit)) {
+            return true;
+        }
+
+        if (input->eof) {
+            return annexb_splitter_flush(&input->splitter, unit);
+        }
+
+        uint8_t *buf = annexb_splitter_reserve(&input->splitter, READ_SIZE);
+        if (!buf) {
+            return false;
+        }
+
+        int r = avio_read_partial(input->avio, buf, READ_SIZE);
+        if (r == AVERROR_EOF) {
+            LOGD("End of input");
+            input->eof = true;
+        } else if (r < 0) {
+            if (!atomic_load_explicit(&input->interrupted,
+                                      memory_order_relaxed)) {
+                LOGE("Could not read input");
+            }
+            return false;
+        } else {
+            annexb_splitter_commit(&input->splitter, r);
+        }
+    }
+}
+
+static bool
+parse_frame_size(const struct annexb_unit *unit, struct size *frame_size) {
+    size_t offset = 0;
+    for (;;) {
+        offset += h264_find_nal(unit->data + offset, unit->size - offset);
+        if (offset >= unit->size) {
+            return false;
+        }
+
+        if (H264_NAL_TYPE(unit->data[offset]) == H264_NAL_SPS) {
+            // the trailing start code bytes, if any, are ignored
+            size_t len = unit->size - offset;
+            len = h264_find_nal(unit->data + offset, len);
+            unsigned width;
+            unsigned height;
+            if (!h264_parse_sps_size(unit->data + offset, len, &width,
+                                     &height)) {
+                LOGW("Invalid SPS ignored");
+                return false;
+            }
+            if (width > 0xFFFF || height > 0xFFFF) {
+                return false;
+            }
+            frame_size->width = width;
+            frame_size->height = height;
+            return true;
+        }
+    }
+}
+
+bool
+annexb_input_read_frame_size(struct annexb_input *input,
+                             struct size *frame_size) {
+    uint64_t read = 0;
+    struct annexb_unit unit;
+    while (read < PROBE_MAX_SIZE) {
+        if (!read_unit(input, &unit)) {
+            break;
+        }
+        read += unit.size;
+
+        if (unit.config && parse_frame_size(&unit, frame_size)) {
+            LOGI("Input: %ux%u", frame_size->width, frame_size->height);
+            // the splitter buffer is not touched until the next read, this
+            // unit is still valid
+            input->pending = unit;
+            input->has_pending = true;
+            return true;
+        }
+    }
+
+    LOGE("No H.264 SPS found in the input");
+    return false;
+}
+
+bool
+annexb_input_read(struct annexb_input *input, struct annexb_unit *unit) {
+    if (input->has_pending) {
+        *unit = input->pending;
+        input->has_pending = false;
+        return true;
+    }
+
+    return read_unit(input, unit);
+}
+
+void
+annexb_input_interrupt(struct annexb_input *input) {
+    atomic_store_explicit(&input->interrupted, true, memory_order_relaxed);
+}
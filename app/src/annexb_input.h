@@ -0,0 +1,52 @@
+#ifndef ANNEXB_INPUT_H
+#define ANNEXB_INPUT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <libavformat/avio.h>
+
+#include "config.h"
+#include "annexb_splitter.h"
+#include "common.h"
+
+// A raw H.264 Annex B stream read from a file, a pipe ("-" for stdin) or any
+// URL supported by FFmpeg (--input), in place of the video socket of a device
+//
+// The stream contains no timestamps: the units are timestamped on reception,
+// so the input is expected to be produced in real time (typically piped from
+// a live source).
+struct annexb_input {
+    AVIOContext *avio;
+    struct annexb_splitter splitter;
+    atomic_bool interrupted;
+    bool eof;
+    // the config unit read by annexb_input_read_frame_size(), not returned
+    // yet
+    bool has_pending;
+    struct annexb_unit pending;
+};
+
+bool
+annexb_input_open(struct annexb_input *input, const char *url);
+
+void
+annexb_input_close(struct annexb_input *input);
+
+// read the stream until the first SPS, to get the frame size
+// the units before it are dropped (they could not be decoded)
+bool
+annexb_input_read_frame_size(struct annexb_input *input,
+                             struct size *frame_size);
+
+// read the next unit, valid until the next call
+// return false at the end of the stream or on error
+bool
+annexb_input_read(struct annexb_input *input, struct annexb_unit *unit);
+
+// interrupt a blocking read (a read from a pipe is only interrupted once more
+// data is received)
+// may be called from any thread
+void
+annexb_input_interrupt(struct annexb_input *input);
+
+#endif
@@ -0,0 +1,176 @@
+#include "annexb_splitter.h"
+
+#include <assert.h>
+#include <string.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "config.h"
+#include "h264_nal.h"
+#include "util/log.h"
+
+void
+annexb_splitter_init(struct annexb_splitter *splitter) {
+    splitter->data = NULL;
+    splitter->capacity = 0;
+    splitter->begin = 0;
+    splitter->end = 0;
+    splitter->scan = 0;
+    splitter->started = false;
+    splitter->has_slice = false;
+    splitter->has_param_set = false;
+}
+
+void
+annexb_splitter_destroy(struct annexb_splitter *splitter) {
+    SDL_free(splitter->data);
+}
+
+uint8_t *
+annexb_splitter_reserve(struct annexb_splitter *splitter, size_t len) {
+    if (splitter->capacity - splitter->end >= len) {
+        return &splitter->data[splitter->end];
+    }
+
+    if (splitter->begin) {
+        // move the current unit to the start of the buffer (only the
+        // incomplete one remains, the previous ones have been returned)
+        size_t size = splitter->end - splitter->begin;
+        memmove(splitter->data, &splitter->data[splitter->begin], size);
+        splitter->scan -= splitter->begin;
+        splitter->end = size;
+        splitter->begin = 0;
+        if (splitter->capacity - splitter->end >= len) {
+            return &splitter->data[splitter->end];
+        }
+    }
+
+    if (splitter->end + len > ANNEXB_SPLITTER_MAX_SIZE) {
+        LOGE("Access unit too large (no start code found)");
+        return NULL;
+    }
+
+    size_t capacity = splitter->capacity ? splitter->capacity * 2 : len;
+    if (capacity < splitter->end + len) {
+        capacity = splitter->end + len;
+    }
+    uint8_t *data = SDL_realloc(splitter->data, capacity);
+    if (!data) {
+        LOGC("Could not allocate access unit buffer");
+        return NULL;
+    }
+    splitter->data = data;
+    splitter->capacity = capacity;
+
+    return &splitter->data[splitter->end];
+}
+
+void
+annexb_splitter_commit(struct annexb_splitter *splitter, size_t len) {
+    assert(splitter->end + len <= splitter->capacity);
+    splitter->end += len;
+}
+
+static inline bool
+is_slice(uint8_t type) {
+    return type == H264_NAL_SLICE || type == H264_NAL_IDR_SLICE;
+}
+
+// tell whether a NAL unit of this type following a slice starts a new access
+// unit (H.264 7.4.1.2.3)
+static inline bool
+starts_access_unit(uint8_t type) {
+    return (type >= H264_NAL_SEI && type <= H264_NAL_AUD)
+        || (type >= 14 && type <= 18);
+}
+
+static void
+return_unit(struct annexb_splitter *splitter, size_t end,
+            struct annexb_unit *unit) {
+    unit->data = &splitter->data[splitter->begin];
+    unit->size = end - splitter->begin;
+    unit->config = !splitter->has_slice;
+    splitter->begin = end;
+    splitter->has_slice = false;
+    splitter->has_param_set = false;
+}
+
+bool
+annexb_splitter_next(struct annexb_splitter *splitter,
+                     struct annexb_unit *unit) {
+    const uint8_t *data = splitter->data;
+    size_t end = splitter->end;
+
+    for (;;) {
+        size_t scan = splitter->scan;
+        size_t nal = scan + h264_find_nal(&data[scan], end - scan);
+        if (nal >= end) {
+            // a start code may be split across the reads: search again from
+            // its first byte once more data is received
+            if (end >= 3 && end - 3 > splitter->scan) {
+                splitter->scan = end - 3;
+            }
+            return false;
+        }
+
+        uint8_t type = H264_NAL_TYPE(data[nal]);
+        bool slice = is_slice(type);
+        if (slice && nal + 1 == end) {
+            // first_mb_in_slice is not received yet
+            splitter->scan = nal - 3;
+            return false;
+        }
+
+        // the position of the start code, including the leading zero of a
+        // 4-byte start code
+        size_t start = nal - 3;
+        if (start > splitter->begin && !data[start - 1]) {
+            --start;
+        }
+
+        splitter->scan = nal;
+
+        if (!splitter->started) {
+            // drop the garbage before the first start code
+            splitter->begin = start;
+            splitter->started = true;
+        }
+
+        bool boundary;
+        if (splitter->has_slice) {
+            // a first_mb_in_slice of 0 is encoded as a single '1' bit
+            boundary = starts_access_unit(type)
+                    || (slice && data[nal + 1] & 0x80);
+        } else {
+            // the config unit ends before the first slice
+            boundary = slice && splitter->has_param_set;
+        }
+
+        bool complete = boundary && start > splitter->begin;
+        if (complete) {
+            return_unit(splitter, start, unit);
+        }
+
+        if (slice) {
+            splitter->has_slice = true;
+        } else if (type == H264_NAL_SPS || type == H264_NAL_PPS) {
+            splitter->has_param_set = true;
+        }
+
+        if (complete) {
+            return true;
+        }
+    }
+}
+
+bool
+annexb_splitter_flush(struct annexb_splitter *splitter,
+                      struct annexb_unit *unit) {
+    if (!splitter->has_slice && !splitter->has_param_set) {
+        // nothing decodable
+        return false;
+    }
+
+    return_unit(splitter, splitter->end, unit);
+    splitter->scan = splitter->end;
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef ANNEXB_SPLITTER_H
+#define ANNEXB_SPLITTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// an access unit larger than that is considered corrupted
+#define ANNEXB_SPLITTER_MAX_SIZE (64 * 1024 * 1024)
+
+struct annexb_unit {
+    const uint8_t *data; // valid until the next reserve
+    size_t size;
+    // the unit contains parameter sets (SPS, PPS) but no slice, it must be
+    // prepended to the next one, like the config packets sent by the server
+    bool config;
+};
+
+// Split a raw H.264 Annex B byte stream (as received from a file or a pipe)
+// into access units.
+//
+// The start codes are found by h264_find_nal() (vectorized), only the NAL
+// headers (and the first byte of the slices) are inspected: an access unit
+// ends before the first AUD, SEI, SPS or PPS following a slice, or before a
+// slice starting a new picture (first_mb_in_slice == 0).
+//
+// The parameter sets preceding the first slice of an access unit are
+// returned as a separate config unit.
+//
+// A unit is only returned once the start code of the next one is received
+// (or on flush).
+struct annexb_splitter {
+    uint8_t *data;
+    size_t capacity;
+    size_t begin; // start of the current unit
+    size_t end; // end of the received data
+    size_t scan; // where to search the next start code from
+
+    bool started; // the bytes before the first start code are dropped
+    bool has_slice; // the current unit contains a slice
+    bool has_param_set; // the current unit contains an SPS or a PPS
+};
+
+void
+annexb_splitter_init(struct annexb_splitter *splitter);
+
+void
+annexb_splitter_destroy(struct annexb_splitter *splitter);
+
+// return a buffer to write up to len bytes of the stream, to be committed by
+// annexb_splitter_commit(), or NULL on error
+// the previously returned units are invalidated
+uint8_t *
+annexb_splitter_reserve(struct annexb_splitter *splitter, size_t len);
+
+void
+annexb_splitter_commit(struct annexb_splitter *splitter, size_t len);
+
+// return true if a complete unit is available (written to unit)
+bool
+annexb_splitter_next(struct annexb_splitter *splitter,
+                     struct annexb_unit *unit);
+
+// return the last (incomplete) unit, at the end of the stream
+bool
+annexb_splitter_flush(struct annexb_splitter *splitter,
+                      struct annexb_unit *unit);
+
+#endif
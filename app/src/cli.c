@@ -4,6 +4,7 @@
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "config.h"
@@ -18,6 +19,16 @@ scrcpy_print_usage(const char *arg0) {
         "\n"
         "Options:\n"
         "\n"
+        "    --adaptive-bit-rate\n"
+        "        Adapt the encoding bit-rate to the network conditions, to\n"
+        "        avoid latency increase on slow connections. The --bit-rate\n"
+        "        value is used as a maximum.\n"
+        "\n"
+        "    --adaptive-resolution\n"
+        "        Adapt the video size to the window size: once the window has\n"
+        "        been resized, the device encodes the video at the new window\n"
+        "        size. The --max-size value (if any) is used as a maximum.\n"
+        "\n"
         "    --always-on-top\n"
         "        Make scrcpy window always on top (above other windows).\n"
         "\n"
@@ -35,12 +46,31 @@ scrcpy_print_usage(const char *arg0) {
         "        Android documentation:\n"
         "        <https://d.android.com/reference/android/media/MediaFormat>\n"
         "\n"
+        "    --control-queue-size value\n"
+        "        Set the maximum number of control messages (input events)\n"
+        "        waiting to be sent to the device (between 16 and 65535).\n"
+        "        When the queue is full, the intermediate touch moves are\n"
+        "        merged or dropped, other events replace a queued move (or\n"
+        "        are dropped if there is none).\n"
+        "        Default is 256.\n"
+        "\n"
         "    --crop width:height:x:y\n"
         "        Crop the device screen on the server.\n"
         "        The values are expressed in the device natural orientation\n"
         "        (typically, portrait for a phone, landscape for a tablet).\n"
         "        Any --max-size value is computed on the cropped size.\n"
         "\n"
+        "    --decoder-threads value\n"
+        "        Set the number of threads used to decode the video.\n"
+        "        Default is 0 (automatic).\n"
+        "\n"
+        "    --decoder-thread-type type\n"
+        "        Set the decoder threading mode: \"slice\" decodes the\n"
+        "        slices of a frame in parallel, without adding latency;\n"
+        "        \"frame\" decodes several frames in parallel, at the cost of\n"
+        "        one frame of latency per thread.\n"
+        "        Default is \"slice\".\n"
+        "\n"
         "    --disable-screensaver\n"
         "        Disable screensaver while scrcpy is running.\n"
         "\n"
@@ -53,8 +83,32 @@ scrcpy_print_usage(const char *arg0) {
         "\n"
         "        Default is 0.\n"
         "\n"
+        "    --display-buffer ms\n"
+        "        Hold the decoded frames for the given delay (in\n"
+        "        milliseconds, up to 1000), and present them at their\n"
+        "        capture rhythm, to absorb the network jitter.\n"
+        "        This trades a fixed latency for smoothness (for demos or\n"
+        "        streaming, not for interactive use).\n"
+        "        Default is 0 (disabled: the frames are presented as soon as\n"
+        "        possible).\n"
+        "\n"
         "    --encoder name\n"
-        "        Use a specific MediaCodec encoder (must be a H.264 encoder).\n"
+        "        Use a specific MediaCodec encoder (it must support the\n"
+        "        codec selected by --video-codec).\n"
+        "\n"
+        "    --encoder-profile name\n"
+        "        Tune the encoder for \"latency\" or \"quality\".\n"
+        "        The latency profile requests a realtime priority, a minimal\n"
+        "        encoder latency, no B-frames, and (if the encoder supports\n"
+        "        it) intra refresh instead of periodic key frames. The\n"
+        "        encoders ignore the settings they do not support, the\n"
+        "        accepted ones are logged by the server.\n"
+        "        Default is \"quality\" (the encoder defaults).\n"
+        "\n"
+        "    --file-transfer-workers value\n"
+        "        Set the number of files (dropped on the window) installed or\n"
+        "        pushed in parallel (between 1 and 8).\n"
+        "        Default is 1.\n"
         "\n"
         "    --force-adb-forward\n"
         "        Do not attempt to use \"adb reverse\" to connect to the\n"
@@ -65,12 +119,37 @@ scrcpy_print_usage(const char *arg0) {
         "        middle-click triggers HOME. This option disables these\n"
         "        shortcuts and forward the clicks to the device instead.\n"
         "\n"
+        "    --frame-queue-size value\n"
+        "        Set the number of decoded frames which may be queued for\n"
+        "        rendering (between 2 and 16).\n"
+        "        If the queue is full, the oldest frame is dropped.\n"
+        "        Default is 3.\n"
+        "\n"
         "    -f, --fullscreen\n"
         "        Start in fullscreen.\n"
         "\n"
+        "    --hw-decoder name\n"
+        "        Decode the video using the GPU, and fallback to software\n"
+        "        decoding on failure.\n"
+        "        Possible values are \"auto\", \"vaapi\", \"d3d11va\",\n"
+        "        \"videotoolbox\" and \"cuda\".\n"
+        "        By default, the video is decoded in software.\n"
+        "        The decoded frames are still copied through system memory\n"
+        "        to be displayed.\n"
+        "        10-bit frames (P010) are converted on the CPU to 8 bits per\n"
+        "        sample to be displayed.\n"
+        "\n"
         "    -h, --help\n"
         "        Print this help.\n"
         "\n"
+        "    --input url\n"
+        "        Display (or record) a raw H.264 Annex B stream instead of a\n"
+        "        device: a file, \"-\" for stdin, or any URL supported by\n"
+        "        FFmpeg (for example \"tcp://127.0.0.1:1234?listen\").\n"
+        "        The stream is timestamped on reception, so it must be\n"
+        "        produced in real time (typically piped from a live source).\n"
+        "        Control is disabled.\n"
+        "\n"
         "    --legacy-paste\n"
         "        Inject computer clipboard text as a sequence of key events\n"
         "        on Ctrl+v (like MOD+Shift+v).\n"
@@ -94,6 +173,11 @@ scrcpy_print_usage(const char *arg0) {
         "        is preserved.\n"
         "        Default is %d%s.\n"
         "\n"
+        "    --metrics-port port\n"
+        "        Expose the counters of the session (received bytes, frames,\n"
+        "        queues, latency histograms) over HTTP on localhost, in the\n"
+        "        Prometheus text format: http://localhost:port/metrics\n"
+        "\n"
         "    -n, --no-control\n"
         "        Disable device control (mirror the device in read-only).\n"
         "\n"
@@ -101,6 +185,10 @@ scrcpy_print_usage(const char *arg0) {
         "        Do not display device (only when screen recording is\n"
         "        enabled).\n"
         "\n"
+        "    --no-input-resampling\n"
+        "        Send every mouse motion event to the device, instead of at\n"
+        "        most one per display refresh period of the device.\n"
+        "\n"
         "    --no-key-repeat\n"
         "        Do not forward repeated key events when a key is held down.\n"
         "\n"
@@ -109,6 +197,11 @@ scrcpy_print_usage(const char *arg0) {
         "        mipmaps are automatically generated to improve downscaling\n"
         "        quality. This option disables the generation of mipmaps.\n"
         "\n"
+        "    --pointer-prediction\n"
+        "        Extrapolate the position of the resampled mouse motion\n"
+        "        events from the pointer velocity, to compensate the delay\n"
+        "        they are held for (at most one refresh period).\n"
+        "\n"
         "    -p, --port port[:port]\n"
         "        Set the TCP port (range) used by the client to listen or\n"
         "        server port of direct mode.\n"
@@ -121,19 +214,80 @@ scrcpy_print_usage(const char *arg0) {
         "        special character, but breaks the expected behavior of alpha\n"
         "        keys in games (typically WASD).\n"
         "\n"
+        "    --preview-bit-rate value\n"
+        "        Encode the preview stream at the given bit-rate, expressed\n"
+        "        in bits/s. Unit suffixes are supported: 'K' (x1000) and 'M'\n"
+        "        (x1000000).\n"
+        "        Default is 2M (2000000).\n"
+        "\n"
+        "    --preview-max-size value\n"
+        "        Display a second stream, encoded by the device at a lower\n"
+        "        definition (limited to this value), while the main stream is\n"
+        "        only recorded (or kept in the replay buffer). The full\n"
+        "        definition is never decoded.\n"
+        "        Default is 0 (no preview stream).\n"
+        "\n"
         "    --push-target path\n"
         "        Set the target directory for pushing files to the device by\n"
         "        drag & drop. It is passed as-is to \"adb push\".\n"
         "        Default is \"/sdcard/\".\n"
         "\n"
+        "    --reconnect\n"
+        "        When the connection to the device is lost (for example on\n"
+        "        a USB glitch or an adb restart), restart the server and\n"
+        "        resume the stream in the same window (the recording\n"
+        "        continues in the same file). Abandon after 30 seconds.\n"
+        "\n"
         "    -r, --record file.mp4\n"
         "        Record screen to file.\n"
         "        The format is determined by the --record-format option if\n"
         "        set, or by the file extension (.mp4 or .mkv).\n"
         "\n"
+        "    --record-buffer size\n"
+        "        Set the size of the buffer written to the record file by a\n"
+        "        separate thread, so that the recording never waits for the\n"
+        "        storage unless the buffer is full. Unit suffixes are\n"
+        "        supported: 'K' (x1000) and 'M' (x1000000). 0 disables the\n"
+        "        buffer (the file is written by the recorder thread).\n"
+        "        Default is 4194304 (4MiB).\n"
+        "\n"
         "    --record-format format\n"
         "        Force recording format (either mp4 or mkv).\n"
         "\n"
+        "    --record-fragmented\n"
+        "        Write a fragmented MP4, which remains readable if scrcpy is\n"
+        "        interrupted and can be read while it is being written.\n"
+        "        Only supported for the mp4 format.\n"
+        "\n"
+        "    --record-queue-policy policy\n"
+        "        Set what to do when the recorder queue is full (when the\n"
+        "        file is written slower than the video is received):\n"
+        "        \"block\" waits (the mirroring is slowed down), \"drop\"\n"
+        "        drops the video until the next key frame, and \"fail\"\n"
+        "        stops the recording (the mirroring continues).\n"
+        "        Default is \"block\".\n"
+        "\n"
+        "    --record-queue-size value\n"
+        "        Set the maximum number of video packets waiting to be\n"
+        "        written to the record file (between 16 and 65535).\n"
+        "        Default is 1024.\n"
+        "\n"
+        "    --record-segment seconds\n"
+        "        Split the recording into files of (at least) the given\n"
+        "        duration. Each file starts on a key frame, and is named from\n"
+        "        the record file with an index: file-0000.mp4, file-0001.mp4…\n"
+        "\n"
+        "    --relay-connect ip:port\n"
+        "        Watch the device mirrored by another scrcpy client serving a\n"
+        "        relay (--relay-port), instead of connecting to a device.\n"
+        "        Control is disabled (it remains with the owner of the\n"
+        "        relay).\n"
+        "\n"
+        "    --relay-port port\n"
+        "        Serve the video stream to other scrcpy clients (started\n"
+        "        with --relay-connect) on this port, on localhost, so that\n"
+        "        the device encodes the video only once for all the viewers.\n"
+        "\n"
         "    --render-driver name\n"
         "        Request SDL to use the given render driver (this is just a\n"
         "        hint).\n"
@@ -145,16 +299,49 @@ scrcpy_print_usage(const char *arg0) {
         "        By default, to minimize latency, scrcpy always renders the\n"
         "        last available decoded frame, and drops any previous ones.\n"
         "        This flag forces to render all frames, at a cost of a\n"
-        "        possible increased latency.\n"
+        "        possible increased latency (bounded by --frame-queue-size).\n"
+        "\n"
+        "    --render-pacing mode\n"
+        "        Set when the frames are presented: \"immediate\" renders\n"
+        "        each frame as soon as it is decoded; \"vsync\" presents the\n"
+        "        most recent frame at the display refresh rate, without\n"
+        "        tearing; \"smooth\" is like \"vsync\", but also evens out\n"
+        "        the frame intervals when the video frame rate is lower than\n"
+        "        the refresh rate (at most one refresh period of additional\n"
+        "        latency).\n"
+        "        Default is \"immediate\".\n"
+        "\n"
+        "    --render-thread\n"
+        "        Render the video from a separate thread, so that input events\n"
+        "        are never delayed by the rendering (nor the rendering by a\n"
+        "        flood of input events).\n"
+        "        It may not work with all render drivers.\n"
+        "\n"
+        "    --replay-buffer seconds\n"
+        "        Keep the last seconds of video in memory, to write them to\n"
+        "        a file on demand with MOD+Shift+r (scrcpy-replay-<date>.mp4,\n"
+        "        in the current directory).\n"
         "\n"
         "    --rotation value\n"
         "        Set the initial display rotation.\n"
         "        Possibles values are 0, 1, 2 and 3. Each increment adds a 90\n"
         "        degrees rotation counterclockwise.\n"
         "\n"
+        "    --screenshot-dir path\n"
+        "        Set the directory where the screenshots taken by MOD+Shift+s\n"
+        "        are written (scrcpy-screenshot-<date>-<n>.png).\n"
+        "        Default is the current directory.\n"
+        "\n"
+        "    --screenshot-format format\n"
+        "        Set the screenshot format (either png or jpeg). The PNG\n"
+        "        screenshots are lossless (but the video stream is not).\n"
+        "        Default is png.\n"
+        "\n"
         "    -s, --serial serial\n"
         "        The device serial number. Mandatory only if several devices\n"
         "        are connected to adb.\n"
+        "        It may be repeated to mirror several devices from a single\n"
+        "        process (one window per device).\n"
         "\n"
         "    -d, --device ip\n"
         "        The device ip address.\n"
@@ -162,6 +349,12 @@ scrcpy_print_usage(const char *arg0) {
         "    -u, --url url\n"
         "        The server startup url prefix.\n"
         "\n"
+        "    --server-daemon\n"
+        "        Connect to a resident server on the device, started on the\n"
+        "        first use and kept running for the next sessions (possibly\n"
+        "        concurrent), so that a session does not start a new server\n"
+        "        process on the device.\n"
+        "\n"
         "    --shortcut-mod key[+...]][,...]\n"
         "        Specify the modifiers to use for scrcpy shortcuts.\n"
         "        Possible keys are \"lctrl\", \"rctrl\", \"lalt\", \"ralt\",\n"
@@ -175,6 +368,12 @@ scrcpy_print_usage(const char *arg0) {
         "\n"
         "        Default is \"lalt,lsuper\" (left-Alt or left-Super).\n"
         "\n"
+        "    --shm-sink name\n"
+        "        Publish the decoded frames into a shared memory ring with\n"
+        "        the given name (POSIX shared memory, or Windows file\n"
+        "        mapping), so that local processes read them directly.\n"
+        "        The layout is described in app/src/shm_sink.h.\n"
+        "\n"
         "    -S, --turn-screen-off\n"
         "        Turn the device screen off immediately.\n"
         "\n"
@@ -183,6 +382,38 @@ scrcpy_print_usage(const char *arg0) {
         "        on exit.\n"
         "        It only shows physical touches (not clicks from scrcpy).\n"
         "\n"
+        "    --tile\n"
+        "        Display several devices (given by repeated -s) as tiles of a\n"
+        "        single window, rendered at once.\n"
+        "        The input events are sent to the device under the mouse\n"
+        "        (or the last clicked one).\n"
+        "\n"
+        "    --trace file.json\n"
+        "        Record the activity of the threads of the video and control\n"
+        "        pipelines (receiving, parsing, decoding, uploading,\n"
+        "        presenting, sending...), and write it to a Chrome trace file\n"
+        "        when scrcpy exits (to be opened in chrome://tracing or\n"
+        "        https://ui.perfetto.dev).\n"
+        "\n"
+        "    --upscale-filter filter\n"
+        "        Set the filter used when the video is displayed larger than\n"
+        "        its resolution (either linear or lanczos).\n"
+        "        The lanczos filter keeps the edges (typically the text)\n"
+        "        sharp, so that the device may be mirrored with a lower\n"
+        "        --max-size. It requires an OpenGL 3.0 renderer, and\n"
+        "        software decoding.\n"
+        "        Default is linear.\n"
+        "\n"
+#ifdef HAVE_V4L2
+        "    --v4l2-sink /dev/videoN\n"
+        "        Output the decoded frames to a V4L2 device (typically a\n"
+        "        v4l2loopback one), so that other applications can capture\n"
+        "        them as a webcam.\n"
+        "        The output size is fixed once the device is open: lock\n"
+        "        the video orientation to avoid skipped frames.\n"
+        "        It may be used with --no-display.\n"
+        "\n"
+#endif
         "    -v, --version\n"
         "        Print the version of scrcpy.\n"
         "\n"
@@ -193,6 +424,29 @@ scrcpy_print_usage(const char *arg0) {
 #else
         "        Default is info.\n"
 #endif
+        "\n"
+        "    --video-codec name\n"
+        "        Select the video codec: \"h264\", \"h265\" or \"av1\".\n"
+        "        H.265 and AV1 require less bit-rate for the same quality, but\n"
+        "        the device must provide an encoder for them (and the client\n"
+        "        a decoder).\n"
+        "        Default is \"h264\".\n"
+        "\n"
+        "    --video-recv-buffer value\n"
+        "        Set the size of the socket receive buffer of the video\n"
+        "        stream, in bytes, so that the bursts of data on key frames\n"
+        "        do not stall the device (typically over a network).\n"
+        "        Unit suffixes are supported: 'K' (x1000) and 'M'\n"
+        "        (x1000000).\n"
+        "        Default is 0 (system default).\n"
+        "\n"
+        "    --video-transport protocol\n"
+        "        Transport the video stream over \"tcp\" or \"udp\" (only in\n"
+        "        direct mode, with --device and --url).\n"
+        "        Over UDP, a lost packet does not delay the next ones: the\n"
+        "        incomplete frames are dropped, and a key frame is requested\n"
+        "        if they were referenced by the next frames.\n"
+        "        Default is \"tcp\".\n"
         "\n"
         "    -w, --stay-awake\n"
         "        Keep the device on while scrcpy is running, when the device\n"
@@ -254,6 +508,10 @@ scrcpy_print_usage(const char *arg0) {
         "    MOD+s\n"
         "        Click on APP_SWITCH\n"
         "\n"
+        "    MOD+Shift+s\n"
+        "        Save a screenshot of the current frame (see\n"
+        "        --screenshot-dir)\n"
+        "\n"
         "    MOD+m\n"
         "        Click on MENU\n"
         "\n"
@@ -278,6 +536,16 @@ scrcpy_print_usage(const char *arg0) {
         "    MOD+r\n"
         "        Rotate device screen\n"
         "\n"
+        "    MOD+Shift+r\n"
+        "        Save the replay buffer (if enabled by --replay-buffer)\n"
+        "\n"
+        "    MOD+z\n"
+        "        Crop the device screen to the half of the video around the\n"
+        "        mouse pointer (zoom)\n"
+        "\n"
+        "    MOD+Shift+z\n"
+        "        Restore the initial crop\n"
+        "\n"
         "    MOD+n\n"
         "        Expand notification panel\n"
         "\n"
@@ -290,6 +558,9 @@ scrcpy_print_usage(const char *arg0) {
         "    MOD+x\n"
         "        Cut to clipboard (inject CUT keycode, Android >= 7 only)\n"
         "\n"
+        "    MOD+Shift+x\n"
+        "        Cancel the pending and running file transfers\n"
+        "\n"
         "    MOD+v\n"
         "        Copy computer clipboard to device, then paste (inject PASTE\n"
         "        keycode, Android >= 7 only)\n"
@@ -300,6 +571,10 @@ scrcpy_print_usage(const char *arg0) {
         "    MOD+i\n"
         "        Enable/disable FPS counter (print frames/second in logs)\n"
         "\n"
+        "    MOD+Shift+i\n"
+        "        Print the latency percentiles of each stage of the video\n"
+        "        pipeline in logs\n"
+        "\n"
         "    Ctrl+click-and-move\n"
         "        Pinch-to-zoom from the center of the screen\n"
         "\n"
@@ -484,6 +759,56 @@ parse_port_range(const char *s, struct sc_port_range *port_range) {
     return true;
 }
 
+static bool
+parse_metrics_port(const char *s, uint16_t *port) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0xFFFF, "metrics port");
+    if (!ok) {
+        return false;
+    }
+
+    *port = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_relay_port(const char *s, uint16_t *port) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0xFFFF, "relay port");
+    if (!ok) {
+        return false;
+    }
+
+    *port = (uint16_t) value;
+    return true;
+}
+
+// the address is parsed on connection, only check its format ("ip:port")
+static bool
+check_relay_address(const char *s) {
+    const char *colon = strrchr(s, ':');
+    if (!colon || colon == s) {
+        LOGE("Invalid relay address (expected ip:port): %s", s);
+        return false;
+    }
+
+    long value;
+    return parse_integer_arg(colon + 1, &value, false, 1, 0xFFFF,
+                             "relay port");
+}
+
+static bool
+parse_display_buffer(const char *s, uint16_t *display_buffer) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 1000, "display buffer");
+    if (!ok) {
+        return false;
+    }
+
+    *display_buffer = (uint16_t) value;
+    return true;
+}
+
 static bool
 parse_display_id(const char *s, uint16_t *display_id) {
     long value;
@@ -496,6 +821,250 @@ parse_display_id(const char *s, uint16_t *display_id) {
     return true;
 }
 
+static bool
+parse_frame_queue_size(const char *s, uint8_t *frame_queue_size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 2, 16, "frame queue size");
+    if (!ok) {
+        return false;
+    }
+
+    *frame_queue_size = (uint8_t) value;
+    return true;
+}
+
+static bool
+parse_file_transfer_workers(const char *s, uint8_t *workers) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 8,
+                                "file transfer workers");
+    if (!ok) {
+        return false;
+    }
+
+    *workers = (uint8_t) value;
+    return true;
+}
+
+static bool
+parse_control_queue_size(const char *s, uint16_t *control_queue_size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 16, 0xFFFF,
+                                "control queue size");
+    if (!ok) {
+        return false;
+    }
+
+    *control_queue_size = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_decoder_threads(const char *s, uint8_t *decoder_threads) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 64, "decoder threads");
+    if (!ok) {
+        return false;
+    }
+
+    *decoder_threads = (uint8_t) value;
+    return true;
+}
+
+static bool
+parse_decoder_thread_type(const char *s,
+                          enum sc_decoder_thread_type *thread_type) {
+    if (!strcmp(s, "slice")) {
+        *thread_type = SC_DECODER_THREAD_TYPE_SLICE;
+        return true;
+    }
+    if (!strcmp(s, "frame")) {
+        *thread_type = SC_DECODER_THREAD_TYPE_FRAME;
+        return true;
+    }
+    LOGE("Unsupported decoder thread type: %s (expected slice or frame)", s);
+    return false;
+}
+
+static bool
+parse_hw_decoder(const char *s, enum sc_hw_decoder *hw_decoder) {
+    if (!strcmp(s, "auto")) {
+        *hw_decoder = SC_HW_DECODER_AUTO;
+        return true;
+    }
+    if (!strcmp(s, "vaapi")) {
+        *hw_decoder = SC_HW_DECODER_VAAPI;
+        return true;
+    }
+    if (!strcmp(s, "d3d11va")) {
+        *hw_decoder = SC_HW_DECODER_D3D11VA;
+        return true;
+    }
+    if (!strcmp(s, "videotoolbox")) {
+        *hw_decoder = SC_HW_DECODER_VIDEOTOOLBOX;
+        return true;
+    }
+    if (!strcmp(s, "cuda")) {
+        *hw_decoder = SC_HW_DECODER_CUDA;
+        return true;
+    }
+    LOGE("Unsupported hardware decoder: %s "
+         "(expected auto, vaapi, d3d11va, videotoolbox or cuda)", s);
+    return false;
+}
+
+static bool
+parse_record_queue_policy(const char *s,
+                          enum sc_record_queue_policy *policy) {
+    if (!strcmp(s, "block")) {
+        *policy = SC_RECORD_QUEUE_POLICY_BLOCK;
+        return true;
+    }
+    if (!strcmp(s, "drop")) {
+        *policy = SC_RECORD_QUEUE_POLICY_DROP;
+        return true;
+    }
+    if (!strcmp(s, "fail")) {
+        *policy = SC_RECORD_QUEUE_POLICY_FAIL;
+        return true;
+    }
+    LOGE("Unsupported record queue policy: %s (expected block, drop or fail)",
+         s);
+    return false;
+}
+
+static bool
+parse_record_buffer_size(const char *s, uint32_t *record_buffer_size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, true, 0, 1 << 30,
+                                "record buffer size");
+    if (!ok) {
+        return false;
+    }
+
+    *record_buffer_size = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_record_queue_size(const char *s, uint16_t *record_queue_size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 16, 0xFFFF,
+                                "record queue size");
+    if (!ok) {
+        return false;
+    }
+
+    *record_queue_size = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_record_segment(const char *s, uint32_t *record_segment) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0x7FFFFFFF,
+                                "record segment duration");
+    if (!ok) {
+        return false;
+    }
+
+    *record_segment = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_replay_buffer(const char *s, uint16_t *replay_buffer) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 3600,
+                                "replay buffer duration");
+    if (!ok) {
+        return false;
+    }
+
+    *replay_buffer = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_video_recv_buffer(const char *s, uint32_t *video_recv_buffer) {
+    long value;
+    // the kernel may cap the value (net.core.rmem_max on Linux)
+    bool ok = parse_integer_arg(s, &value, true, 0, 0x7FFFFFFF,
+                                "video receive buffer size");
+    if (!ok) {
+        return false;
+    }
+
+    *video_recv_buffer = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_render_pacing(const char *s, enum sc_render_pacing *render_pacing) {
+    if (!strcmp(s, "immediate")) {
+        *render_pacing = SC_RENDER_PACING_IMMEDIATE;
+        return true;
+    }
+    if (!strcmp(s, "vsync")) {
+        *render_pacing = SC_RENDER_PACING_VSYNC;
+        return true;
+    }
+    if (!strcmp(s, "smooth")) {
+        *render_pacing = SC_RENDER_PACING_SMOOTH;
+        return true;
+    }
+    LOGE("Unsupported render pacing: %s (expected immediate, vsync or smooth)",
+         s);
+    return false;
+}
+
+static bool
+parse_encoder_profile(const char *s, enum sc_encoder_profile *profile) {
+    if (!strcmp(s, "latency")) {
+        *profile = SC_ENCODER_PROFILE_LATENCY;
+        return true;
+    }
+    if (!strcmp(s, "quality")) {
+        *profile = SC_ENCODER_PROFILE_QUALITY;
+        return true;
+    }
+    LOGE("Unsupported encoder profile: %s (expected latency or quality)", s);
+    return false;
+}
+
+static bool
+parse_video_codec(const char *s, enum sc_codec *codec) {
+    if (!strcmp(s, "h264")) {
+        *codec = SC_CODEC_H264;
+        return true;
+    }
+    if (!strcmp(s, "h265")) {
+        *codec = SC_CODEC_H265;
+        return true;
+    }
+    if (!strcmp(s, "av1")) {
+        *codec = SC_CODEC_AV1;
+        return true;
+    }
+    LOGE("Unsupported video codec: %s (expected h264, h265 or av1)", s);
+    return false;
+}
+
+static bool
+parse_video_transport(const char *s,
+                      enum sc_video_transport *video_transport) {
+    if (!strcmp(s, "tcp")) {
+        *video_transport = SC_VIDEO_TRANSPORT_TCP;
+        return true;
+    }
+    if (!strcmp(s, "udp")) {
+        *video_transport = SC_VIDEO_TRANSPORT_UDP;
+        return true;
+    }
+    LOGE("Unsupported video transport: %s (expected tcp or udp)", s);
+    return false;
+}
+
 static bool
 parse_log_level(const char *s, enum sc_log_level *log_level) {
     if (!strcmp(s, "debug")) {
@@ -633,6 +1202,36 @@ parse_record_format(const char *optarg, enum sc_record_format *format) {
     return false;
 }
 
+static bool
+parse_screenshot_format(const char *optarg,
+                        enum sc_screenshot_format *format) {
+    if (!strcmp(optarg, "png")) {
+        *format = SC_SCREENSHOT_FORMAT_PNG;
+        return true;
+    }
+    if (!strcmp(optarg, "jpeg") || !strcmp(optarg, "jpg")) {
+        *format = SC_SCREENSHOT_FORMAT_JPEG;
+        return true;
+    }
+    LOGE("Unsupported screenshot format: %s (expected png or jpeg)", optarg);
+    return false;
+}
+
+static bool
+parse_upscale_filter(const char *optarg, enum sc_upscale_filter *filter) {
+    if (!strcmp(optarg, "linear")) {
+        *filter = SC_UPSCALE_FILTER_LINEAR;
+        return true;
+    }
+    if (!strcmp(optarg, "lanczos")) {
+        *filter = SC_UPSCALE_FILTER_LANCZOS;
+        return true;
+    }
+    LOGE("Unsupported upscale filter: %s (expected linear or lanczos)",
+         optarg);
+    return false;
+}
+
 static enum sc_record_format
 guess_record_format(const char *filename) {
     size_t len = strlen(filename);
@@ -675,51 +1274,151 @@ guess_record_format(const char *filename) {
 #define OPT_FORWARD_ALL_CLICKS     1023
 #define OPT_LEGACY_PASTE           1024
 #define OPT_ENCODER_NAME           1025
+#define OPT_FRAME_QUEUE_SIZE       1026
+#define OPT_HW_DECODER             1027
+#define OPT_DECODER_THREADS        1028
+#define OPT_DECODER_THREAD_TYPE    1029
+#define OPT_ADAPTIVE_BIT_RATE      1030
+#define OPT_CONTROL_QUEUE_SIZE     1031
+#define OPT_RENDER_PACING          1032
+#define OPT_RENDER_THREAD          1033
+#define OPT_RECORD_QUEUE_POLICY    1034
+#define OPT_RECORD_QUEUE_SIZE      1035
+#define OPT_RECORD_SEGMENT         1036
+#define OPT_RECORD_FRAGMENTED      1037
+#define OPT_REPLAY_BUFFER          1038
+#define OPT_TILE                   1039
+#define OPT_PREVIEW_MAX_SIZE       1040
+#define OPT_PREVIEW_BIT_RATE       1041
+#define OPT_VIDEO_RECV_BUFFER      1042
+#define OPT_VIDEO_TRANSPORT        1043
+#define OPT_VIDEO_CODEC            1044
+#define OPT_ENCODER_PROFILE        1045
+#define OPT_SHM_SINK               1046
+#define OPT_V4L2_SINK              1047
+#define OPT_DISPLAY_BUFFER         1048
+#define OPT_METRICS_PORT           1049
+#define OPT_NO_INPUT_RESAMPLING    1050
+#define OPT_POINTER_PREDICTION     1051
+#define OPT_FILE_TRANSFER_WORKERS  1052
+#define OPT_ADAPTIVE_RESOLUTION    1053
+#define OPT_SCREENSHOT_DIR         1054
+#define OPT_SCREENSHOT_FORMAT      1055
+#define OPT_RECORD_BUFFER          1056
+#define OPT_INPUT                  1057
+#define OPT_RECONNECT              1058
+#define OPT_SERVER_DAEMON          1059
+#define OPT_UPSCALE_FILTER         1060
+#define OPT_TRACE                  1061
+#define OPT_RELAY_PORT             1062
+#define OPT_RELAY_CONNECT          1063
 
 bool
 scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
     static const struct option long_options[] = {
+        {"adaptive-bit-rate",      no_argument,       NULL,
+                                                  OPT_ADAPTIVE_BIT_RATE},
+        {"adaptive-resolution",    no_argument,       NULL,
+                                                  OPT_ADAPTIVE_RESOLUTION},
         {"always-on-top",          no_argument,       NULL, OPT_ALWAYS_ON_TOP},
         {"bit-rate",               required_argument, NULL, 'b'},
         {"codec-options",          required_argument, NULL, OPT_CODEC_OPTIONS},
+        {"control-queue-size",     required_argument, NULL,
+                                                  OPT_CONTROL_QUEUE_SIZE},
         {"crop",                   required_argument, NULL, OPT_CROP},
+        {"decoder-threads",        required_argument, NULL,
+                                                  OPT_DECODER_THREADS},
+        {"decoder-thread-type",    required_argument, NULL,
+                                                  OPT_DECODER_THREAD_TYPE},
         {"disable-screensaver",    no_argument,       NULL,
                                                   OPT_DISABLE_SCREENSAVER},
         {"display",                required_argument, NULL, OPT_DISPLAY_ID},
+        {"display-buffer",         required_argument, NULL,
+                                                  OPT_DISPLAY_BUFFER},
         {"encoder",                required_argument, NULL, OPT_ENCODER_NAME},
+        {"encoder-profile",        required_argument, NULL,
+                                                  OPT_ENCODER_PROFILE},
+        {"file-transfer-workers",  required_argument, NULL,
+                                                  OPT_FILE_TRANSFER_WORKERS},
         {"force-adb-forward",      no_argument,       NULL,
                                                   OPT_FORCE_ADB_FORWARD},
         {"forward-all-clicks",     no_argument,       NULL,
                                                   OPT_FORWARD_ALL_CLICKS},
+        {"frame-queue-size",       required_argument, NULL,
+                                                  OPT_FRAME_QUEUE_SIZE},
         {"fullscreen",             no_argument,       NULL, 'f'},
         {"help",                   no_argument,       NULL, 'h'},
+        {"hw-decoder",             required_argument, NULL, OPT_HW_DECODER},
+        {"input",                  required_argument, NULL, OPT_INPUT},
         {"legacy-paste",           no_argument,       NULL, OPT_LEGACY_PASTE},
         {"lock-video-orientation", required_argument, NULL,
                                                   OPT_LOCK_VIDEO_ORIENTATION},
         {"max-fps",                required_argument, NULL, OPT_MAX_FPS},
         {"max-size",               required_argument, NULL, 'm'},
+        {"metrics-port",           required_argument, NULL, OPT_METRICS_PORT},
         {"no-control",             no_argument,       NULL, 'n'},
         {"no-display",             no_argument,       NULL, 'N'},
+        {"no-input-resampling",    no_argument,       NULL,
+                                                  OPT_NO_INPUT_RESAMPLING},
         {"no-key-repeat",          no_argument,       NULL, OPT_NO_KEY_REPEAT},
         {"no-mipmaps",             no_argument,       NULL, OPT_NO_MIPMAPS},
+        {"pointer-prediction",     no_argument,       NULL,
+                                                  OPT_POINTER_PREDICTION},
         {"port",                   required_argument, NULL, 'p'},
         {"prefer-text",            no_argument,       NULL, OPT_PREFER_TEXT},
+        {"preview-bit-rate",       required_argument, NULL,
+                                                  OPT_PREVIEW_BIT_RATE},
+        {"preview-max-size",       required_argument, NULL,
+                                                  OPT_PREVIEW_MAX_SIZE},
         {"push-target",            required_argument, NULL, OPT_PUSH_TARGET},
+        {"reconnect",              no_argument,       NULL, OPT_RECONNECT},
         {"record",                 required_argument, NULL, 'r'},
+        {"record-buffer",          required_argument, NULL, OPT_RECORD_BUFFER},
         {"record-format",          required_argument, NULL, OPT_RECORD_FORMAT},
+        {"record-fragmented",      no_argument,       NULL,
+                                                  OPT_RECORD_FRAGMENTED},
+        {"record-queue-policy",    required_argument, NULL,
+                                                  OPT_RECORD_QUEUE_POLICY},
+        {"record-queue-size",      required_argument, NULL,
+                                                  OPT_RECORD_QUEUE_SIZE},
+        {"record-segment",         required_argument, NULL,
+                                                  OPT_RECORD_SEGMENT},
+        {"relay-connect",          required_argument, NULL, OPT_RELAY_CONNECT},
+        {"relay-port",             required_argument, NULL, OPT_RELAY_PORT},
         {"render-driver",          required_argument, NULL, OPT_RENDER_DRIVER},
         {"render-expired-frames",  no_argument,       NULL,
                                                   OPT_RENDER_EXPIRED_FRAMES},
+        {"render-pacing",          required_argument, NULL, OPT_RENDER_PACING},
+        {"render-thread",          no_argument,       NULL, OPT_RENDER_THREAD},
+        {"replay-buffer",          required_argument, NULL, OPT_REPLAY_BUFFER},
         {"rotation",               required_argument, NULL, OPT_ROTATION},
+        {"screenshot-dir",         required_argument, NULL,
+                                                  OPT_SCREENSHOT_DIR},
+        {"screenshot-format",      required_argument, NULL,
+                                                  OPT_SCREENSHOT_FORMAT},
         {"serial",                 required_argument, NULL, 's'},
         {"device",                 required_argument, NULL, 'd'},
         {"url",                    required_argument, NULL, 'u'},
+        {"server-daemon",          no_argument,       NULL, OPT_SERVER_DAEMON},
         {"shortcut-mod",           required_argument, NULL, OPT_SHORTCUT_MOD},
+        {"shm-sink",               required_argument, NULL, OPT_SHM_SINK},
         {"show-touches",           no_argument,       NULL, 't'},
         {"stay-awake",             no_argument,       NULL, 'w'},
+        {"tile",                   no_argument,       NULL, OPT_TILE},
+        {"trace",                  required_argument, NULL, OPT_TRACE},
         {"turn-screen-off",        no_argument,       NULL, 'S'},
+        {"upscale-filter",         required_argument, NULL,
+                                                  OPT_UPSCALE_FILTER},
+#ifdef HAVE_V4L2
+        {"v4l2-sink",              required_argument, NULL, OPT_V4L2_SINK},
+#endif
         {"verbosity",              required_argument, NULL, 'V'},
         {"version",                no_argument,       NULL, 'v'},
+        {"video-codec",            required_argument, NULL, OPT_VIDEO_CODEC},
+        {"video-recv-buffer",      required_argument, NULL,
+                                                  OPT_VIDEO_RECV_BUFFER},
+        {"video-transport",        required_argument, NULL,
+                                                  OPT_VIDEO_TRANSPORT},
         {"window-title",           required_argument, NULL, OPT_WINDOW_TITLE},
         {"window-x",               required_argument, NULL, OPT_WINDOW_X},
         {"window-y",               required_argument, NULL, OPT_WINDOW_Y},
@@ -754,6 +1453,16 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
                     return false;
                 }
                 break;
+            case OPT_DISPLAY_BUFFER:
+                if (!parse_display_buffer(optarg, &opts->display_buffer)) {
+                    return false;
+                }
+                break;
+            case OPT_METRICS_PORT:
+                if (!parse_metrics_port(optarg, &opts->metrics_port)) {
+                    return false;
+                }
+                break;
             case 'f':
                 opts->fullscreen = true;
                 break;
@@ -798,7 +1507,14 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
                 opts->record_filename = optarg;
                 break;
             case 's':
-                opts->serial = optarg;
+                if (!opts->serial) {
+                    opts->serial = optarg;
+                }
+                if (opts->serials.count == SC_MAX_SESSIONS) {
+                    LOGE("Too many devices (max %d)", SC_MAX_SESSIONS);
+                    return false;
+                }
+                opts->serials.data[opts->serials.count++] = optarg;
                 break;
             case 'd':
                 opts->device = optarg;
@@ -806,6 +1522,9 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
             case 'u':
                 opts->url = optarg;
                 break;
+            case OPT_INPUT:
+                opts->input = optarg;
+                break;
             case 'S':
                 opts->turn_screen_off = true;
                 break;
@@ -832,6 +1551,111 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
             case OPT_RENDER_EXPIRED_FRAMES:
                 opts->render_expired_frames = true;
                 break;
+            case OPT_RECORD_QUEUE_POLICY:
+                if (!parse_record_queue_policy(optarg,
+                                               &opts->record_queue_policy)) {
+                    return false;
+                }
+                break;
+            case OPT_RECONNECT:
+                opts->reconnect = true;
+                break;
+            case OPT_SERVER_DAEMON:
+                opts->server_daemon = true;
+                break;
+            case OPT_RECORD_BUFFER:
+                if (!parse_record_buffer_size(optarg,
+                                              &opts->record_buffer_size)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_QUEUE_SIZE:
+                if (!parse_record_queue_size(optarg,
+                                             &opts->record_queue_size)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_SEGMENT:
+                if (!parse_record_segment(optarg, &opts->record_segment)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_FRAGMENTED:
+                opts->record_fragmented = true;
+                break;
+            case OPT_REPLAY_BUFFER:
+                if (!parse_replay_buffer(optarg, &opts->replay_buffer)) {
+                    return false;
+                }
+                break;
+            case OPT_RENDER_THREAD:
+                opts->render_thread = true;
+                break;
+            case OPT_TILE:
+                opts->tile = true;
+                break;
+            case OPT_TRACE:
+                opts->trace_filename = optarg;
+                break;
+            case OPT_RELAY_PORT:
+                if (!parse_relay_port(optarg, &opts->relay_port)) {
+                    return false;
+                }
+                break;
+            case OPT_RELAY_CONNECT:
+                if (!check_relay_address(optarg)) {
+                    return false;
+                }
+                opts->relay_connect = optarg;
+                break;
+            case OPT_PREVIEW_MAX_SIZE:
+                if (!parse_max_size(optarg, &opts->preview_max_size)) {
+                    return false;
+                }
+                break;
+            case OPT_PREVIEW_BIT_RATE:
+                if (!parse_bit_rate(optarg, &opts->preview_bit_rate)) {
+                    return false;
+                }
+                if (!opts->preview_bit_rate) {
+                    LOGE("The preview bit-rate must not be 0");
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_RECV_BUFFER:
+                if (!parse_video_recv_buffer(optarg,
+                                             &opts->video_recv_buffer)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_TRANSPORT:
+                if (!parse_video_transport(optarg, &opts->video_transport)) {
+                    return false;
+                }
+                break;
+            case OPT_SHM_SINK:
+                opts->shm_sink = optarg;
+                break;
+#ifdef HAVE_V4L2
+            case OPT_V4L2_SINK:
+                opts->v4l2_device = optarg;
+                break;
+#endif
+            case OPT_ENCODER_PROFILE:
+                if (!parse_encoder_profile(optarg, &opts->encoder_profile)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_CODEC:
+                if (!parse_video_codec(optarg, &opts->video_codec)) {
+                    return false;
+                }
+                break;
+            case OPT_RENDER_PACING:
+                if (!parse_render_pacing(optarg, &opts->render_pacing)) {
+                    return false;
+                }
+                break;
             case OPT_WINDOW_TITLE:
                 opts->window_title = optarg;
                 break;
@@ -878,6 +1702,12 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
             case OPT_NO_KEY_REPEAT:
                 opts->forward_key_repeat = false;
                 break;
+            case OPT_NO_INPUT_RESAMPLING:
+                opts->input_resampling = false;
+                break;
+            case OPT_POINTER_PREDICTION:
+                opts->pointer_prediction = true;
+                break;
             case OPT_CODEC_OPTIONS:
                 opts->codec_options = optarg;
                 break;
@@ -901,14 +1731,80 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
             case OPT_LEGACY_PASTE:
                 opts->legacy_paste = true;
                 break;
+            case OPT_ADAPTIVE_BIT_RATE:
+                opts->adaptive_bit_rate = true;
+                break;
+            case OPT_ADAPTIVE_RESOLUTION:
+                opts->adaptive_resolution = true;
+                break;
+            case OPT_SCREENSHOT_DIR:
+                opts->screenshot_dir = optarg;
+                break;
+            case OPT_SCREENSHOT_FORMAT:
+                if (!parse_screenshot_format(optarg,
+                                             &opts->screenshot_format)) {
+                    return false;
+                }
+                break;
+            case OPT_UPSCALE_FILTER:
+                if (!parse_upscale_filter(optarg, &opts->upscale_filter)) {
+                    return false;
+                }
+                break;
+            case OPT_CONTROL_QUEUE_SIZE:
+                if (!parse_control_queue_size(optarg,
+                                              &opts->control_queue_size)) {
+                    return false;
+                }
+                break;
+            case OPT_DECODER_THREADS:
+                if (!parse_decoder_threads(optarg, &opts->decoder_threads)) {
+                    return false;
+                }
+                break;
+            case OPT_DECODER_THREAD_TYPE:
+                if (!parse_decoder_thread_type(optarg,
+                                               &opts->decoder_thread_type)) {
+                    return false;
+                }
+                break;
+            case OPT_HW_DECODER:
+                if (!parse_hw_decoder(optarg, &opts->hw_decoder)) {
+                    return false;
+                }
+                break;
+            case OPT_FRAME_QUEUE_SIZE:
+                if (!parse_frame_queue_size(optarg,
+                                            &opts->frame_queue_size)) {
+                    return false;
+                }
+                break;
+            case OPT_FILE_TRANSFER_WORKERS:
+                if (!parse_file_transfer_workers(optarg,
+                                            &opts->file_transfer_workers)) {
+                    return false;
+                }
+                break;
             default:
                 // getopt prints the error message on stderr
                 return false;
         }
     }
 
-    if (!opts->display && !opts->record_filename) {
+    if (!opts->display && !opts->record_filename && !opts->v4l2_device) {
+#ifdef HAVE_V4L2
+        LOGE("-N/--no-display requires screen recording (-r/--record) "
+             "or a V4L2 sink (--v4l2-sink)");
+#else
         LOGE("-N/--no-display requires screen recording (-r/--record)");
+#endif
+        return false;
+    }
+
+    if (opts->render_pacing != SC_RENDER_PACING_IMMEDIATE
+            && opts->render_expired_frames) {
+        // paced rendering presents only the most recent frame
+        LOGE("--render-pacing is not compatible with --render-expired-frames");
         return false;
     }
 
@@ -918,6 +1814,104 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         return false;
     }
 
+    if (opts->serials.count > 1) {
+        if (opts->record_filename) {
+            LOGE("Could not record several devices to the same file");
+            return false;
+        }
+        if (opts->device || opts->url) {
+            LOGE("Direct connection is only supported for a single device");
+            return false;
+        }
+        if (opts->shm_sink) {
+            LOGE("Could not publish several devices to the same shared "
+                 "memory");
+            return false;
+        }
+        if (opts->v4l2_device) {
+            LOGE("Could not output several devices to the same V4L2 sink");
+            return false;
+        }
+        if (opts->relay_port) {
+            LOGE("Could not relay several devices on the same port");
+            return false;
+        }
+    }
+
+    if (opts->shm_sink && !opts->display && !opts->v4l2_device) {
+        // the frames are only decoded for the display or the V4L2 sink
+        LOGE("Shared memory sink requested without display");
+        return false;
+    }
+
+    if (opts->video_transport == SC_VIDEO_TRANSPORT_UDP
+            && (!opts->device || !opts->url)) {
+        // over adb, the datagrams could not reach the client
+        LOGE("UDP video transport is only supported in direct mode "
+             "(--device and --url)");
+        return false;
+    }
+
+    if (opts->preview_max_size) {
+        if (!opts->display) {
+            LOGE("Preview stream requested without display");
+            return false;
+        }
+        if (!opts->record_filename && !opts->replay_buffer) {
+            // nothing would consume the main stream
+            LOGE("Preview stream requested without recording nor replay "
+                 "buffer (use --max-size)");
+            return false;
+        }
+    }
+
+    if (opts->tile) {
+        if (!opts->display) {
+            LOGE("Tiles requested without display");
+            return false;
+        }
+        if (opts->render_thread) {
+            // the tiles share the renderer of the main thread
+            LOGE("Tiles are not supported with a render thread");
+            return false;
+        }
+    }
+
+    if (opts->adaptive_resolution) {
+        if (!opts->display) {
+            LOGE("Adaptive resolution requested without display");
+            return false;
+        }
+        if (opts->preview_max_size) {
+            // the displayed stream would not be the adapted one
+            LOGE("--adaptive-resolution is not compatible with "
+                 "--preview-max-size");
+            return false;
+        }
+        if (opts->tile) {
+            // the tile sizes do not depend on the window size
+            LOGE("--adaptive-resolution is not compatible with --tile");
+            return false;
+        }
+    }
+
+    if (opts->display_buffer) {
+        if (!opts->display) {
+            LOGE("Display buffer requested without display");
+            return false;
+        }
+        if (opts->render_pacing != SC_RENDER_PACING_IMMEDIATE) {
+            // the frames are already presented at their PTS
+            LOGE("--display-buffer is not compatible with --render-pacing");
+            return false;
+        }
+        if (opts->render_thread) {
+            // the frames must be consumed when presented
+            LOGE("--display-buffer is not compatible with --render-thread");
+            return false;
+        }
+    }
+
     if (opts->record_format && !opts->record_filename) {
         LOGE("Record format specified without recording");
         return false;
@@ -932,6 +1926,93 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         }
     }
 
+    if (opts->replay_buffer && !opts->display) {
+        LOGE("The replay buffer is saved by a shortcut, it requires a "
+             "display");
+        return false;
+    }
+
+    if (opts->record_segment && !opts->record_filename) {
+        LOGE("Record segment duration specified without recording");
+        return false;
+    }
+
+    if (opts->record_fragmented) {
+        if (!opts->record_filename) {
+            LOGE("Fragmented recording requested without recording");
+            return false;
+        }
+        if (opts->record_format != SC_RECORD_FORMAT_MP4) {
+            LOGE("Fragmented recording is only supported for mp4");
+            return false;
+        }
+    }
+
+    if (opts->input) {
+        if (opts->serial || opts->device || opts->url) {
+            LOGE("--input is not compatible with a device (-s, -d or -u)");
+            return false;
+        }
+        if (opts->preview_max_size) {
+            // there is only one stream
+            LOGE("--input is not compatible with --preview-max-size");
+            return false;
+        }
+        if (opts->video_codec != SC_CODEC_H264) {
+            LOGE("Only H.264 is supported with --input");
+            return false;
+        }
+        // there is no device to control
+        opts->control = false;
+    }
+
+    if (opts->relay_connect) {
+        if (opts->serial || opts->device || opts->url || opts->input) {
+            LOGE("--relay-connect is not compatible with a device (-s, -d or "
+                 "-u) or --input");
+            return false;
+        }
+        if (opts->preview_max_size) {
+            // only the main stream is relayed
+            LOGE("--relay-connect is not compatible with --preview-max-size");
+            return false;
+        }
+        if (opts->reconnect) {
+            LOGE("--relay-connect is not compatible with --reconnect");
+            return false;
+        }
+        if (opts->server_daemon) {
+            LOGE("--relay-connect is not compatible with --server-daemon");
+            return false;
+        }
+        // the control remains with the owner of the relay
+        opts->control = false;
+    }
+
+    if (opts->reconnect) {
+        if (opts->input) {
+            LOGE("--reconnect is not compatible with --input");
+            return false;
+        }
+        if (opts->preview_max_size) {
+            // only the main stream is resumed
+            LOGE("--reconnect is not compatible with --preview-max-size");
+            return false;
+        }
+    }
+
+    if (opts->server_daemon) {
+        if (opts->input) {
+            LOGE("--server-daemon is not compatible with --input");
+            return false;
+        }
+        if (opts->device || opts->url) {
+            // the server is started by the url, not by adb
+            LOGE("--server-daemon is not compatible with -d or -u");
+            return false;
+        }
+    }
+
     if (!opts->control && opts->turn_screen_off) {
         LOGE("Could not request to turn screen off if control is disabled");
         return false;
@@ -942,5 +2023,15 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         return false;
     }
 
+    if (!opts->control && opts->adaptive_bit_rate) {
+        LOGE("Could not adapt the bit-rate if control is disabled");
+        return false;
+    }
+
+    if (!opts->control && opts->adaptive_resolution) {
+        LOGE("Could not adapt the resolution if control is disabled");
+        return false;
+    }
+
     return true;
 }
@@ -0,0 +1,66 @@
+#include "clock_sync.h"
+
+#include <inttypes.h>
+
+#include "util/log.h"
+
+void
+clock_sync_init(struct clock_sync *cs) {
+    cs->count = 0;
+    cs->head = 0;
+    atomic_init(&cs->offset, 0);
+    atomic_init(&cs->synced, false);
+}
+
+void
+clock_sync_add_sample(struct clock_sync *cs, int64_t ping_sent,
+                      int64_t ping_received, int64_t pong_sent,
+                      int64_t pong_received) {
+    // the time spent on the device is not part of the network round trip
+    int64_t rtt = (pong_received - ping_sent) - (pong_sent - ping_received);
+    if (rtt < 0) {
+        LOGW("Invalid clock sync sample, ignored");
+        return;
+    }
+
+    // assume the same delay in both directions
+    int64_t offset = ((ping_received - ping_sent)
+                    + (pong_sent - pong_received)) / 2;
+
+    cs->samples[cs->head].rtt = rtt;
+    cs->samples[cs->head].offset = offset;
+    cs->head = (cs->head + 1) % CLOCK_SYNC_SAMPLES;
+    if (cs->count < CLOCK_SYNC_SAMPLES) {
+        ++cs->count;
+    }
+
+    // the exchange having the lowest round trip time is the least impacted by
+    // asymmetric delays
+    unsigned best = 0;
+    for (unsigned i = 1; i < cs->count; ++i) {
+        if (cs->samples[i].rtt < cs->samples[best].rtt) {
+            best = i;
+        }
+    }
+
+    int64_t best_offset = cs->samples[best].offset;
+    bool was_synced = atomic_load_explicit(&cs->synced, memory_order_relaxed);
+    atomic_store_explicit(&cs->offset, best_offset, memory_order_relaxed);
+    atomic_store_explicit(&cs->synced, true, memory_order_release);
+
+    if (!was_synced) {
+        LOGD("Clock synchronized (rtt=%" PRIi64 "us)", rtt);
+    }
+}
+
+bool
+clock_sync_to_local(struct clock_sync *cs, int64_t device_time,
+                    int64_t *local_time) {
+    if (!atomic_load_explicit(&cs->synced, memory_order_acquire)) {
+        return false;
+    }
+
+    int64_t offset = atomic_load_explicit(&cs->offset, memory_order_relaxed);
+    *local_time = device_time - offset;
+    return true;
+}
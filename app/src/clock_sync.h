@@ -0,0 +1,52 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// number of ping/pong exchanges over which the best estimation is selected
+#define CLOCK_SYNC_SAMPLES 16
+
+struct clock_sync_sample {
+    int64_t rtt;
+    int64_t offset; // device clock - local clock
+};
+
+// Estimate the offset between the device monotonic clock and the local
+// monotonic clock (see av_gettime_relative()), both in microseconds
+//
+// The samples are added by the receiver thread only. The stream thread reads
+// the estimated offset, published atomically.
+struct clock_sync {
+    struct clock_sync_sample samples[CLOCK_SYNC_SAMPLES];
+    unsigned count;
+    unsigned head; // index of the next sample to write
+
+    atomic_int_least64_t offset;
+    atomic_bool synced;
+};
+
+void
+clock_sync_init(struct clock_sync *cs);
+
+// Add the timestamps of a ping/pong exchange:
+//  - ping_sent: local time when the ping was sent
+//  - ping_received: device time when the ping was received
+//  - pong_sent: device time when the pong was sent
+//  - pong_received: local time when the pong was received
+void
+clock_sync_add_sample(struct clock_sync *cs, int64_t ping_sent,
+                      int64_t ping_received, int64_t pong_sent,
+                      int64_t pong_received);
+
+// Convert a device time to a local time
+//
+// Return false if no sample has been received yet.
+bool
+clock_sync_to_local(struct clock_sync *cs, int64_t device_time,
+                    int64_t *local_time);
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "config.h"
 #include "common.h"
+#include "util/lock.h"
 #include "util/log.h"
 #include "util/str_util.h"
 
@@ -103,8 +104,10 @@ show_adb_err_msg(enum process_result err, const char *const argv[]) {
     }
 }
 
-process_t
-adb_execute(const char *serial, const char *const adb_cmd[], size_t len) {
+// pout may be NULL (the output is not redirected)
+static process_t
+adb_execute_internal(const char *serial, const char *const adb_cmd[],
+                     size_t len, pipe_t *pout) {
     const char *cmd[len + 4];
     int i;
     process_t process;
@@ -119,7 +122,8 @@ adb_execute(const char *serial, const char *const adb_cmd[], size_t len) {
 
     memcpy(&cmd[i], adb_cmd, len * sizeof(const char *));
     cmd[len + i] = NULL;
-    enum process_result r = cmd_execute(cmd, &process);
+    enum process_result r = pout ? cmd_execute_redirect(cmd, &process, pout)
+                                 : cmd_execute(cmd, &process);
     if (r != PROCESS_SUCCESS) {
         show_adb_err_msg(r, cmd);
         return PROCESS_NONE;
@@ -127,6 +131,17 @@ adb_execute(const char *serial, const char *const adb_cmd[], size_t len) {
     return process;
 }
 
+process_t
+adb_execute(const char *serial, const char *const adb_cmd[], size_t len) {
+    return adb_execute_internal(serial, adb_cmd, len, NULL);
+}
+
+process_t
+adb_execute_redirect(const char *serial, const char *const adb_cmd[],
+                     size_t len, pipe_t *pout) {
+    return adb_execute_internal(serial, adb_cmd, len, pout);
+}
+
 process_t
 adb_forward(const char *serial, uint16_t local_port,
             const char *device_socket_name) {
@@ -231,54 +246,134 @@ process_check_success(process_t proc, const char *name) {
     return true;
 }
 
+// the number of idle curl handles kept for reuse
+#define CURL_POOL_SIZE 4
+#define CURL_CONNECT_TIMEOUT_MS 3000
+#define CURL_TIMEOUT_MS 10000
+
+// The handles are reused so that their connections (kept alive) are reused
+// by the next requests to the same host, without a new TCP (or TLS)
+// handshake. Several requests may be performed concurrently (one per handle).
+static struct {
+    SDL_mutex *mutex;
+    CURL *idle[CURL_POOL_SIZE];
+    unsigned idle_count;
+} curl_pool;
+
+bool
+curl_pool_init(void) {
+    if (curl_global_init(CURL_GLOBAL_ALL)) {
+        LOGC("Could not initialize libcurl");
+        return false;
+    }
+
+    curl_pool.mutex = SDL_CreateMutex();
+    if (!curl_pool.mutex) {
+        LOGC("Could not create mutex");
+        curl_global_cleanup();
+        return false;
+    }
+
+    curl_pool.idle_count = 0;
+    return true;
+}
+
+void
+curl_pool_destroy(void) {
+    for (unsigned i = 0; i < curl_pool.idle_count; ++i) {
+        curl_easy_cleanup(curl_pool.idle[i]);
+    }
+    SDL_DestroyMutex(curl_pool.mutex);
+    curl_global_cleanup();
+}
+
+static CURL *
+curl_pool_take(void) {
+    CURL *curl = NULL;
+    mutex_lock(curl_pool.mutex);
+    if (curl_pool.idle_count) {
+        curl = curl_pool.idle[--curl_pool.idle_count];
+    }
+    mutex_unlock(curl_pool.mutex);
+
+    if (!curl) {
+        curl = curl_easy_init();
+    }
+    return curl;
+}
+
+static void
+curl_pool_release(CURL *curl) {
+    mutex_lock(curl_pool.mutex);
+    if (curl_pool.idle_count < CURL_POOL_SIZE) {
+        curl_pool.idle[curl_pool.idle_count++] = curl;
+        curl = NULL;
+    }
+    mutex_unlock(curl_pool.mutex);
+
+    if (curl) {
+        // the pool is full
+        curl_easy_cleanup(curl);
+    }
+}
+
 struct curl_buffer {
     char  *buffer;
     size_t len;
     size_t pos;
 };
 
-size_t curl_receive_data(char *buffer, size_t size, size_t nmemb, void *buffin) {
-    struct curl_buffer* buff = (struct curl_buffer*)buffin;
-    if(buff->pos >= buff->len) {
-        return 0;
-    }else if (size*nmemb < buff->len-buff->pos) {
-        memcpy(buff->buffer+buff->pos, buffer, size*nmemb);
-        buff->pos += size*nmemb;
-        return size; 
-    }else{
-        size_t remain = buff->len-buff->pos;
-        memcpy(buff->buffer+buff->pos, buffer, remain);
-        buff->pos = buff->len;
-        return remain;
-    }
+static size_t
+curl_receive_data(char *data, size_t size, size_t nmemb, void *userdata) {
+    struct curl_buffer *buff = userdata;
+    size_t len = size * nmemb;
+    size_t remaining = buff->len - buff->pos;
+    size_t n = len < remaining ? len : remaining;
+    memcpy(buff->buffer + buff->pos, data, n);
+    buff->pos += n;
+    // ignore the data which does not fit, but do not abort the transfer (the
+    // connection could not be reused)
+    return len;
 }
 
-int 
-curl_get(const char* url, char* buffer, size_t buff_len) {
+int
+curl_get(const char *url, char *buffer, size_t buff_len) {
+    CURL *curl = curl_pool_take();
+    if (!curl) {
+        LOGE("Could not create curl handle");
+        return -1;
+    }
+
     struct curl_buffer buff;
     buff.buffer = buffer;
     buff.len = buff_len;
     buff.pos = 0;
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    CURL *curl = curl_easy_init();
     curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_receive_data);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buff);
-    
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+                     (long) CURL_CONNECT_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long) CURL_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // timeouts must not rely on signals, requests are performed from
+    // several threads
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
     long http_code = 0;
     CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
-    if (http_code == 200 && res != CURLE_ABORTED_BY_CALLBACK) {
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
-        return buff.pos;
-    } else
-    {
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_pool_release(curl);
+
+    if (res != CURLE_OK) {
+        LOGE("Request failed: %s", curl_easy_strerror(res));
+        return -1;
+    }
+    if (http_code != 200) {
+        LOGE("Request failed: HTTP %ld", http_code);
         return -1;
     }
+    return buff.pos;
 }
 
 
@@ -17,6 +17,7 @@
 # define NO_EXIT_CODE -1u // max value as unsigned
   typedef HANDLE process_t;
   typedef DWORD exit_code_t;
+  typedef HANDLE pipe_t;
 
 #else
 
@@ -28,6 +29,7 @@
 # define NO_EXIT_CODE -1
   typedef pid_t process_t;
   typedef int exit_code_t;
+  typedef int pipe_t;
 
 #endif
 
@@ -47,6 +49,20 @@ cmd_search(const char *file);
 enum process_result
 cmd_execute(const char *const argv[], process_t *process);
 
+// execute the command, with its standard output redirected to a pipe, to be
+// read by cmd_read_pipe_all() and closed by cmd_close_pipe()
+enum process_result
+cmd_execute_redirect(const char *const argv[], process_t *process,
+                     pipe_t *pout);
+
+// read from the pipe until EOF or len bytes, return the number of bytes read
+// or -1 on error
+ssize_t
+cmd_read_pipe_all(pipe_t pipe, char *data, size_t len);
+
+void
+cmd_close_pipe(pipe_t pipe);
+
 bool
 cmd_terminate(process_t pid);
 
@@ -56,6 +72,11 @@ cmd_simple_wait(process_t pid, exit_code_t *exit_code);
 process_t
 adb_execute(const char *serial, const char *const adb_cmd[], size_t len);
 
+// same as adb_execute(), with the standard output redirected to a pipe
+process_t
+adb_execute_redirect(const char *serial, const char *const adb_cmd[],
+                     size_t len, pipe_t *pout);
+
 process_t
 adb_forward(const char *serial, uint16_t local_port,
             const char *device_socket_name);
@@ -90,7 +111,17 @@ get_executable_path(void);
 bool
 is_regular_file(const char *path);
 
-int 
-curl_get(const char* url, char* buffer, size_t buff_len);
+// initialize libcurl and the pool of reusable handles (once per process)
+bool
+curl_pool_init(void);
+
+void
+curl_pool_destroy(void);
+
+// perform a GET request, and write the response into buffer (truncated if it
+// does not fit)
+// return the response length, or -1 on error
+int
+curl_get(const char *url, char *buffer, size_t buff_len);
 
 #endif
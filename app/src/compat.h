@@ -1,7 +1,9 @@
 #ifndef COMPAT_H
 #define COMPAT_H
 
+#include <libavcodec/version.h>
 #include <libavformat/version.h>
+#include <libavutil/version.h>
 #include <SDL2/SDL_version.h>
 
 // In ffmpeg/doc/APIchanges:
@@ -34,6 +36,45 @@
 # define SCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
 #endif
 
+// avcodec_get_hw_config() and AVCodecHWConfig are available since FFmpeg 4.0
+// (lavc 58.18.100)
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 18, 100)
+# define SCRCPY_LAVC_HAS_HW_CONFIG
+#endif
+
+// AVCodecContext.extra_hw_frames is available since FFmpeg 4.1
+// (lavc 58.35.100)
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 35, 100)
+# define SCRCPY_LAVC_HAS_EXTRA_HW_FRAMES
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2021-04-27 - lavu 57.0.100 (FFmpeg 5.0)
+//   The size parameters of the AVBufferRef API (including the allocator of
+//   av_buffer_pool_init2()) are changed from int to size_t.
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+# define SCRCPY_LAVU_HAS_SIZE_T_BUFFER_SIZE
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2023-01-29 - a1a80f2e64 - lavc 59.63.100
+//   Allow AV_CODEC_FLAG_COPY_OPAQUE to be used with decoders.
+// (AVCodecContext.reordered_opaque, used before, is deprecated by FFmpeg 6.0
+// and removed by FFmpeg 7.0)
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(59, 63, 100)
+# define SCRCPY_LAVC_HAS_COPY_OPAQUE
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2023-05-04 - 0fc9c1f6828 - lavu 58.7.100 - frame.h
+//   Deprecate AVFrame.interlaced_frame, AVFrame.top_field_first, and
+//   AVFrame.key_frame.
+//   Add AV_FRAME_FLAG_INTERLACED, AV_FRAME_FLAG_TOP_FIELD_FIRST, and
+//   AV_FRAME_FLAG_KEY flags as replacement.
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(58, 7, 100)
+# define SCRCPY_LAVU_HAS_FRAME_FLAG_KEY
+#endif
+
 #if SDL_VERSION_ATLEAST(2, 0, 5)
 // <https://wiki.libsdl.org/SDL_HINT_MOUSE_FOCUS_CLICKTHROUGH>
 # define SCRCPY_SDL_HAS_HINT_MOUSE_FOCUS_CLICKTHROUGH
@@ -46,6 +87,13 @@
 #if SDL_VERSION_ATLEAST(2, 0, 8)
 // <https://hg.libsdl.org/SDL/rev/dfde5d3f9781>
 # define SCRCPY_SDL_HAS_HINT_VIDEO_X11_NET_WM_BYPASS_COMPOSITOR
+// <https://wiki.libsdl.org/SDL_GetYUVConversionModeForResolution>
+# define SCRCPY_SDL_HAS_YUV_CONVERSION_MODE
+#endif
+
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+// <https://wiki.libsdl.org/SDL_UpdateNVTexture>
+# define SCRCPY_SDL_HAS_UPDATE_NV_TEXTURE
 #endif
 
 #endif
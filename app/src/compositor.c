@@ -0,0 +1,273 @@
+#include "compositor.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "config.h"
+#include "icon.xpm"
+#include "screen.h"
+#include "tiny_xpm.h"
+#include "trace.h"
+#include "util/log.h"
+
+#define DEFAULT_WINDOW_WIDTH 1280
+#define DEFAULT_WINDOW_HEIGHT 800
+
+static void
+init_opengl(struct compositor *compositor, const char *renderer_name,
+            bool mipmaps) {
+    compositor->mipmaps = false;
+
+    // starts with "opengl"
+    compositor->use_opengl =
+        renderer_name && !strncmp(renderer_name, "opengl", 6);
+    if (!compositor->use_opengl) {
+        return;
+    }
+
+    struct sc_opengl *gl = &compositor->gl;
+    sc_opengl_init(gl);
+    LOGI("OpenGL version: %s", gl->version);
+
+    // the tiles are typically heavily downscaled, trilinear filtering avoids
+    // aliasing
+    if (mipmaps) {
+        compositor->mipmaps =
+            sc_opengl_version_at_least(gl, 3, 0, /* OpenGL 3.0+ */
+                                           2, 0  /* OpenGL ES 2.0+ */);
+        if (!compositor->mipmaps) {
+            LOGW("Trilinear filtering disabled "
+                 "(OpenGL 3.0+ or ES 2.0+ required)");
+        }
+    }
+}
+
+bool
+compositor_init(struct compositor *compositor, const char *window_title,
+                unsigned tile_count, uint16_t window_width,
+                uint16_t window_height, bool always_on_top,
+                bool window_borderless, bool mipmaps, bool vsync) {
+    assert(tile_count);
+
+    compositor->tiles = SDL_calloc(tile_count, sizeof(*compositor->tiles));
+    if (!compositor->tiles) {
+        LOGC("Could not allocate tiles");
+        return false;
+    }
+    compositor->tile_count = 0;
+
+    // as square as possible
+    unsigned columns = 1;
+    while (columns * columns < tile_count) {
+        ++columns;
+    }
+    compositor->columns = columns;
+    compositor->rows = (tile_count + compositor->columns - 1)
+                     / compositor->columns;
+
+    uint32_t window_flags = SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE;
+#ifdef HIDPI_SUPPORT
+    window_flags |= SDL_WINDOW_ALLOW_HIGHDPI;
+#endif
+    if (always_on_top) {
+#ifdef SCRCPY_SDL_HAS_WINDOW_ALWAYS_ON_TOP
+        window_flags |= SDL_WINDOW_ALWAYS_ON_TOP;
+#else
+        LOGW("The 'always on top' flag is not available "
+             "(compile with SDL >= 2.0.5 to enable it)");
+#endif
+    }
+    if (window_borderless) {
+        window_flags |= SDL_WINDOW_BORDERLESS;
+    }
+
+    int w = window_width ? window_width : DEFAULT_WINDOW_WIDTH;
+    int h = window_height ? window_height : DEFAULT_WINDOW_HEIGHT;
+    compositor->window = SDL_CreateWindow(window_title,
+                                          SDL_WINDOWPOS_UNDEFINED,
+                                          SDL_WINDOWPOS_UNDEFINED, w, h,
+                                          window_flags);
+    if (!compositor->window) {
+        LOGC("Could not create window: %s", SDL_GetError());
+        SDL_free(compositor->tiles);
+        return false;
+    }
+
+    SDL_Surface *icon = read_xpm(icon_xpm);
+    if (icon) {
+        SDL_SetWindowIcon(compositor->window, icon);
+        SDL_FreeSurface(icon);
+    } else {
+        LOGW("Could not load icon");
+    }
+
+    uint32_t renderer_flags = SDL_RENDERER_ACCELERATED;
+    if (vsync) {
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    compositor->renderer = SDL_CreateRenderer(compositor->window, -1,
+                                              renderer_flags);
+    if (!compositor->renderer) {
+        LOGC("Could not create renderer: %s", SDL_GetError());
+        SDL_DestroyWindow(compositor->window);
+        SDL_free(compositor->tiles);
+        return false;
+    }
+
+    SDL_RendererInfo renderer_info;
+    int r = SDL_GetRendererInfo(compositor->renderer, &renderer_info);
+    const char *renderer_name = r ? NULL : renderer_info.name;
+    LOGI("Renderer: %s", renderer_name ? renderer_name : "(unknown)");
+
+    init_opengl(compositor, renderer_name, mipmaps);
+
+    compositor->fullscreen = false;
+    compositor->shown = false;
+    compositor->render_requested = false;
+    compositor->focus = NULL;
+
+    LOGI("Tiled window: %ux%u", compositor->columns, compositor->rows);
+    return true;
+}
+
+void
+compositor_destroy(struct compositor *compositor) {
+    // the tiles must have been released (their textures belong to the
+    // renderer)
+    SDL_DestroyRenderer(compositor->renderer);
+    SDL_DestroyWindow(compositor->window);
+    SDL_free(compositor->tiles);
+}
+
+unsigned
+compositor_add_tile(struct compositor *compositor, struct screen *screen) {
+    unsigned index = compositor->tile_count++;
+    assert(index < compositor->columns * compositor->rows);
+    compositor->tiles[index] = screen;
+    return index;
+}
+
+void
+compositor_remove_tile(struct compositor *compositor, unsigned index) {
+    assert(index < compositor->tile_count);
+    if (compositor->focus == compositor->tiles[index]) {
+        compositor->focus = NULL;
+    }
+    // keep the other tiles in place, the cell becomes black
+    compositor->tiles[index] = NULL;
+    compositor_request_render(compositor);
+}
+
+void
+compositor_get_tile_bounds(struct compositor *compositor, unsigned index,
+                           SDL_Rect *bounds) {
+    int dw;
+    int dh;
+    SDL_GL_GetDrawableSize(compositor->window, &dw, &dh);
+
+    unsigned column = index % compositor->columns;
+    unsigned row = index / compositor->columns;
+    // distribute the remaining pixels, so that the cells cover the window
+    bounds->x = dw * column / compositor->columns;
+    bounds->y = dh * row / compositor->rows;
+    bounds->w = dw * (column + 1) / compositor->columns - bounds->x;
+    bounds->h = dh * (row + 1) / compositor->rows - bounds->y;
+}
+
+struct screen *
+compositor_get_tile_at(struct compositor *compositor, int32_t x, int32_t y) {
+    int ww;
+    int wh;
+    SDL_GetWindowSize(compositor->window, &ww, &wh);
+    if (x < 0 || y < 0 || x >= ww || y >= wh) {
+        return NULL;
+    }
+
+    unsigned column = (int64_t) x * compositor->columns / ww;
+    unsigned row = (int64_t) y * compositor->rows / wh;
+    unsigned index = row * compositor->columns + column;
+    if (index >= compositor->tile_count) {
+        return NULL;
+    }
+    return compositor->tiles[index];
+}
+
+void
+compositor_request_render(struct compositor *compositor) {
+    compositor->render_requested = true;
+}
+
+void
+compositor_render_if_requested(struct compositor *compositor) {
+    if (!compositor->render_requested) {
+        return;
+    }
+    compositor->render_requested = false;
+
+    SDL_RenderClear(compositor->renderer);
+    for (unsigned i = 0; i < compositor->tile_count; ++i) {
+        struct screen *screen = compositor->tiles[i];
+        if (screen && screen->has_frame) {
+            screen_draw(screen);
+        }
+    }
+    // a single present for all the devices
+    trace_begin("present");
+    SDL_RenderPresent(compositor->renderer);
+    trace_end();
+}
+
+void
+compositor_show_window(struct compositor *compositor) {
+    if (!compositor->shown) {
+        SDL_ShowWindow(compositor->window);
+        compositor->shown = true;
+    }
+}
+
+void
+compositor_switch_fullscreen(struct compositor *compositor) {
+    uint32_t new_mode =
+        compositor->fullscreen ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP;
+    if (SDL_SetWindowFullscreen(compositor->window, new_mode)) {
+        LOGW("Could not switch fullscreen mode: %s", SDL_GetError());
+        return;
+    }
+
+    compositor->fullscreen = !compositor->fullscreen;
+    LOGD("Switched to %s mode",
+         compositor->fullscreen ? "fullscreen" : "windowed");
+}
+
+void
+compositor_handle_window_event(struct compositor *compositor,
+                               const SDL_WindowEvent *event) {
+    switch (event->event) {
+        case SDL_WINDOWEVENT_EXPOSED:
+            compositor_request_render(compositor);
+            break;
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+            for (unsigned i = 0; i < compositor->tile_count; ++i) {
+                struct screen *screen = compositor->tiles[i];
+                if (screen) {
+                    // recompute the content rectangle in the new cell
+                    screen_render(screen, true);
+                }
+            }
+            compositor_request_render(compositor);
+            break;
+    }
+}
+
+int
+compositor_get_refresh_rate(struct compositor *compositor) {
+    int display_index = SDL_GetWindowDisplayIndex(compositor->window);
+    if (display_index < 0) {
+        return 0;
+    }
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(display_index, &mode)) {
+        return 0;
+    }
+    return mode.refresh_rate;
+}
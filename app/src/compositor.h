@@ -0,0 +1,86 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#include "config.h"
+#include "common.h"
+#include "opengl.h"
+
+struct screen;
+
+// A single window displaying the screens of several devices in a grid.
+//
+// Each screen (a "tile") keeps its own texture, created on the shared
+// renderer, and is drawn downscaled (by the GPU) into its cell. A frame update
+// only requests a render: all the tiles are drawn and presented at once.
+struct compositor {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    bool use_opengl;
+    struct sc_opengl gl;
+    bool mipmaps;
+
+    struct screen **tiles; // NULL for a released tile
+    unsigned tile_count;
+    unsigned columns;
+    unsigned rows;
+
+    bool fullscreen;
+    bool shown;
+    bool render_requested;
+    // the tile which receives the keyboard events and the mouse drags
+    struct screen *focus;
+};
+
+// create the window and the renderer for a grid of tile_count tiles
+// (window_width and window_height may be 0 for a default size)
+bool
+compositor_init(struct compositor *compositor, const char *window_title,
+                unsigned tile_count, uint16_t window_width,
+                uint16_t window_height, bool always_on_top,
+                bool window_borderless, bool mipmaps, bool vsync);
+
+void
+compositor_destroy(struct compositor *compositor);
+
+// register a screen, return its tile index
+unsigned
+compositor_add_tile(struct compositor *compositor, struct screen *screen);
+
+void
+compositor_remove_tile(struct compositor *compositor, unsigned index);
+
+// get the cell of a tile, in drawable coordinates
+void
+compositor_get_tile_bounds(struct compositor *compositor, unsigned index,
+                           SDL_Rect *bounds);
+
+// return the tile at the given position (in window coordinates), or NULL
+struct screen *
+compositor_get_tile_at(struct compositor *compositor, int32_t x, int32_t y);
+
+// schedule a render (on the next compositor_render_if_requested())
+void
+compositor_request_render(struct compositor *compositor);
+
+// draw all the tiles and present, if requested
+void
+compositor_render_if_requested(struct compositor *compositor);
+
+void
+compositor_show_window(struct compositor *compositor);
+
+void
+compositor_switch_fullscreen(struct compositor *compositor);
+
+void
+compositor_handle_window_event(struct compositor *compositor,
+                               const SDL_WindowEvent *event);
+
+int
+compositor_get_refresh_rate(struct compositor *compositor);
+
+#endif
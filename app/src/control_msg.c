@@ -74,14 +74,36 @@ control_msg_serialize(const struct control_msg *msg, unsigned char *buf) {
                                       &buf[2]);
             return 2 + len;
         }
+        case CONTROL_MSG_TYPE_SET_CLIPBOARD_PART:
+            return 1 + write_string(msg->set_clipboard.text,
+                                    CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH,
+                                    &buf[1]);
         case CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
             buf[1] = msg->set_screen_power_mode.mode;
             return 2;
+        case CONTROL_MSG_TYPE_PING:
+            buffer_write64be(&buf[1], msg->ping.timestamp);
+            return 9;
+        case CONTROL_MSG_TYPE_SET_BIT_RATE:
+            buffer_write32be(&buf[1], msg->set_bit_rate.bit_rate);
+            return 5;
+        case CONTROL_MSG_TYPE_SET_CROP:
+            write_position(&buf[1], &msg->set_crop.position);
+            buffer_write32be(&buf[13], msg->set_crop.width);
+            buffer_write32be(&buf[17], msg->set_crop.height);
+            return 21;
+        case CONTROL_MSG_TYPE_SET_MAX_SIZE:
+            buffer_write16be(&buf[1], msg->set_max_size.max_size);
+            return 3;
+        case CONTROL_MSG_TYPE_SET_VIDEO_PAUSED:
+            buf[1] = msg->set_video_paused.paused;
+            return 2;
         case CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
         case CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
         case CONTROL_MSG_TYPE_COLLAPSE_NOTIFICATION_PANEL:
         case CONTROL_MSG_TYPE_GET_CLIPBOARD:
         case CONTROL_MSG_TYPE_ROTATE_DEVICE:
+        case CONTROL_MSG_TYPE_REQUEST_KEY_FRAME:
             // no additional data
             return 1;
         default:
@@ -90,6 +112,93 @@ control_msg_serialize(const struct control_msg *msg, unsigned char *buf) {
     }
 }
 
+void
+control_msg_compact_state_init(struct control_msg_compact_state *state) {
+    state->screen_size.width = 0;
+    state->screen_size.height = 0;
+    state->point.x = 0;
+    state->point.y = 0;
+}
+
+static uint64_t
+zigzag_encode(int64_t value) {
+    // small negative values are encoded as small unsigned values
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+// write the SET_SCREEN_SIZE message if necessary, then the position delta
+static size_t
+write_position_compact(const struct position *position,
+                       struct control_msg_compact_state *state,
+                       unsigned char *prefix, unsigned char *buf,
+                       size_t *prefix_len) {
+    const struct size *size = &position->screen_size;
+    if (size->width != state->screen_size.width
+            || size->height != state->screen_size.height) {
+        prefix[0] = CONTROL_MSG_TYPE_SET_SCREEN_SIZE;
+        buffer_write16be(&prefix[1], size->width);
+        buffer_write16be(&prefix[3], size->height);
+        *prefix_len = 5;
+        state->screen_size = *size;
+    } else {
+        *prefix_len = 0;
+    }
+
+    const struct point *point = &position->point;
+    int64_t dx = (int64_t) point->x - state->point.x;
+    int64_t dy = (int64_t) point->y - state->point.y;
+    size_t len = buffer_write_varint(buf, zigzag_encode(dx));
+    len += buffer_write_varint(&buf[len], zigzag_encode(dy));
+    state->point = *point;
+    return len;
+}
+
+size_t
+control_msg_serialize_compact(const struct control_msg *msg,
+                              struct control_msg_compact_state *state,
+                              unsigned char *buf) {
+    // The screen size message, if any, must be written first. Its size is
+    // known in advance: reserve it, and move the message if it is not needed.
+    unsigned char *msg_buf = &buf[5];
+    size_t prefix_len;
+    size_t len;
+    switch (msg->type) {
+        case CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            msg_buf[0] = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT_COMPACT;
+            msg_buf[1] = msg->inject_touch_event.action;
+            len = 2;
+            // mouse (-1) and virtual finger (-2) ids become 1 and 0
+            len += buffer_write_varint(&msg_buf[len],
+                                       msg->inject_touch_event.pointer_id + 2);
+            len += write_position_compact(&msg->inject_touch_event.position,
+                                          state, buf, &msg_buf[len],
+                                          &prefix_len);
+            msg_buf[len++] =
+                to_fixed_point_16(msg->inject_touch_event.pressure) >> 8;
+            len += buffer_write_varint(&msg_buf[len],
+                                       msg->inject_touch_event.buttons);
+            break;
+        case CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+            msg_buf[0] = CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT_COMPACT;
+            len = 1;
+            len += write_position_compact(&msg->inject_scroll_event.position,
+                                          state, buf, &msg_buf[len],
+                                          &prefix_len);
+            len += buffer_write_varint(&msg_buf[len],
+                    zigzag_encode(msg->inject_scroll_event.hscroll));
+            len += buffer_write_varint(&msg_buf[len],
+                    zigzag_encode(msg->inject_scroll_event.vscroll));
+            break;
+        default:
+            return control_msg_serialize(msg, buf);
+    }
+
+    if (!prefix_len) {
+        memmove(buf, msg_buf, len);
+    }
+    return prefix_len + len;
+}
+
 void
 control_msg_destroy(struct control_msg *msg) {
     switch (msg->type) {
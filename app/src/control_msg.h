@@ -10,10 +10,11 @@
 #include "android/keycodes.h"
 #include "common.h"
 
-#define CONTROL_MSG_MAX_SIZE (1 << 18) // 256k
+#define CONTROL_MSG_MAX_SIZE (1 << 14) // 16k
 
 #define CONTROL_MSG_INJECT_TEXT_MAX_LENGTH 300
 // type: 1 byte; paste flag: 1 byte; length: 4 bytes
+// a larger clipboard text is sent in several chunks of (at most) this length
 #define CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH (CONTROL_MSG_MAX_SIZE - 6)
 
 #define POINTER_ID_MOUSE UINT64_C(-1);
@@ -31,6 +32,19 @@ enum control_msg_type {
     CONTROL_MSG_TYPE_SET_CLIPBOARD,
     CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE,
     CONTROL_MSG_TYPE_ROTATE_DEVICE,
+    CONTROL_MSG_TYPE_PING,
+    CONTROL_MSG_TYPE_SET_BIT_RATE,
+    CONTROL_MSG_TYPE_REQUEST_KEY_FRAME,
+    // compact variants, only written by control_msg_serialize_compact()
+    CONTROL_MSG_TYPE_SET_SCREEN_SIZE,
+    CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT_COMPACT,
+    CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT_COMPACT,
+    // a non-final chunk of a SET_CLIPBOARD text (in set_clipboard, the paste
+    // flag is ignored), only written by the controller
+    CONTROL_MSG_TYPE_SET_CLIPBOARD_PART,
+    CONTROL_MSG_TYPE_SET_CROP,
+    CONTROL_MSG_TYPE_SET_MAX_SIZE,
+    CONTROL_MSG_TYPE_SET_VIDEO_PAUSED,
 };
 
 enum screen_power_mode {
@@ -70,14 +84,60 @@ struct control_msg {
         struct {
             enum screen_power_mode mode;
         } set_screen_power_mode;
+        struct {
+            // local time (in microseconds) when the ping is sent, echoed back
+            // by the device in the pong device message
+            uint64_t timestamp;
+        } ping;
+        struct {
+            uint32_t bit_rate;
+        } set_bit_rate;
+        struct {
+            // the top-left corner, in frame coordinates
+            struct position position;
+            // in frame coordinates, 0 to restore the initial crop
+            uint32_t width;
+            uint32_t height;
+        } set_crop;
+        struct {
+            // 0 to restore the initial max size
+            uint16_t max_size;
+        } set_max_size;
+        struct {
+            // suspend the encoders (a key frame is produced on resume)
+            bool paused;
+        } set_video_paused;
     };
 };
 
+// state shared by the consecutive compact messages of a session (the device
+// maintains the same state while parsing)
+struct control_msg_compact_state {
+    struct size screen_size; // the last screen size sent
+    struct point point; // the last position sent
+};
+
 // buf size must be at least CONTROL_MSG_MAX_SIZE
 // return the number of bytes written
 size_t
 control_msg_serialize(const struct control_msg *msg, unsigned char *buf);
 
+void
+control_msg_compact_state_init(struct control_msg_compact_state *state);
+
+// Like control_msg_serialize(), but write touch and scroll events in a compact
+// form: the screen size is only sent when it changes (in a separate message
+// written just before), the pointer id, the coordinates (as deltas from the
+// previous position) and the scroll amounts are varints, and the pressure is
+// stored in 8 bits.
+//
+// buf size must be at least CONTROL_MSG_MAX_SIZE
+// return the number of bytes written
+size_t
+control_msg_serialize_compact(const struct control_msg *msg,
+                              struct control_msg_compact_state *state,
+                              unsigned char *buf);
+
 void
 control_msg_destroy(struct control_msg *msg);
 
@@ -1,96 +1,667 @@
 #include "controller.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <libavutil/time.h>
+#include <SDL2/SDL_timer.h>
 
 #include "config.h"
+#include "trace.h"
 #include "util/lock.h"
 #include "util/log.h"
+#include "util/str_util.h"
 
-bool
-controller_init(struct controller *controller, socket_t control_socket) {
-    cbuf_init(&controller->queue);
+// interval between two clock synchronization pings
+#define PING_INTERVAL_MS 1000
+// the first pings are sent faster, to synchronize quickly on start
+#define PING_INITIAL_INTERVAL_MS 50
+
+// minimum interval between two warnings about dropped messages
+#define DROP_LOG_INTERVAL_MS 1000
+
+// the refresh rates reported out of this range (in millihertz) are ignored
+#define RESAMPLING_MIN_RATE 20000
+#define RESAMPLING_MAX_RATE 500000
+
+// the velocity is not estimated from moves farther apart (in microseconds),
+// the pointer is considered stopped in between
+#define PREDICTION_MAX_SAMPLE_INTERVAL 50000
 
-    if (!receiver_init(&controller->receiver, control_socket)) {
+bool
+controller_init(struct controller *controller, socket_t control_socket,
+                struct clock_sync *clock_sync, struct metrics *metrics,
+                unsigned queue_size, bool resample_input,
+                bool predict_pointer) {
+    assert(queue_size);
+    controller->queue = SDL_malloc(queue_size * sizeof(*controller->queue));
+    if (!controller->queue) {
+        LOGC("Could not allocate control message queue");
         return false;
     }
 
+    if (!receiver_init(&controller->receiver, control_socket, clock_sync)) {
+        goto error_free_queue;
+    }
+
     if (!(controller->mutex = SDL_CreateMutex())) {
-        receiver_destroy(&controller->receiver);
-        return false;
+        goto error_destroy_receiver;
     }
 
     if (!(controller->msg_cond = SDL_CreateCond())) {
-        receiver_destroy(&controller->receiver);
-        SDL_DestroyMutex(controller->mutex);
-        return false;
+        goto error_destroy_mutex;
     }
 
     controller->control_socket = control_socket;
     controller->stopped = false;
+    controller->queue_capacity = queue_size;
+    controller->queue_head = 0;
+    controller->queue_count = 0;
+    controller->bulk_queue_head = 0;
+    controller->bulk_queue_count = 0;
+    controller->dropped = 0;
+    controller->next_drop_log = SDL_GetTicks();
+    controller->metrics = metrics;
+    controller->resample_input = resample_input;
+    controller->predict_pointer = predict_pointer;
+    controller->has_last_move = false;
+    controller->has_velocity = false;
+    control_msg_compact_state_init(&controller->compact_state);
+    controller->next_move = 0;
+    controller->has_clipboard = false;
+    controller->next_ping = 0;
+    controller->ping_count = 0;
+
+    return true;
 
+error_destroy_mutex:
+    SDL_DestroyMutex(controller->mutex);
+error_destroy_receiver:
+    receiver_destroy(&controller->receiver);
+error_free_queue:
+    SDL_free(controller->queue);
+
+    return false;
+}
+
+// must be called with the mutex locked
+static bool
+queue_take(struct controller *controller, struct control_msg *msg) {
+    if (!controller->queue_count) {
+        return false;
+    }
+    *msg = controller->queue[controller->queue_head];
+    controller->queue_head =
+        (controller->queue_head + 1) % controller->queue_capacity;
+    --controller->queue_count;
+    return true;
+}
+
+// must be called with the mutex locked
+static bool
+bulk_queue_take(struct controller *controller, struct control_msg *msg) {
+    if (!controller->bulk_queue_count) {
+        return false;
+    }
+    *msg = controller->bulk_queue[controller->bulk_queue_head];
+    controller->bulk_queue_head =
+        (controller->bulk_queue_head + 1) % CONTROLLER_BULK_QUEUE_SIZE;
+    --controller->bulk_queue_count;
     return true;
 }
 
+// must be called with the mutex locked
+static struct control_msg *
+queue_last(struct controller *controller) {
+    assert(controller->queue_count);
+    unsigned index = (controller->queue_head + controller->queue_count - 1)
+                   % controller->queue_capacity;
+    return &controller->queue[index];
+}
+
 void
 controller_destroy(struct controller *controller) {
+    if (controller->dropped) {
+        LOGW("%" PRIu64 " control messages dropped (queue full)",
+             controller->dropped);
+    }
+
     SDL_DestroyCond(controller->msg_cond);
     SDL_DestroyMutex(controller->mutex);
 
     struct control_msg msg;
-    while (cbuf_take(&controller->queue, &msg)) {
+    while (queue_take(controller, &msg)) {
+        control_msg_destroy(&msg);
+    }
+    SDL_free(controller->queue);
+    while (bulk_queue_take(controller, &msg)) {
         control_msg_destroy(&msg);
     }
 
+    if (controller->has_clipboard) {
+        control_msg_destroy(&controller->clipboard);
+    }
+
     receiver_destroy(&controller->receiver);
 }
 
+static bool
+is_touch_move(const struct control_msg *msg) {
+    return msg->type == CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT
+        && msg->inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE;
+}
+
+// a move event may replace the previous one if it concerns the same pointer
+static bool
+can_replace(const struct control_msg *prev, const struct control_msg *msg) {
+    return is_touch_move(prev) && is_touch_move(msg)
+        && prev->inject_touch_event.pointer_id
+            == msg->inject_touch_event.pointer_id
+        && prev->inject_touch_event.buttons
+            == msg->inject_touch_event.buttons;
+}
+
+// the bulk messages must not delay the others
+static bool
+is_bulk(const struct control_msg *msg) {
+    return msg->type == CONTROL_MSG_TYPE_SET_CLIPBOARD;
+}
+
+// must be called with the mutex locked
+static bool
+queue_is_full(struct controller *controller) {
+    return controller->queue_count == controller->queue_capacity;
+}
+
+// must be called with the mutex locked
+static bool
+bulk_queue_is_full(struct controller *controller) {
+    return controller->bulk_queue_count == CONTROLLER_BULK_QUEUE_SIZE;
+}
+
+// must be called with the mutex locked, on non-empty queue
+static bool
+replace_last_move(struct controller *controller,
+                  const struct control_msg *msg) {
+    struct control_msg *last = queue_last(controller);
+    if (!can_replace(last, msg)) {
+        return false;
+    }
+    // a touch event owns no data, no need to destroy it
+    *last = *msg;
+    return true;
+}
+
+// must be called with the mutex locked
+// remove the oldest queued touch move, to make room for another message (an
+// intermediate position may be lost without consequence)
+// return false if no move is queued
+static bool
+evict_move(struct controller *controller) {
+    unsigned capacity = controller->queue_capacity;
+    for (unsigned i = 0; i < controller->queue_count; ++i) {
+        unsigned index = (controller->queue_head + i) % capacity;
+        if (is_touch_move(&controller->queue[index])) {
+            // shift the next messages (a touch event owns no data)
+            for (unsigned j = i + 1; j < controller->queue_count; ++j) {
+                unsigned from = (controller->queue_head + j) % capacity;
+                controller->queue[index] = controller->queue[from];
+                index = from;
+            }
+            --controller->queue_count;
+            return true;
+        }
+    }
+    return false;
+}
+
+// must be called with the mutex locked
+static void
+update_velocity(struct controller *controller, const struct control_msg *msg) {
+    if (msg->type != CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT) {
+        return;
+    }
+
+    uint64_t pointer_id = msg->inject_touch_event.pointer_id;
+    if (!is_touch_move(msg)) {
+        if (controller->has_last_move
+                && controller->last_move_pointer_id == pointer_id) {
+            // the pointer is down or up, the drag is finished
+            controller->has_last_move = false;
+            controller->has_velocity = false;
+        }
+        return;
+    }
+
+    struct point point = msg->inject_touch_event.position.point;
+    int64_t now = av_gettime_relative();
+
+    controller->has_velocity = false;
+    if (controller->has_last_move
+            && controller->last_move_pointer_id == pointer_id) {
+        int64_t dt = now - controller->last_move_time;
+        if (dt > 0 && dt <= PREDICTION_MAX_SAMPLE_INTERVAL) {
+            controller->velocity_x =
+                (float) (point.x - controller->last_move_point.x) / dt;
+            controller->velocity_y =
+                (float) (point.y - controller->last_move_point.y) / dt;
+            controller->has_velocity = true;
+        }
+    }
+
+    controller->has_last_move = true;
+    controller->last_move_pointer_id = pointer_id;
+    controller->last_move_point = point;
+    controller->last_move_time = now;
+}
+
+// must be called with the mutex locked
+static void
+count_drop(struct controller *controller) {
+    ++controller->dropped;
+    metrics_add(&controller->metrics->controller_dropped, 1);
+    // on full queue, the messages are dropped in a row, do not flood the log
+    uint32_t now = SDL_GetTicks();
+    if ((int32_t) (now - controller->next_drop_log) >= 0) {
+        LOGW("Control message dropped, queue full (%" PRIu64 " total)",
+             controller->dropped);
+        controller->next_drop_log = now + DROP_LOG_INTERVAL_MS;
+    }
+}
+
+// must be called with the mutex locked
+static bool
+push_bulk_msg(struct controller *controller, const struct control_msg *msg) {
+    if (bulk_queue_is_full(controller)) {
+        count_drop(controller);
+        return false;
+    }
+
+    unsigned index =
+        (controller->bulk_queue_head + controller->bulk_queue_count)
+        % CONTROLLER_BULK_QUEUE_SIZE;
+    controller->bulk_queue[index] = *msg;
+    ++controller->bulk_queue_count;
+    // the controller thread may hold a pending move
+    cond_signal(controller->msg_cond);
+    return true;
+}
+
 bool
 controller_push_msg(struct controller *controller,
-                      const struct control_msg *msg) {
+                    const struct control_msg *msg) {
+    // the contention with the controller thread
+    trace_begin("lock");
     mutex_lock(controller->mutex);
-    bool was_empty = cbuf_is_empty(&controller->queue);
-    bool res = cbuf_push(&controller->queue, *msg);
-    if (was_empty) {
+    trace_end();
+    if (is_bulk(msg)) {
+        bool ok = push_bulk_msg(controller, msg);
+        mutex_unlock(controller->mutex);
+        return ok;
+    }
+
+    if (controller->predict_pointer) {
+        update_velocity(controller, msg);
+    }
+
+    if (controller->resample_input && controller->queue_count
+            && replace_last_move(controller, msg)) {
+        // the pending move will be sent on the next refresh period of the
+        // device, it now has the most recent position
+        mutex_unlock(controller->mutex);
+        return true;
+    }
+
+    if (queue_is_full(controller)) {
+        // Never block the caller (the main thread or a stream thread)
+        if (is_touch_move(msg)) {
+            // Only the last position matters: merge it with the last queued
+            // move, or drop it (an intermediate position may be lost without
+            // consequence, so it is not reported as a failure)
+            if (!replace_last_move(controller, msg)) {
+                count_drop(controller);
+            }
+            mutex_unlock(controller->mutex);
+            return true;
+        }
+
+        // Any other message (e.g. a touch ACTION_UP or a key event) should
+        // not be lost: make room by dropping a queued move instead
+        if (!evict_move(controller)) {
+            count_drop(controller);
+            mutex_unlock(controller->mutex);
+            return false;
+        }
+        count_drop(controller);
+    }
+
+    bool was_empty = !controller->queue_count;
+    unsigned index = (controller->queue_head + controller->queue_count)
+                   % controller->queue_capacity;
+    controller->queue[index] = *msg;
+    ++controller->queue_count;
+    // with resampling, a single pending move may be held by the controller
+    // thread, which must not wait anymore once another message is queued
+    if (was_empty
+            || (controller->resample_input && controller->queue_count == 2)) {
         cond_signal(controller->msg_cond);
     }
     mutex_unlock(controller->mutex);
-    return res;
+    return true;
 }
 
 static bool
 process_msg(struct controller *controller,
               const struct control_msg *msg) {
-    static unsigned char serialized_msg[CONTROL_MSG_MAX_SIZE];
+    unsigned char *serialized_msg = controller->buf;
+    trace_begin("serialize");
     int length = control_msg_serialize(msg, serialized_msg);
+    trace_end();
     if (!length) {
         return false;
     }
+    trace_begin("send");
     int w = net_send_all(controller->control_socket, serialized_msg, length);
+    trace_end();
     return w == length;
 }
 
+// return the input period of the device, in microseconds, or 0 if the input
+// must not be resampled
+static int64_t
+get_move_period(struct controller *controller) {
+    if (!controller->resample_input) {
+        return 0;
+    }
+    uint32_t rate = receiver_get_refresh_rate(&controller->receiver);
+    if (rate < RESAMPLING_MIN_RATE || rate > RESAMPLING_MAX_RATE) {
+        // unknown (or not trusted)
+        return 0;
+    }
+    return INT64_C(1000000000) / rate;
+}
+
+static void
+schedule_next_move(struct controller *controller) {
+    int64_t period = get_move_period(controller);
+    if (!period) {
+        return;
+    }
+
+    int64_t now = av_gettime_relative();
+    if (now - controller->next_move > period) {
+        // the pointer was idle, start a new period
+        controller->next_move = now + period;
+    } else {
+        // stay aligned on regular periods, even if the controller thread is
+        // woken up late (the waiting delays are rounded to milliseconds)
+        controller->next_move += period;
+    }
+}
+
+// must be called with the mutex locked
+// return the delay (in milliseconds) to hold the queued messages, or 0 if they
+// must be sent now
+static uint32_t
+resampling_delay(struct controller *controller) {
+    if (controller->queue_count != 1
+            || !is_touch_move(&controller->queue[controller->queue_head])) {
+        // never delay any other message
+        return 0;
+    }
+
+    if (!get_move_period(controller)) {
+        return 0;
+    }
+
+    int64_t delay = controller->next_move - av_gettime_relative();
+    // round up, to not wake up too early
+    return delay > 0 ? (delay + 999) / 1000 : 0;
+}
+
+// a pending move held for resampling is not taken (the controller thread may
+// be woken up before its time to send a bulk message)
+static bool
+take_msg(struct controller *controller, struct control_msg *msg) {
+    mutex_lock(controller->mutex);
+    if (controller->resample_input && resampling_delay(controller)) {
+        mutex_unlock(controller->mutex);
+        return false;
+    }
+    bool non_empty = queue_take(controller, msg);
+    mutex_unlock(controller->mutex);
+    return non_empty;
+}
+
+static bool
+take_bulk_msg(struct controller *controller, struct control_msg *msg) {
+    mutex_lock(controller->mutex);
+    bool non_empty = bulk_queue_take(controller, msg);
+    mutex_unlock(controller->mutex);
+    return non_empty;
+}
+
+static int32_t
+clamp(int32_t value, uint16_t size) {
+    if (value < 0) {
+        return 0;
+    }
+    if (value >= size) {
+        return size ? size - 1 : 0;
+    }
+    return value;
+}
+
+// must be called with the mutex locked
+// extrapolate the position of the single pending move to now, to compensate
+// the delay it has been held for
+static void
+predict_pending_move(struct controller *controller) {
+    if (controller->queue_count != 1 || !controller->has_velocity) {
+        return;
+    }
+
+    struct control_msg *msg = &controller->queue[controller->queue_head];
+    if (!is_touch_move(msg) || msg->inject_touch_event.pointer_id
+                                != controller->last_move_pointer_id) {
+        return;
+    }
+
+    int64_t dt = av_gettime_relative() - controller->last_move_time;
+    int64_t period = get_move_period(controller);
+    if (dt <= 0 || dt > period) {
+        // do not extrapolate further than one period
+        return;
+    }
+
+    struct position *position = &msg->inject_touch_event.position;
+    int32_t x = controller->last_move_point.x + controller->velocity_x * dt;
+    int32_t y = controller->last_move_point.y + controller->velocity_y * dt;
+    // stay within the screen
+    position->point.x = clamp(x, position->screen_size.width);
+    position->point.y = clamp(y, position->screen_size.height);
+}
+
+// serialize the next chunk of the pending clipboard text
+static size_t
+serialize_clipboard_chunk(struct controller *controller, unsigned char *buf) {
+    assert(controller->has_clipboard);
+    struct control_msg *clipboard = &controller->clipboard;
+    const char *text = &clipboard->set_clipboard.text[
+                                            controller->clipboard_offset];
+    size_t len = utf8_truncation_index(text,
+                                       CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH);
+    bool last = !text[len];
+
+    // the chunk does not own its text
+    struct control_msg chunk;
+    chunk.type = last ? CONTROL_MSG_TYPE_SET_CLIPBOARD
+                      : CONTROL_MSG_TYPE_SET_CLIPBOARD_PART;
+    chunk.set_clipboard.text = (char *) text;
+    chunk.set_clipboard.paste = clipboard->set_clipboard.paste;
+    size_t size = control_msg_serialize(&chunk, buf);
+
+    if (last) {
+        control_msg_destroy(clipboard);
+        controller->has_clipboard = false;
+    } else {
+        controller->clipboard_offset += len;
+    }
+    return size;
+}
+
+// serialize the queued messages and send them at once
+static bool
+process_msgs(struct controller *controller) {
+    unsigned char *buf = controller->buf;
+    size_t length = 0;
+
+    // the previous message, its offset in buf and the compact state before
+    // it was serialized
+    struct control_msg prev;
+    bool has_prev = false;
+    size_t prev_offset = 0;
+    struct control_msg_compact_state prev_state;
+
+    struct control_msg_compact_state *state = &controller->compact_state;
+
+    bool has_move = false;
+
+    struct control_msg msg;
+    while (length < CONTROLLER_BATCH_SIZE && take_msg(controller, &msg)) {
+        has_move |= is_touch_move(&msg);
+
+        size_t offset;
+        if (has_prev && can_replace(&prev, &msg)) {
+            // consecutive moves of the same pointer are coalesced: only the
+            // last position matters, overwrite the previous one (the position
+            // delta must be computed as if it had never been serialized)
+            offset = prev_offset;
+            *state = prev_state;
+        } else {
+            offset = length;
+            prev_state = *state;
+        }
+
+        size_t len = control_msg_serialize_compact(&msg, state, &buf[offset]);
+        control_msg_destroy(&msg);
+        if (!len) {
+            return false;
+        }
+
+        // only the type and the touch event fields are read by can_replace()
+        prev = msg;
+        has_prev = true;
+        prev_offset = offset;
+        length = offset + len;
+    }
+
+    // the bulk messages are only sent once the input queue has been flushed
+    if (!controller->has_clipboard && length < CONTROLLER_BATCH_SIZE
+            && take_bulk_msg(controller, &msg)) {
+        assert(msg.type == CONTROL_MSG_TYPE_SET_CLIPBOARD);
+        // its text is sent by chunks
+        controller->clipboard = msg;
+        controller->clipboard_offset = 0;
+        controller->has_clipboard = true;
+    }
+
+    if (controller->has_clipboard && length < CONTROLLER_BATCH_SIZE) {
+        // at most one chunk per batch, to not delay the other messages
+        size_t len = serialize_clipboard_chunk(controller, &buf[length]);
+        if (!len) {
+            return false;
+        }
+        length += len;
+    }
+
+    if (!length) {
+        return true;
+    }
+
+    if (has_move) {
+        schedule_next_move(controller);
+    }
+
+    ssize_t w = net_send_all(controller->control_socket, buf, length);
+    return w >= 0 && (size_t) w == length;
+}
+
+static bool
+send_ping(struct controller *controller) {
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_PING;
+    // as late as possible, the queuing delay is not part of the round trip
+    msg.ping.timestamp = av_gettime_relative();
+    bool ok = process_msg(controller, &msg);
+
+    unsigned interval = controller->ping_count < CLOCK_SYNC_SAMPLES
+                      ? PING_INITIAL_INTERVAL_MS
+                      : PING_INTERVAL_MS;
+    ++controller->ping_count;
+    controller->next_ping = SDL_GetTicks() + interval;
+    return ok;
+}
+
+// return the delay until the next ping, or 0 if a ping must be sent now
+static uint32_t
+ping_delay(struct controller *controller) {
+    int32_t delay = (int32_t) (controller->next_ping - SDL_GetTicks());
+    return delay > 0 ? (uint32_t) delay : 0;
+}
+
+// must be called with the mutex locked
+// return the delay to wait for, or 0 if there is something to do now
+static uint32_t
+wait_delay(struct controller *controller) {
+    uint32_t delay = ping_delay(controller);
+    if (delay && (controller->has_clipboard
+                    || controller->bulk_queue_count)) {
+        // the next chunk must be sent
+        return 0;
+    }
+    if (delay && controller->queue_count) {
+        uint32_t hold = controller->resample_input
+                      ? resampling_delay(controller)
+                      : 0;
+        if (hold < delay) {
+            delay = hold;
+        }
+    }
+    return delay;
+}
+
 static int
 run_controller(void *data) {
     struct controller *controller = data;
+    trace_set_thread_name("controller");
+
+    controller->next_ping = SDL_GetTicks();
 
     for (;;) {
         mutex_lock(controller->mutex);
-        while (!controller->stopped && cbuf_is_empty(&controller->queue)) {
-            cond_wait(controller->msg_cond, controller->mutex);
+        uint32_t delay;
+        while (!controller->stopped && (delay = wait_delay(controller))) {
+            cond_wait_timeout(controller->msg_cond, controller->mutex, delay);
         }
         if (controller->stopped) {
             // stop immediately, do not process further msgs
             mutex_unlock(controller->mutex);
             break;
         }
-        struct control_msg msg;
-        bool non_empty = cbuf_take(&controller->queue, &msg);
-        assert(non_empty);
-        (void) non_empty;
+        if (!ping_delay(controller)) {
+            mutex_unlock(controller->mutex);
+            if (!send_ping(controller)) {
+                LOGD("Could not write ping to socket");
+                break;
+            }
+            continue;
+        }
+        if (controller->predict_pointer) {
+            predict_pending_move(controller);
+        }
         mutex_unlock(controller->mutex);
 
-        bool ok = process_msg(controller, &msg);
-        control_msg_destroy(&msg);
+        bool ok = process_msgs(controller);
         if (!ok) {
             LOGD("Could not write msg to socket");
             break;
@@ -132,3 +703,23 @@ controller_join(struct controller *controller) {
     SDL_WaitThread(controller->thread, NULL);
     receiver_join(&controller->receiver);
 }
+
+bool
+controller_restart(struct controller *controller, socket_t control_socket) {
+    // the threads are joined, only the queues may be accessed concurrently
+    controller->control_socket = control_socket;
+    receiver_set_socket(&controller->receiver, control_socket);
+
+    // the new server knows nothing about the previous messages
+    control_msg_compact_state_init(&controller->compact_state);
+    controller->clipboard_offset = 0;
+    controller->next_move = 0;
+
+    mutex_lock(controller->mutex);
+    controller->stopped = false;
+    controller->has_last_move = false;
+    controller->has_velocity = false;
+    mutex_unlock(controller->mutex);
+
+    return controller_start(controller);
+}
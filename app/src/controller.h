@@ -2,16 +2,23 @@
 #define CONTROLLER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <SDL2/SDL_mutex.h>
 #include <SDL2/SDL_thread.h>
 
 #include "config.h"
+#include "clock_sync.h"
 #include "control_msg.h"
+#include "metrics.h"
 #include "receiver.h"
-#include "util/cbuf.h"
 #include "util/net.h"
 
-struct control_msg_queue CBUF(struct control_msg, 64);
+// maximum number of pending bulk messages (see controller_push_msg())
+#define CONTROLLER_BULK_QUEUE_SIZE 16
+
+// the queued messages are serialized and sent by batches of (at least) this
+// size, in a single write
+#define CONTROLLER_BATCH_SIZE 4096
 
 struct controller {
     socket_t control_socket;
@@ -19,12 +26,66 @@ struct controller {
     SDL_mutex *mutex;
     SDL_cond *msg_cond;
     bool stopped;
-    struct control_msg_queue queue;
+    // ring buffer of pending messages
+    struct control_msg *queue;
+    unsigned queue_capacity;
+    unsigned queue_head; // index of the oldest message
+    unsigned queue_count;
+    // ring buffer of pending bulk messages, sent with a lower priority
+    struct control_msg bulk_queue[CONTROLLER_BULK_QUEUE_SIZE];
+    unsigned bulk_queue_head;
+    unsigned bulk_queue_count;
+    // number of messages dropped because the queue was full
+    uint64_t dropped;
+    uint32_t next_drop_log; // in SDL ticks
+    struct metrics *metrics;
     struct receiver receiver;
+
+    // see controller_init()
+    bool resample_input;
+    bool predict_pointer;
+
+    // the last move pushed (before any merge), to estimate the pointer
+    // velocity, protected by the mutex
+    bool has_last_move;
+    uint64_t last_move_pointer_id;
+    struct point last_move_point;
+    int64_t last_move_time;
+    bool has_velocity;
+    float velocity_x; // in pixels per microsecond
+    float velocity_y;
+
+    // only accessed from the controller thread
+    struct control_msg_compact_state compact_state;
+    // the serialized messages (any message fits after CONTROLLER_BATCH_SIZE
+    // bytes)
+    unsigned char buf[CONTROLLER_BATCH_SIZE + CONTROL_MSG_MAX_SIZE];
+    // the time at which the next move may be sent, if resampling is enabled
+    int64_t next_move;
+    // the SET_CLIPBOARD message being sent by chunks, and the length of its
+    // text already sent
+    bool has_clipboard;
+    struct control_msg clipboard;
+    size_t clipboard_offset;
+
+    // clock synchronization pings, only accessed from the controller thread
+    uint32_t next_ping; // in SDL ticks
+    unsigned ping_count;
 };
 
+// queue_size is the maximum number of pending messages
+//
+// If resample_input is set, the touch move events are sent at most once per
+// display refresh period of the device (as soon as it is reported): the moves
+// received in the meantime are merged, since the device could not use them
+// anyway. If predict_pointer is also set, the position of a move delayed this
+// way is extrapolated from the pointer velocity to the time it is actually
+// sent.
 bool
-controller_init(struct controller *controller, socket_t control_socket);
+controller_init(struct controller *controller, socket_t control_socket,
+                struct clock_sync *clock_sync, struct metrics *metrics,
+                unsigned queue_size, bool resample_input,
+                bool predict_pointer);
 
 void
 controller_destroy(struct controller *controller);
@@ -38,6 +99,27 @@ controller_stop(struct controller *controller);
 void
 controller_join(struct controller *controller);
 
+// start the controller again on a new connection, once it has been stopped and
+// joined
+//
+// The messages still queued are sent to the new server (a clipboard text being
+// sent by chunks is sent again from its start).
+bool
+controller_restart(struct controller *controller, socket_t control_socket);
+
+// Queue a message to be sent to the device
+//
+// If the queue is full (or if the input is resampled), a touch move event is
+// merged with the last queued move of the same pointer; on full queue, it is
+// dropped otherwise, and any other message replaces the oldest queued move.
+// This never blocks. Return false if the message has been dropped (it is still
+// owned by the caller); a dropped touch move is not reported.
+//
+// The bulk messages (the clipboard texts, which may be large) are queued
+// separately, and only sent once the other queued messages have been sent. A
+// large text is sent by chunks, one per batch, so that an event pushed in the
+// meantime is never delayed by more than a single chunk (the other messages
+// may therefore be received before the end of the text).
 bool
 controller_push_msg(struct controller *controller,
                     const struct control_msg *msg);
@@ -1,6 +1,9 @@
 #include "decoder.h"
 
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libavutil/time.h>
 #include <SDL2/SDL_events.h>
 #include <SDL2/SDL_mutex.h>
@@ -8,33 +11,215 @@
 #include <unistd.h>
 
 #include "config.h"
+#include "common.h"
 #include "compat.h"
+#include "decoder_pool.h"
 #include "events.h"
 #include "recorder.h"
+#include "shm_sink.h"
+#include "trace.h"
+#ifdef HAVE_V4L2
+# include "v4l2_sink.h"
+#endif
 #include "video_buffer.h"
 #include "util/buffer_util.h"
 #include "util/log.h"
 
+// A packet encoding a frame identical to the previous one (typically a frame
+// repeated by the encoder on an idle screen) only contains skipped macroblocks,
+// so it is very small. Above this size, a frame is not even compared.
+#define UNCHANGED_FRAME_MAX_PACKET_SIZE 1024
+
 // set the decoded frame as ready for rendering, and notify
 static void
 push_frame(struct decoder *decoder) {
-    bool previous_frame_skipped;
-    video_buffer_offer_decoded_frame(decoder->video_buffer,
-                                     &previous_frame_skipped);
-    if (previous_frame_skipped) {
-        // the previous EVENT_NEW_FRAME will consume this frame
+    trace_begin("offer");
+    bool notify = video_buffer_offer_decoded_frame(decoder->video_buffer);
+    trace_end();
+    if (!notify) {
+        // a pending EVENT_NEW_FRAME will consume this frame
         return;
     }
-    static SDL_Event new_frame_event = {
-        .type = EVENT_NEW_FRAME,
-    };
+    SDL_Event new_frame_event;
+    new_frame_event.type = EVENT_NEW_FRAME;
+    // identify the source, several devices may be mirrored
+    new_frame_event.user.data1 = decoder->video_buffer;
     SDL_PushEvent(&new_frame_event);
 }
 
 void
-decoder_init(struct decoder *decoder, struct video_buffer *vb) {
+decoder_init(struct decoder *decoder, struct video_buffer *vb,
+             struct shm_sink *shm_sink, struct v4l2_sink *v4l2_sink,
+             enum sc_hw_decoder hw_decoder, unsigned thread_count,
+             enum sc_decoder_thread_type thread_type,
+             struct decoder_pool *pool) {
     decoder->video_buffer = vb;
+    decoder->shm_sink = shm_sink;
+    decoder->v4l2_sink = v4l2_sink;
+    decoder->hw_decoder = hw_decoder;
+    decoder->thread_count = thread_count;
+    decoder->thread_type = thread_type;
+    decoder->capture_offset = 0;
+    decoder->wait_key_frame = false;
+    decoder->hw_device_ctx = NULL;
+    decoder->last_frame = NULL;
+    decoder->unchanged_frames = 0;
+    decoder->skipped_frames = 0;
+    decoder->pool = pool;
+    queue_init(&decoder->tasks);
+    queue_init(&decoder->free_tasks);
+    for (unsigned i = 0; i < DECODER_TASK_COUNT; ++i) {
+        struct decoder_task *task = &decoder->task_storage[i];
+        // av_packet_ref() does not initialize all fields in old FFmpeg
+        // versions
+        // See <https://github.com/Genymobile/scrcpy/issues/707>
+        av_init_packet(&task->packet);
+        task->packet.data = NULL;
+        task->packet.size = 0;
+        queue_push(&decoder->free_tasks, next, task);
+    }
+    decoder->wait_key_packet = false;
+    decoder->dropped_packets = 0;
+    decoder->scheduled = false;
+    decoder->error = false;
+}
+
+#ifdef SCRCPY_LAVC_HAS_HW_CONFIG
+static enum AVHWDeviceType
+get_hw_device_type(enum sc_hw_decoder hw_decoder) {
+    switch (hw_decoder) {
+        case SC_HW_DECODER_VAAPI:
+            return AV_HWDEVICE_TYPE_VAAPI;
+        case SC_HW_DECODER_D3D11VA:
+            return AV_HWDEVICE_TYPE_D3D11VA;
+        case SC_HW_DECODER_VIDEOTOOLBOX:
+            return AV_HWDEVICE_TYPE_VIDEOTOOLBOX;
+        case SC_HW_DECODER_CUDA:
+            return AV_HWDEVICE_TYPE_CUDA;
+        default:
+            return AV_HWDEVICE_TYPE_NONE;
+    }
+}
+
+static enum AVPixelFormat
+get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *formats) {
+    struct decoder *decoder = ctx->opaque;
+    for (const enum AVPixelFormat *p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+        if (*p == decoder->hw_pix_fmt) {
+            return *p;
+        }
+    }
+
+    LOGW("Hardware decoding not supported for this stream, "
+         "fallback to software decoding");
+    return avcodec_default_get_format(ctx, formats);
+}
+
+static bool
+init_hw_device(struct decoder *decoder, const AVCodec *codec,
+               enum AVHWDeviceType type) {
+    const AVCodecHWConfig *config;
+    for (int i = 0; (config = avcodec_get_hw_config(codec, i)); ++i) {
+        if (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX
+                && config->device_type == type) {
+            break;
+        }
+    }
+
+    const char *name = av_hwdevice_get_type_name(type);
+    if (!config) {
+        LOGD("Decoder %s does not support %s", codec->name, name);
+        return false;
+    }
+
+    int ret = av_hwdevice_ctx_create(&decoder->hw_device_ctx, type, NULL, NULL,
+                                     0);
+    if (ret < 0) {
+        LOGD("Could not create %s device: %d", name, ret);
+        return false;
+    }
+
+    decoder->hw_pix_fmt = config->pix_fmt;
+    LOGI("Hardware decoding enabled: %s", name);
+    return true;
+}
+
+static bool
+open_hw_device(struct decoder *decoder, const AVCodec *codec) {
+    if (decoder->hw_decoder == SC_HW_DECODER_AUTO) {
+        static const enum AVHWDeviceType types[] = {
+            AV_HWDEVICE_TYPE_VIDEOTOOLBOX,
+            AV_HWDEVICE_TYPE_D3D11VA,
+            AV_HWDEVICE_TYPE_VAAPI,
+            AV_HWDEVICE_TYPE_CUDA,
+        };
+        for (size_t i = 0; i < ARRAY_LEN(types); ++i) {
+            if (init_hw_device(decoder, codec, types[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    enum AVHWDeviceType type = get_hw_device_type(decoder->hw_decoder);
+    return init_hw_device(decoder, codec, type);
 }
+#endif
+
+static void
+close_hw_device(struct decoder *decoder) {
+    if (decoder->hw_device_ctx) {
+        av_buffer_unref(&decoder->hw_device_ctx);
+    }
+}
+
+static void
+setup_hw_decoding(struct decoder *decoder, const AVCodec *codec) {
+#ifdef SCRCPY_LAVC_HAS_HW_CONFIG
+    if (!open_hw_device(decoder, codec)) {
+        LOGW("Could not enable hardware decoding, "
+             "fallback to software decoding");
+        return;
+    }
+
+    decoder->codec_ctx->hw_device_ctx = av_buffer_ref(decoder->hw_device_ctx);
+    if (!decoder->codec_ctx->hw_device_ctx) {
+        LOGC("Could not reference hardware device");
+        close_hw_device(decoder);
+        return;
+    }
+
+    decoder->codec_ctx->opaque = decoder;
+    decoder->codec_ctx->get_format = get_hw_format;
+# ifdef SCRCPY_LAVC_HAS_EXTRA_HW_FRAMES
+    // the decoded frames are only read back from the GPU when they are
+    // rendered, so the surfaces held by the video buffer must not starve the
+    // decoder
+    decoder->codec_ctx->extra_hw_frames =
+        decoder->video_buffer->slot_count + 1;
+# endif
+#else
+    (void) codec;
+    LOGW("Hardware decoding is not available "
+         "(compile with FFmpeg >= 4.0 to enable it)");
+#endif
+}
+
+// the properties of a packet, forwarded to the frame decoded from it (even if
+// it is output later)
+struct decoder_packet_props {
+    int64_t recv_time;
+    // AVFrame.pkt_size is deprecated by FFmpeg 6.1 and removed by FFmpeg 7.0
+    int packet_size;
+};
+
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+// return NULL if the frame has no props
+static inline const struct decoder_packet_props *
+get_frame_props(const AVFrame *frame) {
+    return frame->opaque_ref ? (const void *) frame->opaque_ref->data : NULL;
+}
+#endif
 
 bool
 decoder_open(struct decoder *decoder, const AVCodec *codec) {
@@ -44,36 +229,293 @@ decoder_open(struct decoder *decoder, const AVCodec *codec) {
         return false;
     }
 
+    AVCodecContext *ctx = decoder->codec_ctx;
+    ctx->thread_count = decoder->thread_count;
+    if (decoder->thread_type == SC_DECODER_THREAD_TYPE_SLICE) {
+        // Slice threading decodes the slices of a frame in parallel, without
+        // delaying the output (frame threading adds one frame of latency
+        // per thread). LOW_DELAY disables frame threading anyway.
+        ctx->thread_type = FF_THREAD_SLICE;
+        ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    } else {
+        ctx->thread_type = FF_THREAD_FRAME;
+    }
+
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    ctx->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+#endif
+
+    if (decoder->hw_decoder != SC_HW_DECODER_NONE) {
+        setup_hw_decoding(decoder, codec);
+    }
+
+    decoder->last_frame = av_frame_alloc();
+    if (!decoder->last_frame) {
+        LOGC("Could not allocate frame");
+        goto error_free_context;
+    }
+
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    decoder->packet = av_packet_alloc();
+    if (!decoder->packet) {
+        LOGC("Could not allocate packet");
+        goto error_free_frame;
+    }
+
+    decoder->props_pool =
+        av_buffer_pool_init(sizeof(struct decoder_packet_props), NULL);
+    if (!decoder->props_pool) {
+        LOGC("Could not create packet props pool");
+        goto error_free_packet;
+    }
+#endif
+
     if (avcodec_open2(decoder->codec_ctx, codec, NULL) < 0) {
         LOGE("Could not open codec");
-        avcodec_free_context(&decoder->codec_ctx);
-        return false;
+        goto error_uninit_props_pool;
     }
 
     return true;
+
+error_uninit_props_pool:
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    av_buffer_pool_uninit(&decoder->props_pool);
+error_free_packet:
+    av_packet_free(&decoder->packet);
+error_free_frame:
+#endif
+    av_frame_free(&decoder->last_frame);
+error_free_context:
+    avcodec_free_context(&decoder->codec_ctx);
+    close_hw_device(decoder);
+    return false;
 }
 
 void
 decoder_close(struct decoder *decoder) {
+    if (decoder->pool) {
+        decoder_pool_release(decoder->pool, decoder);
+    }
     avcodec_close(decoder->codec_ctx);
     avcodec_free_context(&decoder->codec_ctx);
+    close_hw_device(decoder);
+    av_frame_free(&decoder->last_frame);
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    av_packet_free(&decoder->packet);
+    // the buffers still referenced by frames are released with them
+    av_buffer_pool_uninit(&decoder->props_pool);
+#endif
+    if (decoder->unchanged_frames) {
+        LOGD("Unchanged frames not rendered: %" PRIu64,
+             decoder->unchanged_frames);
+    }
+    if (decoder->skipped_frames) {
+        LOGD("Non-reference frames not decoded: %" PRIu64,
+             decoder->skipped_frames);
+    }
+    if (decoder->dropped_packets) {
+        LOGD("Packets dropped because decoding was behind: %" PRIu64,
+             decoder->dropped_packets);
+    }
 }
 
-bool
-decoder_push(struct decoder *decoder, const AVPacket *packet) {
+// record the timestamps of the decoded frame
+static void
+set_decoding_times(struct decoder *decoder, int64_t recv_time,
+                   int64_t capture_time) {
+    struct sc_frame_times *times = &decoder->video_buffer->decoding_times;
+    times->captured = capture_time;
+    times->received = recv_time;
+    times->decoded = av_gettime_relative();
+}
+
+static bool
+is_same_picture(const AVFrame *a, const AVFrame *b) {
+    if (a->format != b->format || a->width != b->width
+            || a->height != b->height) {
+        return false;
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(a->format);
+    if (!desc) {
+        return false;
+    }
+
+    int planes = av_pix_fmt_count_planes(a->format);
+    for (int i = 0; i < planes; ++i) {
+        int row_size = av_image_get_linesize(a->format, a->width, i);
+        if (row_size < 0) {
+            return false;
+        }
+        // planes 1 and 2 are the chroma planes (also for NV12)
+        int height = i == 1 || i == 2
+                   ? AV_CEIL_RSHIFT(a->height, desc->log2_chroma_h)
+                   : a->height;
+        for (int y = 0; y < height; ++y) {
+            if (memcmp(a->data[i] + y * a->linesize[i],
+                       b->data[i] + y * b->linesize[i], row_size)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static inline bool
+is_key_frame(const AVFrame *frame) {
+#ifdef SCRCPY_LAVU_HAS_FRAME_FLAG_KEY
+    return frame->flags & AV_FRAME_FLAG_KEY;
+#else
+    return frame->key_frame;
+#endif
+}
+
+// the size of the packet the frame has been decoded from, or -1 if unknown
+static inline int
+get_frame_packet_size(const AVFrame *frame) {
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    const struct decoder_packet_props *props = get_frame_props(frame);
+    return props ? props->packet_size : -1;
+#else
+    return frame->pkt_size;
+#endif
+}
+
+// return true if the frame is identical to the last frame offered for
+// rendering, so that it can be skipped (no texture upload, no render)
+static bool
+is_unchanged_frame(struct decoder *decoder, const AVFrame *frame) {
+    const AVFrame *last = decoder->last_frame;
+    if (!last->buf[0]) {
+        // no previous frame
+        return false;
+    }
+
+    int packet_size = get_frame_packet_size(frame);
+    if (is_key_frame(frame) || packet_size < 0
+            || packet_size > UNCHANGED_FRAME_MAX_PACKET_SIZE) {
+        return false;
+    }
+
+    if (frame->hw_frames_ctx) {
+        // the frame data is on the GPU, it cannot be compared cheaply
+        return false;
+    }
+
+    // the packet size is only a hint, the content must actually be the same
+    return is_same_picture(frame, last);
+}
+
+// offer the decoded frame for rendering, unless it is unchanged
+static void
+offer_frame(struct decoder *decoder) {
+    AVFrame *frame = decoder->video_buffer->decoding_frame;
+    metrics_add(&decoder->video_buffer->metrics->decoded_frames, 1);
+    if (is_unchanged_frame(decoder, frame)) {
+        ++decoder->unchanged_frames;
+        return;
+    }
+
+    // keep a reference to compare with the next frame (the buffers are
+    // refcounted, the data is not copied)
+    av_frame_unref(decoder->last_frame);
+    if (av_frame_ref(decoder->last_frame, frame)) {
+        LOGW("Could not reference frame");
+    }
+
+    if (decoder->shm_sink) {
+        // before the frame is swapped into the video buffer
+        shm_sink_push(decoder->shm_sink, frame);
+    }
+#ifdef HAVE_V4L2
+    if (decoder->v4l2_sink) {
+        v4l2_sink_push(decoder->v4l2_sink, frame);
+    }
+#endif
+
+    push_frame(decoder);
+}
+
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+// reference the packet into decoder->packet, with its props attached
+static bool
+attach_packet_props(struct decoder *decoder, const AVPacket *packet,
+                    int64_t recv_time) {
+    // the props are recycled, there is no allocation per packet
+    AVBufferRef *props_ref = av_buffer_pool_get(decoder->props_pool);
+    if (!props_ref) {
+        LOGC("Could not allocate packet props");
+        return false;
+    }
+    struct decoder_packet_props *props = (void *) props_ref->data;
+    props->recv_time = recv_time;
+    props->packet_size = packet->size;
+
+    if (av_packet_ref(decoder->packet, packet)) {
+        LOGC("Could not reference packet");
+        av_buffer_unref(&props_ref);
+        return false;
+    }
+    // the reference is owned by the packet
+    av_buffer_unref(&decoder->packet->opaque_ref);
+    decoder->packet->opaque_ref = props_ref;
+    return true;
+}
+#endif
+
+#ifdef SCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
+// the receive time of the packet the frame has been decoded from
+static int64_t
+get_frame_recv_time(const AVFrame *frame) {
+# ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    const struct decoder_packet_props *props = get_frame_props(frame);
+    return props ? props->recv_time : 0;
+# else
+    return frame->reordered_opaque;
+# endif
+}
+#endif
+
+static bool
+decode_packet(struct decoder *decoder, const AVPacket *packet,
+              int64_t recv_time, int64_t capture_time) {
 // the new decoding/encoding API has been introduced by:
 // <http://git.videolan.org/?p=ffmpeg.git;a=commitdiff;h=7fc329e2dd6226dfecaa4a1d7adf353bf2773726>
 #ifdef SCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
     int ret;
-    if ((ret = avcodec_send_packet(decoder->codec_ctx, packet)) < 0) {
+    if (capture_time && packet->pts != AV_NOPTS_VALUE) {
+        // the PTS is forwarded to the frame, the capture time is retrieved
+        // from it (the difference is constant for a session)
+        decoder->capture_offset = capture_time - packet->pts;
+    }
+    // associate the receive time to the frame (even if it is output later)
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    if (!attach_packet_props(decoder, packet, recv_time)) {
+        return false;
+    }
+    ret = avcodec_send_packet(decoder->codec_ctx, decoder->packet);
+    av_packet_unref(decoder->packet);
+#else
+    decoder->codec_ctx->reordered_opaque = recv_time;
+    ret = avcodec_send_packet(decoder->codec_ctx, packet);
+#endif
+    if (ret < 0) {
         LOGE("Could not send video packet: %d", ret);
         return false;
     }
+    // hardware frames are not downloaded here, but by the renderer (only the
+    // frames actually rendered are read back)
     ret = avcodec_receive_frame(decoder->codec_ctx,
                                 decoder->video_buffer->decoding_frame);
     if (!ret) {
         // a frame was received
-        push_frame(decoder);
+        AVFrame *frame = decoder->video_buffer->decoding_frame;
+        int64_t frame_capture_time =
+            decoder->capture_offset && frame->pts != AV_NOPTS_VALUE
+                ? frame->pts + decoder->capture_offset : 0;
+        set_decoding_times(decoder, get_frame_recv_time(frame),
+                           frame_capture_time);
+        offer_frame(decoder);
     } else if (ret != AVERROR(EAGAIN)) {
         LOGE("Could not receive video frame: %d", ret);
         return false;
@@ -89,12 +531,71 @@ decoder_push(struct decoder *decoder, const AVPacket *packet) {
         return false;
     }
     if (got_picture) {
-        push_frame(decoder);
+        set_decoding_times(decoder, recv_time, capture_time);
+        offer_frame(decoder);
     }
 #endif
     return true;
 }
 
+// tell whether the renderer is behind, so that the frames which are not needed
+// to decode the next ones may be skipped
+static bool
+is_behind(struct decoder *decoder) {
+    struct video_buffer *vb = decoder->video_buffer;
+    // with render_expired_frames, every frame must be rendered
+    return !vb->render_expired_frames && video_buffer_has_pending_frame(vb);
+}
+
+bool
+decoder_decode(struct decoder *decoder, const AVPacket *packet,
+               int64_t recv_time, int64_t capture_time) {
+    if (decoder->wait_key_frame) {
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+            // the frame would reference broken frames, drop it
+            return true;
+        }
+        decoder->wait_key_frame = false;
+    }
+
+    bool behind = is_behind(decoder);
+#ifdef AV_PKT_FLAG_DISPOSABLE
+    if (behind && packet->flags & AV_PKT_FLAG_DISPOSABLE) {
+        // the decoded frame would replace the pending one, and probably be
+        // replaced by the next one before being rendered: do not even decode
+        // it (the next frames do not reference it)
+        ++decoder->skipped_frames;
+        metrics_add(&decoder->video_buffer->metrics->skipped_frames, 1);
+        return true;
+    }
+#endif
+    // the packets of the other codecs are not flagged, let the decoder
+    // discard the non-reference frames itself
+    decoder->codec_ctx->skip_frame = behind ? AVDISCARD_NONREF
+                                            : AVDISCARD_DEFAULT;
+
+    trace_begin("decode");
+    bool ok = decode_packet(decoder, packet, recv_time, capture_time);
+    trace_end();
+    if (!ok) {
+        decoder->wait_key_frame = true;
+        avcodec_flush_buffers(decoder->codec_ctx);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+decoder_push(struct decoder *decoder, const AVPacket *packet,
+             int64_t recv_time, int64_t capture_time) {
+    if (decoder->pool) {
+        return decoder_pool_push(decoder->pool, decoder, packet, recv_time,
+                                 capture_time);
+    }
+    return decoder_decode(decoder, packet, recv_time, capture_time);
+}
+
 void
 decoder_interrupt(struct decoder *decoder) {
     video_buffer_interrupt(decoder->video_buffer);
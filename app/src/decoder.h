@@ -5,16 +5,82 @@
 #include <libavformat/avformat.h>
 
 #include "config.h"
+#include "compat.h"
+#include "scrcpy.h"
+#include "util/queue.h"
 
+struct decoder_pool;
+struct shm_sink;
+struct v4l2_sink;
 struct video_buffer;
 
+// a packet waiting to be decoded by a pool worker
+struct decoder_task {
+    AVPacket packet;
+    int64_t recv_time;
+    int64_t capture_time;
+    struct decoder_task *next;
+};
+
+struct decoder_task_queue QUEUE(struct decoder_task);
+
+// maximum number of packets queued (or being decoded) for a decoder of a pool
+#define DECODER_TASK_COUNT 64
+
 struct decoder {
     struct video_buffer *video_buffer;
+    // the decoded frames are also published to this sink, if not NULL
+    struct shm_sink *shm_sink;
+    struct v4l2_sink *v4l2_sink;
+    enum sc_hw_decoder hw_decoder;
+    unsigned thread_count; // 0 for automatic
+    enum sc_decoder_thread_type thread_type;
     AVCodecContext *codec_ctx;
+    // local capture time - PTS, or 0 if unknown
+    int64_t capture_offset;
+    // set on decoding error, until the next key frame
+    bool wait_key_frame;
+    // reference to the last frame offered for rendering, to detect unchanged
+    // frames
+    AVFrame *last_frame;
+    uint64_t unchanged_frames;
+    // non-reference frames not decoded because the renderer was behind
+    uint64_t skipped_frames;
+
+#ifdef SCRCPY_LAVC_HAS_COPY_OPAQUE
+    // the packet sent to the codec: it references the packet to decode, with
+    // its props attached (forwarded to the frame by AV_CODEC_FLAG_COPY_OPAQUE)
+    AVPacket *packet;
+    AVBufferPool *props_pool;
+#endif
+
+    // only set if hardware decoding is enabled
+    AVBufferRef *hw_device_ctx;
+    enum AVPixelFormat hw_pix_fmt;
+
+    // if not NULL, the packets are decoded asynchronously by the pool
+    struct decoder_pool *pool;
+    // the fields below are protected by the pool mutex
+    struct decoder_task_queue tasks;
+    // the items of task_storage neither queued nor being decoded
+    struct decoder_task_queue free_tasks;
+    struct decoder_task task_storage[DECODER_TASK_COUNT];
+    // the queue overflowed, drop the packets until the next key frame
+    bool wait_key_packet;
+    uint64_t dropped_packets;
+    bool scheduled; // in the pool run queue, or being decoded
+    bool error; // a packet could not be decoded, reported on the next push
+    struct decoder *next; // in the pool run queue
 };
 
+// shm_sink and v4l2_sink may be NULL
+// pool may be NULL to decode synchronously, from decoder_push()
 void
-decoder_init(struct decoder *decoder, struct video_buffer *vb);
+decoder_init(struct decoder *decoder, struct video_buffer *vb,
+             struct shm_sink *shm_sink, struct v4l2_sink *v4l2_sink,
+             enum sc_hw_decoder hw_decoder, unsigned thread_count,
+             enum sc_decoder_thread_type thread_type,
+             struct decoder_pool *pool);
 
 bool
 decoder_open(struct decoder *decoder, const AVCodec *codec);
@@ -22,8 +88,24 @@ decoder_open(struct decoder *decoder, const AVCodec *codec);
 void
 decoder_close(struct decoder *decoder);
 
+// recv_time is the time at which the packet has been received, in
+// microseconds (see av_gettime_relative())
+// capture_time is the time at which the frame has been captured on the device,
+// converted to the local clock (0 if unknown)
+//
+// On error, the next packets are dropped until a key frame is received.
+//
+// With a pool, the packet is only queued, and a decoding error is reported by
+// the next call.
+bool
+decoder_push(struct decoder *decoder, const AVPacket *packet,
+             int64_t recv_time, int64_t capture_time);
+
+// decode the packet immediately (called by decoder_push() or by the pool
+// workers)
 bool
-decoder_push(struct decoder *decoder, const AVPacket *packet);
+decoder_decode(struct decoder *decoder, const AVPacket *packet,
+               int64_t recv_time, int64_t capture_time);
 
 void
 decoder_interrupt(struct decoder *decoder);
@@ -0,0 +1,239 @@
+#include "decoder_pool.h"
+
+#include <assert.h>
+#include <SDL2/SDL_cpuinfo.h>
+
+#include "config.h"
+#include "decoder.h"
+#include "trace.h"
+#include "util/lock.h"
+#include "util/log.h"
+
+bool
+decoder_pool_init(struct decoder_pool *pool, unsigned worker_count) {
+    if (!worker_count) {
+        int cpu_count = SDL_GetCPUCount();
+        worker_count = cpu_count > 0 ? cpu_count : 1;
+    }
+
+    pool->workers = SDL_malloc(worker_count * sizeof(*pool->workers));
+    if (!pool->workers) {
+        LOGC("Could not allocate decoder workers");
+        return false;
+    }
+
+    pool->mutex = SDL_CreateMutex();
+    if (!pool->mutex) {
+        LOGC("Could not create mutex");
+        SDL_free(pool->workers);
+        return false;
+    }
+
+    pool->work_cond = SDL_CreateCond();
+    if (!pool->work_cond) {
+        LOGC("Could not create cond");
+        SDL_DestroyMutex(pool->mutex);
+        SDL_free(pool->workers);
+        return false;
+    }
+
+    pool->idle_cond = SDL_CreateCond();
+    if (!pool->idle_cond) {
+        LOGC("Could not create cond");
+        SDL_DestroyCond(pool->work_cond);
+        SDL_DestroyMutex(pool->mutex);
+        SDL_free(pool->workers);
+        return false;
+    }
+
+    pool->worker_count = worker_count;
+    pool->stopped = false;
+    queue_init(&pool->ready);
+
+    return true;
+}
+
+void
+decoder_pool_destroy(struct decoder_pool *pool) {
+    SDL_DestroyCond(pool->idle_cond);
+    SDL_DestroyCond(pool->work_cond);
+    SDL_DestroyMutex(pool->mutex);
+    SDL_free(pool->workers);
+}
+
+// return the pending tasks of the decoder to its free list
+// return the number of dropped packets
+static unsigned
+drop_tasks(struct decoder *decoder) {
+    unsigned count = 0;
+    while (!queue_is_empty(&decoder->tasks)) {
+        struct decoder_task *task;
+        queue_take(&decoder->tasks, next, &task);
+        av_packet_unref(&task->packet);
+        queue_push(&decoder->free_tasks, next, task);
+        ++count;
+    }
+    return count;
+}
+
+static int
+run_worker(void *data) {
+    struct decoder_pool *pool = data;
+    trace_set_thread_name("decoder");
+
+    for (;;) {
+        mutex_lock(pool->mutex);
+        while (!pool->stopped && queue_is_empty(&pool->ready)) {
+            cond_wait(pool->work_cond, pool->mutex);
+        }
+        if (pool->stopped) {
+            mutex_unlock(pool->mutex);
+            break;
+        }
+
+        struct decoder *decoder;
+        queue_take(&pool->ready, next, &decoder);
+        if (queue_is_empty(&decoder->tasks)) {
+            // its pending packets have been dropped
+            decoder->scheduled = false;
+            cond_broadcast(pool->idle_cond);
+            mutex_unlock(pool->mutex);
+            continue;
+        }
+
+        // take one packet at a time, so that the packets left pending can
+        // still be dropped; the decoder remains scheduled so that no other
+        // worker decodes it meanwhile
+        struct decoder_task *task;
+        queue_take(&decoder->tasks, next, &task);
+        mutex_unlock(pool->mutex);
+
+        bool ok = decoder_decode(decoder, &task->packet, task->recv_time,
+                                 task->capture_time);
+        av_packet_unref(&task->packet);
+
+        mutex_lock(pool->mutex);
+        queue_push(&decoder->free_tasks, next, task);
+        if (!ok) {
+            decoder->error = true;
+        }
+        if (queue_is_empty(&decoder->tasks)) {
+            decoder->scheduled = false;
+            cond_broadcast(pool->idle_cond);
+        } else {
+            // schedule it again (at the end, so that the other decoders are
+            // not starved)
+            queue_push(&pool->ready, next, decoder);
+            cond_signal(pool->work_cond);
+        }
+        mutex_unlock(pool->mutex);
+    }
+
+    return 0;
+}
+
+bool
+decoder_pool_start(struct decoder_pool *pool) {
+    LOGD("Starting %u decoder workers", pool->worker_count);
+
+    for (unsigned i = 0; i < pool->worker_count; ++i) {
+        pool->workers[i] = SDL_CreateThread(run_worker, "decoder", pool);
+        if (!pool->workers[i]) {
+            LOGC("Could not start decoder worker");
+            decoder_pool_stop(pool);
+            for (unsigned j = 0; j < i; ++j) {
+                SDL_WaitThread(pool->workers[j], NULL);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+decoder_pool_stop(struct decoder_pool *pool) {
+    mutex_lock(pool->mutex);
+    pool->stopped = true;
+    cond_broadcast(pool->work_cond);
+    cond_broadcast(pool->idle_cond);
+    mutex_unlock(pool->mutex);
+}
+
+void
+decoder_pool_join(struct decoder_pool *pool) {
+    for (unsigned i = 0; i < pool->worker_count; ++i) {
+        SDL_WaitThread(pool->workers[i], NULL);
+    }
+}
+
+bool
+decoder_pool_push(struct decoder_pool *pool, struct decoder *decoder,
+                  const AVPacket *packet, int64_t recv_time,
+                  int64_t capture_time) {
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+
+    mutex_lock(pool->mutex);
+    bool error = decoder->error;
+    decoder->error = false;
+
+    if (decoder->wait_key_packet) {
+        if (!key_frame) {
+            ++decoder->dropped_packets;
+            mutex_unlock(pool->mutex);
+            return !error;
+        }
+        decoder->wait_key_packet = false;
+    }
+
+    if (queue_is_empty(&decoder->free_tasks)) {
+        // the decoding is behind: the pending packets would be decoded too
+        // late anyway, and a packet cannot be dropped alone without breaking
+        // the next ones
+        decoder->dropped_packets += drop_tasks(decoder);
+        if (!key_frame) {
+            LOGD("Decoder queue full, dropping packets until a key frame");
+            decoder->wait_key_packet = true;
+            ++decoder->dropped_packets;
+            mutex_unlock(pool->mutex);
+            return !error;
+        }
+        // at most one packet is being decoded
+        assert(!queue_is_empty(&decoder->free_tasks));
+    }
+
+    struct decoder_task *task;
+    queue_take(&decoder->free_tasks, next, &task);
+
+    // only increments the refcount of the packet data
+    if (av_packet_ref(&task->packet, packet)) {
+        LOGC("Could not reference packet");
+        queue_push(&decoder->free_tasks, next, task);
+        mutex_unlock(pool->mutex);
+        return false;
+    }
+    task->recv_time = recv_time;
+    task->capture_time = capture_time;
+
+    queue_push(&decoder->tasks, next, task);
+    if (!decoder->scheduled) {
+        decoder->scheduled = true;
+        queue_push(&pool->ready, next, decoder);
+        cond_signal(pool->work_cond);
+    }
+    mutex_unlock(pool->mutex);
+
+    return !error;
+}
+
+void
+decoder_pool_release(struct decoder_pool *pool, struct decoder *decoder) {
+    mutex_lock(pool->mutex);
+    drop_tasks(decoder);
+    // if it is still in the run queue, a worker will take it and find no
+    // packets
+    while (decoder->scheduled && !pool->stopped) {
+        cond_wait(pool->idle_cond, pool->mutex);
+    }
+    mutex_unlock(pool->mutex);
+}
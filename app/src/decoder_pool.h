@@ -0,0 +1,69 @@
+#ifndef DECODER_POOL_H
+#define DECODER_POOL_H
+
+#include <stdbool.h>
+#include <libavformat/avformat.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+#include "config.h"
+#include "util/queue.h"
+
+struct decoder;
+
+struct decoder_queue QUEUE(struct decoder);
+
+// Decode the packets of several decoders (one per device) from a fixed set of
+// worker threads, instead of decoding on each stream thread.
+//
+// The packets pushed for a decoder are queued, in tasks preallocated by the
+// decoder (at most DECODER_TASK_COUNT). A decoder having pending packets is
+// scheduled in a shared run queue, from which any idle worker takes it: the
+// busy devices are decoded by the workers left idle by the others. A decoder
+// is never decoded by several workers at once, so its packets are decoded in
+// order.
+//
+// If the queue of a decoder is full, the pending packets are dropped, and so
+// are the next ones until a key frame: the stream thread is never blocked by
+// a slow decoder, and the decoding does not lag further and further behind.
+struct decoder_pool {
+    SDL_mutex *mutex;
+    SDL_cond *work_cond; // signaled when a decoder is scheduled
+    SDL_cond *idle_cond; // broadcast when a decoder has no more work
+    SDL_Thread **workers;
+    unsigned worker_count;
+    bool stopped;
+
+    // the decoders having pending packets, not being decoded
+    struct decoder_queue ready;
+};
+
+// worker_count is the number of decoding threads (0 for the number of CPU
+// cores)
+bool
+decoder_pool_init(struct decoder_pool *pool, unsigned worker_count);
+
+void
+decoder_pool_destroy(struct decoder_pool *pool);
+
+bool
+decoder_pool_start(struct decoder_pool *pool);
+
+void
+decoder_pool_stop(struct decoder_pool *pool);
+
+void
+decoder_pool_join(struct decoder_pool *pool);
+
+// queue a packet to be decoded by a worker
+// return false if a previous packet of this decoder could not be decoded
+bool
+decoder_pool_push(struct decoder_pool *pool, struct decoder *decoder,
+                  const AVPacket *packet, int64_t recv_time,
+                  int64_t capture_time);
+
+// drop the pending packets of the decoder, and wait until no worker uses it
+void
+decoder_pool_release(struct decoder_pool *pool, struct decoder *decoder);
+
+#endif
@@ -22,3 +22,16 @@ device_read_info(socket_t device_socket, char *device_name, struct size *size) {
             | buf[DEVICE_NAME_FIELD_LENGTH + 3];
     return true;
 }
+
+bool
+device_read_preview_size(socket_t preview_socket, struct size *size) {
+    unsigned char buf[4];
+    int r = net_recv_all(preview_socket, buf, sizeof(buf));
+    if (r < 4) {
+        LOGE("Could not retrieve preview size");
+        return false;
+    }
+    size->width = (buf[0] << 8) | buf[1];
+    size->height = (buf[2] << 8) | buf[3];
+    return true;
+}
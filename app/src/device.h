@@ -13,4 +13,8 @@
 bool
 device_read_info(socket_t device_socket, char *device_name, struct size *size);
 
+// read the initial frame size of the preview stream (sent on its socket)
+bool
+device_read_preview_size(socket_t preview_socket, struct size *size);
+
 #endif
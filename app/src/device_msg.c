@@ -16,7 +16,8 @@ device_msg_deserialize(const unsigned char *buf, size_t len,
 
     msg->type = buf[0];
     switch (msg->type) {
-        case DEVICE_MSG_TYPE_CLIPBOARD: {
+        case DEVICE_MSG_TYPE_CLIPBOARD:
+        case DEVICE_MSG_TYPE_CLIPBOARD_PART: {
             size_t clipboard_len = buffer_read32be(&buf[1]);
             if (clipboard_len > len - 5) {
                 return 0; // not available
@@ -34,6 +35,33 @@ device_msg_deserialize(const unsigned char *buf, size_t len,
             msg->clipboard.text = text;
             return 5 + clipboard_len;
         }
+        case DEVICE_MSG_TYPE_PONG:
+            if (len < 25) {
+                return 0; // not available
+            }
+            msg->pong.ping_timestamp = buffer_read64be(&buf[1]);
+            msg->pong.ping_received = buffer_read64be(&buf[9]);
+            msg->pong.pong_sent = buffer_read64be(&buf[17]);
+            return 25;
+        case DEVICE_MSG_TYPE_STATS: {
+            if (len < 37) {
+                return 0; // not available
+            }
+            struct device_stats *stats = &msg->stats;
+            stats->encoded_frames = buffer_read32be(&buf[1]);
+            stats->dropped_frames = buffer_read32be(&buf[5]);
+            stats->bytes_per_second = buffer_read32be(&buf[9]);
+            stats->encode_time_avg = buffer_read32be(&buf[13]);
+            stats->encode_time_max = buffer_read32be(&buf[17]);
+            stats->queue_depth_max = buffer_read32be(&buf[21]);
+            stats->injected_events = buffer_read32be(&buf[25]);
+            stats->injection_latency_avg = buffer_read32be(&buf[29]);
+            stats->injection_latency_max = buffer_read32be(&buf[33]);
+            return 37;
+        }
+        case DEVICE_MSG_TYPE_REFRESH_RATE:
+            msg->refresh_rate.rate = buffer_read32be(&buf[1]);
+            return 5;
         default:
             LOGW("Unknown device message type: %d", (int) msg->type);
             return -1; // error, we cannot recover
@@ -42,7 +70,8 @@ device_msg_deserialize(const unsigned char *buf, size_t len,
 
 void
 device_msg_destroy(struct device_msg *msg) {
-    if (msg->type == DEVICE_MSG_TYPE_CLIPBOARD) {
+    if (msg->type == DEVICE_MSG_TYPE_CLIPBOARD
+            || msg->type == DEVICE_MSG_TYPE_CLIPBOARD_PART) {
         SDL_free(msg->clipboard.text);
     }
 }
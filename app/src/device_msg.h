@@ -7,12 +7,34 @@
 
 #include "config.h"
 
-#define DEVICE_MSG_MAX_SIZE (1 << 18) // 256k
+#define DEVICE_MSG_MAX_SIZE (1 << 14) // 16k
 // type: 1 byte; length: 4 bytes
+// a larger clipboard text is received in several chunks
 #define DEVICE_MSG_TEXT_MAX_LENGTH (DEVICE_MSG_MAX_SIZE - 5)
 
 enum device_msg_type {
     DEVICE_MSG_TYPE_CLIPBOARD,
+    DEVICE_MSG_TYPE_PONG,
+    DEVICE_MSG_TYPE_STATS,
+    DEVICE_MSG_TYPE_REFRESH_RATE,
+    // a non-final chunk of a clipboard text (in clipboard), the last one is a
+    // DEVICE_MSG_TYPE_CLIPBOARD
+    DEVICE_MSG_TYPE_CLIPBOARD_PART,
+};
+
+// performance counters of the device over the last period (about 1 second),
+// all times in microseconds
+struct device_stats {
+    uint32_t encoded_frames;
+    uint32_t dropped_frames; // encoded but not sent
+    uint32_t bytes_per_second;
+    uint32_t encode_time_avg; // from capture to encoder output
+    uint32_t encode_time_max;
+    // the max number of frames already encoded when the previous one was sent
+    uint32_t queue_depth_max;
+    uint32_t injected_events;
+    uint32_t injection_latency_avg; // from reception to injection
+    uint32_t injection_latency_max;
 };
 
 struct device_msg {
@@ -21,6 +43,15 @@ struct device_msg {
         struct {
             char *text; // owned, to be freed by SDL_free()
         } clipboard;
+        struct {
+            uint64_t ping_timestamp; // echoed from the ping (local clock)
+            uint64_t ping_received; // device clock
+            uint64_t pong_sent; // device clock
+        } pong;
+        struct device_stats stats;
+        struct {
+            uint32_t rate; // in millihertz
+        } refresh_rate;
     };
 };
 
@@ -0,0 +1,43 @@
+#include "display_buffer.h"
+
+#include <assert.h>
+
+// above this lateness, the PTS timeline is considered discontinuous, the
+// offset is reset instead of presenting every frame late
+#define RESYNC_THRESHOLD 1000000 // 1s
+
+// the offset moves up by 1/DRIFT_FACTOR of the difference on each frame
+#define DRIFT_FACTOR 256
+
+void
+display_buffer_init(struct display_buffer *db, int64_t delay) {
+    assert(delay > 0);
+    db->delay = delay;
+    db->has_offset = false;
+    db->offset = 0;
+    db->last_pts = 0;
+}
+
+static void
+update_offset(struct display_buffer *db, int64_t offset) {
+    if (!db->has_offset || offset < db->offset
+            || offset - db->offset > RESYNC_THRESHOLD) {
+        // this frame experienced the least delay so far
+        db->offset = offset;
+        db->has_offset = true;
+        return;
+    }
+
+    db->offset += (offset - db->offset) / DRIFT_FACTOR;
+}
+
+int64_t
+display_buffer_get_deadline(struct display_buffer *db, int64_t pts,
+                            int64_t arrival) {
+    if (!db->has_offset || pts != db->last_pts) {
+        update_offset(db, arrival - pts);
+        db->last_pts = pts;
+    }
+
+    return pts + db->offset + db->delay;
+}
@@ -0,0 +1,42 @@
+#ifndef DISPLAY_BUFFER_H
+#define DISPLAY_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Decide when to present the frames, when they are held in a jitter buffer
+// (--display-buffer).
+//
+// Each frame is presented at its PTS-relative time on the local clock, plus a
+// fixed delay: the network jitter is absorbed (up to the delay), at the cost
+// of a constant latency.
+//
+// The local time of a PTS is estimated from the frames which experienced the
+// least delay: the offset (arrival - PTS) follows the minimum, and slowly
+// drifts up otherwise, so that a clock drift between the device and the
+// computer does not accumulate.
+//
+// All times are in microseconds (see av_gettime_relative()). Only accessed
+// from the main thread.
+struct display_buffer {
+    int64_t delay;
+    bool has_offset;
+    int64_t offset;
+    // the PTS of the last frame taken into account for the offset
+    int64_t last_pts;
+};
+
+void
+display_buffer_init(struct display_buffer *db, int64_t delay);
+
+// return the time at which the frame must be presented (possibly in the past,
+// if it arrived too late)
+//
+// It may be called several times for the same frame, until it is presented.
+int64_t
+display_buffer_get_deadline(struct display_buffer *db, int64_t pts,
+                            int64_t arrival);
+
+#endif
@@ -1,3 +1,9 @@
+// For the events below, user.data1 is the component which pushed them (to
+// find the device session it belongs to)
 #define EVENT_NEW_SESSION SDL_USEREVENT
 #define EVENT_NEW_FRAME (SDL_USEREVENT + 1)
 #define EVENT_STREAM_STOPPED (SDL_USEREVENT + 2)
+#define EVENT_FRAME_SIZE_CHANGED (SDL_USEREVENT + 3)
+#define EVENT_WINDOW_SIZE_SETTLED (SDL_USEREVENT + 4)
+// the connection has been lost, the stream waits for stream_resume()
+#define EVENT_STREAM_DISCONNECTED (SDL_USEREVENT + 5)
@@ -13,13 +13,23 @@
 static void
 file_handler_request_destroy(struct file_handler_request *req) {
     SDL_free(req->file);
+    SDL_free(req);
+}
+
+// must be called with the mutex locked (or before the workers are started)
+static void
+reset_batch(struct file_handler *file_handler) {
+    file_handler->total = 0;
+    file_handler->done = 0;
+    file_handler->failed = 0;
 }
 
 bool
 file_handler_init(struct file_handler *file_handler, const char *serial,
-                  const char *push_target) {
+                  const char *push_target, unsigned worker_count) {
+    assert(worker_count && worker_count <= FILE_HANDLER_MAX_WORKERS);
 
-    cbuf_init(&file_handler->queue);
+    queue_init(&file_handler->queue);
 
     if (!(file_handler->mutex = SDL_CreateMutex())) {
         return false;
@@ -46,23 +56,42 @@ file_handler_init(struct file_handler *file_handler, const char *serial,
     file_handler->initialized = false;
 
     file_handler->stopped = false;
-    file_handler->current_process = PROCESS_NONE;
+    reset_batch(file_handler);
+
+    file_handler->worker_count = worker_count;
+    for (unsigned i = 0; i < worker_count; ++i) {
+        struct file_handler_worker *worker = &file_handler->workers[i];
+        worker->file_handler = file_handler;
+        worker->thread = NULL;
+        worker->current_process = PROCESS_NONE;
+        worker->canceled = false;
+    }
 
     file_handler->push_target = push_target ? push_target : DEFAULT_PUSH_TARGET;
 
     return true;
 }
 
+// must be called with the mutex locked
+static unsigned
+drop_pending_requests(struct file_handler *file_handler) {
+    unsigned count = 0;
+    while (!queue_is_empty(&file_handler->queue)) {
+        struct file_handler_request *req;
+        queue_take(&file_handler->queue, next, &req);
+        file_handler_request_destroy(req);
+        ++count;
+    }
+    return count;
+}
+
 void
 file_handler_destroy(struct file_handler *file_handler) {
     SDL_DestroyCond(file_handler->event_cond);
     SDL_DestroyMutex(file_handler->mutex);
     SDL_free(file_handler->serial);
 
-    struct file_handler_request req;
-    while (cbuf_take(&file_handler->queue, &req)) {
-        file_handler_request_destroy(&req);
-    }
+    drop_pending_requests(file_handler);
 }
 
 static process_t
@@ -81,36 +110,59 @@ file_handler_request(struct file_handler *file_handler,
     // start file_handler if it's used for the first time
     if (!file_handler->initialized) {
         if (!file_handler_start(file_handler)) {
+            SDL_free(file);
             return false;
         }
         file_handler->initialized = true;
     }
 
+    struct file_handler_request *req = SDL_malloc(sizeof(*req));
+    if (!req) {
+        LOGW("Could not allocate file request");
+        SDL_free(file);
+        return false;
+    }
+    req->action = action;
+    req->file = file;
+
+    mutex_lock(file_handler->mutex);
+    req->index = ++file_handler->total;
     LOGI("Request to %s %s", action == ACTION_INSTALL_APK ? "install" : "push",
                              file);
-    struct file_handler_request req = {
-        .action = action,
-        .file = file,
-    };
+    queue_push(&file_handler->queue, next, req);
+    cond_signal(file_handler->event_cond);
+    mutex_unlock(file_handler->mutex);
+    return true;
+}
 
-    mutex_lock(file_handler->mutex);
-    bool was_empty = cbuf_is_empty(&file_handler->queue);
-    bool res = cbuf_push(&file_handler->queue, req);
-    if (was_empty) {
-        cond_signal(file_handler->event_cond);
+// must be called with the mutex locked
+static void
+complete_request(struct file_handler *file_handler, bool success) {
+    ++file_handler->done;
+    if (!success) {
+        ++file_handler->failed;
+    }
+
+    if (file_handler->done == file_handler->total) {
+        // all the requests of the batch are done
+        if (file_handler->total > 1) {
+            LOGI("File transfers done: %u succeeded, %u failed",
+                 file_handler->total - file_handler->failed,
+                 file_handler->failed);
+        }
+        reset_batch(file_handler);
     }
-    mutex_unlock(file_handler->mutex);
-    return res;
 }
 
 static int
-run_file_handler(void *data) {
-    struct file_handler *file_handler = data;
+run_file_handler_worker(void *data) {
+    struct file_handler_worker *worker = data;
+    struct file_handler *file_handler = worker->file_handler;
 
     for (;;) {
         mutex_lock(file_handler->mutex);
-        file_handler->current_process = PROCESS_NONE;
-        while (!file_handler->stopped && cbuf_is_empty(&file_handler->queue)) {
+        while (!file_handler->stopped
+                && queue_is_empty(&file_handler->queue)) {
             cond_wait(file_handler->event_cond, file_handler->mutex);
         }
         if (file_handler->stopped) {
@@ -118,74 +170,133 @@ run_file_handler(void *data) {
             mutex_unlock(file_handler->mutex);
             break;
         }
-        struct file_handler_request req;
-        bool non_empty = cbuf_take(&file_handler->queue, &req);
-        assert(non_empty);
-        (void) non_empty;
+        struct file_handler_request *req;
+        queue_take(&file_handler->queue, next, &req);
 
+        unsigned total = file_handler->total;
         process_t process;
-        if (req.action == ACTION_INSTALL_APK) {
-            LOGI("Installing %s...", req.file);
-            process = install_apk(file_handler->serial, req.file);
+        if (req->action == ACTION_INSTALL_APK) {
+            LOGI("[%u/%u] Installing %s...", req->index, total, req->file);
+            process = install_apk(file_handler->serial, req->file);
         } else {
-            LOGI("Pushing %s...", req.file);
-            process = push_file(file_handler->serial, req.file,
+            LOGI("[%u/%u] Pushing %s...", req->index, total, req->file);
+            process = push_file(file_handler->serial, req->file,
                                 file_handler->push_target);
         }
-        file_handler->current_process = process;
+        // the process is started with the mutex locked, so that a concurrent
+        // cancellation or stop always sees it
+        worker->current_process = process;
+        worker->canceled = false;
+        mutex_unlock(file_handler->mutex);
+
+        bool success;
+        if (req->action == ACTION_INSTALL_APK) {
+            success = process_check_success(process, "adb install");
+        } else {
+            success = process_check_success(process, "adb push");
+        }
+
+        mutex_lock(file_handler->mutex);
+        worker->current_process = PROCESS_NONE;
+        bool canceled = worker->canceled;
+        complete_request(file_handler, success);
         mutex_unlock(file_handler->mutex);
 
-        if (req.action == ACTION_INSTALL_APK) {
-            if (process_check_success(process, "adb install")) {
-                LOGI("%s successfully installed", req.file);
+        if (canceled) {
+            LOGI("%s canceled", req->file);
+        } else if (req->action == ACTION_INSTALL_APK) {
+            if (success) {
+                LOGI("%s successfully installed", req->file);
             } else {
-                LOGE("Failed to install %s", req.file);
+                LOGE("Failed to install %s", req->file);
             }
         } else {
-            if (process_check_success(process, "adb push")) {
-                LOGI("%s successfully pushed to %s", req.file,
+            if (success) {
+                LOGI("%s successfully pushed to %s", req->file,
                                                      file_handler->push_target);
             } else {
-                LOGE("Failed to push %s to %s", req.file,
+                LOGE("Failed to push %s to %s", req->file,
                                                 file_handler->push_target);
             }
         }
 
-        file_handler_request_destroy(&req);
+        file_handler_request_destroy(req);
     }
     return 0;
 }
 
 bool
 file_handler_start(struct file_handler *file_handler) {
-    LOGD("Starting file_handler thread");
+    LOGD("Starting file_handler threads (%u)", file_handler->worker_count);
 
-    file_handler->thread = SDL_CreateThread(run_file_handler, "file_handler",
-                                            file_handler);
-    if (!file_handler->thread) {
-        LOGC("Could not start file_handler thread");
-        return false;
+    for (unsigned i = 0; i < file_handler->worker_count; ++i) {
+        struct file_handler_worker *worker = &file_handler->workers[i];
+        worker->thread = SDL_CreateThread(run_file_handler_worker,
+                                          "file_handler", worker);
+        if (!worker->thread) {
+            LOGC("Could not start file_handler thread");
+            file_handler_stop(file_handler);
+            file_handler_join(file_handler);
+            return false;
+        }
     }
 
     return true;
 }
 
+// must be called with the mutex locked
+static void
+terminate_processes(struct file_handler *file_handler, bool wait) {
+    for (unsigned i = 0; i < file_handler->worker_count; ++i) {
+        struct file_handler_worker *worker = &file_handler->workers[i];
+        if (worker->current_process != PROCESS_NONE) {
+            if (!cmd_terminate(worker->current_process)) {
+                LOGW("Could not terminate install process");
+            }
+            worker->canceled = true;
+            if (wait) {
+                cmd_simple_wait(worker->current_process, NULL);
+                worker->current_process = PROCESS_NONE;
+            }
+        }
+    }
+}
+
 void
 file_handler_stop(struct file_handler *file_handler) {
     mutex_lock(file_handler->mutex);
     file_handler->stopped = true;
-    cond_signal(file_handler->event_cond);
-    if (file_handler->current_process != PROCESS_NONE) {
-        if (!cmd_terminate(file_handler->current_process)) {
-            LOGW("Could not terminate install process");
-        }
-        cmd_simple_wait(file_handler->current_process, NULL);
-        file_handler->current_process = PROCESS_NONE;
-    }
+    cond_broadcast(file_handler->event_cond);
+    terminate_processes(file_handler, true);
     mutex_unlock(file_handler->mutex);
 }
 
 void
 file_handler_join(struct file_handler *file_handler) {
-    SDL_WaitThread(file_handler->thread, NULL);
+    for (unsigned i = 0; i < file_handler->worker_count; ++i) {
+        struct file_handler_worker *worker = &file_handler->workers[i];
+        if (worker->thread) {
+            SDL_WaitThread(worker->thread, NULL);
+            worker->thread = NULL;
+        }
+    }
+}
+
+void
+file_handler_cancel(struct file_handler *file_handler) {
+    mutex_lock(file_handler->mutex);
+    unsigned dropped = drop_pending_requests(file_handler);
+    // the canceled requests are not part of the batch anymore
+    file_handler->total -= dropped;
+    bool running = file_handler->done < file_handler->total;
+    if (!running) {
+        reset_batch(file_handler);
+    }
+    // the workers reap their processes and complete their requests
+    terminate_processes(file_handler, false);
+    mutex_unlock(file_handler->mutex);
+
+    if (dropped || running) {
+        LOGI("File transfers canceled");
+    }
 }
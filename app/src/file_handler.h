@@ -7,7 +7,9 @@
 
 #include "config.h"
 #include "command.h"
-#include "util/cbuf.h"
+#include "util/queue.h"
+
+#define FILE_HANDLER_MAX_WORKERS 8
 
 typedef enum {
     ACTION_INSTALL_APK,
@@ -17,25 +19,49 @@ typedef enum {
 struct file_handler_request {
     file_handler_action_t action;
     char *file;
+    unsigned index; // in the current batch, for the progress
+    struct file_handler_request *next;
 };
 
-struct file_handler_request_queue CBUF(struct file_handler_request, 16);
+struct file_handler_request_queue QUEUE(struct file_handler_request);
+
+struct file_handler;
+
+struct file_handler_worker {
+    struct file_handler *file_handler;
+    SDL_Thread *thread;
+    // protected by the mutex of the file handler
+    process_t current_process;
+    bool canceled;
+};
 
+// Install the APKs and push the files dropped on the window, through adb
+//
+// The requests are queued (without limit) and handled by a pool of workers,
+// each one running one adb process at a time.
 struct file_handler {
     char *serial;
     const char *push_target;
-    SDL_Thread *thread;
     SDL_mutex *mutex;
     SDL_cond *event_cond;
     bool stopped;
     bool initialized;
-    process_t current_process;
     struct file_handler_request_queue queue;
+
+    // progress of the current batch, protected by the mutex (reset once all
+    // its requests are done)
+    unsigned total;
+    unsigned done;
+    unsigned failed;
+
+    unsigned worker_count;
+    struct file_handler_worker workers[FILE_HANDLER_MAX_WORKERS];
 };
 
+// worker_count is the number of files transferred in parallel
 bool
 file_handler_init(struct file_handler *file_handler, const char *serial,
-                  const char *push_target);
+                  const char *push_target, unsigned worker_count);
 
 void
 file_handler_destroy(struct file_handler *file_handler);
@@ -55,4 +81,8 @@ file_handler_request(struct file_handler *file_handler,
                      file_handler_action_t action,
                      char *file);
 
+// drop the pending requests and terminate the running adb processes
+void
+file_handler_cancel(struct file_handler *file_handler);
+
 #endif
@@ -0,0 +1,227 @@
+#include "file_writer.h"
+
+#include <assert.h>
+#include <string.h>
+#include <libavutil/mem.h>
+
+#include "config.h"
+#include "common.h"
+#include "util/lock.h"
+#include "util/log.h"
+
+// the buffer between the muxer and the ring
+#define AVIO_BUFFER_SIZE (64 * 1024)
+
+// append data to the ring, waiting for space if necessary
+static int
+write_packet(void *opaque, uint8_t *buf, int buf_size) {
+    struct file_writer *fw = opaque;
+
+    size_t remaining = buf_size;
+    while (remaining) {
+        mutex_lock(fw->mutex);
+        while (!fw->failed && fw->count == fw->capacity) {
+            cond_wait(fw->space_cond, fw->mutex);
+        }
+        if (fw->failed) {
+            mutex_unlock(fw->mutex);
+            return AVERROR(EIO);
+        }
+        size_t tail = (fw->head + fw->count) % fw->capacity;
+        size_t space = fw->capacity - fw->count;
+        mutex_unlock(fw->mutex);
+
+        // the free area is never accessed by the I/O thread, the copy does
+        // not need the mutex
+        size_t len = MIN(remaining, space);
+        size_t first = MIN(len, fw->capacity - tail);
+        memcpy(&fw->buffer[tail], buf, first);
+        memcpy(fw->buffer, buf + first, len - first);
+        buf += len;
+        remaining -= len;
+
+        mutex_lock(fw->mutex);
+        fw->count += len;
+        cond_signal(fw->data_cond);
+        mutex_unlock(fw->mutex);
+    }
+
+    return buf_size;
+}
+
+// wait for all the buffered data to be written
+// return false if a write failed
+// the mutex must be locked
+static bool
+drain(struct file_writer *fw) {
+    while (!fw->failed && (fw->count || fw->writing)) {
+        cond_wait(fw->space_cond, fw->mutex);
+    }
+    return !fw->failed;
+}
+
+static int64_t
+seek(void *opaque, int64_t offset, int whence) {
+    struct file_writer *fw = opaque;
+
+    mutex_lock(fw->mutex);
+    int64_t ret;
+    if (!drain(fw)) {
+        ret = AVERROR(EIO);
+    } else if (whence & AVSEEK_SIZE) {
+        ret = avio_size(fw->file);
+    } else {
+        // the I/O thread is idle, the file may be accessed from here
+        ret = avio_seek(fw->file, offset, whence);
+    }
+    mutex_unlock(fw->mutex);
+
+    return ret;
+}
+
+static int
+run_file_writer(void *data) {
+    struct file_writer *fw = data;
+
+    mutex_lock(fw->mutex);
+    for (;;) {
+        while (!fw->stopped && !fw->count) {
+            cond_wait(fw->data_cond, fw->mutex);
+        }
+        if (!fw->count) {
+            // stopped, everything is written
+            break;
+        }
+
+        // the contiguous part of the pending data
+        size_t head = fw->head;
+        size_t len = MIN(fw->count, fw->capacity - head);
+        fw->writing = true;
+        mutex_unlock(fw->mutex);
+
+        avio_write(fw->file, &fw->buffer[head], len);
+        bool failed = fw->file->error < 0;
+
+        mutex_lock(fw->mutex);
+        fw->writing = false;
+        fw->head = (head + len) % fw->capacity;
+        fw->count -= len;
+        if (failed) {
+            LOGE("Could not write to the output file");
+            fw->failed = true;
+            // drop the pending data, the file is broken anyway
+            fw->count = 0;
+        }
+        cond_broadcast(fw->space_cond);
+    }
+    mutex_unlock(fw->mutex);
+
+    return 0;
+}
+
+bool
+file_writer_open(struct file_writer *fw, const char *filename,
+                 size_t buffer_size) {
+    assert(buffer_size);
+
+    fw->buffer = SDL_malloc(buffer_size);
+    if (!fw->buffer) {
+        LOGC("Could not allocate write buffer");
+        return false;
+    }
+    fw->capacity = buffer_size;
+    fw->head = 0;
+    fw->count = 0;
+    fw->stopped = false;
+    fw->failed = false;
+    fw->writing = false;
+
+    if (!(fw->mutex = SDL_CreateMutex())) {
+        goto error_free_buffer;
+    }
+
+    if (!(fw->data_cond = SDL_CreateCond())) {
+        goto error_destroy_mutex;
+    }
+
+    if (!(fw->space_cond = SDL_CreateCond())) {
+        goto error_destroy_data_cond;
+    }
+
+    // avio handles UTF-8 file names on all platforms
+    if (avio_open(&fw->file, filename, AVIO_FLAG_WRITE) < 0) {
+        LOGE("Failed to open output file: %s", filename);
+        goto error_destroy_space_cond;
+    }
+
+    // owned by the AVIOContext (it may be reallocated)
+    uint8_t *avio_buffer = av_malloc(AVIO_BUFFER_SIZE);
+    if (!avio_buffer) {
+        LOGC("Could not allocate avio buffer");
+        goto error_close_file;
+    }
+
+    fw->avio = avio_alloc_context(avio_buffer, AVIO_BUFFER_SIZE, 1, fw, NULL,
+                                  write_packet, seek);
+    if (!fw->avio) {
+        LOGC("Could not allocate avio context");
+        av_free(avio_buffer);
+        goto error_close_file;
+    }
+    // the muxers write their index on trailer only if the output is seekable
+    fw->avio->seekable = fw->file->seekable;
+
+    fw->thread = SDL_CreateThread(run_file_writer, "file_writer", fw);
+    if (!fw->thread) {
+        LOGC("Could not start file writer thread");
+        goto error_free_avio;
+    }
+
+    return true;
+
+error_free_avio:
+    av_freep(&fw->avio->buffer);
+    avio_context_free(&fw->avio);
+error_close_file:
+    avio_closep(&fw->file);
+error_destroy_space_cond:
+    SDL_DestroyCond(fw->space_cond);
+error_destroy_data_cond:
+    SDL_DestroyCond(fw->data_cond);
+error_destroy_mutex:
+    SDL_DestroyMutex(fw->mutex);
+error_free_buffer:
+    SDL_free(fw->buffer);
+
+    return false;
+}
+
+bool
+file_writer_close(struct file_writer *fw) {
+    // write the data still in the muxer buffer to the ring
+    avio_flush(fw->avio);
+    bool ok = fw->avio->error >= 0;
+
+    mutex_lock(fw->mutex);
+    fw->stopped = true;
+    cond_signal(fw->data_cond);
+    mutex_unlock(fw->mutex);
+
+    SDL_WaitThread(fw->thread, NULL);
+
+    if (fw->failed) {
+        ok = false;
+    }
+    if (avio_closep(&fw->file) < 0) {
+        ok = false;
+    }
+
+    av_freep(&fw->avio->buffer);
+    avio_context_free(&fw->avio);
+    SDL_DestroyCond(fw->space_cond);
+    SDL_DestroyCond(fw->data_cond);
+    SDL_DestroyMutex(fw->mutex);
+    SDL_free(fw->buffer);
+
+    return ok;
+}
@@ -0,0 +1,50 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavformat/avio.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+#include "config.h"
+
+// Write-behind output file, to be used as the AVIOContext of a muxer
+//
+// The muxer writes into a large ring buffer (from its own thread), which is
+// written to the actual file by a separate I/O thread. That way, the muxer
+// only waits for the storage if the buffer is full (on a slow or remote file
+// system, each write may take several milliseconds).
+//
+// A seek (the muxers seek back to complete the headers, typically on trailer)
+// waits for all the buffered data to be written.
+struct file_writer {
+    AVIOContext *avio; // the context to pass to the muxer
+    AVIOContext *file; // the actual output, only written by the I/O thread
+
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *data_cond; // signaled when data is appended
+    SDL_cond *space_cond; // signaled when data is written to the file
+    bool stopped;
+    bool failed; // a write to the file has failed
+    bool writing; // the I/O thread is writing (outside the mutex)
+
+    uint8_t *buffer;
+    size_t capacity;
+    size_t head; // index of the oldest byte
+    size_t count;
+};
+
+// buffer_size is the size of the ring buffer, in bytes
+bool
+file_writer_open(struct file_writer *fw, const char *filename,
+                 size_t buffer_size);
+
+// write the pending data and close the file
+// return false if any write failed
+bool
+file_writer_close(struct file_writer *fw);
+
+#endif
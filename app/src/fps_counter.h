@@ -4,34 +4,40 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <SDL2/SDL_mutex.h>
-#include <SDL2/SDL_thread.h>
 
 #include "config.h"
-
+#include "metrics.h"
+
+// Log the frame rate every second, when enabled (MOD+i)
+//
+// The frames are not counted here: the counters of the session (struct
+// metrics) are always updated by relaxed atomics, the FPS counter only samples
+// them on each rendered frame, from the consumer thread, and logs the
+// differences once the interval is expired. There is no lock and no thread.
+//
+// Since the sampling is driven by the rendered frames, nothing is logged while
+// no frame is rendered (the rate is computed over the actual elapsed time on
+// the next one).
 struct fps_counter {
-    SDL_Thread *thread;
-    SDL_mutex *mutex;
-    SDL_cond *state_cond;
+    const struct metrics *metrics;
 
-    // atomic so that we can check without locking the mutex
-    // if the FPS counter is disabled, we don't want to lock unnecessarily
+    // written by the main thread, read by the consumer thread
     atomic_bool started;
-
-    // the following fields are protected by the mutex
-    bool interrupted;
-    unsigned nr_rendered;
-    unsigned nr_skipped;
-    uint32_t next_timestamp;
+    // set on start, so that the consumer thread resets its samples
+    atomic_bool restarted;
+
+    // only accessed from the consumer thread
+    uint32_t interval_start; // in SDL ticks
+    uint64_t rendered_start; // sampled rendered_frames
+    uint64_t skipped_start; // sampled skipped_frames
+    // maximum number of decoded frames waiting to be rendered
+    unsigned max_queue_depth;
 };
 
-bool
-fps_counter_init(struct fps_counter *counter);
-
 void
-fps_counter_destroy(struct fps_counter *counter);
+fps_counter_init(struct fps_counter *counter, const struct metrics *metrics);
 
-bool
+void
 fps_counter_start(struct fps_counter *counter);
 
 void
@@ -40,18 +46,13 @@ fps_counter_stop(struct fps_counter *counter);
 bool
 fps_counter_is_started(struct fps_counter *counter);
 
-// request to stop the thread (on quit)
-// must be called before fps_counter_join()
-void
-fps_counter_interrupt(struct fps_counter *counter);
-
-void
-fps_counter_join(struct fps_counter *counter);
-
-void
-fps_counter_add_rendered_frame(struct fps_counter *counter);
-
+// sample the counters once a frame has been consumed for rendering (and
+// counted in the metrics)
+// queue_depth is the number of decoded frames which were waiting to be
+// rendered
+// must be called from the consumer thread
 void
-fps_counter_add_skipped_frame(struct fps_counter *counter);
+fps_counter_on_rendered_frame(struct fps_counter *counter,
+                              unsigned queue_depth);
 
 #endif
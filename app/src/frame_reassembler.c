@@ -0,0 +1,173 @@
+#include "frame_reassembler.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "config.h"
+#include "h264_nal.h"
+#include "util/buffer_util.h"
+#include "util/log.h"
+
+void
+frame_reassembler_init(struct frame_reassembler *ra,
+                        bool detect_non_reference) {
+    ra->data = NULL;
+    ra->capacity = 0;
+    ra->received = NULL;
+    ra->received_capacity = 0;
+    ra->in_progress = false;
+    ra->started = false;
+    ra->next_seq = 0;
+    ra->detect_non_reference = detect_non_reference;
+    ra->lost_packets = 0;
+    ra->lost_reference = false;
+}
+
+void
+frame_reassembler_destroy(struct frame_reassembler *ra) {
+    SDL_free(ra->data);
+    SDL_free(ra->received);
+}
+
+// tell whether seq a is before seq b (modulo 2^32)
+static inline bool
+seq_before(uint32_t a, uint32_t b) {
+    return (int32_t) (a - b) < 0;
+}
+
+static void
+drop_current(struct frame_reassembler *ra) {
+    assert(ra->in_progress);
+    ++ra->lost_packets;
+    // a non-reference frame may be dropped safely, but its first fragment is
+    // needed to know it
+    bool reference = !ra->detect_non_reference || !ra->received[0]
+                  || h264_is_reference(ra->data, ra->fragment_count > 1
+                                           ? FRAME_REASSEMBLER_MAX_PAYLOAD
+                                           : ra->size);
+    if (reference) {
+        ra->lost_reference = true;
+    }
+    LOGD("Incomplete packet %" PRIu32 " dropped (%u/%u fragments%s)",
+         ra->seq, ra->received_count, ra->fragment_count,
+         reference ? "" : ", non-reference");
+    ra->in_progress = false;
+    ra->started = true;
+    ra->next_seq = ra->seq + 1;
+}
+
+static bool
+begin(struct frame_reassembler *ra, uint32_t seq, uint16_t fragment_count,
+      uint64_t pts, uint64_t capture_time, uint32_t size) {
+    if (size > ra->capacity) {
+        uint8_t *data = SDL_realloc(ra->data, size);
+        if (!data) {
+            LOGC("Could not allocate packet");
+            return false;
+        }
+        ra->data = data;
+        ra->capacity = size;
+    }
+    if (fragment_count > ra->received_capacity) {
+        uint8_t *received = SDL_realloc(ra->received, fragment_count);
+        if (!received) {
+            LOGC("Could not allocate fragment flags");
+            return false;
+        }
+        ra->received = received;
+        ra->received_capacity = fragment_count;
+    }
+    memset(ra->received, 0, fragment_count);
+
+    if (ra->started && seq != ra->next_seq) {
+        // no fragment at all of the packets in between
+        ra->lost_packets += seq - ra->next_seq;
+        ra->lost_reference = true;
+        LOGD("Packets %" PRIu32 " to %" PRIu32 " lost", ra->next_seq,
+             seq - 1);
+    }
+
+    ra->in_progress = true;
+    ra->seq = seq;
+    ra->fragment_count = fragment_count;
+    ra->received_count = 0;
+    ra->pts = pts;
+    ra->capture_time = capture_time;
+    ra->size = size;
+    return true;
+}
+
+int
+frame_reassembler_push(struct frame_reassembler *ra, const uint8_t *datagram,
+                       size_t len, struct reassembled_frame *frame) {
+    if (len < FRAME_REASSEMBLER_HEADER_SIZE) {
+        LOGW("Datagram too short: %" PRIu64 " bytes", (uint64_t) len);
+        return 0;
+    }
+
+    uint32_t seq = buffer_read32be(datagram);
+    uint16_t index = buffer_read16be(&datagram[4]);
+    uint16_t count = buffer_read16be(&datagram[6]);
+    uint64_t pts = buffer_read64be(&datagram[8]);
+    uint64_t capture_time = buffer_read64be(&datagram[16]);
+    uint32_t size = buffer_read32be(&datagram[24]);
+    const uint8_t *payload = &datagram[FRAME_REASSEMBLER_HEADER_SIZE];
+    size_t payload_len = len - FRAME_REASSEMBLER_HEADER_SIZE;
+
+    size_t offset = (size_t) index * FRAME_REASSEMBLER_MAX_PAYLOAD;
+    bool valid = size && index < count
+              && ((uint64_t) size + FRAME_REASSEMBLER_MAX_PAYLOAD - 1)
+                    / FRAME_REASSEMBLER_MAX_PAYLOAD == count
+              && payload_len == (index == count - 1
+                                     ? size - offset
+                                     : FRAME_REASSEMBLER_MAX_PAYLOAD);
+    if (!valid) {
+        LOGW("Malformed datagram ignored");
+        return 0;
+    }
+
+    if (ra->in_progress && seq != ra->seq) {
+        if (seq_before(seq, ra->seq)) {
+            // late fragment of a dropped packet
+            return 0;
+        }
+        drop_current(ra);
+    }
+
+    if (!ra->in_progress) {
+        if (ra->started && seq_before(seq, ra->next_seq)) {
+            // late or duplicated fragment of a complete or dropped packet
+            return 0;
+        }
+        if (!begin(ra, seq, count, pts, capture_time, size)) {
+            return -1;
+        }
+    } else if (count != ra->fragment_count || size != ra->size) {
+        LOGW("Inconsistent datagram ignored");
+        return 0;
+    }
+
+    if (ra->received[index]) {
+        // duplicated
+        return 0;
+    }
+    memcpy(ra->data + offset, payload, payload_len);
+    ra->received[index] = 1;
+    ++ra->received_count;
+
+    if (ra->received_count < ra->fragment_count) {
+        return 0;
+    }
+
+    ra->in_progress = false;
+    ra->started = true;
+    ra->next_seq = seq + 1;
+
+    frame->pts = ra->pts;
+    frame->capture_time = ra->capture_time;
+    frame->data = ra->data;
+    frame->size = ra->size;
+    return 1;
+}
@@ -0,0 +1,80 @@
+#ifndef FRAME_REASSEMBLER_H
+#define FRAME_REASSEMBLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Over UDP, each packet is split into fragments, sent as separate datagrams.
+//
+// The datagram header length is 28 bytes:
+// [. . . .|. .|. .|. . . . . . . .|. . . . . . . .|. . . .]. . . . . . ...
+//  <-----> <-> <-> <-------------> <-------------> <-----> <-------------...
+//  packet  fragment        PTS       capture time  packet     fragment
+//  seq    index count                               size      payload
+//
+// The PTS, the capture time and the packet size are the same as the TCP frame
+// meta header, they are repeated in the header of each fragment. Every
+// fragment but the last one contains exactly FRAME_REASSEMBLER_MAX_PAYLOAD
+// bytes.
+#define FRAME_REASSEMBLER_HEADER_SIZE 28
+// must match the server (small enough to avoid IP fragmentation)
+#define FRAME_REASSEMBLER_MAX_PAYLOAD 1200
+#define FRAME_REASSEMBLER_MAX_DATAGRAM \
+    (FRAME_REASSEMBLER_HEADER_SIZE + FRAME_REASSEMBLER_MAX_PAYLOAD)
+
+struct reassembled_frame {
+    uint64_t pts;
+    uint64_t capture_time;
+    const uint8_t *data; // valid until the next push
+    size_t size;
+};
+
+// Reassemble the packets from their fragments, received in any order.
+//
+// Only one packet is reassembled at a time: when a fragment of a more recent
+// packet is received, the current one is dropped (its missing fragments are
+// considered lost, they would arrive too late anyway).
+struct frame_reassembler {
+    uint8_t *data;
+    size_t capacity;
+    uint8_t *received; // one flag per fragment
+    size_t received_capacity;
+
+    bool in_progress;
+    uint32_t seq;
+    uint16_t fragment_count;
+    uint16_t received_count;
+    uint64_t pts;
+    uint64_t capture_time;
+    uint32_t size;
+
+    bool started; // at least one packet has been completed (or dropped)
+    uint32_t next_seq;
+
+    // if set, a lost non-reference H.264 frame does not break the decoding
+    bool detect_non_reference;
+
+    uint64_t lost_packets;
+    // set when a lost packet may be referenced by the next ones (the decoding
+    // is broken until the next key frame), to be reset by the caller
+    bool lost_reference;
+};
+
+void
+frame_reassembler_init(struct frame_reassembler *ra,
+                        bool detect_non_reference);
+
+void
+frame_reassembler_destroy(struct frame_reassembler *ra);
+
+// process one datagram (malformed, late and duplicated ones are ignored)
+// return 1 if a packet is complete (written to frame), 0 if more fragments are
+// needed, or -1 on allocation error
+int
+frame_reassembler_push(struct frame_reassembler *ra, const uint8_t *datagram,
+                       size_t len, struct reassembled_frame *frame);
+
+#endif
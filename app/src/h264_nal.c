@@ -0,0 +1,271 @@
+#include "h264_nal.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
+// an SPS is a few dozens of bytes, unless it contains scaling matrices
+#define SPS_MAX_SIZE 512
+
+size_t
+h264_find_nal(const uint8_t *data, size_t len) {
+    size_t i = 2;
+
+    // A start code ends at i if data[i] == 1 and data[i - 2] | data[i - 1]
+    // == 0: test 16 positions at once (with unaligned loads of the previous
+    // bytes), the scalar loop below locates the match in the block.
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &data[i - 2]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &data[i - 1]);
+        __m128i c = _mm_loadu_si128((const __m128i *) &data[i]);
+        __m128i m = _mm_and_si128(_mm_cmpeq_epi8(c, one),
+                                  _mm_cmpeq_epi8(_mm_or_si128(a, b), zero));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return i + __builtin_ctz(mask) + 1;
+        }
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t a = vld1q_u8(&data[i - 2]);
+        uint8x16_t b = vld1q_u8(&data[i - 1]);
+        uint8x16_t c = vld1q_u8(&data[i]);
+        uint8x16_t m = vandq_u8(vceqq_u8(c, vdupq_n_u8(1)),
+                                vceqzq_u8(vorrq_u8(a, b)));
+        if (vmaxvq_u8(m)) {
+            break;
+        }
+    }
+#endif
+
+    // a 4-byte start code (00 00 00 01) ends with a 3-byte one
+    for (; i < len; ++i) {
+        if (data[i] > 1) {
+            // no start code can end at i, i + 1 or i + 2
+            i += 2;
+        } else if (data[i] == 1 && !data[i - 1] && !data[i - 2]) {
+            return i + 1;
+        }
+    }
+    return len;
+}
+
+bool
+h264_is_key_frame(const uint8_t *data, size_t len) {
+    size_t offset = 0;
+    for (;;) {
+        offset += h264_find_nal(data + offset, len - offset);
+        if (offset >= len) {
+            return false;
+        }
+
+        uint8_t type = H264_NAL_TYPE(data[offset]);
+        if (type == H264_NAL_IDR_SLICE) {
+            return true;
+        }
+        if (type == H264_NAL_SLICE) {
+            // the first slice of the access unit is not IDR
+            return false;
+        }
+        // other NAL units (SPS, PPS, SEI…) precede the slices
+    }
+}
+
+bool
+h264_is_reference(const uint8_t *data, size_t len) {
+    size_t offset = 0;
+    for (;;) {
+        offset += h264_find_nal(data + offset, len - offset);
+        if (offset >= len) {
+            // unknown, assume the worst
+            return true;
+        }
+
+        uint8_t type = H264_NAL_TYPE(data[offset]);
+        if (type == H264_NAL_SLICE || type == H264_NAL_IDR_SLICE) {
+            return H264_NAL_REF_IDC(data[offset]) != 0;
+        }
+    }
+}
+
+struct bit_reader {
+    const uint8_t *data;
+    size_t len; // in bytes
+    size_t pos; // in bits
+    bool overflow;
+};
+
+static unsigned
+read_bits(struct bit_reader *br, unsigned n) {
+    unsigned value = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        if (br->pos >= br->len * 8) {
+            br->overflow = true;
+            return 0;
+        }
+        unsigned bit = (br->data[br->pos / 8] >> (7 - br->pos % 8)) & 1;
+        value = (value << 1) | bit;
+        ++br->pos;
+    }
+    return value;
+}
+
+// Exp-Golomb unsigned value, ue(v)
+static uint32_t
+read_ue(struct bit_reader *br) {
+    unsigned zeros = 0;
+    while (!read_bits(br, 1)) {
+        if (br->overflow || ++zeros > 31) {
+            br->overflow = true;
+            return 0;
+        }
+    }
+    return (UINT32_C(1) << zeros) - 1 + read_bits(br, zeros);
+}
+
+// Exp-Golomb signed value, se(v)
+static int32_t
+read_se(struct bit_reader *br) {
+    uint32_t v = read_ue(br);
+    return v & 1 ? (int32_t) ((v + 1) / 2) : -(int32_t) (v / 2);
+}
+
+static void
+skip_scaling_list(struct bit_reader *br, unsigned size) {
+    int last = 8;
+    int next = 8;
+    for (unsigned i = 0; i < size && !br->overflow; ++i) {
+        if (next) {
+            next = (last + read_se(br) + 256) % 256;
+        }
+        if (next) {
+            last = next;
+        }
+    }
+}
+
+bool
+h264_parse_sps_size(const uint8_t *nal, size_t len, unsigned *width,
+                    unsigned *height) {
+    if (!len || H264_NAL_TYPE(nal[0]) != H264_NAL_SPS) {
+        return false;
+    }
+
+    // remove the emulation prevention bytes (00 00 03)
+    uint8_t rbsp[SPS_MAX_SIZE];
+    size_t rbsp_len = 0;
+    unsigned zeros = 0;
+    for (size_t i = 1; i < len && rbsp_len < SPS_MAX_SIZE; ++i) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] ? 0 : zeros + 1;
+        rbsp[rbsp_len++] = nal[i];
+    }
+
+    struct bit_reader br = {
+        .data = rbsp,
+        .len = rbsp_len,
+        .pos = 0,
+        .overflow = false,
+    };
+
+    unsigned profile_idc = read_bits(&br, 8);
+    read_bits(&br, 16); // constraint flags and level_idc
+    read_ue(&br); // seq_parameter_set_id
+
+    unsigned chroma_format_idc = 1;
+    bool separate_colour_plane = false;
+    switch (profile_idc) {
+        case 100: case 110: case 122: case 244: case 44: case 83: case 86:
+        case 118: case 128: case 138: case 139: case 134: case 135:
+            chroma_format_idc = read_ue(&br);
+            if (chroma_format_idc > 3) {
+                return false;
+            }
+            if (chroma_format_idc == 3) {
+                separate_colour_plane = read_bits(&br, 1);
+            }
+            read_ue(&br); // bit_depth_luma_minus8
+            read_ue(&br); // bit_depth_chroma_minus8
+            read_bits(&br, 1); // qpprime_y_zero_transform_bypass_flag
+            if (read_bits(&br, 1)) { // seq_scaling_matrix_present_flag
+                unsigned count = chroma_format_idc == 3 ? 12 : 8;
+                for (unsigned i = 0; i < count; ++i) {
+                    if (read_bits(&br, 1)) {
+                        skip_scaling_list(&br, i < 6 ? 16 : 64);
+                    }
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    read_ue(&br); // log2_max_frame_num_minus4
+    uint32_t pic_order_cnt_type = read_ue(&br);
+    if (pic_order_cnt_type == 0) {
+        read_ue(&br); // log2_max_pic_order_cnt_lsb_minus4
+    } else if (pic_order_cnt_type == 1) {
+        read_bits(&br, 1); // delta_pic_order_always_zero_flag
+        read_se(&br); // offset_for_non_ref_pic
+        read_se(&br); // offset_for_top_to_bottom_field
+        uint32_t count = read_ue(&br);
+        if (count > 255) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            read_se(&br); // offset_for_ref_frame
+        }
+    }
+    read_ue(&br); // max_num_ref_frames
+    read_bits(&br, 1); // gaps_in_frame_num_value_allowed_flag
+    uint32_t width_in_mbs = read_ue(&br) + 1;
+    uint32_t height_in_map_units = read_ue(&br) + 1;
+    bool frame_mbs_only = read_bits(&br, 1);
+    if (!frame_mbs_only) {
+        read_bits(&br, 1); // mb_adaptive_frame_field_flag
+    }
+    read_bits(&br, 1); // direct_8x8_inference_flag
+
+    uint32_t crop_left = 0;
+    uint32_t crop_right = 0;
+    uint32_t crop_top = 0;
+    uint32_t crop_bottom = 0;
+    if (read_bits(&br, 1)) { // frame_cropping_flag
+        crop_left = read_ue(&br);
+        crop_right = read_ue(&br);
+        crop_top = read_ue(&br);
+        crop_bottom = read_ue(&br);
+    }
+
+    if (br.overflow || width_in_mbs > 1024 || height_in_map_units > 1024) {
+        return false;
+    }
+
+    // the crop offsets are expressed in chroma samples
+    unsigned crop_unit_x = 1;
+    unsigned crop_unit_y = 2 - frame_mbs_only;
+    if (chroma_format_idc && !separate_colour_plane) {
+        crop_unit_x = chroma_format_idc == 3 ? 1 : 2;
+        crop_unit_y *= chroma_format_idc == 1 ? 2 : 1;
+    }
+
+    uint64_t w = (uint64_t) width_in_mbs * 16;
+    uint64_t h = (uint64_t) height_in_map_units * 16 * (2 - frame_mbs_only);
+    uint64_t crop_x = (uint64_t) crop_unit_x * (crop_left + crop_right);
+    uint64_t crop_y = (uint64_t) crop_unit_y * (crop_top + crop_bottom);
+    if (crop_x >= w || crop_y >= h) {
+        return false;
+    }
+
+    *width = w - crop_x;
+    *height = h - crop_y;
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef H264_NAL_H
+#define H264_NAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR_SLICE 5
+#define H264_NAL_SEI 6
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H264_NAL_AUD 9
+#define H264_NAL_TYPE(HEADER) ((HEADER) & 0x1f)
+#define H264_NAL_REF_IDC(HEADER) (((HEADER) >> 5) & 0x3)
+
+// return the offset of the first NAL unit payload (just after a 00 00 01
+// start code) at or after data, or len if there is none
+//
+// The start codes are searched 16 bytes at a time with SSE2 or NEON if
+// available.
+size_t
+h264_find_nal(const uint8_t *data, size_t len);
+
+// tell whether an Annex B access unit (possibly prefixed by SPS/PPS) contains
+// an IDR slice, by inspecting the NAL headers only
+bool
+h264_is_key_frame(const uint8_t *data, size_t len);
+
+// tell whether an Annex B access unit may be referenced by the next ones (its
+// first slice has a non-zero nal_ref_idc)
+// return true if there is no slice in data (it may be truncated)
+bool
+h264_is_reference(const uint8_t *data, size_t len);
+
+// read the frame size (cropped) from an SPS NAL unit (starting with its
+// header, without start code)
+// return false if the SPS is invalid or truncated
+bool
+h264_parse_sps_size(const uint8_t *nal, size_t len, unsigned *width,
+                    unsigned *height);
+
+#endif
@@ -1,12 +1,14 @@
 #include "input_manager.h"
 
 #include <assert.h>
+#include <string.h>
 #include <SDL2/SDL_keycode.h>
 
 #include "config.h"
 #include "event_converter.h"
 #include "util/lock.h"
 #include "util/log.h"
+#include "util/str_util.h"
 
 static const int ACTION_DOWN = 1;
 static const int ACTION_UP = 1 << 1;
@@ -222,11 +224,8 @@ switch_fps_counter_state(struct fps_counter *fps_counter) {
         fps_counter_stop(fps_counter);
         LOGI("FPS counter stopped");
     } else {
-        if (fps_counter_start(fps_counter)) {
-            LOGI("FPS counter started");
-        } else {
-            LOGE("FPS counter starting failed");
-        }
+        fps_counter_start(fps_counter);
+        LOGI("FPS counter started");
     }
 }
 
@@ -243,13 +242,33 @@ clipboard_paste(struct controller *controller) {
         return;
     }
 
-    struct control_msg msg;
-    msg.type = CONTROL_MSG_TYPE_INJECT_TEXT;
-    msg.inject_text.text = text;
-    if (!controller_push_msg(controller, &msg)) {
-        SDL_free(text);
-        LOGW("Could not request 'paste clipboard'");
+    // a message is limited to CONTROL_MSG_INJECT_TEXT_MAX_LENGTH bytes: split
+    // the text into several messages (on code point boundaries)
+    const char *chunk = text;
+    while (*chunk) {
+        size_t len =
+            utf8_truncation_index(chunk, CONTROL_MSG_INJECT_TEXT_MAX_LENGTH);
+        assert(len);
+
+        struct control_msg msg;
+        msg.type = CONTROL_MSG_TYPE_INJECT_TEXT;
+        msg.inject_text.text = SDL_malloc(len + 1);
+        if (!msg.inject_text.text) {
+            LOGW("Could not allocate text chunk");
+            break;
+        }
+        memcpy(msg.inject_text.text, chunk, len);
+        msg.inject_text.text[len] = '\0';
+
+        if (!controller_push_msg(controller, &msg)) {
+            SDL_free(msg.inject_text.text);
+            LOGW("Could not request 'paste clipboard'");
+            break;
+        }
+        chunk += len;
     }
+
+    SDL_free(text);
 }
 
 static void
@@ -262,6 +281,46 @@ rotate_device(struct controller *controller) {
     }
 }
 
+// crop the device screen to the half of the current frame around the mouse, or
+// restore the initial crop
+static void
+set_crop(struct controller *controller, struct screen *screen, bool reset) {
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_SET_CROP;
+    msg.set_crop.position.screen_size = screen->frame_size;
+
+    if (reset) {
+        msg.set_crop.position.point.x = 0;
+        msg.set_crop.position.point.y = 0;
+        msg.set_crop.width = 0;
+        msg.set_crop.height = 0;
+    } else {
+        int mouse_x;
+        int mouse_y;
+        SDL_GetMouseState(&mouse_x, &mouse_y);
+        struct point center =
+            screen_convert_window_to_frame_coords(screen, mouse_x, mouse_y);
+
+        struct size *size = &screen->frame_size;
+        int32_t w = size->width / 2;
+        int32_t h = size->height / 2;
+        // keep the crop within the frame
+        int32_t x = MAX(center.x - w / 2, 0);
+        x = MIN(x, size->width - w);
+        int32_t y = MAX(center.y - h / 2, 0);
+        y = MIN(y, size->height - h);
+
+        msg.set_crop.position.point.x = x;
+        msg.set_crop.position.point.y = y;
+        msg.set_crop.width = w;
+        msg.set_crop.height = h;
+    }
+
+    if (!controller_push_msg(controller, &msg)) {
+        LOGW("Could not request 'set crop'");
+    }
+}
+
 static void
 rotate_client_left(struct screen *screen) {
     unsigned new_rotation = (screen->rotation + 1) % 4;
@@ -388,6 +447,8 @@ input_manager_process_key(struct input_manager *im,
             case SDLK_s:
                 if (control && !shift && !repeat) {
                     action_app_switch(controller, action);
+                } else if (shift && !repeat && down && im->screenshot) {
+                    screenshot_request(im->screenshot);
                 }
                 return;
             case SDLK_m:
@@ -438,6 +499,8 @@ input_manager_process_key(struct input_manager *im,
             case SDLK_x:
                 if (control && !shift && !repeat) {
                     action_cut(controller, action);
+                } else if (shift && !repeat && down && im->file_handler) {
+                    file_handler_cancel(im->file_handler);
                 }
                 return;
             case SDLK_v:
@@ -467,10 +530,14 @@ input_manager_process_key(struct input_manager *im,
                 }
                 return;
             case SDLK_i:
-                if (!shift && !repeat && down) {
-                    struct fps_counter *fps_counter =
-                        im->video_buffer->fps_counter;
-                    switch_fps_counter_state(fps_counter);
+                if (!repeat && down) {
+                    if (shift) {
+                        screen_log_latency_stats(im->screen, im->video_buffer);
+                    } else {
+                        struct fps_counter *fps_counter =
+                            im->video_buffer->fps_counter;
+                        switch_fps_counter_state(fps_counter);
+                    }
                 }
                 return;
             case SDLK_n:
@@ -482,9 +549,16 @@ input_manager_process_key(struct input_manager *im,
                     }
                 }
                 return;
+            case SDLK_z:
+                if (control && !repeat && down) {
+                    set_crop(controller, im->screen, shift);
+                }
+                return;
             case SDLK_r:
                 if (control && !shift && !repeat && down) {
                     rotate_device(controller);
+                } else if (shift && !repeat && down && im->replay_buffer) {
+                    replay_buffer_save(im->replay_buffer);
                 }
                 return;
         }
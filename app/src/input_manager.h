@@ -9,14 +9,20 @@
 #include "common.h"
 #include "controller.h"
 #include "fps_counter.h"
+#include "file_handler.h"
+#include "replay_buffer.h"
 #include "scrcpy.h"
 #include "screen.h"
+#include "screenshot.h"
 #include "video_buffer.h"
 
 struct input_manager {
     struct controller *controller;
     struct video_buffer *video_buffer;
     struct screen *screen;
+    struct replay_buffer *replay_buffer; // may be NULL
+    struct file_handler *file_handler; // may be NULL
+    struct screenshot *screenshot; // may be NULL
 
     // SDL reports repeated events as a boolean, but Android expects the actual
     // number of repetitions. This variable keeps track of the count.
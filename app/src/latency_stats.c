@@ -0,0 +1,126 @@
+#include "latency_stats.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+static const char *const stage_names[] = {
+    [SC_LATENCY_STAGE_DEVICE] = "device",
+    [SC_LATENCY_STAGE_DECODE] = "decode",
+    [SC_LATENCY_STAGE_OFFER] = "offer",
+    [SC_LATENCY_STAGE_RENDER] = "render",
+    [SC_LATENCY_STAGE_TOTAL] = "total",
+    [SC_LATENCY_STAGE_GLASS] = "glass",
+};
+
+const char *
+latency_stage_get_name(enum sc_latency_stage stage) {
+    assert(stage < SC_LATENCY_STAGE_COUNT);
+    return stage_names[stage];
+}
+
+static int64_t
+get_duration(int64_t from, int64_t to) {
+    if (!from || !to) {
+        // unknown timestamp
+        return -1;
+    }
+    int64_t duration = to - from;
+    return duration < 0 ? 0 : duration;
+}
+
+void
+sc_frame_times_get_stages(const struct sc_frame_times *times,
+                          int64_t presented,
+                          int64_t durations[SC_LATENCY_STAGE_COUNT]) {
+    int64_t *d = durations;
+    d[SC_LATENCY_STAGE_DEVICE] = get_duration(times->captured, times->received);
+    d[SC_LATENCY_STAGE_DECODE] = get_duration(times->received, times->decoded);
+    d[SC_LATENCY_STAGE_OFFER] = get_duration(times->decoded, times->offered);
+    d[SC_LATENCY_STAGE_RENDER] = get_duration(times->offered, presented);
+    d[SC_LATENCY_STAGE_TOTAL] = get_duration(times->received, presented);
+    d[SC_LATENCY_STAGE_GLASS] = get_duration(times->captured, presented);
+}
+
+void
+latency_stats_init(struct latency_stats *stats) {
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        stats->windows[i].count = 0;
+        stats->windows[i].head = 0;
+    }
+}
+
+static void
+window_add(struct latency_window *window, int64_t duration) {
+    if (duration < 0) {
+        // unknown timestamp
+        return;
+    }
+
+    if (duration > UINT32_MAX) {
+        duration = UINT32_MAX;
+    }
+
+    window->samples[window->head] = duration;
+    window->head = (window->head + 1) % LATENCY_STATS_WINDOW_SIZE;
+    if (window->count < LATENCY_STATS_WINDOW_SIZE) {
+        ++window->count;
+    }
+}
+
+void
+latency_stats_add_frame(struct latency_stats *stats,
+                        const struct sc_frame_times *times, int64_t presented) {
+    int64_t durations[SC_LATENCY_STAGE_COUNT];
+    sc_frame_times_get_stages(times, presented, durations);
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        window_add(&stats->windows[i], durations[i]);
+    }
+}
+
+static int
+compare_samples(const void *a, const void *b) {
+    uint32_t va = *(const uint32_t *) a;
+    uint32_t vb = *(const uint32_t *) b;
+    return (va > vb) - (va < vb);
+}
+
+// the samples must be sorted
+static uint32_t
+percentile(const uint32_t *samples, unsigned count, unsigned p) {
+    assert(count);
+    assert(p <= 100);
+    unsigned index = (count - 1) * p / 100;
+    return samples[index];
+}
+
+void
+latency_stats_log(struct latency_stats *stats) {
+    static uint32_t sorted[LATENCY_STATS_WINDOW_SIZE];
+
+    unsigned frames = stats->windows[SC_LATENCY_STAGE_TOTAL].count;
+    if (!frames) {
+        LOGI("Latency: no frame rendered yet");
+        return;
+    }
+
+    LOGI("Latency over the last %u frames (p50 / p95 / p99):", frames);
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        struct latency_window *window = &stats->windows[i];
+        if (!window->count) {
+            continue;
+        }
+
+        memcpy(sorted, window->samples, window->count * sizeof(*sorted));
+        qsort(sorted, window->count, sizeof(*sorted), compare_samples);
+
+        uint32_t p50 = percentile(sorted, window->count, 50);
+        uint32_t p95 = percentile(sorted, window->count, 95);
+        uint32_t p99 = percentile(sorted, window->count, 99);
+        LOGI("    %-6s %3u.%03u / %3u.%03u / %3u.%03u ms", stage_names[i],
+             p50 / 1000, p50 % 1000, p95 / 1000, p95 % 1000,
+             p99 / 1000, p99 % 1000);
+    }
+}
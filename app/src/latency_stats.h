@@ -0,0 +1,68 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// number of frames over which the percentiles are computed
+#define LATENCY_STATS_WINDOW_SIZE 512
+
+// timestamps of a frame at each stage of the pipeline, in microseconds (see
+// av_gettime_relative())
+struct sc_frame_times {
+    // the frame has been captured on the device (converted to the local
+    // clock), 0 if the clocks are not synchronized
+    int64_t captured;
+    int64_t received; // the packet has been received from the socket
+    int64_t decoded; // the frame has been output by the decoder
+    int64_t offered; // the frame has been queued for rendering
+};
+
+enum sc_latency_stage {
+    SC_LATENCY_STAGE_DEVICE, // captured -> received (encode and transfer)
+    SC_LATENCY_STAGE_DECODE, // received -> decoded
+    SC_LATENCY_STAGE_OFFER, // decoded -> offered
+    SC_LATENCY_STAGE_RENDER, // offered -> presented
+    SC_LATENCY_STAGE_TOTAL, // received -> presented
+    SC_LATENCY_STAGE_GLASS, // captured -> presented
+    SC_LATENCY_STAGE_COUNT,
+};
+
+// compute the duration of each stage of a frame presented at the given time,
+// in microseconds (-1 if a timestamp is unknown)
+void
+sc_frame_times_get_stages(const struct sc_frame_times *times,
+                          int64_t presented,
+                          int64_t durations[SC_LATENCY_STAGE_COUNT]);
+
+const char *
+latency_stage_get_name(enum sc_latency_stage stage);
+
+struct latency_window {
+    uint32_t samples[LATENCY_STATS_WINDOW_SIZE]; // in microseconds
+    unsigned count;
+    unsigned head; // index of the next sample to write
+};
+
+// Rolling latency percentiles of the last rendered frames
+//
+// Only accessed from the main thread: the timestamps are collected by the
+// other threads along with the frame itself.
+struct latency_stats {
+    struct latency_window windows[SC_LATENCY_STAGE_COUNT];
+};
+
+void
+latency_stats_init(struct latency_stats *stats);
+
+// record the stages of a frame presented at the given time
+void
+latency_stats_add_frame(struct latency_stats *stats,
+                        const struct sc_frame_times *times, int64_t presented);
+
+// log the p50, p95 and p99 of each stage
+void
+latency_stats_log(struct latency_stats *stats);
+
+#endif
@@ -4,11 +4,15 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <libavformat/avformat.h>
+#ifdef HAVE_V4L2
+# include <libavdevice/avdevice.h>
+#endif
 #define SDL_MAIN_HANDLED // avoid link error on Linux Windows Subsystem
 #include <SDL2/SDL.h>
 
 #include "config.h"
 #include "cli.h"
+#include "command.h"
 #include "compat.h"
 #include "util/log.h"
 
@@ -90,12 +94,22 @@ main(int argc, char *argv[]) {
     av_register_all();
 #endif
 
+#ifdef HAVE_V4L2
+    avdevice_register_all();
+#endif
+
     if (avformat_network_init()) {
         return 1;
     }
 
+    if (!curl_pool_init()) {
+        avformat_network_deinit();
+        return 1;
+    }
+
     int res = scrcpy(&args.opts) ? 0 : 1;
 
+    curl_pool_destroy();
     avformat_network_deinit(); // ignore failure
 
     return res;
@@ -0,0 +1,250 @@
+#include "metrics.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "common.h"
+
+// the buffer size for an escaped serial (longer serials are truncated)
+#define SERIAL_LABEL_SIZE 128
+
+// upper bounds of the finite buckets of the histograms, in microseconds
+static const uint32_t histogram_bounds[METRICS_HISTOGRAM_BUCKETS] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000,
+};
+
+struct counter_desc {
+    const char *name;
+    const char *type;
+    const char *help;
+    size_t offset; // of the field in struct metrics
+};
+
+static const struct counter_desc counters[] = {
+    {
+        "scrcpy_received_bytes_total", "counter",
+        "Video bytes received from the device.",
+        offsetof(struct metrics, received_bytes),
+    },
+    {
+        "scrcpy_decoded_frames_total", "counter",
+        "Frames output by the decoder.",
+        offsetof(struct metrics, decoded_frames),
+    },
+    {
+        "scrcpy_rendered_frames_total", "counter",
+        "Frames rendered.",
+        offsetof(struct metrics, rendered_frames),
+    },
+    {
+        "scrcpy_skipped_frames_total", "counter",
+        "Frames dropped before being rendered.",
+        offsetof(struct metrics, skipped_frames),
+    },
+    {
+        "scrcpy_controller_dropped_total", "counter",
+        "Control messages dropped because the queue was full.",
+        offsetof(struct metrics, controller_dropped),
+    },
+    {
+        "scrcpy_recorder_queue_depth", "gauge",
+        "Packets waiting to be written by the recorder.",
+        offsetof(struct metrics, recorder_queue_depth),
+    },
+};
+
+static void
+histogram_init(struct metrics_histogram *histogram) {
+    for (unsigned i = 0; i <= METRICS_HISTOGRAM_BUCKETS; ++i) {
+        atomic_init(&histogram->buckets[i], 0);
+    }
+    atomic_init(&histogram->sum, 0);
+}
+
+void
+metrics_init(struct metrics *metrics) {
+    atomic_init(&metrics->received_bytes, 0);
+    atomic_init(&metrics->decoded_frames, 0);
+    atomic_init(&metrics->rendered_frames, 0);
+    atomic_init(&metrics->skipped_frames, 0);
+    atomic_init(&metrics->controller_dropped, 0);
+    atomic_init(&metrics->recorder_queue_depth, 0);
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        histogram_init(&metrics->latency[i]);
+    }
+    histogram_init(&metrics->frame_interval);
+}
+
+void
+metrics_histogram_add(struct metrics_histogram *histogram, uint64_t value) {
+    unsigned i = 0;
+    while (i < METRICS_HISTOGRAM_BUCKETS && value > histogram_bounds[i]) {
+        ++i;
+    }
+    metrics_add(&histogram->buckets[i], 1);
+    metrics_add(&histogram->sum, value);
+}
+
+void
+metrics_add_frame(struct metrics *metrics, const struct sc_frame_times *times,
+                  int64_t presented) {
+    int64_t durations[SC_LATENCY_STAGE_COUNT];
+    sc_frame_times_get_stages(times, presented, durations);
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        if (durations[i] >= 0) {
+            metrics_histogram_add(&metrics->latency[i], durations[i]);
+        }
+    }
+}
+
+static uint64_t
+load(const atomic_uint_least64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+struct writer {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool truncated;
+};
+
+static void
+write_fmt(struct writer *w, const char *fmt, ...) {
+    if (w->truncated) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    int r = vsnprintf(w->buf + w->len, w->size - w->len, fmt, ap);
+    va_end(ap);
+
+    if (r < 0 || (size_t) r >= w->size - w->len) {
+        w->truncated = true;
+        return;
+    }
+    w->len += r;
+}
+
+// write the serial of the source into dst, escaped as a label value
+// <https://prometheus.io/docs/instrumenting/exposition_formats/>
+static const char *
+get_serial(const struct metrics_source *source, char *dst, size_t size) {
+    assert(size);
+    const char *serial = source->serial ? source->serial : "";
+
+    size_t len = 0;
+    for (const char *c = serial; *c; ++c) {
+        char escaped = *c == '\\' ? '\\'
+                     : *c == '"' ? '"'
+                     : *c == '\n' ? 'n'
+                     : '\0';
+        size_t needed = escaped ? 2 : 1;
+        if (len + needed >= size) {
+            // truncated
+            break;
+        }
+        if (escaped) {
+            dst[len++] = '\\';
+            dst[len++] = escaped;
+        } else {
+            dst[len++] = *c;
+        }
+    }
+    dst[len] = '\0';
+    return dst;
+}
+
+// write the samples of one histogram, labels is inserted before "le"
+static void
+write_histogram(struct writer *w, const char *name, const char *labels,
+                const struct metrics_histogram *histogram) {
+    // the Prometheus buckets are cumulative
+    uint64_t cumulated = 0;
+    for (unsigned i = 0; i <= METRICS_HISTOGRAM_BUCKETS; ++i) {
+        cumulated += load(&histogram->buckets[i]);
+        if (i < METRICS_HISTOGRAM_BUCKETS) {
+            uint32_t bound = histogram_bounds[i];
+            write_fmt(w, "%s_bucket{%s,le=\"%" PRIu32 ".%06" PRIu32 "\"} %"
+                         PRIu64 "\n", name, labels, bound / 1000000,
+                      bound % 1000000, cumulated);
+        } else {
+            write_fmt(w, "%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n", name,
+                      labels, cumulated);
+        }
+    }
+
+    uint64_t sum = load(&histogram->sum);
+    write_fmt(w, "%s_sum{%s} %" PRIu64 ".%06" PRIu64 "\n", name, labels,
+              sum / 1000000, sum % 1000000);
+    write_fmt(w, "%s_count{%s} %" PRIu64 "\n", name, labels, cumulated);
+}
+
+static void
+write_histograms(struct writer *w, const struct metrics_source *sources,
+                 unsigned count) {
+    char labels[256];
+    char serial[SERIAL_LABEL_SIZE];
+
+    write_fmt(w, "# HELP scrcpy_latency_seconds Latency of each stage of the "
+                 "rendered frames.\n"
+                 "# TYPE scrcpy_latency_seconds histogram\n");
+    for (unsigned i = 0; i < count; ++i) {
+        get_serial(&sources[i], serial, sizeof(serial));
+        for (unsigned stage = 0; stage < SC_LATENCY_STAGE_COUNT; ++stage) {
+            snprintf(labels, sizeof(labels), "serial=\"%s\",stage=\"%s\"",
+                     serial, latency_stage_get_name(stage));
+            write_histogram(w, "scrcpy_latency_seconds", labels,
+                            &sources[i].metrics->latency[stage]);
+        }
+    }
+
+    write_fmt(w, "# HELP scrcpy_frame_interval_seconds Interval between two "
+                 "consecutive rendered frames.\n"
+                 "# TYPE scrcpy_frame_interval_seconds histogram\n");
+    for (unsigned i = 0; i < count; ++i) {
+        snprintf(labels, sizeof(labels), "serial=\"%s\"",
+                 get_serial(&sources[i], serial, sizeof(serial)));
+        write_histogram(w, "scrcpy_frame_interval_seconds", labels,
+                        &sources[i].metrics->frame_interval);
+    }
+}
+
+size_t
+metrics_format(const struct metrics_source *sources, unsigned count,
+               char *buf, size_t size) {
+    assert(size);
+
+    struct writer w = {
+        .buf = buf,
+        .size = size,
+        .len = 0,
+        .truncated = false,
+    };
+    buf[0] = '\0';
+
+    char serial[SERIAL_LABEL_SIZE];
+
+    // the samples of a metric must be grouped
+    for (unsigned i = 0; i < ARRAY_LEN(counters); ++i) {
+        const struct counter_desc *desc = &counters[i];
+        write_fmt(&w, "# HELP %s %s\n# TYPE %s %s\n", desc->name, desc->help,
+                  desc->name, desc->type);
+        for (unsigned j = 0; j < count; ++j) {
+            const atomic_uint_least64_t *counter =
+                (const void *) ((const char *) sources[j].metrics
+                                    + desc->offset);
+            write_fmt(&w, "%s{serial=\"%s\"} %" PRIu64 "\n", desc->name,
+                      get_serial(&sources[j], serial, sizeof(serial)),
+                      load(counter));
+        }
+    }
+
+    write_histograms(&w, sources, count);
+
+    return w.truncated ? size : w.len;
+}
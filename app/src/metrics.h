@@ -0,0 +1,77 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "latency_stats.h"
+
+// number of finite buckets of the histograms (see metrics.c for their bounds),
+// a last bucket counts the larger samples
+#define METRICS_HISTOGRAM_BUCKETS 10
+
+struct metrics_histogram {
+    // the number of samples of each bucket (not cumulative)
+    atomic_uint_least64_t buckets[METRICS_HISTOGRAM_BUCKETS + 1];
+    atomic_uint_least64_t sum; // in microseconds
+};
+
+// Counters of a session, exported by the metrics server (--metrics-port)
+//
+// They are updated from several threads on the hot paths, so every field is
+// a relaxed atomic: an update costs a single atomic add, without any lock,
+// and the counters are always updated (they may be read at any time). A reader
+// gets a consistent value for each field, not for the whole structure.
+struct metrics {
+    atomic_uint_least64_t received_bytes; // video payload from the device
+    atomic_uint_least64_t decoded_frames;
+    atomic_uint_least64_t rendered_frames;
+    atomic_uint_least64_t skipped_frames;
+    // the number of control messages dropped because the queue was full
+    atomic_uint_least64_t controller_dropped;
+    // the number of packets waiting to be written by the recorder
+    atomic_uint_least64_t recorder_queue_depth;
+    // the latency of each stage of the rendered frames
+    struct metrics_histogram latency[SC_LATENCY_STAGE_COUNT];
+    // the interval between two consecutive rendered frames
+    struct metrics_histogram frame_interval;
+};
+
+// the metrics of a session, labeled by its device serial
+struct metrics_source {
+    const char *serial; // NULL for the default device
+    const struct metrics *metrics;
+};
+
+void
+metrics_init(struct metrics *metrics);
+
+static inline void
+metrics_add(atomic_uint_least64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline void
+metrics_set(atomic_uint_least64_t *gauge, uint64_t value) {
+    atomic_store_explicit(gauge, value, memory_order_relaxed);
+}
+
+// record a sample, in microseconds
+void
+metrics_histogram_add(struct metrics_histogram *histogram, uint64_t value);
+
+// record the latency of each stage of a frame presented at the given time
+void
+metrics_add_frame(struct metrics *metrics, const struct sc_frame_times *times,
+                  int64_t presented);
+
+// write the metrics of the sessions in the Prometheus text format
+// returns the number of chars actually written (max size-1) if no truncation
+// occurred, or size if truncated
+size_t
+metrics_format(const struct metrics_source *sources, unsigned count,
+               char *buf, size_t size);
+
+#endif
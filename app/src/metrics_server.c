@@ -0,0 +1,187 @@
+#include "metrics_server.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "util/log.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+// the size of the response body reserved for each session
+#define BUFFER_SIZE_PER_SESSION 16384
+
+// a client which does not send its request within this delay is disconnected,
+// so that it does not block the next ones
+#define REQUEST_TIMEOUT_MS 1000
+// likewise, a client which does not read the response within this delay is
+// disconnected
+#define RESPONSE_TIMEOUT_MS 1000
+
+bool
+metrics_server_init(struct metrics_server *ms, uint16_t port,
+                    const struct metrics_source *sources, unsigned count) {
+    assert(count);
+
+    ms->sources = SDL_malloc(count * sizeof(*sources));
+    if (!ms->sources) {
+        LOGC("Could not allocate metrics sources");
+        return false;
+    }
+    memcpy(ms->sources, sources, count * sizeof(*sources));
+    ms->count = count;
+
+    ms->buf_size = count * BUFFER_SIZE_PER_SESSION;
+    ms->buf = SDL_malloc(ms->buf_size);
+    if (!ms->buf) {
+        LOGC("Could not allocate metrics buffer");
+        goto error_free_sources;
+    }
+
+    ms->server_socket = net_listen(IPV4_LOCALHOST, port, 4);
+    if (ms->server_socket == INVALID_SOCKET) {
+        LOGE("Could not listen on port %" PRIu16 " for the metrics", port);
+        goto error_free_buf;
+    }
+    ms->closed = false;
+
+    LOGI("Metrics available on http://localhost:%" PRIu16 "/metrics", port);
+    return true;
+
+error_free_buf:
+    SDL_free(ms->buf);
+error_free_sources:
+    SDL_free(ms->sources);
+
+    return false;
+}
+
+static void
+close_server_socket(struct metrics_server *ms) {
+    if (!ms->closed) {
+        // On Linux, accept() is unblocked by shutdown(), but on Windows, it is
+        // unblocked by closesocket(). Therefore, call both.
+        net_shutdown(ms->server_socket, SHUT_RDWR);
+        net_close(ms->server_socket);
+        ms->closed = true;
+    }
+}
+
+void
+metrics_server_destroy(struct metrics_server *ms) {
+    close_server_socket(ms);
+    SDL_free(ms->buf);
+    SDL_free(ms->sources);
+}
+
+static bool
+is_metrics_request(const char *request) {
+    static const char prefix[] = "GET /metrics";
+    if (strncmp(request, prefix, sizeof(prefix) - 1)) {
+        return false;
+    }
+    // ignore the query, if any
+    char c = request[sizeof(prefix) - 1];
+    return c == ' ' || c == '?';
+}
+
+static void
+send_response(socket_t socket, const char *status, const char *body,
+              size_t len) {
+    char header[256];
+    int r = snprintf(header, sizeof(header),
+                     "HTTP/1.0 %s\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n"
+                     "\r\n", status, len);
+    assert(r > 0 && (size_t) r < sizeof(header));
+    if (net_send_all(socket, header, r) == r && len) {
+        net_send_all(socket, body, len);
+    }
+}
+
+static void
+handle_client(struct metrics_server *ms, socket_t socket) {
+    if (net_wait_readable(socket, socket, REQUEST_TIMEOUT_MS) <= 0) {
+        LOGD("Metrics request timeout");
+        return;
+    }
+
+    if (!net_set_send_timeout(socket, RESPONSE_TIMEOUT_MS)) {
+        // a stalled client would block the next ones
+        return;
+    }
+
+    // only the request line matters, the headers are ignored
+    char request[1024];
+    ssize_t r = net_recv(socket, request, sizeof(request) - 1);
+    if (r <= 0) {
+        return;
+    }
+    request[r] = '\0';
+
+    if (!is_metrics_request(request)) {
+        static const char not_found[] = "Not found\n";
+        send_response(socket, "404 Not Found", not_found,
+                      sizeof(not_found) - 1);
+        return;
+    }
+
+    size_t len = metrics_format(ms->sources, ms->count, ms->buf,
+                                ms->buf_size);
+    if (len == ms->buf_size) {
+        LOGW("Metrics truncated");
+        static const char error[] = "Metrics truncated\n";
+        send_response(socket, "500 Internal Server Error", error,
+                      sizeof(error) - 1);
+        return;
+    }
+
+    send_response(socket, "200 OK", ms->buf, len);
+}
+
+static int
+run_metrics_server(void *data) {
+    struct metrics_server *ms = data;
+
+    for (;;) {
+        socket_t socket = net_accept(ms->server_socket);
+        if (socket == INVALID_SOCKET) {
+            // the server socket has been closed
+            break;
+        }
+
+        handle_client(ms, socket);
+        net_shutdown(socket, SHUT_RDWR);
+        net_close(socket);
+    }
+
+    LOGD("Metrics server stopped");
+    return 0;
+}
+
+bool
+metrics_server_start(struct metrics_server *ms) {
+    LOGD("Starting metrics server thread");
+
+    ms->thread = SDL_CreateThread(run_metrics_server, "metrics", ms);
+    if (!ms->thread) {
+        LOGC("Could not start metrics server thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+metrics_server_stop(struct metrics_server *ms) {
+    close_server_socket(ms);
+}
+
+void
+metrics_server_join(struct metrics_server *ms) {
+    SDL_WaitThread(ms->thread, NULL);
+}
@@ -0,0 +1,44 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL_thread.h>
+
+#include "config.h"
+#include "metrics.h"
+#include "util/net.h"
+
+// Serve the metrics of the sessions over HTTP, on localhost only, in the
+// Prometheus text format (GET /metrics)
+//
+// The requests are handled one at a time by a dedicated thread, a scraper
+// typically connects every few seconds.
+struct metrics_server {
+    socket_t server_socket;
+    bool closed; // only accessed from the main thread
+    SDL_Thread *thread;
+    struct metrics_source *sources; // owned
+    unsigned count;
+    char *buf; // the response body
+    size_t buf_size;
+};
+
+// the sources are copied, the metrics must outlive the server
+bool
+metrics_server_init(struct metrics_server *ms, uint16_t port,
+                    const struct metrics_source *sources, unsigned count);
+
+void
+metrics_server_destroy(struct metrics_server *ms);
+
+bool
+metrics_server_start(struct metrics_server *ms);
+
+void
+metrics_server_stop(struct metrics_server *ms);
+
+void
+metrics_server_join(struct metrics_server *ms);
+
+#endif
@@ -17,6 +17,44 @@ sc_opengl_init(struct sc_opengl *gl) {
 
     // optional
     gl->GenerateMipmap = SDL_GL_GetProcAddress("glGenerateMipmap");
+    gl->ActiveTexture = SDL_GL_GetProcAddress("glActiveTexture");
+    gl->PixelStorei = SDL_GL_GetProcAddress("glPixelStorei");
+    gl->TexSubImage2D = SDL_GL_GetProcAddress("glTexSubImage2D");
+    gl->GenBuffers = SDL_GL_GetProcAddress("glGenBuffers");
+    gl->DeleteBuffers = SDL_GL_GetProcAddress("glDeleteBuffers");
+    gl->BindBuffer = SDL_GL_GetProcAddress("glBindBuffer");
+    gl->BufferData = SDL_GL_GetProcAddress("glBufferData");
+    gl->MapBufferRange = SDL_GL_GetProcAddress("glMapBufferRange");
+    gl->UnmapBuffer = SDL_GL_GetProcAddress("glUnmapBuffer");
+    gl->GetIntegerv = SDL_GL_GetProcAddress("glGetIntegerv");
+    gl->Viewport = SDL_GL_GetProcAddress("glViewport");
+    gl->DrawArrays = SDL_GL_GetProcAddress("glDrawArrays");
+    gl->CreateShader = SDL_GL_GetProcAddress("glCreateShader");
+    gl->ShaderSource = SDL_GL_GetProcAddress("glShaderSource");
+    gl->CompileShader = SDL_GL_GetProcAddress("glCompileShader");
+    gl->GetShaderiv = SDL_GL_GetProcAddress("glGetShaderiv");
+    gl->GetShaderInfoLog = SDL_GL_GetProcAddress("glGetShaderInfoLog");
+    gl->DeleteShader = SDL_GL_GetProcAddress("glDeleteShader");
+    gl->CreateProgram = SDL_GL_GetProcAddress("glCreateProgram");
+    gl->AttachShader = SDL_GL_GetProcAddress("glAttachShader");
+    gl->BindAttribLocation = SDL_GL_GetProcAddress("glBindAttribLocation");
+    gl->LinkProgram = SDL_GL_GetProcAddress("glLinkProgram");
+    gl->GetProgramiv = SDL_GL_GetProcAddress("glGetProgramiv");
+    gl->GetProgramInfoLog = SDL_GL_GetProcAddress("glGetProgramInfoLog");
+    gl->DeleteProgram = SDL_GL_GetProcAddress("glDeleteProgram");
+    gl->UseProgram = SDL_GL_GetProcAddress("glUseProgram");
+    gl->GetUniformLocation = SDL_GL_GetProcAddress("glGetUniformLocation");
+    gl->Uniform1i = SDL_GL_GetProcAddress("glUniform1i");
+    gl->Uniform2i = SDL_GL_GetProcAddress("glUniform2i");
+    gl->Uniform2f = SDL_GL_GetProcAddress("glUniform2f");
+    gl->Uniform3f = SDL_GL_GetProcAddress("glUniform3f");
+    gl->UniformMatrix3fv = SDL_GL_GetProcAddress("glUniformMatrix3fv");
+    gl->VertexAttribPointer = SDL_GL_GetProcAddress("glVertexAttribPointer");
+    gl->EnableVertexAttribArray =
+        SDL_GL_GetProcAddress("glEnableVertexAttribArray");
+    gl->DisableVertexAttribArray =
+        SDL_GL_GetProcAddress("glDisableVertexAttribArray");
+    gl->GetVertexAttribiv = SDL_GL_GetProcAddress("glGetVertexAttribiv");
 
     const char *version = (const char *) gl->GetString(GL_VERSION);
     assert(version);
@@ -54,3 +92,32 @@ sc_opengl_version_at_least(struct sc_opengl *gl,
         || (gl->version_major == minver_major
          && gl->version_minor >= minver_minor);
 }
+
+bool
+sc_opengl_has_pbo(struct sc_opengl *gl) {
+    // glMapBufferRange() and GL_UNPACK_ROW_LENGTH on OpenGL ES
+    return sc_opengl_version_at_least(gl, 3, 0, 3, 0)
+        && gl->ActiveTexture && gl->PixelStorei && gl->TexSubImage2D
+        && gl->GenBuffers && gl->DeleteBuffers && gl->BindBuffer
+        && gl->BufferData && gl->MapBufferRange && gl->UnmapBuffer;
+}
+
+bool
+sc_opengl_has_shaders(struct sc_opengl *gl) {
+    if (gl->is_opengles || !sc_opengl_version_at_least(gl, 3, 0, 0, 0)) {
+        return false;
+    }
+
+    // the vertices are read from a buffer object
+    return gl->GenBuffers && gl->DeleteBuffers && gl->BindBuffer
+        && gl->BufferData && gl->GetIntegerv && gl->Viewport
+        && gl->DrawArrays && gl->CreateShader && gl->ShaderSource
+        && gl->CompileShader && gl->GetShaderiv && gl->GetShaderInfoLog
+        && gl->DeleteShader && gl->CreateProgram && gl->AttachShader
+        && gl->BindAttribLocation && gl->LinkProgram && gl->GetProgramiv
+        && gl->GetProgramInfoLog && gl->DeleteProgram && gl->UseProgram
+        && gl->GetUniformLocation && gl->Uniform1i && gl->Uniform2i
+        && gl->Uniform2f && gl->Uniform3f && gl->UniformMatrix3fv
+        && gl->VertexAttribPointer && gl->EnableVertexAttribArray
+        && gl->DisableVertexAttribArray && gl->GetVertexAttribiv;
+}
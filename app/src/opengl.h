@@ -23,6 +23,126 @@ struct sc_opengl {
 
     void
     (*GenerateMipmap)(GLenum target);
+
+    // pixel buffer objects (optional, OpenGL 3.0+ or ES 3.0+)
+    void
+    (*ActiveTexture)(GLenum texture);
+
+    void
+    (*PixelStorei)(GLenum pname, GLint param);
+
+    void
+    (*TexSubImage2D)(GLenum target, GLint level, GLint xoffset,
+                     GLint yoffset, GLsizei width, GLsizei height,
+                     GLenum format, GLenum type, const void *pixels);
+
+    void
+    (*GenBuffers)(GLsizei n, GLuint *buffers);
+
+    void
+    (*DeleteBuffers)(GLsizei n, const GLuint *buffers);
+
+    void
+    (*BindBuffer)(GLenum target, GLuint buffer);
+
+    void
+    (*BufferData)(GLenum target, GLsizeiptr size, const void *data,
+                  GLenum usage);
+
+    void *
+    (*MapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length,
+                      GLbitfield access);
+
+    GLboolean
+    (*UnmapBuffer)(GLenum target);
+
+    // shaders (optional, OpenGL 3.0+)
+    void
+    (*GetIntegerv)(GLenum pname, GLint *data);
+
+    void
+    (*Viewport)(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void
+    (*DrawArrays)(GLenum mode, GLint first, GLsizei count);
+
+    GLuint
+    (*CreateShader)(GLenum type);
+
+    void
+    (*ShaderSource)(GLuint shader, GLsizei count, const GLchar *const *string,
+                    const GLint *length);
+
+    void
+    (*CompileShader)(GLuint shader);
+
+    void
+    (*GetShaderiv)(GLuint shader, GLenum pname, GLint *params);
+
+    void
+    (*GetShaderInfoLog)(GLuint shader, GLsizei max_length, GLsizei *length,
+                        GLchar *info_log);
+
+    void
+    (*DeleteShader)(GLuint shader);
+
+    GLuint
+    (*CreateProgram)(void);
+
+    void
+    (*AttachShader)(GLuint program, GLuint shader);
+
+    void
+    (*BindAttribLocation)(GLuint program, GLuint index, const GLchar *name);
+
+    void
+    (*LinkProgram)(GLuint program);
+
+    void
+    (*GetProgramiv)(GLuint program, GLenum pname, GLint *params);
+
+    void
+    (*GetProgramInfoLog)(GLuint program, GLsizei max_length, GLsizei *length,
+                         GLchar *info_log);
+
+    void
+    (*DeleteProgram)(GLuint program);
+
+    void
+    (*UseProgram)(GLuint program);
+
+    GLint
+    (*GetUniformLocation)(GLuint program, const GLchar *name);
+
+    void
+    (*Uniform1i)(GLint location, GLint v0);
+
+    void
+    (*Uniform2i)(GLint location, GLint v0, GLint v1);
+
+    void
+    (*Uniform2f)(GLint location, GLfloat v0, GLfloat v1);
+
+    void
+    (*Uniform3f)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+
+    void
+    (*UniformMatrix3fv)(GLint location, GLsizei count, GLboolean transpose,
+                        const GLfloat *value);
+
+    void
+    (*VertexAttribPointer)(GLuint index, GLint size, GLenum type,
+                           GLboolean normalized, GLsizei stride,
+                           const void *pointer);
+
+    void
+    (*EnableVertexAttribArray)(GLuint index);
+
+    void
+    (*DisableVertexAttribArray)(GLuint index);
+
+    void
+    (*GetVertexAttribiv)(GLuint index, GLenum pname, GLint *params);
 };
 
 void
@@ -33,4 +153,13 @@ sc_opengl_version_at_least(struct sc_opengl *gl,
                            int minver_major, int minver_minor,
                            int minver_es_major, int minver_es_minor);
 
+// tell whether the textures may be uploaded from pixel buffer objects
+bool
+sc_opengl_has_pbo(struct sc_opengl *gl);
+
+// tell whether the content may be drawn by custom shaders (desktop OpenGL
+// only, the shaders are written in GLSL 1.30)
+bool
+sc_opengl_has_shaders(struct sc_opengl *gl);
+
 #endif
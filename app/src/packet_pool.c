@@ -0,0 +1,92 @@
+#include "packet_pool.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "compat.h"
+#include "util/log.h"
+
+static unsigned
+get_bucket_index(size_t size) {
+    unsigned log2 = PACKET_POOL_MIN_SIZE_LOG2;
+    while (((size_t) 1 << log2) < size) {
+        ++log2;
+    }
+    return log2 - PACKET_POOL_MIN_SIZE_LOG2;
+}
+
+static AVBufferRef *
+#ifdef SCRCPY_LAVU_HAS_SIZE_T_BUFFER_SIZE
+alloc_buffer(void *opaque, size_t size) {
+#else
+alloc_buffer(void *opaque, int size) {
+#endif
+    // only called when the pool has no buffer to recycle
+    struct packet_pool *pool = opaque;
+    ++pool->misses;
+    return av_buffer_alloc(size);
+}
+
+void
+packet_pool_init(struct packet_pool *pool) {
+    for (unsigned i = 0; i < PACKET_POOL_BUCKETS; ++i) {
+        pool->buckets[i] = NULL;
+    }
+    pool->hits = 0;
+    pool->misses = 0;
+}
+
+void
+packet_pool_destroy(struct packet_pool *pool) {
+    for (unsigned i = 0; i < PACKET_POOL_BUCKETS; ++i) {
+        if (pool->buckets[i]) {
+            av_buffer_pool_uninit(&pool->buckets[i]);
+        }
+    }
+}
+
+static AVBufferRef *
+get_buffer(struct packet_pool *pool, size_t size) {
+    if (size > ((size_t) 1 << PACKET_POOL_MAX_SIZE_LOG2)) {
+        // too big to be pooled
+        ++pool->misses;
+        return av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    }
+
+    unsigned index = get_bucket_index(size);
+    AVBufferPool **bucket = &pool->buckets[index];
+    if (!*bucket) {
+        int bucket_size = (1 << (PACKET_POOL_MIN_SIZE_LOG2 + index))
+                        + AV_INPUT_BUFFER_PADDING_SIZE;
+        *bucket = av_buffer_pool_init2(bucket_size, pool, alloc_buffer, NULL);
+        if (!*bucket) {
+            return NULL;
+        }
+    }
+
+    uint64_t misses = pool->misses;
+    AVBufferRef *buf = av_buffer_pool_get(*bucket);
+    if (buf && pool->misses == misses) {
+        // the buffer has been recycled
+        ++pool->hits;
+    }
+    return buf;
+}
+
+bool
+packet_pool_get(struct packet_pool *pool, AVPacket *packet, size_t size) {
+    assert(size <= INT32_MAX - AV_INPUT_BUFFER_PADDING_SIZE);
+
+    AVBufferRef *buf = get_buffer(pool, size);
+    if (!buf) {
+        LOGE("Could not allocate packet buffer");
+        return false;
+    }
+
+    av_init_packet(packet);
+    packet->buf = buf;
+    packet->data = buf->data;
+    packet->size = size;
+    memset(packet->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    return true;
+}
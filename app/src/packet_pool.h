@@ -0,0 +1,42 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+
+#include "config.h"
+
+// buckets of power-of-two sizes, from 4 KiB to 16 MiB
+#define PACKET_POOL_MIN_SIZE_LOG2 12
+#define PACKET_POOL_MAX_SIZE_LOG2 24
+#define PACKET_POOL_BUCKETS \
+    (PACKET_POOL_MAX_SIZE_LOG2 - PACKET_POOL_MIN_SIZE_LOG2 + 1)
+
+// Allocator of AVPacket payloads, backed by ref-counted buffers recycled once
+// all the references (decoder, recorder) have been released, so that steady
+// state streaming does not allocate.
+//
+// packet_pool_get() must always be called from the same thread; the buffers
+// may be released from any thread.
+struct packet_pool {
+    // lazily initialized
+    AVBufferPool *buckets[PACKET_POOL_BUCKETS];
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+void
+packet_pool_init(struct packet_pool *pool);
+
+// the buffers still referenced are freed once released
+void
+packet_pool_destroy(struct packet_pool *pool);
+
+// initialize packet with a payload of size bytes (plus zeroed padding)
+bool
+packet_pool_get(struct packet_pool *pool, AVPacket *packet, size_t size);
+
+#endif
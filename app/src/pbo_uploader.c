@@ -0,0 +1,114 @@
+#include "pbo_uploader.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "util/log.h"
+
+#define PLANE_COUNT 3
+
+void
+pbo_uploader_init(struct pbo_uploader *uploader, struct sc_opengl *gl) {
+    uploader->gl = gl;
+    gl->GenBuffers(PBO_UPLOADER_COUNT, uploader->buffers);
+    for (unsigned i = 0; i < PBO_UPLOADER_COUNT; ++i) {
+        uploader->sizes[i] = 0;
+    }
+    uploader->index = 0;
+}
+
+void
+pbo_uploader_destroy(struct pbo_uploader *uploader) {
+    uploader->gl->DeleteBuffers(PBO_UPLOADER_COUNT, uploader->buffers);
+}
+
+// copy the planes into the bound buffer, at the given offsets
+static bool
+write_planes(struct pbo_uploader *uploader, const AVFrame *frame,
+             const size_t offsets[static PLANE_COUNT], size_t size) {
+    struct sc_opengl *gl = uploader->gl;
+
+    unsigned index = uploader->index;
+    if (uploader->sizes[index] != size) {
+        gl->BufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        uploader->sizes[index] = size;
+    }
+
+    uint8_t *data = gl->MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                       GL_MAP_WRITE_BIT
+                                     | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!data) {
+        LOGE("Could not map pixel buffer");
+        return false;
+    }
+
+    for (unsigned i = 0; i < PLANE_COUNT; ++i) {
+        int width = i ? (frame->width + 1) / 2 : frame->width;
+        int height = i ? (frame->height + 1) / 2 : frame->height;
+        // the rows are copied at once, including their padding, except after
+        // the last one (it may not be allocated)
+        size_t len = (size_t) frame->linesize[i] * (height - 1) + width;
+        memcpy(&data[offsets[i]], frame->data[i], len);
+    }
+
+    if (!gl->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        // the content has been lost (for example on a display mode change)
+        LOGW("Pixel buffer content lost");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+pbo_uploader_upload(struct pbo_uploader *uploader, SDL_Texture *texture,
+                    const AVFrame *frame) {
+    struct sc_opengl *gl = uploader->gl;
+
+    size_t offsets[PLANE_COUNT];
+    size_t size = 0;
+    for (unsigned i = 0; i < PLANE_COUNT; ++i) {
+        if (frame->linesize[i] <= 0) {
+            // bottom-up planes are not supported
+            return false;
+        }
+        int height = i ? (frame->height + 1) / 2 : frame->height;
+        offsets[i] = size;
+        size += (size_t) frame->linesize[i] * height;
+    }
+
+    // for a YUV texture, SDL binds the U and V planes to the texture units 1
+    // and 2 (and leaves the unit 0 active, with the Y plane)
+    if (SDL_GL_BindTexture(texture, NULL, NULL)) {
+        LOGE("Could not bind texture: %s", SDL_GetError());
+        return false;
+    }
+
+    gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER,
+                   uploader->buffers[uploader->index]);
+
+    bool ok = write_planes(uploader, frame, offsets, size);
+    if (ok) {
+        gl->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned i = 0; i < PLANE_COUNT; ++i) {
+            int width = i ? (frame->width + 1) / 2 : frame->width;
+            int height = i ? (frame->height + 1) / 2 : frame->height;
+            gl->ActiveTexture(GL_TEXTURE0 + i);
+            gl->PixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i]);
+            // with a pixel buffer bound, the pointer is an offset in it
+            gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                              GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                              (const void *) (uintptr_t) offsets[i]);
+        }
+        gl->ActiveTexture(GL_TEXTURE0);
+        gl->PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+        uploader->index = (uploader->index + 1) % PBO_UPLOADER_COUNT;
+    }
+
+    // SDL uploads from client memory, the buffer must not remain bound
+    gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    SDL_GL_UnbindTexture(texture);
+    return ok;
+}
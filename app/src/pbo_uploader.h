@@ -0,0 +1,48 @@
+#ifndef PBO_UPLOADER_H
+#define PBO_UPLOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL_render.h>
+#include <libavutil/frame.h>
+
+#include "config.h"
+#include "opengl.h"
+
+// the buffers are written in turn, so that a buffer the GPU may still be
+// reading from is not mapped again immediately
+#define PBO_UPLOADER_COUNT 3
+
+// Upload the planar YUV 4:2:0 frames to the SDL texture through pixel buffer
+// objects, so that the transfer to the GPU does not block the rendering
+// thread.
+//
+// SDL_UpdateYUVTexture() passes the frame memory to glTexSubImage2D(), which
+// must copy it before returning, and may wait for the GPU to finish drawing
+// the previous frame from the texture. Instead, the frame is copied into a
+// mapped buffer (invalidated on map, so that the driver never waits for its
+// previous content to be consumed), and glTexSubImage2D() only schedules the
+// transfer from the buffer.
+//
+// Only accessed from the rendering thread (the OpenGL context is current).
+struct pbo_uploader {
+    struct sc_opengl *gl;
+    GLuint buffers[PBO_UPLOADER_COUNT];
+    size_t sizes[PBO_UPLOADER_COUNT]; // the allocated size of each buffer
+    unsigned index; // the next buffer to write
+};
+
+// the OpenGL context must support them (see sc_opengl_has_pbo())
+void
+pbo_uploader_init(struct pbo_uploader *uploader, struct sc_opengl *gl);
+
+void
+pbo_uploader_destroy(struct pbo_uploader *uploader);
+
+// upload a YUV420P frame to the top-left area of a YV12 texture
+// return false on error, the caller may upload the frame with SDL instead
+bool
+pbo_uploader_upload(struct pbo_uploader *uploader, SDL_Texture *texture,
+                    const AVFrame *frame);
+
+#endif
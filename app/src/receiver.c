@@ -2,48 +2,159 @@
 
 #include <errno.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <libavutil/time.h>
 #include <SDL2/SDL_clipboard.h>
 
 #include "config.h"
 #include "device_msg.h"
+#include "trace.h"
 #include "util/lock.h"
 #include "util/log.h"
 
+// the reassembled device clipboard text is truncated to this length
+#define CLIPBOARD_MAX_LENGTH (1 << 24) // 16M
+
 bool
-receiver_init(struct receiver *receiver, socket_t control_socket) {
+receiver_init(struct receiver *receiver, socket_t control_socket,
+              struct clock_sync *clock_sync) {
     if (!(receiver->mutex = SDL_CreateMutex())) {
         return false;
     }
     receiver->control_socket = control_socket;
+    receiver->clock_sync = clock_sync;
+    receiver->has_device_stats = false;
+    atomic_init(&receiver->refresh_rate, 0);
+    receiver->clipboard = NULL;
+    receiver->clipboard_len = 0;
+    receiver->clipboard_truncated = false;
     return true;
 }
 
 void
 receiver_destroy(struct receiver *receiver) {
     SDL_DestroyMutex(receiver->mutex);
+    SDL_free(receiver->clipboard);
+}
+
+void
+receiver_set_socket(struct receiver *receiver, socket_t control_socket) {
+    receiver->control_socket = control_socket;
+    // the remaining chunks of a text will never be received
+    SDL_free(receiver->clipboard);
+    receiver->clipboard = NULL;
+    receiver->clipboard_len = 0;
+    receiver->clipboard_truncated = false;
 }
 
 static void
-process_msg(struct device_msg *msg) {
+append_clipboard(struct receiver *receiver, const char *text) {
+    size_t len = strlen(text);
+    if (receiver->clipboard_len + len > CLIPBOARD_MAX_LENGTH) {
+        // drop the remaining chunks rather than growing without limit
+        receiver->clipboard_truncated = true;
+        return;
+    }
+
+    char *clipboard = SDL_realloc(receiver->clipboard,
+                                  receiver->clipboard_len + len + 1);
+    if (!clipboard) {
+        LOGW("Could not allocate clipboard text");
+        receiver->clipboard_truncated = true;
+        return;
+    }
+    memcpy(&clipboard[receiver->clipboard_len], text, len);
+    receiver->clipboard = clipboard;
+    receiver->clipboard_len += len;
+}
+
+static void
+set_clipboard(const char *text) {
+    char *current = SDL_GetClipboardText();
+    bool same = current && !strcmp(current, text);
+    SDL_free(current);
+    if (same) {
+        LOGD("Computer clipboard unchanged");
+        return;
+    }
+
+    LOGI("Device clipboard copied");
+    SDL_SetClipboardText(text);
+}
+
+// the last chunk of a clipboard text
+static void
+finish_clipboard(struct receiver *receiver, const char *text) {
+    if (!receiver->clipboard_len && !receiver->clipboard_truncated) {
+        // the text was not split
+        set_clipboard(text);
+        return;
+    }
+
+    append_clipboard(receiver, text);
+    if (receiver->clipboard_truncated) {
+        LOGW("Device clipboard truncated to %zu bytes",
+             receiver->clipboard_len);
+    }
+    if (receiver->clipboard) {
+        receiver->clipboard[receiver->clipboard_len] = '\0';
+        set_clipboard(receiver->clipboard);
+    }
+
+    SDL_free(receiver->clipboard);
+    receiver->clipboard = NULL;
+    receiver->clipboard_len = 0;
+    receiver->clipboard_truncated = false;
+}
+
+// recv_time is the local time at which the message has been received
+static void
+process_msg(struct receiver *receiver, struct device_msg *msg,
+            int64_t recv_time) {
     switch (msg->type) {
-        case DEVICE_MSG_TYPE_CLIPBOARD: {
-            char *current = SDL_GetClipboardText();
-            bool same = current && !strcmp(current, msg->clipboard.text);
-            SDL_free(current);
-            if (same) {
-                LOGD("Computer clipboard unchanged");
-                return;
-            }
-
-            LOGI("Device clipboard copied");
-            SDL_SetClipboardText(msg->clipboard.text);
+        case DEVICE_MSG_TYPE_CLIPBOARD_PART:
+            append_clipboard(receiver, msg->clipboard.text);
+            break;
+        case DEVICE_MSG_TYPE_CLIPBOARD:
+            finish_clipboard(receiver, msg->clipboard.text);
+            break;
+        case DEVICE_MSG_TYPE_PONG:
+            clock_sync_add_sample(receiver->clock_sync,
+                                  msg->pong.ping_timestamp,
+                                  msg->pong.ping_received,
+                                  msg->pong.pong_sent, recv_time);
+            break;
+        case DEVICE_MSG_TYPE_STATS: {
+            const struct device_stats *stats = &msg->stats;
+            LOGD("Device: %" PRIu32 " frames (%" PRIu32 " dropped), "
+                 "%" PRIu32 " kB/s, encode %" PRIu32 "/%" PRIu32 " us "
+                 "(avg/max), queue %" PRIu32 ", %" PRIu32 " injections "
+                 "%" PRIu32 "/%" PRIu32 " us (avg/max)",
+                 stats->encoded_frames, stats->dropped_frames,
+                 stats->bytes_per_second / 1000, stats->encode_time_avg,
+                 stats->encode_time_max, stats->queue_depth_max,
+                 stats->injected_events, stats->injection_latency_avg,
+                 stats->injection_latency_max);
+            mutex_lock(receiver->mutex);
+            receiver->device_stats = *stats;
+            receiver->has_device_stats = true;
+            mutex_unlock(receiver->mutex);
             break;
         }
+        case DEVICE_MSG_TYPE_REFRESH_RATE:
+            LOGI("Device refresh rate: %" PRIu32 ".%03" PRIu32 " Hz",
+                 msg->refresh_rate.rate / 1000, msg->refresh_rate.rate % 1000);
+            atomic_store_explicit(&receiver->refresh_rate,
+                                  msg->refresh_rate.rate,
+                                  memory_order_relaxed);
+            break;
     }
 }
 
 static ssize_t
-process_msgs(const unsigned char *buf, size_t len) {
+process_msgs(struct receiver *receiver, const unsigned char *buf, size_t len,
+             int64_t recv_time) {
     size_t head = 0;
     for (;;) {
         struct device_msg msg;
@@ -55,7 +166,7 @@ process_msgs(const unsigned char *buf, size_t len) {
             return head;
         }
 
-        process_msg(&msg);
+        process_msg(receiver, &msg, recv_time);
         device_msg_destroy(&msg);
 
         head += r;
@@ -69,29 +180,48 @@ process_msgs(const unsigned char *buf, size_t len) {
 static int
 run_receiver(void *data) {
     struct receiver *receiver = data;
+    trace_set_thread_name("receiver");
 
-    static unsigned char buf[DEVICE_MSG_MAX_SIZE];
+    unsigned char *buf = receiver->buf;
+    // the pending data (not processed yet) is in [head, tail)
     size_t head = 0;
+    size_t tail = 0;
 
     for (;;) {
-        assert(head < DEVICE_MSG_MAX_SIZE);
-        ssize_t r = net_recv(receiver->control_socket, buf + head,
-                             DEVICE_MSG_MAX_SIZE - head);
+        // there is always room for at least a full message
+        assert(RECEIVER_BUFFER_SIZE - tail >= DEVICE_MSG_MAX_SIZE);
+        ssize_t r = net_recv(receiver->control_socket, buf + tail,
+                             RECEIVER_BUFFER_SIZE - tail);
         if (r <= 0) {
             break;
         }
 
-        head += r;
-        ssize_t consumed = process_msgs(buf, head);
+        int64_t recv_time = av_gettime_relative();
+
+        tail += r;
+        trace_begin("parse");
+        ssize_t consumed = process_msgs(receiver, &buf[head], tail - head,
+                                        recv_time);
+        trace_end();
         if (consumed == -1) {
             // an error occurred
             break;
         }
+        head += consumed;
 
-        if (consumed) {
-            head -= consumed;
-            // shift the remaining data in the buffer
-            memmove(buf, &buf[consumed], head);
+        if (head == tail) {
+            // everything has been processed, restart from the beginning
+            head = 0;
+            tail = 0;
+        } else if (tail - head >= DEVICE_MSG_MAX_SIZE) {
+            LOGE("Device message too big");
+            break;
+        } else if (RECEIVER_BUFFER_SIZE - tail < DEVICE_MSG_MAX_SIZE) {
+            // shift the remaining partial message (smaller than a message) to
+            // the beginning of the buffer, only when it may not fit anymore
+            tail -= head;
+            memmove(buf, &buf[head], tail);
+            head = 0;
         }
     }
 
@@ -115,3 +245,20 @@ void
 receiver_join(struct receiver *receiver) {
     SDL_WaitThread(receiver->thread, NULL);
 }
+
+bool
+receiver_get_device_stats(struct receiver *receiver,
+                          struct device_stats *stats) {
+    mutex_lock(receiver->mutex);
+    bool has_stats = receiver->has_device_stats;
+    if (has_stats) {
+        *stats = receiver->device_stats;
+    }
+    mutex_unlock(receiver->mutex);
+    return has_stats;
+}
+
+uint32_t
+receiver_get_refresh_rate(struct receiver *receiver) {
+    return atomic_load_explicit(&receiver->refresh_rate, memory_order_relaxed);
+}
@@ -1,23 +1,51 @@
 #ifndef RECEIVER_H
 #define RECEIVER_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <SDL2/SDL_mutex.h>
 #include <SDL2/SDL_thread.h>
 
 #include "config.h"
+#include "clock_sync.h"
+#include "device_msg.h"
 #include "util/net.h"
 
+// the messages are received in a buffer large enough to hold several of them,
+// so that the remaining partial message is rarely moved
+#define RECEIVER_BUFFER_SIZE (4 * DEVICE_MSG_MAX_SIZE)
+
 // receive events from the device
 // managed by the controller
 struct receiver {
     socket_t control_socket;
     SDL_Thread *thread;
     SDL_mutex *mutex;
+    struct clock_sync *clock_sync;
+
+    // the last performance counters received from the device, protected by
+    // the mutex
+    bool has_device_stats;
+    struct device_stats device_stats;
+
+    // the display refresh rate of the device, in millihertz (0 if unknown),
+    // read by the controller thread for every move event
+    atomic_uint_least32_t refresh_rate;
+
+    // the first chunks of a large device clipboard text (not nul-terminated),
+    // only accessed from the receiver thread
+    char *clipboard;
+    size_t clipboard_len;
+    bool clipboard_truncated;
+
+    // the received data, only accessed from the receiver thread
+    unsigned char buf[RECEIVER_BUFFER_SIZE];
 };
 
 bool
-receiver_init(struct receiver *receiver, socket_t control_socket);
+receiver_init(struct receiver *receiver, socket_t control_socket,
+              struct clock_sync *clock_sync);
 
 void
 receiver_destroy(struct receiver *receiver);
@@ -25,9 +53,28 @@ receiver_destroy(struct receiver *receiver);
 bool
 receiver_start(struct receiver *receiver);
 
+// receive the events from a new connection (the receiver must not be
+// running)
+void
+receiver_set_socket(struct receiver *receiver, socket_t control_socket);
+
 // no receiver_stop(), it will automatically stop on control_socket shutdown
 
 void
 receiver_join(struct receiver *receiver);
 
+// get the last performance counters of the device (return false if none has
+// been received yet)
+//
+// May be called from any thread.
+bool
+receiver_get_device_stats(struct receiver *receiver,
+                          struct device_stats *stats);
+
+// get the display refresh rate of the device, in millihertz (0 if unknown)
+//
+// May be called from any thread.
+uint32_t
+receiver_get_refresh_rate(struct receiver *receiver);
+
 #endif
@@ -1,10 +1,14 @@
 #include "recorder.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include <libavutil/time.h>
 
 #include "config.h"
 #include "compat.h"
+#include "trace.h"
 #include "util/lock.h"
 #include "util/log.h"
 
@@ -27,83 +31,160 @@ find_muxer(const char *name) {
     return oformat;
 }
 
-static struct record_packet *
-record_packet_new(const AVPacket *packet) {
-    struct record_packet *rec = SDL_malloc(sizeof(*rec));
-    if (!rec) {
-        return NULL;
-    }
-
-    // av_packet_ref() does not initialize all fields in old FFmpeg versions
-    // See <https://github.com/Genymobile/scrcpy/issues/707>
-    av_init_packet(&rec->packet);
-
-    if (av_packet_ref(&rec->packet, packet)) {
-        SDL_free(rec);
-        return NULL;
-    }
-    return rec;
-}
-
+// must be called (with the mutex locked) whenever the queue count changes
 static void
-record_packet_delete(struct record_packet *rec) {
-    av_packet_unref(&rec->packet);
-    SDL_free(rec);
+publish_queue_depth(struct recorder *recorder) {
+    if (recorder->metrics) {
+        metrics_set(&recorder->metrics->recorder_queue_depth,
+                    recorder->queue_count);
+    }
 }
 
 static void
-recorder_queue_clear(struct recorder_queue *queue) {
-    while (!queue_is_empty(queue)) {
-        struct record_packet *rec;
-        queue_take(queue, next, &rec);
-        record_packet_delete(rec);
+recorder_queue_clear(struct recorder *recorder) {
+    while (recorder->queue_count) {
+        av_packet_unref(&recorder->queue[recorder->queue_head]);
+        recorder->queue_head =
+            (recorder->queue_head + 1) % recorder->queue_capacity;
+        --recorder->queue_count;
     }
+    publish_queue_depth(recorder);
 }
 
 bool
 recorder_init(struct recorder *recorder,
               const char *filename,
               enum sc_record_format format,
-              struct size declared_frame_size) {
+              struct size declared_frame_size,
+              unsigned queue_size,
+              enum sc_record_queue_policy queue_policy,
+              uint64_t segment_duration,
+              bool fragmented,
+              size_t write_buffer_size,
+              struct metrics *metrics) {
+    assert(!fragmented || format == SC_RECORD_FORMAT_MP4);
+    assert(queue_size);
+
     recorder->filename = SDL_strdup(filename);
     if (!recorder->filename) {
         LOGE("Could not strdup filename");
-        return false;
+        goto error_0;
+    }
+
+    recorder->queue = SDL_malloc(queue_size * sizeof(*recorder->queue));
+    if (!recorder->queue) {
+        LOGC("Could not allocate recorder queue");
+        goto error_1;
     }
 
     recorder->mutex = SDL_CreateMutex();
     if (!recorder->mutex) {
         LOGC("Could not create mutex");
-        SDL_free(recorder->filename);
-        return false;
+        goto error_2;
     }
 
     recorder->queue_cond = SDL_CreateCond();
     if (!recorder->queue_cond) {
         LOGC("Could not create cond");
-        SDL_DestroyMutex(recorder->mutex);
-        SDL_free(recorder->filename);
-        return false;
+        goto error_3;
+    }
+
+    recorder->space_cond = SDL_CreateCond();
+    if (!recorder->space_cond) {
+        LOGC("Could not create cond");
+        goto error_4;
     }
 
-    queue_init(&recorder->queue);
+    for (unsigned i = 0; i < queue_size; ++i) {
+        // av_packet_ref() does not initialize all fields in old FFmpeg
+        // versions
+        // See <https://github.com/Genymobile/scrcpy/issues/707>
+        av_init_packet(&recorder->queue[i]);
+        recorder->queue[i].data = NULL;
+        recorder->queue[i].size = 0;
+    }
+    recorder->queue_capacity = queue_size;
+    recorder->queue_head = 0;
+    recorder->queue_count = 0;
+    recorder->queue_policy = queue_policy;
+    recorder->metrics = metrics;
+    recorder->dropping = false;
+    recorder->dropped = 0;
+
     recorder->stopped = false;
     recorder->failed = false;
+    recorder->overflowed = false;
     recorder->format = format;
     recorder->declared_frame_size = declared_frame_size;
     recorder->header_written = false;
-    recorder->previous = NULL;
+    recorder->has_previous = false;
+    recorder->codec = NULL;
+    recorder->ctx = NULL;
+    recorder->fragmented = fragmented;
+    recorder->write_buffer_size = write_buffer_size;
+    recorder->segment_duration = segment_duration;
+    recorder->segment_index = 0;
+    recorder->segment_start = AV_NOPTS_VALUE;
+    recorder->output_filename = NULL;
+    recorder->config = NULL;
+    recorder->config_size = 0;
 
     return true;
+
+error_4:
+    SDL_DestroyCond(recorder->queue_cond);
+error_3:
+    SDL_DestroyMutex(recorder->mutex);
+error_2:
+    SDL_free(recorder->queue);
+error_1:
+    SDL_free(recorder->filename);
+error_0:
+    return false;
 }
 
 void
 recorder_destroy(struct recorder *recorder) {
+    recorder_queue_clear(recorder);
+    if (recorder->dropped) {
+        LOGW("Recorder queue overflow: %" PRIu64 " packets not recorded",
+             recorder->dropped);
+    }
+    SDL_DestroyCond(recorder->space_cond);
     SDL_DestroyCond(recorder->queue_cond);
     SDL_DestroyMutex(recorder->mutex);
+    SDL_free(recorder->queue);
+    SDL_free(recorder->config);
+    SDL_free(recorder->output_filename);
     SDL_free(recorder->filename);
 }
 
+// insert the segment index before the extension: "file.mp4" -> "file-0001.mp4"
+static char *
+get_segment_filename(const char *filename, unsigned index) {
+    const char *ext = strrchr(filename, '.');
+    const char *sep = strrchr(filename, '/');
+#ifdef _WIN32
+    const char *sep2 = strrchr(filename, '\\');
+    if (sep2 > sep) {
+        sep = sep2;
+    }
+#endif
+    if (!ext || (sep && ext < sep)) {
+        // the dot is not in the file name
+        ext = filename + strlen(filename);
+    }
+
+    int base_len = ext - filename;
+    size_t len = base_len + 1 + 10 + strlen(ext) + 1;
+    char *name = SDL_malloc(len);
+    if (!name) {
+        return NULL;
+    }
+    snprintf(name, len, "%.*s-%04u%s", base_len, filename, index, ext);
+    return name;
+}
+
 static const char *
 recorder_get_format_name(enum sc_record_format format) {
     switch (format) {
@@ -113,8 +194,11 @@ recorder_get_format_name(enum sc_record_format format) {
     }
 }
 
-bool
-recorder_open(struct recorder *recorder, const AVCodec *input_codec) {
+// open the current output file
+static bool
+open_output(struct recorder *recorder) {
+    const AVCodec *input_codec = recorder->codec;
+    const char *filename = recorder->output_filename;
     const char *format_name = recorder_get_format_name(recorder->format);
     assert(format_name);
     const AVOutputFormat *format = find_muxer(format_name);
@@ -158,73 +242,186 @@ recorder_open(struct recorder *recorder, const AVCodec *input_codec) {
     ostream->codec->height = recorder->declared_frame_size.height;
 #endif
 
-    int ret = avio_open(&recorder->ctx->pb, recorder->filename,
-                        AVIO_FLAG_WRITE);
-    if (ret < 0) {
-        LOGE("Failed to open output file: %s", recorder->filename);
+    bool ok;
+    if (recorder->write_buffer_size) {
+        ok = file_writer_open(&recorder->writer, filename,
+                              recorder->write_buffer_size);
+        if (ok) {
+            recorder->ctx->pb = recorder->writer.avio;
+        }
+    } else {
+        ok = avio_open(&recorder->ctx->pb, filename, AVIO_FLAG_WRITE) >= 0;
+        if (!ok) {
+            LOGE("Failed to open output file: %s", filename);
+        }
+    }
+    if (!ok) {
         // ostream will be cleaned up during context cleaning
         avformat_free_context(recorder->ctx);
+        recorder->ctx = NULL;
         return false;
     }
 
-    LOGI("Recording started to %s file: %s", format_name, recorder->filename);
+    LOGI("Recording started to %s file: %s", format_name, filename);
 
     return true;
 }
 
-void
-recorder_close(struct recorder *recorder) {
+// close the current output file, return false if it is not valid
+static bool
+close_output(struct recorder *recorder) {
+    bool ok = true;
     if (recorder->header_written) {
         int ret = av_write_trailer(recorder->ctx);
         if (ret < 0) {
-            LOGE("Failed to write trailer to %s", recorder->filename);
-            recorder->failed = true;
+            LOGE("Failed to write trailer to %s", recorder->output_filename);
+            ok = false;
         }
     } else {
         // the recorded file is empty
-        recorder->failed = true;
+        ok = false;
+    }
+    if (recorder->write_buffer_size) {
+        // wait for the buffered data to be written
+        if (!file_writer_close(&recorder->writer)) {
+            LOGE("Failed to write to %s", recorder->output_filename);
+            ok = false;
+        }
+        // owned by the writer
+        recorder->ctx->pb = NULL;
+    } else {
+        avio_close(recorder->ctx->pb);
     }
-    avio_close(recorder->ctx->pb);
     avformat_free_context(recorder->ctx);
+    recorder->ctx = NULL;
+    recorder->header_written = false;
+    return ok;
+}
+
+bool
+recorder_open(struct recorder *recorder, const AVCodec *input_codec) {
+    recorder->codec = input_codec;
+
+    recorder->output_filename = recorder->segment_duration
+        ? get_segment_filename(recorder->filename, 0)
+        : SDL_strdup(recorder->filename);
+    if (!recorder->output_filename) {
+        LOGC("Could not allocate filename");
+        return false;
+    }
+
+    if (!open_output(recorder)) {
+        SDL_free(recorder->output_filename);
+        recorder->output_filename = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void
+recorder_close(struct recorder *recorder) {
+    // the context is NULL if a segment rotation failed
+    if (!recorder->ctx || !close_output(recorder)) {
+        recorder->failed = true;
+    }
 
     if (recorder->failed) {
         LOGE("Recording failed to %s", recorder->filename);
     } else {
         const char *format_name = recorder_get_format_name(recorder->format);
-        LOGI("Recording complete to %s file: %s", format_name, recorder->filename);
+        if (recorder->segment_duration) {
+            LOGI("Recording complete to %s files: %s (%u segments)",
+                 format_name, recorder->filename, recorder->segment_index + 1);
+        } else {
+            LOGI("Recording complete to %s file: %s", format_name,
+                 recorder->filename);
+        }
     }
 }
 
+// keep the config packet, to write it in the header of the next files
 static bool
-recorder_write_header(struct recorder *recorder, const AVPacket *packet) {
+recorder_save_config(struct recorder *recorder, const AVPacket *packet) {
+    uint8_t *config = SDL_realloc(recorder->config, packet->size);
+    if (!config) {
+        LOGC("Could not allocate config");
+        return false;
+    }
+    memcpy(config, packet->data, packet->size);
+    recorder->config = config;
+    recorder->config_size = packet->size;
+    return true;
+}
+
+static bool
+recorder_write_header(struct recorder *recorder) {
     AVStream *ostream = recorder->ctx->streams[0];
 
-    uint8_t *extradata = av_malloc(packet->size * sizeof(uint8_t));
+    uint8_t *extradata = av_malloc(recorder->config_size * sizeof(uint8_t));
     if (!extradata) {
         LOGC("Could not allocate extradata");
         return false;
     }
 
-    // copy the first packet to the extra data
-    memcpy(extradata, packet->data, packet->size);
+    // copy the config packet to the extra data
+    memcpy(extradata, recorder->config, recorder->config_size);
 
 #ifdef SCRCPY_LAVF_HAS_NEW_CODEC_PARAMS_API
     ostream->codecpar->extradata = extradata;
-    ostream->codecpar->extradata_size = packet->size;
+    ostream->codecpar->extradata_size = recorder->config_size;
 #else
     ostream->codec->extradata = extradata;
-    ostream->codec->extradata_size = packet->size;
+    ostream->codec->extradata_size = recorder->config_size;
 #endif
 
-    int ret = avformat_write_header(recorder->ctx, NULL);
+    AVDictionary *opts = NULL;
+    if (recorder->fragmented) {
+        // write the moov atom first, then a fragment per key frame, so that
+        // the file is readable while it is being written
+        av_dict_set(&opts, "movflags",
+                    "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+
+    int ret = avformat_write_header(recorder->ctx, &opts);
+    av_dict_free(&opts);
     if (ret < 0) {
-        LOGE("Failed to write header to %s", recorder->filename);
+        LOGE("Failed to write header to %s", recorder->output_filename);
         return false;
     }
 
     return true;
 }
 
+// finish the current file and start the next one
+static bool
+recorder_rotate_segment(struct recorder *recorder) {
+    if (!close_output(recorder)) {
+        return false;
+    }
+
+    LOGI("Recording segment complete: %s", recorder->output_filename);
+
+    char *filename = get_segment_filename(recorder->filename,
+                                          ++recorder->segment_index);
+    if (!filename) {
+        LOGC("Could not allocate filename");
+        return false;
+    }
+    SDL_free(recorder->output_filename);
+    recorder->output_filename = filename;
+
+    if (!open_output(recorder)) {
+        return false;
+    }
+
+    if (!recorder_write_header(recorder)) {
+        return false;
+    }
+    recorder->header_written = true;
+    return true;
+}
+
 static void
 recorder_rescale_packet(struct recorder *recorder, AVPacket *packet) {
     AVStream *ostream = recorder->ctx->streams[0];
@@ -233,22 +430,42 @@ recorder_rescale_packet(struct recorder *recorder, AVPacket *packet) {
 
 bool
 recorder_write(struct recorder *recorder, AVPacket *packet) {
-    if (!recorder->header_written) {
-        if (packet->pts != AV_NOPTS_VALUE) {
-            LOGE("The first packet is not a config packet");
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // config packet, written as extradata of the header
+        if (!recorder_save_config(recorder, packet)) {
             return false;
         }
-        bool ok = recorder_write_header(recorder, packet);
-        if (!ok) {
-            return false;
+        if (!recorder->header_written) {
+            if (!recorder_write_header(recorder)) {
+                return false;
+            }
+            recorder->header_written = true;
         }
-        recorder->header_written = true;
+        // later config packets are only written to the next segments
         return true;
     }
 
-    if (packet->pts == AV_NOPTS_VALUE) {
-        // ignore config packets
-        return true;
+    if (!recorder->header_written) {
+        LOGE("The first packet is not a config packet");
+        return false;
+    }
+
+    if (recorder->segment_duration) {
+        if (recorder->segment_start == AV_NOPTS_VALUE) {
+            recorder->segment_start = packet->pts;
+        } else if (packet->flags & AV_PKT_FLAG_KEY
+                && (uint64_t) (packet->pts - recorder->segment_start)
+                        >= recorder->segment_duration) {
+            // a segment must start with a key frame to be decodable alone
+            if (!recorder_rotate_segment(recorder)) {
+                return false;
+            }
+            recorder->segment_start = packet->pts;
+        }
+
+        // each segment starts at 0
+        packet->pts -= recorder->segment_start;
+        packet->dts = packet->pts;
     }
 
     recorder_rescale_packet(recorder, packet);
@@ -258,71 +475,103 @@ recorder_write(struct recorder *recorder, AVPacket *packet) {
 static int
 run_recorder(void *data) {
     struct recorder *recorder = data;
+    trace_set_thread_name("recorder");
+
+    // the packet being processed (it becomes the previous packet)
+    AVPacket packet;
+    av_init_packet(&packet);
 
     for (;;) {
         mutex_lock(recorder->mutex);
 
-        while (!recorder->stopped && queue_is_empty(&recorder->queue)) {
+        while (!recorder->stopped && !recorder->overflowed
+                && !recorder->queue_count) {
             cond_wait(recorder->queue_cond, recorder->mutex);
         }
 
-        // if stopped is set, continue to process the remaining events (to
-        // finish the recording) before actually stopping
+        // if stopped (or overflowed) is set, continue to process the
+        // remaining events (to finish the recording) before actually stopping
 
-        if (recorder->stopped && queue_is_empty(&recorder->queue)) {
+        if ((recorder->stopped || recorder->overflowed)
+                && !recorder->queue_count) {
             mutex_unlock(recorder->mutex);
-            struct record_packet *last = recorder->previous;
-            if (last) {
+            if (recorder->has_previous) {
+                AVPacket *last = &recorder->previous;
                 // assign an arbitrary duration to the last packet
-                last->packet.duration = 100000;
-                bool ok = recorder_write(recorder, &last->packet);
+                last->duration = 100000;
+                bool ok = recorder_write(recorder, last);
                 if (!ok) {
                     // failing to write the last frame is not very serious, no
                     // future frame may depend on it, so the resulting file
                     // will still be valid
                     LOGW("Could not record last packet");
                 }
-                record_packet_delete(last);
+                av_packet_unref(last);
             }
             break;
         }
 
-        struct record_packet *rec;
-        queue_take(&recorder->queue, next, &rec);
+        // move the packet out of the queue (this does not copy the data)
+        packet = recorder->queue[recorder->queue_head];
+        av_init_packet(&recorder->queue[recorder->queue_head]);
+        recorder->queue[recorder->queue_head].data = NULL;
+        recorder->queue[recorder->queue_head].size = 0;
+        recorder->queue_head =
+            (recorder->queue_head + 1) % recorder->queue_capacity;
+        --recorder->queue_count;
+        publish_queue_depth(recorder);
+        cond_signal(recorder->space_cond);
 
         mutex_unlock(recorder->mutex);
 
         // recorder->previous is only written from this thread, no need to lock
-        struct record_packet *previous = recorder->previous;
-        recorder->previous = rec;
-
-        if (!previous) {
+        if (!recorder->has_previous) {
             // we just received the first packet
+            recorder->previous = packet;
+            recorder->has_previous = true;
             continue;
         }
 
+        AVPacket *previous = &recorder->previous;
+
         // config packets have no PTS, we must ignore them
-        if (rec->packet.pts != AV_NOPTS_VALUE
-            && previous->packet.pts != AV_NOPTS_VALUE) {
+        if (packet.pts != AV_NOPTS_VALUE
+            && previous->pts != AV_NOPTS_VALUE) {
             // we now know the duration of the previous packet
-            previous->packet.duration = rec->packet.pts - previous->packet.pts;
+            previous->duration = packet.pts - previous->pts;
         }
 
-        bool ok = recorder_write(recorder, &previous->packet);
-        record_packet_delete(previous);
+        trace_begin("write");
+        bool ok = recorder_write(recorder, previous);
+        trace_end();
+        av_packet_unref(previous);
+        recorder->previous = packet;
         if (!ok) {
             LOGE("Could not record packet");
+            av_packet_unref(&recorder->previous);
+            recorder->has_previous = false;
 
             mutex_lock(recorder->mutex);
             recorder->failed = true;
             // discard pending packets
-            recorder_queue_clear(&recorder->queue);
+            recorder_queue_clear(recorder);
+            // unblock the producer
+            cond_signal(recorder->space_cond);
             mutex_unlock(recorder->mutex);
             break;
         }
 
     }
 
+    mutex_lock(recorder->mutex);
+    bool overflowed = recorder->overflowed;
+    mutex_unlock(recorder->mutex);
+    if (overflowed && recorder->ctx) {
+        // the stream continues, close the file now (recorder_close() will
+        // report the recording as failed)
+        close_output(recorder);
+    }
+
     LOGD("Recorder thread ended");
 
     return 0;
@@ -346,6 +595,7 @@ recorder_stop(struct recorder *recorder) {
     mutex_lock(recorder->mutex);
     recorder->stopped = true;
     cond_signal(recorder->queue_cond);
+    cond_signal(recorder->space_cond);
     mutex_unlock(recorder->mutex);
 }
 
@@ -354,25 +604,99 @@ recorder_join(struct recorder *recorder) {
     SDL_WaitThread(recorder->thread, NULL);
 }
 
+// return true if the packet may be pushed
+// the mutex must be locked
+static bool
+wait_for_room(struct recorder *recorder, const AVPacket *packet) {
+    if (recorder->queue_count < recorder->queue_capacity) {
+        return true;
+    }
+
+    switch (recorder->queue_policy) {
+        case SC_RECORD_QUEUE_POLICY_BLOCK:
+            while (!recorder->stopped && !recorder->failed
+                    && recorder->queue_count == recorder->queue_capacity) {
+                cond_wait(recorder->space_cond, recorder->mutex);
+            }
+            return !recorder->stopped && !recorder->failed;
+        case SC_RECORD_QUEUE_POLICY_DROP:
+            if (packet->pts == AV_NOPTS_VALUE) {
+                // a config packet must never be dropped, it is small and
+                // there are few of them: wait
+                while (!recorder->stopped && !recorder->failed
+                        && recorder->queue_count == recorder->queue_capacity) {
+                    cond_wait(recorder->space_cond, recorder->mutex);
+                }
+                return !recorder->stopped && !recorder->failed;
+            }
+            // the next frames would reference the dropped one, drop them
+            // until the next key frame
+            if (!recorder->dropping) {
+                LOGW("Recorder queue full, dropping packets until the next "
+                     "key frame");
+            }
+            recorder->dropping = true;
+            return false;
+        default:
+            assert(recorder->queue_policy == SC_RECORD_QUEUE_POLICY_FAIL);
+            LOGE("Recorder queue full (%u packets), stopping the recording",
+                 recorder->queue_capacity);
+            recorder->overflowed = true;
+            // finish the recording
+            cond_signal(recorder->queue_cond);
+            return false;
+    }
+}
+
 bool
 recorder_push(struct recorder *recorder, const AVPacket *packet) {
     mutex_lock(recorder->mutex);
     assert(!recorder->stopped);
 
+    if (recorder->overflowed) {
+        // the recording is stopped, ignore the packet (even if the end of the
+        // recording failed)
+        mutex_unlock(recorder->mutex);
+        return true;
+    }
+
     if (recorder->failed) {
         // reject any new packet (this will stop the stream)
         mutex_unlock(recorder->mutex);
         return false;
     }
 
-    struct record_packet *rec = record_packet_new(packet);
-    if (!rec) {
-        LOGC("Could not allocate record packet");
+    if (recorder->dropping) {
+        if (packet->pts != AV_NOPTS_VALUE
+                && !(packet->flags & AV_PKT_FLAG_KEY)) {
+            ++recorder->dropped;
+            mutex_unlock(recorder->mutex);
+            return true;
+        }
+        recorder->dropping = false;
+    }
+
+    if (!wait_for_room(recorder, packet)) {
+        bool failed = recorder->failed;
+        if (recorder->dropping) {
+            ++recorder->dropped;
+        }
+        mutex_unlock(recorder->mutex);
+        // on drop or overflow, the stream continues
+        return !failed;
+    }
+
+    unsigned index = (recorder->queue_head + recorder->queue_count)
+                   % recorder->queue_capacity;
+    // only increments the refcount of the packet data
+    if (av_packet_ref(&recorder->queue[index], packet)) {
+        LOGC("Could not reference packet");
         mutex_unlock(recorder->mutex);
         return false;
     }
 
-    queue_push(&recorder->queue, next, rec);
+    ++recorder->queue_count;
+    publish_queue_depth(recorder);
     cond_signal(recorder->queue_cond);
 
     mutex_unlock(recorder->mutex);
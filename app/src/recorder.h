@@ -8,40 +8,76 @@
 
 #include "config.h"
 #include "common.h"
+#include "file_writer.h"
+#include "metrics.h"
 #include "scrcpy.h"
-#include "util/queue.h"
-
-struct record_packet {
-    AVPacket packet;
-    struct record_packet *next;
-};
-
-struct recorder_queue QUEUE(struct record_packet);
 
 struct recorder {
     char *filename;
     enum sc_record_format format;
-    AVFormatContext *ctx;
+    const AVCodec *codec;
+    AVFormatContext *ctx; // NULL once closed
     struct size declared_frame_size;
-    bool header_written;
+    bool header_written; // for the current file
+    bool fragmented; // write a fragmented MP4, readable while recording
+    // if not 0, the muxer writes into a write-behind buffer of this size
+    size_t write_buffer_size;
+    struct file_writer writer; // for the current file
+
+    // if not 0, the recording is split into files of (at least) this
+    // duration, rotated on key frames, in microseconds
+    uint64_t segment_duration;
+    unsigned segment_index;
+    int64_t segment_start; // PTS of the first packet of the current segment
+    char *output_filename; // the current file (filename if not segmented)
+
+    // the last config packet, written as extradata of each file
+    uint8_t *config;
+    int config_size;
 
     SDL_Thread *thread;
     SDL_mutex *mutex;
-    SDL_cond *queue_cond;
+    SDL_cond *queue_cond; // signaled when a packet is pushed
+    SDL_cond *space_cond; // signaled when a packet is taken
     bool stopped; // set on recorder_stop() by the stream reader
     bool failed; // set on packet write failure
-    struct recorder_queue queue;
+    // set when the queue is full with the "fail" policy: the recording is
+    // stopped, but not the stream
+    bool overflowed;
+
+    // Bounded ring of packets referencing the stream packets (the data is
+    // never copied). The slots are allocated once, so that pushing a packet
+    // never allocates.
+    AVPacket *queue;
+    unsigned queue_capacity;
+    unsigned queue_head; // index of the oldest packet
+    unsigned queue_count;
+    enum sc_record_queue_policy queue_policy;
+    struct metrics *metrics; // may be NULL
+
+    // only accessed from the stream thread (the producer)
+    bool dropping; // drop the packets until the next key frame
+    uint64_t dropped;
 
     // we can write a packet only once we received the next one so that we can
     // set its duration (next_pts - current_pts)
     // "previous" is only accessed from the recorder thread, so it does not
     // need to be protected by the mutex
-    struct record_packet *previous;
+    AVPacket previous;
+    bool has_previous;
 };
 
+// queue_size is the maximum number of packets waiting to be written
+// segment_duration is in microseconds (0 to record a single file)
+// write_buffer_size is in bytes (0 to write to the file from the recorder
+// thread)
+// metrics may be NULL
 bool
 recorder_init(struct recorder *recorder, const char *filename,
-              enum sc_record_format format, struct size declared_frame_size);
+              enum sc_record_format format, struct size declared_frame_size,
+              unsigned queue_size, enum sc_record_queue_policy queue_policy,
+              uint64_t segment_duration, bool fragmented,
+              size_t write_buffer_size, struct metrics *metrics);
 
 void
 recorder_destroy(struct recorder *recorder);
@@ -61,6 +97,7 @@ recorder_stop(struct recorder *recorder);
 void
 recorder_join(struct recorder *recorder);
 
+// if the queue is full, block, drop or fail according to the queue policy
 bool
 recorder_push(struct recorder *recorder, const AVPacket *packet);
 
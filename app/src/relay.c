@@ -0,0 +1,501 @@
+#include "relay.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <libavutil/time.h>
+#include <SDL2/SDL_platform.h>
+#ifndef __WINDOWS__
+# include <signal.h>
+#endif
+
+#include "config.h"
+#include "control_msg.h"
+#include "controller.h"
+#include "util/buffer_util.h"
+#include "util/lock.h"
+#include "util/log.h"
+#include "util/str_util.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+// the packets are sent in the format of the server (see stream_recv_packet())
+#define HEADER_SIZE 20
+#define NO_PTS UINT64_C(-1)
+#define PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+// the device info, followed by the codec
+#define INFO_SIZE (DEVICE_NAME_FIELD_LENGTH + 5)
+
+// a slow viewer must not make the device encode key frames continuously
+#define KEY_FRAME_REQUEST_INTERVAL_US 1000000
+
+bool
+relay_init(struct relay *relay, uint16_t port, const char *device_name,
+           struct size frame_size, enum sc_codec codec,
+           struct controller *controller) {
+    relay->mutex = SDL_CreateMutex();
+    if (!relay->mutex) {
+        LOGC("Could not create mutex");
+        return false;
+    }
+
+    relay->queue_cond = SDL_CreateCond();
+    if (!relay->queue_cond) {
+        LOGC("Could not create cond");
+        goto error_destroy_mutex;
+    }
+
+    relay->server_socket = net_listen(IPV4_LOCALHOST, port, 4);
+    if (relay->server_socket == INVALID_SOCKET) {
+        LOGE("Could not listen on port %" PRIu16 " for the relay", port);
+        goto error_destroy_cond;
+    }
+    relay->closed = false;
+    relay->stopped = false;
+
+#ifndef __WINDOWS__
+    // a viewer may disconnect at any time: send() must fail rather than kill
+    // the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    xstrncpy(relay->device_name, device_name, sizeof(relay->device_name));
+    relay->frame_size = frame_size;
+    relay->codec = codec;
+    relay->controller = controller;
+    relay->last_key_frame_request = 0;
+
+    // av_packet_ref() does not initialize all fields in old FFmpeg versions
+    // See <https://github.com/Genymobile/scrcpy/issues/707>
+    av_init_packet(&relay->config);
+    relay->config.data = NULL;
+    relay->config.size = 0;
+    relay->has_config = false;
+
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        struct relay_viewer *viewer = &relay->viewers[i];
+        viewer->relay = relay;
+        viewer->socket = INVALID_SOCKET;
+        viewer->thread = NULL;
+        viewer->finished = false;
+        for (unsigned j = 0; j < RELAY_QUEUE_SIZE; ++j) {
+            av_init_packet(&viewer->queue[j]);
+            viewer->queue[j].data = NULL;
+            viewer->queue[j].size = 0;
+        }
+        viewer->queue_head = 0;
+        viewer->queue_count = 0;
+        viewer->wait_key_frame = false;
+    }
+
+    LOGI("Relay available on localhost:%" PRIu16, port);
+    return true;
+
+error_destroy_cond:
+    SDL_DestroyCond(relay->queue_cond);
+error_destroy_mutex:
+    SDL_DestroyMutex(relay->mutex);
+
+    return false;
+}
+
+static void
+close_server_socket(struct relay *relay) {
+    if (!relay->closed) {
+        // On Linux, accept() is unblocked by shutdown(), but on Windows, it is
+        // unblocked by closesocket(). Therefore, call both.
+        net_shutdown(relay->server_socket, SHUT_RDWR);
+        net_close(relay->server_socket);
+        relay->closed = true;
+    }
+}
+
+static void
+viewer_queue_clear(struct relay_viewer *viewer) {
+    while (viewer->queue_count) {
+        av_packet_unref(&viewer->queue[viewer->queue_head]);
+        viewer->queue_head = (viewer->queue_head + 1) % RELAY_QUEUE_SIZE;
+        --viewer->queue_count;
+    }
+}
+
+void
+relay_destroy(struct relay *relay) {
+    close_server_socket(relay);
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        // the threads have been joined
+        assert(!relay->viewers[i].thread);
+        viewer_queue_clear(&relay->viewers[i]);
+    }
+    if (relay->has_config) {
+        av_packet_unref(&relay->config);
+    }
+    SDL_DestroyCond(relay->queue_cond);
+    SDL_DestroyMutex(relay->mutex);
+}
+
+// the relay mutex must be locked
+static bool
+viewer_queue_push(struct relay_viewer *viewer, const AVPacket *packet) {
+    assert(viewer->queue_count < RELAY_QUEUE_SIZE);
+    unsigned index = (viewer->queue_head + viewer->queue_count)
+                   % RELAY_QUEUE_SIZE;
+    // only increments the refcount of the packet data
+    if (av_packet_ref(&viewer->queue[index], packet)) {
+        LOGC("Could not reference packet");
+        return false;
+    }
+
+    ++viewer->queue_count;
+    cond_broadcast(viewer->relay->queue_cond);
+    return true;
+}
+
+// return true if a key frame must be requested now (the mutex must be locked)
+static bool
+should_request_key_frame(struct relay *relay) {
+    if (!relay->controller) {
+        // wait for the periodic one
+        return false;
+    }
+
+    int64_t now = av_gettime_relative();
+    if (relay->last_key_frame_request
+            && now - relay->last_key_frame_request
+                < KEY_FRAME_REQUEST_INTERVAL_US) {
+        // the previous request is probably in progress
+        return false;
+    }
+    relay->last_key_frame_request = now;
+    return true;
+}
+
+static void
+request_key_frame(struct relay *relay) {
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_REQUEST_KEY_FRAME;
+    if (!controller_push_msg(relay->controller, &msg)) {
+        LOGW("Could not request 'request key frame'");
+    }
+}
+
+static bool
+send_packet(socket_t socket, const AVPacket *packet) {
+    uint64_t pts;
+    if (packet->pts == AV_NOPTS_VALUE) {
+        pts = NO_PTS;
+    } else {
+        pts = (uint64_t) packet->pts;
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            pts |= PACKET_FLAG_KEY_FRAME;
+        }
+    }
+
+    uint8_t header[HEADER_SIZE];
+    buffer_write64be(header, pts);
+    // the capture time is expressed in the device clock, which the viewer
+    // could not convert (0 means unknown)
+    buffer_write64be(&header[8], 0);
+    buffer_write32be(&header[16], packet->size);
+
+    return net_send_all(socket, header, HEADER_SIZE) == HEADER_SIZE
+        && net_send_all(socket, packet->data, packet->size)
+            == (ssize_t) packet->size;
+}
+
+static int
+run_viewer(void *data) {
+    struct relay_viewer *viewer = data;
+    struct relay *relay = viewer->relay;
+
+    for (;;) {
+        mutex_lock(relay->mutex);
+        while (!relay->stopped && !viewer->queue_count) {
+            cond_wait(relay->queue_cond, relay->mutex);
+        }
+        if (relay->stopped) {
+            mutex_unlock(relay->mutex);
+            break;
+        }
+        AVPacket packet;
+        av_packet_move_ref(&packet, &viewer->queue[viewer->queue_head]);
+        viewer->queue_head = (viewer->queue_head + 1) % RELAY_QUEUE_SIZE;
+        --viewer->queue_count;
+        mutex_unlock(relay->mutex);
+
+        // the stream thread is never blocked by a viewer
+        bool ok = send_packet(viewer->socket, &packet);
+        av_packet_unref(&packet);
+        if (!ok) {
+            LOGI("Relay viewer disconnected");
+            break;
+        }
+    }
+
+    mutex_lock(relay->mutex);
+    viewer->finished = true;
+    viewer_queue_clear(viewer);
+    mutex_unlock(relay->mutex);
+
+    return 0;
+}
+
+static bool
+send_info(struct relay *relay, socket_t socket) {
+    // the same device info as sent by the server
+    uint8_t buf[INFO_SIZE];
+    memset(buf, 0, DEVICE_NAME_FIELD_LENGTH);
+    xstrncpy((char *) buf, relay->device_name, DEVICE_NAME_FIELD_LENGTH);
+    buffer_write16be(&buf[DEVICE_NAME_FIELD_LENGTH],
+                     relay->frame_size.width);
+    buffer_write16be(&buf[DEVICE_NAME_FIELD_LENGTH + 2],
+                     relay->frame_size.height);
+    buf[DEVICE_NAME_FIELD_LENGTH + 4] = relay->codec;
+
+    return net_send_all(socket, buf, INFO_SIZE) == INFO_SIZE;
+}
+
+bool
+relay_read_info(socket_t socket, char *device_name, struct size *size,
+                enum sc_codec *codec) {
+    uint8_t buf[INFO_SIZE];
+    ssize_t r = net_recv_all(socket, buf, INFO_SIZE);
+    if (r < INFO_SIZE) {
+        LOGE("Could not retrieve relay information");
+        return false;
+    }
+
+    uint8_t value = buf[DEVICE_NAME_FIELD_LENGTH + 4];
+    if (value > SC_CODEC_AV1) {
+        LOGE("Unexpected relay codec: %" PRIu8, value);
+        return false;
+    }
+
+    // in case the relay sends garbage
+    buf[DEVICE_NAME_FIELD_LENGTH - 1] = '\0';
+    strcpy(device_name, (char *) buf);
+    size->width = buffer_read16be(&buf[DEVICE_NAME_FIELD_LENGTH]);
+    size->height = buffer_read16be(&buf[DEVICE_NAME_FIELD_LENGTH + 2]);
+    *codec = value;
+    return true;
+}
+
+// join the threads of the disconnected viewers, to reuse their slots
+// (the threads are only started and joined from the relay thread, until
+// relay_join())
+static void
+release_finished_viewers(struct relay *relay) {
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        struct relay_viewer *viewer = &relay->viewers[i];
+
+        mutex_lock(relay->mutex);
+        SDL_Thread *thread = viewer->finished ? viewer->thread : NULL;
+        if (thread) {
+            viewer->thread = NULL;
+            viewer->finished = false;
+        }
+        mutex_unlock(relay->mutex);
+
+        if (thread) {
+            SDL_WaitThread(thread, NULL);
+            net_close(viewer->socket);
+            viewer->socket = INVALID_SOCKET;
+        }
+    }
+}
+
+static struct relay_viewer *
+find_free_viewer(struct relay *relay) {
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        // only written from this thread, no need to lock
+        if (!relay->viewers[i].thread) {
+            return &relay->viewers[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+add_viewer(struct relay *relay, socket_t socket) {
+    release_finished_viewers(relay);
+
+    struct relay_viewer *viewer = find_free_viewer(relay);
+    if (!viewer) {
+        LOGW("Too many relay viewers (%d), connection refused",
+             RELAY_MAX_VIEWERS);
+        goto error_close_socket;
+    }
+
+    if (!send_info(relay, socket)) {
+        goto error_close_socket;
+    }
+
+    mutex_lock(relay->mutex);
+    if (relay->stopped) {
+        mutex_unlock(relay->mutex);
+        goto error_close_socket;
+    }
+
+    assert(!viewer->queue_count);
+    viewer->socket = socket;
+    viewer->wait_key_frame = true;
+    if (relay->has_config && !viewer_queue_push(viewer, &relay->config)) {
+        mutex_unlock(relay->mutex);
+        goto error_close_socket;
+    }
+
+    viewer->thread = SDL_CreateThread(run_viewer, "relay-viewer", viewer);
+    if (!viewer->thread) {
+        LOGC("Could not start relay viewer thread");
+        viewer_queue_clear(viewer);
+        mutex_unlock(relay->mutex);
+        goto error_close_socket;
+    }
+
+    bool request = should_request_key_frame(relay);
+    mutex_unlock(relay->mutex);
+
+    LOGI("Relay viewer connected");
+    if (request) {
+        // do not wait for the periodic key frame
+        request_key_frame(relay);
+    }
+    return;
+
+error_close_socket:
+    net_close(socket);
+}
+
+#ifdef SC_TEST
+// expose the function to unit-tests
+void
+sc_relay_add_viewer(struct relay *relay, socket_t socket) {
+    add_viewer(relay, socket);
+}
+#endif
+
+static int
+run_relay(void *data) {
+    struct relay *relay = data;
+
+    for (;;) {
+        socket_t socket = net_accept(relay->server_socket);
+        if (socket == INVALID_SOCKET) {
+            // the server socket has been closed
+            break;
+        }
+
+        add_viewer(relay, socket);
+    }
+
+    LOGD("Relay stopped");
+    return 0;
+}
+
+bool
+relay_start(struct relay *relay) {
+    LOGD("Starting relay thread");
+
+    relay->thread = SDL_CreateThread(run_relay, "relay", relay);
+    if (!relay->thread) {
+        LOGC("Could not start relay thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+relay_stop(struct relay *relay) {
+    mutex_lock(relay->mutex);
+    relay->stopped = true;
+    cond_broadcast(relay->queue_cond);
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        struct relay_viewer *viewer = &relay->viewers[i];
+        if (viewer->thread && !viewer->finished) {
+            // unblock a pending send()
+            net_shutdown(viewer->socket, SHUT_RDWR);
+        }
+    }
+    mutex_unlock(relay->mutex);
+
+    close_server_socket(relay);
+}
+
+void
+relay_join(struct relay *relay) {
+    SDL_WaitThread(relay->thread, NULL);
+
+    // no viewer is added anymore
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        struct relay_viewer *viewer = &relay->viewers[i];
+        if (viewer->thread) {
+            SDL_WaitThread(viewer->thread, NULL);
+            viewer->thread = NULL;
+            net_close(viewer->socket);
+            viewer->socket = INVALID_SOCKET;
+        }
+    }
+}
+
+bool
+relay_push(struct relay *relay, const AVPacket *packet) {
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+    bool request = false;
+
+    mutex_lock(relay->mutex);
+
+    if (is_config) {
+        if (relay->has_config) {
+            av_packet_unref(&relay->config);
+        }
+        relay->has_config = !av_packet_ref(&relay->config, packet);
+        if (!relay->has_config) {
+            LOGC("Could not reference packet");
+            goto error_unlock;
+        }
+    }
+
+    for (unsigned i = 0; i < RELAY_MAX_VIEWERS; ++i) {
+        struct relay_viewer *viewer = &relay->viewers[i];
+        if (!viewer->thread || viewer->finished) {
+            continue;
+        }
+
+        if (viewer->queue_count == RELAY_QUEUE_SIZE) {
+            LOGW("Relay viewer too slow, waiting for the next key frame");
+            viewer_queue_clear(viewer);
+            // the config packet may have been dropped
+            if (relay->has_config && !is_config
+                    && !viewer_queue_push(viewer, &relay->config)) {
+                goto error_unlock;
+            }
+            viewer->wait_key_frame = true;
+            request |= !key_frame && should_request_key_frame(relay);
+        }
+
+        if (viewer->wait_key_frame && !is_config) {
+            if (!key_frame) {
+                continue;
+            }
+            viewer->wait_key_frame = false;
+        }
+
+        if (!viewer_queue_push(viewer, packet)) {
+            goto error_unlock;
+        }
+    }
+
+    mutex_unlock(relay->mutex);
+
+    if (request) {
+        request_key_frame(relay);
+    }
+    return true;
+
+error_unlock:
+    mutex_unlock(relay->mutex);
+    return false;
+}
@@ -0,0 +1,107 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+#include "config.h"
+#include "common.h"
+#include "device.h"
+#include "scrcpy.h"
+#include "util/net.h"
+
+#define RELAY_MAX_VIEWERS 16
+
+// the packets waiting to be sent to a viewer: beyond that, the viewer is too
+// slow, its queue is dropped and it resumes on the next key frame
+#define RELAY_QUEUE_SIZE 64
+
+struct controller;
+struct relay;
+
+struct relay_viewer {
+    struct relay *relay;
+    socket_t socket;
+    SDL_Thread *thread; // NULL if the slot is free
+    bool finished; // the thread has exited, it must be joined
+
+    // Ring of packets referencing the stream packets (the data is shared by
+    // all the viewers, never copied)
+    AVPacket queue[RELAY_QUEUE_SIZE];
+    unsigned queue_head; // index of the oldest packet
+    unsigned queue_count;
+    // the decoder of the viewer needs a key frame (on join, or after a drop)
+    bool wait_key_frame;
+};
+
+// Serve the video stream received from the device to other scrcpy clients
+// (--relay-port), so that a single encoder runs on the device whatever the
+// number of viewers.
+//
+// A viewer receives the device info (like from the server), the codec, then
+// the packets in the same format as the video socket. A late joiner receives
+// the last config packet, then the stream resumes on the next key frame
+// (requested immediately if a controller is available).
+//
+// The control remains with the owner of the relay: the viewers are read-only.
+struct relay {
+    socket_t server_socket;
+    bool closed; // only accessed from the main thread
+    SDL_Thread *thread; // accepts the viewers
+    SDL_mutex *mutex;
+    SDL_cond *queue_cond; // signaled when a packet is pushed to any viewer
+    bool stopped;
+
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size frame_size;
+    enum sc_codec codec;
+    struct controller *controller; // may be NULL
+    int64_t last_key_frame_request;
+
+    // the last config packet, sent to the late joiners
+    AVPacket config;
+    bool has_config;
+
+    struct relay_viewer viewers[RELAY_MAX_VIEWERS];
+};
+
+// controller may be NULL (the late joiners wait for the periodic key frame)
+bool
+relay_init(struct relay *relay, uint16_t port, const char *device_name,
+           struct size frame_size, enum sc_codec codec,
+           struct controller *controller);
+
+void
+relay_destroy(struct relay *relay);
+
+bool
+relay_start(struct relay *relay);
+
+void
+relay_stop(struct relay *relay);
+
+void
+relay_join(struct relay *relay);
+
+// read the header sent by a relay to a viewer (--relay-connect)
+// device_name must be at least DEVICE_NAME_FIELD_LENGTH bytes
+bool
+relay_read_info(socket_t socket, char *device_name, struct size *size,
+                enum sc_codec *codec);
+
+// forward a packet (config or data) received from the device to the viewers
+// only called from the stream thread
+bool
+relay_push(struct relay *relay, const AVPacket *packet);
+
+#ifdef SC_TEST
+// serve the stream to a viewer already connected (the socket is owned by the
+// relay, and closed on failure)
+void
+sc_relay_add_viewer(struct relay *relay, socket_t socket);
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#include "render_pacer.h"
+
+#include <assert.h>
+
+// above this interval, the stream is considered paused (the device screen
+// does not change), so the previous arrivals are irrelevant
+#define MAX_FRAME_PERIOD 250000 // 250ms
+
+void
+render_pacer_init(struct render_pacer *pacer, bool smooth) {
+    pacer->smooth = smooth;
+    pacer->refresh_period = 1000000 / RENDER_PACER_DEFAULT_REFRESH_RATE;
+    pacer->frame_period = 0;
+    pacer->last_arrival = -1;
+    pacer->last_present = -1;
+    pacer->frame_pending = false;
+    pacer->deadline = 0;
+}
+
+void
+render_pacer_set_refresh_rate(struct render_pacer *pacer, int refresh_rate) {
+    if (refresh_rate <= 0) {
+        refresh_rate = RENDER_PACER_DEFAULT_REFRESH_RATE;
+    }
+    pacer->refresh_period = 1000000 / refresh_rate;
+}
+
+static void
+update_frame_period(struct render_pacer *pacer, int64_t now) {
+    if (pacer->last_arrival != -1) {
+        int64_t delta = now - pacer->last_arrival;
+        if (delta > MAX_FRAME_PERIOD) {
+            pacer->frame_period = 0;
+        } else if (!pacer->frame_period) {
+            pacer->frame_period = delta;
+        } else {
+            // exponential moving average, to absorb the jitter
+            pacer->frame_period = (7 * pacer->frame_period + delta) / 8;
+        }
+    }
+    pacer->last_arrival = now;
+}
+
+void
+render_pacer_frame_available(struct render_pacer *pacer, int64_t now) {
+    update_frame_period(pacer, now);
+
+    if (pacer->frame_pending) {
+        // the new frame replaces the pending one, at the same deadline
+        return;
+    }
+
+    pacer->frame_pending = true;
+    pacer->deadline = now;
+
+    if (!pacer->smooth || pacer->last_present == -1
+            || pacer->frame_period <= pacer->refresh_period) {
+        // nothing to smooth: present every refresh
+        return;
+    }
+
+    // Target one frame period after the previous presentation, minus half a
+    // refresh period, so that the presentation happens on the vsync closest
+    // to the ideal time
+    int64_t target = pacer->last_present + pacer->frame_period
+                   - pacer->refresh_period / 2;
+    int64_t max_deadline = now + pacer->refresh_period;
+    if (target > max_deadline) {
+        target = max_deadline;
+    }
+    if (target > now) {
+        pacer->deadline = target;
+    }
+}
+
+int64_t
+render_pacer_get_delay(const struct render_pacer *pacer, int64_t now) {
+    if (!pacer->frame_pending) {
+        return -1;
+    }
+    return pacer->deadline > now ? pacer->deadline - now : 0;
+}
+
+void
+render_pacer_frame_presented(struct render_pacer *pacer, int64_t now) {
+    assert(pacer->frame_pending);
+    pacer->frame_pending = false;
+    pacer->last_present = now;
+}
@@ -0,0 +1,56 @@
+#ifndef RENDER_PACER_H
+#define RENDER_PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#define RENDER_PACER_DEFAULT_REFRESH_RATE 60
+
+// Decide when to present the frames, when the presentation is synchronized
+// to the display refresh (vsync).
+//
+// Without smoothing, a new frame is presented as soon as all the pending
+// events have been processed (the most recent frame is always taken).
+//
+// With smoothing, if the video frame rate is lower than the refresh rate, a
+// frame arriving early (typically because of network jitter) is delayed to
+// keep the interval between presentations close to the video frame interval.
+// The delay never exceeds one refresh period, so the added latency is
+// bounded.
+//
+// All times are in microseconds (see av_gettime_relative()). Only accessed
+// from the main thread.
+struct render_pacer {
+    bool smooth;
+    int64_t refresh_period;
+    // estimated interval between video frames, 0 if unknown
+    int64_t frame_period;
+    int64_t last_arrival; // -1 if none
+    int64_t last_present; // -1 if none
+    bool frame_pending;
+    int64_t deadline; // meaningful only if frame_pending is set
+};
+
+void
+render_pacer_init(struct render_pacer *pacer, bool smooth);
+
+// set the display refresh rate (in Hz), 0 if unknown
+void
+render_pacer_set_refresh_rate(struct render_pacer *pacer, int refresh_rate);
+
+// a new frame is available for rendering
+void
+render_pacer_frame_available(struct render_pacer *pacer, int64_t now);
+
+// return the delay before the pending frame must be presented (0 if it is
+// due), or -1 if there is no pending frame
+int64_t
+render_pacer_get_delay(const struct render_pacer *pacer, int64_t now);
+
+// the pending frame has been presented
+void
+render_pacer_frame_presented(struct render_pacer *pacer, int64_t now);
+
+#endif
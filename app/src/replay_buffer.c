@@ -0,0 +1,349 @@
+#include "replay_buffer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "config.h"
+#include "recorder.h"
+#include "util/lock.h"
+#include "util/log.h"
+
+// the packets to save, referenced at the time of the request
+struct replay_save {
+    struct replay_buffer *rb;
+    char filename[64];
+    AVPacket *packets; // the config packet, then the data packets
+    unsigned count;
+};
+
+bool
+replay_buffer_init(struct replay_buffer *rb, enum AVCodecID codec_id,
+                   struct size declared_frame_size, uint64_t duration,
+                   size_t max_bytes) {
+    rb->mutex = SDL_CreateMutex();
+    if (!rb->mutex) {
+        LOGC("Could not create mutex");
+        return false;
+    }
+
+    rb->codec_id = codec_id;
+    rb->declared_frame_size = declared_frame_size;
+    rb->duration = duration;
+    rb->max_bytes = max_bytes;
+    rb->has_config = false;
+    // av_packet_ref() does not initialize all fields in old FFmpeg versions
+    // See <https://github.com/Genymobile/scrcpy/issues/707>
+    av_init_packet(&rb->config);
+    queue_init(&rb->queue);
+    rb->count = 0;
+    rb->bytes = 0;
+    rb->last_pts = AV_NOPTS_VALUE;
+    rb->save_thread = NULL;
+    rb->saving = false;
+
+    return true;
+}
+
+static void
+replay_buffer_drop_first(struct replay_buffer *rb) {
+    struct replay_packet *rp;
+    queue_take(&rb->queue, next, &rp);
+    --rb->count;
+    rb->bytes -= rp->packet.size;
+    av_packet_unref(&rp->packet);
+    SDL_free(rp);
+}
+
+void
+replay_buffer_destroy(struct replay_buffer *rb) {
+    if (rb->save_thread) {
+        LOGI("Finishing replay saving...");
+        SDL_WaitThread(rb->save_thread, NULL);
+    }
+    while (!queue_is_empty(&rb->queue)) {
+        replay_buffer_drop_first(rb);
+    }
+    if (rb->has_config) {
+        av_packet_unref(&rb->config);
+    }
+    SDL_DestroyMutex(rb->mutex);
+}
+
+// the start of the second GOP, or NULL if there is only one
+static struct replay_packet *
+find_next_key_frame(struct replay_buffer *rb) {
+    assert(!queue_is_empty(&rb->queue));
+    for (struct replay_packet *rp = rb->queue.first->next; rp; rp = rp->next) {
+        if (rp->packet.flags & AV_PKT_FLAG_KEY) {
+            return rp;
+        }
+    }
+    return NULL;
+}
+
+// discard the oldest GOPs which are not needed anymore
+// the mutex must be locked
+static void
+replay_buffer_trim(struct replay_buffer *rb) {
+    for (;;) {
+        struct replay_packet *next_key = find_next_key_frame(rb);
+        if (!next_key) {
+            // never cut a GOP, it could not be decoded
+            return;
+        }
+
+        bool expired =
+            (uint64_t) (rb->last_pts - next_key->packet.pts) >= rb->duration;
+        bool too_big = rb->bytes > rb->max_bytes;
+        if (!expired && !too_big) {
+            return;
+        }
+
+        if (!expired) {
+            LOGW("Replay buffer full, keeping less than the requested "
+                 "duration");
+        }
+
+        while (rb->queue.first != next_key) {
+            replay_buffer_drop_first(rb);
+        }
+    }
+}
+
+bool
+replay_buffer_push(struct replay_buffer *rb, const AVPacket *packet) {
+    mutex_lock(rb->mutex);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // config packet, only the last one is needed
+        if (rb->has_config) {
+            av_packet_unref(&rb->config);
+        }
+        rb->has_config = !av_packet_ref(&rb->config, packet);
+        mutex_unlock(rb->mutex);
+        if (!rb->has_config) {
+            LOGC("Could not reference packet");
+            return false;
+        }
+        return true;
+    }
+
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+    if (queue_is_empty(&rb->queue) && !key_frame) {
+        // the buffer must start on a key frame
+        mutex_unlock(rb->mutex);
+        return true;
+    }
+
+    struct replay_packet *rp = SDL_malloc(sizeof(*rp));
+    if (!rp) {
+        mutex_unlock(rb->mutex);
+        LOGC("Could not allocate replay packet");
+        return false;
+    }
+
+    // av_packet_ref() does not initialize all fields in old FFmpeg versions
+    // See <https://github.com/Genymobile/scrcpy/issues/707>
+    av_init_packet(&rp->packet);
+
+    // only increments the refcount of the packet data
+    if (av_packet_ref(&rp->packet, packet)) {
+        mutex_unlock(rb->mutex);
+        LOGC("Could not reference packet");
+        SDL_free(rp);
+        return false;
+    }
+    rp->packet.dts = rp->packet.pts;
+
+    queue_push(&rb->queue, next, rp);
+    ++rb->count;
+    rb->bytes += packet->size;
+    rb->last_pts = packet->pts;
+
+    // a GOP may only be discarded once the next one has started
+    if (key_frame || rb->bytes > rb->max_bytes) {
+        replay_buffer_trim(rb);
+    }
+
+    mutex_unlock(rb->mutex);
+    return true;
+}
+
+static bool
+write_replay(struct replay_save *save) {
+    const AVCodec *codec = avcodec_find_decoder(save->rb->codec_id);
+    if (!codec) {
+        LOGE("Decoder not found: %s", avcodec_get_name(save->rb->codec_id));
+        return false;
+    }
+
+    // reuse the recorder (on this thread, blocking is harmless, so the file
+    // is written directly)
+    struct recorder recorder;
+    if (!recorder_init(&recorder, save->filename, SC_RECORD_FORMAT_MP4,
+                       save->rb->declared_frame_size, 64,
+                       SC_RECORD_QUEUE_POLICY_BLOCK, 0, false, 0, NULL)) {
+        return false;
+    }
+
+    bool ok = false;
+    if (!recorder_open(&recorder, codec)) {
+        goto end;
+    }
+
+    if (!recorder_start(&recorder)) {
+        goto close;
+    }
+
+    // the replay starts at 0
+    int64_t start_pts = save->packets[1].pts;
+    for (unsigned i = 0; i < save->count; ++i) {
+        AVPacket *packet = &save->packets[i];
+        if (i) {
+            packet->pts -= start_pts;
+            packet->dts = packet->pts;
+        }
+        if (!recorder_push(&recorder, packet)) {
+            break;
+        }
+    }
+
+    recorder_stop(&recorder);
+    recorder_join(&recorder);
+
+close:
+    recorder_close(&recorder);
+    ok = !recorder.failed;
+end:
+    recorder_destroy(&recorder);
+    return ok;
+}
+
+static int
+run_save(void *data) {
+    struct replay_save *save = data;
+    struct replay_buffer *rb = save->rb;
+
+    if (write_replay(save)) {
+        LOGI("Replay saved to %s", save->filename);
+    } else {
+        LOGE("Could not save replay to %s", save->filename);
+    }
+
+    for (unsigned i = 0; i < save->count; ++i) {
+        av_packet_unref(&save->packets[i]);
+    }
+    SDL_free(save->packets);
+    SDL_free(save);
+
+    mutex_lock(rb->mutex);
+    rb->saving = false;
+    mutex_unlock(rb->mutex);
+
+    return 0;
+}
+
+// reference the buffered packets into save
+// the mutex must be locked
+static bool
+replay_buffer_snapshot(struct replay_buffer *rb, struct replay_save *save) {
+    save->packets = SDL_malloc((rb->count + 1) * sizeof(*save->packets));
+    if (!save->packets) {
+        LOGC("Could not allocate replay packets");
+        return false;
+    }
+
+    // av_packet_ref() does not initialize all fields in old FFmpeg versions
+    // See <https://github.com/Genymobile/scrcpy/issues/707>
+    for (unsigned i = 0; i < rb->count + 1; ++i) {
+        av_init_packet(&save->packets[i]);
+    }
+
+    save->count = 0;
+    if (av_packet_ref(&save->packets[0], &rb->config)) {
+        goto error;
+    }
+    ++save->count;
+    for (struct replay_packet *rp = rb->queue.first; rp; rp = rp->next) {
+        if (av_packet_ref(&save->packets[save->count], &rp->packet)) {
+            goto error;
+        }
+        ++save->count;
+    }
+    assert(save->count == rb->count + 1);
+
+    return true;
+
+error:
+    LOGC("Could not reference packet");
+    // count is the number of successfully referenced packets
+    for (unsigned i = 0; i < save->count; ++i) {
+        av_packet_unref(&save->packets[i]);
+    }
+    SDL_free(save->packets);
+    return false;
+}
+
+bool
+replay_buffer_save(struct replay_buffer *rb) {
+    struct replay_save *save = SDL_malloc(sizeof(*save));
+    if (!save) {
+        LOGC("Could not allocate replay");
+        return false;
+    }
+    save->rb = rb;
+
+    time_t now = time(NULL);
+    strftime(save->filename, sizeof(save->filename),
+             "scrcpy-replay-%Y%m%d-%H%M%S.mp4", localtime(&now));
+
+    mutex_lock(rb->mutex);
+    if (rb->saving) {
+        mutex_unlock(rb->mutex);
+        LOGW("A replay is already being saved");
+        SDL_free(save);
+        return false;
+    }
+
+    if (!rb->has_config || queue_is_empty(&rb->queue)) {
+        mutex_unlock(rb->mutex);
+        LOGW("Replay buffer is empty");
+        SDL_free(save);
+        return false;
+    }
+
+    bool ok = replay_buffer_snapshot(rb, save);
+    if (ok) {
+        rb->saving = true;
+    }
+    mutex_unlock(rb->mutex);
+
+    if (!ok) {
+        SDL_free(save);
+        return false;
+    }
+
+    if (rb->save_thread) {
+        // the previous save is complete, release its thread
+        SDL_WaitThread(rb->save_thread, NULL);
+    }
+
+    LOGI("Saving replay to %s...", save->filename);
+
+    rb->save_thread = SDL_CreateThread(run_save, "replay", save);
+    if (!rb->save_thread) {
+        LOGC("Could not start replay thread");
+        for (unsigned i = 0; i < save->count; ++i) {
+            av_packet_unref(&save->packets[i]);
+        }
+        SDL_free(save->packets);
+        SDL_free(save);
+        mutex_lock(rb->mutex);
+        rb->saving = false;
+        mutex_unlock(rb->mutex);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavformat/avformat.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+#include "config.h"
+#include "common.h"
+#include "util/queue.h"
+
+struct replay_packet {
+    AVPacket packet;
+    struct replay_packet *next;
+};
+
+struct replay_queue QUEUE(struct replay_packet);
+
+// Keep the last seconds of the video stream in memory, so that they can be
+// written to a file on demand ("instant replay").
+//
+// The buffer always starts on a key frame: whole GOPs are discarded once the
+// remaining packets still cover the requested duration (or exceed the memory
+// limit).
+struct replay_buffer {
+    SDL_mutex *mutex;
+    enum AVCodecID codec_id;
+    struct size declared_frame_size;
+    uint64_t duration; // in microseconds
+    size_t max_bytes;
+
+    // the last config packet, written first on save
+    bool has_config;
+    AVPacket config;
+
+    struct replay_queue queue;
+    unsigned count;
+    size_t bytes;
+    int64_t last_pts;
+
+    // written by the save thread, one at a time
+    SDL_Thread *save_thread;
+    bool saving;
+};
+
+// duration is in microseconds
+bool
+replay_buffer_init(struct replay_buffer *rb, enum AVCodecID codec_id,
+                   struct size declared_frame_size, uint64_t duration,
+                   size_t max_bytes);
+
+// wait for the pending save, if any
+void
+replay_buffer_destroy(struct replay_buffer *rb);
+
+// called by the stream thread for each packet (config or data)
+bool
+replay_buffer_push(struct replay_buffer *rb, const AVPacket *packet);
+
+// write the buffered packets to a new MP4 file, from a separate thread
+// (the file name is generated from the current date and time)
+bool
+replay_buffer_save(struct replay_buffer *rb);
+
+#endif
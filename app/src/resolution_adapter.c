@@ -0,0 +1,112 @@
+#include "resolution_adapter.h"
+
+#include <inttypes.h>
+#include <SDL2/SDL_events.h>
+
+#include "config.h"
+#include "common.h"
+#include "control_msg.h"
+#include "events.h"
+#include "util/log.h"
+
+#define RESOLUTION_ADAPTER_DELAY_MS 500
+// the encoder requires multiples of 8
+#define RESOLUTION_ADAPTER_ALIGN 8
+// do not request a video smaller than this
+#define RESOLUTION_ADAPTER_MIN_SIZE 128
+
+void
+resolution_adapter_init(struct resolution_adapter *adapter,
+                        struct screen *screen, struct controller *controller,
+                        uint16_t max_size) {
+    adapter->screen = screen;
+    adapter->controller = controller;
+    adapter->max_size = max_size;
+    adapter->requested = 0;
+    adapter->timer = 0;
+}
+
+void
+resolution_adapter_destroy(struct resolution_adapter *adapter) {
+    if (adapter->timer) {
+        SDL_RemoveTimer(adapter->timer);
+    }
+}
+
+static uint32_t
+on_timeout(uint32_t interval, void *data) {
+    (void) interval;
+
+    // called from the SDL timer thread
+    SDL_Event event;
+    event.type = EVENT_WINDOW_SIZE_SETTLED;
+    event.user.data1 = data;
+    SDL_PushEvent(&event);
+
+    // do not repeat
+    return 0;
+}
+
+void
+resolution_adapter_on_window_resized(struct resolution_adapter *adapter) {
+    if (adapter->timer) {
+        // the window is still being resized, restart the delay
+        SDL_RemoveTimer(adapter->timer);
+    }
+    adapter->timer = SDL_AddTimer(RESOLUTION_ADAPTER_DELAY_MS, on_timeout,
+                                  adapter);
+    if (!adapter->timer) {
+        LOGW("Could not add resolution adapter timer: %s", SDL_GetError());
+    }
+}
+
+void
+resolution_adapter_apply(struct resolution_adapter *adapter) {
+    // the timer has expired (removing it is not necessary)
+    adapter->timer = 0;
+
+    struct screen *screen = adapter->screen;
+    if (!screen->has_frame) {
+        return;
+    }
+
+    // the major dimension is independent of the rotation
+    uint32_t window_size = MAX(screen->rect.w, screen->rect.h);
+    uint32_t desired = (window_size + RESOLUTION_ADAPTER_ALIGN - 1)
+                     & ~(RESOLUTION_ADAPTER_ALIGN - 1);
+    desired = MAX(desired, RESOLUTION_ADAPTER_MIN_SIZE);
+    if (adapter->max_size) {
+        desired = MIN(desired, adapter->max_size);
+    }
+    if (desired > 0xFFFF) {
+        desired = 0xFFFF & ~(RESOLUTION_ADAPTER_ALIGN - 1);
+    }
+
+    if (desired == adapter->requested) {
+        return;
+    }
+
+    uint32_t frame_size = MAX(screen->frame_size.width,
+                              screen->frame_size.height);
+    if (frame_size >= desired && frame_size <= desired + desired / 8) {
+        // slightly bigger than the window, keep it
+        return;
+    }
+    if (frame_size < desired && adapter->requested >= desired) {
+        // the device cannot provide more pixels (its screen or its crop is
+        // smaller than the window)
+        return;
+    }
+
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_SET_MAX_SIZE;
+    msg.set_max_size.max_size = desired;
+
+    if (!controller_push_msg(adapter->controller, &msg)) {
+        LOGW("Could not request 'set max size'");
+        return;
+    }
+
+    LOGD("Requested max size %" PRIu32, desired);
+    adapter->requested = desired;
+}
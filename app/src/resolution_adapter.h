@@ -0,0 +1,54 @@
+#ifndef RESOLUTION_ADAPTER_H
+#define RESOLUTION_ADAPTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL_timer.h>
+
+#include "config.h"
+#include "controller.h"
+#include "screen.h"
+
+// Request the device to encode the main stream at the size of the window
+// (--adaptive-resolution)
+//
+// Once the window has not been resized for a short delay, a new max size
+// (the major dimension of the content rectangle) is sent to the server, which
+// restarts only its encoder if the video size actually changes. The window
+// keeps its size when the new frames are received (see keep_window_size in
+// struct screen).
+//
+// A small hysteresis avoids to restart the encoder for a few pixels: a frame
+// slightly bigger than the window is kept (it is downscaled on rendering).
+//
+// Only accessed from the main thread (the timer callback only pushes an
+// event).
+struct resolution_adapter {
+    struct screen *screen;
+    struct controller *controller;
+    // the max size requested on start (0 for unlimited), never exceeded
+    uint16_t max_size;
+    // the last max size sent to the server (0 if none)
+    uint16_t requested;
+    SDL_TimerID timer; // 0 if not armed
+};
+
+void
+resolution_adapter_init(struct resolution_adapter *adapter,
+                        struct screen *screen, struct controller *controller,
+                        uint16_t max_size);
+
+void
+resolution_adapter_destroy(struct resolution_adapter *adapter);
+
+// (re)start the debounce delay, after which EVENT_WINDOW_SIZE_SETTLED is
+// pushed
+void
+resolution_adapter_on_window_resized(struct resolution_adapter *adapter);
+
+// request a new max size if the window size requires it (on
+// EVENT_WINDOW_SIZE_SETTLED)
+void
+resolution_adapter_apply(struct resolution_adapter *adapter);
+
+#endif
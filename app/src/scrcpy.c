@@ -1,9 +1,14 @@
 #include "scrcpy.h"
 
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <libavformat/avformat.h>
+#include <libavutil/time.h>
 #include <sys/time.h>
 #include <SDL2/SDL.h>
 
@@ -14,48 +19,128 @@
 #endif
 
 #include "config.h"
+#include "annexb_input.h"
+#include "clock_sync.h"
 #include "command.h"
 #include "common.h"
 #include "compat.h"
 #include "controller.h"
 #include "decoder.h"
+#include "compositor.h"
+#include "decoder_pool.h"
 #include "device.h"
+#include "display_buffer.h"
 #include "events.h"
 #include "file_handler.h"
 #include "fps_counter.h"
 #include "input_manager.h"
+#include "metrics.h"
+#include "metrics_server.h"
 #include "recorder.h"
+#include "relay.h"
+#include "replay_buffer.h"
+#include "render_pacer.h"
+#include "resolution_adapter.h"
 #include "screen.h"
+#include "screenshot.h"
 #include "server.h"
+#include "shm_sink.h"
+#ifdef HAVE_V4L2
+# include "v4l2_sink.h"
+#endif
 #include "stream.h"
 #include "tiny_xpm.h"
+#include "trace.h"
 #include "video_buffer.h"
 #include "util/lock.h"
 #include "util/log.h"
 #include "util/net.h"
 
-static struct server server;
-static struct screen screen = SCREEN_INITIALIZER;
-static struct fps_counter fps_counter;
-static struct video_buffer video_buffer;
-static struct stream stream;
-static struct decoder decoder;
-static struct recorder recorder;
-static struct controller controller;
-static struct file_handler file_handler;
-
-static struct input_manager input_manager = {
-    .controller = &controller,
-    .video_buffer = &video_buffer,
-    .screen = &screen,
-    .repeat = 0,
-
-    // initialized later
-    .prefer_text = false,
-    .sdl_shortcut_mods = {
-        .data = {0},
-        .count = 0,
-    },
+// all the state related to one device
+struct session {
+    // the options of this session (with its own serial)
+    struct scrcpy_options options;
+
+    struct server server;
+    // only used with --input (there is no server)
+    struct annexb_input input;
+    // only used with --relay-connect (there is no server)
+    socket_t relay_socket;
+
+    // the device is connected on a separate thread, while SDL and the
+    // renderer are initialized
+    SDL_Thread *connect_thread;
+    bool connected;
+    // set on connection
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size frame_size;
+    struct size display_size; // the size of the displayed stream
+    // only used with --reconnect, while the connection is re-established
+    SDL_Thread *reconnect_thread;
+    atomic_bool reconnect_interrupted;
+    struct screen screen;
+    struct fps_counter fps_counter;
+    struct clock_sync clock_sync;
+    struct video_buffer video_buffer;
+    struct stream stream;
+    // the decoded stream, if a preview stream is requested (the main stream
+    // is then only recorded)
+    struct stream preview_stream;
+    struct decoder decoder;
+    struct recorder recorder;
+    struct replay_buffer replay_buffer;
+    // only used with --relay-port
+    struct relay relay;
+    struct shm_sink shm_sink;
+#ifdef HAVE_V4L2
+    struct v4l2_sink v4l2_sink;
+#endif
+    struct controller controller;
+    struct file_handler file_handler;
+    struct render_pacer render_pacer;
+    // only used with --display-buffer
+    struct display_buffer display_buffer;
+    struct input_manager input_manager;
+    // only used with --adaptive-resolution
+    struct resolution_adapter resolution_adapter;
+    // only used with a display
+    struct screenshot screenshot;
+    // always updated, only exported with --metrics-port
+    struct metrics metrics;
+
+    // the session is connected and running: its events are handled (the
+    // server is not initialized with --input or --relay-connect)
+    bool active;
+    bool server_initialized;
+    bool server_started;
+    bool input_opened;
+    bool video_buffer_initialized;
+    bool file_handler_initialized;
+    bool recorder_initialized;
+    bool replay_buffer_initialized;
+    bool relay_initialized;
+    bool relay_started;
+    bool shm_sink_initialized;
+    bool v4l2_sink_initialized;
+    bool stream_started;
+    bool preview_stream_started;
+    bool controller_initialized;
+    bool controller_started;
+    bool screen_initialized;
+    bool screenshot_initialized;
+    bool screenshot_started;
+    bool resolution_adapter_initialized;
+    // the window is minimized or hidden
+    bool video_paused;
+};
+
+struct session_list {
+    struct session *data;
+    unsigned count;
+    // shared by the sessions (NULL if there is only one)
+    struct decoder_pool *decoder_pool;
+    // the window displaying all the sessions as tiles (NULL if disabled)
+    struct compositor *compositor;
 };
 
 #ifdef _WIN32
@@ -74,7 +159,9 @@ BOOL WINAPI windows_ctrl_handler(DWORD ctrl_type) {
 static bool
 sdl_init_and_configure(bool display, const char *render_driver,
                        bool disable_screensaver) {
-    uint32_t flags = display ? SDL_INIT_VIDEO : SDL_INIT_EVENTS;
+    // the timers are used to debounce the window resizing
+    uint32_t flags = display ? SDL_INIT_VIDEO | SDL_INIT_TIMER
+                             : SDL_INIT_EVENTS;
     if (SDL_Init(flags)) {
         LOGC("Could not initialize SDL: %s", SDL_GetError());
         return false;
@@ -138,6 +225,39 @@ sdl_init_and_configure(bool display, const char *render_driver,
 # define CONTINUOUS_RESIZING_WORKAROUND
 #endif
 
+static struct session *
+find_session_by_screen(struct session_list *sessions, struct screen *screen) {
+    if (!screen) {
+        return NULL;
+    }
+    for (unsigned i = 0; i < sessions->count; ++i) {
+        struct session *s = &sessions->data[i];
+        if (s->screen_initialized && &s->screen == screen) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static struct session *
+find_session_by_window_id(struct session_list *sessions, uint32_t window_id) {
+    if (sessions->count == 1) {
+        // a single window, do not rely on the event window id
+        return &sessions->data[0];
+    }
+    SDL_Window *window = SDL_GetWindowFromID(window_id);
+    if (!window) {
+        return NULL;
+    }
+    for (unsigned i = 0; i < sessions->count; ++i) {
+        struct session *s = &sessions->data[i];
+        if (s->screen_initialized && s->screen.window == window) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
 #ifdef CONTINUOUS_RESIZING_WORKAROUND
 // On Windows and MacOS, resizing blocks the event loop, so resizing events are
 // not triggered. As a workaround, handle them in an event handler.
@@ -146,12 +266,22 @@ sdl_init_and_configure(bool display, const char *render_driver,
 // <https://stackoverflow.com/a/40693139/1987178>
 static int
 event_watcher(void *data, SDL_Event *event) {
-    (void) data;
+    struct session_list *sessions = data;
     if (event->type == SDL_WINDOWEVENT
             && event->window.event == SDL_WINDOWEVENT_RESIZED) {
         // In practice, it seems to always be called from the same thread in
         // that specific case. Anyway, it's just a workaround.
-        screen_render(&screen, true);
+        struct compositor *compositor = sessions->compositor;
+        if (compositor) {
+            compositor_handle_window_event(compositor, &event->window);
+            compositor_render_if_requested(compositor);
+            return 0;
+        }
+        struct session *s =
+            find_session_by_window_id(sessions, event->window.windowID);
+        if (s) {
+            screen_render(&s->screen, true);
+        }
     }
     return 0;
 }
@@ -163,68 +293,269 @@ is_apk(const char *file) {
     return ext && !strcmp(ext, ".apk");
 }
 
+// return the tile an input event of the compositor window is related to
+static struct screen *
+find_event_tile(struct compositor *compositor, const SDL_Event *event) {
+    int x;
+    int y;
+    switch (event->type) {
+        case SDL_MOUSEMOTION:
+            if (event->motion.state && compositor->focus) {
+                // a drag continues on the tile where it started
+                return compositor->focus;
+            }
+            return compositor_get_tile_at(compositor, event->motion.x,
+                                          event->motion.y);
+        case SDL_MOUSEBUTTONDOWN:
+            compositor->focus = compositor_get_tile_at(compositor,
+                                                       event->button.x,
+                                                       event->button.y);
+            return compositor->focus;
+        case SDL_MOUSEBUTTONUP:
+            return compositor->focus;
+        case SDL_MOUSEWHEEL:
+            SDL_GetMouseState(&x, &y);
+            return compositor_get_tile_at(compositor, x, y);
+        case SDL_TEXTINPUT:
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_DROPFILE:
+        case SDL_FINGERMOTION:
+        case SDL_FINGERDOWN:
+        case SDL_FINGERUP:
+            if (compositor->focus) {
+                return compositor->focus;
+            }
+            SDL_GetMouseState(&x, &y);
+            return compositor_get_tile_at(compositor, x, y);
+    }
+    return NULL;
+}
+
+// return the session an event is related to, or NULL
+static struct session *
+find_event_session(struct session_list *sessions, const SDL_Event *event) {
+    if (sessions->compositor) {
+        switch (event->type) {
+            case EVENT_NEW_FRAME:
+            case EVENT_STREAM_STOPPED:
+            case EVENT_STREAM_DISCONNECTED:
+            case EVENT_FRAME_SIZE_CHANGED:
+            case EVENT_WINDOW_SIZE_SETTLED:
+                // found by source, below
+                break;
+            default:
+                // all the input events come from the compositor window
+                return find_session_by_screen(sessions,
+                        find_event_tile(sessions->compositor, event));
+        }
+    }
+
+    switch (event->type) {
+        case EVENT_NEW_FRAME:
+        case EVENT_STREAM_STOPPED:
+        case EVENT_STREAM_DISCONNECTED:
+        case EVENT_FRAME_SIZE_CHANGED:
+        case EVENT_WINDOW_SIZE_SETTLED:
+            // the source component is passed as data1
+            for (unsigned i = 0; i < sessions->count; ++i) {
+                struct session *s = &sessions->data[i];
+                void *source = event->user.data1;
+                if (source == &s->video_buffer || source == &s->stream
+                        || source == &s->preview_stream
+                        || source == &s->screen
+                        || source == &s->resolution_adapter) {
+                    return s;
+                }
+            }
+            return NULL;
+        case SDL_WINDOWEVENT:
+            return find_session_by_window_id(sessions, event->window.windowID);
+        case SDL_TEXTINPUT:
+            return find_session_by_window_id(sessions, event->text.windowID);
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            return find_session_by_window_id(sessions, event->key.windowID);
+        case SDL_MOUSEMOTION:
+            return find_session_by_window_id(sessions, event->motion.windowID);
+        case SDL_MOUSEWHEEL:
+            return find_session_by_window_id(sessions, event->wheel.windowID);
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            return find_session_by_window_id(sessions, event->button.windowID);
+        case SDL_DROPFILE:
+            return find_session_by_window_id(sessions, event->drop.windowID);
+        case SDL_FINGERMOTION:
+        case SDL_FINGERDOWN:
+        case SDL_FINGERUP: {
+            // touch events are not associated to a window
+            SDL_Window *focus = SDL_GetMouseFocus();
+            uint32_t window_id = focus ? SDL_GetWindowID(focus) : 0;
+            return find_session_by_window_id(sessions, window_id);
+        }
+    }
+    return NULL;
+}
+
+// pause the video while it is not visible
+static void
+set_video_paused(struct session *s, bool paused) {
+    if (paused == s->video_paused) {
+        return;
+    }
+    s->video_paused = paused;
+
+    const struct scrcpy_options *options = &s->options;
+    if (options->shm_sink || options->v4l2_device) {
+        // the sinks still consume the decoded frames
+        return;
+    }
+
+    if (options->record_filename || options->replay_buffer
+            || !options->control) {
+        // the stream is still needed (or the encoder cannot be suspended),
+        // only skip the decoding and the rendering
+        struct stream *stream = options->preview_max_size ? &s->preview_stream
+                                                          : &s->stream;
+        stream_set_decoding_paused(stream, paused);
+    } else {
+        struct control_msg msg;
+        msg.type = CONTROL_MSG_TYPE_SET_VIDEO_PAUSED;
+        msg.set_video_paused.paused = paused;
+
+        if (!controller_push_msg(&s->controller, &msg)) {
+            LOGW("Could not request 'set video paused'");
+            return;
+        }
+    }
+
+    LOGI("Video %s", paused ? "paused" : "resumed");
+}
+
+static void
+handle_visibility_event(struct session *s, const SDL_WindowEvent *event) {
+    switch (event->event) {
+        case SDL_WINDOWEVENT_MINIMIZED:
+        case SDL_WINDOWEVENT_HIDDEN:
+            set_video_paused(s, true);
+            break;
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_MAXIMIZED: // may be restored directly maximized
+        case SDL_WINDOWEVENT_SHOWN:
+            set_video_paused(s, false);
+            break;
+    }
+}
+
 enum event_result {
     EVENT_RESULT_CONTINUE,
-    EVENT_RESULT_STOPPED_BY_USER,
     EVENT_RESULT_STOPPED_BY_EOS,
 };
 
+static bool session_start_reconnect(struct session *s);
+
 static enum event_result
-handle_event(SDL_Event *event, const struct scrcpy_options *options) {
+handle_event(struct session *s, SDL_Event *event) {
+    const struct scrcpy_options *options = &s->options;
     switch (event->type) {
         case EVENT_STREAM_STOPPED:
             LOGD("Video stream stopped");
             return EVENT_RESULT_STOPPED_BY_EOS;
-        case SDL_QUIT:
-            LOGD("User requested to quit");
-            return EVENT_RESULT_STOPPED_BY_USER;
+        case EVENT_STREAM_DISCONNECTED:
+            // the window, the decoder and the recorder are kept meanwhile
+            LOGW("Connection lost, reconnecting...");
+            if (!session_start_reconnect(s)) {
+                return EVENT_RESULT_STOPPED_BY_EOS;
+            }
+            break;
         case EVENT_NEW_FRAME:
-            if (!screen.has_frame) {
-                screen.has_frame = true;
+            if (!options->display) {
+                // the frames are only decoded for the sinks, drop them
+                if (video_buffer_consume_rendered_frame(&s->video_buffer)) {
+                    video_buffer_release_rendered_frame(&s->video_buffer);
+                }
+                break;
+            }
+            if (!s->screen.has_frame) {
+                s->screen.has_frame = true;
                 // this is the very first frame, show the window
-                screen_show_window(&screen);
+                screen_show_window(&s->screen);
+                int refresh_rate = screen_get_refresh_rate(&s->screen);
+                render_pacer_set_refresh_rate(&s->render_pacer, refresh_rate);
+            }
+            if (options->display_buffer) {
+                // the frame will be presented by the event loop, at its PTS
+                // (plus the buffering delay)
+                break;
+            }
+            if (options->render_pacing != SC_RENDER_PACING_IMMEDIATE) {
+                // the frame will be presented by the event loop, when due
+                render_pacer_frame_available(&s->render_pacer,
+                                             av_gettime_relative());
+                break;
             }
-            if (!screen_update_frame(&screen, &video_buffer)) {
+            if (!screen_update_frame(&s->screen, &s->video_buffer)) {
                 return EVENT_RESULT_CONTINUE;
             }
             break;
+        case EVENT_FRAME_SIZE_CHANGED:
+            screen_handle_frame_size_changed(&s->screen);
+            break;
+        case EVENT_WINDOW_SIZE_SETTLED:
+            if (s->resolution_adapter_initialized) {
+                resolution_adapter_apply(&s->resolution_adapter);
+            }
+            break;
         case SDL_WINDOWEVENT:
-            screen_handle_window_event(&screen, &event->window);
+            screen_handle_window_event(&s->screen, &event->window);
+            handle_visibility_event(s, &event->window);
+            if (s->resolution_adapter_initialized
+                    && event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                resolution_adapter_on_window_resized(&s->resolution_adapter);
+            }
+            if (event->window.event == SDL_WINDOWEVENT_MOVED) {
+                // the window may have moved to another display
+                int refresh_rate = screen_get_refresh_rate(&s->screen);
+                render_pacer_set_refresh_rate(&s->render_pacer, refresh_rate);
+            }
             break;
         case SDL_TEXTINPUT:
             if (!options->control) {
                 break;
             }
-            input_manager_process_text_input(&input_manager, &event->text);
+            input_manager_process_text_input(&s->input_manager, &event->text);
             break;
         case SDL_KEYDOWN:
         case SDL_KEYUP:
             // some key events do not interact with the device, so process the
             // event even if control is disabled
-            input_manager_process_key(&input_manager, &event->key);
+            input_manager_process_key(&s->input_manager, &event->key);
             break;
         case SDL_MOUSEMOTION:
             if (!options->control) {
                 break;
             }
-            input_manager_process_mouse_motion(&input_manager, &event->motion);
+            input_manager_process_mouse_motion(&s->input_manager,
+                                               &event->motion);
             break;
         case SDL_MOUSEWHEEL:
             if (!options->control) {
                 break;
             }
-            input_manager_process_mouse_wheel(&input_manager, &event->wheel);
+            input_manager_process_mouse_wheel(&s->input_manager,
+                                              &event->wheel);
             break;
         case SDL_MOUSEBUTTONDOWN:
         case SDL_MOUSEBUTTONUP:
             // some mouse events do not interact with the device, so process
             // the event even if control is disabled
-            input_manager_process_mouse_button(&input_manager, &event->button);
+            input_manager_process_mouse_button(&s->input_manager,
+                                               &event->button);
             break;
         case SDL_FINGERMOTION:
         case SDL_FINGERDOWN:
         case SDL_FINGERUP:
-            input_manager_process_touch(&input_manager, &event->tfinger);
+            input_manager_process_touch(&s->input_manager, &event->tfinger);
             break;
         case SDL_DROPFILE: {
             if (!options->control) {
@@ -236,29 +567,161 @@ handle_event(SDL_Event *event, const struct scrcpy_options *options) {
             } else {
                 action = ACTION_PUSH_FILE;
             }
-            file_handler_request(&file_handler, action, event->drop.file);
+            file_handler_request(&s->file_handler, action, event->drop.file);
             break;
         }
     }
     return EVENT_RESULT_CONTINUE;
 }
 
+static void session_destroy(struct session *s);
+
+// the delay (in microseconds) until the next pending frame of the session
+// must be presented, or -1 if there is none
+static int64_t
+get_session_present_delay(struct session *s, int64_t now) {
+    if (!s->options.display_buffer) {
+        return render_pacer_get_delay(&s->render_pacer, now);
+    }
+
+    // the frames are held in the video buffer until their deadline
+    int64_t pts;
+    int64_t offered;
+    if (!video_buffer_peek_next_frame(&s->video_buffer, &pts, &offered)) {
+        return -1;
+    }
+    if (pts == AV_NOPTS_VALUE) {
+        return 0;
+    }
+    int64_t deadline =
+        display_buffer_get_deadline(&s->display_buffer, pts, offered);
+    return deadline > now ? deadline - now : 0;
+}
+
+// the delay (in microseconds) until the next pending frame of any session
+// must be presented, or -1 if there is none
+static int64_t
+get_present_delay(struct session_list *sessions, int64_t now) {
+    int64_t delay = -1;
+    for (unsigned i = 0; i < sessions->count; ++i) {
+        struct session *s = &sessions->data[i];
+        if (!s->screen_initialized) {
+            continue;
+        }
+        int64_t d = get_session_present_delay(s, now);
+        if (d >= 0 && (delay < 0 || d < delay)) {
+            delay = d;
+        }
+    }
+    return delay;
+}
+
+static void
+present_due_frames(struct session_list *sessions) {
+    for (unsigned i = 0; i < sessions->count; ++i) {
+        struct session *s = &sessions->data[i];
+        if (s->screen_initialized
+                && !get_session_present_delay(s, av_gettime_relative())) {
+            // with vsync, this blocks until the next refresh
+            screen_update_frame(&s->screen, &s->video_buffer);
+            render_pacer_frame_presented(&s->render_pacer,
+                                         av_gettime_relative());
+        }
+    }
+}
+
+static void
+update_refresh_rates(struct session_list *sessions) {
+    int refresh_rate = compositor_get_refresh_rate(sessions->compositor);
+    for (unsigned i = 0; i < sessions->count; ++i) {
+        struct session *s = &sessions->data[i];
+        if (s->screen_initialized) {
+            render_pacer_set_refresh_rate(&s->render_pacer, refresh_rate);
+        }
+    }
+}
+
 static bool
-event_loop(const struct scrcpy_options *options) {
+event_loop(struct session_list *sessions) {
 #ifdef CONTINUOUS_RESIZING_WORKAROUND
-    if (options->display) {
-        SDL_AddEventWatch(event_watcher, NULL);
+    if (sessions->data[0].options.display) {
+        SDL_AddEventWatch(event_watcher, sessions);
     }
 #endif
+    unsigned running = sessions->count;
     SDL_Event event;
-    while (SDL_WaitEvent(&event)) {
-        enum event_result result = handle_event(&event, options);
+    for (;;) {
+        // wait for an event until the pending frame, if any, must be presented
+        int64_t delay = get_present_delay(sessions, av_gettime_relative());
+        if (sessions->compositor && sessions->compositor->render_requested) {
+            // render the tiles once all the pending events are processed
+            delay = 0;
+        }
+        bool has_event;
+        if (delay < 0) {
+            has_event = SDL_WaitEvent(&event);
+            if (!has_event) {
+                break;
+            }
+        } else if (delay == 0) {
+            // process all the pending events before presenting
+            has_event = SDL_PollEvent(&event);
+        } else {
+            // round up, to never wake up before the deadline
+            has_event = SDL_WaitEventTimeout(&event, (delay + 999) / 1000);
+        }
+
+        if (!has_event) {
+            present_due_frames(sessions);
+            if (sessions->compositor) {
+                // draw all the tiles updated meanwhile, and present once
+                compositor_render_if_requested(sessions->compositor);
+            }
+            continue;
+        }
+
+        if (event.type == SDL_QUIT) {
+            LOGD("User requested to quit");
+            return true;
+        }
+
+        if (sessions->compositor && event.type == SDL_WINDOWEVENT) {
+            compositor_handle_window_event(sessions->compositor,
+                                           &event.window);
+            for (unsigned i = 0; i < sessions->count; ++i) {
+                struct session *s = &sessions->data[i];
+                if (s->active) {
+                    // the tiles are visible only if the window is
+                    handle_visibility_event(s, &event.window);
+                }
+            }
+            if (event.window.event == SDL_WINDOWEVENT_MOVED) {
+                // the window may have moved to another display
+                update_refresh_rates(sessions);
+            }
+            continue;
+        }
+
+        struct session *s = find_event_session(sessions, &event);
+        if (!s || !s->active) {
+            // unrelated event, or late event from a destroyed session
+            continue;
+        }
+
+        enum event_result result = handle_event(s, &event);
         switch (result) {
-            case EVENT_RESULT_STOPPED_BY_USER:
-                return true;
             case EVENT_RESULT_STOPPED_BY_EOS:
-                LOGW("Device disconnected");
-                return false;
+                if (sessions->count == 1) {
+                    LOGW("Device disconnected");
+                    return false;
+                }
+                LOGW("Device disconnected: %s", s->options.serial);
+                // release it immediately, the other sessions continue
+                session_destroy(s);
+                if (!--running) {
+                    return false;
+                }
+                break;
             case EVENT_RESULT_CONTINUE:
                 break;
         }
@@ -302,30 +765,74 @@ av_log_callback(void *avcl, int level, const char *fmt, va_list vl) {
     SDL_free(local_fmt);
 }
 
-bool
-scrcpy(const struct scrcpy_options *options) {
-    if (!server_init(&server)) {
+static void
+session_init(struct session *s, const struct scrcpy_options *options,
+             const char *serial) {
+    s->options = *options;
+    s->options.serial = serial;
+
+    s->screen = (struct screen) SCREEN_INITIALIZER;
+    metrics_init(&s->metrics);
+
+    s->input_manager.controller = &s->controller;
+    s->input_manager.video_buffer = &s->video_buffer;
+    s->input_manager.screen = &s->screen;
+    s->input_manager.replay_buffer = NULL;
+    s->input_manager.file_handler = NULL;
+    s->input_manager.screenshot = NULL;
+    s->input_manager.repeat = 0;
+
+    s->connect_thread = NULL;
+    s->connected = false;
+    s->reconnect_thread = NULL;
+    atomic_init(&s->reconnect_interrupted, false);
+    s->active = false;
+    s->server_initialized = false;
+    s->server_started = false;
+    s->input_opened = false;
+    s->relay_socket = INVALID_SOCKET;
+    s->video_buffer_initialized = false;
+    s->file_handler_initialized = false;
+    s->recorder_initialized = false;
+    s->replay_buffer_initialized = false;
+    s->relay_initialized = false;
+    s->relay_started = false;
+    s->shm_sink_initialized = false;
+    s->v4l2_sink_initialized = false;
+    s->stream_started = false;
+    s->preview_stream_started = false;
+    s->controller_initialized = false;
+    s->controller_started = false;
+    s->screen_initialized = false;
+    s->screenshot_initialized = false;
+    s->screenshot_started = false;
+    s->resolution_adapter_initialized = false;
+    s->video_paused = false;
+}
+
+static bool
+session_start_server(struct session *s) {
+    const struct scrcpy_options *options = &s->options;
+    struct server *server = &s->server;
+
+    if (options->input || options->relay_connect) {
+        // no device, the video stream is read from the input or the relay
+        // (the server remains uninitialized, the session is still activated
+        // by session_connect())
+        return true;
+    }
+
+    if (!server_init(server)) {
         return false;
     }
+    s->server_initialized = true;
 
     if(options->device && options->url) {
-        server.url = SDL_strdup(options->url);
-        server.addr = net_addr(options->device);
-        server.direct = true;
+        server->url = SDL_strdup(options->url);
+        server->addr = net_addr(options->device);
+        server->direct = true;
     }
 
-    bool ret = false;
-
-    bool server_started = false;
-    bool fps_counter_initialized = false;
-    bool video_buffer_initialized = false;
-    bool file_handler_initialized = false;
-    bool recorder_initialized = false;
-    bool stream_started = false;
-    bool controller_initialized = false;
-    bool controller_started = false;
-
-    bool record = !!options->record_filename;
     struct server_params params = {
         .log_level = options->log_level,
         .crop = options->crop,
@@ -341,179 +848,831 @@ scrcpy(const struct scrcpy_options *options) {
         .codec_options = options->codec_options,
         .encoder_name = options->encoder_name,
         .force_adb_forward = options->force_adb_forward,
+        .preview_max_size = options->preview_max_size,
+        .preview_bit_rate =
+            options->preview_max_size ? options->preview_bit_rate : 0,
+        .video_recv_buffer = options->video_recv_buffer,
+        .video_transport = options->video_transport,
+        .video_codec = options->video_codec,
+        .encoder_profile = options->encoder_profile,
+        .daemon = options->server_daemon,
     };
-    if (!server_start(&server, options->serial, &params)) {
-        goto end;
+    if (!server_start(server, options->serial, &params)) {
+        return false;
     }
 
-    server_started = true;
+    s->server_started = true;
+    return true;
+}
 
-    if (!sdl_init_and_configure(options->display, options->render_driver,
-                                options->disable_screensaver)) {
-        goto end;
+static enum AVCodecID
+get_codec_id(enum sc_codec codec) {
+    switch (codec) {
+        case SC_CODEC_H264:
+            return AV_CODEC_ID_H264;
+        case SC_CODEC_H265:
+            return AV_CODEC_ID_HEVC;
+        case SC_CODEC_AV1:
+            return AV_CODEC_ID_AV1;
+        default:
+            assert(!"unexpected codec");
+            return AV_CODEC_ID_NONE;
     }
+}
 
-    if (!server_connect_to(&server)) {
-        goto end;
+// the video buffer must hold all the frames received during the buffering
+// delay (and a bit more, to absorb the jitter)
+static unsigned
+get_display_buffer_slot_count(const struct scrcpy_options *options) {
+    unsigned fps = options->max_fps ? options->max_fps : 60;
+    unsigned count = (options->display_buffer * fps + 999) / 1000 + 2;
+    if (count < options->frame_queue_size) {
+        count = options->frame_queue_size;
+    }
+    if (count > VIDEO_BUFFER_MAX_SLOTS) {
+        LOGW("Display buffer too large for %u fps, some frames may be "
+             "dropped", fps);
+        count = VIDEO_BUFFER_MAX_SLOTS;
+    }
+    return count;
+}
+
+// connect to the relay of another client (--relay-connect), and read the
+// device info and the codec of the stream
+static bool
+session_connect_relay(struct session *s) {
+    const char *address = s->options.relay_connect;
+    // the format "ip:port" has been validated by the command line parser
+    const char *colon = strrchr(address, ':');
+    assert(colon);
+
+    char ip[16]; // "xxx.xxx.xxx.xxx"
+    size_t len = colon - address;
+    if (len >= sizeof(ip)) {
+        LOGE("Invalid relay address: %s", address);
+        return false;
+    }
+    memcpy(ip, address, len);
+    ip[len] = '\0';
+    uint16_t port = (uint16_t) strtol(colon + 1, NULL, 10);
+
+    s->relay_socket = net_connect(net_addr(ip), port);
+    if (s->relay_socket == INVALID_SOCKET) {
+        LOGE("Could not connect to relay %s", address);
+        return false;
+    }
+
+    // the codec is chosen by the owner of the relay
+    return relay_read_info(s->relay_socket, s->device_name, &s->frame_size,
+                           &s->options.video_codec);
+}
+
+// read the device name and the frame size (from the server, from the relay,
+// or from the first SPS of the --input)
+static bool
+session_connect_device(struct session *s) {
+    const struct scrcpy_options *options = &s->options;
+
+    if (options->input) {
+        if (!annexb_input_open(&s->input, options->input)) {
+            return false;
+        }
+        s->input_opened = true;
+
+        if (!annexb_input_read_frame_size(&s->input, &s->frame_size)) {
+            return false;
+        }
+        snprintf(s->device_name, sizeof(s->device_name), "%s",
+                 options->input);
+    } else if (options->relay_connect) {
+        if (!session_connect_relay(s)) {
+            return false;
+        }
+    } else {
+        if (!server_connect_to(&s->server)) {
+            return false;
+        }
+
+        // screenrecord does not send frames when the screen content does not
+        // change therefore, we transmit the screen size before the video
+        // stream, to be able to init the window immediately
+        if (!device_read_info(s->server.video_socket, s->device_name,
+                              &s->frame_size)) {
+            return false;
+        }
+    }
+
+    s->display_size = s->frame_size;
+    if (options->preview_max_size
+            && !device_read_preview_size(s->server.preview_socket,
+                                         &s->display_size)) {
+        return false;
+    }
+
+    return true;
+}
+
+static int
+run_connect(void *data) {
+    struct session *s = data;
+    s->connected = session_start_server(s) && session_connect_device(s);
+    return 0;
+}
+
+static bool
+session_start_connect(struct session *s) {
+    s->connect_thread = SDL_CreateThread(run_connect, "connect", s);
+    if (!s->connect_thread) {
+        LOGC("Could not start connection thread");
+        return false;
+    }
+    return true;
+}
+
+// return false if the connection failed
+static bool
+session_join_connect(struct session *s) {
+    if (s->connect_thread) {
+        SDL_WaitThread(s->connect_thread, NULL);
+        s->connect_thread = NULL;
+    }
+    return s->connected;
+}
+
+// the reconnection attempts are abandoned after this delay
+#define RECONNECT_TIMEOUT_US (30 * 1000000)
+#define RECONNECT_RETRY_DELAY_MS 100
+
+// restart the server and read the device info again (the other fields are
+// the same as on the first connection)
+static bool
+session_reconnect_device(struct session *s) {
+    if (!server_restart(&s->server)) {
+        return false;
     }
+    s->server_started = true;
 
     char device_name[DEVICE_NAME_FIELD_LENGTH];
-    struct size frame_size;
+    struct size frame_size; // any change is handled by the decoder
+    if (!server_connect_to(&s->server)
+            || !device_read_info(s->server.video_socket, device_name,
+                                 &frame_size)) {
+        server_stop(&s->server);
+        s->server_started = false;
+        return false;
+    }
 
-    // screenrecord does not send frames when the screen content does not
-    // change therefore, we transmit the screen size before the video stream,
-    // to be able to init the window immediately
-    if (!device_read_info(server.video_socket, device_name, &frame_size)) {
-        goto end;
+    return true;
+}
+
+static int
+run_reconnect(void *data) {
+    struct session *s = data;
+    int64_t start = av_gettime_relative();
+
+    // the controller must not write to the sockets once they are closed
+    bool controller = s->controller_started;
+    if (controller) {
+        controller_stop(&s->controller);
+    }
+    server_stop(&s->server);
+    s->server_started = false;
+    if (controller) {
+        controller_join(&s->controller);
+        s->controller_started = false;
+    }
+
+    bool ok = false;
+    for (;;) {
+        if (atomic_load(&s->reconnect_interrupted)) {
+            break;
+        }
+        if (session_reconnect_device(s)) {
+            ok = true;
+            break;
+        }
+        if (av_gettime_relative() - start >= RECONNECT_TIMEOUT_US) {
+            LOGE("Could not reconnect to the device");
+            break;
+        }
+        // typically, the device is not visible by adb yet
+        SDL_Delay(RECONNECT_RETRY_DELAY_MS);
+    }
+
+    if (ok && controller) {
+        ok = controller_restart(&s->controller, s->server.control_socket);
+        s->controller_started = ok;
+    }
+
+    if (!ok) {
+        // the stream thread reports the end of stream
+        stream_stop(&s->stream);
+        return 0;
     }
 
+    stream_resume(&s->stream, s->server.video_socket,
+                  s->server.video_dgram_socket);
+    LOGI("Reconnected in %" PRId64 " ms",
+         (av_gettime_relative() - start) / 1000);
+    return 0;
+}
+
+static bool
+session_start_reconnect(struct session *s) {
+    if (s->reconnect_thread) {
+        // the previous reconnection has succeeded, it is terminated
+        SDL_WaitThread(s->reconnect_thread, NULL);
+    }
+
+    s->reconnect_thread = SDL_CreateThread(run_reconnect, "reconnect", s);
+    if (!s->reconnect_thread) {
+        LOGC("Could not start reconnection thread");
+        return false;
+    }
+    return true;
+}
+
+static void
+session_join_reconnect(struct session *s) {
+    if (s->reconnect_thread) {
+        // abandon the next attempts
+        atomic_store(&s->reconnect_interrupted, true);
+        SDL_WaitThread(s->reconnect_thread, NULL);
+        s->reconnect_thread = NULL;
+    }
+}
+
+// create the window and the renderer, before the device is connected
+static bool
+session_init_window(struct session *s) {
+    const struct scrcpy_options *options = &s->options;
+    // the device name is not known yet
+    const char *window_title =
+        options->window_title ? options->window_title : "scrcpy";
+
+    struct screen_params params = {
+        .window_title = window_title,
+        .always_on_top = options->always_on_top,
+        .window_x = options->window_x,
+        .window_y = options->window_y,
+        .window_width = options->window_width,
+        .window_height = options->window_height,
+        .window_borderless = options->window_borderless,
+        .mipmaps = options->mipmaps,
+        .upscaler = options->upscale_filter == SC_UPSCALE_FILTER_LANCZOS,
+        .vsync = options->render_pacing != SC_RENDER_PACING_IMMEDIATE,
+        .render_thread = options->render_thread,
+    };
+    if (!screen_init_rendering(&s->screen, &params)) {
+        return false;
+    }
+    s->screen_initialized = true;
+    return true;
+}
+
+static bool
+session_connect(struct session *s, struct decoder_pool *pool,
+                struct compositor *compositor) {
+    const struct scrcpy_options *options = &s->options;
+    bool record = !!options->record_filename;
+    enum AVCodecID codec_id = get_codec_id(options->video_codec);
+
+    struct size frame_size = s->frame_size;
+    struct size display_size = s->display_size;
+    bool preview = options->preview_max_size;
+
     struct decoder *dec = NULL;
-    if (options->display) {
-        if (!fps_counter_init(&fps_counter)) {
-            goto end;
+    // without display, the frames may still be decoded for a v4l2 sink
+    bool decode = options->display || options->v4l2_device;
+    if (decode) {
+        fps_counter_init(&s->fps_counter, &s->metrics);
+
+        render_pacer_init(&s->render_pacer,
+                          options->render_pacing == SC_RENDER_PACING_SMOOTH);
+
+        // the display buffer presents every frame in order
+        bool render_expired_frames = options->render_expired_frames
+                                  || options->display_buffer;
+        unsigned slot_count = options->frame_queue_size;
+        if (options->display_buffer) {
+            display_buffer_init(&s->display_buffer,
+                                (int64_t) options->display_buffer * 1000);
+            slot_count = get_display_buffer_slot_count(options);
         }
-        fps_counter_initialized = true;
 
-        if (!video_buffer_init(&video_buffer, &fps_counter,
-                               options->render_expired_frames)) {
-            goto end;
+        if (!video_buffer_init(&s->video_buffer, &s->fps_counter,
+                               &s->metrics, render_expired_frames,
+                               slot_count)) {
+            return false;
         }
-        video_buffer_initialized = true;
+        s->video_buffer_initialized = true;
 
-        if (options->control) {
-            if (!file_handler_init(&file_handler, server.serial,
-                                   options->push_target)) {
-                goto end;
+        if (options->display && options->control) {
+            if (!file_handler_init(&s->file_handler, s->server.serial,
+                                   options->push_target,
+                                   options->file_transfer_workers)) {
+                return false;
             }
-            file_handler_initialized = true;
+            s->file_handler_initialized = true;
+            s->input_manager.file_handler = &s->file_handler;
         }
 
-        decoder_init(&decoder, &video_buffer);
-        dec = &decoder;
+        unsigned decoder_threads = options->decoder_threads;
+        if (pool && !decoder_threads) {
+            // the pool already decodes the devices in parallel, do not start
+            // a set of FFmpeg threads per device
+            decoder_threads = 1;
+        }
+        struct shm_sink *shm = NULL;
+        if (options->shm_sink) {
+            if (!shm_sink_init(&s->shm_sink, options->shm_sink, frame_size)) {
+                return false;
+            }
+            s->shm_sink_initialized = true;
+            shm = &s->shm_sink;
+        }
+
+        struct v4l2_sink *v4l2 = NULL;
+#ifdef HAVE_V4L2
+        if (options->v4l2_device) {
+            if (!v4l2_sink_init(&s->v4l2_sink, options->v4l2_device)) {
+                return false;
+            }
+            s->v4l2_sink_initialized = true;
+            v4l2 = &s->v4l2_sink;
+        }
+#endif
+
+        decoder_init(&s->decoder, &s->video_buffer, shm, v4l2,
+                     options->hw_decoder, decoder_threads,
+                     options->decoder_thread_type, pool);
+        dec = &s->decoder;
     }
 
     struct recorder *rec = NULL;
     if (record) {
-        if (!recorder_init(&recorder,
+        if (!recorder_init(&s->recorder,
                            options->record_filename,
                            options->record_format,
-                           frame_size)) {
-            goto end;
+                           frame_size,
+                           options->record_queue_size,
+                           options->record_queue_policy,
+                           (uint64_t) options->record_segment * 1000000,
+                           options->record_fragmented,
+                           options->record_buffer_size, &s->metrics)) {
+            return false;
         }
-        rec = &recorder;
-        recorder_initialized = true;
+        rec = &s->recorder;
+        s->recorder_initialized = true;
     }
 
-    av_log_set_callback(av_log_callback);
+    struct replay_buffer *replay = NULL;
+    if (options->replay_buffer) {
+        uint64_t duration = (uint64_t) options->replay_buffer * 1000000;
+        // twice the expected size, to absorb bit rate peaks
+        size_t max_bytes = (uint64_t) options->replay_buffer
+                         * (options->bit_rate / 8) * 2;
+        if (!replay_buffer_init(&s->replay_buffer, codec_id, frame_size,
+                                duration, max_bytes)) {
+            return false;
+        }
+        replay = &s->replay_buffer;
+        s->replay_buffer_initialized = true;
+    }
 
-    stream_init(&stream, server.video_socket, dec, rec);
+    clock_sync_init(&s->clock_sync);
+
+    // the controller must be started before the stream, which may send
+    // control messages (to request a key frame or to adapt the bit rate)
+    struct controller *ctrl = NULL;
+    if (options->display && options->control) {
+        if (!controller_init(&s->controller, s->server.control_socket,
+                             &s->clock_sync, &s->metrics,
+                             options->control_queue_size,
+                             options->input_resampling,
+                             options->pointer_prediction)) {
+            return false;
+        }
+        s->controller_initialized = true;
+
+        if (!controller_start(&s->controller)) {
+            return false;
+        }
+        s->controller_started = true;
+        ctrl = &s->controller;
+    }
+
+    // the late joiners of the relay request key frames through the
+    // controller
+    if (options->relay_port) {
+        if (!relay_init(&s->relay, options->relay_port, s->device_name,
+                        frame_size, options->video_codec, ctrl)) {
+            return false;
+        }
+        s->relay_initialized = true;
+
+        if (!relay_start(&s->relay)) {
+            return false;
+        }
+        s->relay_started = true;
+    }
+
+    // with a preview stream, the main stream is never decoded
+    socket_t video_socket;
+    if (options->input) {
+        video_socket = INVALID_SOCKET;
+    } else if (options->relay_connect) {
+        video_socket = s->relay_socket;
+    } else {
+        video_socket = s->server.video_socket;
+    }
+    stream_init(&s->stream, video_socket, codec_id,
+                preview ? NULL : dec, rec, replay, &s->clock_sync, ctrl,
+                &s->metrics, options->adaptive_bit_rate, options->bit_rate);
+    if (options->input) {
+        stream_use_annexb_input(&s->stream, &s->input);
+    } else if (!options->relay_connect
+            && s->server.video_dgram_socket != INVALID_SOCKET) {
+        stream_use_datagrams(&s->stream, s->server.video_dgram_socket);
+    }
+    if (s->relay_started) {
+        stream_use_relay(&s->stream, &s->relay);
+    }
+    if (options->reconnect && !stream_enable_reconnect(&s->stream)) {
+        return false;
+    }
 
     // now we consumed the header values, the socket receives the video stream
     // start the stream
-    if (!stream_start(&stream)) {
-        goto end;
+    if (!stream_start(&s->stream)) {
+        return false;
+    }
+    s->stream_started = true;
+
+    if (preview) {
+        // the bit rate of the preview stream is not adapted: the controller
+        // only changes the bit rate of the main encoder
+        stream_init(&s->preview_stream, s->server.preview_socket, codec_id,
+                    dec, NULL, NULL, &s->clock_sync, ctrl, &s->metrics,
+                    false, options->preview_bit_rate);
+        if (!stream_start(&s->preview_stream)) {
+            return false;
+        }
+        s->preview_stream_started = true;
     }
-    stream_started = true;
 
     if (options->display) {
-        if (options->control) {
-            if (!controller_init(&controller, server.control_socket)) {
-                goto end;
-            }
-            controller_initialized = true;
+        const char *window_title =
+            options->window_title ? options->window_title : s->device_name;
 
-            if (!controller_start(&controller)) {
-                goto end;
+        if (compositor) {
+            if (!screen_init_tile(&s->screen, compositor, display_size,
+                                  options->rotation)) {
+                return false;
             }
-            controller_started = true;
+            s->screen_initialized = true;
+        } else {
+            // the window and the renderer are already initialized
+            assert(s->screen_initialized);
+            screen_init_content(&s->screen, window_title, display_size,
+                                options->window_width, options->window_height,
+                                options->rotation);
         }
 
-        const char *window_title =
-            options->window_title ? options->window_title : device_name;
-
-        if (!screen_init_rendering(&screen, window_title, frame_size,
-                                   options->always_on_top, options->window_x,
-                                   options->window_y, options->window_width,
-                                   options->window_height,
-                                   options->window_borderless,
-                                   options->rotation, options->mipmaps)) {
-            goto end;
+        if (!screenshot_init(&s->screenshot, options->screenshot_format,
+                             options->screenshot_dir)) {
+            return false;
+        }
+        s->screenshot_initialized = true;
+
+        if (!screenshot_start(&s->screenshot)) {
+            return false;
         }
+        s->screenshot_started = true;
+        s->screen.screenshot = &s->screenshot;
+        s->input_manager.screenshot = &s->screenshot;
 
         if (options->turn_screen_off) {
             struct control_msg msg;
             msg.type = CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE;
             msg.set_screen_power_mode.mode = SCREEN_POWER_MODE_OFF;
 
-            if (!controller_push_msg(&controller, &msg)) {
+            if (!controller_push_msg(&s->controller, &msg)) {
                 LOGW("Could not request 'set screen power mode'");
             }
         }
 
         if (options->fullscreen) {
-            screen_switch_fullscreen(&screen);
+            screen_switch_fullscreen(&s->screen);
+        }
+
+        if (options->adaptive_resolution) {
+            s->screen.keep_window_size = true;
+            resolution_adapter_init(&s->resolution_adapter, &s->screen,
+                                    &s->controller, options->max_size);
+            s->resolution_adapter_initialized = true;
+            // adapt to the initial window size (possibly given by
+            // --window-width and --window-height)
+            resolution_adapter_on_window_resized(&s->resolution_adapter);
         }
     }
 
-    input_manager_init(&input_manager, options);
+    s->input_manager.replay_buffer = replay;
+    input_manager_init(&s->input_manager, options);
 
-    ret = event_loop(options);
-    LOGD("quit...");
+    s->active = true;
+    return true;
+}
 
-    screen_destroy(&screen);
+// release everything that has been initialized (may be called several times)
+static void
+session_destroy(struct session *s) {
+    // its late events are ignored
+    s->active = false;
+
+    // the connection thread initializes the server and the input
+    session_join_connect(s);
+    // the reconnection thread restarts the server and the controller
+    session_join_reconnect(s);
+
+    if (s->resolution_adapter_initialized) {
+        resolution_adapter_destroy(&s->resolution_adapter);
+        s->resolution_adapter_initialized = false;
+    }
+
+    if (s->screen_initialized) {
+        screen_destroy(&s->screen);
+        s->screen_initialized = false;
+    }
+
+    // the renderer is stopped, no more frames are captured
+    if (s->screenshot_started) {
+        screenshot_stop(&s->screenshot);
+        screenshot_join(&s->screenshot);
+        s->screenshot_started = false;
+    }
+    if (s->screenshot_initialized) {
+        screenshot_destroy(&s->screenshot);
+        s->screenshot_initialized = false;
+    }
 
-end:
     // stop stream and controller so that they don't continue once their socket
     // is shutdown
-    if (stream_started) {
-        stream_stop(&stream);
+    if (s->stream_started) {
+        stream_stop(&s->stream);
+    }
+    if (s->preview_stream_started) {
+        stream_stop(&s->preview_stream);
     }
-    if (controller_started) {
-        controller_stop(&controller);
+    if (s->relay_started) {
+        relay_stop(&s->relay);
     }
-    if (file_handler_initialized) {
-        file_handler_stop(&file_handler);
+    if (s->controller_started) {
+        controller_stop(&s->controller);
     }
-    if (fps_counter_initialized) {
-        fps_counter_interrupt(&fps_counter);
+    if (s->file_handler_initialized) {
+        file_handler_stop(&s->file_handler);
     }
 
-    if (server_started) {
+    if (s->server_started) {
         // shutdown the sockets and kill the server
-        server_stop(&server);
+        server_stop(&s->server);
+        s->server_started = false;
+    }
+    if (s->relay_socket != INVALID_SOCKET) {
+        net_shutdown(s->relay_socket, SHUT_RDWR);
     }
 
     // now that the sockets are shutdown, the stream and controller are
     // interrupted, we can join them
-    if (stream_started) {
-        stream_join(&stream);
+    if (s->stream_started) {
+        stream_join(&s->stream);
+        s->stream_started = false;
+    }
+    if (s->preview_stream_started) {
+        stream_join(&s->preview_stream);
+        s->preview_stream_started = false;
+    }
+    if (s->input_opened) {
+        annexb_input_close(&s->input);
+        s->input_opened = false;
+    }
+    if (s->relay_socket != INVALID_SOCKET) {
+        net_close(s->relay_socket);
+        s->relay_socket = INVALID_SOCKET;
+    }
+    // the relay may request key frames until it is joined
+    if (s->relay_started) {
+        relay_join(&s->relay);
+        s->relay_started = false;
+    }
+    if (s->relay_initialized) {
+        relay_destroy(&s->relay);
+        s->relay_initialized = false;
+    }
+    if (s->controller_started) {
+        controller_join(&s->controller);
+        s->controller_started = false;
+    }
+    if (s->controller_initialized) {
+        controller_destroy(&s->controller);
+        s->controller_initialized = false;
+    }
+
+    if (s->recorder_initialized) {
+        recorder_destroy(&s->recorder);
+        s->recorder_initialized = false;
+    }
+
+    if (s->replay_buffer_initialized) {
+        replay_buffer_destroy(&s->replay_buffer);
+        s->replay_buffer_initialized = false;
+    }
+
+    if (s->shm_sink_initialized) {
+        shm_sink_destroy(&s->shm_sink);
+        s->shm_sink_initialized = false;
+    }
+
+#ifdef HAVE_V4L2
+    if (s->v4l2_sink_initialized) {
+        v4l2_sink_destroy(&s->v4l2_sink);
+        s->v4l2_sink_initialized = false;
+    }
+#endif
+
+    if (s->file_handler_initialized) {
+        file_handler_join(&s->file_handler);
+        file_handler_destroy(&s->file_handler);
+        s->file_handler_initialized = false;
+    }
+
+    if (s->video_buffer_initialized) {
+        video_buffer_destroy(&s->video_buffer);
+        s->video_buffer_initialized = false;
+    }
+
+    if (s->server_initialized) {
+        server_destroy(&s->server);
+        s->server_initialized = false;
+    }
+}
+
+bool
+scrcpy(const struct scrcpy_options *options) {
+    // before any traced thread is started
+    bool trace_started = false;
+    if (options->trace_filename) {
+        if (!trace_init(options->trace_filename)) {
+            return false;
+        }
+        trace_started = true;
+    }
+
+    // one session per device
+    struct session_list sessions;
+    sessions.count = options->serials.count ? options->serials.count : 1;
+    sessions.data = SDL_malloc(sessions.count * sizeof(*sessions.data));
+    if (!sessions.data) {
+        LOGC("Could not allocate sessions");
+        if (trace_started) {
+            trace_destroy();
+        }
+        return false;
     }
-    if (controller_started) {
-        controller_join(&controller);
+
+    for (unsigned i = 0; i < sessions.count; ++i) {
+        session_init(&sessions.data[i], options,
+                     options->serials.count ? options->serials.data[i]
+                                            : options->serial);
     }
-    if (controller_initialized) {
-        controller_destroy(&controller);
+
+    bool ret = false;
+
+    struct decoder_pool decoder_pool;
+    bool decoder_pool_started = false;
+    sessions.decoder_pool = NULL;
+
+    struct compositor compositor;
+    sessions.compositor = NULL;
+
+    struct metrics_server metrics_server;
+    bool metrics_server_started = false;
+
+    av_log_set_callback(av_log_callback);
+
+    // push and start the servers, and connect to them, while SDL and the
+    // renderers are initialized (both may take hundreds of milliseconds)
+    for (unsigned i = 0; i < sessions.count; ++i) {
+        if (!session_start_connect(&sessions.data[i])) {
+            goto end;
+        }
     }
 
-    if (recorder_initialized) {
-        recorder_destroy(&recorder);
+    if (!sdl_init_and_configure(options->display, options->render_driver,
+                                options->disable_screensaver)) {
+        goto end;
     }
 
-    if (file_handler_initialized) {
-        file_handler_join(&file_handler);
-        file_handler_destroy(&file_handler);
+    if (options->metrics_port) {
+        struct metrics_source *sources =
+            SDL_malloc(sessions.count * sizeof(*sources));
+        if (!sources) {
+            LOGC("Could not allocate metrics sources");
+            goto end;
+        }
+        for (unsigned i = 0; i < sessions.count; ++i) {
+            sources[i].serial = sessions.data[i].options.serial;
+            sources[i].metrics = &sessions.data[i].metrics;
+        }
+        bool ok = metrics_server_init(&metrics_server, options->metrics_port,
+                                      sources, sessions.count);
+        SDL_free(sources);
+        if (!ok) {
+            goto end;
+        }
+        if (!metrics_server_start(&metrics_server)) {
+            metrics_server_destroy(&metrics_server);
+            goto end;
+        }
+        metrics_server_started = true;
     }
 
-    if (video_buffer_initialized) {
-        video_buffer_destroy(&video_buffer);
+    // with several devices, the decoding is shared by a pool of workers
+    // (sized to the core count), rather than done by each stream thread
+    if (sessions.count > 1 && options->display) {
+        if (!decoder_pool_init(&decoder_pool, 0)) {
+            goto end;
+        }
+        if (!decoder_pool_start(&decoder_pool)) {
+            decoder_pool_destroy(&decoder_pool);
+            goto end;
+        }
+        decoder_pool_started = true;
+        sessions.decoder_pool = &decoder_pool;
+    }
+
+    if (options->tile) {
+        const char *window_title =
+            options->window_title ? options->window_title : "scrcpy";
+        if (!compositor_init(&compositor, window_title, sessions.count,
+                             options->window_width, options->window_height,
+                             options->always_on_top,
+                             options->window_borderless, options->mipmaps,
+                             options->render_pacing
+                                != SC_RENDER_PACING_IMMEDIATE)) {
+            goto end;
+        }
+        sessions.compositor = &compositor;
+    } else if (options->display) {
+        for (unsigned i = 0; i < sessions.count; ++i) {
+            if (!session_init_window(&sessions.data[i])) {
+                goto end;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < sessions.count; ++i) {
+        if (!session_join_connect(&sessions.data[i])) {
+            goto end;
+        }
     }
 
-    if (fps_counter_initialized) {
-        fps_counter_join(&fps_counter);
-        fps_counter_destroy(&fps_counter);
+    for (unsigned i = 0; i < sessions.count; ++i) {
+        if (!session_connect(&sessions.data[i], sessions.decoder_pool,
+                             sessions.compositor)) {
+            goto end;
+        }
     }
 
-    server_destroy(&server);
+    ret = event_loop(&sessions);
+    LOGD("quit...");
+
+end:
+    for (unsigned i = 0; i < sessions.count; ++i) {
+        session_destroy(&sessions.data[i]);
+    }
+    if (sessions.compositor) {
+        // all the tiles have been released
+        compositor_destroy(sessions.compositor);
+    }
+    if (decoder_pool_started) {
+        // all the decoders have been closed
+        decoder_pool_stop(&decoder_pool);
+        decoder_pool_join(&decoder_pool);
+        decoder_pool_destroy(&decoder_pool);
+    }
+    if (metrics_server_started) {
+        // the metrics are owned by the sessions
+        metrics_server_stop(&metrics_server);
+        metrics_server_join(&metrics_server);
+        metrics_server_destroy(&metrics_server);
+    }
+    if (trace_started) {
+        // all the traced threads have been joined
+        trace_destroy();
+    }
+    SDL_free(sessions.data);
 
     return ret;
 }
@@ -20,6 +20,59 @@ enum sc_record_format {
     SC_RECORD_FORMAT_MKV,
 };
 
+enum sc_screenshot_format {
+    SC_SCREENSHOT_FORMAT_PNG, // lossless
+    SC_SCREENSHOT_FORMAT_JPEG,
+};
+
+enum sc_upscale_filter {
+    SC_UPSCALE_FILTER_LINEAR, // by SDL
+    SC_UPSCALE_FILTER_LANCZOS, // by a shader
+};
+
+// what to do when the recorder queue is full
+enum sc_record_queue_policy {
+    SC_RECORD_QUEUE_POLICY_BLOCK, // wait, so that the stream is throttled
+    SC_RECORD_QUEUE_POLICY_DROP, // drop packets until the next key frame
+    SC_RECORD_QUEUE_POLICY_FAIL, // stop the recording
+};
+
+enum sc_hw_decoder {
+    SC_HW_DECODER_NONE, // software decoding
+    SC_HW_DECODER_AUTO,
+    SC_HW_DECODER_VAAPI,
+    SC_HW_DECODER_D3D11VA,
+    SC_HW_DECODER_VIDEOTOOLBOX,
+    SC_HW_DECODER_CUDA,
+};
+
+enum sc_decoder_thread_type {
+    SC_DECODER_THREAD_TYPE_SLICE,
+    SC_DECODER_THREAD_TYPE_FRAME,
+};
+
+enum sc_render_pacing {
+    SC_RENDER_PACING_IMMEDIATE, // render each frame as soon as it is decoded
+    SC_RENDER_PACING_VSYNC,
+    SC_RENDER_PACING_SMOOTH, // vsync with frame time smoothing
+};
+
+enum sc_video_transport {
+    SC_VIDEO_TRANSPORT_TCP,
+    SC_VIDEO_TRANSPORT_UDP, // datagrams, in direct mode only
+};
+
+enum sc_codec {
+    SC_CODEC_H264,
+    SC_CODEC_H265,
+    SC_CODEC_AV1,
+};
+
+enum sc_encoder_profile {
+    SC_ENCODER_PROFILE_QUALITY, // the encoder defaults
+    SC_ENCODER_PROFILE_LATENCY,
+};
+
 #define SC_MAX_SHORTCUT_MODS 8
 
 enum sc_shortcut_mod {
@@ -41,25 +94,59 @@ struct sc_port_range {
     uint16_t last;
 };
 
+// maximum number of devices mirrored by a single process
+#define SC_MAX_SESSIONS 64
+
+struct sc_serials {
+    const char *data[SC_MAX_SESSIONS];
+    unsigned count;
+};
+
 #define SC_WINDOW_POSITION_UNDEFINED (-0x8000)
 
 struct scrcpy_options {
-    const char *serial;
+    const char *serial; // the first serial, NULL if none
+    struct sc_serials serials; // all the serials, if several are given
     const char *device;
     const char *url;
+    // a raw H.264 Annex B stream to display instead of a device ("-" for
+    // stdin), NULL if disabled
+    const char *input;
+    // the address of a relay to watch instead of a device ("ip:port"), NULL
+    // if disabled
+    const char *relay_connect;
     const char *crop;
     const char *record_filename;
+    const char *shm_sink; // the shared memory name, NULL if disabled
+    // the V4L2 output device, NULL if disabled (only set with HAVE_V4L2)
+    const char *v4l2_device;
     const char *window_title;
     const char *push_target;
+    const char *screenshot_dir; // NULL for the current directory
+    const char *trace_filename; // NULL to disable
     const char *render_driver;
     const char *codec_options;
     const char *encoder_name;
     enum sc_log_level log_level;
     enum sc_record_format record_format;
+    enum sc_record_queue_policy record_queue_policy;
+    enum sc_screenshot_format screenshot_format;
+    enum sc_upscale_filter upscale_filter;
+    enum sc_hw_decoder hw_decoder;
+    enum sc_decoder_thread_type decoder_thread_type;
+    enum sc_render_pacing render_pacing;
+    enum sc_video_transport video_transport;
+    enum sc_codec video_codec;
+    enum sc_encoder_profile encoder_profile;
     struct sc_port_range port_range;
     struct sc_shortcut_mods shortcut_mods;
     uint16_t max_size;
     uint32_t bit_rate;
+    uint16_t preview_max_size; // 0 to disable the preview stream
+    uint32_t preview_bit_rate;
+    uint32_t video_recv_buffer; // 0 for the system default
+    uint32_t record_segment; // in seconds, 0 for a single file
+    uint32_t record_buffer_size; // in bytes, 0 to disable write-behind
     uint16_t max_fps;
     int8_t lock_video_orientation;
     uint8_t rotation;
@@ -68,6 +155,15 @@ struct scrcpy_options {
     uint16_t window_width;
     uint16_t window_height;
     uint16_t display_id;
+    uint16_t control_queue_size;
+    uint16_t record_queue_size;
+    uint16_t replay_buffer; // in seconds, 0 to disable
+    uint16_t display_buffer; // in milliseconds, 0 to disable
+    uint16_t metrics_port; // 0 to disable
+    uint16_t relay_port; // 0 to disable
+    uint8_t frame_queue_size;
+    uint8_t file_transfer_workers;
+    uint8_t decoder_threads; // 0 for automatic
     bool show_touches;
     bool fullscreen;
     bool always_on_top;
@@ -83,20 +179,48 @@ struct scrcpy_options {
     bool disable_screensaver;
     bool forward_key_repeat;
     bool forward_all_clicks;
+    bool input_resampling;
+    bool pointer_prediction;
     bool legacy_paste;
+    bool adaptive_bit_rate;
+    bool adaptive_resolution;
+    bool render_thread;
+    bool record_fragmented;
+    bool tile;
+    bool reconnect;
+    bool server_daemon;
 };
 
 #define SCRCPY_OPTIONS_DEFAULT { \
     .serial = NULL, \
+    .serials = { \
+        .data = {NULL}, \
+        .count = 0, \
+    }, \
+    .input = NULL, \
+    .relay_connect = NULL, \
     .crop = NULL, \
     .record_filename = NULL, \
+    .shm_sink = NULL, \
+    .v4l2_device = NULL, \
     .window_title = NULL, \
     .push_target = NULL, \
+    .screenshot_dir = NULL, \
+    .trace_filename = NULL, \
     .render_driver = NULL, \
     .codec_options = NULL, \
     .encoder_name = NULL, \
     .log_level = SC_LOG_LEVEL_INFO, \
     .record_format = SC_RECORD_FORMAT_AUTO, \
+    .record_queue_policy = SC_RECORD_QUEUE_POLICY_BLOCK, \
+    .screenshot_format = SC_SCREENSHOT_FORMAT_PNG, \
+    .upscale_filter = SC_UPSCALE_FILTER_LINEAR, \
+    .hw_decoder = SC_HW_DECODER_NONE, \
+    .decoder_thread_type = SC_DECODER_THREAD_TYPE_SLICE, \
+    .render_pacing = SC_RENDER_PACING_IMMEDIATE, \
+    .video_transport = SC_VIDEO_TRANSPORT_TCP, \
+    .video_codec = SC_CODEC_H264, \
+    .encoder_profile = SC_ENCODER_PROFILE_QUALITY, \
     .port_range = { \
         .first = DEFAULT_LOCAL_PORT_RANGE_FIRST, \
         .last = DEFAULT_LOCAL_PORT_RANGE_LAST, \
@@ -107,6 +231,11 @@ struct scrcpy_options {
     }, \
     .max_size = DEFAULT_MAX_SIZE, \
     .bit_rate = DEFAULT_BIT_RATE, \
+    .preview_max_size = 0, \
+    .preview_bit_rate = 2000000, \
+    .video_recv_buffer = 0, \
+    .record_segment = 0, \
+    .record_buffer_size = 4 * 1024 * 1024, \
     .max_fps = 0, \
     .lock_video_orientation = DEFAULT_LOCK_VIDEO_ORIENTATION, \
     .rotation = 0, \
@@ -115,6 +244,15 @@ struct scrcpy_options {
     .window_width = 0, \
     .window_height = 0, \
     .display_id = 0, \
+    .control_queue_size = 256, \
+    .record_queue_size = 1024, \
+    .replay_buffer = 0, \
+    .display_buffer = 0, \
+    .metrics_port = 0, \
+    .relay_port = 0, \
+    .frame_queue_size = 3, \
+    .file_transfer_workers = 1, \
+    .decoder_threads = 0, \
     .show_touches = false, \
     .fullscreen = false, \
     .always_on_top = false, \
@@ -130,7 +268,16 @@ struct scrcpy_options {
     .disable_screensaver = false, \
     .forward_key_repeat = true, \
     .forward_all_clicks = false, \
+    .input_resampling = true, \
+    .pointer_prediction = false, \
     .legacy_paste = false, \
+    .adaptive_bit_rate = false, \
+    .adaptive_resolution = false, \
+    .render_thread = false, \
+    .record_fragmented = false, \
+    .tile = false, \
+    .reconnect = false, \
+    .server_daemon = false, \
 }
 
 bool
@@ -3,19 +3,29 @@
 #include <assert.h>
 #include <string.h>
 #include <SDL2/SDL.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/time.h>
 
 #include "config.h"
 #include "common.h"
 #include "compat.h"
+#include "compositor.h"
+#include "events.h"
 #include "icon.xpm"
 #include "scrcpy.h"
+#include "screenshot.h"
 #include "tiny_xpm.h"
+#include "trace.h"
 #include "video_buffer.h"
 #include "util/lock.h"
 #include "util/log.h"
 
 #define DISPLAY_MARGINS 96
 
+// the size of the (hidden) window until the frame size is known
+#define DEFAULT_WINDOW_WIDTH 640
+#define DEFAULT_WINDOW_HEIGHT 480
+
 static inline struct size
 get_rotated_size(struct size size, int rotation) {
     struct size rotated_size;
@@ -159,39 +169,53 @@ get_initial_optimal_size(struct size content_size, uint16_t req_width,
 
 static void
 screen_update_content_rect(struct screen *screen) {
-    int dw;
-    int dh;
-    SDL_GL_GetDrawableSize(screen->window, &dw, &dh);
+    // the area available for the content, in drawable coordinates
+    SDL_Rect bounds;
+    if (screen->compositor) {
+        compositor_get_tile_bounds(screen->compositor, screen->tile_index,
+                                   &bounds);
+    } else {
+        bounds.x = 0;
+        bounds.y = 0;
+        SDL_GL_GetDrawableSize(screen->window, &bounds.w, &bounds.h);
+    }
 
     struct size content_size = screen->content_size;
     // The drawable size is the window size * the HiDPI scale
-    struct size drawable_size = {dw, dh};
+    struct size drawable_size = {bounds.w, bounds.h};
 
-    SDL_Rect *rect = &screen->rect;
+    SDL_Rect r;
+    SDL_Rect *rect = &r;
 
     if (is_optimal_size(drawable_size, content_size)) {
         rect->x = 0;
         rect->y = 0;
         rect->w = drawable_size.width;
         rect->h = drawable_size.height;
-        return;
-    }
-
-    bool keep_width = content_size.width * drawable_size.height
-                    > content_size.height * drawable_size.width;
-    if (keep_width) {
-        rect->x = 0;
-        rect->w = drawable_size.width;
-        rect->h = drawable_size.width * content_size.height
-                                      / content_size.width;
-        rect->y = (drawable_size.height - rect->h) / 2;
     } else {
-        rect->y = 0;
-        rect->h = drawable_size.height;
-        rect->w = drawable_size.height * content_size.width
-                                       / content_size.height;
-        rect->x = (drawable_size.width - rect->w) / 2;
+        bool keep_width = content_size.width * drawable_size.height
+                        > content_size.height * drawable_size.width;
+        if (keep_width) {
+            rect->x = 0;
+            rect->w = drawable_size.width;
+            rect->h = drawable_size.width * content_size.height
+                                          / content_size.width;
+            rect->y = (drawable_size.height - rect->h) / 2;
+        } else {
+            rect->y = 0;
+            rect->h = drawable_size.height;
+            rect->w = drawable_size.height * content_size.width
+                                           / content_size.height;
+            rect->x = (drawable_size.width - rect->w) / 2;
+        }
     }
+    rect->x += bounds.x;
+    rect->y += bounds.y;
+
+    // the render thread, if any, reads it
+    mutex_lock(screen->mutex);
+    screen->rect = r;
+    mutex_unlock(screen->mutex);
 }
 
 void
@@ -199,16 +223,71 @@ screen_init(struct screen *screen) {
     *screen = (struct screen) SCREEN_INITIALIZER;
 }
 
+static Uint32
+get_sdl_pixel_format(enum AVPixelFormat format) {
+    switch (format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            return SDL_PIXELFORMAT_YV12;
+        case AV_PIX_FMT_NV12:
+            // typically output by hardware decoders
+            return SDL_PIXELFORMAT_NV12;
+        case AV_PIX_FMT_P010:
+            // 10-bit output of hardware decoders: SDL has no 16-bit YUV
+            // texture formats, it is narrowed to NV12 by the CPU during the
+            // upload (only the 8 most significant bits of each sample are
+            // kept, see narrow_row())
+            return SDL_PIXELFORMAT_NV12;
+        default:
+            return SDL_PIXELFORMAT_UNKNOWN;
+    }
+}
+
+// the J formats use the full range (0-255), instead of the limited range
+// (16-235) expected by the default BT.601 conversion
+static inline bool
+is_full_range(enum AVPixelFormat format) {
+    return format == AV_PIX_FMT_YUVJ420P;
+}
+
+static void
+set_yuv_conversion_mode(enum AVPixelFormat format) {
+#ifdef SCRCPY_SDL_HAS_YUV_CONVERSION_MODE
+    // the mode is global, it is read by SDL when the texture is created (so
+    // it must be set before each creation, all the devices of a session list
+    // normally output the same format)
+    SDL_YUV_CONVERSION_MODE mode = is_full_range(format)
+                                 ? SDL_YUV_CONVERSION_JPEG
+                                 : SDL_YUV_CONVERSION_AUTOMATIC;
+    SDL_SetYUVConversionMode(mode);
+#else
+    if (is_full_range(format)) {
+        LOGW("Full range YUV requires SDL >= 2.0.8, colors may be washed "
+             "out");
+    }
+#endif
+}
+
 static inline SDL_Texture *
 create_texture(struct screen *screen) {
     SDL_Renderer *renderer = screen->renderer;
-    struct size size = screen->frame_size;
-    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_YV12,
+    struct size size = screen->texture_size;
+    uint16_t side = MAX(size.width, size.height);
+    size.width = side;
+    size.height = side;
+    Uint32 format = get_sdl_pixel_format(screen->frame_format);
+    if (format == SDL_PIXELFORMAT_UNKNOWN) {
+        LOGE("Unsupported frame format: %d", screen->frame_format);
+        return NULL;
+    }
+    set_yuv_conversion_mode(screen->frame_format);
+    SDL_Texture *texture = SDL_CreateTexture(renderer, format,
                                              SDL_TEXTUREACCESS_STREAMING,
                                              size.width, size.height);
     if (!texture) {
         return NULL;
     }
+    screen->texture_capacity = size;
 
     if (screen->mipmaps) {
         struct sc_opengl *gl = &screen->gl;
@@ -219,62 +298,31 @@ create_texture(struct screen *screen) {
         gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                           GL_LINEAR_MIPMAP_LINEAR);
         gl->TexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, -1.f);
+        // Allocate the mipmap levels once: the texture must be mipmap-complete
+        // to be sampled at all, even when the mipmaps are not used. Their
+        // content is generated on render, only when the texture is
+        // downscaled.
+        gl->GenerateMipmap(GL_TEXTURE_2D);
 
         SDL_GL_UnbindTexture(texture);
+        screen->mipmaps_valid = false;
     }
 
     return texture;
 }
 
-bool
-screen_init_rendering(struct screen *screen, const char *window_title,
-                      struct size frame_size, bool always_on_top,
-                      int16_t window_x, int16_t window_y, uint16_t window_width,
-                      uint16_t window_height, bool window_borderless,
-                      uint8_t rotation, bool mipmaps) {
-    screen->frame_size = frame_size;
-    screen->rotation = rotation;
-    if (rotation) {
-        LOGI("Initial display rotation set to %u", rotation);
-    }
-    struct size content_size = get_rotated_size(frame_size, screen->rotation);
-    screen->content_size = content_size;
-
-    struct size window_size =
-        get_initial_optimal_size(content_size, window_width, window_height);
-    uint32_t window_flags = SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE;
-#ifdef HIDPI_SUPPORT
-    window_flags |= SDL_WINDOW_ALLOW_HIGHDPI;
-#endif
-    if (always_on_top) {
-#ifdef SCRCPY_SDL_HAS_WINDOW_ALWAYS_ON_TOP
-        window_flags |= SDL_WINDOW_ALWAYS_ON_TOP;
-#else
-        LOGW("The 'always on top' flag is not available "
-             "(compile with SDL >= 2.0.5 to enable it)");
-#endif
-    }
-    if (window_borderless) {
-        window_flags |= SDL_WINDOW_BORDERLESS;
-    }
-
-    int x = window_x != SC_WINDOW_POSITION_UNDEFINED
-          ? window_x : (int) SDL_WINDOWPOS_UNDEFINED;
-    int y = window_y != SC_WINDOW_POSITION_UNDEFINED
-          ? window_y : (int) SDL_WINDOWPOS_UNDEFINED;
-    screen->window = SDL_CreateWindow(window_title, x, y,
-                                      window_size.width, window_size.height,
-                                      window_flags);
-    if (!screen->window) {
-        LOGC("Could not create window: %s", SDL_GetError());
-        return false;
+// create the renderer, on the rendering thread
+// the texture is created on the first frame, once its size and format are
+// known
+static bool
+init_renderer(struct screen *screen) {
+    uint32_t renderer_flags = SDL_RENDERER_ACCELERATED;
+    if (screen->vsync) {
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
     }
-
-    screen->renderer = SDL_CreateRenderer(screen->window, -1,
-                                          SDL_RENDERER_ACCELERATED);
+    screen->renderer = SDL_CreateRenderer(screen->window, -1, renderer_flags);
     if (!screen->renderer) {
         LOGC("Could not create renderer: %s", SDL_GetError());
-        screen_destroy(screen);
         return false;
     }
 
@@ -283,6 +331,13 @@ screen_init_rendering(struct screen *screen, const char *window_title,
     const char *renderer_name = r ? NULL : renderer_info.name;
     LOGI("Renderer: %s", renderer_name ? renderer_name : "(unknown)");
 
+    // mipmaps are requested, disable them if they are not supported
+    bool mipmaps = screen->mipmaps;
+    screen->mipmaps = false;
+    // same for the upscaler
+    bool upscaler = screen->use_upscaler;
+    screen->use_upscaler = false;
+
     // starts with "opengl"
     screen->use_opengl = renderer_name && !strncmp(renderer_name, "opengl", 6);
     if (screen->use_opengl) {
@@ -291,6 +346,23 @@ screen_init_rendering(struct screen *screen, const char *window_title,
 
         LOGI("OpenGL version: %s", gl->version);
 
+        screen->use_pbo = sc_opengl_has_pbo(gl);
+        if (screen->use_pbo) {
+            pbo_uploader_init(&screen->pbo_uploader, gl);
+            LOGD("Asynchronous texture uploads enabled");
+        }
+
+        if (upscaler) {
+            if (!sc_opengl_has_shaders(gl)) {
+                LOGW("Lanczos upscaling disabled (OpenGL 3.0+ required)");
+            } else if (upscaler_init(&screen->upscaler, gl)) {
+                LOGI("Lanczos upscaling enabled");
+                screen->use_upscaler = true;
+            } else {
+                LOGW("Lanczos upscaling disabled");
+            }
+        }
+
         if (mipmaps) {
             bool supports_mipmaps =
                 sc_opengl_version_at_least(gl, 3, 0, /* OpenGL 3.0+ */
@@ -307,6 +379,155 @@ screen_init_rendering(struct screen *screen, const char *window_title,
         }
     } else {
         LOGD("Trilinear filtering disabled (not an OpenGL renderer)");
+        if (upscaler) {
+            LOGW("Lanczos upscaling disabled (not an OpenGL renderer)");
+        }
+    }
+
+    return true;
+}
+
+static void
+destroy_renderer(struct screen *screen) {
+    if (screen->texture) {
+        SDL_DestroyTexture(screen->texture);
+        screen->texture = NULL;
+    }
+    if (screen->use_pbo) {
+        pbo_uploader_destroy(&screen->pbo_uploader);
+        screen->use_pbo = false;
+    }
+    if (screen->use_upscaler) {
+        upscaler_destroy(&screen->upscaler);
+        screen->use_upscaler = false;
+    }
+    if (screen->renderer) {
+        SDL_DestroyRenderer(screen->renderer);
+        screen->renderer = NULL;
+    }
+}
+
+static bool
+update_frame(struct screen *screen, struct video_buffer *vb);
+
+static void
+render(struct screen *screen);
+
+static int
+run_render_thread(void *data) {
+    struct screen *screen = data;
+    trace_set_thread_name("render");
+
+    bool ok = init_renderer(screen);
+
+    mutex_lock(screen->mutex);
+    screen->renderer_initialized = true;
+    // wake up screen_init_rendering()
+    SDL_CondBroadcast(screen->render_cond);
+
+    if (ok) {
+        for (;;) {
+            while (!screen->render_stopped && !screen->frame_pending
+                    && !screen->render_requested) {
+                cond_wait(screen->render_cond, screen->mutex);
+            }
+            if (screen->render_stopped) {
+                break;
+            }
+
+            bool frame_pending = screen->frame_pending;
+            struct video_buffer *vb = screen->video_buffer;
+            screen->frame_pending = false;
+            screen->render_requested = false;
+            mutex_unlock(screen->mutex);
+
+            if (frame_pending) {
+                // also renders
+                update_frame(screen, vb);
+            } else {
+                render(screen);
+            }
+
+            mutex_lock(screen->mutex);
+        }
+    }
+
+    mutex_unlock(screen->mutex);
+
+    // the renderer must be destroyed from the thread which created it
+    destroy_renderer(screen);
+    return 0;
+}
+
+// create the renderer, either directly or on a separate rendering thread
+static bool
+start_renderer(struct screen *screen) {
+    if (!screen->use_render_thread) {
+        return init_renderer(screen);
+    }
+
+    screen->render_thread = SDL_CreateThread(run_render_thread, "render",
+                                             screen);
+    if (!screen->render_thread) {
+        LOGC("Could not start render thread");
+        return false;
+    }
+
+    mutex_lock(screen->mutex);
+    while (!screen->renderer_initialized) {
+        cond_wait(screen->render_cond, screen->mutex);
+    }
+    bool ok = screen->renderer;
+    mutex_unlock(screen->mutex);
+
+    if (!ok) {
+        SDL_WaitThread(screen->render_thread, NULL);
+        screen->render_thread = NULL;
+    }
+    return ok;
+}
+
+bool
+screen_init_rendering(struct screen *screen,
+                      const struct screen_params *params) {
+    screen->mipmaps = params->mipmaps;
+    screen->use_upscaler = params->upscaler;
+    screen->vsync = params->vsync;
+    screen->use_render_thread = params->render_thread;
+
+    // the window is hidden, it is resized by screen_init_content()
+    struct size window_size = {
+        .width = params->window_width ? params->window_width
+                                      : DEFAULT_WINDOW_WIDTH,
+        .height = params->window_height ? params->window_height
+                                        : DEFAULT_WINDOW_HEIGHT,
+    };
+    uint32_t window_flags = SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE;
+#ifdef HIDPI_SUPPORT
+    window_flags |= SDL_WINDOW_ALLOW_HIGHDPI;
+#endif
+    if (params->always_on_top) {
+#ifdef SCRCPY_SDL_HAS_WINDOW_ALWAYS_ON_TOP
+        window_flags |= SDL_WINDOW_ALWAYS_ON_TOP;
+#else
+        LOGW("The 'always on top' flag is not available "
+             "(compile with SDL >= 2.0.5 to enable it)");
+#endif
+    }
+    if (params->window_borderless) {
+        window_flags |= SDL_WINDOW_BORDERLESS;
+    }
+
+    int x = params->window_x != SC_WINDOW_POSITION_UNDEFINED
+          ? params->window_x : (int) SDL_WINDOWPOS_UNDEFINED;
+    int y = params->window_y != SC_WINDOW_POSITION_UNDEFINED
+          ? params->window_y : (int) SDL_WINDOWPOS_UNDEFINED;
+    screen->window = SDL_CreateWindow(params->window_title, x, y,
+                                      window_size.width, window_size.height,
+                                      window_flags);
+    if (!screen->window) {
+        LOGC("Could not create window: %s", SDL_GetError());
+        return false;
     }
 
     SDL_Surface *icon = read_xpm(icon_xpm);
@@ -317,20 +538,88 @@ screen_init_rendering(struct screen *screen, const char *window_title,
         LOGW("Could not load icon");
     }
 
-    LOGI("Initial texture: %" PRIu16 "x%" PRIu16, frame_size.width,
-                                                  frame_size.height);
+    screen->mutex = SDL_CreateMutex();
+    if (!screen->mutex) {
+        LOGC("Could not create mutex");
+        screen_destroy(screen);
+        return false;
+    }
+
+    screen->render_cond = SDL_CreateCond();
+    if (!screen->render_cond) {
+        LOGC("Could not create cond");
+        screen_destroy(screen);
+        return false;
+    }
+
+    if (!start_renderer(screen)) {
+        screen_destroy(screen);
+        return false;
+    }
+
+    return true;
+}
+
+void
+screen_init_content(struct screen *screen, const char *window_title,
+                    struct size frame_size, uint16_t window_width,
+                    uint16_t window_height, uint8_t rotation) {
+    SDL_SetWindowTitle(screen->window, window_title);
+
+    screen->frame_size = frame_size;
+    screen->texture_size = frame_size;
+    screen->rotation = rotation;
+    if (rotation) {
+        LOGI("Initial display rotation set to %u", rotation);
+    }
+    struct size content_size = get_rotated_size(frame_size, screen->rotation);
+    screen->content_size = content_size;
+
+    struct size window_size =
+        get_initial_optimal_size(content_size, window_width, window_height);
+    // This also triggers a SIZE_CHANGED event, to workaround HiDPI issues
+    // with some SDL renderers when several displays having different HiDPI
+    // scaling are connected
+    SDL_SetWindowSize(screen->window, window_size.width, window_size.height);
+
+    screen_update_content_rect(screen);
+}
+
+bool
+screen_init_tile(struct screen *screen, struct compositor *compositor,
+                 struct size frame_size, uint8_t rotation) {
+    screen->compositor = compositor;
+    screen->frame_size = frame_size;
+    screen->texture_size = frame_size;
+    screen->rotation = rotation;
+    screen->content_size = get_rotated_size(frame_size, rotation);
+
+    // the window and the renderer are shared by all the tiles
+    screen->window = compositor->window;
+    screen->renderer = compositor->renderer;
+    screen->use_opengl = compositor->use_opengl;
+    screen->gl = compositor->gl;
+    screen->mipmaps = compositor->mipmaps;
+    screen->use_pbo = screen->use_opengl && sc_opengl_has_pbo(&screen->gl);
+
+    screen->mutex = SDL_CreateMutex();
+    if (!screen->mutex) {
+        LOGC("Could not create mutex");
+        return false;
+    }
+
     screen->texture = create_texture(screen);
     if (!screen->texture) {
         LOGC("Could not create texture: %s", SDL_GetError());
-        screen_destroy(screen);
+        SDL_DestroyMutex(screen->mutex);
         return false;
     }
 
-    // Reset the window size to trigger a SIZE_CHANGED event, to workaround
-    // HiDPI issues with some SDL renderers when several displays having
-    // different HiDPI scaling are connected
-    SDL_SetWindowSize(screen->window, window_size.width, window_size.height);
+    if (screen->use_pbo) {
+        pbo_uploader_init(&screen->pbo_uploader, &screen->gl);
+    }
 
+    screen->tile_index = compositor_add_tile(compositor, screen);
     screen_update_content_rect(screen);
 
     return true;
@@ -338,16 +627,51 @@ screen_init_rendering(struct screen *screen, const char *window_title,
 
 void
 screen_show_window(struct screen *screen) {
+    if (screen->compositor) {
+        compositor_show_window(screen->compositor);
+        return;
+    }
     SDL_ShowWindow(screen->window);
 }
 
+static void
+destroy_tile(struct screen *screen) {
+    compositor_remove_tile(screen->compositor, screen->tile_index);
+    if (screen->use_pbo) {
+        pbo_uploader_destroy(&screen->pbo_uploader);
+    }
+    SDL_DestroyTexture(screen->texture);
+    if (screen->sw_frame) {
+        av_frame_free(&screen->sw_frame);
+    }
+    SDL_DestroyMutex(screen->mutex);
+}
+
 void
 screen_destroy(struct screen *screen) {
-    if (screen->texture) {
-        SDL_DestroyTexture(screen->texture);
+    if (screen->compositor) {
+        // the window and the renderer belong to the compositor
+        destroy_tile(screen);
+        return;
     }
-    if (screen->renderer) {
-        SDL_DestroyRenderer(screen->renderer);
+    if (screen->render_thread) {
+        mutex_lock(screen->mutex);
+        screen->render_stopped = true;
+        cond_signal(screen->render_cond);
+        mutex_unlock(screen->mutex);
+        // the render thread destroys the renderer
+        SDL_WaitThread(screen->render_thread, NULL);
+    } else {
+        destroy_renderer(screen);
+    }
+    if (screen->sw_frame) {
+        av_frame_free(&screen->sw_frame);
+    }
+    if (screen->render_cond) {
+        SDL_DestroyCond(screen->render_cond);
+    }
+    if (screen->mutex) {
+        SDL_DestroyMutex(screen->mutex);
     }
     if (screen->window) {
         SDL_DestroyWindow(screen->window);
@@ -368,9 +692,20 @@ resize_for_content(struct screen *screen, struct size old_content_size,
     set_window_size(screen, target_size);
 }
 
+static inline bool
+is_portrait(struct size size) {
+    return size.width < size.height;
+}
+
 static void
 set_content_size(struct screen *screen, struct size new_content_size) {
-    if (!screen->fullscreen && !screen->maximized) {
+    if (screen->compositor) {
+        // the tile size does not depend on the content
+    } else if (screen->keep_window_size
+            && is_portrait(screen->content_size)
+                == is_portrait(new_content_size)) {
+        // the content is only scaled to the current window
+    } else if (!screen->fullscreen && !screen->maximized) {
         resize_for_content(screen, screen->content_size, new_content_size);
     } else if (!screen->resize_pending) {
         // Store the windowed size to be able to compute the optimal size once
@@ -405,108 +740,473 @@ screen_set_rotation(struct screen *screen, unsigned rotation) {
 
     set_content_size(screen, new_content_size);
 
+    mutex_lock(screen->mutex);
     screen->rotation = rotation;
+    mutex_unlock(screen->mutex);
     LOGI("Display rotation set to %u", rotation);
 
     screen_render(screen, true);
 }
 
-// recreate the texture and resize the window if the frame size has changed
-static bool
-prepare_for_frame(struct screen *screen, struct size new_frame_size) {
-    if (screen->frame_size.width != new_frame_size.width
-            || screen->frame_size.height != new_frame_size.height) {
-        // frame dimension changed, destroy texture
-        SDL_DestroyTexture(screen->texture);
+// resize the window for the new frame size (on the main thread)
+static void
+apply_frame_size(struct screen *screen, struct size new_frame_size) {
+    screen->frame_size = new_frame_size;
 
-        screen->frame_size = new_frame_size;
+    struct size new_content_size =
+        get_rotated_size(new_frame_size, screen->rotation);
+    set_content_size(screen, new_content_size);
 
-        struct size new_content_size =
-            get_rotated_size(new_frame_size, screen->rotation);
-        set_content_size(screen, new_content_size);
+    screen_update_content_rect(screen);
+}
 
-        screen_update_content_rect(screen);
+// Fill the whole texture with black. Only its top-left area is written by the
+// frames, but the texels around it are sampled by the linear filtering and
+// averaged into the mipmaps: they must not contain garbage.
+static void
+clear_texture(struct screen *screen) {
+    // SDL only supports full locks of YUV textures (in all its renderers);
+    // with both the supported formats, the chroma samples follow the Y plane
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(screen->texture, NULL, &pixels, &pitch)) {
+        LOGW("Could not lock texture: %s", SDL_GetError());
+        return;
+    }
+
+    int height = screen->texture_capacity.height;
+    size_t y_size = (size_t) height * pitch;
+    size_t uv_size = (size_t) ((height + 1) / 2) * ((pitch + 1) & ~1);
+    uint8_t black = is_full_range(screen->frame_format) ? 0 : 16;
+    uint8_t *dst = pixels;
+    memset(dst, black, y_size);
+    memset(dst + y_size, 128, uv_size);
+
+    SDL_UnlockTexture(screen->texture);
+}
+
+// resize the window if the frame size has changed, and recreate the texture
+// if it does not fit anymore (a rotation only swaps the frame dimensions, it
+// always fits, the texture is only cleared)
+static bool
+prepare_for_frame(struct screen *screen, struct size new_frame_size,
+                  enum AVPixelFormat new_frame_format) {
+    bool size_changed = screen->texture_size.width != new_frame_size.width
+                     || screen->texture_size.height != new_frame_size.height;
+    if (size_changed) {
+        screen->texture_size = new_frame_size;
+
+        if (screen->use_render_thread) {
+            // the window must be resized from the main thread
+            mutex_lock(screen->mutex);
+            screen->new_frame_size = new_frame_size;
+            mutex_unlock(screen->mutex);
+
+            SDL_Event event;
+            event.type = EVENT_FRAME_SIZE_CHANGED;
+            event.user.data1 = screen;
+            SDL_PushEvent(&event);
+        } else {
+            apply_frame_size(screen, new_frame_size);
+        }
+    }
+
+    // the texture is created on the first frame
+    bool fits = screen->texture
+             && new_frame_size.width <= screen->texture_capacity.width
+             && new_frame_size.height <= screen->texture_capacity.height;
+    bool format_changed = screen->frame_format != new_frame_format;
+    if (!fits || format_changed) {
+        // frame too big or format changed, destroy texture
+        if (screen->texture) {
+            SDL_DestroyTexture(screen->texture);
+            screen->texture = NULL;
+        }
+
+        screen->frame_format = new_frame_format;
 
-        LOGI("New texture: %" PRIu16 "x%" PRIu16,
-                     screen->frame_size.width, screen->frame_size.height);
         screen->texture = create_texture(screen);
         if (!screen->texture) {
             LOGC("Could not create texture: %s", SDL_GetError());
             return false;
         }
+        LOGI("New texture: %" PRIu16 "x%" PRIu16,
+             screen->texture_capacity.width, screen->texture_capacity.height);
+        clear_texture(screen);
+    } else if (size_changed) {
+        // the area previously used by the other orientation is now unused
+        clear_texture(screen);
     }
 
     return true;
 }
 
+static void
+update_nv_texture(struct screen *screen, const SDL_Rect *rect,
+                  const AVFrame *frame) {
+#ifdef SCRCPY_SDL_HAS_UPDATE_NV_TEXTURE
+    SDL_UpdateNVTexture(screen->texture, rect,
+            frame->data[0], frame->linesize[0],
+            frame->data[1], frame->linesize[1]);
+#else
+    (void) rect;
+    // the whole texture is locked (SDL does not support partial locks of
+    // YUV textures), the frame is written to its top-left area
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(screen->texture, NULL, &pixels, &pitch)) {
+        LOGE("Could not lock texture: %s", SDL_GetError());
+        return;
+    }
+
+    uint8_t *dst = pixels;
+    for (int y = 0; y < frame->height; ++y) {
+        memcpy(dst, frame->data[0] + y * frame->linesize[0], frame->width);
+        dst += pitch;
+    }
+    // the UV plane follows the Y plane of the texture, it has half the
+    // height, with interleaved U and V samples
+    dst = (uint8_t *) pixels
+        + (size_t) screen->texture_capacity.height * pitch;
+    int uv_pitch = (pitch + 1) & ~1;
+    int uv_width = (frame->width + 1) & ~1;
+    for (int y = 0; y < (frame->height + 1) / 2; ++y) {
+        memcpy(dst, frame->data[1] + y * frame->linesize[1], uv_width);
+        dst += uv_pitch;
+    }
+
+    SDL_UnlockTexture(screen->texture);
+#endif
+}
+
+// copy the most significant byte of each 16-bit sample
+static inline void
+narrow_row(uint8_t *dst, const uint8_t *src, int samples) {
+    const uint16_t *src16 = (const uint16_t *) src;
+    for (int i = 0; i < samples; ++i) {
+        dst[i] = src16[i] >> 8;
+    }
+}
+
+// P010 has the same layout as NV12, with 16-bit samples (10 significant
+// bits, in the most significant bits)
+static void
+update_p010_texture(struct screen *screen, const AVFrame *frame) {
+    // the whole texture is locked (SDL does not support partial locks of
+    // YUV textures), the frame is written to its top-left area
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(screen->texture, NULL, &pixels, &pitch)) {
+        LOGE("Could not lock texture: %s", SDL_GetError());
+        return;
+    }
+
+    // narrow the samples on the CPU; this is a conversion of every sample, but
+    // done while copying to the texture rather than as a separate pass
+    uint8_t *dst = pixels;
+    for (int y = 0; y < frame->height; ++y) {
+        narrow_row(dst, frame->data[0] + y * frame->linesize[0],
+                   frame->width);
+        dst += pitch;
+    }
+    dst = (uint8_t *) pixels
+        + (size_t) screen->texture_capacity.height * pitch;
+    int uv_pitch = (pitch + 1) & ~1;
+    int uv_samples = (frame->width + 1) & ~1;
+    for (int y = 0; y < (frame->height + 1) / 2; ++y) {
+        narrow_row(dst, frame->data[1] + y * frame->linesize[1], uv_samples);
+        dst += uv_pitch;
+    }
+
+    SDL_UnlockTexture(screen->texture);
+}
+
+// the area of the texture containing the frame
+static inline SDL_Rect
+get_texture_rect(struct screen *screen) {
+    SDL_Rect rect = {0, 0, screen->texture_size.width,
+                     screen->texture_size.height};
+    return rect;
+}
+
 // write the frame into the texture
 static void
 update_texture(struct screen *screen, const AVFrame *frame) {
-    SDL_UpdateYUVTexture(screen->texture, NULL,
-            frame->data[0], frame->linesize[0],
-            frame->data[1], frame->linesize[1],
-            frame->data[2], frame->linesize[2]);
+    SDL_Rect rect = get_texture_rect(screen);
+    if (frame->format == AV_PIX_FMT_NV12) {
+        update_nv_texture(screen, &rect, frame);
+    } else if (frame->format == AV_PIX_FMT_P010) {
+        update_p010_texture(screen, frame);
+    } else if (!screen->use_pbo
+            || !pbo_uploader_upload(&screen->pbo_uploader, screen->texture,
+                                    frame)) {
+        SDL_UpdateYUVTexture(screen->texture, &rect,
+                frame->data[0], frame->linesize[0],
+                frame->data[1], frame->linesize[1],
+                frame->data[2], frame->linesize[2]);
+    }
 
-    if (screen->mipmaps) {
-        assert(screen->use_opengl);
-        SDL_GL_BindTexture(screen->texture, NULL, NULL);
-        screen->gl.GenerateMipmap(GL_TEXTURE_2D);
-        SDL_GL_UnbindTexture(screen->texture);
+    // regenerated on render, only if they are used
+    screen->mipmaps_valid = false;
+}
+
+// Return true if the texture is rendered downscaled enough for the mipmaps to
+// be sampled: with a LOD bias of -1, the minification filter only applies
+// when the texture is downscaled by more than a factor 2.
+static bool
+is_mipmap_scale(struct screen *screen, const SDL_Rect *content_rect,
+                unsigned rotation) {
+    // the texture is drawn rotated
+    int w = rotation & 1 ? content_rect->h : content_rect->w;
+    int h = rotation & 1 ? content_rect->w : content_rect->h;
+    return screen->texture_size.width > 2 * w
+        || screen->texture_size.height > 2 * h;
+}
+
+// Return true if the texture is rendered upscaled in at least one dimension
+static bool
+is_upscale(struct screen *screen, const SDL_Rect *content_rect,
+           unsigned rotation) {
+    // the texture is drawn rotated
+    int w = rotation & 1 ? content_rect->h : content_rect->w;
+    int h = rotation & 1 ? content_rect->w : content_rect->h;
+    return w > screen->texture_size.width || h > screen->texture_size.height;
+}
+
+static void
+update_mipmaps(struct screen *screen, const SDL_Rect *content_rect,
+               unsigned rotation) {
+    if (!screen->mipmaps || screen->mipmaps_valid
+            || !is_mipmap_scale(screen, content_rect, rotation)) {
+        return;
     }
+
+    assert(screen->use_opengl);
+    SDL_GL_BindTexture(screen->texture, NULL, NULL);
+    screen->gl.GenerateMipmap(GL_TEXTURE_2D);
+    SDL_GL_UnbindTexture(screen->texture);
+    screen->mipmaps_valid = true;
 }
 
-bool
-screen_update_frame(struct screen *screen, struct video_buffer *vb) {
-    mutex_lock(vb->mutex);
+// return a frame readable from the CPU
+// a hardware frame is mapped (or downloaded if it cannot be mapped) to
+// system memory, then copied to the texture like a software frame: this is
+// not a zero-copy import, the frame still goes through the CPU
+static const AVFrame *
+get_sw_frame(struct screen *screen, const AVFrame *frame) {
+    if (!frame->hw_frames_ctx) {
+        // already in system memory
+        return frame;
+    }
+
+    if (!screen->sw_frame) {
+        screen->sw_frame = av_frame_alloc();
+        if (!screen->sw_frame) {
+            LOGC("Could not allocate frame");
+            return NULL;
+        }
+    }
+
+    AVFrame *sw_frame = screen->sw_frame;
+    int ret = av_hwframe_map(sw_frame, frame, AV_HWFRAME_MAP_READ);
+    if (ret < 0) {
+        // not all hardware support mapping, download the frame instead
+        av_frame_unref(sw_frame);
+        ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+        if (ret < 0) {
+            LOGE("Could not download hardware frame: %d", ret);
+            return NULL;
+        }
+    }
+
+    return sw_frame;
+}
+
+// upload the next frame to the texture and render it, on the rendering thread
+static bool
+update_frame(struct screen *screen, struct video_buffer *vb) {
     const AVFrame *frame = video_buffer_consume_rendered_frame(vb);
-    struct size new_frame_size = {frame->width, frame->height};
-    if (!prepare_for_frame(screen, new_frame_size)) {
-        mutex_unlock(vb->mutex);
+    if (!frame) {
+        // the frame has already been rendered on a previous event
+        return true;
+    }
+
+    if (screen->screenshot) {
+        // only referenced, the frame is not touched by this thread
+        screenshot_on_rendered_frame(screen->screenshot, frame);
+    }
+
+    const AVFrame *sw_frame = get_sw_frame(screen, frame);
+    if (!sw_frame) {
+        video_buffer_release_rendered_frame(vb);
+        return false;
+    }
+
+    struct size new_frame_size = {sw_frame->width, sw_frame->height};
+    bool ok = prepare_for_frame(screen, new_frame_size, sw_frame->format);
+    if (ok) {
+        trace_begin("upload");
+        update_texture(screen, sw_frame);
+        trace_end();
+    }
+
+    if (sw_frame != frame) {
+        // unmap the hardware frame
+        av_frame_unref(screen->sw_frame);
+    }
+    video_buffer_release_rendered_frame(vb);
+
+    if (!ok) {
         return false;
     }
-    update_texture(screen, frame);
-    mutex_unlock(vb->mutex);
 
-    screen_render(screen, false);
+    render(screen);
+
+    // the latency stats may be logged from the main thread
+    mutex_lock(screen->mutex);
+    int64_t presented = av_gettime_relative();
+    latency_stats_add_frame(&vb->latency_stats, &vb->rendering_times,
+                            presented);
+    mutex_unlock(screen->mutex);
+    metrics_add_frame(vb->metrics, &vb->rendering_times, presented);
+    return true;
+}
+
+bool
+screen_update_frame(struct screen *screen, struct video_buffer *vb) {
+    if (!screen->use_render_thread) {
+        return update_frame(screen, vb);
+    }
+
+    mutex_lock(screen->mutex);
+    screen->video_buffer = vb;
+    screen->frame_pending = true;
+    cond_signal(screen->render_cond);
+    mutex_unlock(screen->mutex);
     return true;
 }
 
 void
-screen_render(struct screen *screen, bool update_content_rect) {
-    if (update_content_rect) {
-        screen_update_content_rect(screen);
+screen_handle_frame_size_changed(struct screen *screen) {
+    assert(screen->use_render_thread);
+
+    mutex_lock(screen->mutex);
+    struct size new_frame_size = screen->new_frame_size;
+    mutex_unlock(screen->mutex);
+
+    if (new_frame_size.width != screen->frame_size.width
+            || new_frame_size.height != screen->frame_size.height) {
+        apply_frame_size(screen, new_frame_size);
+        screen_render(screen, false);
     }
+}
 
-    SDL_RenderClear(screen->renderer);
-    if (screen->rotation == 0) {
-        SDL_RenderCopy(screen->renderer, screen->texture, NULL, &screen->rect);
+void
+screen_log_latency_stats(struct screen *screen, struct video_buffer *vb) {
+    mutex_lock(screen->mutex);
+    latency_stats_log(&vb->latency_stats);
+    mutex_unlock(screen->mutex);
+}
+
+void
+screen_draw(struct screen *screen) {
+    if (!screen->texture) {
+        // no frame received yet
+        return;
+    }
+
+    mutex_lock(screen->mutex);
+    unsigned rotation = screen->rotation;
+    SDL_Rect content_rect = screen->rect;
+    mutex_unlock(screen->mutex);
+
+    // the window may have been downscaled since the last texture update
+    update_mipmaps(screen, &content_rect, rotation);
+
+    bool planar = screen->frame_format == AV_PIX_FMT_YUV420P
+               || screen->frame_format == AV_PIX_FMT_YUVJ420P;
+    if (screen->use_upscaler && planar
+            && is_upscale(screen, &content_rect, rotation)) {
+        int drawable_width;
+        int drawable_height;
+        SDL_GL_GetDrawableSize(screen->window, &drawable_width,
+                               &drawable_height);
+        if (upscaler_draw(&screen->upscaler, screen->texture,
+                          screen->texture_capacity, screen->texture_size,
+                          &content_rect, drawable_height, rotation)) {
+            return;
+        }
+        // draw it with SDL instead
+    }
+
+    SDL_Rect srcrect = get_texture_rect(screen);
+    if (rotation == 0) {
+        SDL_RenderCopy(screen->renderer, screen->texture, &srcrect,
+                       &content_rect);
     } else {
         // rotation in RenderCopyEx() is clockwise, while screen->rotation is
         // counterclockwise (to be consistent with --lock-video-orientation)
-        int cw_rotation = (4 - screen->rotation) % 4;
+        int cw_rotation = (4 - rotation) % 4;
         double angle = 90 * cw_rotation;
 
         SDL_Rect *dstrect = NULL;
         SDL_Rect rect;
-        if (screen->rotation & 1) {
-            rect.x = screen->rect.x + (screen->rect.w - screen->rect.h) / 2;
-            rect.y = screen->rect.y + (screen->rect.h - screen->rect.w) / 2;
-            rect.w = screen->rect.h;
-            rect.h = screen->rect.w;
+        if (rotation & 1) {
+            rect.x = content_rect.x + (content_rect.w - content_rect.h) / 2;
+            rect.y = content_rect.y + (content_rect.h - content_rect.w) / 2;
+            rect.w = content_rect.h;
+            rect.h = content_rect.w;
             dstrect = &rect;
         } else {
-            assert(screen->rotation == 2);
-            dstrect = &screen->rect;
+            assert(rotation == 2);
+            dstrect = &content_rect;
         }
 
-        SDL_RenderCopyEx(screen->renderer, screen->texture, NULL, dstrect,
+        SDL_RenderCopyEx(screen->renderer, screen->texture, &srcrect, dstrect,
                          angle, NULL, 0);
     }
+}
+
+// render the texture, on the rendering thread
+static void
+render(struct screen *screen) {
+    if (screen->compositor) {
+        // drawn with the other tiles
+        compositor_request_render(screen->compositor);
+        return;
+    }
+
+    SDL_RenderClear(screen->renderer);
+    screen_draw(screen);
+    trace_begin("present");
     SDL_RenderPresent(screen->renderer);
+    trace_end();
+}
+
+void
+screen_render(struct screen *screen, bool update_content_rect) {
+    if (update_content_rect) {
+        screen_update_content_rect(screen);
+    }
+
+    if (!screen->use_render_thread) {
+        render(screen);
+        return;
+    }
+
+    mutex_lock(screen->mutex);
+    screen->render_requested = true;
+    cond_signal(screen->render_cond);
+    mutex_unlock(screen->mutex);
 }
 
 void
 screen_switch_fullscreen(struct screen *screen) {
+    if (screen->compositor) {
+        compositor_switch_fullscreen(screen->compositor);
+        return;
+    }
+
     uint32_t new_mode = screen->fullscreen ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP;
     if (SDL_SetWindowFullscreen(screen->window, new_mode)) {
         LOGW("Could not switch fullscreen mode: %s", SDL_GetError());
@@ -524,7 +1224,7 @@ screen_switch_fullscreen(struct screen *screen) {
 
 void
 screen_resize_to_fit(struct screen *screen) {
-    if (screen->fullscreen || screen->maximized) {
+    if (screen->compositor || screen->fullscreen || screen->maximized) {
         return;
     }
 
@@ -537,7 +1237,7 @@ screen_resize_to_fit(struct screen *screen) {
 
 void
 screen_resize_to_pixel_perfect(struct screen *screen) {
-    if (screen->fullscreen) {
+    if (screen->compositor || screen->fullscreen) {
         return;
     }
 
@@ -579,6 +1279,19 @@ screen_handle_window_event(struct screen *screen,
     }
 }
 
+int
+screen_get_refresh_rate(struct screen *screen) {
+    int display_index = SDL_GetWindowDisplayIndex(screen->window);
+    if (display_index < 0) {
+        return 0;
+    }
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(display_index, &mode)) {
+        return 0;
+    }
+    return mode.refresh_rate;
+}
+
 struct point
 screen_convert_drawable_to_frame_coords(struct screen *screen,
                                         int32_t x, int32_t y) {
@@ -3,21 +3,45 @@
 
 #include <stdbool.h>
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
 #include <libavformat/avformat.h>
 
 #include "config.h"
 #include "common.h"
 #include "opengl.h"
+#include "pbo_uploader.h"
+#include "upscaler.h"
 
+struct compositor;
+struct screenshot;
 struct video_buffer;
 
 struct screen {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    // hardware frames mapped (or downloaded) to system memory, lazily
+    // allocated
+    AVFrame *sw_frame;
     bool use_opengl;
     struct sc_opengl gl;
+    // upload the YUV420P frames asynchronously (if supported by OpenGL)
+    bool use_pbo;
+    struct pbo_uploader pbo_uploader;
+    // draw the upscaled YUV420P frames with a Lanczos filter (if supported by
+    // OpenGL)
+    bool use_upscaler;
+    struct upscaler upscaler;
     struct size frame_size;
+    // the size of the texture, which differs from frame_size until the main
+    // thread handles a frame size change (with a render thread)
+    struct size texture_size;
+    // the allocated size of the texture, square so that a rotation of the
+    // device (swapping the frame dimensions) does not recreate it; only its
+    // top-left texture_size area is used
+    struct size texture_capacity;
+    enum AVPixelFormat frame_format; // the format of the texture content
     struct size content_size; // rotated frame_size
 
     bool resize_pending; // resize requested while fullscreen or maximized
@@ -34,18 +58,63 @@ struct screen {
     bool maximized;
     bool no_window;
     bool mipmaps;
+    // the mipmaps have been generated for the current texture content
+    bool mipmaps_valid;
+    bool vsync;
+    // do not resize the window when the frame size changes without changing
+    // its orientation (the frame size follows the window size, with
+    // --adaptive-resolution)
+    bool keep_window_size;
+
+    // If enabled, the renderer is owned by a separate thread, so that a slow
+    // present never delays the processing of input events. The main thread
+    // only requests renders.
+    bool use_render_thread;
+    SDL_Thread *render_thread;
+    // protects rect and rotation (written by the main thread) and the render
+    // requests below
+    SDL_mutex *mutex;
+    SDL_cond *render_cond;
+    bool renderer_initialized;
+    bool render_stopped;
+    bool render_requested;
+    bool frame_pending;
+    struct video_buffer *video_buffer; // the source of the pending frame
+    struct size new_frame_size; // set by the render thread on size change
+
+    // if set, the screen is a tile of a shared window (it owns only its
+    // texture)
+    struct compositor *compositor;
+    unsigned tile_index;
+
+    // captures the rendered frames on request (may be NULL)
+    struct screenshot *screenshot;
 };
 
 #define SCREEN_INITIALIZER { \
     .window = NULL, \
     .renderer = NULL, \
     .texture = NULL, \
+    .sw_frame = NULL, \
     .use_opengl = false, \
     .gl = {0}, \
+    .use_pbo = false, \
+    .pbo_uploader = {0}, \
+    .use_upscaler = false, \
+    .upscaler = {0}, \
     .frame_size = { \
         .width = 0, \
         .height = 0, \
     }, \
+    .texture_size = { \
+        .width = 0, \
+        .height = 0, \
+    }, \
+    .texture_capacity = { \
+        .width = 0, \
+        .height = 0, \
+    }, \
+    .frame_format = AV_PIX_FMT_YUV420P, \
     .content_size = { \
         .width = 0, \
         .height = 0, \
@@ -67,20 +136,66 @@ struct screen {
     .maximized = false, \
     .no_window = false, \
     .mipmaps = false, \
+    .mipmaps_valid = false, \
+    .vsync = false, \
+    .keep_window_size = false, \
+    .use_render_thread = false, \
+    .render_thread = NULL, \
+    .mutex = NULL, \
+    .render_cond = NULL, \
+    .renderer_initialized = false, \
+    .render_stopped = false, \
+    .render_requested = false, \
+    .frame_pending = false, \
+    .video_buffer = NULL, \
+    .new_frame_size = { \
+        .width = 0, \
+        .height = 0, \
+    }, \
+    .compositor = NULL, \
+    .tile_index = 0, \
+    .screenshot = NULL, \
 }
 
+struct screen_params {
+    const char *window_title;
+    bool always_on_top;
+    int16_t window_x; // accepts SC_WINDOW_POSITION_UNDEFINED
+    int16_t window_y; // accepts SC_WINDOW_POSITION_UNDEFINED
+    uint16_t window_width; // 0 for the default size
+    uint16_t window_height;
+    bool window_borderless;
+    bool mipmaps;
+    // draw the upscaled frames with a Lanczos filter (when supported by the
+    // renderer)
+    bool upscaler;
+    bool vsync;
+    // create and use the renderer from a separate thread
+    bool render_thread;
+};
+
 // initialize default values
 void
 screen_init(struct screen *screen);
 
-// initialize screen, create window, renderer and texture (window is hidden)
-// window_x and window_y accept SC_WINDOW_POSITION_UNDEFINED
+// initialize screen, create window and renderer (window is hidden)
+// it does not depend on the device, so that it may be called while the
+// device is connecting (the renderer creation may be slow)
 bool
-screen_init_rendering(struct screen *screen, const char *window_title,
-                      struct size frame_size, bool always_on_top,
-                      int16_t window_x, int16_t window_y, uint16_t window_width,
-                      uint16_t window_height, bool window_borderless,
-                      uint8_t rotation, bool mipmaps);
+screen_init_rendering(struct screen *screen,
+                      const struct screen_params *params);
+
+// set the initial frame size, once the device is connected, and resize the
+// window accordingly (the texture is created on the first frame)
+void
+screen_init_content(struct screen *screen, const char *window_title,
+                    struct size frame_size, uint16_t window_width,
+                    uint16_t window_height, uint8_t rotation);
+
+// initialize screen as a tile of the compositor window, create its texture
+bool
+screen_init_tile(struct screen *screen, struct compositor *compositor,
+                 struct size frame_size, uint8_t rotation);
 
 // show the window
 void
@@ -91,16 +206,31 @@ void
 screen_destroy(struct screen *screen);
 
 // resize if necessary and write the rendered frame into the texture
+// (with a render thread, only request it to do so)
 bool
 screen_update_frame(struct screen *screen, struct video_buffer *vb);
 
-// render the texture to the renderer
+// render the texture to the renderer (with a render thread, only request a
+// render)
 //
 // Set the update_content_rect flag if the window or content size may have
 // changed, so that the content rectangle is recomputed
 void
 screen_render(struct screen *screen, bool update_content_rect);
 
+// draw the texture into its content rectangle, without clearing or presenting
+// (on the rendering thread)
+void
+screen_draw(struct screen *screen);
+
+// react to EVENT_FRAME_SIZE_CHANGED (only sent if a render thread is used)
+void
+screen_handle_frame_size_changed(struct screen *screen);
+
+// log the latency stats (updated on rendering)
+void
+screen_log_latency_stats(struct screen *screen, struct video_buffer *vb);
+
 // switch the fullscreen mode
 void
 screen_switch_fullscreen(struct screen *screen);
@@ -121,6 +251,11 @@ screen_set_rotation(struct screen *screen, unsigned rotation);
 void
 screen_handle_window_event(struct screen *screen, const SDL_WindowEvent *event);
 
+// return the refresh rate (in Hz) of the display containing the window, or 0
+// if unknown
+int
+screen_get_refresh_rate(struct screen *screen);
+
 // convert point from window coordinates to frame coordinates
 // x and y are expressed in pixels
 struct point
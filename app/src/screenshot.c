@@ -0,0 +1,317 @@
+#include "screenshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libswscale/swscale.h>
+
+#include "config.h"
+#include "util/lock.h"
+#include "util/log.h"
+
+bool
+screenshot_init(struct screenshot *ss, enum sc_screenshot_format format,
+                const char *directory) {
+    if (!(ss->mutex = SDL_CreateMutex())) {
+        return false;
+    }
+
+    if (!(ss->queue_cond = SDL_CreateCond())) {
+        SDL_DestroyMutex(ss->mutex);
+        return false;
+    }
+
+    ss->format = format;
+    ss->directory = directory;
+    atomic_init(&ss->requested, false);
+    ss->thread = NULL;
+    ss->stopped = false;
+    ss->head = 0;
+    ss->count = 0;
+    ss->index = 0;
+
+    return true;
+}
+
+void
+screenshot_destroy(struct screenshot *ss) {
+    // the frames captured after the thread has stopped
+    while (ss->count) {
+        av_frame_free(&ss->queue[ss->head]);
+        ss->head = (ss->head + 1) % SCREENSHOT_QUEUE_SIZE;
+        --ss->count;
+    }
+    SDL_DestroyCond(ss->queue_cond);
+    SDL_DestroyMutex(ss->mutex);
+}
+
+static const char *
+get_extension(enum sc_screenshot_format format) {
+    return format == SC_SCREENSHOT_FORMAT_JPEG ? "jpg" : "png";
+}
+
+// return a string to be released by SDL_free(), or NULL on error
+static char *
+create_filename(struct screenshot *ss) {
+    char name[64];
+    time_t now = time(NULL);
+    size_t len = strftime(name, sizeof(name),
+                          "scrcpy-screenshot-%Y%m%d-%H%M%S",
+                          localtime(&now));
+    // several screenshots may be taken in the same second
+    snprintf(name + len, sizeof(name) - len, "-%u.%s", ++ss->index,
+             get_extension(ss->format));
+
+    if (!ss->directory) {
+        return SDL_strdup(name);
+    }
+
+    size_t size = strlen(ss->directory) + 1 + strlen(name) + 1;
+    char *filename = SDL_malloc(size);
+    if (filename) {
+        snprintf(filename, size, "%s/%s", ss->directory, name);
+    }
+    return filename;
+}
+
+// convert the frame to the pixel format expected by the encoder
+// return a new frame to be released by av_frame_free(), or NULL on error
+static AVFrame *
+convert_frame(const AVFrame *frame, enum AVPixelFormat format) {
+    AVFrame *converted = av_frame_alloc();
+    if (!converted) {
+        return NULL;
+    }
+    converted->width = frame->width;
+    converted->height = frame->height;
+    converted->format = format;
+    if (av_frame_get_buffer(converted, 0)) {
+        goto error;
+    }
+
+    // full chroma interpolation, since the image is not scaled
+    struct SwsContext *sws = sws_getContext(frame->width, frame->height,
+                                            frame->format, frame->width,
+                                            frame->height, format,
+                                            SWS_BILINEAR | SWS_FULL_CHR_H_INT
+                                                | SWS_ACCURATE_RND,
+                                            NULL, NULL, NULL);
+    if (!sws) {
+        LOGE("Could not create screenshot conversion context");
+        goto error;
+    }
+
+    sws_scale(sws, (const uint8_t *const *) frame->data, frame->linesize, 0,
+              frame->height, converted->data, converted->linesize);
+    sws_freeContext(sws);
+
+    return converted;
+
+error:
+    av_frame_free(&converted);
+    return NULL;
+}
+
+static bool
+encode_frame(const AVFrame *frame, enum sc_screenshot_format format,
+             AVPacket *packet) {
+    bool jpeg = format == SC_SCREENSHOT_FORMAT_JPEG;
+    enum AVCodecID codec_id = jpeg ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_PNG;
+    // the PNG is lossless
+    enum AVPixelFormat pix_fmt = jpeg ? AV_PIX_FMT_YUVJ420P
+                                      : AV_PIX_FMT_RGB24;
+
+    AVCodec *codec = avcodec_find_encoder(codec_id);
+    if (!codec) {
+        LOGE("Screenshot encoder not found: %s", avcodec_get_name(codec_id));
+        return false;
+    }
+
+    AVFrame *converted = convert_frame(frame, pix_fmt);
+    if (!converted) {
+        return false;
+    }
+
+    bool ok = false;
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOGC("Could not allocate screenshot codec context");
+        goto end;
+    }
+
+    ctx->width = converted->width;
+    ctx->height = converted->height;
+    ctx->pix_fmt = pix_fmt;
+    ctx->time_base = (AVRational) {1, 1};
+    if (jpeg) {
+        // the best quality (the default rate control targets a video)
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+        ctx->global_quality = FF_QP2LAMBDA * 2;
+        converted->quality = ctx->global_quality;
+    }
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Could not open screenshot encoder");
+        goto end;
+    }
+
+    converted->pts = 0;
+    if (avcodec_send_frame(ctx, converted)
+            || avcodec_receive_packet(ctx, packet)) {
+        LOGE("Could not encode screenshot");
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    avcodec_free_context(&ctx);
+    av_frame_free(&converted);
+    return ok;
+}
+
+static bool
+write_screenshot(const AVFrame *frame, enum sc_screenshot_format format,
+                 const char *filename) {
+    AVFrame *sw_frame = NULL;
+    if (frame->hw_frames_ctx) {
+        // the frame is still in the GPU memory
+        sw_frame = av_frame_alloc();
+        if (!sw_frame) {
+            LOGC("Could not allocate frame");
+            return false;
+        }
+        if (av_hwframe_transfer_data(sw_frame, frame, 0) < 0) {
+            LOGE("Could not download hardware frame");
+            av_frame_free(&sw_frame);
+            return false;
+        }
+        frame = sw_frame;
+    }
+
+    bool ok = false;
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOGC("Could not allocate packet");
+        goto end;
+    }
+
+    if (!encode_frame(frame, format, packet)) {
+        goto end;
+    }
+
+    // avio handles UTF-8 file names on all platforms
+    AVIOContext *io;
+    if (avio_open(&io, filename, AVIO_FLAG_WRITE) < 0) {
+        LOGE("Could not open %s", filename);
+        goto end;
+    }
+    avio_write(io, packet->data, packet->size);
+    ok = avio_closep(&io) >= 0;
+
+end:
+    av_packet_free(&packet);
+    av_frame_free(&sw_frame);
+    return ok;
+}
+
+static int
+run_screenshot(void *data) {
+    struct screenshot *ss = data;
+
+    for (;;) {
+        mutex_lock(ss->mutex);
+        while (!ss->stopped && !ss->count) {
+            cond_wait(ss->queue_cond, ss->mutex);
+        }
+        if (!ss->count) {
+            // stopped, and all the screenshots are written
+            mutex_unlock(ss->mutex);
+            break;
+        }
+        AVFrame *frame = ss->queue[ss->head];
+        ss->head = (ss->head + 1) % SCREENSHOT_QUEUE_SIZE;
+        --ss->count;
+        mutex_unlock(ss->mutex);
+
+        char *filename = create_filename(ss);
+        if (!filename) {
+            LOGC("Could not allocate screenshot file name");
+        } else if (write_screenshot(frame, ss->format, filename)) {
+            LOGI("Screenshot saved to %s", filename);
+        } else {
+            LOGE("Could not save screenshot to %s", filename);
+        }
+
+        SDL_free(filename);
+        av_frame_free(&frame);
+    }
+
+    return 0;
+}
+
+bool
+screenshot_start(struct screenshot *ss) {
+    LOGD("Starting screenshot thread");
+
+    ss->thread = SDL_CreateThread(run_screenshot, "screenshot", ss);
+    if (!ss->thread) {
+        LOGC("Could not start screenshot thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+screenshot_stop(struct screenshot *ss) {
+    mutex_lock(ss->mutex);
+    ss->stopped = true;
+    cond_signal(ss->queue_cond);
+    mutex_unlock(ss->mutex);
+}
+
+void
+screenshot_join(struct screenshot *ss) {
+    SDL_WaitThread(ss->thread, NULL);
+}
+
+void
+screenshot_request(struct screenshot *ss) {
+    atomic_store_explicit(&ss->requested, true, memory_order_relaxed);
+}
+
+void
+screenshot_on_rendered_frame(struct screenshot *ss, const AVFrame *frame) {
+    if (!atomic_load_explicit(&ss->requested, memory_order_relaxed)
+            || !atomic_exchange_explicit(&ss->requested, false,
+                                         memory_order_relaxed)) {
+        return;
+    }
+
+    // only the buffers are referenced, the frame is converted by the
+    // screenshot thread
+    AVFrame *ref = av_frame_clone(frame);
+    if (!ref) {
+        LOGE("Could not reference screenshot frame");
+        return;
+    }
+
+    mutex_lock(ss->mutex);
+    bool full = ss->count == SCREENSHOT_QUEUE_SIZE;
+    if (!full) {
+        unsigned tail = (ss->head + ss->count) % SCREENSHOT_QUEUE_SIZE;
+        ss->queue[tail] = ref;
+        ++ss->count;
+        cond_signal(ss->queue_cond);
+    }
+    mutex_unlock(ss->mutex);
+
+    if (full) {
+        LOGW("Too many pending screenshots, screenshot dropped");
+        av_frame_free(&ref);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SCREENSHOT_H
+#define SCREENSHOT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+#include "config.h"
+#include "scrcpy.h"
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+#define SCREENSHOT_QUEUE_SIZE 8
+
+// Write the rendered frames to image files on demand (MOD+Shift+s)
+//
+// On request, the next frame consumed for rendering is referenced (not
+// copied) by the renderer. The conversion, the encoding and the write are
+// executed by a separate thread, so that neither the event loop nor the
+// render thread is ever blocked.
+struct screenshot {
+    enum sc_screenshot_format format;
+    const char *directory; // NULL for the current directory
+
+    // the next rendered frame must be captured
+    atomic_bool requested;
+
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *queue_cond;
+    bool stopped;
+    // captured frames, waiting to be written
+    AVFrame *queue[SCREENSHOT_QUEUE_SIZE];
+    unsigned head;
+    unsigned count;
+
+    // only accessed from the screenshot thread
+    unsigned index; // number of screenshots written, for the file names
+};
+
+bool
+screenshot_init(struct screenshot *ss, enum sc_screenshot_format format,
+                const char *directory);
+
+void
+screenshot_destroy(struct screenshot *ss);
+
+bool
+screenshot_start(struct screenshot *ss);
+
+// the pending screenshots are still written
+void
+screenshot_stop(struct screenshot *ss);
+
+void
+screenshot_join(struct screenshot *ss);
+
+// capture the next rendered frame
+void
+screenshot_request(struct screenshot *ss);
+
+// called by the renderer for each frame consumed for rendering, before it is
+// released
+void
+screenshot_on_rendered_frame(struct screenshot *ss, const AVFrame *frame);
+
+#endif
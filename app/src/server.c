@@ -8,15 +8,20 @@
 #include <SDL2/SDL_thread.h>
 #include <SDL2/SDL_timer.h>
 #include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_rwops.h>
+#include <libavutil/hash.h>
+#include <libavutil/time.h>
 
 #include "config.h"
 #include "command.h"
+#include "util/buffer_util.h"
 #include "util/lock.h"
 #include "util/log.h"
 #include "util/net.h"
 #include "util/str_util.h"
 
 #define SOCKET_NAME "scrcpy"
+#define DAEMON_SOCKET_NAME "scrcpy-daemon"
 #define SERVER_FILENAME "scrcpy-server"
 
 #define DEFAULT_SERVER_PATH PREFIX "/share/scrcpy/" SERVER_FILENAME
@@ -88,8 +93,64 @@ get_server_path(void) {
 #endif
 }
 
+#define SHA256_HEX_LENGTH 64
+
+// write the SHA-256 of the file content, as a null-terminated hex string
+static bool
+compute_file_sha256(const char *path, char *hex) {
+    SDL_RWops *file = SDL_RWFromFile(path, "rb");
+    if (!file) {
+        LOGE("Could not open %s: %s", path, SDL_GetError());
+        return false;
+    }
+
+    struct AVHashContext *ctx;
+    if (av_hash_alloc(&ctx, "SHA256")) {
+        LOGC("Could not allocate hash context");
+        SDL_RWclose(file);
+        return false;
+    }
+    av_hash_init(ctx);
+
+    uint8_t buf[4096];
+    size_t r;
+    while ((r = SDL_RWread(file, buf, 1, sizeof(buf))) > 0) {
+        av_hash_update(ctx, buf, r);
+    }
+    SDL_RWclose(file);
+
+    av_hash_final_hex(ctx, (uint8_t *) hex, SHA256_HEX_LENGTH + 1);
+    av_hash_freep(&ctx);
+    return true;
+}
+
+// return true if the server on the device has the given SHA-256
 static bool
-push_server(const char *serial) {
+is_server_up_to_date(const char *serial, const char *hex) {
+    const char *const cmd[] = {"shell", "sha256sum", DEVICE_SERVER_PATH};
+    pipe_t pout;
+    process_t process = adb_execute_redirect(serial, cmd, ARRAY_LEN(cmd),
+                                             &pout);
+    if (process == PROCESS_NONE) {
+        return false;
+    }
+
+    // the output starts with the hex digest (if the file exists and
+    // sha256sum is available on the device, i.e. Android 6+)
+    char output[SHA256_HEX_LENGTH];
+    ssize_t r = cmd_read_pipe_all(pout, output, sizeof(output));
+    cmd_close_pipe(pout);
+    // ignore the exit code, the output is sufficient
+    cmd_simple_wait(process, NULL);
+
+    return r == SHA256_HEX_LENGTH
+        && !SDL_strncasecmp(output, hex, SHA256_HEX_LENGTH);
+}
+
+// start pushing the server to the device, unless an identical copy is
+// already there (in which case *process is set to PROCESS_NONE)
+static bool
+start_push_server(const char *serial, process_t *process) {
     char *server_path = get_server_path();
     if (!server_path) {
         return false;
@@ -99,9 +160,23 @@ push_server(const char *serial) {
         SDL_free(server_path);
         return false;
     }
-    process_t process = adb_push(serial, server_path, DEVICE_SERVER_PATH);
+
+    char hex[SHA256_HEX_LENGTH + 1];
+    if (compute_file_sha256(server_path, hex)
+            && is_server_up_to_date(serial, hex)) {
+        LOGD("Server already pushed: %s", hex);
+        SDL_free(server_path);
+        *process = PROCESS_NONE;
+        return true;
+    }
+
+    *process = adb_push(serial, server_path, DEVICE_SERVER_PATH);
     SDL_free(server_path);
-    return process_check_success(process, "adb push");
+    if (*process == PROCESS_NONE) {
+        LOGE("Could not execute \"adb push\"");
+        return false;
+    }
+    return true;
 }
 
 static bool
@@ -117,8 +192,9 @@ disable_tunnel_reverse(const char *serial) {
 }
 
 static bool
-enable_tunnel_forward(const char *serial, uint16_t local_port) {
-    process_t process = adb_forward(serial, local_port, SOCKET_NAME);
+enable_tunnel_forward(const char *serial, uint16_t local_port,
+                      const char *socket_name) {
+    process_t process = adb_forward(serial, local_port, socket_name);
     return process_check_success(process, "adb forward");
 }
 
@@ -192,9 +268,11 @@ static bool
 enable_tunnel_forward_any_port(struct server *server,
                                struct sc_port_range port_range) {
     server->tunnel_forward = true;
+    const char *socket_name = server->daemon ? DAEMON_SOCKET_NAME
+                                             : SOCKET_NAME;
     uint16_t port = port_range.first;
     for (;;) {
-        if (enable_tunnel_forward(server->serial, port)) {
+        if (enable_tunnel_forward(server->serial, port, socket_name)) {
             // success
             server->local_port = port;
             return true;
@@ -252,51 +330,116 @@ log_level_to_server_string(enum sc_log_level level) {
     }
 }
 
+static const char *
+codec_to_server_string(enum sc_codec codec) {
+    switch (codec) {
+        case SC_CODEC_H264:
+            return "h264";
+        case SC_CODEC_H265:
+            return "h265";
+        case SC_CODEC_AV1:
+            return "av1";
+        default:
+            assert(!"unexpected codec");
+            return "(unknown)";
+    }
+}
+
+static const char *
+encoder_profile_to_server_string(enum sc_encoder_profile profile) {
+    switch (profile) {
+        case SC_ENCODER_PROFILE_QUALITY:
+            return "quality";
+        case SC_ENCODER_PROFILE_LATENCY:
+            return "latency";
+        default:
+            assert(!"unexpected encoder profile");
+            return "(unknown)";
+    }
+}
+
+// the arguments of the server (after its class name), also sent to the
+// daemon for each session
+#define SERVER_ARG_COUNT 20
+
+struct server_args {
+    char max_size[6];
+    char bit_rate[11];
+    char max_fps[6];
+    char lock_video_orientation[5];
+    char display_id[6];
+    char preview_max_size[6];
+    char preview_bit_rate[11];
+    const char *argv[SERVER_ARG_COUNT];
+};
+
+static void
+server_args_init(struct server_args *args, const struct server_params *params,
+                 bool tunnel_forward) {
+    sprintf(args->max_size, "%"PRIu16, params->max_size);
+    sprintf(args->bit_rate, "%"PRIu32, params->bit_rate);
+    sprintf(args->max_fps, "%"PRIu16, params->max_fps);
+    sprintf(args->lock_video_orientation, "%"PRIi8,
+            params->lock_video_orientation);
+    sprintf(args->display_id, "%"PRIu16, params->display_id);
+    sprintf(args->preview_max_size, "%"PRIu16, params->preview_max_size);
+    sprintf(args->preview_bit_rate, "%"PRIu32, params->preview_bit_rate);
+
+    const char **argv = args->argv;
+    unsigned i = 0;
+    argv[i++] = SCRCPY_VERSION;
+    argv[i++] = log_level_to_server_string(params->log_level);
+    argv[i++] = args->max_size;
+    argv[i++] = args->bit_rate;
+    argv[i++] = args->max_fps;
+    argv[i++] = args->lock_video_orientation;
+    argv[i++] = tunnel_forward ? "true" : "false";
+    argv[i++] = params->crop ? params->crop : "-";
+    // always send frame meta (packet boundaries + timestamp)
+    argv[i++] = "true";
+    argv[i++] = params->control ? "true" : "false";
+    argv[i++] = args->display_id;
+    argv[i++] = params->show_touches ? "true" : "false";
+    argv[i++] = params->stay_awake ? "true" : "false";
+    argv[i++] = params->codec_options ? params->codec_options : "-";
+    argv[i++] = params->encoder_name ? params->encoder_name : "-";
+    argv[i++] = args->preview_max_size;
+    argv[i++] = args->preview_bit_rate;
+    // no UDP video port (datagrams are not forwarded by adb)
+    argv[i++] = "0";
+    argv[i++] = codec_to_server_string(params->video_codec);
+    argv[i++] = encoder_profile_to_server_string(params->encoder_profile);
+    assert(i == SERVER_ARG_COUNT);
+}
+
 static process_t
 execute_server_adb(struct server *server, const struct server_params *params) {
-    char max_size_string[6];
-    char bit_rate_string[11];
-    char max_fps_string[6];
-    char lock_video_orientation_string[5];
-    char display_id_string[6];
-    sprintf(max_size_string, "%"PRIu16, params->max_size);
-    sprintf(bit_rate_string, "%"PRIu32, params->bit_rate);
-    sprintf(max_fps_string, "%"PRIu16, params->max_fps);
-    sprintf(lock_video_orientation_string, "%"PRIi8, params->lock_video_orientation);
-    sprintf(display_id_string, "%"PRIu16, params->display_id);
-    const char *const cmd[] = {
-        "shell",
-        "CLASSPATH=" DEVICE_SERVER_PATH,
-        "app_process",
+    struct server_args args;
+    server_args_init(&args, params, server->tunnel_forward);
+
+    const char *cmd[6 + SERVER_ARG_COUNT];
+    size_t len = 0;
+    cmd[len++] = "shell";
+    cmd[len++] = "CLASSPATH=" DEVICE_SERVER_PATH;
+    cmd[len++] = "app_process";
 #ifdef SERVER_DEBUGGER
 # define SERVER_DEBUGGER_PORT "5005"
 # ifdef SERVER_DEBUGGER_METHOD_NEW
-        /* Android 9 and above */
-        "-XjdwpProvider:internal -XjdwpOptions:transport=dt_socket,suspend=y,server=y,address="
+    /* Android 9 and above */
+    cmd[len++] = "-XjdwpProvider:internal -XjdwpOptions:transport=dt_socket,"
+                 "suspend=y,server=y,address=" SERVER_DEBUGGER_PORT;
 # else
-        /* Android 8 and below */
-        "-agentlib:jdwp=transport=dt_socket,suspend=y,server=y,address="
+    /* Android 8 and below */
+    cmd[len++] = "-agentlib:jdwp=transport=dt_socket,suspend=y,server=y,"
+                 "address=" SERVER_DEBUGGER_PORT;
 # endif
-            SERVER_DEBUGGER_PORT,
 #endif
-        "/", // unused
-        "com.genymobile.scrcpy.Server",
-        SCRCPY_VERSION,
-        log_level_to_server_string(params->log_level),
-        max_size_string,
-        bit_rate_string,
-        max_fps_string,
-        lock_video_orientation_string,
-        server->tunnel_forward ? "true" : "false",
-        params->crop ? params->crop : "-",
-        "true", // always send frame meta (packet boundaries + timestamp)
-        params->control ? "true" : "false",
-        display_id_string,
-        params->show_touches ? "true" : "false",
-        params->stay_awake ? "true" : "false",
-        params->codec_options ? params->codec_options : "-",
-        params->encoder_name ? params->encoder_name : "-",
-    };
+    cmd[len++] = "/"; // unused
+    cmd[len++] = "com.genymobile.scrcpy.Server";
+    for (unsigned i = 0; i < SERVER_ARG_COUNT; ++i) {
+        cmd[len++] = args.argv[i];
+    }
+    assert(len <= ARRAY_LEN(cmd));
 #ifdef SERVER_DEBUGGER
     LOGI("Server debugger waiting for a client on device port "
          SERVER_DEBUGGER_PORT "...");
@@ -308,7 +451,7 @@ execute_server_adb(struct server *server, const struct server_params *params) {
     //     Port: 5005
     // Then click on "Debug"
 #endif
-    return adb_execute(server->serial, cmd, sizeof(cmd) / sizeof(cmd[0]));
+    return adb_execute(server->serial, (const char *const *) cmd, len);
 }
 
 static enum process_result
@@ -318,14 +461,24 @@ execute_server_curl(struct server *server, const struct server_params *params) {
     char max_fps_string[6];
     char lock_video_orientation_string[5];
     char display_id_string[6];
+    char preview_max_size_string[6];
+    char preview_bit_rate_string[11];
+    char video_udp_port_string[6];
     char url[1024];
     sprintf(max_size_string, "%"PRIu16, params->max_size);
     sprintf(bit_rate_string, "%"PRIu32, params->bit_rate);
     sprintf(max_fps_string, "%"PRIu16, params->max_fps);
     sprintf(lock_video_orientation_string, "%"PRIi8, params->lock_video_orientation);
     sprintf(display_id_string, "%"PRIu16, params->display_id);
+    sprintf(preview_max_size_string, "%"PRIu16, params->preview_max_size);
+    sprintf(preview_bit_rate_string, "%"PRIu32, params->preview_bit_rate);
+    // over UDP, the server receives the datagrams of the client on the same
+    // port number as the TCP connections
+    sprintf(video_udp_port_string, "%"PRIu16,
+            params->video_transport == SC_VIDEO_TRANSPORT_UDP
+                ? params->port_range.first : 0);
     snprintf(url, sizeof(url), 
-        "%s/startScrcpy/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s", 
+        "%s/startScrcpy/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s/%s", 
         server->url, 
         SCRCPY_VERSION,
         log_level_to_server_string(params->log_level),
@@ -341,7 +494,12 @@ execute_server_curl(struct server *server, const struct server_params *params) {
         params->show_touches ? "true" : "false",
         params->stay_awake ? "true" : "false",
         params->codec_options ? params->codec_options : "-",
-        params->encoder_name ? params->encoder_name : "-");
+        params->encoder_name ? params->encoder_name : "-",
+        preview_max_size_string,
+        preview_bit_rate_string,
+        video_udp_port_string,
+        codec_to_server_string(params->video_codec),
+        encoder_profile_to_server_string(params->encoder_profile));
 
     LOGI("%s\n", url);
 
@@ -385,13 +543,44 @@ stop_server_curl(struct server *server) {
     return PROCESS_ERROR_GENERIC;
 }
 
+static int
+run_stop_server_curl(void *data) {
+    struct server *server = data;
+    stop_server_curl(server); // ignore failure
+    return 0;
+}
+
+// the reply of the daemon to the hello of a session video socket (see
+// Daemon.java)
+enum daemon_reply {
+    DAEMON_REPLY_OK,
+    // another version, the daemon exits (it had no other session)
+    DAEMON_REPLY_VERSION_EXITING,
+    // another version, the daemon keeps running for its other sessions
+    DAEMON_REPLY_VERSION_BUSY,
+};
+
+// hello is sent before reading (it may be NULL)
+// with a hello (a daemon session), any reply other than DAEMON_REPLY_OK is a
+// failure, and it is stored in reply (if not NULL)
 static socket_t
-connect_and_read_byte(uint32_t addr, uint16_t port) {
-    socket_t socket = net_connect(addr, port);
+connect_and_read_byte(uint32_t addr, uint16_t port,
+                      const struct net_socket_profile *profile,
+                      const uint8_t *hello, size_t hello_len,
+                      enum daemon_reply *reply) {
+    socket_t socket = net_connect_profile(addr, port, profile);
     if (socket == INVALID_SOCKET) {
         return INVALID_SOCKET;
     }
 
+    if (hello_len) {
+        ssize_t w = net_send_all(socket, hello, hello_len);
+        if (w < 0 || (size_t) w != hello_len) {
+            net_close(socket);
+            return INVALID_SOCKET;
+        }
+    }
+
     char byte;
     // the connection may succeed even if the server behind the "adb tunnel"
     // is not listening, so read one byte to detect a working connection
@@ -400,25 +589,212 @@ connect_and_read_byte(uint32_t addr, uint16_t port) {
         net_close(socket);
         return INVALID_SOCKET;
     }
+    if (hello_len && byte != DAEMON_REPLY_OK) {
+        if (reply) {
+            *reply = (enum daemon_reply) byte;
+        }
+        net_close(socket);
+        return INVALID_SOCKET;
+    }
     return socket;
 }
 
+#define DGRAM_RECV_BUFFER_SIZE (2 * 1024 * 1024)
+
+// the first retry is almost immediate, then the delay is doubled after each
+// failed attempt (up to max_delay), so that the connection is established
+// shortly after the server is listening, without flooding the tunnel
+#define CONNECT_INITIAL_DELAY 5 // ms
+
 static socket_t
-connect_to_server(uint32_t addr, uint16_t port, uint32_t attempts, uint32_t delay) {
-    do {
-        LOGD("Remaining connection attempts: %d", (int) attempts);
-        socket_t socket = connect_and_read_byte(addr, port);
+connect_to_server(uint32_t addr, uint16_t port,
+                  const struct net_socket_profile *profile, uint32_t timeout,
+                  uint32_t max_delay, const uint8_t *hello, size_t hello_len) {
+    uint32_t deadline = SDL_GetTicks() + timeout;
+    uint32_t delay = CONNECT_INITIAL_DELAY;
+    unsigned attempts = 0;
+    for (;;) {
+        ++attempts;
+        socket_t socket = connect_and_read_byte(addr, port, profile, hello,
+                                                hello_len, NULL);
         if (socket != INVALID_SOCKET) {
             // it worked!
+            LOGD("Connected to server after %u attempt(s)", attempts);
             return socket;
         }
-        if (attempts) {
-            SDL_Delay(delay);
+
+        int32_t remaining = (int32_t) (deadline - SDL_GetTicks());
+        if (remaining <= 0) {
+            break;
+        }
+        if (delay > (uint32_t) remaining) {
+            delay = remaining;
+        }
+        SDL_Delay(delay);
+
+        delay *= 2;
+        if (delay > max_delay) {
+            delay = max_delay;
         }
-    } while (--attempts > 0);
+    }
+
+    LOGE("Could not connect to server after %u attempts", attempts);
     return INVALID_SOCKET;
 }
 
+// the roles of the sockets of a daemon session (see Daemon.java)
+enum daemon_socket_role {
+    DAEMON_SOCKET_VIDEO,
+    DAEMON_SOCKET_CONTROL,
+    DAEMON_SOCKET_PREVIEW,
+};
+
+#define DAEMON_HELLO_HEADER_SIZE 5 // role + session token
+#define DAEMON_HELLO_MAX_SIZE 2048
+
+// write the hello starting a daemon session socket (the server arguments are
+// only sent on the video socket)
+// return its length, or 0 if the arguments are too long
+static size_t
+serialize_daemon_hello(struct server *server, enum daemon_socket_role role,
+                       uint8_t buf[static DAEMON_HELLO_HEADER_SIZE]) {
+    buf[0] = role;
+    buffer_write32be(&buf[1], server->session_token);
+    if (role != DAEMON_SOCKET_VIDEO) {
+        return DAEMON_HELLO_HEADER_SIZE;
+    }
+
+    struct server_args args;
+    server_args_init(&args, &server->params, true);
+
+    // the arguments are separated by '\0', after their total length
+    size_t len = DAEMON_HELLO_HEADER_SIZE + 2;
+    for (unsigned i = 0; i < SERVER_ARG_COUNT; ++i) {
+        size_t arg_len = strlen(args.argv[i]);
+        size_t sep = i ? 1 : 0;
+        if (len + sep + arg_len > DAEMON_HELLO_MAX_SIZE) {
+            LOGE("Server arguments too long");
+            return 0;
+        }
+        if (sep) {
+            buf[len++] = '\0';
+        }
+        memcpy(&buf[len], args.argv[i], arg_len);
+        len += arg_len;
+    }
+    buffer_write16be(&buf[DAEMON_HELLO_HEADER_SIZE],
+                     len - DAEMON_HELLO_HEADER_SIZE - 2);
+    return len;
+}
+
+static socket_t
+connect_daemon_socket(struct server *server, enum daemon_socket_role role,
+                      const struct net_socket_profile *profile) {
+    socket_t socket = net_connect_profile(IPV4_LOCALHOST, server->local_port,
+                                          profile);
+    if (socket == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    uint8_t hello[DAEMON_HELLO_HEADER_SIZE];
+    size_t len = serialize_daemon_hello(server, role, hello);
+    ssize_t w = net_send_all(socket, hello, len);
+    if (w < 0 || (size_t) w != len) {
+        net_close(socket);
+        return INVALID_SOCKET;
+    }
+    return socket;
+}
+
+// push the server if necessary, and start it as a daemon (it exits
+// immediately if another one is already running)
+static bool
+start_daemon(struct server *server) {
+    process_t push;
+    if (!start_push_server(server->serial, &push)) {
+        return false;
+    }
+    if (push != PROCESS_NONE && !process_check_success(push, "adb push")) {
+        return false;
+    }
+
+    const char *const cmd[] = {
+        "shell",
+        "CLASSPATH=" DEVICE_SERVER_PATH,
+        // detached, so that it survives the adb command (and this client)
+        "nohup",
+        "app_process",
+        "/", // unused
+        "com.genymobile.scrcpy.Server",
+        SCRCPY_VERSION,
+        "daemon",
+        // the log level is global to the daemon
+        log_level_to_server_string(server->params.log_level),
+        ">/dev/null",
+        "2>&1",
+        "&",
+    };
+    process_t process = adb_execute(server->serial, cmd, ARRAY_LEN(cmd));
+    return process_check_success(process, "adb shell (daemon)");
+}
+
+static bool
+connect_to_daemon(struct server *server) {
+    uint8_t hello[DAEMON_HELLO_MAX_SIZE];
+    size_t len = serialize_daemon_hello(server, DAEMON_SOCKET_VIDEO, hello);
+    if (!len) {
+        return false;
+    }
+
+    // the daemon is typically already running, a single attempt is made
+    // before starting it (a daemon of another version exits on connection,
+    // unless it still runs other sessions)
+    enum daemon_reply reply = DAEMON_REPLY_OK;
+    server->video_socket =
+        connect_and_read_byte(IPV4_LOCALHOST, server->local_port,
+                              &server->video_profile, hello, len, &reply);
+    if (reply == DAEMON_REPLY_VERSION_BUSY) {
+        LOGE("The server daemon of another version is running other "
+             "sessions, close them or retry without --server-daemon");
+        return false;
+    }
+    if (server->video_socket == INVALID_SOCKET) {
+        LOGI("Starting the server daemon...");
+        if (!start_daemon(server)) {
+            return false;
+        }
+
+        uint32_t timeout = 10000; // ms
+        uint32_t max_delay = 100; // ms
+        server->video_socket =
+            connect_to_server(IPV4_LOCALHOST, server->local_port,
+                              &server->video_profile, timeout, max_delay,
+                              hello, len);
+        if (server->video_socket == INVALID_SOCKET) {
+            return false;
+        }
+    }
+
+    // the session is registered, the other sockets are attached to it
+    server->control_socket =
+        connect_daemon_socket(server, DAEMON_SOCKET_CONTROL,
+                              &server->control_profile);
+    if (server->control_socket == INVALID_SOCKET) {
+        return false;
+    }
+
+    if (server->preview) {
+        server->preview_socket =
+            connect_daemon_socket(server, DAEMON_SOCKET_PREVIEW,
+                                  &server->video_profile);
+        if (server->preview_socket == INVALID_SOCKET) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static void
 close_socket(socket_t socket) {
     assert(socket != INVALID_SOCKET);
@@ -434,6 +810,7 @@ server_init(struct server *server) {
     server->url = NULL;
     server->addr = 0;
     server->process = PROCESS_NONE;
+    server->stop_thread = NULL;
     server->wait_server_thread = NULL;
     atomic_flag_clear_explicit(&server->server_socket_closed,
                                memory_order_relaxed);
@@ -454,6 +831,12 @@ server_init(struct server *server) {
     server->server_socket = INVALID_SOCKET;
     server->video_socket = INVALID_SOCKET;
     server->control_socket = INVALID_SOCKET;
+    server->preview_socket = INVALID_SOCKET;
+    server->video_dgram_socket = INVALID_SOCKET;
+    server->video_udp = false;
+    server->preview = false;
+    server->video_profile = (struct net_socket_profile) {0};
+    server->control_profile = (struct net_socket_profile) {0};
 
     server->port_range.first = 0;
     server->port_range.last = 0;
@@ -462,6 +845,8 @@ server_init(struct server *server) {
     server->tunnel_enabled = false;
     server->tunnel_forward = false;
     server->direct = false;
+    server->daemon = false;
+    server->session_token = 0;
 
     return true;
 }
@@ -491,7 +876,20 @@ run_wait_server(void *data) {
 bool
 server_start(struct server *server, const char *serial,
              const struct server_params *params) {
+    server->params = *params;
     server->port_range = params->port_range;
+    server->preview = params->preview_bit_rate != 0;
+    server->video_udp = params->video_transport == SC_VIDEO_TRANSPORT_UDP;
+    assert(!server->video_udp || server->direct);
+
+    // the video stream is a throughput stream, with bursts on key frames
+    server->video_profile.nodelay = false;
+    server->video_profile.keepalive = true;
+    server->video_profile.recv_buffer_size = params->video_recv_buffer;
+    // the control messages (input events, clipboard) must not be delayed
+    server->control_profile.nodelay = true;
+    server->control_profile.keepalive = true;
+    server->control_profile.recv_buffer_size = 0;
 
     if (serial) {
         server->serial = SDL_strdup(serial);
@@ -500,20 +898,42 @@ server_start(struct server *server, const char *serial,
         }
     }
 
+    server->daemon = params->daemon;
+    if (server->daemon) {
+        // distinguish the sockets of concurrent sessions on the daemon
+        server->session_token =
+            (uint32_t) av_gettime() ^ (uint32_t) (uintptr_t) server;
+
+        // the daemon is started on connection, only if it is not running
+        if (!enable_tunnel_forward_any_port(server, params->port_range)) {
+            goto error1;
+        }
+        server->tunnel_enabled = true;
+        return true;
+    }
+
     if (server->direct) {
         // server will connect to our server socket
         if (execute_server_curl(server, params) != PROCESS_SUCCESS) {
             goto error2;
         }
     }else {
-        if (!push_server(serial)) {
+        process_t push;
+        if (!start_push_server(serial, &push)) {
             goto error1;
         }
 
-        if (!enable_tunnel_any_port(server, params->port_range,
-                                    params->force_adb_forward)) {
+        // the tunnel does not depend on the server, enable it meanwhile
+        bool tunnel_ok = enable_tunnel_any_port(server, params->port_range,
+                                                params->force_adb_forward);
+        bool push_ok = push == PROCESS_NONE
+                    || process_check_success(push, "adb push");
+        if (!tunnel_ok) {
             goto error1;
         }
+        if (!push_ok) {
+            goto error2;
+        }
 
         // server will connect to our server socket
         server->process = execute_server_adb(server, params);
@@ -556,44 +976,96 @@ error2:
     }
 error1:
     SDL_free(server->serial);
+    // released again by server_destroy()
+    server->serial = NULL;
     return false;
 }
 
 bool
 server_connect_to(struct server *server) {
     if(server->direct) {
-        uint32_t attempts = 12;
-        uint32_t delay = 1000; // ms
-        server->video_socket =
-            connect_to_server(server->addr, server->port_range.first, attempts, delay);
+        uint32_t timeout = 12000; // ms
+        uint32_t max_delay = 1000; // ms
+        server->video_socket = connect_to_server(server->addr,
+                                                 server->port_range.first,
+                                                 &server->video_profile,
+                                                 timeout, max_delay, NULL, 0);
         if (server->video_socket == INVALID_SOCKET) {
             return false;
         }
 
         // we know that the device is listening, we don't need several attempts
         server->control_socket =
-            net_connect(server->addr, server->port_range.first);
+            net_connect_profile(server->addr, server->port_range.first,
+                                &server->control_profile);
         if (server->control_socket == INVALID_SOCKET) {
             return false;
         }
-        
+
+        if (server->preview) {
+            server->preview_socket =
+                net_connect_profile(server->addr, server->port_range.first,
+                                    &server->video_profile);
+            if (server->preview_socket == INVALID_SOCKET) {
+                return false;
+            }
+        }
+
+        if (server->video_udp) {
+            // a key frame is received at once, the datagrams which do not fit
+            // in the buffer are lost
+            struct net_socket_profile profile = {
+                .recv_buffer_size = server->video_profile.recv_buffer_size
+                                  ? server->video_profile.recv_buffer_size
+                                  : DGRAM_RECV_BUFFER_SIZE,
+            };
+            server->video_dgram_socket =
+                net_udp_connect(server->addr, server->port_range.first,
+                                &profile);
+            if (server->video_dgram_socket == INVALID_SOCKET) {
+                return false;
+            }
+        }
+
+        return true;
+    } else if (server->daemon) {
+        if (!connect_to_daemon(server)) {
+            return false;
+        }
+
+        // we don't need the adb tunnel anymore
+        disable_tunnel(server); // ignore failure
+        server->tunnel_enabled = false;
+
         return true;
     } else if (server->tunnel_forward) {
-        uint32_t attempts = 100;
-        uint32_t delay = 100; // ms
-        server->video_socket =
-            connect_to_server(IPV4_LOCALHOST, server->local_port, attempts, delay);
+        uint32_t timeout = 10000; // ms
+        uint32_t max_delay = 100; // ms
+        server->video_socket = connect_to_server(IPV4_LOCALHOST,
+                                                 server->local_port,
+                                                 &server->video_profile,
+                                                 timeout, max_delay, NULL, 0);
         if (server->video_socket == INVALID_SOCKET) {
             return false;
         }
 
         // we know that the device is listening, we don't need several attempts
         server->control_socket =
-            net_connect(IPV4_LOCALHOST, server->local_port);
+            net_connect_profile(IPV4_LOCALHOST, server->local_port,
+                                &server->control_profile);
         if (server->control_socket == INVALID_SOCKET) {
             return false;
         }
 
+        if (server->preview) {
+            server->preview_socket =
+                net_connect_profile(IPV4_LOCALHOST, server->local_port,
+                                    &server->video_profile);
+            if (server->preview_socket == INVALID_SOCKET) {
+                return false;
+            }
+        }
+
         // we don't need the adb tunnel anymore
         disable_tunnel(server); // ignore failure
         server->tunnel_enabled = false;
@@ -604,12 +1076,22 @@ server_connect_to(struct server *server) {
         if (server->video_socket == INVALID_SOCKET) {
             return false;
         }
+        net_apply_profile(server->video_socket, &server->video_profile);
 
         server->control_socket = net_accept(server->server_socket);
         if (server->control_socket == INVALID_SOCKET) {
             // the video_socket will be cleaned up on destroy
             return false;
         }
+        net_apply_profile(server->control_socket, &server->control_profile);
+
+        if (server->preview) {
+            server->preview_socket = net_accept(server->server_socket);
+            if (server->preview_socket == INVALID_SOCKET) {
+                return false;
+            }
+            net_apply_profile(server->preview_socket, &server->video_profile);
+        }
 
         // we don't need the server socket anymore
         if (!atomic_flag_test_and_set(&server->server_socket_closed)) {
@@ -634,16 +1116,32 @@ server_stop(struct server *server) {
     if (server->control_socket != INVALID_SOCKET) {
         close_socket(server->control_socket);
     }
-
-    assert(server->process != PROCESS_NONE);
+    if (server->preview_socket != INVALID_SOCKET) {
+        close_socket(server->preview_socket);
+    }
 
     if (server->tunnel_enabled && !server->direct) {
         // ignore failure
         disable_tunnel(server);
     }
 
+    if (server->daemon) {
+        // the daemon ends the session on socket close, and keeps running for
+        // the next ones
+        return;
+    }
+
+    assert(server->process != PROCESS_NONE);
+
     if (server->direct) {
-        stop_server_curl(server);
+        // do not block the shutdown of the session on the request, it is
+        // joined on destroy
+        server->stop_thread =
+            SDL_CreateThread(run_stop_server_curl, "stop-server", server);
+        if (!server->stop_thread) {
+            LOGW("Could not start stop-server thread");
+            stop_server_curl(server);
+        }
     }
 
     // Give some delay for the server to terminate properly
@@ -671,8 +1169,49 @@ server_stop(struct server *server) {
     SDL_WaitThread(server->wait_server_thread, NULL);
 }
 
+bool
+server_restart(struct server *server) {
+    // the sockets have been closed by server_stop()
+    server->server_socket = INVALID_SOCKET;
+    server->video_socket = INVALID_SOCKET;
+    server->control_socket = INVALID_SOCKET;
+    server->preview_socket = INVALID_SOCKET;
+    // the stream thread does not read it anymore, it waits for the new one
+    if (server->video_dgram_socket != INVALID_SOCKET) {
+        net_close(server->video_dgram_socket);
+        server->video_dgram_socket = INVALID_SOCKET;
+    }
+    if (server->stop_thread) {
+        // the previous server must be stopped before the new one is started
+        SDL_WaitThread(server->stop_thread, NULL);
+        server->stop_thread = NULL;
+    }
+
+    server->process = PROCESS_NONE;
+    server->wait_server_thread = NULL;
+    server->process_terminated = false;
+    atomic_flag_clear_explicit(&server->server_socket_closed,
+                               memory_order_relaxed);
+    server->tunnel_enabled = false;
+
+    // server_start() copies the serial again (and releases it on error)
+    char *serial = server->serial;
+    server->serial = NULL;
+    bool ok = server_start(server, serial, &server->params);
+    SDL_free(serial);
+    return ok;
+}
+
 void
 server_destroy(struct server *server) {
+    // closed only once the stream thread is joined (it is woken up by the
+    // video socket shutdown)
+    if (server->video_dgram_socket != INVALID_SOCKET) {
+        net_close(server->video_dgram_socket);
+    }
+    if (server->stop_thread) {
+        SDL_WaitThread(server->stop_thread, NULL);
+    }
     SDL_free(server->serial);
     SDL_free(server->url);
     SDL_DestroyCond(server->process_terminated_cond);
@@ -13,12 +13,41 @@
 #include "util/log.h"
 #include "util/net.h"
 
+struct server_params {
+    enum sc_log_level log_level;
+    const char *crop;
+    const char *codec_options;
+    const char *encoder_name;
+    struct sc_port_range port_range;
+    uint16_t max_size;
+    uint32_t bit_rate;
+    uint16_t max_fps;
+    int8_t lock_video_orientation;
+    bool control;
+    uint16_t display_id;
+    bool show_touches;
+    bool stay_awake;
+    bool force_adb_forward;
+    // a second, independently downscaled stream (disabled if the bit rate is
+    // 0)
+    uint16_t preview_max_size;
+    uint32_t preview_bit_rate;
+    uint32_t video_recv_buffer; // 0 for the system default
+    enum sc_video_transport video_transport;
+    enum sc_codec video_codec;
+    enum sc_encoder_profile encoder_profile;
+    // connect to a resident server on the device (started if necessary),
+    // instead of starting a server process for the session
+    bool daemon;
+};
+
 struct server {
     char *serial;
     char *url;
     uint32_t addr;
     process_t process;
     SDL_Thread *wait_server_thread;
+    SDL_Thread *stop_thread; // only used in direct mode
     atomic_flag server_socket_closed;
 
     SDL_mutex *mutex;
@@ -28,28 +57,21 @@ struct server {
     socket_t server_socket; // only used if !tunnel_forward
     socket_t video_socket;
     socket_t control_socket;
+    socket_t preview_socket; // only used if a preview stream is requested
+    // only used over UDP (the video socket only receives the header)
+    socket_t video_dgram_socket;
+    bool preview;
+    bool video_udp;
+    struct net_socket_profile video_profile; // also for the preview socket
+    struct net_socket_profile control_profile;
     struct sc_port_range port_range;
     uint16_t local_port; // selected from port_range
     bool tunnel_enabled;
     bool tunnel_forward; // use "adb forward" instead of "adb reverse"
     bool direct;
-};
-
-struct server_params {
-    enum sc_log_level log_level;
-    const char *crop;
-    const char *codec_options;
-    const char *encoder_name;
-    struct sc_port_range port_range;
-    uint16_t max_size;
-    uint32_t bit_rate;
-    uint16_t max_fps;
-    int8_t lock_video_orientation;
-    bool control;
-    uint16_t display_id;
-    bool show_touches;
-    bool stay_awake;
-    bool force_adb_forward;
+    bool daemon; // see server_params
+    uint32_t session_token; // only used with a daemon
+    struct server_params params; // to restart the server
 };
 
 // init default values
@@ -69,6 +91,13 @@ server_connect_to(struct server *server);
 void
 server_stop(struct server *server);
 
+// start the server again (on the same device, with the same parameters), once
+// it has been stopped by server_stop()
+//
+// The sockets are released, server_connect_to() must then be called.
+bool
+server_restart(struct server *server);
+
 // close and release sockets
 void
 server_destroy(struct server *server);
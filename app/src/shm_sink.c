@@ -0,0 +1,144 @@
+#include "shm_sink.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <libavutil/frame.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+#include "config.h"
+#include "util/log.h"
+
+static_assert(sizeof(struct shm_sink_header) == 64, "unexpected header size");
+static_assert(sizeof(struct shm_sink_slot_header) == 64,
+              "unexpected slot header size");
+
+// enough for any 4:2:0 format up to 16 bits per sample (typically P010)
+#define MAX_BYTES_PER_PIXEL 3
+
+bool
+shm_sink_init(struct shm_sink *sink, const char *name,
+              struct size frame_size) {
+    size_t side = MAX(frame_size.width, frame_size.height);
+    size_t data_size = side * side * MAX_BYTES_PER_PIXEL;
+    // keep the slots aligned
+    sink->slot_size = (sizeof(struct shm_sink_slot_header) + data_size + 63)
+                    & ~(size_t) 63;
+
+    size_t size = sizeof(struct shm_sink_header)
+                + SHM_SINK_SLOT_COUNT * sink->slot_size;
+    if (!sc_shm_create(&sink->shm, name, size)) {
+        return false;
+    }
+
+    struct shm_sink_header *header = sink->shm.data;
+    memcpy(header->magic, SHM_SINK_MAGIC, sizeof(header->magic));
+    header->version = SHM_SINK_VERSION;
+    header->slot_count = SHM_SINK_SLOT_COUNT;
+    header->slot_size = sink->slot_size;
+    atomic_init(&header->latest, 0);
+    sink->header = header;
+
+    sink->seq = 0;
+    sink->sw_frame = NULL;
+    sink->warned = false;
+
+    LOGI("Publishing frames to shared memory %s (%" PRIu64 " bytes)", name,
+         (uint64_t) size);
+    return true;
+}
+
+void
+shm_sink_destroy(struct shm_sink *sink) {
+    av_frame_free(&sink->sw_frame);
+    sc_shm_destroy(&sink->shm);
+}
+
+static struct shm_sink_slot_header *
+get_slot(struct shm_sink *sink, uint64_t seq) {
+    uint8_t *slots = (uint8_t *) (sink->header + 1);
+    size_t index = (seq - 1) % SHM_SINK_SLOT_COUNT;
+    return (struct shm_sink_slot_header *) (slots + index * sink->slot_size);
+}
+
+// return a frame readable from the CPU
+static const AVFrame *
+get_sw_frame(struct shm_sink *sink, const AVFrame *frame) {
+    if (!frame->hw_frames_ctx) {
+        return frame;
+    }
+
+    if (!sink->sw_frame) {
+        sink->sw_frame = av_frame_alloc();
+        if (!sink->sw_frame) {
+            LOGC("Could not allocate frame");
+            return NULL;
+        }
+    }
+
+    int ret = av_hwframe_transfer_data(sink->sw_frame, frame, 0);
+    if (ret < 0) {
+        LOGE("Could not download hardware frame: %d", ret);
+        return NULL;
+    }
+    sink->sw_frame->pts = frame->pts;
+    return sink->sw_frame;
+}
+
+void
+shm_sink_push(struct shm_sink *sink, const AVFrame *frame) {
+    const AVFrame *sw_frame = get_sw_frame(sink, frame);
+    if (!sw_frame) {
+        return;
+    }
+
+    int size = av_image_get_buffer_size(sw_frame->format, sw_frame->width,
+                                        sw_frame->height, 1);
+    if (size < 0 || (size_t) size
+            > sink->slot_size - sizeof(struct shm_sink_slot_header)) {
+        if (!sink->warned) {
+            LOGW("Frame too big for the shared memory slots, not published");
+            sink->warned = true;
+        }
+        goto end;
+    }
+
+    uint64_t seq = ++sink->seq;
+    struct shm_sink_slot_header *slot = get_slot(sink, seq);
+    uint8_t *dst = (uint8_t *) (slot + 1);
+
+    // invalidate the slot before overwriting it (seqlock)
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    av_image_copy_to_buffer(dst, size,
+                            (const uint8_t *const *) sw_frame->data,
+                            sw_frame->linesize, sw_frame->format,
+                            sw_frame->width, sw_frame->height, 1);
+
+    uint8_t *planes[4];
+    int linesizes[4];
+    av_image_fill_arrays(planes, linesizes, dst, sw_frame->format,
+                         sw_frame->width, sw_frame->height, 1);
+    unsigned plane_count = av_pix_fmt_count_planes(sw_frame->format);
+    for (unsigned i = 0; i < 4; ++i) {
+        bool used = i < plane_count;
+        slot->linesize[i] = used ? linesizes[i] : 0;
+        slot->offset[i] = used ? planes[i] - (uint8_t *) slot : 0;
+    }
+    slot->pts = sw_frame->pts;
+    slot->width = sw_frame->width;
+    slot->height = sw_frame->height;
+    slot->format = sw_frame->format;
+    slot->plane_count = plane_count;
+
+    atomic_store_explicit(&slot->seq, seq, memory_order_release);
+    atomic_store_explicit(&sink->header->latest, seq, memory_order_release);
+
+end:
+    if (sw_frame != frame) {
+        av_frame_unref(sink->sw_frame);
+    }
+}
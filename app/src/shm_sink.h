@@ -0,0 +1,83 @@
+#ifndef SHM_SINK_H
+#define SHM_SINK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "common.h"
+#include "util/shm.h"
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+// Publish the decoded frames into a shared memory ring, so that local
+// processes (typically computer vision tools) read them without decoding the
+// stream again, nor grabbing the window.
+//
+// All the fields are in the native byte order. The region starts with a
+// header:
+//
+//     struct shm_sink_header (64 bytes)
+//
+// followed by slot_count slots of slot_size bytes, each one starting with:
+//
+//     struct shm_sink_slot_header (64 bytes)
+//
+// followed by the planes of the frame, packed (without padding between the
+// rows), at the given offsets from the start of the slot.
+//
+// The frame N is written to the slot (N - 1) % slot_count. The slot seq is 0
+// while it is written, and N once complete. To read the last frame, a reader
+// loads latest, reads the slot seq (it must be latest), reads the frame in
+// place, then checks that the slot seq has not changed (otherwise the frame
+// has been overwritten meanwhile, and must be discarded).
+#define SHM_SINK_MAGIC "SCRCPYFR"
+#define SHM_SINK_VERSION 1
+#define SHM_SINK_SLOT_COUNT 3
+
+struct shm_sink_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slot_size; // including the slot header
+    // the seq of the last complete frame (0 if none)
+    atomic_uint_least64_t latest;
+    uint8_t reserved[32];
+};
+
+struct shm_sink_slot_header {
+    atomic_uint_least64_t seq;
+    int64_t pts; // in microseconds, relative to the first frame
+    uint32_t width;
+    uint32_t height;
+    int32_t format; // the FFmpeg AVPixelFormat value
+    uint32_t plane_count;
+    uint32_t linesize[4];
+    uint32_t offset[4];
+};
+
+struct shm_sink {
+    struct sc_shm shm;
+    struct shm_sink_header *header;
+    size_t slot_size;
+    uint64_t seq;
+    // downloaded hardware frames, lazily allocated
+    AVFrame *sw_frame;
+    bool warned;
+};
+
+// the slots are large enough for the frame in both orientations
+bool
+shm_sink_init(struct shm_sink *sink, const char *name,
+              struct size frame_size);
+
+void
+shm_sink_destroy(struct shm_sink *sink);
+
+// copy the frame to the next slot, called by the decoder
+void
+shm_sink_push(struct shm_sink *sink, const AVFrame *frame);
+
+#endif
@@ -1,6 +1,7 @@
 #include "stream.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <libavformat/avformat.h>
 #include <libavutil/time.h>
 #include <SDL2/SDL_events.h>
@@ -9,17 +10,105 @@
 #include <unistd.h>
 
 #include "config.h"
+#include "annexb_input.h"
+#include "common.h"
 #include "compat.h"
+#include "controller.h"
 #include "decoder.h"
 #include "events.h"
+#include "h264_nal.h"
 #include "recorder.h"
+#include "relay.h"
+#include "replay_buffer.h"
+#include "trace.h"
 #include "util/buffer_util.h"
+#include "util/lock.h"
 #include "util/log.h"
 
 #define BUFSIZE 0x10000
 
-#define HEADER_SIZE 12
+#define HEADER_SIZE 20
 #define NO_PTS UINT64_C(-1)
+// set by the server in the PTS field, so that key frames are detected without
+// parsing the bitstream of any codec
+#define PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+// over UDP, until the first datagram is received
+#define HELLO_INTERVAL_MS 100
+#define KEY_FRAME_REQUEST_INTERVAL_US 200000
+
+static void
+adapt_bit_rate(struct stream *stream, size_t size) {
+    struct adaptive_bit_rate *abr = &stream->adaptive_bit_rate;
+    if (!adaptive_bit_rate_add_packet(abr, size, stream->capture_time,
+                                      stream->recv_time)) {
+        return;
+    }
+
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_SET_BIT_RATE;
+    msg.set_bit_rate.bit_rate = abr->bit_rate;
+    if (!controller_push_msg(stream->controller, &msg)) {
+        LOGW("Could not request 'set bit rate'");
+    }
+}
+
+// The pending config packets must be prepended to the next data packet:
+// reserve headroom for them, so that the frame is received in place (at
+// offset).
+static bool
+stream_alloc_packet(struct stream *stream, AVPacket *packet, bool is_config,
+                    size_t len, size_t *offset) {
+    *offset = !is_config && stream->has_pending ? stream->pending.size : 0;
+
+    if (!packet_pool_get(&stream->packet_pool, packet, *offset + len)) {
+        return false;
+    }
+
+    if (*offset) {
+        // only copy the config bytes (a few dozens), not the frame
+        memcpy(packet->data, stream->pending.data, *offset);
+        stream->has_pending = false;
+        av_packet_unref(&stream->pending);
+    }
+
+    return true;
+}
+
+static void
+stream_set_packet_meta(struct stream *stream, AVPacket *packet, uint64_t pts,
+                       uint64_t capture_time, size_t len) {
+    stream->recv_time = av_gettime_relative();
+    stream->capture_time = 0;
+    if (capture_time && stream->clock_sync) {
+        int64_t local_time;
+        if (clock_sync_to_local(stream->clock_sync, (int64_t) capture_time,
+                                &local_time)) {
+            stream->capture_time = local_time;
+        }
+    }
+    if (pts == NO_PTS) {
+        packet->pts = AV_NOPTS_VALUE;
+    } else {
+        if (pts & PACKET_FLAG_KEY_FRAME) {
+            packet->flags |= AV_PKT_FLAG_KEY;
+        }
+        packet->pts = (int64_t) (pts & ~PACKET_FLAG_KEY_FRAME);
+        if (stream->rebase_pts) {
+            // continue after the last packet of the previous connection, as
+            // if the stream had been paused meanwhile
+            int64_t gap = MAX(stream->recv_time - stream->disconnect_time, 1);
+            stream->pts_offset = stream->last_pts + gap - packet->pts;
+            stream->rebase_pts = false;
+        }
+        packet->pts += stream->pts_offset;
+        stream->last_pts = packet->pts;
+    }
+
+    if (stream->controller && stream->adapt_bit_rate) {
+        adapt_bit_rate(stream, len);
+    }
+}
 
 static bool
 stream_recv_packet(struct stream *stream, AVPacket *packet) {
@@ -27,63 +116,266 @@ stream_recv_packet(struct stream *stream, AVPacket *packet) {
     // record, we retrieve the timestamps separately, from a "meta" header
     // added by the server before each raw packet.
     //
-    // The "meta" header length is 12 bytes:
-    // [. . . . . . . .|. . . .]. . . . . . . . . . . . . . . ...
-    //  <-------------> <-----> <-----------------------------...
-    //        PTS        packet        raw packet
-    //                    size
+    // The "meta" header length is 20 bytes:
+    // [. . . . . . . .|. . . . . . . .|. . . .]. . . . . . . . . . . . . ...
+    //  <-------------> <-------------> <-----> <-------------------------...
+    //        PTS         capture time   packet         raw packet
+    //                                    size
+    //
+    // The most significant bit of the PTS is never set. The next one is set
+    // for key frames (PACKET_FLAG_KEY_FRAME).
+    //
+    // The capture time is expressed in the device monotonic clock (0 for
+    // config packets).
     //
     // It is followed by <packet_size> bytes containing the packet/frame.
 
     uint8_t header[HEADER_SIZE];
-    ssize_t r = net_recv_all(stream->socket, header, HEADER_SIZE);
-    if (r < HEADER_SIZE) {
+    if (!net_reader_read_all(&stream->reader, header, HEADER_SIZE)) {
         return false;
     }
 
     uint64_t pts = buffer_read64be(header);
-    uint32_t len = buffer_read32be(&header[8]);
+    uint64_t capture_time = buffer_read64be(&header[8]);
+    uint32_t len = buffer_read32be(&header[16]);
     assert(pts == NO_PTS || (pts & 0x8000000000000000) == 0);
     assert(len);
 
-    if (av_new_packet(packet, len)) {
-        LOGE("Could not allocate packet");
+    size_t offset;
+    if (!stream_alloc_packet(stream, packet, pts == NO_PTS, len, &offset)) {
         return false;
     }
 
-    r = net_recv_all(stream->socket, packet->data, len);
-    if (r < 0 || ((uint32_t) r) < len) {
+    if (!net_reader_read_all(&stream->reader, packet->data + offset, len)) {
         av_packet_unref(packet);
         return false;
     }
 
-    packet->pts = pts != NO_PTS ? (int64_t) pts : AV_NOPTS_VALUE;
-
+    stream_set_packet_meta(stream, packet, pts, capture_time, len);
     return true;
 }
 
 static void
-notify_stopped(void) {
+notify_stopped(struct stream *stream) {
     SDL_Event stop_event;
     stop_event.type = EVENT_STREAM_STOPPED;
+    stop_event.user.data1 = stream;
     SDL_PushEvent(&stop_event);
 }
 
+static void
+notify_disconnected(struct stream *stream) {
+    SDL_Event event;
+    event.type = EVENT_STREAM_DISCONNECTED;
+    event.user.data1 = stream;
+    SDL_PushEvent(&event);
+}
+
 static bool
 process_config_packet(struct stream *stream, AVPacket *packet) {
     if (stream->recorder && !recorder_push(stream->recorder, packet)) {
         LOGE("Could not send config packet to recorder");
         return false;
     }
+    if (stream->replay_buffer
+            && !replay_buffer_push(stream->replay_buffer, packet)) {
+        LOGE("Could not send config packet to replay buffer");
+        return false;
+    }
+    if (stream->relay && !relay_push(stream->relay, packet)) {
+        LOGE("Could not send config packet to relay");
+        return false;
+    }
     return true;
 }
 
+static void
+request_key_frame(struct stream *stream) {
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_REQUEST_KEY_FRAME;
+    if (!controller_push_msg(stream->controller, &msg)) {
+        LOGW("Could not request 'request key frame'");
+    }
+}
+
+static void
+request_key_frame_on_loss(struct stream *stream) {
+    if (!stream->controller) {
+        // wait for the periodic one
+        return;
+    }
+
+    int64_t now = av_gettime_relative();
+    if (stream->last_key_frame_request
+            && now - stream->last_key_frame_request
+                < KEY_FRAME_REQUEST_INTERVAL_US) {
+        // the previous request is probably in progress
+        return;
+    }
+    stream->last_key_frame_request = now;
+    request_key_frame(stream);
+}
+
+// the server learns our address (possibly translated by a NAT) from this
+// datagram
+static void
+send_hello(struct stream *stream) {
+    static const char hello[] = "scrcpy";
+    net_send(stream->dgram_socket, hello, sizeof(hello) - 1);
+}
+
 static bool
-process_frame(struct stream *stream, AVPacket *packet) {
-    if (stream->decoder && !decoder_push(stream->decoder, packet)) {
+stream_recv_datagram_packet(struct stream *stream, AVPacket *packet) {
+    uint8_t dgram[FRAME_REASSEMBLER_MAX_DATAGRAM];
+    for (;;) {
+        int r = net_wait_readable(stream->dgram_socket, stream->socket,
+                                  HELLO_INTERVAL_MS);
+        if (r < 0) {
+            LOGE("Could not wait for datagrams");
+            return false;
+        }
+        if (r & 2) {
+            // nothing is sent on the video socket after the device info, it
+            // is only readable once closed
+            return false;
+        }
+        if (!r) {
+            if (!stream->dgram_received) {
+                // it may have been lost
+                send_hello(stream);
+            }
+            continue;
+        }
+
+        ssize_t len = net_recv(stream->dgram_socket, dgram, sizeof(dgram));
+        if (len < 0) {
+            // typically the ICMP error for a hello sent before the server
+            // was listening
+            continue;
+        }
+        stream->dgram_received = true;
+
+        struct reassembled_frame frame;
+        int ret = frame_reassembler_push(&stream->reassembler, dgram, len,
+                                         &frame);
+        if (ret < 0) {
+            return false;
+        }
+
+        if (stream->reassembler.lost_reference) {
+            stream->reassembler.lost_reference = false;
+            if (!stream->wait_key_frame) {
+                LOGW("Video packets lost, waiting for a key frame");
+                stream->wait_key_frame = true;
+            }
+            request_key_frame_on_loss(stream);
+        }
+
+        if (!ret) {
+            continue;
+        }
+
+        bool is_config = frame.pts == NO_PTS;
+        if (stream->wait_key_frame && !is_config) {
+            if (!(frame.pts & PACKET_FLAG_KEY_FRAME)) {
+                // it may reference a lost frame, it would be decoded with
+                // artifacts
+                request_key_frame_on_loss(stream);
+                continue;
+            }
+            LOGD("Key frame received");
+            stream->wait_key_frame = false;
+        }
+
+        size_t offset;
+        if (!stream_alloc_packet(stream, packet, is_config, frame.size,
+                                 &offset)) {
+            return false;
+        }
+        memcpy(packet->data + offset, frame.data, frame.size);
+
+        stream_set_packet_meta(stream, packet, frame.pts, frame.capture_time,
+                               frame.size);
+        return true;
+    }
+}
+
+static bool
+stream_recv_annexb_packet(struct stream *stream, AVPacket *packet) {
+    struct annexb_unit unit;
+    if (!annexb_input_read(stream->input, &unit)) {
         return false;
     }
 
+    uint64_t pts = NO_PTS;
+    if (!unit.config) {
+        // Annex B has no timestamps, use the reception time (strictly
+        // increasing, several units may be split from the same read)
+        int64_t now = av_gettime_relative();
+        if (!stream->input_start_time) {
+            stream->input_start_time = now;
+        }
+        int64_t input_pts = now - stream->input_start_time;
+        if (input_pts <= stream->input_last_pts) {
+            input_pts = stream->input_last_pts + 1;
+        }
+        stream->input_last_pts = input_pts;
+        pts = (uint64_t) input_pts;
+        if (h264_is_key_frame(unit.data, unit.size)) {
+            pts |= PACKET_FLAG_KEY_FRAME;
+        }
+    }
+
+    size_t offset;
+    if (!stream_alloc_packet(stream, packet, unit.config, unit.size,
+                             &offset)) {
+        return false;
+    }
+    memcpy(packet->data + offset, unit.data, unit.size);
+
+    stream_set_packet_meta(stream, packet, pts, 0, unit.size);
+    return true;
+}
+
+// tell whether the packet must not be decoded, because the decoding is (or
+// has just been) paused
+static bool
+skip_decoding(struct stream *stream, const AVPacket *packet) {
+    if (atomic_load_explicit(&stream->decoding_paused,
+                             memory_order_relaxed)) {
+        // the next decoded frame must not reference a skipped one
+        stream->resync_decoder = true;
+        return true;
+    }
+
+    if (stream->resync_decoder) {
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+            request_key_frame_on_loss(stream);
+            return true;
+        }
+        LOGD("Key frame received, decoding resumed");
+        stream->resync_decoder = false;
+    }
+
+    return false;
+}
+
+static bool
+process_frame(struct stream *stream, AVPacket *packet) {
+    if (stream->decoder && !skip_decoding(stream, packet)
+            && !decoder_push(stream->decoder, packet, stream->recv_time,
+                             stream->capture_time)) {
+        // Do not stop on a decoding error: the decoder drops the packets
+        // until the next key frame, request it immediately rather than
+        // waiting for the periodic one (possibly 10 seconds later)
+        if (stream->controller) {
+            LOGW("Decoding error, requesting a key frame");
+            request_key_frame(stream);
+        } else {
+            LOGW("Decoding error, waiting for the next key frame");
+        }
+    }
+
     if (stream->recorder) {
         packet->dts = packet->pts;
 
@@ -93,18 +385,57 @@ process_frame(struct stream *stream, AVPacket *packet) {
         }
     }
 
+    if (stream->replay_buffer
+            && !replay_buffer_push(stream->replay_buffer, packet)) {
+        LOGE("Could not send packet to replay buffer");
+        return false;
+    }
+
+    if (stream->relay && !relay_push(stream->relay, packet)) {
+        LOGE("Could not send packet to relay");
+        return false;
+    }
+
     return true;
 }
 
+// tell whether the packet contains a frame which is not referenced by the next
+// ones (it may be skipped by the decoder if it is late)
+static bool
+is_disposable(struct stream *stream, const AVPacket *packet) {
+    if (stream->codec_id != AV_CODEC_ID_H264
+            || packet->flags & AV_PKT_FLAG_KEY) {
+        return false;
+    }
+
+    // a pending config packet may have been prepended, it must be decoded
+    size_t offset = h264_find_nal(packet->data, packet->size);
+    if (offset >= (size_t) packet->size
+            || H264_NAL_TYPE(packet->data[offset]) != H264_NAL_SLICE) {
+        return false;
+    }
+
+    return !h264_is_reference(packet->data, packet->size);
+}
+
 static bool
 stream_parse(struct stream *stream, AVPacket *packet) {
+    if (!stream->parser) {
+        // Nothing is decoded (record only), or the packets are split from an
+        // Annex B input: the parser would only be used to detect the key
+        // frames, which are already flagged
+        return process_frame(stream, packet);
+    }
+
     uint8_t *in_data = packet->data;
     int in_len = packet->size;
     uint8_t *out_data = NULL;
     int out_len = 0;
+    trace_begin("parse");
     int r = av_parser_parse2(stream->parser, stream->codec_ctx,
                              &out_data, &out_len, in_data, in_len,
                              AV_NOPTS_VALUE, AV_NOPTS_VALUE, -1);
+    trace_end();
 
     // PARSER_FLAG_COMPLETE_FRAMES is set
     assert(r == in_len);
@@ -114,6 +445,11 @@ stream_parse(struct stream *stream, AVPacket *packet) {
     if (stream->parser->key_frame == 1) {
         packet->flags |= AV_PKT_FLAG_KEY;
     }
+#ifdef AV_PKT_FLAG_DISPOSABLE
+    if (is_disposable(stream, packet)) {
+        packet->flags |= AV_PKT_FLAG_DISPOSABLE;
+    }
+#endif
 
     bool ok = process_frame(stream, packet);
     if (!ok) {
@@ -128,55 +464,82 @@ static bool
 stream_push_packet(struct stream *stream, AVPacket *packet) {
     bool is_config = packet->pts == AV_NOPTS_VALUE;
 
+    if (!is_config) {
+        // data packet (any pending config packet has been prepended on
+        // reception)
+        return stream_parse(stream, packet);
+    }
+
     // A config packet must not be decoded immetiately (it contains no
-    // frame); instead, it must be concatenated with the future data packet.
-    if (stream->has_pending || is_config) {
-        size_t offset;
-        if (stream->has_pending) {
-            offset = stream->pending.size;
-            if (av_grow_packet(&stream->pending, packet->size)) {
-                LOGE("Could not grow packet");
-                return false;
-            }
-        } else {
-            offset = 0;
-            if (av_new_packet(&stream->pending, packet->size)) {
-                LOGE("Could not create packet");
-                return false;
-            }
-            stream->has_pending = true;
+    // frame); instead, it must be prepended to the future data packet.
+    if (stream->has_pending) {
+        // several config packets in a row (rare), concatenate them
+        size_t offset = stream->pending.size;
+        if (av_grow_packet(&stream->pending, packet->size)) {
+            LOGE("Could not grow packet");
+            return false;
         }
-
         memcpy(stream->pending.data + offset, packet->data, packet->size);
-
-        if (!is_config) {
-            // prepare the concat packet to send to the decoder
-            stream->pending.pts = packet->pts;
-            stream->pending.dts = packet->dts;
-            stream->pending.flags = packet->flags;
-            packet = &stream->pending;
+    } else {
+        if (av_packet_ref(&stream->pending, packet)) {
+            LOGE("Could not reference packet");
+            return false;
         }
+        stream->has_pending = true;
     }
 
-    if (is_config) {
-        // config packet
-        bool ok = process_config_packet(stream, packet);
-        if (!ok) {
-            return false;
-        }
-    } else {
-        // data packet
-        bool ok = stream_parse(stream, packet);
+    return process_config_packet(stream, packet);
+}
 
-        if (stream->has_pending) {
-            // the pending packet must be discarded (consumed or error)
-            stream->has_pending = false;
-            av_packet_unref(&stream->pending);
-        }
+// wait for a new connection, at the end of the stream
+// return false if the stream is stopped
+static bool
+stream_wait_resumed(struct stream *stream) {
+    stream->disconnect_time = av_gettime_relative();
 
-        if (!ok) {
-            return false;
-        }
+    mutex_lock(stream->mutex);
+    if (!stream->stopped) {
+        // not an expected end of stream
+        notify_disconnected(stream);
+    }
+    while (!stream->stopped && !stream->resumed) {
+        cond_wait(stream->resume_cond, stream->mutex);
+    }
+    bool resumed = !stream->stopped;
+    stream->resumed = false;
+    mutex_unlock(stream->mutex);
+
+    if (!resumed) {
+        return false;
+    }
+
+    LOGI("Video stream resumed");
+
+    // the bytes buffered from the previous connection are discarded
+    net_reader_reset(&stream->reader, stream->socket);
+
+    // the new server sends its own config packets
+    if (stream->has_pending) {
+        av_packet_unref(&stream->pending);
+        stream->has_pending = false;
+    }
+
+    if (stream->dgram_socket != INVALID_SOCKET) {
+        // the sequence numbers restart, with a new connection
+        frame_reassembler_destroy(&stream->reassembler);
+        frame_reassembler_init(&stream->reassembler,
+                               stream->codec_id == AV_CODEC_ID_H264);
+        stream->dgram_received = false;
+        stream->wait_key_frame = false;
+        send_hello(stream);
+    }
+
+    // the decoder still holds the references of the previous encoder: do not
+    // decode anything before a key frame (requested if necessary)
+    stream->resync_decoder = true;
+    stream->last_key_frame_request = 0;
+    if (stream->last_pts != AV_NOPTS_VALUE) {
+        stream->rebase_pts = true;
     }
     return true;
 }
@@ -184,10 +547,11 @@ stream_push_packet(struct stream *stream, AVPacket *packet) {
 static int
 run_stream(void *data) {
     struct stream *stream = data;
+    trace_set_thread_name("stream");
 
-    AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    AVCodec *codec = avcodec_find_decoder(stream->codec_id);
     if (!codec) {
-        LOGE("H.264 decoder not found");
+        LOGE("Decoder not found: %s", avcodec_get_name(stream->codec_id));
         goto end;
     }
 
@@ -214,24 +578,52 @@ run_stream(void *data) {
         }
     }
 
-    stream->parser = av_parser_init(AV_CODEC_ID_H264);
-    if (!stream->parser) {
-        LOGE("Could not initialize parser");
-        goto finally_stop_and_join_recorder;
+    stream->parser = NULL;
+    if (stream->decoder && !stream->input) {
+        stream->parser = av_parser_init(stream->codec_id);
+        if (!stream->parser) {
+            LOGE("Could not initialize parser");
+            goto finally_stop_and_join_recorder;
+        }
+
+        // We must only pass complete frames to av_parser_parse2()!
+        // It's more complicated, but this allows to reduce the latency by 1
+        // frame!
+        stream->parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+    }
+
+    if (!stream->input && !net_reader_init(&stream->reader, stream->socket)) {
+        goto finally_close_parser;
     }
 
-    // We must only pass complete frames to av_parser_parse2()!
-    // It's more complicated, but this allows to reduce the latency by 1 frame!
-    stream->parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+    bool datagrams = stream->dgram_socket != INVALID_SOCKET;
+    if (datagrams) {
+        send_hello(stream);
+    }
 
     for (;;) {
         AVPacket packet;
-        bool ok = stream_recv_packet(stream, &packet);
+        bool ok;
+        // includes the wait for the data
+        trace_begin("recv");
+        if (stream->input) {
+            ok = stream_recv_annexb_packet(stream, &packet);
+        } else if (datagrams) {
+            ok = stream_recv_datagram_packet(stream, &packet);
+        } else {
+            ok = stream_recv_packet(stream, &packet);
+        }
+        trace_end();
         if (!ok) {
             // end of stream
+            if (stream->reconnect && stream_wait_resumed(stream)) {
+                datagrams = stream->dgram_socket != INVALID_SOCKET;
+                continue;
+            }
             break;
         }
 
+        metrics_add(&stream->metrics->received_bytes, packet.size);
         ok = stream_push_packet(stream, &packet);
         av_packet_unref(&packet);
         if (!ok) {
@@ -246,7 +638,13 @@ run_stream(void *data) {
         av_packet_unref(&stream->pending);
     }
 
-    av_parser_close(stream->parser);
+    if (!stream->input) {
+        net_reader_destroy(&stream->reader);
+    }
+finally_close_parser:
+    if (stream->parser) {
+        av_parser_close(stream->parser);
+    }
 finally_stop_and_join_recorder:
     if (stream->recorder) {
         recorder_stop(stream->recorder);
@@ -264,17 +662,104 @@ finally_close_decoder:
 finally_free_codec_ctx:
     avcodec_free_context(&stream->codec_ctx);
 end:
-    notify_stopped();
+    LOGD("Packet pool: %" PRIu64 " hits, %" PRIu64 " misses",
+         stream->packet_pool.hits, stream->packet_pool.misses);
+    packet_pool_destroy(&stream->packet_pool);
+    if (stream->dgram_socket != INVALID_SOCKET) {
+        LOGD("Video packets lost: %" PRIu64,
+             stream->reassembler.lost_packets);
+        frame_reassembler_destroy(&stream->reassembler);
+    }
+    notify_stopped(stream);
     return 0;
 }
 
 void
-stream_init(struct stream *stream, socket_t socket,
-            struct decoder *decoder, struct recorder *recorder) {
+stream_init(struct stream *stream, socket_t socket, enum AVCodecID codec_id,
+            struct decoder *decoder, struct recorder *recorder,
+            struct replay_buffer *replay_buffer, struct clock_sync *clock_sync,
+            struct controller *controller,
+            struct metrics *metrics, bool adapt_bit_rate, uint32_t bit_rate) {
     stream->socket = socket;
+    stream->codec_id = codec_id;
     stream->decoder = decoder,
     stream->recorder = recorder;
+    stream->replay_buffer = replay_buffer;
+    stream->relay = NULL;
+    stream->clock_sync = clock_sync;
+    stream->controller = controller;
+    stream->metrics = metrics;
+    stream->adapt_bit_rate = adapt_bit_rate;
+    adaptive_bit_rate_init(&stream->adaptive_bit_rate, bit_rate);
+    stream->recv_time = 0;
+    stream->capture_time = 0;
     stream->has_pending = false;
+    stream->dgram_socket = INVALID_SOCKET;
+    stream->input = NULL;
+    stream->reconnect = false;
+    stream->pts_offset = 0;
+    stream->last_pts = AV_NOPTS_VALUE;
+    stream->rebase_pts = false;
+    atomic_init(&stream->decoding_paused, false);
+    stream->resync_decoder = false;
+    packet_pool_init(&stream->packet_pool);
+}
+
+void
+stream_use_datagrams(struct stream *stream, socket_t dgram_socket) {
+    stream->dgram_socket = dgram_socket;
+    // only the H.264 NAL headers are inspected to detect the non-reference
+    // frames
+    frame_reassembler_init(&stream->reassembler,
+                           stream->codec_id == AV_CODEC_ID_H264);
+    stream->dgram_received = false;
+    stream->wait_key_frame = false;
+    stream->last_key_frame_request = 0;
+}
+
+void
+stream_use_annexb_input(struct stream *stream, struct annexb_input *input) {
+    assert(stream->codec_id == AV_CODEC_ID_H264);
+    stream->input = input;
+    stream->input_start_time = 0;
+    stream->input_last_pts = -1;
+}
+
+void
+stream_use_relay(struct stream *stream, struct relay *relay) {
+    stream->relay = relay;
+}
+
+bool
+stream_enable_reconnect(struct stream *stream) {
+    assert(!stream->input);
+
+    if (!(stream->mutex = SDL_CreateMutex())) {
+        return false;
+    }
+
+    if (!(stream->resume_cond = SDL_CreateCond())) {
+        SDL_DestroyMutex(stream->mutex);
+        return false;
+    }
+
+    stream->stopped = false;
+    stream->resumed = false;
+    stream->reconnect = true;
+    return true;
+}
+
+void
+stream_resume(struct stream *stream, socket_t socket, socket_t dgram_socket) {
+    assert(stream->reconnect);
+
+    mutex_lock(stream->mutex);
+    // the stream thread reads them once woken up
+    stream->socket = socket;
+    stream->dgram_socket = dgram_socket;
+    stream->resumed = true;
+    cond_signal(stream->resume_cond);
+    mutex_unlock(stream->mutex);
 }
 
 bool
@@ -291,6 +776,15 @@ stream_start(struct stream *stream) {
 
 void
 stream_stop(struct stream *stream) {
+    if (stream->reconnect) {
+        mutex_lock(stream->mutex);
+        stream->stopped = true;
+        cond_signal(stream->resume_cond);
+        mutex_unlock(stream->mutex);
+    }
+    if (stream->input) {
+        annexb_input_interrupt(stream->input);
+    }
     if (stream->decoder) {
         decoder_interrupt(stream->decoder);
     }
@@ -299,4 +793,14 @@ stream_stop(struct stream *stream) {
 void
 stream_join(struct stream *stream) {
     SDL_WaitThread(stream->thread, NULL);
+    if (stream->reconnect) {
+        SDL_DestroyCond(stream->resume_cond);
+        SDL_DestroyMutex(stream->mutex);
+    }
+}
+
+void
+stream_set_decoding_paused(struct stream *stream, bool paused) {
+    atomic_store_explicit(&stream->decoding_paused, paused,
+                          memory_order_relaxed);
 }
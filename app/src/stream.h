@@ -1,33 +1,129 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <libavformat/avformat.h>
 #include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_mutex.h>
 #include <SDL2/SDL_thread.h>
 
 #include "config.h"
+#include "adaptive_bit_rate.h"
+#include "clock_sync.h"
+#include "frame_reassembler.h"
+#include "metrics.h"
+#include "packet_pool.h"
 #include "util/net.h"
+#include "util/net_reader.h"
 
+struct annexb_input;
+struct controller;
+struct relay;
+struct replay_buffer;
 struct video_buffer;
 
 struct stream {
     socket_t socket;
+    // the packets are parsed from a read-ahead buffer over the socket (not
+    // used for datagrams or --input)
+    struct net_reader reader;
+    enum AVCodecID codec_id;
+    // if set, the packets are received as datagrams (the socket only detects
+    // the end of the stream)
+    socket_t dgram_socket;
+    struct frame_reassembler reassembler;
+    // if set, the packets are split from a raw Annex B stream (the socket is
+    // not used)
+    struct annexb_input *input;
+    int64_t input_start_time;
+    int64_t input_last_pts;
+    bool dgram_received; // stop sending hello datagrams
+    bool wait_key_frame; // a reference frame has been lost
+    int64_t last_key_frame_request;
     SDL_Thread *thread;
     struct decoder *decoder;
+    // the packets are not decoded (but still recorded)
+    atomic_bool decoding_paused;
+    // the decoding has been paused, wait for a key frame (only accessed
+    // from the stream thread)
+    bool resync_decoder;
     struct recorder *recorder;
+    struct replay_buffer *replay_buffer; // may be NULL
+    // the packets are forwarded to the viewers of a relay (may be NULL)
+    struct relay *relay;
     AVCodecContext *codec_ctx;
-    AVCodecParserContext *parser;
-    // successive packets may need to be concatenated, until a non-config
-    // packet is available
+    AVCodecParserContext *parser; // NULL if there is no decoder
+    // received packets payloads are allocated from this pool
+    struct packet_pool packet_pool;
+    // the time at which the last packet has been received
+    int64_t recv_time;
+    // the capture time of the last packet, in the local clock (0 if unknown)
+    int64_t capture_time;
+    // may be NULL
+    struct clock_sync *clock_sync;
+    // to request key frames and bit rate changes, NULL if control is
+    // disabled
+    struct controller *controller;
+    struct metrics *metrics;
+    bool adapt_bit_rate;
+    struct adaptive_bit_rate adaptive_bit_rate;
+    // config packets are kept until the next data packet is received, to be
+    // prepended to it
     bool has_pending;
     AVPacket pending;
+
+    // if set, the stream waits for a new connection at the end of the
+    // stream, instead of stopping (see stream_enable_reconnect())
+    bool reconnect;
+    SDL_mutex *mutex;
+    SDL_cond *resume_cond;
+    bool stopped; // protected by the mutex
+    bool resumed; // protected by the mutex
+    // the PTS restart from 0 on a new connection: they are shifted so that
+    // the timeline continues after the gap
+    int64_t pts_offset;
+    int64_t last_pts; // AV_NOPTS_VALUE if no data packet has been received
+    int64_t disconnect_time;
+    bool rebase_pts; // compute pts_offset on the next data packet
 };
 
 void
-stream_init(struct stream *stream, socket_t socket,
-            struct decoder *decoder, struct recorder *recorder);
+stream_init(struct stream *stream, socket_t socket, enum AVCodecID codec_id,
+            struct decoder *decoder, struct recorder *recorder,
+            struct replay_buffer *replay_buffer, struct clock_sync *clock_sync,
+            struct controller *controller,
+            struct metrics *metrics, bool adapt_bit_rate, uint32_t bit_rate);
+
+// receive the packets from a (connected) UDP socket
+// must be called before stream_start()
+void
+stream_use_datagrams(struct stream *stream, socket_t dgram_socket);
+
+// read the packets from a raw H.264 Annex B stream (--input)
+// must be called before stream_start()
+void
+stream_use_annexb_input(struct stream *stream, struct annexb_input *input);
+
+// forward the packets to the viewers of the relay (--relay-port)
+// must be called before stream_start()
+void
+stream_use_relay(struct stream *stream, struct relay *relay);
+
+// on end of stream, push EVENT_STREAM_DISCONNECTED and wait for
+// stream_resume() (or stream_stop()), keeping the decoder and the recorder
+// open
+// must be called before stream_start()
+bool
+stream_enable_reconnect(struct stream *stream);
+
+// continue the stream on a new connection (the previous sockets are not used
+// anymore once EVENT_STREAM_DISCONNECTED has been pushed)
+//
+// The decoding resumes on the next key frame.
+void
+stream_resume(struct stream *stream, socket_t socket, socket_t dgram_socket);
 
 bool
 stream_start(struct stream *stream);
@@ -38,4 +134,10 @@ stream_stop(struct stream *stream);
 void
 stream_join(struct stream *stream);
 
+// stop or resume decoding the packets, typically while the window is
+// minimized (the recorder still receives all of them)
+// may be called from any thread
+void
+stream_set_decoding_paused(struct stream *stream, bool paused);
+
 #endif
@@ -62,15 +62,24 @@ cmd_search(const char *file) {
     return ret;
 }
 
-enum process_result
-cmd_execute(const char *const argv[], pid_t *pid) {
+// pout may be NULL (the output is not redirected)
+static enum process_result
+execute(const char *const argv[], pid_t *pid, int *pout) {
     int fd[2];
+    int out[2] = {-1, -1};
 
     if (pipe(fd) == -1) {
         perror("pipe");
         return PROCESS_ERROR_GENERIC;
     }
 
+    if (pout && pipe(out) == -1) {
+        perror("pipe");
+        close(fd[0]);
+        close(fd[1]);
+        return PROCESS_ERROR_GENERIC;
+    }
+
     enum process_result ret = PROCESS_SUCCESS;
 
     *pid = fork();
@@ -84,6 +93,10 @@ cmd_execute(const char *const argv[], pid_t *pid) {
         // parent close write side
         close(fd[1]);
         fd[1] = -1;
+        if (pout) {
+            close(out[1]);
+            out[1] = -1;
+        }
         // wait for EOF or receive errno from child
         if (read(fd[0], &ret, sizeof(ret)) == -1) {
             perror("read");
@@ -93,6 +106,14 @@ cmd_execute(const char *const argv[], pid_t *pid) {
     } else if (*pid == 0) {
         // child close read side
         close(fd[0]);
+        if (pout) {
+            if (dup2(out[1], STDOUT_FILENO) == -1) {
+                perror("dup2");
+                _exit(1);
+            }
+            close(out[0]);
+            close(out[1]);
+        }
         if (fcntl(fd[1], F_SETFD, FD_CLOEXEC) == 0) {
             execvp(argv[0], (char *const *)argv);
             if (errno == ENOENT) {
@@ -121,9 +142,57 @@ end:
     if (fd[1] != -1) {
         close(fd[1]);
     }
+    if (pout) {
+        if (out[1] != -1) {
+            close(out[1]);
+        }
+        if (ret == PROCESS_SUCCESS) {
+            *pout = out[0];
+        } else {
+            close(out[0]);
+        }
+    }
     return ret;
 }
 
+enum process_result
+cmd_execute(const char *const argv[], pid_t *pid) {
+    return execute(argv, pid, NULL);
+}
+
+enum process_result
+cmd_execute_redirect(const char *const argv[], pid_t *pid, int *pout) {
+    return execute(argv, pid, pout);
+}
+
+ssize_t
+cmd_read_pipe_all(int pipe, char *data, size_t len) {
+    size_t copied = 0;
+    while (copied < len) {
+        ssize_t r = read(pipe, data + copied, len - copied);
+        if (r == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("read");
+            return -1;
+        }
+        if (!r) {
+            // EOF
+            break;
+        }
+        copied += r;
+    }
+    return copied;
+}
+
+void
+cmd_close_pipe(int pipe) {
+    if (close(pipe)) {
+        perror("close pipe");
+    }
+}
+
 bool
 cmd_terminate(pid_t pid) {
     if (pid <= 0) {
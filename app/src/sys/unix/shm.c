@@ -0,0 +1,72 @@
+// for shm_open() and ftruncate()
+#define _POSIX_C_SOURCE 200809L
+
+#include "util/shm.h"
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "util/log.h"
+
+bool
+sc_shm_create(struct sc_shm *shm, const char *name, size_t size) {
+    // POSIX shared memory names start with a single '/'
+    size_t len = strlen(name);
+    shm->name = SDL_malloc(len + 2);
+    if (!shm->name) {
+        LOGC("Could not allocate shared memory name");
+        return false;
+    }
+    shm->name[0] = '/';
+    memcpy(&shm->name[1], name, len + 1);
+
+    int fd = shm_open(shm->name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        LOGE("Could not open shared memory %s: %s", shm->name,
+             strerror(errno));
+        goto error_free_name;
+    }
+
+    // reset any content left by a previous session (the new pages are
+    // zero-filled)
+    if (ftruncate(fd, 0) || ftruncate(fd, size)) {
+        LOGE("Could not resize shared memory %s: %s", shm->name,
+             strerror(errno));
+        goto error_unlink;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        LOGE("Could not map shared memory %s: %s", shm->name,
+             strerror(errno));
+        goto error_unlink;
+    }
+
+    // the mapping remains valid once the descriptor is closed
+    close(fd);
+
+    shm->data = data;
+    shm->size = size;
+    return true;
+
+error_unlink:
+    close(fd);
+    shm_unlink(shm->name);
+error_free_name:
+    SDL_free(shm->name);
+    return false;
+}
+
+void
+sc_shm_destroy(struct sc_shm *shm) {
+    munmap(shm->data, shm->size);
+    shm_unlink(shm->name);
+    SDL_free(shm->name);
+}
@@ -20,8 +20,9 @@ build_cmd(char *cmd, size_t len, const char *const argv[]) {
     return 0;
 }
 
-enum process_result
-cmd_execute(const char *const argv[], HANDLE *handle) {
+// pout may be NULL (the output is not redirected)
+static enum process_result
+execute(const char *const argv[], HANDLE *handle, HANDLE *pout) {
     STARTUPINFOW si;
     PROCESS_INFORMATION pi;
     memset(&si, 0, sizeof(si));
@@ -33,16 +34,45 @@ cmd_execute(const char *const argv[], HANDLE *handle) {
         return PROCESS_ERROR_GENERIC;
     }
 
+    HANDLE out_read = NULL;
+    HANDLE out_write = NULL;
+    if (pout) {
+        SECURITY_ATTRIBUTES sa;
+        sa.nLength = sizeof(sa);
+        sa.lpSecurityDescriptor = NULL;
+        sa.bInheritHandle = TRUE;
+        if (!CreatePipe(&out_read, &out_write, &sa, 0)) {
+            LOGE("Could not create pipe");
+            *handle = NULL;
+            return PROCESS_ERROR_GENERIC;
+        }
+        // only the write side must be inherited by the child
+        SetHandleInformation(out_read, HANDLE_FLAG_INHERIT, 0);
+
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        si.hStdOutput = out_write;
+        si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    }
+
     wchar_t *wide = utf8_to_wide_char(cmd);
     if (!wide) {
         LOGC("Could not allocate wide char string");
+        if (pout) {
+            CloseHandle(out_read);
+            CloseHandle(out_write);
+        }
         return PROCESS_ERROR_GENERIC;
     }
 
-    if (!CreateProcessW(NULL, wide, NULL, NULL, FALSE, 0, NULL, NULL, &si,
-                        &pi)) {
+    if (!CreateProcessW(NULL, wide, NULL, NULL, pout ? TRUE : FALSE, 0, NULL,
+                        NULL, &si, &pi)) {
         SDL_free(wide);
         *handle = NULL;
+        if (pout) {
+            CloseHandle(out_read);
+            CloseHandle(out_write);
+        }
         if (GetLastError() == ERROR_FILE_NOT_FOUND) {
             return PROCESS_ERROR_MISSING_BINARY;
         }
@@ -50,10 +80,53 @@ cmd_execute(const char *const argv[], HANDLE *handle) {
     }
 
     SDL_free(wide);
+    if (pout) {
+        // the child owns its copy
+        CloseHandle(out_write);
+        *pout = out_read;
+    }
     *handle = pi.hProcess;
     return PROCESS_SUCCESS;
 }
 
+enum process_result
+cmd_execute(const char *const argv[], HANDLE *handle) {
+    return execute(argv, handle, NULL);
+}
+
+enum process_result
+cmd_execute_redirect(const char *const argv[], HANDLE *handle,
+                     HANDLE *pout) {
+    return execute(argv, handle, pout);
+}
+
+ssize_t
+cmd_read_pipe_all(HANDLE pipe, char *data, size_t len) {
+    size_t copied = 0;
+    while (copied < len) {
+        DWORD r;
+        if (!ReadFile(pipe, data + copied, len - copied, &r, NULL)) {
+            if (GetLastError() == ERROR_BROKEN_PIPE) {
+                // EOF
+                break;
+            }
+            return -1;
+        }
+        if (!r) {
+            break;
+        }
+        copied += r;
+    }
+    return copied;
+}
+
+void
+cmd_close_pipe(HANDLE pipe) {
+    if (!CloseHandle(pipe)) {
+        LOGW("Could not close pipe");
+    }
+}
+
 bool
 cmd_terminate(HANDLE handle) {
     return TerminateProcess(handle, 1);
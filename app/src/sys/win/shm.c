@@ -0,0 +1,46 @@
+#include "util/shm.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "util/log.h"
+
+bool
+sc_shm_create(struct sc_shm *shm, const char *name, size_t size) {
+    uint64_t size64 = size;
+    shm->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+                                      PAGE_READWRITE, size64 >> 32,
+                                      size64 & 0xFFFFFFFF, name);
+    if (!shm->mapping) {
+        LOGE("Could not create file mapping %s (error %lu)", name,
+             GetLastError());
+        return false;
+    }
+
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+    void *data = MapViewOfFile(shm->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!data) {
+        LOGE("Could not map file mapping %s (error %lu)", name,
+             GetLastError());
+        CloseHandle(shm->mapping);
+        return false;
+    }
+
+    if (existed) {
+        // still opened by a reader since a previous session
+        memset(data, 0, size);
+    }
+
+    shm->data = data;
+    shm->size = size;
+    return true;
+}
+
+void
+sc_shm_destroy(struct sc_shm *shm) {
+    UnmapViewOfFile(shm->data);
+    // the mapping is removed once the last handle is closed
+    CloseHandle(shm->mapping);
+}
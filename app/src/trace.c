@@ -0,0 +1,239 @@
+#include "trace.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <libavformat/avio.h>
+#include <libavutil/time.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "util/lock.h"
+#include "util/log.h"
+
+#define TRACE_CHUNK_EVENTS 4096
+// at most 1M events (24 MB) per thread, the next ones are dropped
+#define TRACE_MAX_CHUNKS 256
+
+struct trace_event {
+    int64_t time; // relative to the start of the trace
+    const char *name; // NULL for the end of a span
+    char phase; // 'B' or 'E'
+};
+
+struct trace_chunk {
+    struct trace_chunk *next;
+    unsigned count;
+    struct trace_event events[TRACE_CHUNK_EVENTS];
+};
+
+// only written by its thread (the list link excepted)
+struct trace_thread {
+    struct trace_thread *next;
+    unsigned id;
+    const char *name;
+    struct trace_chunk *head;
+    struct trace_chunk *tail;
+    unsigned chunk_count;
+    uint64_t dropped;
+};
+
+bool trace_enabled = false;
+
+static struct {
+    char *filename;
+    int64_t start;
+    SDL_mutex *mutex; // protects the list of threads
+    struct trace_thread *threads;
+    unsigned next_id;
+} trace;
+
+static _Thread_local struct trace_thread *current_thread;
+
+bool
+trace_init(const char *filename) {
+    assert(!trace_enabled);
+
+    trace.filename = SDL_strdup(filename);
+    if (!trace.filename) {
+        LOGC("Could not allocate trace file name");
+        return false;
+    }
+
+    trace.mutex = SDL_CreateMutex();
+    if (!trace.mutex) {
+        LOGC("Could not create trace mutex");
+        SDL_free(trace.filename);
+        return false;
+    }
+
+    trace.start = av_gettime_relative();
+    trace.threads = NULL;
+    trace.next_id = 1;
+    trace_enabled = true;
+
+    trace_set_thread_name("main");
+    return true;
+}
+
+// register the current thread on its first event
+static struct trace_thread *
+get_current_thread(void) {
+    if (current_thread) {
+        return current_thread;
+    }
+
+    struct trace_thread *thread = SDL_malloc(sizeof(*thread));
+    if (!thread) {
+        return NULL;
+    }
+    thread->name = NULL;
+    thread->head = NULL;
+    thread->tail = NULL;
+    thread->chunk_count = 0;
+    thread->dropped = 0;
+
+    mutex_lock(trace.mutex);
+    thread->id = trace.next_id++;
+    thread->next = trace.threads;
+    trace.threads = thread;
+    mutex_unlock(trace.mutex);
+
+    current_thread = thread;
+    return thread;
+}
+
+void
+trace_set_thread_name_internal(const char *name) {
+    struct trace_thread *thread = get_current_thread();
+    if (thread) {
+        thread->name = name;
+    }
+}
+
+void
+trace_add_event(const char *name, char phase) {
+    int64_t now = av_gettime_relative();
+
+    struct trace_thread *thread = get_current_thread();
+    if (!thread) {
+        return;
+    }
+
+    struct trace_chunk *chunk = thread->tail;
+    if (!chunk || chunk->count == TRACE_CHUNK_EVENTS) {
+        if (thread->chunk_count == TRACE_MAX_CHUNKS) {
+            ++thread->dropped;
+            return;
+        }
+        chunk = SDL_malloc(sizeof(*chunk));
+        if (!chunk) {
+            ++thread->dropped;
+            return;
+        }
+        chunk->next = NULL;
+        chunk->count = 0;
+        if (thread->tail) {
+            thread->tail->next = chunk;
+        } else {
+            thread->head = chunk;
+        }
+        thread->tail = chunk;
+        ++thread->chunk_count;
+    }
+
+    struct trace_event *event = &chunk->events[chunk->count++];
+    event->time = now - trace.start;
+    event->name = name;
+    event->phase = phase;
+}
+
+static void
+write_thread(AVIOContext *io, const struct trace_thread *thread,
+             bool *first) {
+    if (thread->name) {
+        avio_printf(io, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                        "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    *first ? "" : ",\n", thread->id, thread->name);
+        *first = false;
+    }
+
+    for (struct trace_chunk *chunk = thread->head; chunk;
+            chunk = chunk->next) {
+        for (unsigned i = 0; i < chunk->count; ++i) {
+            const struct trace_event *event = &chunk->events[i];
+            const char *sep = *first ? "" : ",\n";
+            if (event->name) {
+                avio_printf(io, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"
+                                PRIi64 ",\"pid\":1,\"tid\":%u}",
+                            sep, event->name, event->phase, event->time,
+                            thread->id);
+            } else {
+                avio_printf(io, "%s{\"ph\":\"%c\",\"ts\":%" PRIi64
+                                ",\"pid\":1,\"tid\":%u}",
+                            sep, event->phase, event->time, thread->id);
+            }
+            *first = false;
+        }
+    }
+
+    if (thread->dropped) {
+        LOGW("Trace: %" PRIu64 " events dropped on thread %u", thread->dropped,
+             thread->id);
+    }
+}
+
+static bool
+write_trace(const char *filename) {
+    AVIOContext *io;
+    // avio handles UTF-8 file names on all platforms
+    if (avio_open(&io, filename, AVIO_FLAG_WRITE) < 0) {
+        LOGE("Could not open trace file: %s", filename);
+        return false;
+    }
+
+    avio_printf(io, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (struct trace_thread *thread = trace.threads; thread;
+            thread = thread->next) {
+        write_thread(io, thread, &first);
+    }
+    avio_printf(io, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    bool ok = !io->error;
+    avio_closep(&io);
+    if (!ok) {
+        LOGE("Could not write trace file: %s", filename);
+    }
+    return ok;
+}
+
+void
+trace_destroy(void) {
+    assert(trace_enabled);
+    trace_enabled = false;
+
+    if (write_trace(trace.filename)) {
+        LOGI("Trace written to %s", trace.filename);
+    }
+
+    struct trace_thread *thread = trace.threads;
+    while (thread) {
+        struct trace_chunk *chunk = thread->head;
+        while (chunk) {
+            struct trace_chunk *next = chunk->next;
+            SDL_free(chunk);
+            chunk = next;
+        }
+        struct trace_thread *next = thread->next;
+        SDL_free(thread);
+        thread = next;
+    }
+    trace.threads = NULL;
+    // the threads which recorded events have terminated, except the current
+    // one
+    current_thread = NULL;
+
+    SDL_DestroyMutex(trace.mutex);
+    SDL_free(trace.filename);
+}
@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+// Record the spans of the pipeline threads (--trace), written as a Chrome
+// trace (JSON) once the session ends, to be opened in chrome://tracing or
+// <https://ui.perfetto.dev>.
+//
+// Each thread appends its events to its own buffer, allocated on its first
+// event: recording an event never takes a lock, nor touches memory shared
+// with the other threads. The buffers are only read by trace_destroy(), once
+// all the traced threads have been joined.
+//
+// When tracing is disabled, a span costs a single test of trace_enabled.
+
+// set by trace_init() before any traced thread is started, and cleared by
+// trace_destroy() once they are joined
+extern bool trace_enabled;
+
+// start recording, to write the trace to filename on trace_destroy()
+bool
+trace_init(const char *filename);
+
+// write the trace file and release the buffers
+void
+trace_destroy(void);
+
+void
+trace_add_event(const char *name, char phase);
+
+void
+trace_set_thread_name_internal(const char *name);
+
+// name must be a string literal (it is not copied)
+static inline void
+trace_set_thread_name(const char *name) {
+    if (trace_enabled) {
+        trace_set_thread_name_internal(name);
+    }
+}
+
+// begin a span on the current thread (name must be a string literal)
+static inline void
+trace_begin(const char *name) {
+    if (trace_enabled) {
+        trace_add_event(name, 'B');
+    }
+}
+
+// end the last span begun on the current thread
+static inline void
+trace_end(void) {
+    if (trace_enabled) {
+        trace_add_event(NULL, 'E');
+    }
+}
+
+#endif
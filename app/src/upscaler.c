@@ -0,0 +1,335 @@
+#include "upscaler.h"
+
+#include <assert.h>
+
+#include "compat.h"
+#include "util/log.h"
+
+#define POSITION_ATTRIB 0
+
+// the quad covering the viewport, as a triangle strip
+static const GLfloat quad[] = {
+    0.f, 0.f,
+    1.f, 0.f,
+    0.f, 1.f,
+    1.f, 1.f,
+};
+
+static const char *const vertex_shader_source =
+    "#version 130\n"
+    "in vec2 position;\n"
+    "uniform int rotation;\n"
+    "uniform vec2 tex_scale;\n"
+    "out vec2 tex_coord;\n"
+    "void main() {\n"
+    "    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);\n"
+    // the viewport y axis is upwards, the texture rows are stored downwards
+    "    vec2 uv = vec2(position.x, 1.0 - position.y);\n"
+    // the content is rotated counterclockwise
+    "    for (int i = 0; i < rotation; ++i) {\n"
+    "        uv = vec2(1.0 - uv.y, uv.x);\n"
+    "    }\n"
+    "    tex_coord = uv * tex_scale;\n"
+    "}\n";
+
+static const char *const fragment_shader_source =
+    "#version 130\n"
+    "in vec2 tex_coord;\n"
+    "out vec4 frag_color;\n"
+    "uniform sampler2D tex_y;\n"
+    "uniform sampler2D tex_u;\n"
+    "uniform sampler2D tex_v;\n"
+    "uniform vec2 luma_size;\n" // the texture size, in texels
+    "uniform ivec2 luma_max;\n" // the last texel of the frame
+    "uniform vec2 chroma_max;\n" // the last chroma texel center
+    "uniform vec3 yuv_offset;\n"
+    "uniform mat3 yuv_matrix;\n"
+    "float lanczos2(float x) {\n"
+    "    x = abs(x);\n"
+    "    if (x < 1e-4) {\n"
+    "        return 1.0;\n"
+    "    }\n"
+    "    if (x >= 2.0) {\n"
+    "        return 0.0;\n"
+    "    }\n"
+    "    float px = 3.14159265 * x;\n"
+    "    return 2.0 * sin(px) * sin(px * 0.5) / (px * px);\n"
+    "}\n"
+    "void main() {\n"
+    "    vec2 pos = tex_coord * luma_size - 0.5;\n"
+    "    vec2 base = floor(pos);\n"
+    "    vec2 f = pos - base;\n"
+    "    float sum = 0.0;\n"
+    "    float weights = 0.0;\n"
+    "    float lo = 1.0;\n"
+    "    float hi = 0.0;\n"
+    "    for (int j = -1; j <= 2; ++j) {\n"
+    "        float wy = lanczos2(float(j) - f.y);\n"
+    "        for (int i = -1; i <= 2; ++i) {\n"
+    "            ivec2 p = clamp(ivec2(base) + ivec2(i, j), ivec2(0),\n"
+    "                            luma_max);\n"
+    "            float s = texelFetch(tex_y, p, 0).r;\n"
+    "            float w = lanczos2(float(i) - f.x) * wy;\n"
+    "            sum += s * w;\n"
+    "            weights += w;\n"
+    "            if (i >= 0 && i <= 1 && j >= 0 && j <= 1) {\n"
+    "                lo = min(lo, s);\n"
+    "                hi = max(hi, s);\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    // deringing
+    "    float y = clamp(sum / weights, lo, hi);\n"
+    "    vec2 c = min(tex_coord, chroma_max);\n"
+    "    float u = texture(tex_u, c).r;\n"
+    "    float v = texture(tex_v, c).r;\n"
+    "    vec3 rgb = yuv_matrix * (vec3(y, u, v) - yuv_offset);\n"
+    "    frag_color = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+// the conversions used by SDL for its own YUV shaders, so that the colors do
+// not change when the upscaler is enabled or disabled
+struct yuv_conversion {
+    GLfloat offset[3];
+    GLfloat matrix[9]; // column-major
+};
+
+static const struct yuv_conversion conversion_jpeg = {
+    .offset = {0.f, 0.501960814f, 0.501960814f},
+    .matrix = {
+        1.f, 1.f, 1.f,
+        0.f, -0.3441f, 1.772f,
+        1.402f, -0.7141f, 0.f,
+    },
+};
+
+static const struct yuv_conversion conversion_bt601 = {
+    .offset = {0.0625f, 0.501960814f, 0.501960814f},
+    .matrix = {
+        1.1644f, 1.1644f, 1.1644f,
+        0.f, -0.3918f, 2.0172f,
+        1.596f, -0.813f, 0.f,
+    },
+};
+
+static const struct yuv_conversion conversion_bt709 = {
+    .offset = {0.0625f, 0.501960814f, 0.501960814f},
+    .matrix = {
+        1.1644f, 1.1644f, 1.1644f,
+        0.f, -0.2132f, 2.1124f,
+        1.7927f, -0.5329f, 0.f,
+    },
+};
+
+static const struct yuv_conversion *
+get_yuv_conversion(struct size texture_size) {
+#ifdef SCRCPY_SDL_HAS_YUV_CONVERSION_MODE
+    // SDL selects its shader from the texture size
+    SDL_YUV_CONVERSION_MODE mode =
+        SDL_GetYUVConversionModeForResolution(texture_size.width,
+                                              texture_size.height);
+    switch (mode) {
+        case SDL_YUV_CONVERSION_JPEG:
+            return &conversion_jpeg;
+        case SDL_YUV_CONVERSION_BT709:
+            return &conversion_bt709;
+        default:
+            return &conversion_bt601;
+    }
+#else
+    (void) texture_size;
+    // older SDL versions only convert with BT.601
+    return &conversion_bt601;
+#endif
+}
+
+static GLuint
+compile_shader(struct sc_opengl *gl, GLenum type, const char *source) {
+    GLuint shader = gl->CreateShader(type);
+    if (!shader) {
+        LOGE("Could not create shader");
+        return 0;
+    }
+
+    gl->ShaderSource(shader, 1, &source, NULL);
+    gl->CompileShader(shader);
+
+    GLint status;
+    gl->GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char log[512];
+        gl->GetShaderInfoLog(shader, sizeof(log), NULL, log);
+        LOGE("Could not compile shader: %s", log);
+        gl->DeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static GLuint
+create_program(struct sc_opengl *gl) {
+    GLuint vertex_shader =
+        compile_shader(gl, GL_VERTEX_SHADER, vertex_shader_source);
+    if (!vertex_shader) {
+        return 0;
+    }
+
+    GLuint fragment_shader =
+        compile_shader(gl, GL_FRAGMENT_SHADER, fragment_shader_source);
+    if (!fragment_shader) {
+        gl->DeleteShader(vertex_shader);
+        return 0;
+    }
+
+    GLuint program = gl->CreateProgram();
+    if (!program) {
+        LOGE("Could not create shader program");
+        goto end;
+    }
+
+    gl->AttachShader(program, vertex_shader);
+    gl->AttachShader(program, fragment_shader);
+    gl->BindAttribLocation(program, POSITION_ATTRIB, "position");
+    gl->LinkProgram(program);
+
+    GLint status;
+    gl->GetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        char log[512];
+        gl->GetProgramInfoLog(program, sizeof(log), NULL, log);
+        LOGE("Could not link shader program: %s", log);
+        gl->DeleteProgram(program);
+        program = 0;
+    }
+
+end:
+    // released with the program
+    gl->DeleteShader(vertex_shader);
+    gl->DeleteShader(fragment_shader);
+    return program;
+}
+
+bool
+upscaler_init(struct upscaler *upscaler, struct sc_opengl *gl) {
+    upscaler->gl = gl;
+
+    GLint previous_program;
+    gl->GetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+
+    upscaler->program = create_program(gl);
+    if (!upscaler->program) {
+        return false;
+    }
+
+    GLuint program = upscaler->program;
+    upscaler->rotation_loc = gl->GetUniformLocation(program, "rotation");
+    upscaler->tex_scale_loc = gl->GetUniformLocation(program, "tex_scale");
+    upscaler->luma_size_loc = gl->GetUniformLocation(program, "luma_size");
+    upscaler->luma_max_loc = gl->GetUniformLocation(program, "luma_max");
+    upscaler->chroma_max_loc = gl->GetUniformLocation(program, "chroma_max");
+    upscaler->yuv_offset_loc = gl->GetUniformLocation(program, "yuv_offset");
+    upscaler->yuv_matrix_loc = gl->GetUniformLocation(program, "yuv_matrix");
+
+    // SDL binds the planes of a YUV texture to the texture units 0, 1 and 2
+    gl->UseProgram(program);
+    gl->Uniform1i(gl->GetUniformLocation(program, "tex_y"), 0);
+    gl->Uniform1i(gl->GetUniformLocation(program, "tex_u"), 1);
+    gl->Uniform1i(gl->GetUniformLocation(program, "tex_v"), 2);
+    gl->UseProgram(previous_program);
+
+    GLint previous_buffer;
+    gl->GetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous_buffer);
+    gl->GenBuffers(1, &upscaler->vertex_buffer);
+    gl->BindBuffer(GL_ARRAY_BUFFER, upscaler->vertex_buffer);
+    gl->BufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    gl->BindBuffer(GL_ARRAY_BUFFER, previous_buffer);
+
+    return true;
+}
+
+void
+upscaler_destroy(struct upscaler *upscaler) {
+    struct sc_opengl *gl = upscaler->gl;
+    gl->DeleteBuffers(1, &upscaler->vertex_buffer);
+    gl->DeleteProgram(upscaler->program);
+}
+
+static void
+set_uniforms(struct upscaler *upscaler, struct size texture_size,
+             struct size frame_size, unsigned rotation) {
+    struct sc_opengl *gl = upscaler->gl;
+
+    gl->Uniform1i(upscaler->rotation_loc, rotation);
+    gl->Uniform2f(upscaler->tex_scale_loc,
+                  (GLfloat) frame_size.width / texture_size.width,
+                  (GLfloat) frame_size.height / texture_size.height);
+    gl->Uniform2f(upscaler->luma_size_loc, texture_size.width,
+                  texture_size.height);
+    gl->Uniform2i(upscaler->luma_max_loc, frame_size.width - 1,
+                  frame_size.height - 1);
+
+    // the chroma planes have half the size (rounded up)
+    unsigned chroma_w = (frame_size.width + 1) / 2;
+    unsigned chroma_h = (frame_size.height + 1) / 2;
+    unsigned chroma_tex_w = (texture_size.width + 1) / 2;
+    unsigned chroma_tex_h = (texture_size.height + 1) / 2;
+    // do not blend the last texels with the unused area of the texture
+    gl->Uniform2f(upscaler->chroma_max_loc,
+                  (chroma_w - 0.5f) / chroma_tex_w,
+                  (chroma_h - 0.5f) / chroma_tex_h);
+
+    const struct yuv_conversion *conversion = get_yuv_conversion(texture_size);
+    gl->Uniform3f(upscaler->yuv_offset_loc, conversion->offset[0],
+                  conversion->offset[1], conversion->offset[2]);
+    gl->UniformMatrix3fv(upscaler->yuv_matrix_loc, 1, GL_FALSE,
+                         conversion->matrix);
+}
+
+bool
+upscaler_draw(struct upscaler *upscaler, SDL_Texture *texture,
+              struct size texture_size, struct size frame_size,
+              const SDL_Rect *rect, int drawable_height, unsigned rotation) {
+    assert(rotation < 4);
+    struct sc_opengl *gl = upscaler->gl;
+
+    // flushes the pending SDL commands (the clear of the frame)
+    if (SDL_GL_BindTexture(texture, NULL, NULL)) {
+        LOGE("Could not bind texture: %s", SDL_GetError());
+        return false;
+    }
+
+    GLint previous_program;
+    gl->GetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+    GLint previous_viewport[4];
+    gl->GetIntegerv(GL_VIEWPORT, previous_viewport);
+    GLint previous_buffer;
+    gl->GetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous_buffer);
+    GLint attrib_enabled;
+    gl->GetVertexAttribiv(POSITION_ATTRIB, GL_VERTEX_ATTRIB_ARRAY_ENABLED,
+                          &attrib_enabled);
+
+    gl->UseProgram(upscaler->program);
+    set_uniforms(upscaler, texture_size, frame_size, rotation);
+
+    // the viewport origin is at the bottom-left corner
+    gl->Viewport(rect->x, drawable_height - rect->y - rect->h, rect->w,
+                 rect->h);
+
+    gl->BindBuffer(GL_ARRAY_BUFFER, upscaler->vertex_buffer);
+    gl->VertexAttribPointer(POSITION_ATTRIB, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    gl->EnableVertexAttribArray(POSITION_ATTRIB);
+    gl->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    if (!attrib_enabled) {
+        gl->DisableVertexAttribArray(POSITION_ATTRIB);
+    }
+
+    // SDL caches its state, restore what it expects
+    gl->BindBuffer(GL_ARRAY_BUFFER, previous_buffer);
+    gl->Viewport(previous_viewport[0], previous_viewport[1],
+                 previous_viewport[2], previous_viewport[3]);
+    gl->UseProgram(previous_program);
+
+    SDL_GL_UnbindTexture(texture);
+    return true;
+}
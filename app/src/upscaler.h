@@ -0,0 +1,53 @@
+#ifndef UPSCALER_H
+#define UPSCALER_H
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+#include "config.h"
+#include "common.h"
+#include "opengl.h"
+
+// Draw a YV12 SDL texture upscaled with a Lanczos-2 filter, instead of the
+// bilinear filtering of SDL_RenderCopy(), so that a stream captured below
+// the native resolution remains sharp (typically the UI text).
+//
+// The luma is sampled with a 4x4 Lanczos-2 kernel. To avoid the ringing of
+// the kernel around the edges, the result is clamped to the range of the 4
+// nearest samples (like the edge-adaptive upscaling of AMD FSR 1). The chroma
+// has half the resolution, it is sampled bilinearly.
+//
+// The texture is drawn by OpenGL directly, after the pending SDL rendering
+// commands have been flushed. The OpenGL state changed by the draw is
+// restored, so that SDL continues with the state it expects.
+//
+// Only accessed from the rendering thread (the OpenGL context is current).
+struct upscaler {
+    struct sc_opengl *gl;
+    GLuint program;
+    GLuint vertex_buffer;
+    GLint rotation_loc;
+    GLint tex_scale_loc;
+    GLint luma_size_loc;
+    GLint luma_max_loc;
+    GLint chroma_max_loc;
+    GLint yuv_offset_loc;
+    GLint yuv_matrix_loc;
+};
+
+// the OpenGL context must support shaders (see sc_opengl_has_shaders())
+bool
+upscaler_init(struct upscaler *upscaler, struct sc_opengl *gl);
+
+void
+upscaler_destroy(struct upscaler *upscaler);
+
+// draw the top-left frame_size area of the texture (of texture_size) into the
+// rectangle (in drawable coordinates), rotated by rotation x90 degrees
+// counterclockwise
+bool
+upscaler_draw(struct upscaler *upscaler, SDL_Texture *texture,
+              struct size texture_size, struct size frame_size,
+              const SDL_Rect *rect, int drawable_height, unsigned rotation);
+
+#endif
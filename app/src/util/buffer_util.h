@@ -2,6 +2,7 @@
 #define BUFFER_UTIL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "config.h"
@@ -26,6 +27,19 @@ buffer_write64be(uint8_t *buf, uint64_t value) {
     buffer_write32be(&buf[4], (uint32_t) value);
 }
 
+// write an unsigned LEB128 varint (7 bits per byte, least significant first)
+// return the number of bytes written (at most 10)
+static inline size_t
+buffer_write_varint(uint8_t *buf, uint64_t value) {
+    size_t i = 0;
+    while (value >= 0x80) {
+        buf[i++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buf[i++] = value;
+    return i;
+}
+
 static inline uint16_t
 buffer_read16be(const uint8_t *buf) {
     return (buf[0] << 8) | buf[1];
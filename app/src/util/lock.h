@@ -71,4 +71,17 @@ cond_signal(SDL_cond *cond) {
 #endif
 }
 
+static inline void
+cond_broadcast(SDL_cond *cond) {
+    int r = SDL_CondBroadcast(cond);
+#ifndef NDEBUG
+    if (r) {
+        LOGC("Could not broadcast a condition: %s", SDL_GetError());
+        abort();
+    }
+#else
+    (void) r;
+#endif
+}
+
 #endif
@@ -1,5 +1,6 @@
 #include "net.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <SDL2/SDL_platform.h>
 
@@ -9,9 +10,11 @@
 #ifdef __WINDOWS__
   typedef int socklen_t;
 #else
+# include <sys/select.h>
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <netinet/in.h>
+# include <netinet/tcp.h>
 # include <arpa/inet.h>
 # include <unistd.h>
 # define SOCKET_ERROR -1
@@ -20,14 +23,52 @@
   typedef struct in_addr IN_ADDR;
 #endif
 
+static bool
+set_option(socket_t socket, int level, int name, int value,
+           const char *desc) {
+    if (setsockopt(socket, level, name, (const void *) &value,
+                   sizeof(value)) == SOCKET_ERROR) {
+        LOGW("Could not set socket option %s", desc);
+        return false;
+    }
+    return true;
+}
+
+bool
+net_apply_profile(socket_t socket, const struct net_socket_profile *profile) {
+    bool ok = true;
+    if (profile->nodelay) {
+        ok &= set_option(socket, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+    if (profile->keepalive) {
+        ok &= set_option(socket, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+    }
+    if (profile->recv_buffer_size) {
+        // on Linux, this disables the autotuning of the receive buffer
+        ok &= set_option(socket, SOL_SOCKET, SO_RCVBUF,
+                         profile->recv_buffer_size, "SO_RCVBUF");
+    }
+    return ok;
+}
+
 socket_t
 net_connect(uint32_t addr, uint16_t port) {
+    return net_connect_profile(addr, port, NULL);
+}
+
+socket_t
+net_connect_profile(uint32_t addr, uint16_t port,
+                    const struct net_socket_profile *profile) {
     socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         perror("socket");
         return INVALID_SOCKET;
     }
 
+    if (profile) {
+        net_apply_profile(sock, profile); // ignore failure
+    }
+
     SOCKADDR_IN sin;
     sin.sin_family = AF_INET;
     sin.sin_addr.s_addr = htonl(addr);
@@ -43,6 +84,85 @@ net_connect(uint32_t addr, uint16_t port) {
     return sock;
 }
 
+socket_t
+net_udp_connect(uint32_t addr, uint16_t port,
+                const struct net_socket_profile *profile) {
+    socket_t sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCKET) {
+        perror("socket");
+        return INVALID_SOCKET;
+    }
+
+    if (profile) {
+        net_apply_profile(sock, profile); // ignore failure
+    }
+
+    SOCKADDR_IN sin;
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(addr);
+    sin.sin_port = htons(port);
+
+    // no packet is exchanged, it only sets the default peer
+    if (connect(sock, (SOCKADDR *) &sin, sizeof(sin)) == SOCKET_ERROR) {
+        perror("connect");
+        net_close(sock);
+        return INVALID_SOCKET;
+    }
+
+    return sock;
+}
+
+int
+net_wait_readable(socket_t socket1, socket_t socket2, uint32_t timeout_ms) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(socket1, &fds);
+    FD_SET(socket2, &fds);
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    // ignored on Windows
+    int nfds = (socket1 > socket2 ? socket1 : socket2) + 1;
+    int r = select(nfds, &fds, NULL, NULL, &tv);
+    if (r == SOCKET_ERROR) {
+#ifndef __WINDOWS__
+        if (errno == EINTR) {
+            // interrupted by a signal, like a timeout
+            return 0;
+        }
+#endif
+        return -1;
+    }
+
+    int mask = 0;
+    if (FD_ISSET(socket1, &fds)) {
+        mask |= 1;
+    }
+    if (FD_ISSET(socket2, &fds)) {
+        mask |= 2;
+    }
+    return mask;
+}
+
+bool
+net_set_send_timeout(socket_t socket, uint32_t timeout_ms) {
+#ifdef __WINDOWS__
+    DWORD tv = timeout_ms;
+#else
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+#endif
+    if (setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const void *) &tv,
+                   sizeof(tv)) == SOCKET_ERROR) {
+        LOGW("Could not set socket option SO_SNDTIMEO");
+        return false;
+    }
+    return true;
+}
+
 socket_t
 net_listen(uint32_t addr, uint16_t port, int backlog) {
     socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
@@ -25,9 +25,44 @@ net_init(void);
 void
 net_cleanup(void);
 
+// socket options, depending on the usage of the socket
+struct net_socket_profile {
+    bool nodelay; // send small messages immediately (disable Nagle)
+    bool keepalive; // detect a dead peer on an idle connection
+    uint32_t recv_buffer_size; // 0 for the system default (autotuned)
+};
+
 socket_t
 net_connect(uint32_t addr, uint16_t port);
 
+// the profile is applied before connecting, so that the receive window may be
+// negotiated according to the buffer size (profile may be NULL)
+socket_t
+net_connect_profile(uint32_t addr, uint16_t port,
+                    const struct net_socket_profile *profile);
+
+// apply the profile on a connected (or accepted) socket
+// return false if an option could not be set (the socket is still usable)
+bool
+net_apply_profile(socket_t socket, const struct net_socket_profile *profile);
+
+// create a UDP socket, bound to any local port, and connected to the peer
+// (so that only its datagrams are received)
+socket_t
+net_udp_connect(uint32_t addr, uint16_t port,
+                const struct net_socket_profile *profile);
+
+// wait until socket1 or socket2 is readable, or the timeout expires
+// return a bitmask of the readable sockets (1 for socket1, 2 for socket2), 0
+// on timeout, or -1 on error
+int
+net_wait_readable(socket_t socket1, socket_t socket2, uint32_t timeout_ms);
+
+// fail the send calls blocked for more than timeout_ms
+// return false if the option could not be set
+bool
+net_set_send_timeout(socket_t socket, uint32_t timeout_ms);
+
 socket_t
 net_listen(uint32_t addr, uint16_t port, int backlog);
 
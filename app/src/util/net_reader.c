@@ -0,0 +1,65 @@
+#include "net_reader.h"
+
+#include <string.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "config.h"
+#include "log.h"
+
+bool
+net_reader_init(struct net_reader *reader, socket_t socket) {
+    reader->data = SDL_malloc(NET_READER_CAPACITY);
+    if (!reader->data) {
+        LOGC("Could not allocate socket read buffer");
+        return false;
+    }
+
+    reader->socket = socket;
+    reader->head = 0;
+    reader->tail = 0;
+    return true;
+}
+
+void
+net_reader_destroy(struct net_reader *reader) {
+    SDL_free(reader->data);
+}
+
+void
+net_reader_reset(struct net_reader *reader, socket_t socket) {
+    reader->socket = socket;
+    reader->head = 0;
+    reader->tail = 0;
+}
+
+bool
+net_reader_read_all(struct net_reader *reader, void *buf, size_t len) {
+    uint8_t *dst = buf;
+    for (;;) {
+        size_t available = reader->tail - reader->head;
+        if (available >= len) {
+            memcpy(dst, &reader->data[reader->head], len);
+            reader->head += len;
+            return true;
+        }
+
+        memcpy(dst, &reader->data[reader->head], available);
+        dst += available;
+        len -= available;
+        // the buffer is empty, it is refilled from the start (nothing to move)
+        reader->head = 0;
+        reader->tail = 0;
+
+        if (len >= NET_READER_DIRECT_READ_SIZE) {
+            ssize_t r = net_recv_all(reader->socket, dst, len);
+            return r >= 0 && (size_t) r == len;
+        }
+
+        ssize_t r = net_recv(reader->socket, reader->data,
+                             NET_READER_CAPACITY);
+        if (r <= 0) {
+            return false;
+        }
+        reader->tail = r;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef NET_READER_H
+#define NET_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "net.h"
+
+// the buffer size, large enough to receive many small packets per recv()
+#define NET_READER_CAPACITY 0x40000
+
+// once the buffered bytes are consumed, a remaining read at least this large
+// is received directly into the destination buffer
+#define NET_READER_DIRECT_READ_SIZE 0x10000
+
+// Read-ahead buffer over a stream socket.
+//
+// Each recv() fills the buffer with as much data as is available, so that the
+// headers and the small packets are read without additional syscalls, while
+// the large packets are received in place (without copy).
+struct net_reader {
+    socket_t socket;
+    uint8_t *data;
+    size_t head; // the next byte to read
+    size_t tail; // the end of the buffered data
+};
+
+bool
+net_reader_init(struct net_reader *reader, socket_t socket);
+
+void
+net_reader_destroy(struct net_reader *reader);
+
+// discard the buffered data, and read from another socket
+void
+net_reader_reset(struct net_reader *reader, socket_t socket);
+
+// read exactly len bytes
+// return false on error or at the end of the stream
+bool
+net_reader_read_all(struct net_reader *reader, void *buf, size_t len);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL_platform.h>
+
+#ifdef __WINDOWS__
+# include <windows.h>
+#endif
+
+#include "config.h"
+
+// A named shared memory region, readable by other local processes.
+//
+// The implementation is platform-specific (POSIX shm or Windows file mapping).
+struct sc_shm {
+    void *data;
+    size_t size;
+#ifdef __WINDOWS__
+    HANDLE mapping;
+#else
+    char *name; // to unlink it on destroy
+#endif
+};
+
+// create (or reuse, if it already exists) the region and map it, zero-filled
+bool
+sc_shm_create(struct sc_shm *shm, const char *name, size_t size);
+
+// unmap the region, and remove its name (the processes which opened it keep
+// it mapped)
+void
+sc_shm_destroy(struct sc_shm *shm);
+
+#endif
@@ -146,11 +146,12 @@ parse_integer_with_suffix(const char *s, long *out) {
 
 size_t
 utf8_truncation_index(const char *utf8, size_t max_len) {
-    size_t len = strlen(utf8);
-    if (len <= max_len) {
-        return len;
+    // do not scan the whole string, it may be far longer than max_len
+    const char *end = memchr(utf8, '\0', max_len + 1);
+    if (end) {
+        return end - utf8;
     }
-    len = max_len;
+    size_t len = max_len;
     // see UTF-8 encoding <https://en.wikipedia.org/wiki/UTF-8#Description>
     while ((utf8[len] & 0x80) != 0 && (utf8[len] & 0xc0) != 0xc0) {
         // the next byte is not the start of a new UTF-8 codepoint
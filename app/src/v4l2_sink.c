@@ -0,0 +1,224 @@
+#include "v4l2_sink.h"
+
+#include <libavutil/hwcontext.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "config.h"
+#include "compat.h"
+#include "util/log.h"
+
+bool
+v4l2_sink_init(struct v4l2_sink *vs, const char *device_name) {
+    vs->device_name = SDL_strdup(device_name);
+    if (!vs->device_name) {
+        LOGC("Could not strdup v4l2 device name");
+        return false;
+    }
+
+    vs->packet = av_packet_alloc();
+    if (!vs->packet) {
+        LOGC("Could not allocate packet");
+        SDL_free(vs->device_name);
+        return false;
+    }
+
+    vs->format_ctx = NULL;
+    vs->encoder_ctx = NULL;
+    vs->sw_frame = NULL;
+    vs->opened = false;
+    vs->failed = false;
+    vs->warned = false;
+    return true;
+}
+
+static void
+close_output(struct v4l2_sink *vs) {
+    if (vs->opened) {
+        av_write_trailer(vs->format_ctx);
+        vs->opened = false;
+    }
+    if (vs->format_ctx) {
+        avio_closep(&vs->format_ctx->pb);
+        avformat_free_context(vs->format_ctx);
+        vs->format_ctx = NULL;
+    }
+    avcodec_free_context(&vs->encoder_ctx);
+}
+
+void
+v4l2_sink_destroy(struct v4l2_sink *vs) {
+    close_output(vs);
+    av_frame_free(&vs->sw_frame);
+    av_packet_free(&vs->packet);
+    SDL_free(vs->device_name);
+}
+
+// open the device for the format and the size of the first frame
+static bool
+open_output(struct v4l2_sink *vs, const AVFrame *frame) {
+    const AVOutputFormat *format = av_guess_format("video4linux2", NULL, NULL);
+    if (!format) {
+        LOGE("Could not find v4l2 muxer");
+        return false;
+    }
+
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_RAWVIDEO);
+    if (!codec) {
+        LOGE("Raw video encoder not found");
+        return false;
+    }
+
+    vs->format_ctx = avformat_alloc_context();
+    if (!vs->format_ctx) {
+        LOGC("Could not allocate v4l2 output context");
+        return false;
+    }
+    // AVFormatContext.oformat expects a pointer-to-non-const (see recorder)
+    vs->format_ctx->oformat = (AVOutputFormat *) format;
+
+    AVStream *ostream = avformat_new_stream(vs->format_ctx, codec);
+    if (!ostream) {
+        LOGC("Could not allocate v4l2 stream");
+        goto error;
+    }
+
+    vs->encoder_ctx = avcodec_alloc_context3(codec);
+    if (!vs->encoder_ctx) {
+        LOGC("Could not allocate codec context");
+        goto error;
+    }
+    vs->encoder_ctx->width = frame->width;
+    vs->encoder_ctx->height = frame->height;
+    vs->encoder_ctx->pix_fmt = frame->format;
+    vs->encoder_ctx->time_base = (AVRational) {1, 1000000};
+
+    if (avcodec_open2(vs->encoder_ctx, codec, NULL) < 0) {
+        LOGE("Could not open raw video encoder");
+        goto error;
+    }
+
+    if (avcodec_parameters_from_context(ostream->codecpar, vs->encoder_ctx)
+            < 0) {
+        LOGE("Could not set v4l2 stream parameters");
+        goto error;
+    }
+    ostream->time_base = vs->encoder_ctx->time_base;
+
+    if (avio_open(&vs->format_ctx->pb, vs->device_name, AVIO_FLAG_WRITE) < 0) {
+        LOGE("Could not open v4l2 device: %s", vs->device_name);
+        goto error;
+    }
+
+    if (avformat_write_header(vs->format_ctx, NULL) < 0) {
+        LOGE("Could not write header to v4l2 device: %s", vs->device_name);
+        goto error;
+    }
+
+    vs->opened = true;
+    LOGI("v4l2 sink started to device: %s (%dx%d)", vs->device_name,
+         frame->width, frame->height);
+    return true;
+
+error:
+    close_output(vs);
+    return false;
+}
+
+// return a frame readable from the CPU
+static const AVFrame *
+get_sw_frame(struct v4l2_sink *vs, const AVFrame *frame) {
+    if (!frame->hw_frames_ctx) {
+        return frame;
+    }
+
+    if (!vs->sw_frame) {
+        vs->sw_frame = av_frame_alloc();
+        if (!vs->sw_frame) {
+            LOGC("Could not allocate frame");
+            return NULL;
+        }
+    }
+
+    int ret = av_hwframe_transfer_data(vs->sw_frame, frame, 0);
+    if (ret < 0) {
+        LOGE("Could not download hardware frame: %d", ret);
+        return NULL;
+    }
+    vs->sw_frame->pts = frame->pts;
+    return vs->sw_frame;
+}
+
+static bool
+encode_and_write(struct v4l2_sink *vs, const AVFrame *frame) {
+#ifdef SCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
+    int ret = avcodec_send_frame(vs->encoder_ctx, frame);
+    if (ret < 0) {
+        LOGE("Could not send v4l2 video frame: %d", ret);
+        return false;
+    }
+
+    // the raw video encoder outputs exactly one packet per frame
+    ret = avcodec_receive_packet(vs->encoder_ctx, vs->packet);
+    if (ret < 0) {
+        LOGE("Could not receive v4l2 video packet: %d", ret);
+        return false;
+    }
+#else
+    int got_packet;
+    int ret = avcodec_encode_video2(vs->encoder_ctx, vs->packet, frame,
+                                    &got_packet);
+    if (ret < 0 || !got_packet) {
+        LOGE("Could not encode v4l2 video frame: %d", ret);
+        return false;
+    }
+#endif
+
+    ret = av_write_frame(vs->format_ctx, vs->packet);
+    av_packet_unref(vs->packet);
+    if (ret < 0) {
+        LOGE("Could not write frame to v4l2 device: %d", ret);
+        return false;
+    }
+    return true;
+}
+
+void
+v4l2_sink_push(struct v4l2_sink *vs, const AVFrame *frame) {
+    if (vs->failed) {
+        return;
+    }
+
+    const AVFrame *sw_frame = get_sw_frame(vs, frame);
+    if (!sw_frame) {
+        return;
+    }
+
+    if (!vs->opened) {
+        if (!open_output(vs, sw_frame)) {
+            vs->failed = true;
+            goto end;
+        }
+    }
+
+    if (sw_frame->width != vs->encoder_ctx->width
+            || sw_frame->height != vs->encoder_ctx->height
+            || sw_frame->format != vs->encoder_ctx->pix_fmt) {
+        // the format of a v4l2 device cannot be changed while it is open
+        if (!vs->warned) {
+            LOGW("Frame size changed, not written to the v4l2 device "
+                 "(use --lock-video-orientation)");
+            vs->warned = true;
+        }
+        goto end;
+    }
+
+    if (!encode_and_write(vs, sw_frame)) {
+        // the device may have been closed, do not flood the logs
+        vs->failed = true;
+    }
+
+end:
+    if (sw_frame != frame) {
+        av_frame_unref(vs->sw_frame);
+    }
+}
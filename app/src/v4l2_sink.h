@@ -0,0 +1,38 @@
+#ifndef V4L2_SINK_H
+#define V4L2_SINK_H
+
+#include <stdbool.h>
+#include <libavformat/avformat.h>
+
+#include "config.h"
+#include "common.h"
+
+// Write the decoded frames to a V4L2 device (typically a v4l2loopback virtual
+// webcam), through the FFmpeg "video4linux2" output device.
+//
+// The frames are written raw, in their decoded pixel format (YUV420P for
+// software decoding), without any conversion. The output is opened on the
+// first frame, and its size cannot change afterwards.
+struct v4l2_sink {
+    char *device_name;
+    AVFormatContext *format_ctx;
+    AVCodecContext *encoder_ctx;
+    AVPacket *packet;
+    // downloaded hardware frames, lazily allocated
+    AVFrame *sw_frame;
+    bool opened;
+    bool failed; // do not retry to open the device on every frame
+    bool warned;
+};
+
+bool
+v4l2_sink_init(struct v4l2_sink *vs, const char *device_name);
+
+void
+v4l2_sink_destroy(struct v4l2_sink *vs);
+
+// write the frame to the device, called by the decoder
+void
+v4l2_sink_push(struct v4l2_sink *vs, const AVFrame *frame);
+
+#endif
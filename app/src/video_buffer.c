@@ -1,51 +1,65 @@
 #include "video_buffer.h"
 
 #include <assert.h>
-#include <SDL2/SDL_mutex.h>
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
+#include <libavutil/time.h>
 
 #include "config.h"
-#include "util/lock.h"
 #include "util/log.h"
 
+#define VB_SLOT_FREE 0
+#define VB_SLOT_WRITING 1
+#define VB_SLOT_CONSUMING 2
+// the first sequence number (a state value above is a ready frame)
+#define VB_SLOT_FIRST_SEQ 3
+
+static inline bool
+is_ready(uint64_t state) {
+    return state >= VB_SLOT_FIRST_SEQ;
+}
+
 bool
 video_buffer_init(struct video_buffer *vb, struct fps_counter *fps_counter,
-                  bool render_expired_frames) {
+                  struct metrics *metrics, bool render_expired_frames,
+                  unsigned slot_count) {
+    assert(slot_count >= VIDEO_BUFFER_MIN_SLOTS);
+    assert(slot_count <= VIDEO_BUFFER_MAX_SLOTS);
+
     vb->fps_counter = fps_counter;
+    vb->metrics = metrics;
 
     if (!(vb->decoding_frame = av_frame_alloc())) {
         goto error_0;
     }
 
-    if (!(vb->rendering_frame = av_frame_alloc())) {
-        goto error_1;
-    }
-
-    if (!(vb->mutex = SDL_CreateMutex())) {
-        goto error_2;
-    }
-
-    vb->render_expired_frames = render_expired_frames;
-    if (render_expired_frames) {
-        if (!(vb->rendering_frame_consumed_cond = SDL_CreateCond())) {
-            SDL_DestroyMutex(vb->mutex);
-            goto error_2;
+    unsigned i;
+    for (i = 0; i < slot_count; ++i) {
+        struct video_buffer_slot *slot = &vb->slots[i];
+        if (!(slot->frame = av_frame_alloc())) {
+            goto error_1;
         }
-        // interrupted is not used if expired frames are not rendered
-        // since offering a frame will never block
-        vb->interrupted = false;
+        atomic_init(&slot->pts, 0);
+        atomic_init(&slot->offered, 0);
+        atomic_init(&slot->state, VB_SLOT_FREE);
     }
+    vb->slot_count = slot_count;
 
-    // there is initially no rendering frame, so consider it has already been
-    // consumed
-    vb->rendering_frame_consumed = true;
+    vb->render_expired_frames = render_expired_frames;
+    atomic_init(&vb->interrupted, false);
+    atomic_init(&vb->depth, 0);
+    atomic_init(&vb->notified, false);
+    vb->next_seq = VB_SLOT_FIRST_SEQ;
+    vb->consuming_slot = -1;
+    vb->last_consumed = -1;
+    latency_stats_init(&vb->latency_stats);
 
     return true;
 
-error_2:
-    av_frame_free(&vb->rendering_frame);
 error_1:
+    while (i--) {
+        av_frame_free(&vb->slots[i].frame);
+    }
     av_frame_free(&vb->decoding_frame);
 error_0:
     return false;
@@ -53,61 +67,210 @@ error_0:
 
 void
 video_buffer_destroy(struct video_buffer *vb) {
-    if (vb->render_expired_frames) {
-        SDL_DestroyCond(vb->rendering_frame_consumed_cond);
+    for (unsigned i = 0; i < vb->slot_count; ++i) {
+        av_frame_free(&vb->slots[i].frame);
     }
-    SDL_DestroyMutex(vb->mutex);
-    av_frame_free(&vb->rendering_frame);
     av_frame_free(&vb->decoding_frame);
 }
 
-static void
-video_buffer_swap_frames(struct video_buffer *vb) {
-    AVFrame *tmp = vb->decoding_frame;
-    vb->decoding_frame = vb->rendering_frame;
-    vb->rendering_frame = tmp;
+// return the index of a slot to write into, owned by the producer
+static unsigned
+acquire_writable_slot(struct video_buffer *vb, bool *dropped) {
+    for (;;) {
+        int oldest = -1;
+        uint64_t oldest_seq = UINT64_MAX;
+        for (unsigned i = 0; i < vb->slot_count; ++i) {
+            struct video_buffer_slot *slot = &vb->slots[i];
+            uint64_t state = atomic_load(&slot->state);
+            if (state == VB_SLOT_FREE) {
+                // only the producer may change the state of a free slot
+                atomic_store(&slot->state, VB_SLOT_WRITING);
+                *dropped = false;
+                return i;
+            }
+            if (is_ready(state) && state < oldest_seq) {
+                oldest = i;
+                oldest_seq = state;
+            }
+        }
+
+        // the consumer holds at most one slot, so if there are at least 2
+        // slots, there is always a ready one when none is free
+        assert(oldest != -1);
+
+        // the queue is full, drop the oldest frame (unless the consumer took
+        // it in the meantime)
+        struct video_buffer_slot *slot = &vb->slots[oldest];
+        if (atomic_compare_exchange_strong(&slot->state, &oldest_seq,
+                                           VB_SLOT_WRITING)) {
+            atomic_fetch_sub(&vb->depth, 1);
+            *dropped = true;
+            return oldest;
+        }
+    }
 }
 
-void
-video_buffer_offer_decoded_frame(struct video_buffer *vb,
-                                 bool *previous_frame_skipped) {
-    mutex_lock(vb->mutex);
+bool
+video_buffer_offer_decoded_frame(struct video_buffer *vb) {
+    if (atomic_load(&vb->interrupted)) {
+        return false;
+    }
+
+    bool dropped;
+    unsigned index = acquire_writable_slot(vb, &dropped);
+    struct video_buffer_slot *slot = &vb->slots[index];
+
+    // swap the frames
+    AVFrame *tmp = slot->frame;
+    slot->frame = vb->decoding_frame;
+    vb->decoding_frame = tmp;
+
+    slot->times = vb->decoding_times;
+    slot->times.offered = av_gettime_relative();
+    atomic_store(&slot->pts, slot->frame->pts);
+    atomic_store(&slot->offered, slot->times.offered);
+
+    atomic_fetch_add(&vb->depth, 1);
+    // publish the frame
+    atomic_store(&slot->state, vb->next_seq++);
+
+    if (dropped) {
+        metrics_add(&vb->metrics->skipped_frames, 1);
+    }
+
     if (vb->render_expired_frames) {
-        // wait for the current (expired) frame to be consumed
-        while (!vb->rendering_frame_consumed && !vb->interrupted) {
-            cond_wait(vb->rendering_frame_consumed_cond, vb->mutex);
-        }
-    } else if (!vb->rendering_frame_consumed) {
-        fps_counter_add_skipped_frame(vb->fps_counter);
+        // one notification per frame: if a frame has been dropped, its
+        // notification will consume this one
+        return !dropped;
     }
 
-    video_buffer_swap_frames(vb);
+    // the consumer always takes the most recent frame, so a single pending
+    // notification is sufficient
+    return !atomic_exchange(&vb->notified, true);
+}
+
+bool
+video_buffer_has_pending_frame(struct video_buffer *vb) {
+    return atomic_load(&vb->depth) > 0;
+}
+
+bool
+video_buffer_peek_next_frame(struct video_buffer *vb, int64_t *pts,
+                             int64_t *offered) {
+    assert(vb->render_expired_frames);
+
+    for (;;) {
+        int oldest = -1;
+        uint64_t oldest_seq = UINT64_MAX;
+        for (unsigned i = 0; i < vb->slot_count; ++i) {
+            uint64_t state = atomic_load(&vb->slots[i].state);
+            if (is_ready(state) && state < oldest_seq) {
+                oldest = i;
+                oldest_seq = state;
+            }
+        }
 
-    *previous_frame_skipped = !vb->rendering_frame_consumed;
-    vb->rendering_frame_consumed = false;
+        if (oldest == -1) {
+            return false;
+        }
 
-    mutex_unlock(vb->mutex);
+        struct video_buffer_slot *slot = &vb->slots[oldest];
+        int64_t p = atomic_load(&slot->pts);
+        int64_t o = atomic_load(&slot->offered);
+        // the sequence numbers are never reused: if the state did not change,
+        // the values belong to this frame
+        if (atomic_load(&slot->state) == oldest_seq) {
+            *pts = p;
+            *offered = o;
+            return true;
+        }
+        // the producer dropped this frame in the meantime, retry
+    }
 }
 
 const AVFrame *
 video_buffer_consume_rendered_frame(struct video_buffer *vb) {
-    assert(!vb->rendering_frame_consumed);
-    vb->rendering_frame_consumed = true;
-    fps_counter_add_rendered_frame(vb->fps_counter);
-    if (vb->render_expired_frames) {
-        // unblock video_buffer_offer_decoded_frame()
-        cond_signal(vb->rendering_frame_consumed_cond);
+    assert(vb->consuming_slot == -1);
+
+    if (!vb->render_expired_frames) {
+        // any frame offered from now will require a new notification
+        atomic_store(&vb->notified, false);
     }
-    return vb->rendering_frame;
+
+    unsigned depth = atomic_load(&vb->depth);
+
+    int selected;
+    uint64_t selected_seq;
+    for (;;) {
+        selected = -1;
+        selected_seq = vb->render_expired_frames ? UINT64_MAX : 0;
+        for (unsigned i = 0; i < vb->slot_count; ++i) {
+            uint64_t state = atomic_load(&vb->slots[i].state);
+            if (!is_ready(state)) {
+                continue;
+            }
+            // oldest frame if expired frames are rendered, most recent
+            // frame otherwise
+            if (vb->render_expired_frames ? state < selected_seq
+                                          : state > selected_seq) {
+                selected = i;
+                selected_seq = state;
+            }
+        }
+
+        if (selected == -1) {
+            // nothing to consume (already consumed on previous notification)
+            return NULL;
+        }
+
+        if (atomic_compare_exchange_strong(&vb->slots[selected].state,
+                                           &selected_seq, VB_SLOT_CONSUMING)) {
+            break;
+        }
+        // the producer dropped this frame in the meantime, retry
+    }
+
+    atomic_fetch_sub(&vb->depth, 1);
+
+    if (!vb->render_expired_frames) {
+        // drop the expired frames
+        for (unsigned i = 0; i < vb->slot_count; ++i) {
+            struct video_buffer_slot *slot = &vb->slots[i];
+            uint64_t state = atomic_load(&slot->state);
+            if (is_ready(state) && state < selected_seq &&
+                    atomic_compare_exchange_strong(&slot->state, &state,
+                                                   VB_SLOT_FREE)) {
+                atomic_fetch_sub(&vb->depth, 1);
+                metrics_add(&vb->metrics->skipped_frames, 1);
+            }
+        }
+    }
+
+    vb->consuming_slot = selected;
+    vb->rendering_times = vb->slots[selected].times;
+    metrics_add(&vb->metrics->rendered_frames, 1);
+
+    int64_t now = av_gettime_relative();
+    if (vb->last_consumed != -1) {
+        metrics_histogram_add(&vb->metrics->frame_interval,
+                              now - vb->last_consumed);
+    }
+    vb->last_consumed = now;
+
+    fps_counter_on_rendered_frame(vb->fps_counter, depth);
+    return vb->slots[selected].frame;
+}
+
+void
+video_buffer_release_rendered_frame(struct video_buffer *vb) {
+    assert(vb->consuming_slot != -1);
+    struct video_buffer_slot *slot = &vb->slots[vb->consuming_slot];
+    assert(atomic_load(&slot->state) == VB_SLOT_CONSUMING);
+    atomic_store(&slot->state, VB_SLOT_FREE);
+    vb->consuming_slot = -1;
 }
 
 void
 video_buffer_interrupt(struct video_buffer *vb) {
-    if (vb->render_expired_frames) {
-        mutex_lock(vb->mutex);
-        vb->interrupted = true;
-        mutex_unlock(vb->mutex);
-        // wake up blocking wait
-        cond_signal(vb->rendering_frame_consumed_cond);
-    }
+    atomic_store(&vb->interrupted, true);
 }
@@ -1,48 +1,115 @@
 #ifndef VIDEO_BUFFER_H
 #define VIDEO_BUFFER_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
-#include <SDL2/SDL_mutex.h>
+#include <stdint.h>
 
 #include "config.h"
 #include "fps_counter.h"
+#include "latency_stats.h"
+#include "metrics.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
 
+#define VIDEO_BUFFER_MIN_SLOTS 2
+// more than --frame-queue-size allows, for the display buffer
+#define VIDEO_BUFFER_MAX_SLOTS 64
+
+// Single-producer (the decoder) single-consumer (the renderer) queue of
+// decoded frames.
+//
+// Each slot state is atomic, so that neither side ever waits for the other:
+//  - the decoder writes into its own frame, then swaps it with a free slot,
+//    or with the oldest ready slot if the queue is full;
+//  - the renderer marks the slot it consumes, so that it is not recycled
+//    until it is released.
+struct video_buffer_slot {
+    AVFrame *frame;
+    struct sc_frame_times times;
+    // copies of the frame PTS and offer time, which may be read by the
+    // consumer before it takes the slot (see video_buffer_peek_next_frame())
+    atomic_int_least64_t pts;
+    atomic_int_least64_t offered;
+    // one of the VB_SLOT_* constants, or the sequence number of the frame
+    // if it is ready to be consumed
+    atomic_uint_least64_t state;
+};
+
 struct video_buffer {
     AVFrame *decoding_frame;
-    AVFrame *rendering_frame;
-    SDL_mutex *mutex;
+    // the times at which the decoding frame has been received and decoded,
+    // set by the decoder
+    struct sc_frame_times decoding_times;
+    struct video_buffer_slot slots[VIDEO_BUFFER_MAX_SLOTS];
+    unsigned slot_count;
+
+    // if true, render every frame in order, dropping the oldest ones only when
+    // the queue is full (bounded latency); otherwise, always render the most
+    // recent frame, and drop the previous ones
     bool render_expired_frames;
-    bool interrupted;
-    SDL_cond *rendering_frame_consumed_cond;
-    bool rendering_frame_consumed;
+
+    atomic_bool interrupted;
+    // number of frames ready to be consumed
+    atomic_uint depth;
+    // set when the consumer has been notified and has not started consuming
+    atomic_bool notified;
+
+    // only accessed by the producer
+    uint64_t next_seq;
+    // only accessed by the consumer
+    int consuming_slot; // -1 if none
+    // the times of the last consumed frame (still valid after it is released)
+    struct sc_frame_times rendering_times;
+    int64_t last_consumed; // the time of the last consumption, -1 if none
+    struct latency_stats latency_stats;
+
     struct fps_counter *fps_counter;
+    // also updated by the decoder
+    struct metrics *metrics;
 };
 
 bool
 video_buffer_init(struct video_buffer *vb, struct fps_counter *fps_counter,
-                  bool render_expired_frames);
+                  struct metrics *metrics, bool render_expired_frames,
+                  unsigned slot_count);
 
 void
 video_buffer_destroy(struct video_buffer *vb);
 
 // set the decoded frame as ready for rendering
-// this function locks frames->mutex during its execution
-// the output flag is set to report whether the previous frame has been skipped
-void
-video_buffer_offer_decoded_frame(struct video_buffer *vb,
-                                 bool *previous_frame_skipped);
+// return true if the consumer must be notified (if it has not been notified
+// already for this frame)
+bool
+video_buffer_offer_decoded_frame(struct video_buffer *vb);
+
+// tell whether a decoded frame is still waiting to be consumed (the renderer
+// is behind the decoder)
+// only meaningful if render_expired_frames is false: the pending frame would
+// be dropped by the next one anyway
+bool
+video_buffer_has_pending_frame(struct video_buffer *vb);
 
-// mark the rendering frame as consumed and return it
-// MUST be called with frames->mutex locked!!!
-// the caller is expected to render the returned frame to some texture before
-// unlocking frames->mutex
+// get the PTS and the offer time of the next frame which would be consumed
+// (the oldest one), without consuming it, to decide when to present it
+// only meaningful if render_expired_frames is true
+// return false if there is no frame to consume
+bool
+video_buffer_peek_next_frame(struct video_buffer *vb, int64_t *pts,
+                             int64_t *offered);
+
+// take the next frame to render, and return it (or NULL if there is none)
+// the caller is expected to render the returned frame to some texture, then
+// call video_buffer_release_rendered_frame()
 const AVFrame *
 video_buffer_consume_rendered_frame(struct video_buffer *vb);
 
-// wake up and avoid any blocking call
+// release the frame returned by video_buffer_consume_rendered_frame()
+void
+video_buffer_release_rendered_frame(struct video_buffer *vb);
+
+// drop any further decoded frame
 void
 video_buffer_interrupt(struct video_buffer *vb);
 
@@ -0,0 +1,129 @@
+#include <assert.h>
+
+#include "adaptive_bit_rate.h"
+
+#define MAX_BIT_RATE 8000000
+
+// receive a first packet, to start the first window
+static void
+start(struct adaptive_bit_rate *abr, int64_t *now) {
+    *now = 1000000;
+    bool changed = adaptive_bit_rate_add_packet(abr, 1000, *now - 10000, *now);
+    assert(!changed);
+}
+
+// simulate a window of 500ms of packets received with the given delay
+static bool
+add_window(struct adaptive_bit_rate *abr, int64_t *now, uint32_t bit_rate,
+           int64_t delay) {
+    // 50 packets every 10ms
+    size_t size = bit_rate / 8 / 100;
+    bool changed = false;
+    for (int i = 0; i < 50; ++i) {
+        *now += 10000;
+        changed |= adaptive_bit_rate_add_packet(abr, size, *now - delay, *now);
+    }
+    return changed;
+}
+
+static void test_adaptive_bit_rate_not_synced(void) {
+    struct adaptive_bit_rate abr;
+    adaptive_bit_rate_init(&abr, MAX_BIT_RATE);
+
+    // no capture time
+    for (int i = 1; i <= 1000; ++i) {
+        bool changed = adaptive_bit_rate_add_packet(&abr, 100000, 0,
+                                                    i * 10000);
+        assert(!changed);
+    }
+    assert(abr.bit_rate == MAX_BIT_RATE);
+}
+
+static void test_adaptive_bit_rate_decrease(void) {
+    struct adaptive_bit_rate abr;
+    adaptive_bit_rate_init(&abr, MAX_BIT_RATE);
+
+    int64_t now;
+    start(&abr, &now);
+    bool changed = add_window(&abr, &now, MAX_BIT_RATE, 10000);
+    assert(!changed);
+
+    // congestion: 100ms of queue delay
+    changed = add_window(&abr, &now, MAX_BIT_RATE, 110000);
+    assert(changed);
+    assert(abr.bit_rate == MAX_BIT_RATE * 3 / 4);
+
+    // no other decision while the queue drains
+    changed = add_window(&abr, &now, MAX_BIT_RATE, 110000);
+    assert(!changed);
+    assert(abr.bit_rate == MAX_BIT_RATE * 3 / 4);
+}
+
+static void test_adaptive_bit_rate_increase(void) {
+    struct adaptive_bit_rate abr;
+    adaptive_bit_rate_init(&abr, MAX_BIT_RATE);
+
+    int64_t now;
+    start(&abr, &now);
+    add_window(&abr, &now, MAX_BIT_RATE, 10000);
+    add_window(&abr, &now, MAX_BIT_RATE, 110000);
+    assert(abr.bit_rate == 6000000);
+
+    // during the hold period
+    bool changed = add_window(&abr, &now, abr.bit_rate, 10000);
+    assert(!changed);
+
+    // the queue is drained
+    changed = add_window(&abr, &now, abr.bit_rate, 10000);
+    assert(changed);
+    assert(abr.bit_rate == 6500000);
+
+    // never above the maximum
+    for (int i = 0; i < 10; ++i) {
+        add_window(&abr, &now, abr.bit_rate, 10000);
+    }
+    assert(abr.bit_rate == MAX_BIT_RATE);
+}
+
+static void test_adaptive_bit_rate_static_content(void) {
+    struct adaptive_bit_rate abr;
+    adaptive_bit_rate_init(&abr, MAX_BIT_RATE);
+
+    int64_t now;
+    start(&abr, &now);
+    add_window(&abr, &now, MAX_BIT_RATE, 10000);
+    add_window(&abr, &now, MAX_BIT_RATE, 110000);
+    assert(abr.bit_rate == 6000000);
+
+    // the encoder produces few data, so the bit rate must not be increased
+    for (int i = 0; i < 10; ++i) {
+        bool changed = add_window(&abr, &now, 1000000, 10000);
+        assert(!changed);
+    }
+    assert(abr.bit_rate == 6000000);
+}
+
+static void test_adaptive_bit_rate_min(void) {
+    struct adaptive_bit_rate abr;
+    adaptive_bit_rate_init(&abr, MAX_BIT_RATE);
+
+    int64_t now;
+    start(&abr, &now);
+    add_window(&abr, &now, MAX_BIT_RATE, 10000);
+    for (int i = 0; i < 100; ++i) {
+        add_window(&abr, &now, MAX_BIT_RATE, 500000);
+    }
+    assert(abr.bit_rate == MAX_BIT_RATE / 16);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_adaptive_bit_rate_not_synced();
+    test_adaptive_bit_rate_decrease();
+    test_adaptive_bit_rate_increase();
+    test_adaptive_bit_rate_static_content();
+    test_adaptive_bit_rate_min();
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <string.h>
+
+#include "annexb_splitter.h"
+
+// garbage, SPS, PPS, IDR (2 slices), non-IDR, SEI + non-IDR
+static const uint8_t stream[] = {
+    0x12, 0x34,
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x28,
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00,
+    0x00, 0x00, 0x01, 0x65, 0x41, 0x9a, // first_mb_in_slice != 0
+    0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02,
+    0x00, 0x00, 0x01, 0x06, 0x05, 0x01,
+    0x00, 0x00, 0x01, 0x41, 0x9b, 0x03,
+};
+
+// offsets of the units in the stream
+#define CONFIG_START 2
+#define IDR_START 18
+#define P1_START 32
+#define P2_START 39
+
+static void push(struct annexb_splitter *splitter, const uint8_t *data,
+                 size_t len) {
+    uint8_t *buf = annexb_splitter_reserve(splitter, len);
+    assert(buf);
+    memcpy(buf, data, len);
+    annexb_splitter_commit(splitter, len);
+}
+
+static void assert_unit(const struct annexb_unit *unit, size_t start,
+                        size_t end, bool config) {
+    assert(unit->size == end - start);
+    assert(!memcmp(unit->data, &stream[start], unit->size));
+    assert(unit->config == config);
+}
+
+static void test_split_chunk_size(size_t chunk) {
+    struct annexb_splitter splitter;
+    annexb_splitter_init(&splitter);
+
+    // the units are copied, they are invalidated by the next push
+    struct {
+        uint8_t data[sizeof(stream)];
+        size_t size;
+        bool config;
+    } units[4];
+    unsigned count = 0;
+
+    for (size_t offset = 0; offset < sizeof(stream); offset += chunk) {
+        size_t len = sizeof(stream) - offset;
+        if (len > chunk) {
+            len = chunk;
+        }
+        push(&splitter, &stream[offset], len);
+
+        struct annexb_unit unit;
+        while (annexb_splitter_next(&splitter, &unit)) {
+            assert(count < 4);
+            memcpy(units[count].data, unit.data, unit.size);
+            units[count].size = unit.size;
+            units[count].config = unit.config;
+            ++count;
+        }
+    }
+
+    struct annexb_unit unit;
+    assert(annexb_splitter_flush(&splitter, &unit));
+    assert_unit(&unit, P2_START, sizeof(stream), false);
+    assert(!annexb_splitter_flush(&splitter, &unit));
+
+    assert(count == 3);
+    const size_t bounds[] = {CONFIG_START, IDR_START, P1_START, P2_START};
+    for (unsigned i = 0; i < count; ++i) {
+        struct annexb_unit u = {
+            .data = units[i].data,
+            .size = units[i].size,
+            .config = units[i].config,
+        };
+        assert_unit(&u, bounds[i], bounds[i + 1], i == 0);
+    }
+
+    annexb_splitter_destroy(&splitter);
+}
+
+static void test_split(void) {
+    // the start codes and the NAL headers may be split across the reads
+    for (size_t chunk = 1; chunk <= sizeof(stream); ++chunk) {
+        test_split_chunk_size(chunk);
+    }
+}
+
+static void test_no_start_code(void) {
+    struct annexb_splitter splitter;
+    annexb_splitter_init(&splitter);
+
+    const uint8_t garbage[] = {0x12, 0x34, 0x56, 0x00, 0x00};
+    push(&splitter, garbage, sizeof(garbage));
+
+    struct annexb_unit unit;
+    assert(!annexb_splitter_next(&splitter, &unit));
+    assert(!annexb_splitter_flush(&splitter, &unit));
+
+    annexb_splitter_destroy(&splitter);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_split();
+    test_no_start_code();
+    return 0;
+}
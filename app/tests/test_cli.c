@@ -44,23 +44,41 @@ static void test_options(void) {
 
     char *argv[] = {
         "scrcpy",
+        "--adaptive-bit-rate",
         "--always-on-top",
         "--bit-rate", "5M",
+        "--control-queue-size", "1024",
         "--crop", "100:200:300:400",
+        "--decoder-threads", "4",
+        "--decoder-thread-type", "frame",
+        "--frame-queue-size", "5",
         "--fullscreen",
+        "--hw-decoder", "vaapi",
         "--max-fps", "30",
         "--max-size", "1024",
         "--lock-video-orientation", "2",
         // "--no-control" is not compatible with "--turn-screen-off"
         // "--no-display" is not compatible with "--fulscreen"
         "--port", "1234:1236",
+        "--preview-bit-rate", "1M",
+        "--preview-max-size", "480",
         "--push-target", "/sdcard/Movies",
         "--record", "file",
+        "--record-buffer", "16M",
         "--record-format", "mkv",
+        "--record-queue-policy", "drop",
+        "--record-queue-size", "256",
+        "--record-segment", "60",
         "--render-expired-frames",
+        "--render-thread",
+        "--replay-buffer", "30",
         "--serial", "0123456789abcdef",
+        "--shm-sink", "scrcpy-frames",
         "--show-touches",
         "--turn-screen-off",
+        "--video-codec", "h265",
+        "--encoder-profile", "latency",
+        "--video-recv-buffer", "4M",
         "--prefer-text",
         "--window-title", "my device",
         "--window-x", "100",
@@ -74,22 +92,40 @@ static void test_options(void) {
     assert(ok);
 
     const struct scrcpy_options *opts = &args.opts;
+    assert(opts->adaptive_bit_rate);
     assert(opts->always_on_top);
     assert(opts->bit_rate == 5000000);
+    assert(opts->control_queue_size == 1024);
     assert(!strcmp(opts->crop, "100:200:300:400"));
+    assert(opts->decoder_threads == 4);
+    assert(opts->decoder_thread_type == SC_DECODER_THREAD_TYPE_FRAME);
+    assert(opts->frame_queue_size == 5);
     assert(opts->fullscreen);
+    assert(opts->hw_decoder == SC_HW_DECODER_VAAPI);
     assert(opts->max_fps == 30);
     assert(opts->max_size == 1024);
     assert(opts->lock_video_orientation == 2);
     assert(opts->port_range.first == 1234);
     assert(opts->port_range.last == 1236);
+    assert(opts->preview_bit_rate == 1000000);
+    assert(opts->preview_max_size == 480);
     assert(!strcmp(opts->push_target, "/sdcard/Movies"));
     assert(!strcmp(opts->record_filename, "file"));
+    assert(opts->record_buffer_size == 16000000);
     assert(opts->record_format == SC_RECORD_FORMAT_MKV);
+    assert(opts->record_queue_policy == SC_RECORD_QUEUE_POLICY_DROP);
+    assert(opts->record_queue_size == 256);
+    assert(opts->record_segment == 60);
     assert(opts->render_expired_frames);
+    assert(opts->render_thread);
+    assert(opts->replay_buffer == 30);
     assert(!strcmp(opts->serial, "0123456789abcdef"));
+    assert(!strcmp(opts->shm_sink, "scrcpy-frames"));
     assert(opts->show_touches);
     assert(opts->turn_screen_off);
+    assert(opts->video_codec == SC_CODEC_H265);
+    assert(opts->encoder_profile == SC_ENCODER_PROFILE_LATENCY);
+    assert(opts->video_recv_buffer == 4000000);
     assert(opts->prefer_text);
     assert(!strcmp(opts->window_title, "my device"));
     assert(opts->window_x == 100);
@@ -123,6 +159,459 @@ static void test_options2(void) {
     assert(opts->record_format == SC_RECORD_FORMAT_MP4);
 }
 
+#ifdef HAVE_V4L2
+static void test_v4l2_sink(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    // the frames are decoded for the sink, even without display
+    char *argv[] = {"scrcpy", "--no-display", "--v4l2-sink", "/dev/video2"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!args.opts.display);
+    assert(!strcmp(args.opts.v4l2_device, "/dev/video2"));
+}
+#endif
+
+static void test_render_pacing(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--render-pacing", "smooth"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.render_pacing == SC_RENDER_PACING_SMOOTH);
+
+    // only the most recent frame is presented
+    char *argv2[] = {"scrcpy", "--render-pacing", "vsync",
+                     "--render-expired-frames"};
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_display_buffer(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--display-buffer", "200"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.display_buffer == 200);
+
+    // the frames are already presented at their PTS
+    char *argv2[] = {"scrcpy", "--display-buffer", "200",
+                     "--render-pacing", "smooth"};
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_metrics_port(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--metrics-port", "9100"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.metrics_port == 9100);
+
+    char *argv2[] = {"scrcpy", "--metrics-port", "0"};
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_input_resampling(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    assert(args.opts.input_resampling);
+    assert(!args.opts.pointer_prediction);
+
+    char *argv[] = {"scrcpy", "--no-input-resampling", "--pointer-prediction"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!args.opts.input_resampling);
+    assert(args.opts.pointer_prediction);
+}
+
+static void test_file_transfer_workers(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--file-transfer-workers", "4"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.file_transfer_workers == 4);
+
+    char *argv2[] = {"scrcpy", "--file-transfer-workers", "9"};
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_adaptive_resolution(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--adaptive-resolution", "-m", "1920"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.adaptive_resolution);
+    assert(args.opts.max_size == 1920);
+
+    // the window size is meaningless without display
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--adaptive-resolution", "--no-display",
+                     "--record", "file.mp4"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_screenshot(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--screenshot-dir", "/tmp/shots",
+                    "--screenshot-format", "jpeg"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!strcmp(args.opts.screenshot_dir, "/tmp/shots"));
+    assert(args.opts.screenshot_format == SC_SCREENSHOT_FORMAT_JPEG);
+
+    char *argv2[] = {"scrcpy", "--screenshot-format", "bmp"};
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_input(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--input", "-"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!strcmp(args.opts.input, "-"));
+    // there is no device to control
+    assert(!args.opts.control);
+
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--input", "-", "-s", "0123456789abcdef"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+
+    struct scrcpy_cli_args args3 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv3[] = {"scrcpy", "--input", "-", "--video-codec", "h265"};
+    ok = scrcpy_parse_args(&args3, ARRAY_LEN(argv3), argv3);
+    assert(!ok);
+}
+
+static void test_reconnect(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    assert(!args.opts.reconnect);
+
+    char *argv[] = {"scrcpy", "--reconnect"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.reconnect);
+
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--reconnect", "--input", "-"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_record_buffer(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    assert(args.opts.record_buffer_size == 4 * 1024 * 1024);
+
+    char *argv[] = {"scrcpy", "--record", "file.mp4", "--record-buffer", "0"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!args.opts.record_buffer_size);
+
+    char *argv2[] = {"scrcpy", "--record", "file.mp4",
+                     "--record-buffer", "-1"};
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_record_fragmented(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--record", "file.mp4", "--record-fragmented"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.record_fragmented);
+
+    // only supported for mp4
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--record", "file.mkv", "--record-fragmented"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_relay(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--relay-port", "27300"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.relay_port == 27300);
+    assert(args.opts.control);
+
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--relay-connect", "127.0.0.1:27300"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(ok);
+    assert(!strcmp(args2.opts.relay_connect, "127.0.0.1:27300"));
+    // the control remains with the owner of the relay
+    assert(!args2.opts.control);
+
+    struct scrcpy_cli_args args3 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv3[] = {"scrcpy", "--relay-connect", "127.0.0.1"};
+    ok = scrcpy_parse_args(&args3, ARRAY_LEN(argv3), argv3);
+    assert(!ok);
+
+    struct scrcpy_cli_args args4 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv4[] = {"scrcpy", "--relay-connect", "127.0.0.1:27300", "-s",
+                     "0123456789abcdef"};
+    ok = scrcpy_parse_args(&args4, ARRAY_LEN(argv4), argv4);
+    assert(!ok);
+}
+
+static void test_server_daemon(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    assert(!args.opts.server_daemon);
+
+    char *argv[] = {"scrcpy", "--server-daemon", "-s", "0123456789abcdef"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.server_daemon);
+
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--server-daemon", "-d", "192.168.1.2"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_several_serials(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "-s", "0123456789abcdef", "-s", "abcdef"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!strcmp(args.opts.serial, "0123456789abcdef"));
+    assert(args.opts.serials.count == 2);
+    assert(!strcmp(args.opts.serials.data[0], "0123456789abcdef"));
+    assert(!strcmp(args.opts.serials.data[1], "abcdef"));
+
+    // a single record file for several devices
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "-s", "0123456789abcdef", "-s", "abcdef",
+                     "-r", "file.mp4"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_tile(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "-s", "0123456789abcdef", "-s", "abcdef",
+                    "--tile"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.tile);
+
+    // the tiles are rendered from the main thread
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--tile", "--render-thread"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_trace(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    assert(!args.opts.trace_filename);
+
+    char *argv[] = {"scrcpy", "--trace", "trace.json"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(!strcmp(args.opts.trace_filename, "trace.json"));
+}
+
+static void test_upscale_filter(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    assert(args.opts.upscale_filter == SC_UPSCALE_FILTER_LINEAR);
+
+    char *argv[] = {"scrcpy", "--upscale-filter", "lanczos"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.upscale_filter == SC_UPSCALE_FILTER_LANCZOS);
+
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--upscale-filter", "nearest"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_video_transport(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {"scrcpy", "--device", "192.168.1.2",
+                    "--url", "http://192.168.1.2:8080",
+                    "--video-transport", "udp"};
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+    assert(args.opts.video_transport == SC_VIDEO_TRANSPORT_UDP);
+
+    // the datagrams could not be forwarded by adb
+    struct scrcpy_cli_args args2 = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+    char *argv2[] = {"scrcpy", "--video-transport", "udp"};
+    ok = scrcpy_parse_args(&args2, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
 static void test_parse_shortcut_mods(void) {
     struct sc_shortcut_mods mods;
     bool ok;
@@ -168,6 +657,27 @@ int main(int argc, char *argv[]) {
     test_flag_help();
     test_options();
     test_options2();
+#ifdef HAVE_V4L2
+    test_v4l2_sink();
+#endif
+    test_render_pacing();
+    test_display_buffer();
+    test_metrics_port();
+    test_input_resampling();
+    test_file_transfer_workers();
+    test_adaptive_resolution();
+    test_screenshot();
+    test_input();
+    test_reconnect();
+    test_record_buffer();
+    test_record_fragmented();
+    test_relay();
+    test_server_daemon();
+    test_several_serials();
+    test_tile();
+    test_trace();
+    test_upscale_filter();
+    test_video_transport();
     test_parse_shortcut_mods();
     return 0;
 };
@@ -0,0 +1,71 @@
+#include <assert.h>
+
+#include "clock_sync.h"
+
+static void test_clock_sync_not_synced(void) {
+    struct clock_sync cs;
+    clock_sync_init(&cs);
+
+    int64_t local;
+    bool ok = clock_sync_to_local(&cs, 1000, &local);
+    assert(!ok);
+}
+
+static void test_clock_sync_symmetric(void) {
+    struct clock_sync cs;
+    clock_sync_init(&cs);
+
+    // the device clock is 5000us ahead, 100us each way, 20us on the device
+    clock_sync_add_sample(&cs, 1000, 6100, 6120, 1220);
+
+    int64_t local;
+    bool ok = clock_sync_to_local(&cs, 7000, &local);
+    assert(ok);
+    assert(local == 2000);
+}
+
+static void test_clock_sync_best_rtt(void) {
+    struct clock_sync cs;
+    clock_sync_init(&cs);
+
+    // delayed on the way back: the offset estimation is wrong
+    clock_sync_add_sample(&cs, 1000, 6100, 6100, 3100);
+    // accurate sample
+    clock_sync_add_sample(&cs, 10000, 15010, 15010, 10020);
+    // delayed on the way to the device
+    clock_sync_add_sample(&cs, 20000, 27000, 27000, 22010);
+
+    // the sample having the lowest round trip time must be used
+    int64_t local;
+    bool ok = clock_sync_to_local(&cs, 5000, &local);
+    assert(ok);
+    assert(local == 0);
+}
+
+static void test_clock_sync_window(void) {
+    struct clock_sync cs;
+    clock_sync_init(&cs);
+
+    // very good sample, with an offset of 1000
+    clock_sync_add_sample(&cs, 0, 1000, 1000, 0);
+
+    // once CLOCK_SYNC_SAMPLES worse samples have been added, it must be
+    // forgotten
+    for (int i = 0; i < CLOCK_SYNC_SAMPLES; ++i) {
+        int64_t t = 100000 * (i + 1);
+        clock_sync_add_sample(&cs, t, t + 2050, t + 2050, t + 100);
+    }
+
+    int64_t local;
+    bool ok = clock_sync_to_local(&cs, 12000, &local);
+    assert(ok);
+    assert(local == 10000);
+}
+
+int main(void) {
+    test_clock_sync_not_synced();
+    test_clock_sync_symmetric();
+    test_clock_sync_best_rtt();
+    test_clock_sync_window();
+    return 0;
+}
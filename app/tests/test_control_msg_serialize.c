@@ -223,6 +223,27 @@ static void test_serialize_set_clipboard(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_set_clipboard_part(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_SET_CLIPBOARD_PART,
+        .set_clipboard = {
+            .paste = true, // ignored
+            .text = "hello",
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 10);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_SET_CLIPBOARD_PART,
+        0x00, 0x00, 0x00, 0x05, // text length
+        'h', 'e', 'l', 'l', 'o', // text
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
 static void test_serialize_set_screen_power_mode(void) {
     struct control_msg msg = {
         .type = CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE,
@@ -257,6 +278,227 @@ static void test_serialize_rotate_device(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_set_max_size(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_SET_MAX_SIZE,
+        .set_max_size = {
+            .max_size = 1024,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 3);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_SET_MAX_SIZE,
+        0x04, 0x00, // 1024
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_set_video_paused(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_SET_VIDEO_PAUSED,
+        .set_video_paused = {
+            .paused = true,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 2);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_SET_VIDEO_PAUSED,
+        0x01, // paused
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_request_key_frame(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_REQUEST_KEY_FRAME,
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 1);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_REQUEST_KEY_FRAME,
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_ping(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_PING,
+        .ping = {
+            .timestamp = UINT64_C(0x0102030405060708),
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 9);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_PING,
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, // timestamp
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_set_bit_rate(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_SET_BIT_RATE,
+        .set_bit_rate = {
+            .bit_rate = 4000000,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 5);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_SET_BIT_RATE,
+        0x00, 0x3d, 0x09, 0x00, // 4000000
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_set_crop(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_SET_CROP,
+        .set_crop = {
+            .position = {
+                .point = {
+                    .x = 260,
+                    .y = 1026,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .width = 540,
+            .height = 960,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    int size = control_msg_serialize(&msg, buf);
+    assert(size == 21);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_SET_CROP,
+        0x00, 0x00, 0x01, 0x04, 0x00, 0x00, 0x04, 0x02, // 260 1026
+        0x04, 0x38, 0x07, 0x80, // 1080 1920
+        0x00, 0x00, 0x02, 0x1c, // 540
+        0x00, 0x00, 0x03, 0xc0, // 960
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_compact(void) {
+    struct control_msg_compact_state state;
+    control_msg_compact_state_init(&state);
+
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_DOWN,
+            .pointer_id = -1, // mouse
+            .position = {
+                .point = {
+                    .x = 100,
+                    .y = 200,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .pressure = 1.0f,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    size_t size = control_msg_serialize_compact(&msg, &state, buf);
+    assert(size == 14);
+
+    const unsigned char expected_down[] = {
+        CONTROL_MSG_TYPE_SET_SCREEN_SIZE,
+        0x04, 0x38, 0x07, 0x80, // 1080 1920
+        CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT_COMPACT,
+        0x00, // AKEY_EVENT_ACTION_DOWN
+        0x01, // pointer id + 2
+        0xc8, 0x01, // +100
+        0x90, 0x03, // +200
+        0xff, // pressure
+        0x01, // AMOTION_EVENT_BUTTON_PRIMARY
+    };
+    assert(!memcmp(buf, expected_down, sizeof(expected_down)));
+
+    // same screen size: not sent again
+    msg.inject_touch_event.action = AMOTION_EVENT_ACTION_MOVE;
+    msg.inject_touch_event.position.point.x = 98;
+    msg.inject_touch_event.position.point.y = 203;
+    size = control_msg_serialize_compact(&msg, &state, buf);
+    assert(size == 7);
+
+    const unsigned char expected_move[] = {
+        CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT_COMPACT,
+        0x02, // AMOTION_EVENT_ACTION_MOVE
+        0x01, // pointer id + 2
+        0x03, // -2
+        0x06, // +3
+        0xff, // pressure
+        0x01, // AMOTION_EVENT_BUTTON_PRIMARY
+    };
+    assert(!memcmp(buf, expected_move, sizeof(expected_move)));
+
+    struct control_msg scroll = {
+        .type = CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT,
+        .inject_scroll_event = {
+            .position = {
+                .point = {
+                    .x = 98,
+                    .y = 203,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .hscroll = 1,
+            .vscroll = -1,
+        },
+    };
+
+    size = control_msg_serialize_compact(&scroll, &state, buf);
+    assert(size == 5);
+
+    const unsigned char expected_scroll[] = {
+        CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT_COMPACT,
+        0x00, 0x00, // same position
+        0x02, // 1
+        0x01, // -1
+    };
+    assert(!memcmp(buf, expected_scroll, sizeof(expected_scroll)));
+
+    // other messages are serialized as usual
+    struct control_msg rotate = {
+        .type = CONTROL_MSG_TYPE_ROTATE_DEVICE,
+    };
+    size = control_msg_serialize_compact(&rotate, &state, buf);
+    assert(size == 1);
+    assert(buf[0] == CONTROL_MSG_TYPE_ROTATE_DEVICE);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -271,7 +513,15 @@ int main(int argc, char *argv[]) {
     test_serialize_collapse_notification_panel();
     test_serialize_get_clipboard();
     test_serialize_set_clipboard();
+    test_serialize_set_clipboard_part();
     test_serialize_set_screen_power_mode();
     test_serialize_rotate_device();
+    test_serialize_ping();
+    test_serialize_set_bit_rate();
+    test_serialize_set_crop();
+    test_serialize_set_max_size();
+    test_serialize_set_video_paused();
+    test_serialize_request_key_frame();
+    test_serialize_compact();
     return 0;
 }
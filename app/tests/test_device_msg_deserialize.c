@@ -45,11 +45,103 @@ static void test_deserialize_clipboard_big(void) {
     device_msg_destroy(&msg);
 }
 
+static void test_deserialize_clipboard_part(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_CLIPBOARD_PART,
+        0x00, 0x00, 0x00, 0x03, // text length
+        0x41, 0x42, 0x43, // "ABC"
+    };
+
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 8);
+
+    assert(msg.type == DEVICE_MSG_TYPE_CLIPBOARD_PART);
+    assert(msg.clipboard.text);
+    assert(!strcmp("ABC", msg.clipboard.text));
+
+    device_msg_destroy(&msg);
+}
+
+static void test_deserialize_pong(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_PONG,
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, // ping timestamp
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xE8, // ping received
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x12, // pong sent
+    };
+
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 25);
+
+    assert(msg.type == DEVICE_MSG_TYPE_PONG);
+    assert(msg.pong.ping_timestamp == UINT64_C(0x0102030405060708));
+    assert(msg.pong.ping_received == 1000);
+    assert(msg.pong.pong_sent == 1042);
+
+    // incomplete message
+    r = device_msg_deserialize(input, sizeof(input) - 1, &msg);
+    assert(r == 0);
+}
+
+static void test_deserialize_stats(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_STATS,
+        0x00, 0x00, 0x00, 0x3C, // encoded frames
+        0x00, 0x00, 0x00, 0x02, // dropped frames
+        0x00, 0x0F, 0x42, 0x40, // bytes per second
+        0x00, 0x00, 0x1F, 0x40, // encode time avg
+        0x00, 0x00, 0x4E, 0x20, // encode time max
+        0x00, 0x00, 0x00, 0x03, // queue depth max
+        0x00, 0x00, 0x00, 0x78, // injected events
+        0x00, 0x00, 0x01, 0xF4, // injection latency avg
+        0x00, 0x00, 0x0F, 0xA0, // injection latency max
+    };
+
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 37);
+
+    assert(msg.type == DEVICE_MSG_TYPE_STATS);
+    assert(msg.stats.encoded_frames == 60);
+    assert(msg.stats.dropped_frames == 2);
+    assert(msg.stats.bytes_per_second == 1000000);
+    assert(msg.stats.encode_time_avg == 8000);
+    assert(msg.stats.encode_time_max == 20000);
+    assert(msg.stats.queue_depth_max == 3);
+    assert(msg.stats.injected_events == 120);
+    assert(msg.stats.injection_latency_avg == 500);
+    assert(msg.stats.injection_latency_max == 4000);
+
+    // incomplete message
+    r = device_msg_deserialize(input, sizeof(input) - 1, &msg);
+    assert(r == 0);
+}
+
+static void test_deserialize_refresh_rate(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_REFRESH_RATE,
+        0x00, 0x00, 0xEA, 0x24, // 59940 mHz
+    };
+
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 5);
+
+    assert(msg.type == DEVICE_MSG_TYPE_REFRESH_RATE);
+    assert(msg.refresh_rate.rate == 59940);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
 
     test_deserialize_clipboard();
     test_deserialize_clipboard_big();
+    test_deserialize_clipboard_part();
+    test_deserialize_pong();
+    test_deserialize_stats();
+    test_deserialize_refresh_rate();
     return 0;
 }
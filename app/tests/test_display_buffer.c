@@ -0,0 +1,80 @@
+#include <assert.h>
+
+#include "display_buffer.h"
+
+static void test_display_buffer_regular(void) {
+    struct display_buffer db;
+    display_buffer_init(&db, 100000);
+
+    // the first frame is presented after the delay
+    int64_t t = 5000000;
+    assert(display_buffer_get_deadline(&db, 0, t) == t + 100000);
+    // several calls for the same frame
+    assert(display_buffer_get_deadline(&db, 0, t + 3000) == t + 100000);
+
+    for (int i = 1; i < 10; ++i) {
+        int64_t pts = i * 16666;
+        assert(display_buffer_get_deadline(&db, pts, t + pts)
+                == t + pts + 100000);
+    }
+}
+
+static void test_display_buffer_jitter(void) {
+    struct display_buffer db;
+    display_buffer_init(&db, 100000);
+
+    int64_t t = 5000000;
+    assert(display_buffer_get_deadline(&db, 0, t) == t + 100000);
+
+    // late arrivals do not change the presentation times (almost)
+    int64_t deadline = display_buffer_get_deadline(&db, 16666, t + 60000);
+    assert(deadline >= t + 16666 + 100000);
+    assert(deadline < t + 16666 + 100000 + 1000);
+
+    // an early one lowers the offset
+    deadline = display_buffer_get_deadline(&db, 33333, t + 33333 - 10000);
+    assert(deadline == t + 33333 - 10000 + 100000);
+}
+
+static void test_display_buffer_drift(void) {
+    struct display_buffer db;
+    display_buffer_init(&db, 100000);
+
+    int64_t t = 5000000;
+    display_buffer_get_deadline(&db, 0, t);
+
+    // the device clock is slower: the arrivals drift
+    int64_t pts = 0;
+    int64_t deadline = 0;
+    for (int i = 1; i < 2000; ++i) {
+        pts += 16666;
+        int64_t arrival = t + pts + i * 10;
+        deadline = display_buffer_get_deadline(&db, pts, arrival);
+        assert(deadline > arrival);
+    }
+    // the actual delay stays close to the requested one
+    int64_t arrival = t + pts + 1999 * 10;
+    assert(deadline - arrival > 95000);
+}
+
+static void test_display_buffer_discontinuity(void) {
+    struct display_buffer db;
+    display_buffer_init(&db, 100000);
+
+    int64_t t = 5000000;
+    display_buffer_get_deadline(&db, 1000000, t);
+    // the PTS restarted from 0
+    assert(display_buffer_get_deadline(&db, 0, t + 16666)
+            == t + 16666 + 100000);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_display_buffer_regular();
+    test_display_buffer_jitter();
+    test_display_buffer_drift();
+    test_display_buffer_discontinuity();
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <assert.h>
+#include <string.h>
+
+#include "frame_reassembler.h"
+#include "util/buffer_util.h"
+
+#define MAX_PAYLOAD FRAME_REASSEMBLER_MAX_PAYLOAD
+
+// fill a datagram for a fragment of data, return its length
+static size_t make_datagram(uint8_t *dgram, uint32_t seq, uint16_t index,
+                            uint64_t pts, const uint8_t *data, uint32_t size) {
+    uint16_t count = (size + MAX_PAYLOAD - 1) / MAX_PAYLOAD;
+    size_t offset = (size_t) index * MAX_PAYLOAD;
+    size_t len = index == count - 1 ? size - offset : MAX_PAYLOAD;
+
+    buffer_write32be(dgram, seq);
+    buffer_write16be(&dgram[4], index);
+    buffer_write16be(&dgram[6], count);
+    buffer_write64be(&dgram[8], pts);
+    buffer_write64be(&dgram[16], 42);
+    buffer_write32be(&dgram[24], size);
+    memcpy(&dgram[FRAME_REASSEMBLER_HEADER_SIZE], data + offset, len);
+    return FRAME_REASSEMBLER_HEADER_SIZE + len;
+}
+
+static int push(struct frame_reassembler *ra, uint32_t seq, uint16_t index,
+                uint64_t pts, const uint8_t *data, uint32_t size,
+                struct reassembled_frame *frame) {
+    uint8_t dgram[FRAME_REASSEMBLER_MAX_DATAGRAM];
+    size_t len = make_datagram(dgram, seq, index, pts, data, size);
+    return frame_reassembler_push(ra, dgram, len, frame);
+}
+
+static void test_reassemble_out_of_order(void) {
+    static uint8_t data[3000];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = i;
+    }
+
+    struct frame_reassembler ra;
+    frame_reassembler_init(&ra, true);
+
+    struct reassembled_frame frame;
+    assert(push(&ra, 0, 2, 1000, data, sizeof(data), &frame) == 0);
+    assert(push(&ra, 0, 0, 1000, data, sizeof(data), &frame) == 0);
+    // duplicated
+    assert(push(&ra, 0, 0, 1000, data, sizeof(data), &frame) == 0);
+    assert(push(&ra, 0, 1, 1000, data, sizeof(data), &frame) == 1);
+
+    assert(frame.pts == 1000);
+    assert(frame.capture_time == 42);
+    assert(frame.size == sizeof(data));
+    assert(!memcmp(frame.data, data, sizeof(data)));
+
+    // late duplicate of a complete packet
+    assert(push(&ra, 0, 1, 1000, data, sizeof(data), &frame) == 0);
+
+    assert(!ra.lost_packets);
+    assert(!ra.lost_reference);
+
+    frame_reassembler_destroy(&ra);
+}
+
+static void test_drop_non_reference(void) {
+    // non-reference slice (nal_ref_idc = 0), on 2 fragments
+    static uint8_t data[2000] = {0x00, 0x00, 0x00, 0x01, 0x01, 0x9e};
+
+    struct frame_reassembler ra;
+    frame_reassembler_init(&ra, true);
+
+    struct reassembled_frame frame;
+    assert(push(&ra, 0, 0, 1000, data, sizeof(data), &frame) == 0);
+    // the second fragment is lost, the next packet is received
+    assert(push(&ra, 1, 0, 2000, data, 10, &frame) == 1);
+    assert(frame.pts == 2000);
+    assert(ra.lost_packets == 1);
+    assert(!ra.lost_reference);
+
+    // a late fragment of the dropped packet is ignored
+    assert(push(&ra, 0, 1, 1000, data, sizeof(data), &frame) == 0);
+
+    frame_reassembler_destroy(&ra);
+}
+
+static void test_drop_reference(void) {
+    // reference slice (nal_ref_idc = 2), on 2 fragments
+    static uint8_t data[2000] = {0x00, 0x00, 0x00, 0x01, 0x41, 0x9a};
+
+    struct frame_reassembler ra;
+    frame_reassembler_init(&ra, true);
+
+    struct reassembled_frame frame;
+    assert(push(&ra, 0, 1, 1000, data, sizeof(data), &frame) == 0);
+    assert(push(&ra, 1, 0, 2000, data, sizeof(data), &frame) == 0);
+    assert(ra.lost_packets == 1);
+    assert(ra.lost_reference);
+    ra.lost_reference = false;
+
+    // packets 2 and 3 are entirely lost
+    assert(push(&ra, 4, 0, 5000, data, 10, &frame) == 1);
+    assert(ra.lost_packets == 4);
+    assert(ra.lost_reference);
+
+    frame_reassembler_destroy(&ra);
+}
+
+static void test_drop_without_detection(void) {
+    // non-reference H.264 slice, but the codec may be another one
+    static uint8_t data[2000] = {0x00, 0x00, 0x00, 0x01, 0x01, 0x9e};
+
+    struct frame_reassembler ra;
+    frame_reassembler_init(&ra, false);
+
+    struct reassembled_frame frame;
+    assert(push(&ra, 0, 0, 1000, data, sizeof(data), &frame) == 0);
+    assert(push(&ra, 1, 0, 2000, data, 10, &frame) == 1);
+    assert(ra.lost_packets == 1);
+    assert(ra.lost_reference);
+
+    frame_reassembler_destroy(&ra);
+}
+
+static void test_malformed(void) {
+    static uint8_t data[2000];
+
+    struct frame_reassembler ra;
+    frame_reassembler_init(&ra, true);
+
+    uint8_t dgram[FRAME_REASSEMBLER_MAX_DATAGRAM];
+    size_t len = make_datagram(dgram, 0, 0, 1000, data, sizeof(data));
+
+    struct reassembled_frame frame;
+    // truncated
+    assert(frame_reassembler_push(&ra, dgram, len - 1, &frame) == 0);
+    assert(frame_reassembler_push(&ra, dgram, 10, &frame) == 0);
+
+    // wrong fragment count
+    buffer_write16be(&dgram[6], 3);
+    assert(frame_reassembler_push(&ra, dgram, len, &frame) == 0);
+
+    assert(!ra.in_progress);
+
+    frame_reassembler_destroy(&ra);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_reassemble_out_of_order();
+    test_drop_non_reference();
+    test_drop_reference();
+    test_drop_without_detection();
+    test_malformed();
+    return 0;
+}
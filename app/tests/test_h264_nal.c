@@ -0,0 +1,162 @@
+#include <assert.h>
+#include <string.h>
+
+#include "h264_nal.h"
+
+// the trivial implementation, to check the vectorized one
+static size_t find_nal_naive(const uint8_t *data, size_t len) {
+    for (size_t i = 2; i < len; ++i) {
+        if (data[i] == 1 && !data[i - 1] && !data[i - 2]) {
+            return i + 1;
+        }
+    }
+    return len;
+}
+
+static void test_find_nal(void) {
+    const uint8_t data[] = {0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x00,
+                            0x01, 0x68};
+    size_t offset = h264_find_nal(data, sizeof(data));
+    assert(offset == 4);
+
+    offset += h264_find_nal(data + offset, sizeof(data) - offset);
+    assert(offset == 9);
+
+    offset += h264_find_nal(data + offset, sizeof(data) - offset);
+    assert(offset == sizeof(data));
+
+    // truncated start code
+    const uint8_t data2[] = {0x42, 0x00, 0x00};
+    assert(h264_find_nal(data2, sizeof(data2)) == sizeof(data2));
+}
+
+static void test_find_nal_long(void) {
+    uint8_t data[100];
+
+    // a start code at every position, across the 16-byte blocks
+    for (size_t pos = 0; pos + 3 <= sizeof(data); ++pos) {
+        memset(data, 0x42, sizeof(data));
+        data[pos] = 0x00;
+        data[pos + 1] = 0x00;
+        data[pos + 2] = 0x01;
+        assert(h264_find_nal(data, sizeof(data)) == pos + 3);
+        // truncated just before the 01
+        assert(h264_find_nal(data, pos + 2) == pos + 2);
+    }
+
+    // pseudo-random bytes, with many zeros
+    uint32_t seed = 42;
+    for (int iter = 0; iter < 1000; ++iter) {
+        for (size_t i = 0; i < sizeof(data); ++i) {
+            seed = seed * 1103515245 + 12345;
+            uint8_t r = seed >> 24;
+            data[i] = r < 96 ? 0 : r < 112 ? 1 : r;
+        }
+        size_t offset = 0;
+        while (offset < sizeof(data)) {
+            size_t expected = find_nal_naive(data + offset,
+                                             sizeof(data) - offset);
+            assert(h264_find_nal(data + offset, sizeof(data) - offset)
+                    == expected);
+            offset += expected;
+        }
+    }
+}
+
+static void test_key_frame(void) {
+    // SPS, PPS, IDR slice
+    const uint8_t idr[] = {0x00, 0x00, 0x00, 0x01, 0x67, 0x42,
+                           0x00, 0x00, 0x00, 0x01, 0x68, 0x11,
+                           0x00, 0x00, 0x01, 0x65, 0x88, 0x84};
+    assert(h264_is_key_frame(idr, sizeof(idr)));
+
+    // non-IDR slice
+    const uint8_t slice[] = {0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02};
+    assert(!h264_is_key_frame(slice, sizeof(slice)));
+
+    // SEI followed by a non-IDR slice
+    const uint8_t sei[] = {0x00, 0x00, 0x01, 0x06, 0x05, 0x01,
+                           0x00, 0x00, 0x01, 0x21, 0x9a};
+    assert(!h264_is_key_frame(sei, sizeof(sei)));
+
+    // no NAL unit
+    const uint8_t garbage[] = {0x12, 0x34, 0x56};
+    assert(!h264_is_key_frame(garbage, sizeof(garbage)));
+}
+
+static void test_reference(void) {
+    // nal_ref_idc = 3
+    const uint8_t idr[] = {0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84};
+    assert(h264_is_reference(idr, sizeof(idr)));
+
+    // nal_ref_idc = 2
+    const uint8_t ref[] = {0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02};
+    assert(h264_is_reference(ref, sizeof(ref)));
+
+    // SEI followed by a non-reference slice (nal_ref_idc = 0)
+    const uint8_t non_ref[] = {0x00, 0x00, 0x01, 0x06, 0x05, 0x01,
+                               0x00, 0x00, 0x01, 0x01, 0x9e};
+    assert(!h264_is_reference(non_ref, sizeof(non_ref)));
+
+    // truncated before the first slice
+    const uint8_t sps[] = {0x00, 0x00, 0x00, 0x01, 0x67, 0x42};
+    assert(h264_is_reference(sps, sizeof(sps)));
+}
+
+static void test_parse_sps(void) {
+    unsigned width;
+    unsigned height;
+
+    // baseline, 1920x1088 cropped to 1920x1080
+    const uint8_t sps_1080p[] = {0x67, 0x42, 0x00, 0x28, 0xda, 0x01, 0xe0,
+                                 0x08, 0x9f, 0x95};
+    assert(h264_parse_sps_size(sps_1080p, sizeof(sps_1080p), &width,
+                               &height));
+    assert(width == 1920);
+    assert(height == 1080);
+
+    // high profile, with a scaling matrix
+    const uint8_t sps_high[] = {0x67, 0x64, 0x00, 0x28, 0xad, 0xb4, 0xd3,
+                                0x4d, 0x34, 0xd3, 0x4d, 0x00, 0xda, 0x01,
+                                0x40, 0x16, 0xe4};
+    assert(h264_parse_sps_size(sps_high, sizeof(sps_high), &width, &height));
+    assert(width == 1280);
+    assert(height == 720);
+
+    // main profile, interlaced, 1920x1088 cropped to 1920x1080
+    const uint8_t sps_interlaced[] = {0x67, 0x4d, 0x00, 0x28, 0xda, 0x01,
+                                      0xe0, 0x11, 0x1f, 0x68};
+    assert(h264_parse_sps_size(sps_interlaced, sizeof(sps_interlaced),
+                               &width, &height));
+    assert(width == 1920);
+    assert(height == 1080);
+
+    // pic_order_cnt_type 1 with large offsets, containing an emulation
+    // prevention byte (00 00 03)
+    const uint8_t sps_epb[] = {0x67, 0x4d, 0x00, 0x28, 0xd0, 0x00, 0x00,
+                               0x04, 0x01, 0xbe, 0xf5, 0x00, 0x00, 0x03,
+                               0x00, 0x80, 0x37, 0xde, 0x40, 0x28, 0x02,
+                               0xdc, 0x80};
+    assert(h264_parse_sps_size(sps_epb, sizeof(sps_epb), &width, &height));
+    assert(width == 1280);
+    assert(height == 720);
+
+    // truncated
+    assert(!h264_parse_sps_size(sps_1080p, 6, &width, &height));
+
+    // not an SPS
+    const uint8_t pps[] = {0x68, 0xce, 0x3c, 0x80};
+    assert(!h264_parse_sps_size(pps, sizeof(pps), &width, &height));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_find_nal();
+    test_find_nal_long();
+    test_key_frame();
+    test_reference();
+    test_parse_sps();
+    return 0;
+}
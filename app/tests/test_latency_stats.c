@@ -0,0 +1,72 @@
+#include <assert.h>
+
+#include "latency_stats.h"
+
+static void test_latency_stats_stages(void) {
+    struct latency_stats stats;
+    latency_stats_init(&stats);
+
+    struct sc_frame_times times = {
+        .received = 1000,
+        .decoded = 3000,
+        .offered = 3100,
+    };
+    latency_stats_add_frame(&stats, &times, 10000);
+
+    struct latency_window *w = stats.windows;
+    assert(w[SC_LATENCY_STAGE_DECODE].count == 1);
+    assert(w[SC_LATENCY_STAGE_DECODE].samples[0] == 2000);
+    assert(w[SC_LATENCY_STAGE_OFFER].samples[0] == 100);
+    assert(w[SC_LATENCY_STAGE_RENDER].samples[0] == 6900);
+    assert(w[SC_LATENCY_STAGE_TOTAL].samples[0] == 9000);
+}
+
+static void test_latency_stats_unknown_time(void) {
+    struct latency_stats stats;
+    latency_stats_init(&stats);
+
+    // the receive time is unknown
+    struct sc_frame_times times = {
+        .received = 0,
+        .decoded = 3000,
+        .offered = 3100,
+    };
+    latency_stats_add_frame(&stats, &times, 10000);
+
+    struct latency_window *w = stats.windows;
+    assert(w[SC_LATENCY_STAGE_DECODE].count == 0);
+    assert(w[SC_LATENCY_STAGE_OFFER].count == 1);
+    assert(w[SC_LATENCY_STAGE_RENDER].count == 1);
+    assert(w[SC_LATENCY_STAGE_TOTAL].count == 0);
+}
+
+static void test_latency_stats_rolling(void) {
+    struct latency_stats stats;
+    latency_stats_init(&stats);
+
+    for (unsigned i = 0; i < LATENCY_STATS_WINDOW_SIZE + 10; ++i) {
+        struct sc_frame_times times = {
+            .received = 1,
+            .decoded = 1 + i,
+            .offered = 1 + i,
+        };
+        latency_stats_add_frame(&stats, &times, 1 + i);
+    }
+
+    struct latency_window *w = &stats.windows[SC_LATENCY_STAGE_DECODE];
+    assert(w->count == LATENCY_STATS_WINDOW_SIZE);
+    assert(w->head == 10);
+    // the oldest samples have been overwritten
+    assert(w->samples[0] == LATENCY_STATS_WINDOW_SIZE);
+    assert(w->samples[10] == 10);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_latency_stats_stages();
+    test_latency_stats_unknown_time();
+    test_latency_stats_rolling();
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <string.h>
+
+#include "metrics.h"
+
+static void test_metrics_counters(void) {
+    struct metrics metrics;
+    metrics_init(&metrics);
+
+    metrics_add(&metrics.received_bytes, 1000);
+    metrics_add(&metrics.received_bytes, 234);
+    metrics_add(&metrics.rendered_frames, 1);
+    metrics_set(&metrics.recorder_queue_depth, 7);
+
+    struct metrics_source source = {
+        .serial = "0123456789abcdef",
+        .metrics = &metrics,
+    };
+
+    char buf[16384];
+    size_t len = metrics_format(&source, 1, buf, sizeof(buf));
+    assert(len < sizeof(buf));
+    assert(strlen(buf) == len);
+
+    assert(strstr(buf, "# TYPE scrcpy_received_bytes_total counter\n"));
+    assert(strstr(buf, "scrcpy_received_bytes_total"
+                       "{serial=\"0123456789abcdef\"} 1234\n"));
+    assert(strstr(buf, "scrcpy_rendered_frames_total"
+                       "{serial=\"0123456789abcdef\"} 1\n"));
+    assert(strstr(buf, "scrcpy_recorder_queue_depth"
+                       "{serial=\"0123456789abcdef\"} 7\n"));
+}
+
+static void test_metrics_histogram(void) {
+    struct metrics metrics;
+    metrics_init(&metrics);
+
+    struct sc_frame_times times = {
+        .received = 1000,
+        .decoded = 4000, // decode: 3ms
+        .offered = 4100,
+    };
+    metrics_add_frame(&metrics, &times, 10000);
+    times.decoded = 1000 + 30000; // decode: 30ms
+    times.offered = 1000 + 30100;
+    metrics_add_frame(&metrics, &times, 1000 + 40000);
+
+    struct metrics_source source = {
+        .serial = NULL,
+        .metrics = &metrics,
+    };
+
+    char buf[16384];
+    size_t len = metrics_format(&source, 1, buf, sizeof(buf));
+    assert(len < sizeof(buf));
+
+    // the buckets are cumulative
+    assert(strstr(buf, "scrcpy_latency_seconds_bucket{serial=\"\","
+                       "stage=\"decode\",le=\"0.002000\"} 0\n"));
+    assert(strstr(buf, "scrcpy_latency_seconds_bucket{serial=\"\","
+                       "stage=\"decode\",le=\"0.005000\"} 1\n"));
+    assert(strstr(buf, "scrcpy_latency_seconds_bucket{serial=\"\","
+                       "stage=\"decode\",le=\"0.050000\"} 2\n"));
+    assert(strstr(buf, "scrcpy_latency_seconds_bucket{serial=\"\","
+                       "stage=\"decode\",le=\"+Inf\"} 2\n"));
+    assert(strstr(buf, "scrcpy_latency_seconds_sum{serial=\"\","
+                       "stage=\"decode\"} 0.033000\n"));
+    assert(strstr(buf, "scrcpy_latency_seconds_count{serial=\"\","
+                       "stage=\"decode\"} 2\n"));
+
+    // the capture time is unknown
+    assert(strstr(buf, "scrcpy_latency_seconds_count{serial=\"\","
+                       "stage=\"glass\"} 0\n"));
+}
+
+static void test_metrics_frame_interval(void) {
+    struct metrics metrics;
+    metrics_init(&metrics);
+
+    metrics_histogram_add(&metrics.frame_interval, 16667);
+    metrics_histogram_add(&metrics.frame_interval, 16666);
+    metrics_histogram_add(&metrics.frame_interval, 2000000);
+
+    struct metrics_source source = {
+        .serial = "serial",
+        .metrics = &metrics,
+    };
+
+    char buf[16384];
+    size_t len = metrics_format(&source, 1, buf, sizeof(buf));
+    assert(len < sizeof(buf));
+
+    assert(strstr(buf, "# TYPE scrcpy_frame_interval_seconds histogram\n"));
+    assert(strstr(buf, "scrcpy_frame_interval_seconds_bucket{serial=\"serial\","
+                       "le=\"0.020000\"} 2\n"));
+    assert(strstr(buf, "scrcpy_frame_interval_seconds_bucket{serial=\"serial\","
+                       "le=\"1.000000\"} 2\n"));
+    assert(strstr(buf, "scrcpy_frame_interval_seconds_bucket{serial=\"serial\","
+                       "le=\"+Inf\"} 3\n"));
+    assert(strstr(buf, "scrcpy_frame_interval_seconds_sum{serial=\"serial\"} "
+                       "2.033333\n"));
+}
+
+static void test_metrics_truncated(void) {
+    struct metrics metrics;
+    metrics_init(&metrics);
+
+    struct metrics_source source = {
+        .serial = "serial",
+        .metrics = &metrics,
+    };
+
+    char buf[64];
+    size_t len = metrics_format(&source, 1, buf, sizeof(buf));
+    assert(len == sizeof(buf));
+}
+
+static void test_metrics_escaped_serial(void) {
+    struct metrics metrics;
+    metrics_init(&metrics);
+
+    struct metrics_source source = {
+        .serial = "a\\b\"c\nd",
+        .metrics = &metrics,
+    };
+
+    char buf[16384];
+    size_t len = metrics_format(&source, 1, buf, sizeof(buf));
+    assert(len < sizeof(buf));
+
+    assert(strstr(buf, "scrcpy_received_bytes_total"
+                       "{serial=\"a\\\\b\\\"c\\nd\"} 0\n"));
+    assert(strstr(buf, "scrcpy_frame_interval_seconds_count"
+                       "{serial=\"a\\\\b\\\"c\\nd\"} 0\n"));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_metrics_counters();
+    test_metrics_histogram();
+    test_metrics_frame_interval();
+    test_metrics_truncated();
+    test_metrics_escaped_serial();
+    return 0;
+}
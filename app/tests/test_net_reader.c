@@ -0,0 +1,91 @@
+#include <assert.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "util/net_reader.h"
+
+static void fill(uint8_t *data, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = (uint8_t) (seed + i);
+    }
+}
+
+static void test_read_small_and_large(void) {
+    int sv[2];
+    int r = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    assert(!r);
+
+    struct net_reader reader;
+    bool ok = net_reader_init(&reader, sv[0]);
+    assert(ok);
+
+    // received from the buffer
+    static uint8_t small[100];
+    fill(small, sizeof(small), 1);
+    // received in place, after the buffered bytes
+    static uint8_t large[NET_READER_DIRECT_READ_SIZE + 1000];
+    fill(large, sizeof(large), 2);
+
+    ssize_t w = net_send_all(sv[1], small, sizeof(small));
+    assert(w == sizeof(small));
+    w = net_send_all(sv[1], large, sizeof(large));
+    assert(w == sizeof(large));
+    net_shutdown(sv[1], SHUT_WR);
+
+    uint8_t header[20];
+    ok = net_reader_read_all(&reader, header, sizeof(header));
+    assert(ok);
+    assert(!memcmp(header, small, sizeof(header)));
+
+    uint8_t payload[sizeof(small) - sizeof(header)];
+    ok = net_reader_read_all(&reader, payload, sizeof(payload));
+    assert(ok);
+    assert(!memcmp(payload, &small[sizeof(header)], sizeof(payload)));
+
+    static uint8_t data[sizeof(large)];
+    ok = net_reader_read_all(&reader, data, sizeof(data));
+    assert(ok);
+    assert(!memcmp(data, large, sizeof(data)));
+
+    // end of stream
+    ok = net_reader_read_all(&reader, header, 1);
+    assert(!ok);
+
+    net_reader_destroy(&reader);
+    net_close(sv[0]);
+    net_close(sv[1]);
+}
+
+static void test_read_truncated(void) {
+    int sv[2];
+    int r = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    assert(!r);
+
+    struct net_reader reader;
+    bool ok = net_reader_init(&reader, sv[0]);
+    assert(ok);
+
+    uint8_t data[10];
+    fill(data, sizeof(data), 3);
+    ssize_t w = net_send_all(sv[1], data, sizeof(data));
+    assert(w == sizeof(data));
+    net_shutdown(sv[1], SHUT_WR);
+
+    // the stream ends in the middle of the read
+    uint8_t buf[20];
+    ok = net_reader_read_all(&reader, buf, sizeof(buf));
+    assert(!ok);
+
+    net_reader_destroy(&reader);
+    net_close(sv[0]);
+    net_close(sv[1]);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_read_small_and_large();
+    test_read_truncated();
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <assert.h>
+
+#include "packet_pool.h"
+
+static void test_packet_pool_recycle(void) {
+    struct packet_pool pool;
+    packet_pool_init(&pool);
+
+    AVPacket packet;
+    bool ok = packet_pool_get(&pool, &packet, 1000);
+    assert(ok);
+    assert(packet.size == 1000);
+    assert(pool.hits == 0);
+    assert(pool.misses == 1);
+
+    // the buffer is still referenced, so it cannot be recycled
+    AVPacket packet2;
+    ok = packet_pool_get(&pool, &packet2, 2000);
+    assert(ok);
+    assert(packet2.data != packet.data);
+    assert(pool.hits == 0);
+    assert(pool.misses == 2);
+
+    av_packet_unref(&packet);
+    av_packet_unref(&packet2);
+
+    // same bucket (4 KiB)
+    ok = packet_pool_get(&pool, &packet, 4096);
+    assert(ok);
+    assert(pool.hits == 1);
+    assert(pool.misses == 2);
+
+    // a different bucket
+    ok = packet_pool_get(&pool, &packet2, 4097);
+    assert(ok);
+    assert(pool.hits == 1);
+    assert(pool.misses == 3);
+
+    av_packet_unref(&packet);
+    av_packet_unref(&packet2);
+
+    packet_pool_destroy(&pool);
+}
+
+static void test_packet_pool_padding(void) {
+    struct packet_pool pool;
+    packet_pool_init(&pool);
+
+    AVPacket packet;
+    bool ok = packet_pool_get(&pool, &packet, 100);
+    assert(ok);
+    packet.data[100] = 42;
+    av_packet_unref(&packet);
+
+    // the padding of a recycled buffer must be zeroed again
+    ok = packet_pool_get(&pool, &packet, 100);
+    assert(ok);
+    assert(pool.hits == 1);
+    for (int i = 0; i < AV_INPUT_BUFFER_PADDING_SIZE; ++i) {
+        assert(!packet.data[100 + i]);
+    }
+    av_packet_unref(&packet);
+
+    packet_pool_destroy(&pool);
+}
+
+static void test_packet_pool_too_big(void) {
+    struct packet_pool pool;
+    packet_pool_init(&pool);
+
+    size_t size = ((size_t) 1 << PACKET_POOL_MAX_SIZE_LOG2) + 1;
+    AVPacket packet;
+    bool ok = packet_pool_get(&pool, &packet, size);
+    assert(ok);
+    assert(packet.size == (int) size);
+    assert(pool.misses == 1);
+    av_packet_unref(&packet);
+
+    ok = packet_pool_get(&pool, &packet, size);
+    assert(ok);
+    assert(pool.hits == 0);
+    assert(pool.misses == 2);
+    av_packet_unref(&packet);
+
+    packet_pool_destroy(&pool);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_packet_pool_recycle();
+    test_packet_pool_padding();
+    test_packet_pool_too_big();
+    return 0;
+}
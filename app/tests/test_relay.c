@@ -0,0 +1,261 @@
+#include <assert.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "controller.h"
+#include "relay.h"
+#include "util/buffer_util.h"
+
+#define NO_PTS UINT64_C(-1)
+#define PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+// the relays are created without controller
+bool
+controller_push_msg(struct controller *controller,
+                    const struct control_msg *msg) {
+    (void) controller;
+    (void) msg;
+    assert(!"unexpected control message");
+    return false;
+}
+
+static void init_relay(struct relay *relay) {
+    struct size size = {1920, 1080};
+    // any available port, the viewers are not connected through it
+    bool ok = relay_init(relay, 0, "my device", size, SC_CODEC_H265, NULL);
+    assert(ok);
+    ok = relay_start(relay);
+    assert(ok);
+}
+
+static void destroy_relay(struct relay *relay) {
+    relay_stop(relay);
+    relay_join(relay);
+    relay_destroy(relay);
+}
+
+// connect a viewer, return the socket of its end
+static int add_viewer(struct relay *relay) {
+    int sv[2];
+    int r = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    assert(!r);
+
+    sc_relay_add_viewer(relay, sv[0]);
+    return sv[1];
+}
+
+// the payload of a packet is derived from its PTS
+static void push(struct relay *relay, int64_t pts, bool key_frame,
+                 size_t size) {
+    static uint8_t data[16384];
+    assert(size <= sizeof(data));
+    memset(data, (uint8_t) pts, size);
+
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = data;
+    packet.size = size;
+    packet.pts = pts;
+    packet.dts = pts;
+    packet.flags = key_frame ? AV_PKT_FLAG_KEY : 0;
+
+    bool ok = relay_push(relay, &packet);
+    assert(ok);
+}
+
+static void push_config(struct relay *relay) {
+    static uint8_t config[] = {0, 0, 0, 1, 0x40, 0x01};
+
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = config;
+    packet.size = sizeof(config);
+    packet.pts = AV_NOPTS_VALUE;
+    packet.dts = AV_NOPTS_VALUE;
+
+    bool ok = relay_push(relay, &packet);
+    assert(ok);
+}
+
+// read a packet sent by the relay, return its size
+static size_t read_packet(int socket, uint64_t *pts_flags, uint8_t *data,
+                          size_t size) {
+    uint8_t header[20];
+    ssize_t r = net_recv_all(socket, header, sizeof(header));
+    assert(r == sizeof(header));
+
+    *pts_flags = buffer_read64be(header);
+    // the capture time is unknown to the viewers
+    assert(!buffer_read64be(&header[8]));
+    uint32_t len = buffer_read32be(&header[16]);
+    assert(len <= size);
+
+    r = net_recv_all(socket, data, len);
+    assert(r == (ssize_t) len);
+    return len;
+}
+
+static void assert_config(int socket) {
+    uint64_t pts_flags;
+    uint8_t data[16];
+    size_t len = read_packet(socket, &pts_flags, data, sizeof(data));
+    assert(pts_flags == NO_PTS);
+    assert(len == 6);
+    assert(!memcmp(data, "\x00\x00\x00\x01\x40\x01", 6));
+}
+
+static void assert_packet(int socket, int64_t pts, bool key_frame,
+                          size_t size) {
+    uint64_t pts_flags;
+    static uint8_t data[16384];
+    size_t len = read_packet(socket, &pts_flags, data, sizeof(data));
+    uint64_t expected = (uint64_t) pts
+                      | (key_frame ? PACKET_FLAG_KEY_FRAME : 0);
+    assert(pts_flags == expected);
+    assert(len == size);
+    for (size_t i = 0; i < len; ++i) {
+        assert(data[i] == (uint8_t) pts);
+    }
+}
+
+static void test_relay_round_trip(void) {
+    struct relay relay;
+    init_relay(&relay);
+
+    int socket = add_viewer(&relay);
+
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size size;
+    enum sc_codec codec;
+    bool ok = relay_read_info(socket, device_name, &size, &codec);
+    assert(ok);
+    assert(!strcmp(device_name, "my device"));
+    assert(size.width == 1920);
+    assert(size.height == 1080);
+    assert(codec == SC_CODEC_H265);
+
+    push_config(&relay);
+    push(&relay, 1000, true, 100);
+    push(&relay, 2000, false, 50);
+
+    assert_config(socket);
+    assert_packet(socket, 1000, true, 100);
+    assert_packet(socket, 2000, false, 50);
+
+    destroy_relay(&relay);
+    net_close(socket);
+}
+
+static void test_relay_fan_out(void) {
+    struct relay relay;
+    init_relay(&relay);
+
+    int sockets[3];
+    for (int i = 0; i < 3; ++i) {
+        sockets[i] = add_viewer(&relay);
+
+        char device_name[DEVICE_NAME_FIELD_LENGTH];
+        struct size size;
+        enum sc_codec codec;
+        bool ok = relay_read_info(sockets[i], device_name, &size, &codec);
+        assert(ok);
+    }
+
+    // not forwarded, the viewers start on a key frame
+    push(&relay, 1, false, 10);
+    push_config(&relay);
+    push(&relay, 2, true, 20);
+    push(&relay, 3, false, 30);
+
+    // a late joiner receives the last config packet, then the next key frame
+    int late = add_viewer(&relay);
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size size;
+    enum sc_codec codec;
+    bool ok = relay_read_info(late, device_name, &size, &codec);
+    assert(ok);
+
+    push(&relay, 4, false, 40);
+    push(&relay, 5, true, 50);
+
+    for (int i = 0; i < 3; ++i) {
+        assert_config(sockets[i]);
+        assert_packet(sockets[i], 2, true, 20);
+        assert_packet(sockets[i], 3, false, 30);
+        assert_packet(sockets[i], 4, false, 40);
+        assert_packet(sockets[i], 5, true, 50);
+    }
+    assert_config(late);
+    assert_packet(late, 5, true, 50);
+
+    destroy_relay(&relay);
+    for (int i = 0; i < 3; ++i) {
+        net_close(sockets[i]);
+    }
+    net_close(late);
+}
+
+static void test_relay_slow_viewer(void) {
+    struct relay relay;
+    init_relay(&relay);
+
+    int fast = add_viewer(&relay);
+    int slow = add_viewer(&relay);
+
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size size;
+    enum sc_codec codec;
+    bool ok = relay_read_info(fast, device_name, &size, &codec);
+    assert(ok);
+    ok = relay_read_info(slow, device_name, &size, &codec);
+    assert(ok);
+
+    push_config(&relay);
+    assert_config(fast);
+
+    // the slow viewer is not read: once its socket buffer is full, its queue
+    // overflows (far more data than any socket buffer)
+    const int count = 300;
+    for (int i = 1; i <= count; ++i) {
+        push(&relay, i, i == 1, 16384);
+        assert_packet(fast, i, i == 1, 16384);
+    }
+
+    push(&relay, count + 1, true, 100);
+    assert_packet(fast, count + 1, true, 100);
+
+    // the slow viewer received the first packets, then its queue has been
+    // dropped: it resumes with the config packet and the next key frame
+    assert_config(slow);
+    int64_t next = 1;
+    for (;;) {
+        uint64_t pts_flags;
+        static uint8_t data[16384];
+        size_t len = read_packet(slow, &pts_flags, data, sizeof(data));
+        if (pts_flags == NO_PTS) {
+            // the config packet sent again after the drop
+            assert(len == 6);
+            break;
+        }
+        uint64_t flags = next == 1 ? PACKET_FLAG_KEY_FRAME : 0;
+        assert(pts_flags == ((uint64_t) next | flags));
+        ++next;
+    }
+    // some packets have been dropped
+    assert(next <= count);
+    assert_packet(slow, count + 1, true, 100);
+
+    destroy_relay(&relay);
+    net_close(fast);
+    net_close(slow);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_relay_round_trip();
+    test_relay_fan_out();
+    test_relay_slow_viewer();
+    return 0;
+}
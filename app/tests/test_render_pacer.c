@@ -0,0 +1,107 @@
+#include <assert.h>
+
+#include "render_pacer.h"
+
+static void test_render_pacer_no_frame(void) {
+    struct render_pacer pacer;
+    render_pacer_init(&pacer, true);
+
+    assert(render_pacer_get_delay(&pacer, 1000) == -1);
+}
+
+static void test_render_pacer_immediate(void) {
+    struct render_pacer pacer;
+    render_pacer_init(&pacer, false);
+    render_pacer_set_refresh_rate(&pacer, 144);
+
+    int64_t t = 1000000;
+    for (int i = 0; i < 10; ++i) {
+        render_pacer_frame_available(&pacer, t);
+        assert(render_pacer_get_delay(&pacer, t) == 0);
+        render_pacer_frame_presented(&pacer, t + 1000);
+        // irregular arrivals
+        t += i % 2 ? 10000 : 23000;
+    }
+}
+
+static void test_render_pacer_smooth(void) {
+    struct render_pacer pacer;
+    render_pacer_init(&pacer, true);
+    render_pacer_set_refresh_rate(&pacer, 144); // period 6944us
+
+    // 60 fps (16666us), presented on arrival
+    int64_t t = 1000000;
+    for (int i = 0; i < 20; ++i) {
+        render_pacer_frame_available(&pacer, t);
+        int64_t delay = render_pacer_get_delay(&pacer, t);
+        assert(delay == 0);
+        render_pacer_frame_presented(&pacer, t);
+        t += 16666;
+    }
+
+    // a frame arriving early is delayed until 1 frame period (minus half a
+    // refresh period) after the last presentation
+    int64_t last_present = t - 16666;
+    int64_t early = last_present + 6000;
+    render_pacer_frame_available(&pacer, early);
+    int64_t delay = render_pacer_get_delay(&pacer, early);
+    int64_t expected = last_present + pacer.frame_period - 6944 / 2 - early;
+    assert(delay == expected);
+    assert(delay > 0 && delay <= 6944);
+
+    // a newer frame arriving meanwhile keeps the deadline
+    render_pacer_frame_available(&pacer, early + 1000);
+    assert(render_pacer_get_delay(&pacer, early + 1000) == delay - 1000);
+
+    // due
+    assert(render_pacer_get_delay(&pacer, early + delay) == 0);
+    assert(render_pacer_get_delay(&pacer, early + delay + 500) == 0);
+    render_pacer_frame_presented(&pacer, early + delay);
+    assert(render_pacer_get_delay(&pacer, early + delay) == -1);
+}
+
+static void test_render_pacer_smooth_bounded(void) {
+    struct render_pacer pacer;
+    render_pacer_init(&pacer, true);
+    render_pacer_set_refresh_rate(&pacer, 144);
+
+    // 10 fps
+    int64_t t = 1000000;
+    for (int i = 0; i < 10; ++i) {
+        render_pacer_frame_available(&pacer, t);
+        render_pacer_frame_presented(&pacer, t);
+        t += 100000;
+    }
+
+    // the delay never exceeds one refresh period
+    int64_t early = t - 100000 + 1000;
+    render_pacer_frame_available(&pacer, early);
+    assert(render_pacer_get_delay(&pacer, early) == 6944);
+}
+
+static void test_render_pacer_faster_than_display(void) {
+    struct render_pacer pacer;
+    render_pacer_init(&pacer, true);
+    render_pacer_set_refresh_rate(&pacer, 30);
+
+    // 60 fps on a 30Hz display: no smoothing
+    int64_t t = 1000000;
+    for (int i = 0; i < 10; ++i) {
+        render_pacer_frame_available(&pacer, t);
+        assert(render_pacer_get_delay(&pacer, t) == 0);
+        render_pacer_frame_presented(&pacer, t);
+        t += 16666;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_render_pacer_no_frame();
+    test_render_pacer_immediate();
+    test_render_pacer_smooth();
+    test_render_pacer_smooth_bounded();
+    test_render_pacer_faster_than_display();
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL_thread.h>
+
+#include "trace.h"
+
+#define TRACE_FILENAME "test_trace.json"
+
+static int
+run_traced(void *data) {
+    (void) data;
+    trace_set_thread_name("worker");
+    trace_begin("decode");
+    trace_end();
+    return 0;
+}
+
+// return the number of occurrences of needle in the file content
+static unsigned
+count(const char *content, const char *needle) {
+    unsigned n = 0;
+    for (const char *p = content; (p = strstr(p, needle)); ++p) {
+        ++n;
+    }
+    return n;
+}
+
+static void
+test_trace(void) {
+    // disabled, nothing is recorded
+    trace_begin("recv");
+    trace_end();
+
+    bool ok = trace_init(TRACE_FILENAME);
+    assert(ok);
+
+    trace_begin("recv");
+    trace_begin("parse");
+    trace_end();
+    trace_end();
+
+    SDL_Thread *thread = SDL_CreateThread(run_traced, "traced", NULL);
+    assert(thread);
+    SDL_WaitThread(thread, NULL);
+
+    trace_destroy();
+
+    FILE *file = fopen(TRACE_FILENAME, "rb");
+    assert(file);
+    static char content[4096];
+    size_t len = fread(content, 1, sizeof(content) - 1, file);
+    fclose(file);
+    content[len] = '\0';
+    remove(TRACE_FILENAME);
+
+    assert(!strncmp(content, "{\"traceEvents\":[", 16));
+    assert(count(content, "\"ph\":\"M\"") == 2);
+    assert(count(content, "\"args\":{\"name\":\"main\"}") == 1);
+    assert(count(content, "\"args\":{\"name\":\"worker\"}") == 1);
+    assert(count(content, "\"ph\":\"B\"") == 3);
+    assert(count(content, "\"ph\":\"E\"") == 3);
+    assert(count(content, "\"name\":\"recv\"") == 1);
+    assert(count(content, "\"name\":\"parse\"") == 1);
+    assert(count(content, "\"name\":\"decode\"") == 1);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_trace();
+    return 0;
+}
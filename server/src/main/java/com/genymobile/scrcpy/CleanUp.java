@@ -61,7 +61,15 @@ public final class CleanUp {
         boolean disableShowTouches = Boolean.parseBoolean(args[0]);
         int restoreStayOn = Integer.parseInt(args[1]);
         boolean restoreNormalPowerMode = Boolean.parseBoolean(args[2]);
+        restore(disableShowTouches, restoreStayOn, restoreNormalPowerMode);
+    }
 
+    /**
+     * Restore the state immediately.
+     * <p>
+     * This is used at the end of a session of the daemon, which does not die (so the clean up process would never run).
+     */
+    public static void restore(boolean disableShowTouches, int restoreStayOn, boolean restoreNormalPowerMode) {
         if (disableShowTouches || restoreStayOn != -1) {
             ServiceManager serviceManager = new ServiceManager();
             try (ContentProvider settings = serviceManager.getActivityManager().createSettingsProvider()) {
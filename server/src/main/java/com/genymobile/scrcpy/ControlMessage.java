@@ -16,6 +16,18 @@ public final class ControlMessage {
     public static final int TYPE_SET_CLIPBOARD = 8;
     public static final int TYPE_SET_SCREEN_POWER_MODE = 9;
     public static final int TYPE_ROTATE_DEVICE = 10;
+    public static final int TYPE_PING = 11;
+    public static final int TYPE_SET_BIT_RATE = 12;
+    public static final int TYPE_REQUEST_KEY_FRAME = 13;
+    // compact variants, parsed into TYPE_INJECT_TOUCH_EVENT and TYPE_INJECT_SCROLL_EVENT messages
+    public static final int TYPE_SET_SCREEN_SIZE = 14;
+    public static final int TYPE_INJECT_TOUCH_EVENT_COMPACT = 15;
+    public static final int TYPE_INJECT_SCROLL_EVENT_COMPACT = 16;
+    // a non-final chunk of a TYPE_SET_CLIPBOARD text
+    public static final int TYPE_SET_CLIPBOARD_PART = 17;
+    public static final int TYPE_SET_CROP = 18;
+    public static final int TYPE_SET_MAX_SIZE = 19;
+    public static final int TYPE_SET_VIDEO_PAUSED = 20;
 
     private int type;
     private String text;
@@ -30,6 +42,12 @@ public final class ControlMessage {
     private int vScroll;
     private boolean paste;
     private int repeat;
+    private long timestamp;
+    private int bitRate;
+    private int cropWidth;
+    private int cropHeight;
+    private int maxSize;
+    private boolean videoPaused;
 
     private ControlMessage() {
     }
@@ -79,6 +97,44 @@ public final class ControlMessage {
         return msg;
     }
 
+    public static ControlMessage createSetClipboardPart(String text) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_CLIPBOARD_PART;
+        msg.text = text;
+        return msg;
+    }
+
+    /**
+     * @param position the top-left corner of the crop, in video coordinates
+     * @param width the width of the crop, in video coordinates (0 to reset the crop)
+     * @param height the height of the crop, in video coordinates (0 to reset the crop)
+     */
+    public static ControlMessage createSetCrop(Position position, int width, int height) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_CROP;
+        msg.position = position;
+        msg.cropWidth = width;
+        msg.cropHeight = height;
+        return msg;
+    }
+
+    /**
+     * @param maxSize the max size of the main stream (0 to restore the initial max size)
+     */
+    public static ControlMessage createSetMaxSize(int maxSize) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_MAX_SIZE;
+        msg.maxSize = maxSize;
+        return msg;
+    }
+
+    public static ControlMessage createSetVideoPaused(boolean paused) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_VIDEO_PAUSED;
+        msg.videoPaused = paused;
+        return msg;
+    }
+
     /**
      * @param mode one of the {@code Device.SCREEN_POWER_MODE_*} constants
      */
@@ -89,6 +145,23 @@ public final class ControlMessage {
         return msg;
     }
 
+    /**
+     * @param timestamp the client time of the ping, to be echoed in the pong
+     */
+    public static ControlMessage createPing(long timestamp) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_PING;
+        msg.timestamp = timestamp;
+        return msg;
+    }
+
+    public static ControlMessage createSetBitRate(int bitRate) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_BIT_RATE;
+        msg.bitRate = bitRate;
+        return msg;
+    }
+
     public static ControlMessage createEmpty(int type) {
         ControlMessage msg = new ControlMessage();
         msg.type = type;
@@ -146,4 +219,28 @@ public final class ControlMessage {
     public int getRepeat() {
         return repeat;
     }
+
+    public long getTimestamp() {
+        return timestamp;
+    }
+
+    public int getBitRate() {
+        return bitRate;
+    }
+
+    public int getCropWidth() {
+        return cropWidth;
+    }
+
+    public int getCropHeight() {
+        return cropHeight;
+    }
+
+    public int getMaxSize() {
+        return maxSize;
+    }
+
+    public boolean getVideoPaused() {
+        return videoPaused;
+    }
 }
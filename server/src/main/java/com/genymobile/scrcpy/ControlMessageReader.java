@@ -3,6 +3,7 @@ package com.genymobile.scrcpy;
 import java.io.EOFException;
 import java.io.IOException;
 import java.io.InputStream;
+import java.nio.BufferUnderflowException;
 import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
 
@@ -13,15 +14,28 @@ public class ControlMessageReader {
     static final int INJECT_SCROLL_EVENT_PAYLOAD_LENGTH = 20;
     static final int SET_SCREEN_POWER_MODE_PAYLOAD_LENGTH = 1;
     static final int SET_CLIPBOARD_FIXED_PAYLOAD_LENGTH = 1;
+    static final int PING_PAYLOAD_LENGTH = 8;
+    static final int SET_BIT_RATE_PAYLOAD_LENGTH = 4;
+    static final int SET_SCREEN_SIZE_PAYLOAD_LENGTH = 4;
+    static final int SET_CROP_PAYLOAD_LENGTH = 20;
+    static final int SET_MAX_SIZE_PAYLOAD_LENGTH = 2;
+    static final int SET_VIDEO_PAUSED_PAYLOAD_LENGTH = 1;
 
-    private static final int MESSAGE_MAX_SIZE = 1 << 18; // 256k
+    private static final int MESSAGE_MAX_SIZE = 1 << 14; // 16k
 
+    // a larger clipboard text is split into TYPE_SET_CLIPBOARD_PART messages by the client
     public static final int CLIPBOARD_TEXT_MAX_LENGTH = MESSAGE_MAX_SIZE - 6; // type: 1 byte; paste flag: 1 byte; length: 4 bytes
     public static final int INJECT_TEXT_MAX_LENGTH = 300;
 
     private final byte[] rawBuffer = new byte[MESSAGE_MAX_SIZE];
     private final ByteBuffer buffer = ByteBuffer.wrap(rawBuffer);
 
+    // state of the compact messages, updated only once a message is fully parsed
+    private int screenWidth;
+    private int screenHeight;
+    private int lastX;
+    private int lastY;
+
     public ControlMessageReader() {
         // invariant: the buffer is always in "get" mode
         buffer.limit(0);
@@ -69,14 +83,47 @@ public class ControlMessageReader {
             case ControlMessage.TYPE_SET_CLIPBOARD:
                 msg = parseSetClipboard();
                 break;
+            case ControlMessage.TYPE_SET_CLIPBOARD_PART:
+                msg = parseSetClipboardPart();
+                break;
             case ControlMessage.TYPE_SET_SCREEN_POWER_MODE:
                 msg = parseSetScreenPowerMode();
                 break;
+            case ControlMessage.TYPE_PING:
+                msg = parsePing();
+                break;
+            case ControlMessage.TYPE_SET_BIT_RATE:
+                msg = parseSetBitRate();
+                break;
+            case ControlMessage.TYPE_SET_CROP:
+                msg = parseSetCrop();
+                break;
+            case ControlMessage.TYPE_SET_MAX_SIZE:
+                msg = parseSetMaxSize();
+                break;
+            case ControlMessage.TYPE_SET_VIDEO_PAUSED:
+                msg = parseSetVideoPaused();
+                break;
+            case ControlMessage.TYPE_SET_SCREEN_SIZE:
+                if (parseSetScreenSize()) {
+                    // the screen size is a state, not a message on its own: return the following message
+                    msg = next();
+                } else {
+                    msg = null;
+                }
+                break;
+            case ControlMessage.TYPE_INJECT_TOUCH_EVENT_COMPACT:
+                msg = parseInjectTouchEventCompact();
+                break;
+            case ControlMessage.TYPE_INJECT_SCROLL_EVENT_COMPACT:
+                msg = parseInjectScrollEventCompact();
+                break;
             case ControlMessage.TYPE_BACK_OR_SCREEN_ON:
             case ControlMessage.TYPE_EXPAND_NOTIFICATION_PANEL:
             case ControlMessage.TYPE_COLLAPSE_NOTIFICATION_PANEL:
             case ControlMessage.TYPE_GET_CLIPBOARD:
             case ControlMessage.TYPE_ROTATE_DEVICE:
+            case ControlMessage.TYPE_REQUEST_KEY_FRAME:
                 msg = ControlMessage.createEmpty(type);
                 break;
             default:
@@ -162,6 +209,14 @@ public class ControlMessageReader {
         return ControlMessage.createSetClipboard(text, paste);
     }
 
+    private ControlMessage parseSetClipboardPart() {
+        String text = parseString();
+        if (text == null) {
+            return null;
+        }
+        return ControlMessage.createSetClipboardPart(text);
+    }
+
     private ControlMessage parseSetScreenPowerMode() {
         if (buffer.remaining() < SET_SCREEN_POWER_MODE_PAYLOAD_LENGTH) {
             return null;
@@ -170,6 +225,113 @@ public class ControlMessageReader {
         return ControlMessage.createSetScreenPowerMode(mode);
     }
 
+    private ControlMessage parsePing() {
+        if (buffer.remaining() < PING_PAYLOAD_LENGTH) {
+            return null;
+        }
+        long timestamp = buffer.getLong();
+        return ControlMessage.createPing(timestamp);
+    }
+
+    private ControlMessage parseSetBitRate() {
+        if (buffer.remaining() < SET_BIT_RATE_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int bitRate = buffer.getInt();
+        return ControlMessage.createSetBitRate(bitRate);
+    }
+
+    private boolean parseSetScreenSize() {
+        if (buffer.remaining() < SET_SCREEN_SIZE_PAYLOAD_LENGTH) {
+            return false;
+        }
+        // parsing the same screen size again (if the following message is incomplete) is harmless
+        screenWidth = toUnsigned(buffer.getShort());
+        screenHeight = toUnsigned(buffer.getShort());
+        return true;
+    }
+
+    private ControlMessage parseInjectTouchEventCompact() {
+        // the payload length is variable, a BufferUnderflowException means that the message is incomplete
+        try {
+            int action = toUnsigned(buffer.get());
+            // mouse (-1) and virtual finger (-2) ids are encoded as 1 and 0
+            long pointerId = readVarint() - 2;
+            int x = lastX + (int) unzigzag(readVarint());
+            int y = lastY + (int) unzigzag(readVarint());
+            // 8 bits fixed-point
+            int pressureInt = toUnsigned(buffer.get());
+            float pressure = pressureInt == 0xff ? 1f : (pressureInt / 0x1p8f);
+            int buttons = (int) readVarint();
+
+            lastX = x;
+            lastY = y;
+            Position position = new Position(x, y, screenWidth, screenHeight);
+            return ControlMessage.createInjectTouchEvent(action, pointerId, position, pressure, buttons);
+        } catch (BufferUnderflowException e) {
+            return null;
+        }
+    }
+
+    private ControlMessage parseInjectScrollEventCompact() {
+        try {
+            int x = lastX + (int) unzigzag(readVarint());
+            int y = lastY + (int) unzigzag(readVarint());
+            int hScroll = (int) unzigzag(readVarint());
+            int vScroll = (int) unzigzag(readVarint());
+
+            lastX = x;
+            lastY = y;
+            Position position = new Position(x, y, screenWidth, screenHeight);
+            return ControlMessage.createInjectScrollEvent(position, hScroll, vScroll);
+        } catch (BufferUnderflowException e) {
+            return null;
+        }
+    }
+
+    // LEB128, throws BufferUnderflowException if incomplete
+    private long readVarint() {
+        long value = 0;
+        int shift = 0;
+        byte b;
+        do {
+            b = buffer.get();
+            value |= (long) (b & 0x7f) << shift;
+            shift += 7;
+        } while ((b & 0x80) != 0 && shift < 64);
+        return value;
+    }
+
+    private static long unzigzag(long value) {
+        return (value >>> 1) ^ -(value & 1);
+    }
+
+    private ControlMessage parseSetCrop() {
+        if (buffer.remaining() < SET_CROP_PAYLOAD_LENGTH) {
+            return null;
+        }
+        Position position = readPosition(buffer);
+        int width = buffer.getInt();
+        int height = buffer.getInt();
+        return ControlMessage.createSetCrop(position, width, height);
+    }
+
+    private ControlMessage parseSetMaxSize() {
+        if (buffer.remaining() < SET_MAX_SIZE_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int maxSize = toUnsigned(buffer.getShort());
+        return ControlMessage.createSetMaxSize(maxSize);
+    }
+
+    private ControlMessage parseSetVideoPaused() {
+        if (buffer.remaining() < SET_VIDEO_PAUSED_PAYLOAD_LENGTH) {
+            return null;
+        }
+        boolean paused = buffer.get() != 0;
+        return ControlMessage.createSetVideoPaused(paused);
+    }
+
     private static Position readPosition(ByteBuffer buffer) {
         int x = buffer.getInt();
         int y = buffer.getInt();
@@ -21,6 +21,9 @@ public class Controller {
     private final Device device;
     private final DesktopConnection connection;
     private final DeviceMessageSender sender;
+    private final ScreenEncoder screenEncoder;
+    private final ScreenEncoder secondaryScreenEncoder; // may be null
+    private final PerfCounters perfCounters;
 
     private final KeyCharacterMap charMap = KeyCharacterMap.load(KeyCharacterMap.VIRTUAL_KEYBOARD);
 
@@ -31,11 +34,19 @@ public class Controller {
 
     private boolean keepPowerModeOff;
 
-    public Controller(Device device, DesktopConnection connection) {
+    // the first chunks of a large clipboard text, received as TYPE_SET_CLIPBOARD_PART (the last one is a TYPE_SET_CLIPBOARD)
+    private final StringBuilder pendingClipboard = new StringBuilder();
+    private boolean pendingClipboardTruncated;
+
+    public Controller(Device device, DesktopConnection connection, ScreenEncoder screenEncoder, ScreenEncoder secondaryScreenEncoder,
+            PerfCounters perfCounters) {
         this.device = device;
         this.connection = connection;
+        this.screenEncoder = screenEncoder;
+        this.secondaryScreenEncoder = secondaryScreenEncoder;
+        this.perfCounters = perfCounters;
         initPointers();
-        sender = new DeviceMessageSender(connection);
+        sender = new DeviceMessageSender(connection, perfCounters);
     }
 
     private void initPointers() {
@@ -67,8 +78,13 @@ public class Controller {
             SystemClock.sleep(500);
         }
 
+        float refreshRate = device.getRefreshRate();
+        if (refreshRate > 0) {
+            sender.pushRefreshRate(Math.round(refreshRate * 1000));
+        }
+
         while (true) {
-            handleEvent();
+            handleEvents();
         }
     }
 
@@ -76,8 +92,47 @@ public class Controller {
         return sender;
     }
 
-    private void handleEvent() throws IOException {
+    private static boolean isInjection(ControlMessage msg) {
+        switch (msg.getType()) {
+            case ControlMessage.TYPE_INJECT_KEYCODE:
+            case ControlMessage.TYPE_INJECT_TEXT:
+            case ControlMessage.TYPE_INJECT_TOUCH_EVENT:
+            case ControlMessage.TYPE_INJECT_SCROLL_EVENT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    private static boolean isTouchMove(ControlMessage msg) {
+        return msg.getType() == ControlMessage.TYPE_INJECT_TOUCH_EVENT && msg.getAction() == MotionEvent.ACTION_MOVE;
+    }
+
+    /**
+     * Indicate whether {@code next} makes {@code msg} useless: only the last position of consecutive moves of a pointer matters.
+     */
+    private static boolean canReplace(ControlMessage msg, ControlMessage next) {
+        return isTouchMove(msg) && isTouchMove(next) && msg.getPointerId() == next.getPointerId() && msg.getButtons() == next.getButtons();
+    }
+
+    private void handleEvents() throws IOException {
+        // block until a message is available, then handle all the messages already received
         ControlMessage msg = connection.receiveControlMessage();
+        long receivedTime = Device.getMonotonicTimeUs();
+        while (msg != null) {
+            ControlMessage next = connection.pollControlMessage();
+            if (next == null || !canReplace(msg, next)) {
+                handleEvent(msg, receivedTime);
+                if (isInjection(msg)) {
+                    // including the time spent waiting for the previous messages of the batch
+                    perfCounters.addInjection(Device.getMonotonicTimeUs() - receivedTime);
+                }
+            }
+            msg = next;
+        }
+    }
+
+    private void handleEvent(ControlMessage msg, long receivedTime) {
         switch (msg.getType()) {
             case ControlMessage.TYPE_INJECT_KEYCODE:
                 if (device.supportsInputEvents()) {
@@ -116,8 +171,11 @@ public class Controller {
                     sender.pushClipboardText(clipboardText);
                 }
                 break;
+            case ControlMessage.TYPE_SET_CLIPBOARD_PART:
+                appendPendingClipboard(msg.getText());
+                break;
             case ControlMessage.TYPE_SET_CLIPBOARD:
-                setClipboard(msg.getText(), msg.getPaste());
+                setClipboard(takePendingClipboard(msg.getText()), msg.getPaste());
                 break;
             case ControlMessage.TYPE_SET_SCREEN_POWER_MODE:
                 if (device.supportsInputEvents()) {
@@ -132,6 +190,31 @@ public class Controller {
             case ControlMessage.TYPE_ROTATE_DEVICE:
                 Device.rotateDevice();
                 break;
+            case ControlMessage.TYPE_PING:
+                sender.pushPong(msg.getTimestamp(), receivedTime);
+                break;
+            case ControlMessage.TYPE_SET_BIT_RATE:
+                screenEncoder.setBitRate(msg.getBitRate());
+                break;
+            case ControlMessage.TYPE_SET_CROP:
+                device.setCrop(msg.getPosition(), msg.getCropWidth(), msg.getCropHeight());
+                break;
+            case ControlMessage.TYPE_SET_MAX_SIZE:
+                device.setMaxSize(msg.getMaxSize());
+                break;
+            case ControlMessage.TYPE_SET_VIDEO_PAUSED:
+                screenEncoder.setSuspended(msg.getVideoPaused());
+                if (secondaryScreenEncoder != null) {
+                    secondaryScreenEncoder.setSuspended(msg.getVideoPaused());
+                }
+                break;
+            case ControlMessage.TYPE_REQUEST_KEY_FRAME:
+                // the client does not tell which stream could not be decoded
+                screenEncoder.requestKeyFrame();
+                if (secondaryScreenEncoder != null) {
+                    secondaryScreenEncoder.requestKeyFrame();
+                }
+                break;
             default:
                 // do nothing
         }
@@ -144,6 +227,22 @@ public class Controller {
         return device.injectKeyEvent(action, keycode, repeat, metaState);
     }
 
+    private KeyEvent[] getTextEvents(String text) {
+        StringBuilder builder = new StringBuilder(text.length());
+        for (int i = 0; i < text.length(); ++i) {
+            char c = text.charAt(i);
+            String decomposed = KeyComposition.decompose(c);
+            if (decomposed != null) {
+                builder.append(decomposed);
+            } else {
+                builder.append(c);
+            }
+        }
+        char[] chars = new char[builder.length()];
+        builder.getChars(0, chars.length, chars, 0);
+        return charMap.getEvents(chars);
+    }
+
     private boolean injectChar(char c) {
         String decomposed = KeyComposition.decompose(c);
         char[] chars = decomposed != null ? decomposed.toCharArray() : new char[]{c};
@@ -160,6 +259,19 @@ public class Controller {
     }
 
     private int injectText(String text) {
+        // fast path: generate the events of the whole text at once
+        KeyEvent[] events = getTextEvents(text);
+        if (events != null) {
+            for (KeyEvent event : events) {
+                if (!device.injectEvent(event)) {
+                    // the events are injected asynchronously, this only fails if the input manager is not available
+                    return 0;
+                }
+            }
+            return text.length();
+        }
+
+        // some chars cannot be generated, inject them one by one to skip only those
         int successCount = 0;
         for (char c : text.toCharArray()) {
             if (!injectChar(c)) {
@@ -212,7 +324,7 @@ public class Controller {
         MotionEvent event = MotionEvent
                 .obtain(lastTouchDown, now, action, pointerCount, pointerProperties, pointerCoords, 0, buttons, 1f, 1f, DEVICE_ID_VIRTUAL, 0, source,
                         0);
-        return device.injectEvent(event);
+        return injectAndRecycle(event);
     }
 
     private boolean injectScroll(Position position, int hScroll, int vScroll) {
@@ -235,7 +347,15 @@ public class Controller {
         MotionEvent event = MotionEvent
                 .obtain(lastTouchDown, now, MotionEvent.ACTION_SCROLL, 1, pointerProperties, pointerCoords, 0, 0, 1f, 1f, DEVICE_ID_VIRTUAL, 0,
                         InputDevice.SOURCE_TOUCHSCREEN, 0);
-        return device.injectEvent(event);
+        return injectAndRecycle(event);
+    }
+
+    private boolean injectAndRecycle(MotionEvent event) {
+        // The event is injected asynchronously, but it is copied (parceled) on injection, so it can be recycled immediately: the next
+        // MotionEvent.obtain() will reuse it instead of allocating a new one
+        boolean ok = device.injectEvent(event);
+        event.recycle();
+        return ok;
     }
 
     /**
@@ -259,6 +379,30 @@ public class Controller {
         return device.injectKeycode(keycode);
     }
 
+    private void appendPendingClipboard(String text) {
+        if (pendingClipboard.length() + text.length() > DeviceMessageWriter.CLIPBOARD_TOTAL_MAX_LENGTH) {
+            // drop the remaining chunks rather than growing without limit
+            pendingClipboardTruncated = true;
+            return;
+        }
+        pendingClipboard.append(text);
+    }
+
+    private String takePendingClipboard(String lastChunk) {
+        if (pendingClipboard.length() == 0) {
+            // the text was not split
+            return lastChunk;
+        }
+        appendPendingClipboard(lastChunk);
+        if (pendingClipboardTruncated) {
+            Ln.w("Clipboard text truncated to " + pendingClipboard.length() + " chars");
+            pendingClipboardTruncated = false;
+        }
+        String text = pendingClipboard.toString();
+        pendingClipboard.setLength(0);
+        return text;
+    }
+
     private boolean setClipboard(String text, boolean paste) {
         boolean ok = device.setClipboardText(text);
         if (ok) {
@@ -0,0 +1,241 @@
+package com.genymobile.scrcpy;
+
+import android.net.LocalServerSocket;
+import android.net.LocalSocket;
+import android.os.SystemClock;
+
+import java.io.DataInputStream;
+import java.io.IOException;
+import java.nio.charset.StandardCharsets;
+import java.util.HashMap;
+import java.util.Map;
+
+/**
+ * A resident server, accepting any number of (possibly concurrent) client sessions, so that a session does not pay the start of a new
+ * process (the JVM, the class loading and the system service wrappers are kept warm).
+ * <p>
+ * Each socket of a session starts with a hello from the client:
+ *
+ * <pre>
+ * [role (1)][session token (4)]
+ * </pre>
+ * <p>
+ * The token is chosen by the client, to associate its sockets. The hello of the video socket, which is connected first, is followed by the
+ * session arguments (the same as on the command line, separated by '\0'):
+ *
+ * <pre>
+ * [length (2)][arguments]
+ * </pre>
+ * <p>
+ * Once the session is registered, the daemon replies {@link #REPLY_OK} on the video socket, then the client connects its other sockets.
+ * <p>
+ * A client of another version is rejected (its connection only): the daemon exits if it has no other session, so that the client may
+ * start a daemon of its own version.
+ * <p>
+ * The log level is the one of the client which has started the daemon (it is global to the process, not per session).
+ */
+public final class Daemon {
+
+    // the command line argument to start the daemon
+    public static final String ARG = "daemon";
+
+    private static final String SOCKET_NAME = "scrcpy-daemon";
+
+    private static final int ROLE_VIDEO = 0;
+    private static final int ROLE_CONTROL = 1;
+    private static final int ROLE_SECONDARY_VIDEO = 2;
+
+    // the replies to the hello of the video socket
+    private static final int REPLY_OK = 0;
+    // the client version does not match, the daemon exits (there was no other session)
+    private static final int REPLY_VERSION_EXITING = 1;
+    // the client version does not match, the daemon keeps running for its other sessions
+    private static final int REPLY_VERSION_BUSY = 2;
+
+    // the other sockets are connected by the client as soon as it receives the reply
+    private static final long SESSION_SOCKETS_TIMEOUT_MS = 10000;
+
+    private static final class PendingSession {
+        private LocalSocket controlSocket;
+        private LocalSocket secondaryVideoSocket;
+    }
+
+    // the sessions waiting for their other sockets, by token (the map is also the lock of the PendingSession fields and of sessionCount)
+    private final Map<Integer, PendingSession> pendingSessions = new HashMap<>();
+    // the sessions registered and not ended yet (pending or running)
+    private int sessionCount;
+
+    private Daemon() {
+        // only created by run()
+    }
+
+    /**
+     * Accept the client sessions forever.
+     * <p>
+     * Return immediately if another daemon is already running.
+     */
+    public static void run() throws IOException {
+        LocalServerSocket serverSocket;
+        try {
+            serverSocket = new LocalServerSocket(SOCKET_NAME);
+        } catch (IOException e) {
+            // the client connects to the running one
+            Ln.i("Daemon already running");
+            return;
+        }
+
+        Ln.i("Daemon started");
+        new Daemon().acceptSessions(serverSocket);
+    }
+
+    private void acceptSessions(LocalServerSocket serverSocket) throws IOException {
+        for (;;) {
+            final LocalSocket socket = serverSocket.accept();
+            // a slow client must not delay the others
+            Thread thread = new Thread(new Runnable() {
+                @Override
+                public void run() {
+                    handle(socket);
+                }
+            });
+            thread.start();
+        }
+    }
+
+    private void handle(LocalSocket socket) {
+        try {
+            DataInputStream input = new DataInputStream(socket.getInputStream());
+            int role = input.readUnsignedByte();
+            int token = input.readInt();
+            if (role == ROLE_VIDEO) {
+                byte[] args = new byte[input.readUnsignedShort()];
+                input.readFully(args);
+                runSession(socket, token, new String(args, StandardCharsets.UTF_8).split("\0", -1));
+            } else {
+                attach(socket, role, token);
+            }
+        } catch (IOException e) {
+            Ln.w("Daemon session failed: " + e.getMessage());
+            close(socket);
+        }
+    }
+
+    private void attach(LocalSocket socket, int role, int token) throws IOException {
+        synchronized (pendingSessions) {
+            PendingSession pending = pendingSessions.get(token);
+            if (pending != null) {
+                if (role == ROLE_CONTROL && pending.controlSocket == null) {
+                    pending.controlSocket = socket;
+                    pendingSessions.notifyAll();
+                    return;
+                }
+                if (role == ROLE_SECONDARY_VIDEO && pending.secondaryVideoSocket == null) {
+                    pending.secondaryVideoSocket = socket;
+                    pendingSessions.notifyAll();
+                    return;
+                }
+            }
+        }
+        throw new IOException("Unexpected socket (role " + role + ")");
+    }
+
+    private void runSession(LocalSocket videoSocket, int token, String[] args) throws IOException {
+        if (!BuildConfig.VERSION_NAME.equals(args[0])) {
+            rejectVersion(videoSocket, args[0]);
+            return;
+        }
+
+        Options options;
+        try {
+            options = Server.createOptions(args);
+        } catch (IllegalArgumentException e) {
+            throw new IOException("Invalid session arguments: " + e.getMessage());
+        }
+
+        PendingSession pending = new PendingSession();
+        synchronized (pendingSessions) {
+            if (pendingSessions.containsKey(token)) {
+                throw new IOException("Duplicate session token");
+            }
+            pendingSessions.put(token, pending);
+            ++sessionCount;
+        }
+
+        try {
+            try {
+                // send one byte so the client may read() to detect a connection error
+                videoSocket.getOutputStream().write(REPLY_OK);
+                waitForSockets(pending, options.hasSecondaryStream());
+            } catch (IOException e) {
+                close(pending.controlSocket);
+                close(pending.secondaryVideoSocket);
+                throw e;
+            } finally {
+                synchronized (pendingSessions) {
+                    pendingSessions.remove(token);
+                }
+            }
+
+            try {
+                Server.scrcpy(options, videoSocket, pending.controlSocket, pending.secondaryVideoSocket);
+            } finally {
+                // if the connection has not been created
+                close(videoSocket);
+                close(pending.controlSocket);
+                close(pending.secondaryVideoSocket);
+            }
+        } finally {
+            synchronized (pendingSessions) {
+                --sessionCount;
+            }
+        }
+    }
+
+    /**
+     * Reject a client of another version, without affecting the running sessions.
+     * <p>
+     * If there are none, the daemon exits, so that the client starts a daemon of its own version once the socket name is released.
+     */
+    private void rejectVersion(LocalSocket videoSocket, String clientVersion) throws IOException {
+        // under the lock, so that no session is registered meanwhile
+        synchronized (pendingSessions) {
+            boolean exit = sessionCount == 0;
+            Ln.w("Client version " + clientVersion + " does not match the daemon (" + BuildConfig.VERSION_NAME + ")" + (exit ? ", exiting" : ""));
+            try {
+                videoSocket.getOutputStream().write(exit ? REPLY_VERSION_EXITING : REPLY_VERSION_BUSY);
+            } finally {
+                close(videoSocket);
+            }
+            if (exit) {
+                System.exit(0);
+            }
+        }
+    }
+
+    private void waitForSockets(PendingSession pending, boolean secondary) throws IOException {
+        long deadline = SystemClock.uptimeMillis() + SESSION_SOCKETS_TIMEOUT_MS;
+        synchronized (pendingSessions) {
+            while (pending.controlSocket == null || (secondary && pending.secondaryVideoSocket == null)) {
+                long remaining = deadline - SystemClock.uptimeMillis();
+                if (remaining <= 0) {
+                    throw new IOException("Timeout waiting for the session sockets");
+                }
+                try {
+                    pendingSessions.wait(remaining);
+                } catch (InterruptedException e) {
+                    throw new IOException("Interrupted", e);
+                }
+            }
+        }
+    }
+
+    private static void close(LocalSocket socket) {
+        if (socket != null) {
+            try {
+                socket.close();
+            } catch (IOException e) {
+                // ignore
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+package com.genymobile.scrcpy;
+
+/**
+ * The device settings changed by the concurrent sessions of the daemon.
+ * <p>
+ * The settings are global to the device: a setting is changed by the first session requiring it, and restored only once the last session
+ * requiring it has ended, so that a session does not disable "show touches" or "stay awake" while another one still needs it. Likewise,
+ * the normal power mode is restored once the last session has ended.
+ */
+final class DaemonSettings {
+
+    private static final Object LOCK = new Object();
+
+    private static int sessionCount;
+    private static int showTouchesCount;
+    private static int stayAwakeCount;
+
+    // the state to restore once no session requires the setting anymore
+    private static boolean mustDisableShowTouches;
+    private static int restoreStayOn = -1;
+
+    private DaemonSettings() {
+        // not instantiable
+    }
+
+    /**
+     * Register a session, changing the settings it requires if no other session does.
+     */
+    static void acquire(boolean showTouches, boolean stayAwake) {
+        synchronized (LOCK) {
+            ++sessionCount;
+            boolean changeShowTouches = showTouches && showTouchesCount++ == 0;
+            boolean changeStayAwake = stayAwake && stayAwakeCount++ == 0;
+            Server.ChangedSettings changed = Server.changeSettings(changeShowTouches, changeStayAwake);
+            if (changeShowTouches) {
+                mustDisableShowTouches = changed.mustDisableShowTouches();
+            }
+            if (changeStayAwake) {
+                restoreStayOn = changed.getRestoreStayOn();
+            }
+        }
+    }
+
+    /**
+     * Unregister a session, restoring the settings it required if no other session does.
+     * <p>
+     * The arguments must be the same as on {@link #acquire(boolean, boolean)}.
+     */
+    static void release(boolean showTouches, boolean stayAwake) {
+        synchronized (LOCK) {
+            boolean lastSession = --sessionCount == 0;
+            boolean disableShowTouches = false;
+            if (showTouches && --showTouchesCount == 0) {
+                disableShowTouches = mustDisableShowTouches;
+                mustDisableShowTouches = false;
+            }
+            int stayOn = -1;
+            if (stayAwake && --stayAwakeCount == 0) {
+                stayOn = restoreStayOn;
+                restoreStayOn = -1;
+            }
+            CleanUp.restore(disableShowTouches, stayOn, lastSession);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+package com.genymobile.scrcpy;
+
+import java.io.Closeable;
+import java.io.IOException;
+import java.net.DatagramPacket;
+import java.net.DatagramSocket;
+import java.net.SocketAddress;
+import java.nio.ByteBuffer;
+
+/**
+ * Send the video packets as datagrams, so that a lost packet does not delay the next ones (no head-of-line blocking).
+ * <p>
+ * Each packet is split into fragments of at most {@link #MAX_PAYLOAD_SIZE} bytes, each one prefixed by a header:
+ *
+ * <pre>
+ * [packet seq (4)][fragment index (2)][fragment count (2)][PTS (8)][capture time (8)][packet size (4)]
+ * </pre>
+ * <p>
+ * The client reassembles the packets, and drops the incomplete ones.
+ */
+public final class DatagramVideoSender implements Closeable {
+
+    public static final int HEADER_SIZE = 28;
+    // small enough to avoid IP fragmentation over most networks
+    public static final int MAX_PAYLOAD_SIZE = 1200;
+
+    private static final long NO_PTS = -1;
+
+    private final DatagramSocket socket;
+    private final byte[] buffer = new byte[HEADER_SIZE + MAX_PAYLOAD_SIZE];
+    private final ByteBuffer header = ByteBuffer.wrap(buffer, 0, HEADER_SIZE);
+    private final DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
+
+    private int seq;
+    // the last config packet, if the client lost it, it could not decode the next key frames
+    private byte[] config;
+    private boolean lastWasConfig;
+
+    public DatagramVideoSender(int port) throws IOException {
+        socket = new DatagramSocket(port);
+    }
+
+    /**
+     * Wait for the first datagram of the client, to get its address (as seen from the device, possibly translated by a NAT).
+     */
+    public void waitForClient() throws IOException {
+        DatagramPacket hello = new DatagramPacket(new byte[16], 16);
+        socket.receive(hello);
+        SocketAddress address = hello.getSocketAddress();
+        socket.connect(address);
+        Ln.i("Sending video datagrams to " + address);
+    }
+
+    public void send(ByteBuffer data, long pts, long captureTime, boolean isConfig, boolean isKeyFrame) throws IOException {
+        if (isConfig) {
+            config = new byte[data.remaining()];
+            data.duplicate().get(config);
+        } else if (isKeyFrame && !lastWasConfig && config != null) {
+            // resend it, it may have been lost (the key frame is typically requested on loss)
+            sendPacket(ByteBuffer.wrap(config), NO_PTS, 0);
+        }
+        sendPacket(data, pts, captureTime);
+        lastWasConfig = isConfig;
+    }
+
+    private void sendPacket(ByteBuffer data, long pts, long captureTime) throws IOException {
+        int size = data.remaining();
+        int count = (size + MAX_PAYLOAD_SIZE - 1) / MAX_PAYLOAD_SIZE;
+        if (count > 0xFFFF) {
+            throw new IOException("Packet too big: " + size + " bytes");
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int len = Math.min(MAX_PAYLOAD_SIZE, data.remaining());
+            header.clear();
+            header.putInt(seq);
+            header.putShort((short) i);
+            header.putShort((short) count);
+            header.putLong(pts);
+            header.putLong(captureTime);
+            header.putInt(size);
+            data.get(buffer, HEADER_SIZE, len);
+            packet.setData(buffer, 0, HEADER_SIZE + len);
+            socket.send(packet);
+        }
+        ++seq;
+    }
+
+    @Override
+    public void close() {
+        socket.close();
+    }
+}
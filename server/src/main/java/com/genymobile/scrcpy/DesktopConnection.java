@@ -17,6 +17,9 @@ public final class DesktopConnection implements Closeable {
 
     private static final String SOCKET_NAME = "scrcpy";
 
+    // large enough for a key frame, so that the encoder thread is not blocked while the client (or the network) catches up
+    private static final int VIDEO_SEND_BUFFER_SIZE = 1 << 20;
+
     private final LocalSocket videoSocket;
     private final FileDescriptor videoFd;
 
@@ -24,15 +27,34 @@ public final class DesktopConnection implements Closeable {
     private final InputStream controlInputStream;
     private final OutputStream controlOutputStream;
 
+    // may be null
+    private final LocalSocket secondaryVideoSocket;
+    private final FileDescriptor secondaryVideoFd;
+
     private final ControlMessageReader reader = new ControlMessageReader();
     private final DeviceMessageWriter writer = new DeviceMessageWriter();
 
-    private DesktopConnection(LocalSocket videoSocket, LocalSocket controlSocket) throws IOException {
+    private DesktopConnection(LocalSocket videoSocket, LocalSocket controlSocket, LocalSocket secondaryVideoSocket) throws IOException {
         this.videoSocket = videoSocket;
         this.controlSocket = controlSocket;
+        this.secondaryVideoSocket = secondaryVideoSocket;
         controlInputStream = controlSocket.getInputStream();
         controlOutputStream = controlSocket.getOutputStream();
         videoFd = videoSocket.getFileDescriptor();
+        secondaryVideoFd = secondaryVideoSocket != null ? secondaryVideoSocket.getFileDescriptor() : null;
+        tuneVideoSocket(videoSocket);
+        if (secondaryVideoSocket != null) {
+            tuneVideoSocket(secondaryVideoSocket);
+        }
+    }
+
+    private static void tuneVideoSocket(LocalSocket socket) {
+        try {
+            socket.setSendBufferSize(VIDEO_SEND_BUFFER_SIZE);
+        } catch (IOException e) {
+            // the system default is still usable
+            Ln.w("Could not set the video socket send buffer size: " + e.getMessage());
+        }
     }
 
     private static LocalSocket connect(String abstractName) throws IOException {
@@ -41,9 +63,19 @@ public final class DesktopConnection implements Closeable {
         return localSocket;
     }
 
-    public static DesktopConnection open(Device device, boolean tunnelForward) throws IOException {
+    /**
+     * Open the connection to the client.
+     *
+     * @param device the device
+     * @param tunnelForward true if the client connects to the device (adb forward)
+     * @param secondaryVideoSize the video size of the secondary stream, or {@code null} if there is none
+     * @return the connection
+     * @throws IOException if the connection failed
+     */
+    public static DesktopConnection open(Device device, boolean tunnelForward, Size secondaryVideoSize) throws IOException {
         LocalSocket videoSocket;
         LocalSocket controlSocket;
+        LocalSocket secondaryVideoSocket = null;
         if (tunnelForward) {
             LocalServerSocket localServerSocket = new LocalServerSocket(SOCKET_NAME);
             try {
@@ -52,6 +84,14 @@ public final class DesktopConnection implements Closeable {
                 videoSocket.getOutputStream().write(0);
                 try {
                     controlSocket = localServerSocket.accept();
+                    if (secondaryVideoSize != null) {
+                        try {
+                            secondaryVideoSocket = localServerSocket.accept();
+                        } catch (IOException | RuntimeException e) {
+                            controlSocket.close();
+                            throw e;
+                        }
+                    }
                 } catch (IOException | RuntimeException e) {
                     videoSocket.close();
                     throw e;
@@ -63,15 +103,42 @@ public final class DesktopConnection implements Closeable {
             videoSocket = connect(SOCKET_NAME);
             try {
                 controlSocket = connect(SOCKET_NAME);
+                if (secondaryVideoSize != null) {
+                    try {
+                        secondaryVideoSocket = connect(SOCKET_NAME);
+                    } catch (IOException | RuntimeException e) {
+                        controlSocket.close();
+                        throw e;
+                    }
+                }
             } catch (IOException | RuntimeException e) {
                 videoSocket.close();
                 throw e;
             }
         }
 
-        DesktopConnection connection = new DesktopConnection(videoSocket, controlSocket);
+        return create(device, videoSocket, controlSocket, secondaryVideoSocket, secondaryVideoSize);
+    }
+
+    /**
+     * Create the connection from sockets already connected (by the daemon), and send the device info.
+     *
+     * @param device the device
+     * @param videoSocket the video socket
+     * @param controlSocket the control socket
+     * @param secondaryVideoSocket the secondary video socket, or {@code null} if there is none
+     * @param secondaryVideoSize the video size of the secondary stream, or {@code null} if there is none
+     * @return the connection
+     * @throws IOException if the device info could not be sent
+     */
+    public static DesktopConnection create(Device device, LocalSocket videoSocket, LocalSocket controlSocket, LocalSocket secondaryVideoSocket,
+            Size secondaryVideoSize) throws IOException {
+        DesktopConnection connection = new DesktopConnection(videoSocket, controlSocket, secondaryVideoSocket);
         Size videoSize = device.getScreenInfo().getVideoSize();
         connection.send(Device.getDeviceName(), videoSize.getWidth(), videoSize.getHeight());
+        if (secondaryVideoSize != null) {
+            connection.sendSecondaryVideoSize(secondaryVideoSize.getWidth(), secondaryVideoSize.getHeight());
+        }
         return connection;
     }
 
@@ -82,6 +149,11 @@ public final class DesktopConnection implements Closeable {
         controlSocket.shutdownInput();
         controlSocket.shutdownOutput();
         controlSocket.close();
+        if (secondaryVideoSocket != null) {
+            secondaryVideoSocket.shutdownInput();
+            secondaryVideoSocket.shutdownOutput();
+            secondaryVideoSocket.close();
+        }
     }
 
     private void send(String deviceName, int width, int height) throws IOException {
@@ -99,10 +171,35 @@ public final class DesktopConnection implements Closeable {
         IO.writeFully(videoFd, buffer, 0, buffer.length);
     }
 
+    private void sendSecondaryVideoSize(int width, int height) throws IOException {
+        byte[] buffer = new byte[4];
+        buffer[0] = (byte) (width >> 8);
+        buffer[1] = (byte) width;
+        buffer[2] = (byte) (height >> 8);
+        buffer[3] = (byte) height;
+        IO.writeFully(secondaryVideoFd, buffer, 0, buffer.length);
+    }
+
+    /**
+     * Block until the client closes the video socket.
+     * <p>
+     * This is only useful if the video stream is not sent over the video socket (writing would fail once it is closed).
+     */
+    public void waitForVideoSocketClosed() throws IOException {
+        InputStream input = videoSocket.getInputStream();
+        while (input.read() != -1) {
+            // the client sends nothing
+        }
+    }
+
     public FileDescriptor getVideoFd() {
         return videoFd;
     }
 
+    public FileDescriptor getSecondaryVideoFd() {
+        return secondaryVideoFd;
+    }
+
     public ControlMessage receiveControlMessage() throws IOException {
         ControlMessage msg = reader.next();
         while (msg == null) {
@@ -112,6 +209,15 @@ public final class DesktopConnection implements Closeable {
         return msg;
     }
 
+    /**
+     * Return the next control message already received, without blocking.
+     *
+     * @return the message, or {@code null} if no complete message is available yet
+     */
+    public ControlMessage pollControlMessage() {
+        return reader.next();
+    }
+
     public void sendDeviceMessage(DeviceMessage msg) throws IOException {
         writer.writeTo(msg, controlOutputStream);
     }
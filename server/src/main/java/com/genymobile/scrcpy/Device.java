@@ -18,6 +18,8 @@ import android.view.InputEvent;
 import android.view.KeyCharacterMap;
 import android.view.KeyEvent;
 
+import java.util.ArrayList;
+import java.util.List;
 import java.util.concurrent.atomic.AtomicBoolean;
 
 public final class Device {
@@ -31,15 +33,24 @@ public final class Device {
         void onRotationChanged(int rotation);
     }
 
+    public interface ScreenInfoListener {
+        void onScreenInfoChanged();
+    }
+
     public interface ClipboardListener {
         void onClipboardTextChanged(String text);
     }
 
     private ScreenInfo screenInfo;
-    private RotationListener rotationListener;
+    private final List<RotationListener> rotationListeners = new ArrayList<>();
+    private final List<ScreenInfoListener> screenInfoListeners = new ArrayList<>();
     private ClipboardListener clipboardListener;
     private final AtomicBoolean isSettingClipboard = new AtomicBoolean();
 
+    // registered to the system services, until release()
+    private final IRotationWatcher rotationWatcher;
+    private IOnPrimaryClipChangedListener clipChangedListener;
+
     /**
      * Logical display identifier
      */
@@ -50,10 +61,32 @@ public final class Device {
      */
     private final int layerStack;
 
+    /**
+     * The refresh rate of the display, in Hz (0 if unknown)
+     */
+    private final float refreshRate;
+
     private final boolean supportsInputEvents;
 
+    /**
+     * The max size of the secondary stream, or -1 if there is none
+     */
+    private final int secondaryMaxSize;
+
+    /**
+     * The crop requested on start (may be null), restored when the crop is reset
+     */
+    private final Rect initialCrop;
+    /**
+     * The max size requested on start (0 for unlimited), the upper bound of the max size requested at runtime
+     */
+    private final int initialMaxSize;
+    private int maxSize;
+    private final int lockedVideoOrientation;
+
     public Device(Options options) {
         displayId = options.getDisplayId();
+        secondaryMaxSize = options.hasSecondaryStream() ? options.getSecondaryMaxSize() : -1;
         DisplayInfo displayInfo = SERVICE_MANAGER.getDisplayManager().getDisplayInfo(displayId);
         if (displayInfo == null) {
             int[] displayIds = SERVICE_MANAGER.getDisplayManager().getDisplayIds();
@@ -62,28 +95,34 @@ public final class Device {
 
         int displayInfoFlags = displayInfo.getFlags();
 
-        screenInfo = ScreenInfo.computeScreenInfo(displayInfo, options.getCrop(), options.getMaxSize(), options.getLockedVideoOrientation());
+        initialCrop = options.getCrop();
+        initialMaxSize = options.getMaxSize();
+        maxSize = initialMaxSize;
+        lockedVideoOrientation = options.getLockedVideoOrientation();
+        screenInfo = ScreenInfo.computeScreenInfo(displayInfo, initialCrop, maxSize, lockedVideoOrientation);
         layerStack = displayInfo.getLayerStack();
+        refreshRate = displayInfo.getRefreshRate();
 
-        SERVICE_MANAGER.getWindowManager().registerRotationWatcher(new IRotationWatcher.Stub() {
+        rotationWatcher = new IRotationWatcher.Stub() {
             @Override
             public void onRotationChanged(int rotation) {
                 synchronized (Device.this) {
                     screenInfo = screenInfo.withDeviceRotation(rotation);
 
                     // notify
-                    if (rotationListener != null) {
+                    for (RotationListener rotationListener : rotationListeners) {
                         rotationListener.onRotationChanged(rotation);
                     }
                 }
             }
-        }, displayId);
+        };
+        SERVICE_MANAGER.getWindowManager().registerRotationWatcher(rotationWatcher, displayId);
 
         if (options.getControl()) {
             // If control is enabled, synchronize Android clipboard to the computer automatically
             ClipboardManager clipboardManager = SERVICE_MANAGER.getClipboardManager();
             if (clipboardManager != null) {
-                clipboardManager.addPrimaryClipChangedListener(new IOnPrimaryClipChangedListener.Stub() {
+                clipChangedListener = new IOnPrimaryClipChangedListener.Stub() {
                     @Override
                     public void dispatchPrimaryClipChanged() {
                         if (isSettingClipboard.get()) {
@@ -99,7 +138,8 @@ public final class Device {
                             }
                         }
                     }
-                });
+                };
+                clipboardManager.addPrimaryClipChangedListener(clipChangedListener);
             } else {
                 Ln.w("No clipboard manager, copy-paste between device and computer will not work");
             }
@@ -124,6 +164,10 @@ public final class Device {
         return layerStack;
     }
 
+    public float getRefreshRate() {
+        return refreshRate;
+    }
+
     public Point getPhysicalPoint(Position position) {
         // it hides the field on purpose, to read it with a lock
         @SuppressWarnings("checkstyle:HiddenField")
@@ -138,9 +182,14 @@ public final class Device {
 
         Size clientVideoSize = devicePosition.getScreenSize();
         if (!unlockedVideoSize.equals(clientVideoSize)) {
-            // The client sends a click relative to a video with wrong dimensions,
-            // the device may have been rotated since the event was generated, so ignore the event
-            return null;
+            // The client may display the secondary stream
+            Size secondaryVideoSize = secondaryMaxSize != -1 ? screenInfo.withMaxSize(secondaryMaxSize).getUnlockedVideoSize() : null;
+            if (!clientVideoSize.equals(secondaryVideoSize)) {
+                // The client sends a click relative to a video with wrong dimensions,
+                // the device may have been rotated since the event was generated, so ignore the event
+                return null;
+            }
+            unlockedVideoSize = secondaryVideoSize;
         }
         Rect contentRect = screenInfo.getContentRect();
         Point point = devicePosition.getPoint();
@@ -149,10 +198,102 @@ public final class Device {
         return new Point(convertedX, convertedY);
     }
 
+    /**
+     * Crop the screen to the given rectangle of the video currently streamed, or restore the initial crop if its size is 0.
+     * <p>
+     * The encoders are notified to apply it on the fly.
+     *
+     * @param position the top-left corner of the crop, relative to the video displayed by the client
+     * @param width the width of the crop, in video coordinates
+     * @param height the height of the crop, in video coordinates
+     */
+    public synchronized void setCrop(Position position, int width, int height) {
+        ScreenInfo newScreenInfo;
+        if (width == 0 || height == 0) {
+            DisplayInfo displayInfo = SERVICE_MANAGER.getDisplayManager().getDisplayInfo(displayId);
+            if (displayInfo == null) {
+                Ln.w("Could not get display info to reset the crop");
+                return;
+            }
+            newScreenInfo = ScreenInfo.computeScreenInfo(displayInfo, initialCrop, maxSize, lockedVideoOrientation);
+        } else {
+            Point topLeft = getPhysicalPoint(position);
+            Point p = position.getPoint();
+            Point bottomRight = getPhysicalPoint(new Position(new Point(p.getX() + width, p.getY() + height), position.getScreenSize()));
+            if (topLeft == null || bottomRight == null) {
+                // the video size has changed since the request
+                Ln.w("Ignoring crop request for an outdated video size");
+                return;
+            }
+            // the video rotation may swap the corners
+            Rect contentRect = new Rect(Math.min(topLeft.getX(), bottomRight.getX()), Math.min(topLeft.getY(), bottomRight.getY()),
+                    Math.max(topLeft.getX(), bottomRight.getX()), Math.max(topLeft.getY(), bottomRight.getY()));
+            if (!contentRect.intersect(screenInfo.getContentRect())) {
+                Ln.w("Crop rectangle out of the video");
+                return;
+            }
+            newScreenInfo = screenInfo.withContentRect(contentRect, maxSize);
+        }
+
+        Size videoSize = newScreenInfo.getUnlockedVideoSize();
+        if (videoSize.getWidth() == 0 || videoSize.getHeight() == 0) {
+            Ln.w("Crop rectangle too small");
+            return;
+        }
+
+        Rect rect = newScreenInfo.getContentRect();
+        Ln.i("Crop set to " + rect.width() + ":" + rect.height() + ":" + rect.left + ":" + rect.top);
+        setScreenInfo(newScreenInfo);
+    }
+
+    /**
+     * Change the max size of the main stream (typically to follow the client window size), bounded by the initial max size.
+     * <p>
+     * The encoder is only restarted if the video size actually changes.
+     *
+     * @param requestedMaxSize the new max size (0 to restore the initial max size)
+     */
+    public synchronized void setMaxSize(int requestedMaxSize) {
+        // H.264 only accepts multiples of 8
+        int newMaxSize = requestedMaxSize & ~7;
+        if (newMaxSize == 0 || (initialMaxSize != 0 && newMaxSize > initialMaxSize)) {
+            newMaxSize = initialMaxSize;
+        }
+        if (newMaxSize == maxSize) {
+            return;
+        }
+        maxSize = newMaxSize;
+
+        ScreenInfo newScreenInfo = screenInfo.withMaxSize(maxSize);
+        if (newScreenInfo == screenInfo) {
+            // same video size
+            return;
+        }
+        Size videoSize = newScreenInfo.getVideoSize();
+        Ln.i("Video size set to " + videoSize.getWidth() + "x" + videoSize.getHeight());
+        setScreenInfo(newScreenInfo);
+    }
+
+    private void setScreenInfo(ScreenInfo newScreenInfo) {
+        screenInfo = newScreenInfo;
+
+        // notify
+        for (ScreenInfoListener screenInfoListener : screenInfoListeners) {
+            screenInfoListener.onScreenInfoChanged();
+        }
+    }
+
     public static String getDeviceName() {
         return Build.MODEL;
     }
 
+    /**
+     * Return the monotonic time in microseconds, in the same time base as the presentation time of the encoded frames.
+     */
+    public static long getMonotonicTimeUs() {
+        return System.nanoTime() / 1000;
+    }
+
     public boolean supportsInputEvents() {
         return supportsInputEvents;
     }
@@ -188,14 +329,38 @@ public final class Device {
         return SERVICE_MANAGER.getPowerManager().isScreenOn();
     }
 
-    public synchronized void setRotationListener(RotationListener rotationListener) {
-        this.rotationListener = rotationListener;
+    public synchronized void addRotationListener(RotationListener rotationListener) {
+        rotationListeners.add(rotationListener);
+    }
+
+    public synchronized void removeRotationListener(RotationListener rotationListener) {
+        rotationListeners.remove(rotationListener);
+    }
+
+    public synchronized void addScreenInfoListener(ScreenInfoListener screenInfoListener) {
+        screenInfoListeners.add(screenInfoListener);
+    }
+
+    public synchronized void removeScreenInfoListener(ScreenInfoListener screenInfoListener) {
+        screenInfoListeners.remove(screenInfoListener);
     }
 
     public synchronized void setClipboardListener(ClipboardListener clipboardListener) {
         this.clipboardListener = clipboardListener;
     }
 
+    /**
+     * Unregister the listeners from the system services.
+     * <p>
+     * This is only necessary if the process outlives the session (daemon mode).
+     */
+    public void release() {
+        SERVICE_MANAGER.getWindowManager().removeRotationWatcher(rotationWatcher);
+        if (clipChangedListener != null) {
+            SERVICE_MANAGER.getClipboardManager().removePrimaryClipChangedListener(clipChangedListener);
+        }
+    }
+
     public static void expandNotificationPanel() {
         SERVICE_MANAGER.getStatusBarManager().expandNotificationsPanel();
     }
@@ -3,9 +3,19 @@ package com.genymobile.scrcpy;
 public final class DeviceMessage {
 
     public static final int TYPE_CLIPBOARD = 0;
+    public static final int TYPE_PONG = 1;
+    public static final int TYPE_STATS = 2;
+    public static final int TYPE_REFRESH_RATE = 3;
+    // a non-final chunk of a clipboard text, only written by DeviceMessageWriter
+    public static final int TYPE_CLIPBOARD_PART = 4;
 
     private int type;
     private String text;
+    private long pingTimestamp;
+    private long pingReceived;
+    private long pongSent;
+    private PerfCounters.Stats stats;
+    private int refreshRate;
 
     private DeviceMessage() {
     }
@@ -17,6 +27,37 @@ public final class DeviceMessage {
         return event;
     }
 
+    /**
+     * @param pingTimestamp the client time of the ping (echoed)
+     * @param pingReceived  the device time when the ping was received, in microseconds
+     * @param pongSent      the device time when the pong is sent, in microseconds
+     */
+    public static DeviceMessage createPong(long pingTimestamp, long pingReceived, long pongSent) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_PONG;
+        event.pingTimestamp = pingTimestamp;
+        event.pingReceived = pingReceived;
+        event.pongSent = pongSent;
+        return event;
+    }
+
+    public static DeviceMessage createStats(PerfCounters.Stats stats) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_STATS;
+        event.stats = stats;
+        return event;
+    }
+
+    /**
+     * @param refreshRate the display refresh rate, in millihertz
+     */
+    public static DeviceMessage createRefreshRate(int refreshRate) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_REFRESH_RATE;
+        event.refreshRate = refreshRate;
+        return event;
+    }
+
     public int getType() {
         return type;
     }
@@ -24,4 +65,24 @@ public final class DeviceMessage {
     public String getText() {
         return text;
     }
+
+    public long getPingTimestamp() {
+        return pingTimestamp;
+    }
+
+    public long getPingReceived() {
+        return pingReceived;
+    }
+
+    public long getPongSent() {
+        return pongSent;
+    }
+
+    public PerfCounters.Stats getStats() {
+        return stats;
+    }
+
+    public int getRefreshRate() {
+        return refreshRate;
+    }
 }
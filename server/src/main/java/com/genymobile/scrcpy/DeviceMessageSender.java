@@ -4,12 +4,22 @@ import java.io.IOException;
 
 public final class DeviceMessageSender {
 
+    private static final long NO_PING = -1;
+    private static final int NO_REFRESH_RATE = 0;
+    private static final long STATS_PERIOD_US = 1_000_000;
+
     private final DesktopConnection connection;
+    private final PerfCounters perfCounters;
 
     private String clipboardText;
+    private int refreshRate = NO_REFRESH_RATE;
+
+    private long pingTimestamp = NO_PING;
+    private long pingReceived;
 
-    public DeviceMessageSender(DesktopConnection connection) {
+    public DeviceMessageSender(DesktopConnection connection, PerfCounters perfCounters) {
         this.connection = connection;
+        this.perfCounters = perfCounters;
     }
 
     public synchronized void pushClipboardText(String text) {
@@ -17,18 +27,72 @@ public final class DeviceMessageSender {
         notify();
     }
 
+    /**
+     * Report the display refresh rate, so that the client sends its input events at the rate the device can consume them.
+     *
+     * @param refreshRate the refresh rate, in millihertz
+     */
+    public synchronized void pushRefreshRate(int refreshRate) {
+        this.refreshRate = refreshRate;
+        notify();
+    }
+
+    /**
+     * Request to answer a ping (only the last one is kept, the client sends them at regular intervals).
+     *
+     * @param timestamp the client time of the ping
+     * @param received  the device time when the ping was received, in microseconds
+     */
+    public synchronized void pushPong(long timestamp, long received) {
+        pingTimestamp = timestamp;
+        pingReceived = received;
+        notify();
+    }
+
     public void loop() throws IOException, InterruptedException {
+        long lastStats = Device.getMonotonicTimeUs();
         while (true) {
             String text;
+            int rate;
+            long timestamp;
+            long received;
+            long now;
             synchronized (this) {
-                while (clipboardText == null) {
-                    wait();
+                while (true) {
+                    now = Device.getMonotonicTimeUs();
+                    long statsTimeout = lastStats + STATS_PERIOD_US - now;
+                    if (clipboardText != null || refreshRate != NO_REFRESH_RATE || pingTimestamp != NO_PING || statsTimeout <= 0) {
+                        break;
+                    }
+                    // round up, wait(0) would wait forever
+                    wait(statsTimeout / 1000 + 1);
                 }
                 text = clipboardText;
                 clipboardText = null;
+                rate = refreshRate;
+                refreshRate = NO_REFRESH_RATE;
+                timestamp = pingTimestamp;
+                received = pingReceived;
+                pingTimestamp = NO_PING;
+            }
+            if (timestamp != NO_PING) {
+                // as late as possible, the time spent on the device is excluded from the round trip
+                DeviceMessage pong = DeviceMessage.createPong(timestamp, received, Device.getMonotonicTimeUs());
+                connection.sendDeviceMessage(pong);
+            }
+            if (rate != NO_REFRESH_RATE) {
+                DeviceMessage event = DeviceMessage.createRefreshRate(rate);
+                connection.sendDeviceMessage(event);
+            }
+            if (text != null) {
+                DeviceMessage event = DeviceMessage.createClipboard(text);
+                connection.sendDeviceMessage(event);
+            }
+            if (now - lastStats >= STATS_PERIOD_US) {
+                DeviceMessage stats = DeviceMessage.createStats(perfCounters.collect(now - lastStats));
+                connection.sendDeviceMessage(stats);
+                lastStats = now;
             }
-            DeviceMessage event = DeviceMessage.createClipboard(text);
-            connection.sendDeviceMessage(event);
         }
     }
 }
@@ -7,22 +7,43 @@ import java.nio.charset.StandardCharsets;
 
 public class DeviceMessageWriter {
 
-    private static final int MESSAGE_MAX_SIZE = 1 << 18; // 256k
+    private static final int MESSAGE_MAX_SIZE = 1 << 14; // 16k
+    // a larger clipboard text is split into several messages
     public static final int CLIPBOARD_TEXT_MAX_LENGTH = MESSAGE_MAX_SIZE - 5; // type: 1 byte; length: 4 bytes
+    // the whole text (of all the chunks) is truncated to this length
+    public static final int CLIPBOARD_TOTAL_MAX_LENGTH = 1 << 24; // 16M
 
     private final byte[] rawBuffer = new byte[MESSAGE_MAX_SIZE];
     private final ByteBuffer buffer = ByteBuffer.wrap(rawBuffer);
 
     public void writeTo(DeviceMessage msg, OutputStream output) throws IOException {
         buffer.clear();
-        buffer.put((byte) DeviceMessage.TYPE_CLIPBOARD);
+        buffer.put((byte) msg.getType());
         switch (msg.getType()) {
             case DeviceMessage.TYPE_CLIPBOARD:
-                String text = msg.getText();
-                byte[] raw = text.getBytes(StandardCharsets.UTF_8);
-                int len = StringUtils.getUtf8TruncationIndex(raw, CLIPBOARD_TEXT_MAX_LENGTH);
-                buffer.putInt(len);
-                buffer.put(raw, 0, len);
+                writeClipboard(msg.getText(), output);
+                break;
+            case DeviceMessage.TYPE_PONG:
+                buffer.putLong(msg.getPingTimestamp());
+                buffer.putLong(msg.getPingReceived());
+                buffer.putLong(msg.getPongSent());
+                output.write(rawBuffer, 0, buffer.position());
+                break;
+            case DeviceMessage.TYPE_STATS:
+                PerfCounters.Stats stats = msg.getStats();
+                buffer.putInt(stats.getEncodedFrames());
+                buffer.putInt(stats.getDroppedFrames());
+                buffer.putInt(stats.getBytesPerSecond());
+                buffer.putInt(stats.getEncodeTimeAvg());
+                buffer.putInt(stats.getEncodeTimeMax());
+                buffer.putInt(stats.getQueueDepthMax());
+                buffer.putInt(stats.getInjectedEvents());
+                buffer.putInt(stats.getInjectionLatencyAvg());
+                buffer.putInt(stats.getInjectionLatencyMax());
+                output.write(rawBuffer, 0, buffer.position());
+                break;
+            case DeviceMessage.TYPE_REFRESH_RATE:
+                buffer.putInt(msg.getRefreshRate());
                 output.write(rawBuffer, 0, buffer.position());
                 break;
             default:
@@ -30,4 +51,25 @@ public class DeviceMessageWriter {
                 break;
         }
     }
+
+    /**
+     * Write the text as a sequence of TYPE_CLIPBOARD_PART chunks followed by a final TYPE_CLIPBOARD chunk (a single TYPE_CLIPBOARD if it is
+     * small enough), split on code point boundaries.
+     */
+    private void writeClipboard(String text, OutputStream output) throws IOException {
+        byte[] raw = text.getBytes(StandardCharsets.UTF_8);
+        int total = StringUtils.getUtf8TruncationIndex(raw, CLIPBOARD_TOTAL_MAX_LENGTH);
+        int offset = 0;
+        boolean last;
+        do {
+            int len = StringUtils.getUtf8TruncationIndex(raw, offset, Math.min(CLIPBOARD_TEXT_MAX_LENGTH, total - offset));
+            last = offset + len == total;
+            buffer.clear();
+            buffer.put((byte) (last ? DeviceMessage.TYPE_CLIPBOARD : DeviceMessage.TYPE_CLIPBOARD_PART));
+            buffer.putInt(len);
+            buffer.put(raw, offset, len);
+            output.write(rawBuffer, 0, buffer.position());
+            offset += len;
+        } while (!last);
+    }
 }
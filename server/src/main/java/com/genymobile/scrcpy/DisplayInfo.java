@@ -6,15 +6,17 @@ public final class DisplayInfo {
     private final int rotation;
     private final int layerStack;
     private final int flags;
+    private final float refreshRate; // 0 if unknown
 
     public static final int FLAG_SUPPORTS_PROTECTED_BUFFERS = 0x00000001;
 
-    public DisplayInfo(int displayId, Size size, int rotation, int layerStack, int flags) {
+    public DisplayInfo(int displayId, Size size, int rotation, int layerStack, int flags, float refreshRate) {
         this.displayId = displayId;
         this.size = size;
         this.rotation = rotation;
         this.layerStack = layerStack;
         this.flags = flags;
+        this.refreshRate = refreshRate;
     }
 
     public int getDisplayId() {
@@ -36,5 +38,9 @@ public final class DisplayInfo {
     public int getFlags() {
         return flags;
     }
+
+    public float getRefreshRate() {
+        return refreshRate;
+    }
 }
 
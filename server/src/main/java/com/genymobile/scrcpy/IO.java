@@ -37,4 +37,47 @@ public final class IO {
     public static void writeFully(FileDescriptor fd, byte[] buffer, int offset, int len) throws IOException {
         writeFully(fd, ByteBuffer.wrap(buffer, offset, len));
     }
+
+    /**
+     * Write the remaining bytes of both buffers using a single {@code writev()} call (unless it is interrupted or partial).
+     * <p>
+     * The buffers must be either direct or backed by an array. Their position is not updated.
+     */
+    public static void writeFully(FileDescriptor fd, ByteBuffer header, ByteBuffer data) throws IOException {
+        // Os.writev() accepts direct ByteBuffers or byte[], and ignores the position of the buffers
+        Object[] buffers = {toIoVecBuffer(header), toIoVecBuffer(data)};
+        int[] offsets = {toIoVecOffset(header), toIoVecOffset(data)};
+        int[] byteCounts = {header.remaining(), data.remaining()};
+
+        int remaining = byteCounts[0] + byteCounts[1];
+        while (remaining > 0) {
+            try {
+                int w = Os.writev(fd, buffers, offsets, byteCounts);
+                if (BuildConfig.DEBUG && w < 0) {
+                    // w should not be negative, since an exception is thrown on error
+                    throw new AssertionError("Os.writev() returned a negative value (" + w + ")");
+                }
+                remaining -= w;
+                // skip the bytes already written on partial write
+                for (int i = 0; i < byteCounts.length && w > 0; ++i) {
+                    int consumed = Math.min(w, byteCounts[i]);
+                    offsets[i] += consumed;
+                    byteCounts[i] -= consumed;
+                    w -= consumed;
+                }
+            } catch (ErrnoException e) {
+                if (e.errno != OsConstants.EINTR) {
+                    throw new IOException(e);
+                }
+            }
+        }
+    }
+
+    private static Object toIoVecBuffer(ByteBuffer buffer) {
+        return buffer.isDirect() ? buffer : buffer.array();
+    }
+
+    private static int toIoVecOffset(ByteBuffer buffer) {
+        return buffer.isDirect() ? buffer.position() : buffer.arrayOffset() + buffer.position();
+    }
 }
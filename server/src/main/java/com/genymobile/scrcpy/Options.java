@@ -17,6 +17,11 @@ public class Options {
     private boolean stayAwake;
     private String codecOptions;
     private String encoderName;
+    private int secondaryMaxSize;
+    private int secondaryBitRate; // 0 if there is no secondary stream
+    private int videoUdpPort; // 0 to send the video stream over the video socket
+    private String videoMimeType;
+    private boolean latencyProfile; // tune the encoder for latency rather than quality
 
     public Ln.Level getLogLevel() {
         return logLevel;
@@ -129,4 +134,48 @@ public class Options {
     public void setEncoderName(String encoderName) {
         this.encoderName = encoderName;
     }
+
+    public int getSecondaryMaxSize() {
+        return secondaryMaxSize;
+    }
+
+    public void setSecondaryMaxSize(int secondaryMaxSize) {
+        this.secondaryMaxSize = secondaryMaxSize;
+    }
+
+    public int getSecondaryBitRate() {
+        return secondaryBitRate;
+    }
+
+    public void setSecondaryBitRate(int secondaryBitRate) {
+        this.secondaryBitRate = secondaryBitRate;
+    }
+
+    public boolean hasSecondaryStream() {
+        return secondaryBitRate != 0;
+    }
+
+    public int getVideoUdpPort() {
+        return videoUdpPort;
+    }
+
+    public void setVideoUdpPort(int videoUdpPort) {
+        this.videoUdpPort = videoUdpPort;
+    }
+
+    public String getVideoMimeType() {
+        return videoMimeType;
+    }
+
+    public void setVideoMimeType(String videoMimeType) {
+        this.videoMimeType = videoMimeType;
+    }
+
+    public boolean getLatencyProfile() {
+        return latencyProfile;
+    }
+
+    public void setLatencyProfile(boolean latencyProfile) {
+        this.latencyProfile = latencyProfile;
+    }
 }
@@ -0,0 +1,143 @@
+package com.genymobile.scrcpy;
+
+/**
+ * Performance counters of the device side, sent periodically to the client (to locate the bottlenecks).
+ * <p>
+ * Updated from the encoder and controller threads, and collected by the device message sender.
+ */
+public final class PerfCounters {
+
+    /**
+     * The counters over one period, all times in microseconds.
+     */
+    public static final class Stats {
+        private final int encodedFrames;
+        private final int droppedFrames;
+        private final int bytesPerSecond;
+        private final int encodeTimeAvg;
+        private final int encodeTimeMax;
+        private final int queueDepthMax;
+        private final int injectedEvents;
+        private final int injectionLatencyAvg;
+        private final int injectionLatencyMax;
+
+        public Stats(int encodedFrames, int droppedFrames, int bytesPerSecond, int encodeTimeAvg, int encodeTimeMax, int queueDepthMax,
+                int injectedEvents, int injectionLatencyAvg, int injectionLatencyMax) {
+            this.encodedFrames = encodedFrames;
+            this.droppedFrames = droppedFrames;
+            this.bytesPerSecond = bytesPerSecond;
+            this.encodeTimeAvg = encodeTimeAvg;
+            this.encodeTimeMax = encodeTimeMax;
+            this.queueDepthMax = queueDepthMax;
+            this.injectedEvents = injectedEvents;
+            this.injectionLatencyAvg = injectionLatencyAvg;
+            this.injectionLatencyMax = injectionLatencyMax;
+        }
+
+        public int getEncodedFrames() {
+            return encodedFrames;
+        }
+
+        public int getDroppedFrames() {
+            return droppedFrames;
+        }
+
+        public int getBytesPerSecond() {
+            return bytesPerSecond;
+        }
+
+        public int getEncodeTimeAvg() {
+            return encodeTimeAvg;
+        }
+
+        public int getEncodeTimeMax() {
+            return encodeTimeMax;
+        }
+
+        public int getQueueDepthMax() {
+            return queueDepthMax;
+        }
+
+        public int getInjectedEvents() {
+            return injectedEvents;
+        }
+
+        public int getInjectionLatencyAvg() {
+            return injectionLatencyAvg;
+        }
+
+        public int getInjectionLatencyMax() {
+            return injectionLatencyMax;
+        }
+    }
+
+    // all guarded by this
+    private int encodedFrames;
+    private int droppedFrames;
+    private long bytes;
+    private long encodeTimeSum;
+    private long encodeTimeMax;
+    private int queueDepthMax;
+    private int injectedEvents;
+    private long injectionLatencySum;
+    private long injectionLatencyMax;
+
+    /**
+     * @param encodeTime the time between the capture and the dequeuing of the output buffer, in microseconds
+     * @param queueDepth the number of frames already encoded when the previous one was sent
+     */
+    public synchronized void addEncodedFrame(long encodeTime, int queueDepth) {
+        ++encodedFrames;
+        encodeTimeSum += encodeTime;
+        encodeTimeMax = Math.max(encodeTimeMax, encodeTime);
+        queueDepthMax = Math.max(queueDepthMax, queueDepth);
+    }
+
+    /**
+     * Count a frame produced by the encoder but never sent.
+     */
+    public synchronized void addDroppedFrame() {
+        ++droppedFrames;
+    }
+
+    public synchronized void addBytes(int count) {
+        bytes += count;
+    }
+
+    /**
+     * @param latency the time between the reception of the control message and the end of its injection, in microseconds
+     */
+    public synchronized void addInjection(long latency) {
+        ++injectedEvents;
+        injectionLatencySum += latency;
+        injectionLatencyMax = Math.max(injectionLatencyMax, latency);
+    }
+
+    /**
+     * Return the counters since the last call, and reset them.
+     *
+     * @param period the duration since the last call, in microseconds
+     */
+    public synchronized Stats collect(long period) {
+        int bytesPerSecond = period > 0 ? (int) Math.min(bytes * 1_000_000 / period, Integer.MAX_VALUE) : 0;
+        int encodeTimeAvg = encodedFrames > 0 ? (int) (encodeTimeSum / encodedFrames) : 0;
+        int injectionLatencyAvg = injectedEvents > 0 ? (int) (injectionLatencySum / injectedEvents) : 0;
+        Stats stats = new Stats(encodedFrames, droppedFrames, bytesPerSecond, encodeTimeAvg, clamp(encodeTimeMax), queueDepthMax,
+                injectedEvents, injectionLatencyAvg, clamp(injectionLatencyMax));
+
+        encodedFrames = 0;
+        droppedFrames = 0;
+        bytes = 0;
+        encodeTimeSum = 0;
+        encodeTimeMax = 0;
+        queueDepthMax = 0;
+        injectedEvents = 0;
+        injectionLatencySum = 0;
+        injectionLatencyMax = 0;
+        return stats;
+    }
+
+    private static int clamp(long value) {
+        return (int) Math.min(value, Integer.MAX_VALUE);
+    }
+}
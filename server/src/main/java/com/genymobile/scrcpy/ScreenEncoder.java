@@ -7,6 +7,8 @@ import android.media.MediaCodec;
 import android.media.MediaCodecInfo;
 import android.media.MediaCodecList;
 import android.media.MediaFormat;
+import android.os.Build;
+import android.os.Bundle;
 import android.os.IBinder;
 import android.view.Surface;
 
@@ -18,30 +20,69 @@ import java.util.Arrays;
 import java.util.List;
 import java.util.concurrent.atomic.AtomicBoolean;
 
-public class ScreenEncoder implements Device.RotationListener {
+public class ScreenEncoder implements Device.RotationListener, Device.ScreenInfoListener {
 
     private static final int DEFAULT_I_FRAME_INTERVAL = 10; // seconds
     private static final int REPEAT_FRAME_DELAY_US = 100_000; // repeat after 100ms
     private static final String KEY_MAX_FPS_TO_ENCODER = "max-fps-to-encoder";
+    // with intra refresh, periodic key frames are only needed to seek in a recording
+    private static final int INTRA_REFRESH_I_FRAME_INTERVAL = 60; // seconds
+    private static final int INTRA_REFRESH_PERIOD_FRAMES = 60;
 
     private static final int NO_PTS = -1;
+    // set in the PTS sent to the client, so that it detects the key frames without parsing the bitstream
+    private static final long PACKET_FLAG_KEY_FRAME = 1L << 62;
+
+    /**
+     * Use the video size of the device screen info (for the main stream)
+     */
+    public static final int DEVICE_MAX_SIZE = -1;
 
     private final AtomicBoolean rotationChanged = new AtomicBoolean();
-    private final ByteBuffer headerBuffer = ByteBuffer.allocate(12);
+    private final AtomicBoolean screenInfoChanged = new AtomicBoolean();
+    private final ByteBuffer headerBuffer = ByteBuffer.allocate(20);
 
+    private final String mimeType;
     private String encoderName;
     private List<CodecOption> codecOptions;
-    private int bitRate;
+    private int bitRate; // guarded by this
+    private MediaCodec runningCodec; // guarded by this
+    private boolean suspended; // guarded by this
     private int maxFps;
     private boolean sendFrameMeta;
     private long ptsOrigin;
-
-    public ScreenEncoder(boolean sendFrameMeta, int bitRate, int maxFps, List<CodecOption> codecOptions, String encoderName) {
+    private final int maxSize;
+    private DatagramVideoSender datagramSender;
+    private final boolean latencyProfile;
+    private boolean latencyProfileLogged;
+    private PerfCounters perfCounters; // may be null
+    // the number of consecutive frames already encoded when their output buffer was requested
+    private int pendingFrames;
+
+    public ScreenEncoder(boolean sendFrameMeta, String mimeType, int bitRate, int maxFps, List<CodecOption> codecOptions, String encoderName,
+            int maxSize, boolean latencyProfile) {
         this.sendFrameMeta = sendFrameMeta;
+        this.mimeType = mimeType;
         this.bitRate = bitRate;
         this.maxFps = maxFps;
         this.codecOptions = codecOptions;
         this.encoderName = encoderName;
+        this.maxSize = maxSize;
+        this.latencyProfile = latencyProfile;
+    }
+
+    /**
+     * Send the video packets over UDP instead of the file descriptor (which must still be passed to {@link #streamScreen}).
+     */
+    public void setDatagramSender(DatagramVideoSender datagramSender) {
+        this.datagramSender = datagramSender;
+    }
+
+    /**
+     * Record the encoding performance into the given counters (must be called before {@link #streamScreen}).
+     */
+    public void setPerfCounters(PerfCounters perfCounters) {
+        this.perfCounters = perfCounters;
     }
 
     @Override
@@ -49,6 +90,83 @@ public class ScreenEncoder implements Device.RotationListener {
         rotationChanged.set(true);
     }
 
+    @Override
+    public void onScreenInfoChanged() {
+        screenInfoChanged.set(true);
+    }
+
+    /**
+     * Change the bit rate of the running encoder (and of the next ones, on rotation).
+     * <p>
+     * May be called from any thread.
+     */
+    public synchronized void setBitRate(int bitRate) {
+        if (bitRate == this.bitRate) {
+            return;
+        }
+        this.bitRate = bitRate;
+        if (runningCodec != null) {
+            Bundle params = new Bundle();
+            params.putInt(MediaCodec.PARAMETER_KEY_VIDEO_BITRATE, bitRate);
+            runningCodec.setParameters(params);
+        }
+        Ln.d("Bit rate set to " + bitRate);
+    }
+
+    /**
+     * Request the running encoder to produce a key frame as soon as possible.
+     * <p>
+     * May be called from any thread.
+     */
+    public synchronized void requestKeyFrame() {
+        if (runningCodec != null) {
+            Bundle params = new Bundle();
+            params.putInt(MediaCodec.PARAMETER_KEY_REQUEST_SYNC_FRAME, 0);
+            runningCodec.setParameters(params);
+            Ln.d("Key frame requested");
+        }
+    }
+
+    /**
+     * Suspend or resume the encoding (typically while the client window is minimized).
+     * <p>
+     * While suspended, the encoder drops its input frames, so nothing is sent. A key frame is requested on resume, since the client may
+     * have dropped the last frames.
+     * <p>
+     * May be called from any thread.
+     */
+    public synchronized void setSuspended(boolean suspended) {
+        if (suspended == this.suspended) {
+            return;
+        }
+        this.suspended = suspended;
+        if (runningCodec != null) {
+            applySuspended(runningCodec, suspended);
+        }
+        Ln.i("Video encoding " + (suspended ? "suspended" : "resumed"));
+    }
+
+    private static void applySuspended(MediaCodec codec, boolean suspended) {
+        Bundle params = new Bundle();
+        params.putInt(MediaCodec.PARAMETER_KEY_SUSPEND, suspended ? 1 : 0);
+        if (!suspended) {
+            params.putInt(MediaCodec.PARAMETER_KEY_REQUEST_SYNC_FRAME, 0);
+        }
+        codec.setParameters(params);
+    }
+
+    private synchronized int getBitRate() {
+        return bitRate;
+    }
+
+    private synchronized void setRunningCodec(MediaCodec codec) {
+        runningCodec = codec;
+        if (codec != null && suspended) {
+            // the encoder has been restarted while suspended
+            applySuspended(codec, true);
+        }
+    }
+
     public boolean consumeRotationChange() {
         return rotationChanged.getAndSet(false);
     }
@@ -69,14 +187,23 @@ public class ScreenEncoder implements Device.RotationListener {
     }
 
     private void internalStreamScreen(Device device, FileDescriptor fd) throws IOException {
-        MediaFormat format = createFormat(bitRate, maxFps, codecOptions);
-        device.setRotationListener(this);
+        MediaFormat format = createFormat(mimeType, getBitRate(), maxFps, codecOptions);
+        device.addRotationListener(this);
+        device.addScreenInfoListener(this);
+        // On rotation, the codec and the display are kept: the codec is only reconfigured, and the display projection changed. Releasing
+        // and recreating them would cost hundreds of milliseconds.
+        MediaCodec codec = createCodec(mimeType, encoderName);
+        IBinder display = createDisplay();
+        boolean reused = false;
         boolean alive;
         try {
             do {
-                MediaCodec codec = createCodec(encoderName);
-                IBinder display = createDisplay();
-                ScreenInfo screenInfo = device.getScreenInfo();
+                if (latencyProfile) {
+                    applyLatencyProfile(format, codec.getCodecInfo());
+                }
+                // a crop or max size change is applied by this (re)configuration
+                screenInfoChanged.set(false);
+                ScreenInfo screenInfo = getScreenInfo(device);
                 Rect contentRect = screenInfo.getContentRect();
                 // include the locked video orientation
                 Rect videoRect = screenInfo.getVideoSize().toRect();
@@ -85,46 +212,112 @@ public class ScreenEncoder implements Device.RotationListener {
                 int videoRotation = screenInfo.getVideoRotation();
                 int layerStack = device.getLayerStack();
 
+                // the bit rate may have been changed by the client
+                format.setInteger(MediaFormat.KEY_BIT_RATE, getBitRate());
                 setSize(format, videoRect.width(), videoRect.height());
-                configure(codec, format);
+                try {
+                    configure(codec, format);
+                } catch (IllegalStateException e) {
+                    if (!reused) {
+                        throw e;
+                    }
+                    // some encoders do not support to be reconfigured after reset(), fall back to a new one
+                    Ln.w("Could not reconfigure the encoder, creating a new one");
+                    codec.release();
+                    codec = createCodec(mimeType, encoderName);
+                    configure(codec, format);
+                }
+                if (latencyProfile && !latencyProfileLogged) {
+                    logLatencyProfile(codec.getOutputFormat());
+                    latencyProfileLogged = true;
+                }
                 Surface surface = codec.createInputSurface();
                 setDisplaySurface(display, surface, videoRotation, contentRect, unlockedVideoRect, layerStack);
                 codec.start();
+                setRunningCodec(codec);
                 try {
-                    alive = encode(codec, fd);
-                    // do not call stop() on exception, it would trigger an IllegalStateException
-                    codec.stop();
+                    alive = encode(codec, fd, device, display, screenInfo.getVideoSize());
+                    setRunningCodec(null);
+                    // return to the uninitialized state, to configure the codec again for the new size (not on exception, the codec is
+                    // released anyway)
+                    codec.reset();
+                    reused = true;
                 } finally {
-                    destroyDisplay(display);
-                    codec.release();
+                    setRunningCodec(null);
                     surface.release();
                 }
             } while (alive);
         } finally {
-            device.setRotationListener(null);
+            destroyDisplay(display);
+            codec.release();
+            device.removeRotationListener(this);
+            device.removeScreenInfoListener(this);
+        }
+    }
+
+    private ScreenInfo getScreenInfo(Device device) {
+        ScreenInfo screenInfo = device.getScreenInfo();
+        if (maxSize != DEVICE_MAX_SIZE) {
+            // a secondary stream, with its own video size
+            screenInfo = screenInfo.withMaxSize(maxSize);
         }
+        return screenInfo;
     }
 
-    private boolean encode(MediaCodec codec, FileDescriptor fd) throws IOException {
+    /**
+     * Apply a screen info change (crop or max size) without reconfiguring the encoder, if the video size is unchanged.
+     *
+     * @return {@code true} if the change has been applied, {@code false} if the encoding must be restarted with a new size
+     */
+    private boolean applyScreenInfoChange(Device device, IBinder display, Size videoSize) {
+        ScreenInfo screenInfo = getScreenInfo(device);
+        if (!screenInfo.getVideoSize().equals(videoSize)) {
+            return false;
+        }
+        // only the region of the screen to capture changes, the encoder keeps running
+        setDisplayProjection(display, screenInfo.getVideoRotation(), screenInfo.getContentRect(), screenInfo.getUnlockedVideoSize().toRect());
+        return true;
+    }
+
+    private boolean encode(MediaCodec codec, FileDescriptor fd, Device device, IBinder display, Size videoSize) throws IOException {
         boolean eof = false;
         MediaCodec.BufferInfo bufferInfo = new MediaCodec.BufferInfo();
 
         while (!consumeRotationChange() && !eof) {
+            long dequeueStart = Device.getMonotonicTimeUs();
             int outputBufferId = codec.dequeueOutputBuffer(bufferInfo, -1);
             eof = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_END_OF_STREAM) != 0;
             try {
-                if (consumeRotationChange()) {
+                boolean restart = consumeRotationChange();
+                if (!restart && screenInfoChanged.getAndSet(false)) {
+                    restart = !applyScreenInfoChange(device, display, videoSize);
+                }
+                if (restart) {
+                    if (outputBufferId >= 0 && perfCounters != null) {
+                        perfCounters.addDroppedFrame();
+                    }
                     // must restart encoding with new size
                     break;
                 }
                 if (outputBufferId >= 0) {
                     ByteBuffer codecBuffer = codec.getOutputBuffer(outputBufferId);
-
-                    if (sendFrameMeta) {
-                        writeFrameMeta(fd, bufferInfo, codecBuffer.remaining());
+                    if (perfCounters != null) {
+                        recordPerf(bufferInfo, dequeueStart, codecBuffer.remaining());
                     }
 
-                    IO.writeFully(fd, codecBuffer);
+                    if (datagramSender != null) {
+                        prepareFrameMeta(bufferInfo, codecBuffer.remaining());
+                        boolean config = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0;
+                        boolean keyFrame = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_KEY_FRAME) != 0;
+                        // the same meta, repeated in each fragment
+                        datagramSender.send(codecBuffer, headerBuffer.getLong(0), headerBuffer.getLong(8), config, keyFrame);
+                    } else if (sendFrameMeta) {
+                        prepareFrameMeta(bufferInfo, codecBuffer.remaining());
+                        // send the header and the packet at once, to avoid a syscall and a header-only TCP segment
+                        IO.writeFully(fd, headerBuffer, codecBuffer);
+                    } else {
+                        IO.writeFully(fd, codecBuffer);
+                    }
                 }
             } finally {
                 if (outputBufferId >= 0) {
@@ -136,47 +329,72 @@ public class ScreenEncoder implements Device.RotationListener {
         return !eof;
     }
 
-    private void writeFrameMeta(FileDescriptor fd, MediaCodec.BufferInfo bufferInfo, int packetSize) throws IOException {
+    private void recordPerf(MediaCodec.BufferInfo bufferInfo, long dequeueStart, int packetSize) {
+        perfCounters.addBytes(packetSize);
+        if ((bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0) {
+            return;
+        }
+        // for a surface input, the presentation time is the capture time in the monotonic clock
+        long captureTime = bufferInfo.presentationTimeUs;
+        // captured before the output buffer was requested: the encoder is ahead of the socket
+        pendingFrames = captureTime < dequeueStart ? pendingFrames + 1 : 0;
+        perfCounters.addEncodedFrame(Device.getMonotonicTimeUs() - captureTime, pendingFrames);
+    }
+
+    private void prepareFrameMeta(MediaCodec.BufferInfo bufferInfo, int packetSize) {
         headerBuffer.clear();
 
         long pts;
+        long captureTime;
         if ((bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0) {
             pts = NO_PTS; // non-media data packet
+            captureTime = 0;
         } else {
             if (ptsOrigin == 0) {
                 ptsOrigin = bufferInfo.presentationTimeUs;
             }
             pts = bufferInfo.presentationTimeUs - ptsOrigin;
+            if ((bufferInfo.flags & MediaCodec.BUFFER_FLAG_KEY_FRAME) != 0) {
+                pts |= PACKET_FLAG_KEY_FRAME;
+            }
+            // for a surface input, the presentation time is the capture time in the monotonic clock (System.nanoTime())
+            captureTime = bufferInfo.presentationTimeUs;
         }
 
         headerBuffer.putLong(pts);
+        headerBuffer.putLong(captureTime);
         headerBuffer.putInt(packetSize);
         headerBuffer.flip();
-        IO.writeFully(fd, headerBuffer);
     }
 
-    private static MediaCodecInfo[] listEncoders() {
+    private static MediaCodecInfo[] listEncoders(String mimeType) {
         List<MediaCodecInfo> result = new ArrayList<>();
         MediaCodecList list = new MediaCodecList(MediaCodecList.REGULAR_CODECS);
         for (MediaCodecInfo codecInfo : list.getCodecInfos()) {
-            if (codecInfo.isEncoder() && Arrays.asList(codecInfo.getSupportedTypes()).contains(MediaFormat.MIMETYPE_VIDEO_AVC)) {
+            if (codecInfo.isEncoder() && Arrays.asList(codecInfo.getSupportedTypes()).contains(mimeType)) {
                 result.add(codecInfo);
             }
         }
         return result.toArray(new MediaCodecInfo[result.size()]);
     }
 
-    private static MediaCodec createCodec(String encoderName) throws IOException {
+    private static MediaCodec createCodec(String mimeType, String encoderName) throws IOException {
         if (encoderName != null) {
             Ln.d("Creating encoder by name: '" + encoderName + "'");
             try {
                 return MediaCodec.createByCodecName(encoderName);
             } catch (IllegalArgumentException e) {
-                MediaCodecInfo[] encoders = listEncoders();
+                MediaCodecInfo[] encoders = listEncoders(mimeType);
                 throw new InvalidEncoderException(encoderName, encoders);
             }
         }
-        MediaCodec codec = MediaCodec.createEncoderByType(MediaFormat.MIMETYPE_VIDEO_AVC);
+        MediaCodec codec;
+        try {
+            codec = MediaCodec.createEncoderByType(mimeType);
+        } catch (IOException | IllegalArgumentException e) {
+            // typically H.265 or AV1 on an older device
+            throw new IOException("No encoder found for " + mimeType, e);
+        }
         Ln.d("Using encoder: '" + codec.getName() + "'");
         return codec;
     }
@@ -198,9 +416,9 @@ public class ScreenEncoder implements Device.RotationListener {
         Ln.d("Codec option set: " + key + " (" + value.getClass().getSimpleName() + ") = " + value);
     }
 
-    private static MediaFormat createFormat(int bitRate, int maxFps, List<CodecOption> codecOptions) {
+    private static MediaFormat createFormat(String mimeType, int bitRate, int maxFps, List<CodecOption> codecOptions) {
         MediaFormat format = new MediaFormat();
-        format.setString(MediaFormat.KEY_MIME, MediaFormat.MIMETYPE_VIDEO_AVC);
+        format.setString(MediaFormat.KEY_MIME, mimeType);
         format.setInteger(MediaFormat.KEY_BIT_RATE, bitRate);
         // must be present to configure the encoder, but does not impact the actual frame rate, which is variable
         format.setInteger(MediaFormat.KEY_FRAME_RATE, 60);
@@ -224,6 +442,90 @@ public class ScreenEncoder implements Device.RotationListener {
         return format;
     }
 
+    private boolean hasCodecOption(String key) {
+        if (codecOptions != null) {
+            for (CodecOption option : codecOptions) {
+                if (option.getKey().equals(key)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    private static void setDefaultInteger(MediaFormat format, String key, int value) {
+        // the options explicitly passed by the user (already set) take precedence
+        if (!format.containsKey(key)) {
+            format.setInteger(key, value);
+        }
+    }
+
+    /**
+     * Tune the format for the lowest latency, according to the capabilities of the encoder.
+     * <p>
+     * The encoders ignore the keys they do not support, so the values actually accepted are logged once configured.
+     */
+    private void applyLatencyProfile(MediaFormat format, MediaCodecInfo codecInfo) {
+        setDefaultInteger(format, MediaFormat.KEY_LATENCY, 1); // frames
+        setDefaultInteger(format, MediaFormat.KEY_PRIORITY, 0); // realtime
+        setDefaultInteger(format, MediaFormat.KEY_OPERATING_RATE, maxFps > 0 ? maxFps : 60);
+        setDefaultInteger(format, MediaFormat.KEY_MAX_B_FRAMES, 0);
+
+        MediaCodecInfo.CodecCapabilities capabilities = codecInfo.getCapabilitiesForType(mimeType);
+        if (MediaFormat.MIMETYPE_VIDEO_AVC.equals(mimeType) && !format.containsKey(MediaFormat.KEY_PROFILE)) {
+            // constrained baseline has no B-frames (and no CABAC), fall back to baseline
+            MediaCodecInfo.CodecProfileLevel selected = null;
+            for (MediaCodecInfo.CodecProfileLevel profileLevel : capabilities.profileLevels) {
+                if (profileLevel.profile == MediaCodecInfo.CodecProfileLevel.AVCProfileConstrainedBaseline) {
+                    selected = profileLevel;
+                    break;
+                }
+                if (profileLevel.profile == MediaCodecInfo.CodecProfileLevel.AVCProfileBaseline) {
+                    selected = profileLevel;
+                }
+            }
+            if (selected != null) {
+                format.setInteger(MediaFormat.KEY_PROFILE, selected.profile);
+                format.setInteger(MediaFormat.KEY_LEVEL, selected.level);
+            }
+        }
+
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.N
+                && capabilities.isFeatureSupported(MediaCodecInfo.CodecCapabilities.FEATURE_IntraRefresh)) {
+            // refresh the picture progressively, rather than spiking on each key frame
+            setDefaultInteger(format, MediaFormat.KEY_INTRA_REFRESH_PERIOD, INTRA_REFRESH_PERIOD_FRAMES);
+            if (!hasCodecOption(MediaFormat.KEY_I_FRAME_INTERVAL)) {
+                format.setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, INTRA_REFRESH_I_FRAME_INTERVAL);
+            }
+        } else {
+            Ln.i("Intra refresh not supported by encoder '" + codecInfo.getName() + "'");
+        }
+    }
+
+    private static void logLatencyProfile(MediaFormat outputFormat) {
+        String[] keys = {MediaFormat.KEY_LATENCY, MediaFormat.KEY_PRIORITY, MediaFormat.KEY_OPERATING_RATE, MediaFormat.KEY_MAX_B_FRAMES,
+                MediaFormat.KEY_PROFILE, MediaFormat.KEY_LEVEL, MediaFormat.KEY_INTRA_REFRESH_PERIOD, MediaFormat.KEY_I_FRAME_INTERVAL};
+        StringBuilder builder = new StringBuilder("Latency profile accepted by the encoder:");
+        for (String key : keys) {
+            builder.append(' ').append(key).append('=');
+            // the value type depends on the encoder (typically integer, sometimes float)
+            builder.append(outputFormat.containsKey(key) ? getValueString(outputFormat, key) : "-");
+        }
+        Ln.i(builder.toString());
+    }
+
+    private static String getValueString(MediaFormat format, String key) {
+        try {
+            return String.valueOf(format.getInteger(key));
+        } catch (ClassCastException e) {
+            try {
+                return String.valueOf(format.getFloat(key));
+            } catch (ClassCastException e2) {
+                return "?";
+            }
+        }
+    }
+
     private static IBinder createDisplay() {
         return SurfaceControl.createDisplay("scrcpy", true);
     }
@@ -248,6 +550,15 @@ public class ScreenEncoder implements Device.RotationListener {
         }
     }
 
+    private static void setDisplayProjection(IBinder display, int orientation, Rect deviceRect, Rect displayRect) {
+        SurfaceControl.openTransaction();
+        try {
+            SurfaceControl.setDisplayProjection(display, orientation, deviceRect, displayRect);
+        } finally {
+            SurfaceControl.closeTransaction();
+        }
+    }
+
     private static void destroyDisplay(IBinder display) {
         SurfaceControl.destroyDisplay(display);
     }
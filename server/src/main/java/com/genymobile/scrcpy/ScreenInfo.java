@@ -80,6 +80,32 @@ public final class ScreenInfo {
         return new ScreenInfo(newContentRect, newUnlockedVideoSize, newDeviceRotation, lockedVideoOrientation);
     }
 
+    /**
+     * Return the same screen info, with the video size computed for another max size (for a secondary stream).
+     *
+     * @param maxSize the max size of the video (0 for unlimited)
+     * @return the screen info for the given max size
+     */
+    public ScreenInfo withMaxSize(int maxSize) {
+        Size newUnlockedVideoSize = computeVideoSize(contentRect.width(), contentRect.height(), maxSize);
+        if (newUnlockedVideoSize.equals(unlockedVideoSize)) {
+            return this;
+        }
+        return new ScreenInfo(contentRect, newUnlockedVideoSize, deviceRotation, lockedVideoOrientation);
+    }
+
+    /**
+     * Return the same screen info, with another content rectangle (for a crop changed at runtime).
+     *
+     * @param newContentRect the content rectangle, in the current device orientation
+     * @param maxSize the max size of the video (0 for unlimited)
+     * @return the screen info for the given content rectangle
+     */
+    public ScreenInfo withContentRect(Rect newContentRect, int maxSize) {
+        Size newUnlockedVideoSize = computeVideoSize(newContentRect.width(), newContentRect.height(), maxSize);
+        return new ScreenInfo(newContentRect, newUnlockedVideoSize, deviceRotation, lockedVideoOrientation);
+    }
+
     public static ScreenInfo computeScreenInfo(DisplayInfo displayInfo, Rect crop, int maxSize, int lockedVideoOrientation) {
         int rotation = displayInfo.getRotation();
         Size deviceSize = displayInfo.getSize();
@@ -5,6 +5,8 @@ import com.genymobile.scrcpy.wrappers.ContentProvider;
 import android.graphics.Rect;
 import android.media.MediaCodec;
 import android.media.MediaCodecInfo;
+import android.media.MediaFormat;
+import android.net.LocalSocket;
 import android.os.BatteryManager;
 import android.os.Build;
 
@@ -19,77 +21,194 @@ public final class Server {
         // not instantiable
     }
 
+    /**
+     * The device settings changed for a session, to restore on clean up.
+     */
+    static final class ChangedSettings {
+        private boolean mustDisableShowTouches;
+        private int restoreStayOn = -1;
+
+        boolean mustDisableShowTouches() {
+            return mustDisableShowTouches;
+        }
+
+        int getRestoreStayOn() {
+            return restoreStayOn;
+        }
+    }
+
     private static void scrcpy(Options options) throws IOException {
         Ln.i("Device: " + Build.MANUFACTURER + " " + Build.MODEL + " (Android " + Build.VERSION.RELEASE + ")");
         final Device device = new Device(options);
-        List<CodecOption> codecOptions = CodecOption.parse(options.getCodecOptions());
 
-        boolean mustDisableShowTouchesOnCleanUp = false;
-        int restoreStayOn = -1;
-        if (options.getShowTouches() || options.getStayAwake()) {
+        ChangedSettings changed = changeSettings(options.getShowTouches(), options.getStayAwake());
+        CleanUp.configure(changed.mustDisableShowTouches, changed.restoreStayOn, true);
+
+        boolean tunnelForward = options.isTunnelForward();
+
+        try (DesktopConnection connection = DesktopConnection.open(device, tunnelForward, getSecondaryVideoSize(options, device))) {
+            stream(options, device, connection);
+        }
+    }
+
+    /**
+     * Run a session of the daemon, on sockets already connected.
+     * <p>
+     * The state changed for the session is restored on return (once no other session needs it), since the process does not die.
+     */
+    static void scrcpy(Options options, LocalSocket videoSocket, LocalSocket controlSocket, LocalSocket secondaryVideoSocket)
+            throws IOException {
+        Ln.i("Session: " + Build.MANUFACTURER + " " + Build.MODEL + " (Android " + Build.VERSION.RELEASE + ")");
+        final Device device = new Device(options);
+        DaemonSettings.acquire(options.getShowTouches(), options.getStayAwake());
+        try (DesktopConnection connection = DesktopConnection.create(device, videoSocket, controlSocket, secondaryVideoSocket,
+                getSecondaryVideoSize(options, device))) {
+            stream(options, device, connection);
+        } finally {
+            device.release();
+            DaemonSettings.release(options.getShowTouches(), options.getStayAwake());
+        }
+    }
+
+    static ChangedSettings changeSettings(boolean showTouches, boolean stayAwake) {
+        ChangedSettings changed = new ChangedSettings();
+        if (showTouches || stayAwake) {
             try (ContentProvider settings = Device.createSettingsProvider()) {
-                if (options.getShowTouches()) {
+                if (showTouches) {
                     String oldValue = settings.getAndPutValue(ContentProvider.TABLE_SYSTEM, "show_touches", "1");
                     // If "show touches" was disabled, it must be disabled back on clean up
-                    mustDisableShowTouchesOnCleanUp = !"1".equals(oldValue);
+                    changed.mustDisableShowTouches = !"1".equals(oldValue);
                 }
 
-                if (options.getStayAwake()) {
+                if (stayAwake) {
                     int stayOn = BatteryManager.BATTERY_PLUGGED_AC | BatteryManager.BATTERY_PLUGGED_USB | BatteryManager.BATTERY_PLUGGED_WIRELESS;
                     String oldValue = settings.getAndPutValue(ContentProvider.TABLE_GLOBAL, "stay_on_while_plugged_in", String.valueOf(stayOn));
                     try {
-                        restoreStayOn = Integer.parseInt(oldValue);
-                        if (restoreStayOn == stayOn) {
+                        changed.restoreStayOn = Integer.parseInt(oldValue);
+                        if (changed.restoreStayOn == stayOn) {
                             // No need to restore
-                            restoreStayOn = -1;
+                            changed.restoreStayOn = -1;
                         }
                     } catch (NumberFormatException e) {
-                        restoreStayOn = 0;
+                        changed.restoreStayOn = 0;
                     }
                 }
             }
         }
+        return changed;
+    }
 
-        CleanUp.configure(mustDisableShowTouchesOnCleanUp, restoreStayOn, true);
+    private static Size getSecondaryVideoSize(Options options, Device device) {
+        if (!options.hasSecondaryStream()) {
+            return null;
+        }
+        return device.getScreenInfo().withMaxSize(options.getSecondaryMaxSize()).getVideoSize();
+    }
 
-        boolean tunnelForward = options.isTunnelForward();
+    private static void stream(Options options, Device device, DesktopConnection connection) throws IOException {
+        List<CodecOption> codecOptions = CodecOption.parse(options.getCodecOptions());
 
-        try (DesktopConnection connection = DesktopConnection.open(device, tunnelForward)) {
-            ScreenEncoder screenEncoder = new ScreenEncoder(options.getSendFrameMeta(), options.getBitRate(), options.getMaxFps(), codecOptions,
-                    options.getEncoderName());
+        ScreenEncoder screenEncoder = new ScreenEncoder(options.getSendFrameMeta(), options.getVideoMimeType(), options.getBitRate(),
+                options.getMaxFps(), codecOptions, options.getEncoderName(), ScreenEncoder.DEVICE_MAX_SIZE,
+                options.getLatencyProfile());
+
+        // a second virtual display and encoder, downscaled independently (typically for a preview while recording the main stream)
+        ScreenEncoder secondaryScreenEncoder = null;
+        Thread secondaryEncoderThread = null;
+        if (options.hasSecondaryStream()) {
+            secondaryScreenEncoder = new ScreenEncoder(options.getSendFrameMeta(), options.getVideoMimeType(), options.getSecondaryBitRate(),
+                    options.getMaxFps(), codecOptions, options.getEncoderName(), options.getSecondaryMaxSize(),
+                    options.getLatencyProfile());
+            secondaryEncoderThread = startSecondaryEncoder(secondaryScreenEncoder, device, connection);
+        }
 
-            Thread controllerThread = null;
-            Thread deviceMessageSenderThread = null;
-            if (options.getControl()) {
-                final Controller controller = new Controller(device, connection);
+        Thread controllerThread = null;
+        Thread deviceMessageSenderThread = null;
+        if (options.getControl()) {
+            // only the main stream is measured, the counters are sent over the control socket
+            PerfCounters perfCounters = new PerfCounters();
+            screenEncoder.setPerfCounters(perfCounters);
+            final Controller controller = new Controller(device, connection, screenEncoder, secondaryScreenEncoder, perfCounters);
+
+            // asynchronous
+            controllerThread = startController(controller);
+            deviceMessageSenderThread = startDeviceMessageSender(controller.getSender());
+
+            device.setClipboardListener(new Device.ClipboardListener() {
+                @Override
+                public void onClipboardTextChanged(String text) {
+                    controller.getSender().pushClipboardText(text);
+                }
+            });
+        }
 
-                // asynchronous
-                controllerThread = startController(controller);
-                deviceMessageSenderThread = startDeviceMessageSender(controller.getSender());
+        DatagramVideoSender datagramSender = null;
+        Thread videoSocketWatcherThread = null;
+        try {
+            if (options.getVideoUdpPort() != 0) {
+                datagramSender = new DatagramVideoSender(options.getVideoUdpPort());
+                // nothing else is sent over UDP to detect that the client is gone
+                videoSocketWatcherThread = startVideoSocketWatcher(connection, datagramSender);
+                datagramSender.waitForClient();
+                screenEncoder.setDatagramSender(datagramSender);
+            }
 
-                device.setClipboardListener(new Device.ClipboardListener() {
-                    @Override
-                    public void onClipboardTextChanged(String text) {
-                        controller.getSender().pushClipboardText(text);
-                    }
-                });
+            // synchronous
+            screenEncoder.streamScreen(device, connection.getVideoFd());
+        } catch (IOException e) {
+            // this is expected on close
+            Ln.d("Screen streaming stopped");
+        } finally {
+            if (datagramSender != null) {
+                datagramSender.close();
+            }
+            if (videoSocketWatcherThread != null) {
+                videoSocketWatcherThread.interrupt();
+            }
+            if (controllerThread != null) {
+                controllerThread.interrupt();
             }
+            if (deviceMessageSenderThread != null) {
+                deviceMessageSenderThread.interrupt();
+            }
+            if (secondaryEncoderThread != null) {
+                secondaryEncoderThread.interrupt();
+            }
+        }
+    }
 
-            try {
-                // synchronous
-                screenEncoder.streamScreen(device, connection.getVideoFd());
-            } catch (IOException e) {
-                // this is expected on close
-                Ln.d("Screen streaming stopped");
-            } finally {
-                if (controllerThread != null) {
-                    controllerThread.interrupt();
+    private static Thread startSecondaryEncoder(final ScreenEncoder screenEncoder, final Device device, final DesktopConnection connection) {
+        Thread thread = new Thread(new Runnable() {
+            @Override
+            public void run() {
+                try {
+                    screenEncoder.streamScreen(device, connection.getSecondaryVideoFd());
+                } catch (IOException e) {
+                    // this is expected on close
+                    Ln.d("Secondary screen streaming stopped");
                 }
-                if (deviceMessageSenderThread != null) {
-                    deviceMessageSenderThread.interrupt();
+            }
+        });
+        thread.start();
+        return thread;
+    }
+
+    private static Thread startVideoSocketWatcher(final DesktopConnection connection, final DatagramVideoSender datagramSender) {
+        Thread thread = new Thread(new Runnable() {
+            @Override
+            public void run() {
+                try {
+                    connection.waitForVideoSocketClosed();
+                } catch (IOException e) {
+                    // closed anyway
                 }
+                Ln.d("Video socket closed");
+                // unblock the encoder thread
+                datagramSender.close();
             }
-        }
+        });
+        thread.start();
+        return thread;
     }
 
     private static Thread startController(final Controller controller) {
@@ -124,18 +243,21 @@ public final class Server {
         return thread;
     }
 
-    private static Options createOptions(String... args) {
-        if (args.length < 1) {
-            throw new IllegalArgumentException("Missing client version");
-        }
-
-        String clientVersion = args[0];
+    private static void checkClientVersion(String clientVersion) {
         if (!clientVersion.equals(BuildConfig.VERSION_NAME)) {
             throw new IllegalArgumentException(
                     "The server version (" + BuildConfig.VERSION_NAME + ") does not match the client " + "(" + clientVersion + ")");
         }
+    }
+
+    static Options createOptions(String... args) {
+        if (args.length < 1) {
+            throw new IllegalArgumentException("Missing client version");
+        }
 
-        final int expectedParameters = 15;
+        checkClientVersion(args[0]);
+
+        final int expectedParameters = 20;
         if (args.length != expectedParameters) {
             throw new IllegalArgumentException("Expecting " + expectedParameters + " parameters");
         }
@@ -185,9 +307,50 @@ public final class Server {
         String encoderName = "-".equals(args[14]) ? null : args[14];
         options.setEncoderName(encoderName);
 
+        int secondaryMaxSize = Integer.parseInt(args[15]) & ~7; // multiple of 8
+        options.setSecondaryMaxSize(secondaryMaxSize);
+
+        // 0 to disable the secondary stream
+        int secondaryBitRate = Integer.parseInt(args[16]);
+        options.setSecondaryBitRate(secondaryBitRate);
+
+        // 0 to send the video stream over the video socket
+        int videoUdpPort = Integer.parseInt(args[17]);
+        options.setVideoUdpPort(videoUdpPort);
+
+        String videoMimeType = parseVideoCodec(args[18]);
+        options.setVideoMimeType(videoMimeType);
+
+        boolean latencyProfile = parseEncoderProfile(args[19]);
+        options.setLatencyProfile(latencyProfile);
+
         return options;
     }
 
+    private static boolean parseEncoderProfile(String profile) {
+        switch (profile) {
+            case "latency":
+                return true;
+            case "quality":
+                return false;
+            default:
+                throw new IllegalArgumentException("Invalid encoder profile: " + profile);
+        }
+    }
+
+    private static String parseVideoCodec(String codec) {
+        switch (codec) {
+            case "h264":
+                return MediaFormat.MIMETYPE_VIDEO_AVC;
+            case "h265":
+                return MediaFormat.MIMETYPE_VIDEO_HEVC;
+            case "av1":
+                return MediaFormat.MIMETYPE_VIDEO_AV1;
+            default:
+                throw new IllegalArgumentException("Invalid video codec: " + codec);
+        }
+    }
+
     private static Rect parseCrop(String crop) {
         if ("-".equals(crop)) {
             return null;
@@ -245,6 +408,14 @@ public final class Server {
             }
         });
 
+        if (args.length == 3 && Daemon.ARG.equals(args[1])) {
+            // the options are received from each client, except the log level which is global to the process
+            checkClientVersion(args[0]);
+            Ln.initLogLevel(Ln.Level.valueOf(args[2].toUpperCase(Locale.ENGLISH)));
+            Daemon.run();
+            return;
+        }
+
         Options options = createOptions(args);
 
         Ln.initLogLevel(options.getLogLevel());
@@ -6,13 +6,20 @@ public final class StringUtils {
     }
 
     public static int getUtf8TruncationIndex(byte[] utf8, int maxLength) {
-        int len = utf8.length;
+        return getUtf8TruncationIndex(utf8, 0, maxLength);
+    }
+
+    /**
+     * Return the length of the longest valid UTF-8 chunk starting at {@code offset}, not longer than {@code maxLength}.
+     */
+    public static int getUtf8TruncationIndex(byte[] utf8, int offset, int maxLength) {
+        int len = utf8.length - offset;
         if (len <= maxLength) {
             return len;
         }
         len = maxLength;
         // see UTF-8 encoding <https://en.wikipedia.org/wiki/UTF-8#Description>
-        while ((utf8[len] & 0x80) != 0 && (utf8[len] & 0xc0) != 0xc0) {
+        while ((utf8[offset + len] & 0x80) != 0 && (utf8[offset + len] & 0xc0) != 0xc0) {
             // the next byte is not the start of a new UTF-8 codepoint
             // so if we would cut there, the character would be truncated
             len--;
@@ -17,7 +17,7 @@ public final class Workarounds {
     }
 
     @SuppressWarnings("deprecation")
-    public static void prepareMainLooper() {
+    public static synchronized void prepareMainLooper() {
         // Some devices internally create a Handler when creating an input Surface, causing an exception:
         //   "Can't create handler inside thread that has not called Looper.prepare()"
         // <https://github.com/Genymobile/scrcpy/issues/240>
@@ -26,7 +26,12 @@ public final class Workarounds {
         //   "Attempt to read from field 'android.os.MessageQueue android.os.Looper.mQueue'
         //    on a null object reference"
         // <https://github.com/Genymobile/scrcpy/issues/921>
-        Looper.prepareMainLooper();
+        if (Looper.getMainLooper() == null) {
+            Looper.prepareMainLooper();
+        } else if (Looper.myLooper() == null) {
+            // the main looper has been prepared by another encoder thread
+            Looper.prepare();
+        }
     }
 
     @SuppressLint("PrivateApi,DiscouragedPrivateApi")
@@ -1,6 +1,7 @@
 package com.genymobile.scrcpy.wrappers;
 
 import com.genymobile.scrcpy.DisplayInfo;
+import com.genymobile.scrcpy.Ln;
 import com.genymobile.scrcpy.Size;
 
 import android.os.IInterface;
@@ -25,12 +26,27 @@ public final class DisplayManager {
             int rotation = cls.getDeclaredField("rotation").getInt(displayInfo);
             int layerStack = cls.getDeclaredField("layerStack").getInt(displayInfo);
             int flags = cls.getDeclaredField("flags").getInt(displayInfo);
-            return new DisplayInfo(displayId, new Size(width, height), rotation, layerStack, flags);
+            float refreshRate = getRefreshRate(cls, displayInfo);
+            return new DisplayInfo(displayId, new Size(width, height), rotation, layerStack, flags, refreshRate);
         } catch (Exception e) {
             throw new AssertionError(e);
         }
     }
 
+    private static float getRefreshRate(Class<?> cls, Object displayInfo) {
+        try {
+            // since Android 6, the refresh rate depends on the current display mode
+            return (float) cls.getMethod("getRefreshRate").invoke(displayInfo);
+        } catch (Exception e) {
+            try {
+                return cls.getDeclaredField("refreshRate").getFloat(displayInfo);
+            } catch (Exception e2) {
+                Ln.w("Could not get the display refresh rate");
+                return 0;
+            }
+        }
+    }
+
     public int[] getDisplayIds() {
         try {
             return (int[]) manager.getClass().getMethod("getDisplayIds").invoke(manager);
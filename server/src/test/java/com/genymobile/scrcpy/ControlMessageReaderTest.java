@@ -116,6 +116,95 @@ public class ControlMessageReaderTest {
         Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, event.getButtons());
     }
 
+    @Test
+    public void testParseCompactEvents() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_SCREEN_SIZE);
+        dos.writeShort(1080);
+        dos.writeShort(1920);
+        dos.writeByte(ControlMessage.TYPE_INJECT_TOUCH_EVENT_COMPACT);
+        dos.writeByte(MotionEvent.ACTION_DOWN);
+        dos.writeByte(0x01); // pointerId + 2
+        dos.write(new byte[]{(byte) 0xc8, 0x01}); // +100
+        dos.write(new byte[]{(byte) 0x90, 0x03}); // +200
+        dos.writeByte(0xff); // pressure
+        dos.writeByte(MotionEvent.BUTTON_PRIMARY);
+        dos.writeByte(ControlMessage.TYPE_INJECT_TOUCH_EVENT_COMPACT);
+        dos.writeByte(MotionEvent.ACTION_MOVE);
+        dos.writeByte(0x01); // pointerId + 2
+        dos.writeByte(0x03); // -2
+        dos.writeByte(0x06); // +3
+        dos.writeByte(0x80); // pressure
+        dos.writeByte(MotionEvent.BUTTON_PRIMARY);
+        dos.writeByte(ControlMessage.TYPE_INJECT_SCROLL_EVENT_COMPACT);
+        dos.writeByte(0x00); // same x
+        dos.writeByte(0x00); // same y
+        dos.writeByte(0x02); // hScroll = 1
+        dos.writeByte(0x01); // vScroll = -1
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+
+        ControlMessage event = reader.next();
+        Assert.assertEquals(ControlMessage.TYPE_INJECT_TOUCH_EVENT, event.getType());
+        Assert.assertEquals(MotionEvent.ACTION_DOWN, event.getAction());
+        Assert.assertEquals(-1, event.getPointerId());
+        Assert.assertEquals(100, event.getPosition().getPoint().getX());
+        Assert.assertEquals(200, event.getPosition().getPoint().getY());
+        Assert.assertEquals(1080, event.getPosition().getScreenSize().getWidth());
+        Assert.assertEquals(1920, event.getPosition().getScreenSize().getHeight());
+        Assert.assertEquals(1f, event.getPressure(), 0f); // must be exact
+        Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, event.getButtons());
+
+        event = reader.next();
+        Assert.assertEquals(ControlMessage.TYPE_INJECT_TOUCH_EVENT, event.getType());
+        Assert.assertEquals(MotionEvent.ACTION_MOVE, event.getAction());
+        Assert.assertEquals(98, event.getPosition().getPoint().getX());
+        Assert.assertEquals(203, event.getPosition().getPoint().getY());
+        Assert.assertEquals(1080, event.getPosition().getScreenSize().getWidth());
+        Assert.assertEquals(1920, event.getPosition().getScreenSize().getHeight());
+        Assert.assertEquals(0.5f, event.getPressure(), 0f);
+
+        event = reader.next();
+        Assert.assertEquals(ControlMessage.TYPE_INJECT_SCROLL_EVENT, event.getType());
+        Assert.assertEquals(98, event.getPosition().getPoint().getX());
+        Assert.assertEquals(203, event.getPosition().getPoint().getY());
+        Assert.assertEquals(1, event.getHScroll());
+        Assert.assertEquals(-1, event.getVScroll());
+
+        Assert.assertNull(reader.next());
+    }
+
+    @Test
+    public void testParseCompactEventPartial() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_INJECT_TOUCH_EVENT_COMPACT);
+        dos.writeByte(MotionEvent.ACTION_DOWN);
+        dos.writeByte(0x01); // pointerId + 2
+        dos.write(new byte[]{(byte) 0xc8, 0x01}); // +100
+        dos.write(new byte[]{(byte) 0x90, 0x03}); // +200
+        dos.writeByte(0xff); // pressure
+        dos.writeByte(MotionEvent.BUTTON_PRIMARY);
+
+        byte[] packet = bos.toByteArray();
+
+        // the varint of y is incomplete
+        reader.readFrom(new ByteArrayInputStream(packet, 0, 6));
+        Assert.assertNull(reader.next());
+
+        reader.readFrom(new ByteArrayInputStream(packet, 6, packet.length - 6));
+        ControlMessage event = reader.next();
+        Assert.assertEquals(100, event.getPosition().getPoint().getX());
+        Assert.assertEquals(200, event.getPosition().getPoint().getY());
+    }
+
     @Test
     public void testParseScrollEvent() throws IOException {
         ControlMessageReader reader = new ControlMessageReader();
@@ -233,6 +322,26 @@ public class ControlMessageReaderTest {
         Assert.assertTrue(event.getPaste());
     }
 
+    @Test
+    public void testParseSetClipboardPartEvent() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_CLIPBOARD_PART);
+        byte[] text = "testé".getBytes(StandardCharsets.UTF_8);
+        dos.writeInt(text.length);
+        dos.write(text);
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_CLIPBOARD_PART, event.getType());
+        Assert.assertEquals("testé", event.getText());
+    }
+
     @Test
     public void testParseBigSetClipboardEvent() throws IOException {
         ControlMessageReader reader = new ControlMessageReader();
@@ -296,6 +405,137 @@ public class ControlMessageReaderTest {
         Assert.assertEquals(ControlMessage.TYPE_ROTATE_DEVICE, event.getType());
     }
 
+    @Test
+    public void testParseRequestKeyFrame() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_REQUEST_KEY_FRAME);
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_REQUEST_KEY_FRAME, event.getType());
+    }
+
+    @Test
+    public void testParsePing() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_PING);
+        dos.writeLong(0x0102030405060708L);
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.PING_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_PING, event.getType());
+        Assert.assertEquals(0x0102030405060708L, event.getTimestamp());
+    }
+
+    @Test
+    public void testParseSetBitRate() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_BIT_RATE);
+        dos.writeInt(4000000);
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.SET_BIT_RATE_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_BIT_RATE, event.getType());
+        Assert.assertEquals(4000000, event.getBitRate());
+    }
+
+    @Test
+    public void testParseSetCrop() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_CROP);
+        dos.writeInt(260);
+        dos.writeInt(1026);
+        dos.writeShort(1080);
+        dos.writeShort(1920);
+        dos.writeInt(540);
+        dos.writeInt(960);
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.SET_CROP_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_CROP, event.getType());
+        Assert.assertEquals(260, event.getPosition().getPoint().getX());
+        Assert.assertEquals(1026, event.getPosition().getPoint().getY());
+        Assert.assertEquals(1080, event.getPosition().getScreenSize().getWidth());
+        Assert.assertEquals(1920, event.getPosition().getScreenSize().getHeight());
+        Assert.assertEquals(540, event.getCropWidth());
+        Assert.assertEquals(960, event.getCropHeight());
+    }
+
+    @Test
+    public void testParseSetMaxSize() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_MAX_SIZE);
+        dos.writeShort(40000);
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.SET_MAX_SIZE_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_MAX_SIZE, event.getType());
+        Assert.assertEquals(40000, event.getMaxSize());
+    }
+
+    @Test
+    public void testParseSetVideoPaused() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_VIDEO_PAUSED);
+        dos.writeByte(1);
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.SET_VIDEO_PAUSED_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_VIDEO_PAUSED, event.getType());
+        Assert.assertTrue(event.getVideoPaused());
+    }
+
     @Test
     public void testMultiEvents() throws IOException {
         ControlMessageReader reader = new ControlMessageReader();
@@ -7,6 +7,7 @@ import java.io.ByteArrayOutputStream;
 import java.io.DataOutputStream;
 import java.io.IOException;
 import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
 
 public class DeviceMessageWriterTest {
 
@@ -32,4 +33,103 @@ public class DeviceMessageWriterTest {
 
         Assert.assertArrayEquals(expected, actual);
     }
+
+    @Test
+    public void testSerializeBigClipboard() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        byte[] data = new byte[DeviceMessageWriter.CLIPBOARD_TEXT_MAX_LENGTH + 10];
+        Arrays.fill(data, (byte) 'a');
+        String text = new String(data, StandardCharsets.US_ASCII);
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_CLIPBOARD_PART);
+        dos.writeInt(DeviceMessageWriter.CLIPBOARD_TEXT_MAX_LENGTH);
+        dos.write(data, 0, DeviceMessageWriter.CLIPBOARD_TEXT_MAX_LENGTH);
+        dos.writeByte(DeviceMessage.TYPE_CLIPBOARD);
+        dos.writeInt(10);
+        dos.write(data, 0, 10);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createClipboard(text);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializePong() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_PONG);
+        dos.writeLong(0x0102030405060708L);
+        dos.writeLong(1000);
+        dos.writeLong(1042);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createPong(0x0102030405060708L, 1000, 1042);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeStats() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_STATS);
+        dos.writeInt(60); // encoded frames
+        dos.writeInt(2); // dropped frames
+        dos.writeInt(1_000_000); // bytes per second
+        dos.writeInt(8000); // encode time avg
+        dos.writeInt(20000); // encode time max
+        dos.writeInt(3); // queue depth max
+        dos.writeInt(120); // injected events
+        dos.writeInt(500); // injection latency avg
+        dos.writeInt(4000); // injection latency max
+
+        byte[] expected = bos.toByteArray();
+
+        PerfCounters.Stats stats = new PerfCounters.Stats(60, 2, 1_000_000, 8000, 20000, 3, 120, 500, 4000);
+        DeviceMessage msg = DeviceMessage.createStats(stats);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeRefreshRate() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_REFRESH_RATE);
+        dos.writeInt(59940);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createRefreshRate(59940);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
 }
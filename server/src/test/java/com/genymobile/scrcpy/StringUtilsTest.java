@@ -39,4 +39,24 @@ public class StringUtilsTest {
         count = StringUtils.getUtf8TruncationIndex(utf8, 8);
         Assert.assertEquals(7, count); // no more chars
     }
+
+    @Test
+    public void testUtf8TruncateFromOffset() {
+        String s = "aÉbÔc";
+        byte[] utf8 = s.getBytes(StandardCharsets.UTF_8);
+
+        int count;
+
+        count = StringUtils.getUtf8TruncationIndex(utf8, 1, 1);
+        Assert.assertEquals(0, count); // É is 2 bytes-wide
+
+        count = StringUtils.getUtf8TruncationIndex(utf8, 1, 2);
+        Assert.assertEquals(2, count);
+
+        count = StringUtils.getUtf8TruncationIndex(utf8, 3, 2);
+        Assert.assertEquals(1, count); // Ô is 2 bytes-wide
+
+        count = StringUtils.getUtf8TruncationIndex(utf8, 4, 8);
+        Assert.assertEquals(3, count); // no more chars
+    }
 }